@@ -0,0 +1,100 @@
+#include "affinity.hpp"
+#include "crypto/verushash/verushash.hpp"
+#include "spdlog/spdlog.h"
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <tuple>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+#ifdef __linux__
+std::optional<int> read_int(const std::filesystem::path& p)
+{
+    std::ifstream f(p);
+    int i;
+    if (f >> i)
+        return i;
+    return {};
+}
+#endif
+}
+
+std::vector<int> pinning_order()
+{
+#ifdef __linux__
+    struct Cpu {
+        int package;
+        int core;
+        int cpu;
+        size_t sibling { 0 }; // index among the logical CPUs of its core
+    };
+    std::vector<Cpu> cpus;
+    const std::filesystem::path base { "/sys/devices/system/cpu" };
+    std::error_code ec;
+    for (auto& e : std::filesystem::directory_iterator(base, ec)) {
+        auto name { e.path().filename().string() };
+        if (name.size() < 4 || name.compare(0, 3, "cpu") != 0
+            || !std::all_of(name.begin() + 3, name.end(), ::isdigit))
+            continue;
+        auto package { read_int(e.path() / "topology/physical_package_id") };
+        auto core { read_int(e.path() / "topology/core_id") };
+        if (!package || !core)
+            continue;
+        cpus.push_back({ *package, *core, std::stoi(name.substr(3)) });
+    }
+    auto key { [](const Cpu& c) { return std::tie(c.package, c.core, c.cpu); } };
+    std::sort(cpus.begin(), cpus.end(), [&](auto& a, auto& b) { return key(a) < key(b); });
+    for (size_t i = 1; i < cpus.size(); ++i) {
+        auto& p { cpus[i - 1] };
+        auto& c { cpus[i] };
+        if (c.package == p.package && c.core == p.core)
+            c.sibling = p.sibling + 1;
+    }
+    std::stable_sort(cpus.begin(), cpus.end(), [](auto& a, auto& b) { return a.sibling < b.sibling; });
+    std::vector<int> res;
+    for (auto& c : cpus)
+        res.push_back(c.cpu);
+    return res;
+#else
+    return {};
+#endif
+}
+
+bool pin_current_thread(int cpu)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
+ThreadPinning::ThreadPinning(bool enabled)
+{
+    if (!enabled)
+        return;
+    order = pinning_order();
+    if (order.empty()) {
+        spdlog::warn("Cannot detect the CPU topology, threads are not pinned.");
+        return;
+    }
+    Verus::use_thread_key_buffers(true);
+}
+
+void ThreadPinning::pin(size_t i) const
+{
+    if (order.empty())
+        return;
+    const int cpu { order[i % order.size()] };
+    if (!pin_current_thread(cpu))
+        spdlog::warn("Cannot pin thread {} to CPU {}.", i, cpu);
+}
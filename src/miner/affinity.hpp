@@ -0,0 +1,23 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+// Logical CPUs in pinning order: one per physical core grouped by package,
+// followed by the SMT siblings. Empty if the topology is unknown.
+std::vector<int> pinning_order();
+
+// pins the calling thread to the cpu, returns false on failure
+bool pin_current_thread(int cpu);
+
+// Pins the i-th of a group of hashing threads according to pinning_order()
+// and makes its verushash keys NUMA-local. Call from the thread before it
+// hashes.
+class ThreadPinning {
+public:
+    ThreadPinning(bool enabled);
+    bool enabled() const { return !order.empty(); }
+    void pin(size_t i) const;
+
+private:
+    std::vector<int> order;
+};
@@ -8,7 +8,12 @@ using namespace std;
 using namespace nlohmann;
 
 API::API(std::string host, uint16_t port)
-    : cli(host, port) {};
+    : cli(host, port)
+{
+    // one connection for all polls, httplib reconnects transparently
+    cli.set_keep_alive(true);
+    cli.set_read_timeout(longPollTimeout);
+};
 size_t writeFunction(void* ptr, size_t size, size_t nmemb, std::string* data)
 {
     data->append((char*)ptr, size * nmemb);
@@ -58,32 +63,49 @@ std::pair<std::string, int> API::submit_block(const Block& mt)
     }
 }
 
+namespace {
+Block parse_mining(const std::string& out)
+{
+    json parsed;
+    try {
+        parsed = json::parse(out);
+    } catch (...) {
+        throw std::runtime_error("API request failed, response is malformed. Is the node version compatible with this wallet?");
+    }
+    int32_t code = parsed["code"].get<int32_t>();
+    if (code != 0) {
+        throw std::runtime_error("API request failed: " + parsed["error"].get<std::string>());
+    }
+    return Block {
+        .height = Height(parsed["data"]["height"].get<uint32_t>()).nonzero_throw(EZEROHEIGHT),
+        .header = hex_to_arr<80>(parsed["data"]["header"].get<std::string>()),
+        .body = hex_to_vec(parsed["data"]["body"].get<std::string>()),
+    };
+}
+}
+
+std::optional<Block> API::wait_mining(const Address& a)
+{
+    try {
+        return parse_mining(http_get("/chain/mine/" + a.to_string() + "/wait"));
+    } catch (...) {
+        return {};
+    }
+}
+
 Block API::get_mining(const Address& a)
 {
+    using namespace std::chrono;
     std::string url = "/chain/mine/" + a.to_string();
+    milliseconds backoff { 100 };
     while (true) {
         try {
-            std::string out = http_get(url);
-
-            json parsed;
-            try {
-                parsed = json::parse(out);
-            } catch (...) {
-                throw std::runtime_error("API request failed, response is malformed. Is the node version compatible with this wallet?");
-            }
-            int32_t code = parsed["code"].get<int32_t>();
-            if (code != 0) {
-                throw std::runtime_error("API request failed: " + parsed["error"].get<std::string>());
-            }
-            return Block {
-                .height = Height(parsed["data"]["height"].get<uint32_t>()).nonzero_throw(EZEROHEIGHT),
-                .header = hex_to_arr<80>(parsed["data"]["header"].get<std::string>()),
-                .body = hex_to_vec(parsed["data"]["body"].get<std::string>()),
-            };
+            return parse_mining(http_get(url));
         } catch (std::runtime_error& e) {
             spdlog::error(e.what());
-            spdlog::warn("Could not get mining information, retrying in 100 milliseconds...");
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            spdlog::warn("Could not get mining information, retrying in {} milliseconds...", backoff.count());
+            std::this_thread::sleep_for(backoff);
+            backoff = std::min(2 * backoff, milliseconds(maxBackoff));
         }
     }
 }
@@ -1,6 +1,8 @@
 #pragma once
 #include "communication/mining_task.hpp"
 #include "httplib.hpp"
+#include <chrono>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -9,8 +11,14 @@ struct API {
     API(std::string host, uint16_t port);
     [[nodiscard]] std::pair<std::string, int> submit_block(const Block& mt);
     [[nodiscard]] Block get_mining(const Address& a);
+    // long-poll, returns the next mining task pushed by the node or
+    // nothing if the node does not support it
+    [[nodiscard]] std::optional<Block> wait_mining(const Address& a);
 
 private:
+    // above the node's long-poll refresh interval of 2 seconds
+    static constexpr std::chrono::seconds longPollTimeout { 10 };
+    static constexpr std::chrono::seconds maxBackoff { 5 }; // reconnect
     std::string http_get(const std::string& path);
     std::string http_post(const std::string& path, const std::string& postdata);
     httplib::Client cli;
@@ -0,0 +1,138 @@
+#include "benchmark.hpp"
+#include "affinity.hpp"
+#include "block/header/difficulty.hpp"
+#include "block/header/generator.hpp"
+#include "block/header/header_impl.hpp"
+#include "block/header/midstate.hpp"
+#include "cpu/mine.hpp"
+#include "cpu/tuning.hpp"
+#include "crypto/verushash/verushash.hpp"
+#include "helpers.hpp"
+#include "spdlog/spdlog.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+int start_gpu_benchmark(std::string gpus);
+
+namespace {
+using namespace std::chrono;
+
+// the seed plays the role of the Workertask extranonce, threads hash
+// different merkle roots
+Header synthetic_header(uint32_t seed)
+{
+    std::array<uint8_t, 32> merkleroot {};
+    memcpy(merkleroot.data(), &seed, 4);
+    return HeaderGenerator({}, merkleroot, TargetV1(1e300), 0).serialize(1);
+}
+
+uint64_t hash_sha256d(Header h, const std::atomic<bool>& stop)
+{
+    uint64_t n { 0 };
+    while (!stop.load(std::memory_order_relaxed)) {
+        auto [solved, exhausted, tries] = mine(h, 0, 10000);
+        n += tries;
+        if (exhausted)
+            h.set_nonce(1);
+    }
+    return n;
+}
+
+uint64_t hash_verus(Header h, const std::atomic<bool>& stop)
+{
+    const HeaderMidstate midstate(h);
+    uint64_t n { 0 };
+    uint8_t sink { 0 };
+    while (!stop.load(std::memory_order_relaxed)) {
+        for (size_t i = 0; i < 100; ++i)
+            sink ^= midstate.verus_hash(uint32_t(n++))[0];
+    }
+    static volatile uint8_t keep;
+    keep = sink;
+    return n;
+}
+
+// hashes per second of nThreads threads each running hash on its own header
+double measure(size_t nThreads, seconds d, const ThreadPinning& pinning,
+    uint64_t (*hash)(Header, const std::atomic<bool>&))
+{
+    std::atomic<bool> stop { false };
+    std::vector<uint64_t> hashes(nThreads);
+    const auto begin { steady_clock::now() };
+    {
+        std::vector<std::jthread> threads;
+        for (size_t i = 0; i < nThreads; ++i)
+            threads.emplace_back([&, i] {
+                pinning.pin(i);
+                hashes[i] = hash(synthetic_header(uint32_t(i)), stop);
+            });
+        std::this_thread::sleep_for(d);
+        stop = true;
+    }
+    const double elapsed { duration<double>(steady_clock::now() - begin).count() };
+    uint64_t sum { 0 };
+    for (auto n : hashes)
+        sum += n;
+    return sum / elapsed;
+}
+
+// 1, 2, 4, ... and the number of logical CPUs
+std::vector<size_t> thread_counts()
+{
+    const size_t cpus { std::max(1u, std::thread::hardware_concurrency()) };
+    std::vector<size_t> v;
+    for (size_t n = 1; n < cpus; n *= 2)
+        v.push_back(n);
+    v.push_back(cpus);
+    return v;
+}
+
+void log_rate(std::string_view what, double rate)
+{
+    auto [hr, unit] = format_hashrate(size_t(rate));
+    spdlog::info("{}: {:.2f} {}/s", what, hr, unit);
+}
+}
+
+int run_benchmark(uint32_t secs, bool pin, bool gpu, std::string gpus)
+{
+    const seconds d(secs);
+    ThreadPinning pinning(pin);
+    spdlog::info("Benchmarking CPU mining, {} seconds per configuration.", secs);
+    CpuTuning best;
+    double bestRate { 0 };
+    for (size_t n : thread_counts()) {
+        auto rate { measure(n, d, pinning, hash_sha256d) };
+        log_rate(spdlog::fmt_lib::format("{} threads", n), rate);
+        if (rate > bestRate) {
+            bestRate = rate;
+            best.threads = n;
+        }
+    }
+
+    spdlog::info("Benchmarking verushash with {} threads.", best.threads);
+    double verusRate[2] { 0, 0 }; // optimized, portable
+    if (Verus::can_optimize()) {
+        verusRate[0] = measure(best.threads, d, pinning, hash_verus);
+        log_rate("optimized verushash", verusRate[0]);
+    } else {
+        spdlog::info("Optimized verushash is not supported by this CPU.");
+    }
+    Verus::use_portable(true);
+    verusRate[1] = measure(best.threads, d, pinning, hash_verus);
+    Verus::use_portable(false);
+    log_rate("portable verushash", verusRate[1]);
+    best.portableVerus = verusRate[1] > verusRate[0];
+
+    spdlog::info("Best CPU configuration: {} threads, {} verushash.",
+        best.threads, best.portableVerus ? "portable" : "optimized");
+    save_cpu_tuning(best);
+    spdlog::info("CPU configuration saved to cpu_tuning.json.");
+    if (gpu)
+        return start_gpu_benchmark(gpus);
+    return 0;
+}
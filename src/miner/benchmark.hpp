@@ -0,0 +1,11 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Offline benchmark (--benchmark), no node is needed. CPU mining of a
+// synthetic header that no nonce solves is timed for doubling thread
+// counts, then the verushash rate of the Janushash verifier with the
+// optimized and the portable implementation. The best CPU configuration
+// is saved to cpu_tuning.json and used by later runs without --threads.
+// With gpu the selected GPUs are tuned again and saved to gpu_tuning.json.
+int run_benchmark(uint32_t seconds, bool pin, bool gpu, std::string gpus);
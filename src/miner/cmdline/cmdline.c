@@ -36,10 +36,12 @@ const char *gengetopt_args_info_description = "";
 const char *gengetopt_args_info_help[] = {
   "      --help                   Print help and exit",
   "  -V, --version                Print version and exit",
-  "  -a, --address=WALLETADDRESS  Specify address that is mined to",
+  "  -a, --address=WALLETADDRESS  Specify address that is mined to, required\n                                 unless --benchmark is given",
   "      --gpu                    Use GPUs for mining. Select specific GPUs with\n                                 the \"--gpus=\" option. By default CPU is used",
   "      --gpus=STRING            Specify GPUs as comma separated list like\n                                 \"0,2,3\". Only applicable for GPU mining. By\n                                 default all GPUs are used.",
-  "  -t, --threads=INT            Number of CPU worker threads, use 0 for number\n                                 of cores. Only applicable for CPU mining.\n                                 (default=`0')",
+  "  -t, --threads=INT            Number of CPU worker threads, use 0 for number\n                                 of cores. With --gpu the CPU threads verify\n                                 the Janushash candidates of the GPUs.\n                                 (default=`0')",
+  "      --pin                    Pin CPU threads to cores, SMT siblings are only\n                                 used when all cores are busy.",
+  "      --benchmark[=SECONDS]    Benchmark offline without a node and save the\n                                 best configuration, each configuration is\n                                 mined for SECONDS seconds.  (default=`5')",
   "  -h, --host=STRING            Host (RPC-Node)  (default=`localhost')",
   "  -p, --port=INT               Port (RPC-Node)  (default=`3000')",
     0
@@ -74,6 +76,8 @@ void clear_given (struct gengetopt_args_info *args_info)
   args_info->gpu_given = 0 ;
   args_info->gpus_given = 0 ;
   args_info->threads_given = 0 ;
+  args_info->pin_given = 0 ;
+  args_info->benchmark_given = 0 ;
   args_info->host_given = 0 ;
   args_info->port_given = 0 ;
 }
@@ -88,6 +92,8 @@ void clear_args (struct gengetopt_args_info *args_info)
   args_info->gpus_orig = NULL;
   args_info->threads_arg = 0;
   args_info->threads_orig = NULL;
+  args_info->benchmark_arg = 5;
+  args_info->benchmark_orig = NULL;
   args_info->host_arg = gengetopt_strdup ("localhost");
   args_info->host_orig = NULL;
   args_info->port_arg = 3000;
@@ -106,8 +112,10 @@ void init_args_info(struct gengetopt_args_info *args_info)
   args_info->gpu_help = gengetopt_args_info_help[3] ;
   args_info->gpus_help = gengetopt_args_info_help[4] ;
   args_info->threads_help = gengetopt_args_info_help[5] ;
-  args_info->host_help = gengetopt_args_info_help[6] ;
-  args_info->port_help = gengetopt_args_info_help[7] ;
+  args_info->pin_help = gengetopt_args_info_help[6] ;
+  args_info->benchmark_help = gengetopt_args_info_help[7] ;
+  args_info->host_help = gengetopt_args_info_help[8] ;
+  args_info->port_help = gengetopt_args_info_help[9] ;
   
 }
 
@@ -202,6 +210,7 @@ cmdline_parser_release (struct gengetopt_args_info *args_info)
   free_string_field (&(args_info->gpus_arg));
   free_string_field (&(args_info->gpus_orig));
   free_string_field (&(args_info->threads_orig));
+  free_string_field (&(args_info->benchmark_orig));
   free_string_field (&(args_info->host_arg));
   free_string_field (&(args_info->host_orig));
   free_string_field (&(args_info->port_orig));
@@ -247,6 +256,10 @@ cmdline_parser_dump(FILE *outfile, struct gengetopt_args_info *args_info)
     write_into_file(outfile, "gpus", args_info->gpus_orig, 0);
   if (args_info->threads_given)
     write_into_file(outfile, "threads", args_info->threads_orig, 0);
+  if (args_info->pin_given)
+    write_into_file(outfile, "pin", 0, 0 );
+  if (args_info->benchmark_given)
+    write_into_file(outfile, "benchmark", args_info->benchmark_orig, 0);
   if (args_info->host_given)
     write_into_file(outfile, "host", args_info->host_orig, 0);
   if (args_info->port_given)
@@ -366,12 +379,8 @@ cmdline_parser_required2 (struct gengetopt_args_info *args_info, const char *pro
   int error_occurred = 0;
   FIX_UNUSED (additional_error);
 
-  /* checks for required options */
-  if (! args_info->address_given)
-    {
-      fprintf (stderr, "%s: '--address' ('-a') option required%s\n", prog_name, (additional_error ? additional_error : ""));
-      error_occurred = 1;
-    }
+  FIX_UNUSED (args_info);
+  FIX_UNUSED (prog_name);
   
   
   /* checks for dependences among options */
@@ -541,6 +550,8 @@ cmdline_parser_internal (
         { "gpu",	0, NULL, 0 },
         { "gpus",	1, NULL, 0 },
         { "threads",	1, NULL, 't' },
+        { "pin",	0, NULL, 0 },
+        { "benchmark",	2, NULL, 0 },
         { "host",	1, NULL, 'h' },
         { "port",	1, NULL, 'p' },
         { 0,  0, 0, 0 }
@@ -557,7 +568,7 @@ cmdline_parser_internal (
           cmdline_parser_free (&local_args_info);
           exit (EXIT_SUCCESS);
 
-        case 'a':	/* Specify address that is mined to.  */
+        case 'a':	/* Specify address that is mined to, required unless --benchmark is given.  */
         
         
           if (update_arg( (void *)&(args_info->address_arg), 
@@ -569,7 +580,7 @@ cmdline_parser_internal (
             goto failure;
         
           break;
-        case 't':	/* Number of CPU worker threads, use 0 for number of cores. Only applicable for CPU mining..  */
+        case 't':	/* Number of CPU worker threads, use 0 for number of cores. With --gpu the CPU threads verify the Janushash candidates of the GPUs..  */
         
         
           if (update_arg( (void *)&(args_info->threads_arg), 
@@ -640,6 +651,34 @@ cmdline_parser_internal (
                 additional_error))
               goto failure;
           
+          }
+          /* Pin CPU threads to cores, SMT siblings are only used when all cores are busy..  */
+          else if (strcmp (long_options[option_index].name, "pin") == 0)
+          {
+          
+          
+            if (update_arg( 0 , 
+                 0 , &(args_info->pin_given),
+                &(local_args_info.pin_given), optarg, 0, 0, ARG_NO,
+                check_ambiguity, override, 0, 0,
+                "pin", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Benchmark offline without a node and save the best configuration, each configuration is mined for SECONDS seconds..  */
+          else if (strcmp (long_options[option_index].name, "benchmark") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->benchmark_arg), 
+                 &(args_info->benchmark_orig), &(args_info->benchmark_given),
+                &(local_args_info.benchmark_given), optarg, 0, "5", ARG_INT,
+                check_ambiguity, override, 0, 0,
+                "benchmark", '-',
+                additional_error))
+              goto failure;
+          
           }
           
           break;
@@ -39,16 +39,20 @@ struct gengetopt_args_info
 {
   const char *help_help; /**< @brief Print help and exit help description.  */
   const char *version_help; /**< @brief Print version and exit help description.  */
-  char * address_arg;	/**< @brief Specify address that is mined to.  */
-  char * address_orig;	/**< @brief Specify address that is mined to original value given at command line.  */
-  const char *address_help; /**< @brief Specify address that is mined to help description.  */
+  char * address_arg;	/**< @brief Specify address that is mined to, required unless --benchmark is given.  */
+  char * address_orig;	/**< @brief Specify address that is mined to, required unless --benchmark is given original value given at command line.  */
+  const char *address_help; /**< @brief Specify address that is mined to, required unless --benchmark is given help description.  */
   const char *gpu_help; /**< @brief Use GPUs for mining. Select specific GPUs with the \"--gpus=\" option. By default CPU is used help description.  */
   char * gpus_arg;	/**< @brief Specify GPUs as comma separated list like \"0,2,3\". Only applicable for GPU mining. By default all GPUs are used..  */
   char * gpus_orig;	/**< @brief Specify GPUs as comma separated list like \"0,2,3\". Only applicable for GPU mining. By default all GPUs are used. original value given at command line.  */
   const char *gpus_help; /**< @brief Specify GPUs as comma separated list like \"0,2,3\". Only applicable for GPU mining. By default all GPUs are used. help description.  */
-  int threads_arg;	/**< @brief Number of CPU worker threads, use 0 for number of cores. Only applicable for CPU mining. (default='0').  */
-  char * threads_orig;	/**< @brief Number of CPU worker threads, use 0 for number of cores. Only applicable for CPU mining. original value given at command line.  */
-  const char *threads_help; /**< @brief Number of CPU worker threads, use 0 for number of cores. Only applicable for CPU mining. help description.  */
+  int threads_arg;	/**< @brief Number of CPU worker threads, use 0 for number of cores. With --gpu the CPU threads verify the Janushash candidates of the GPUs. (default='0').  */
+  char * threads_orig;	/**< @brief Number of CPU worker threads, use 0 for number of cores. With --gpu the CPU threads verify the Janushash candidates of the GPUs. original value given at command line.  */
+  const char *threads_help; /**< @brief Number of CPU worker threads, use 0 for number of cores. With --gpu the CPU threads verify the Janushash candidates of the GPUs. help description.  */
+  const char *pin_help; /**< @brief Pin CPU threads to cores, SMT siblings are only used when all cores are busy help description.  */
+  int benchmark_arg;	/**< @brief Benchmark offline without a node and save the best configuration, each configuration is mined for SECONDS seconds. (default='5').  */
+  char * benchmark_orig;	/**< @brief Benchmark offline without a node and save the best configuration, each configuration is mined for SECONDS seconds. original value given at command line.  */
+  const char *benchmark_help; /**< @brief Benchmark offline without a node and save the best configuration, each configuration is mined for SECONDS seconds. help description.  */
   char * host_arg;	/**< @brief Host (RPC-Node) (default='localhost').  */
   char * host_orig;	/**< @brief Host (RPC-Node) original value given at command line.  */
   const char *host_help; /**< @brief Host (RPC-Node) help description.  */
@@ -62,6 +66,8 @@ struct gengetopt_args_info
   unsigned int gpu_given ;	/**< @brief Whether gpu was given.  */
   unsigned int gpus_given ;	/**< @brief Whether gpus was given.  */
   unsigned int threads_given ;	/**< @brief Whether threads was given.  */
+  unsigned int pin_given ;	/**< @brief Whether pin was given.  */
+  unsigned int benchmark_given ;	/**< @brief Whether benchmark was given.  */
   unsigned int host_given ;	/**< @brief Whether host was given.  */
   unsigned int port_given ;	/**< @brief Whether port was given.  */
 
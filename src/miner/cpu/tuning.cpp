@@ -0,0 +1,36 @@
+#include "tuning.hpp"
+#include "nlohmann/json.hpp"
+#include "spdlog/spdlog.h"
+#include <fstream>
+
+namespace {
+constexpr const char* cacheFile { "cpu_tuning.json" };
+}
+
+std::optional<CpuTuning> load_cpu_tuning()
+{
+    std::ifstream f(cacheFile);
+    if (!f)
+        return {};
+    auto j { nlohmann::json::parse(f, nullptr, false) };
+    try {
+        return CpuTuning {
+            .threads = j.at("threads").get<uint32_t>(),
+            .portableVerus = j.at("portableVerus").get<bool>()
+        };
+    } catch (nlohmann::json::exception&) {
+        spdlog::warn("Ignoring malformed {}.", cacheFile);
+        return {};
+    }
+}
+
+void save_cpu_tuning(const CpuTuning& t)
+{
+    nlohmann::json j {
+        { "threads", t.threads },
+        { "portableVerus", t.portableVerus }
+    };
+    std::ofstream f(cacheFile);
+    if (!(f << j.dump(1)))
+        spdlog::warn("Cannot write {}.", cacheFile);
+}
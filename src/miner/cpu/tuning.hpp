@@ -0,0 +1,12 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+
+// best CPU configuration found by --benchmark, cached in cpu_tuning.json
+struct CpuTuning {
+    uint32_t threads { 0 };
+    bool portableVerus { false }; // portable verushash was faster
+};
+
+std::optional<CpuTuning> load_cpu_tuning();
+void save_cpu_tuning(const CpuTuning&);
@@ -1,4 +1,5 @@
 #include "worker.hpp"
+#include "affinity.hpp"
 #include "block/body/view.hpp"
 #include "helpers.hpp"
 #include "mine.hpp"
@@ -10,48 +11,55 @@ void PoolInterface::on_mined(Block mt)
     pool.on_mined(mt);
 };
 
+const ThreadPinning& PoolInterface::pinning()
+{
+    return pool.pinning;
+}
+
 void Worker::work()
 {
+    pool.pinning().pin(index);
     std::optional<uint32_t> startnonce;
     std::optional<Workertask> task;
+    uint32_t seed { 0 };
+    uint64_t seenEpoch { ~uint64_t(0) };
     while (true) {
-        {
+        if (epoch.load(std::memory_order_acquire) != seenEpoch) {
             std::unique_lock l(m);
-            while (!wakeup && sleep) {
+            while (sleep && !shutdown)
                 cv.wait(l);
-            }
-            wakeup = false;
-            if (newTask) {
-                newTask = false;
-                task = workerTask;
-                startnonce.reset();
-            }
             if (shutdown)
                 break;
-            if (sleep)
-                continue;
+            seenEpoch = epoch.load(std::memory_order_relaxed);
+            task = workerTask;
+            seed = task->seedBase + uint32_t(index);
+            startnonce.reset();
         }
 
         if (!startnonce.has_value()) {
             startnonce = randuint32();
-            uint32_t i = (*task->seeds)++;
-            memcpy(task->b.body.data().data(), &i, 4);
+            memcpy(task->b.body.data().data(), &seed, 4);
             BodyView bv(task->b.body.view());
-            task->b.header.set_merkleroot(bv.merkleRoot());
+            task->b.header.set_merkleroot(bv.merkleRoot(task->b.height));
             task->b.header.set_nonce(*startnonce);
         }
 
         auto [solved, exhausted, tries] = mine(task->b.header, *startnonce, 10000);
+        hashes.store(hashes.load(std::memory_order_relaxed) + tries, std::memory_order_relaxed);
         if (solved) {
             {
+                // solved block wait for next work unless it arrived already
                 std::unique_lock l(m);
-                sleep = true; // solved block wait for next work
+                if (epoch.load(std::memory_order_relaxed) == seenEpoch) {
+                    sleep = true;
+                    epoch.fetch_add(1, std::memory_order_relaxed);
+                }
             }
             pool.on_mined(task->b);
         }
-        if (exhausted) {
+        if (exhausted) { // roll over to the next seed of our partition
+            seed += uint32_t(nWorkers);
             startnonce.reset();
         }
-        sumhashes += tries;
     }
 }
@@ -6,27 +6,29 @@
 #include <mutex>
 #include <thread>
 
+// The 4 byte seed at the start of the body (extranonce) partitions the
+// search space: worker i of n hashes the seeds seedBase + i + k * n, each
+// with the full 32 bit header nonce range, such that workers never share
+// a counter. The random seedBase separates miner processes.
 struct Workertask {
     Block b;
-    std::shared_ptr<std::atomic<uint32_t>> seeds;
-    Workertask(Block b)
-        : b(b)
-        , seeds(std::make_shared<std::atomic<uint32_t>>(0))
-    {
-    }
+    uint32_t seedBase;
 };
 class Workerpool;
+class ThreadPinning;
 struct PoolInterface {
     void on_mined(Block mt);
-    uint32_t next_seed();
+    const ThreadPinning& pinning();
     Workerpool& pool;
 };
 
 class Worker {
 
 public:
-    Worker(PoolInterface pool)
-        : pool(pool)
+    Worker(PoolInterface pool, size_t index, size_t nWorkers)
+        : index(index)
+        , nWorkers(nWorkers)
+        , pool(pool)
     {
         std::thread t2(&Worker::work, this);
         t.swap(t2);
@@ -41,23 +43,22 @@ public:
     {
         std::unique_lock l(m);
         sleep = true;
-        wakeup = true;
+        epoch.fetch_add(1, std::memory_order_release);
         cv.notify_one();
     }
     void set_work(Workertask t)
     {
         std::unique_lock l(m);
-        wakeup = true;
         sleep = false;
-        newTask = true;
         workerTask = std::move(t);
+        epoch.fetch_add(1, std::memory_order_release);
         cv.notify_one();
     }
     [[nodiscard]] size_t update_hashes()
     {
-        size_t tmp { hash_snapshot };
-        size_t out = sumhashes - tmp;
-        sumhashes = tmp;
+        const uint64_t total { hashes.load(std::memory_order_relaxed) };
+        size_t out = total - hash_snapshot;
+        hash_snapshot = total;
         return out;
     }
 
@@ -68,25 +69,29 @@ private:
     uint64_t hash_snapshot { 0 };
 
     // worker thread owned
+    const size_t index;
+    const size_t nWorkers;
 
-    // mutex protected
+    // mutex protected, changes bump the epoch
     std::mutex m;
     std::optional<Workertask> workerTask;
-    bool newTask;
-    bool wakeup = false;
     bool shutdown = false;
     bool sleep = true;
 
-    // shared atomic
-    std::atomic<uint64_t> sumhashes { 0 };
-
     std::condition_variable cv;
     PoolInterface pool;
+
+    // The hashing loop only polls the epoch and takes the mutex when it
+    // changed. The hash counter is only written by the worker thread and
+    // sits on its own cache line (the last one of the object) such that
+    // polling it does not slow down the worker.
+    alignas(64) std::atomic<uint64_t> epoch { 0 };
+    alignas(64) std::atomic<uint64_t> hashes { 0 };
     void terminate()
     {
         std::unique_lock l(m);
         shutdown = true;
-        wakeup = true;
+        epoch.fetch_add(1, std::memory_order_release);
         cv.notify_one();
     }
     void work();
@@ -1,11 +1,13 @@
 #pragma once
 
+#include "affinity.hpp"
 #include "api_call.hpp"
 #include "crypto/address.hpp"
 #include "general/hex.hpp"
 #include "spdlog/fmt//fmt.h"
 #include "helpers.hpp"
 #include "spdlog/spdlog.h"
+#include "task_watcher.hpp"
 #include "worker.hpp"
 #include <cassert>
 #include <chrono>
@@ -39,12 +41,14 @@ class Workerpool {
     };
 
 public:
-    Workerpool(const Address& address, size_t threadnum, std::string host = "localhost", uint16_t port = 3000)
-        : address(address)
+    Workerpool(const Address& address, size_t threadnum, std::string host = "localhost", uint16_t port = 3000, bool pin = false)
+        : pinning(pin)
+        , address(address)
         , api(host, port)
+        , watcher(address, host, port, [this](Block&& b) { on_task(std::move(b)); })
     {
         for (size_t i = 0; i < threadnum; ++i) {
-            workers.emplace_back(new Worker({ *this }));
+            workers.emplace_back(new Worker({ *this }, i, threadnum));
         }
     };
 
@@ -58,8 +62,10 @@ private:
     bool wakeup = false;
     bool _shutdown = false;
     std::list<Block> mined;
+    std::optional<Block> pushedTask;
 
     size_t minedcount = 0;
+    ThreadPinning pinning;
     Address address;
     std::vector<std::unique_ptr<Worker>> workers;
 
@@ -81,6 +87,20 @@ private:
         wakeup = true;
         cv.notify_one();
     }
+    void on_task(Block&& b)
+    {
+        std::unique_lock l(m);
+        pushedTask = std::move(b);
+        wakeup = true;
+        cv.notify_one();
+    }
+    void set_work(const Block& b)
+    {
+        currentMiningTask = Workertask { b, randuint32() };
+        for (auto& w : workers) {
+            w->set_work(*currentMiningTask);
+        }
+    }
 
 public:
     void report_hashrate()
@@ -100,7 +120,6 @@ public:
         constexpr seconds report_interval{5};
 
         bool updateMining = true;
-        time_point<steady_clock> until;
         time_point<steady_clock> report_time { steady_clock::now()  + report_interval};
         while (true) {
             if (steady_clock::now() > report_time) { // report hashrate
@@ -108,20 +127,19 @@ public:
                 report_hashrate();
             }
 
-            bool expired { steady_clock::now() > until };
-            if (updateMining || expired) {
-                until = steady_clock::now() + milliseconds(700);
+            if (updateMining) {
                 updateMining = false;
-                currentMiningTask = Workertask { api.get_mining(address) };
-                for (auto& w : workers) {
-                    w->set_work(*currentMiningTask);
-                }
+                set_work(api.get_mining(address));
             }
             std::unique_lock l(m);
-            while (!wakeup && steady_clock::now() < until) {
-                cv.wait_until(l, until);
+            while (!wakeup && steady_clock::now() < report_time) {
+                cv.wait_until(l, report_time);
             }
             wakeup = false;
+            if (pushedTask) { // new task pushed by the node
+                set_work(*pushedTask);
+                pushedTask.reset();
+            }
             if (_shutdown) {
                 workers.clear();
                 break;
@@ -150,4 +168,5 @@ public:
         }
     }
     API api;
+    TaskWatcher watcher;
 };
@@ -0,0 +1,81 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+// Bounded lock-free multi-producer multi-consumer queue (Vyukov). Every
+// cell carries a sequence number telling producers and consumers whether
+// it is free for the current lap, such that push and pop need a single
+// CAS on the respective index.
+template <typename T>
+class CandidateQueue {
+    struct Cell {
+        std::atomic<size_t> seq;
+        T value;
+    };
+
+public:
+    // capacity is rounded up to a power of two
+    CandidateQueue(size_t capacity)
+        : mask(std::bit_ceil(std::max(capacity, size_t(2))) - 1)
+        , cells(new Cell[mask + 1])
+    {
+        for (size_t i = 0; i <= mask; ++i)
+            cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+    CandidateQueue(const CandidateQueue&) = delete;
+
+    // returns false if the queue is full
+    bool try_push(T t)
+    {
+        size_t pos { head.load(std::memory_order_relaxed) };
+        while (true) {
+            auto& c { cells[pos & mask] };
+            const size_t seq { c.seq.load(std::memory_order_acquire) };
+            const auto diff { intptr_t(seq) - intptr_t(pos) };
+            if (diff == 0) {
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    c.value = std::move(t);
+                    c.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    std::optional<T> try_pop()
+    {
+        size_t pos { tail.load(std::memory_order_relaxed) };
+        while (true) {
+            auto& c { cells[pos & mask] };
+            const size_t seq { c.seq.load(std::memory_order_acquire) };
+            const auto diff { intptr_t(seq) - intptr_t(pos + 1) };
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    std::optional<T> res { std::move(c.value) };
+                    c.value = T {};
+                    c.seq.store(pos + mask + 1, std::memory_order_release);
+                    return res;
+                }
+            } else if (diff < 0) {
+                return {};
+            } else {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+    const size_t mask;
+    std::unique_ptr<Cell[]> cells;
+    alignas(64) std::atomic<size_t> head { 0 };
+    alignas(64) std::atomic<size_t> tail { 0 };
+};
@@ -89,6 +89,19 @@ public:
     read_to(b,&out,rawSize,true);
     return out;
   }
+  // the returned event completes when out is written, out must stay valid
+  // until then
+  template <typename T> [[nodiscard]] cl::Event read_async(const Buffer &b, T &out) {
+    assert(b.size() == sizeof(T));
+    cl::Event e;
+    enqueueReadBuffer(b, CL_FALSE, 0, sizeof(T), &out, nullptr, &e);
+    return e;
+  }
+  // in must stay valid until the write is executed
+  template <typename T> void write_async(const Buffer &b, const T &in) {
+    assert(b.size() == sizeof(T));
+    enqueueWriteBuffer(b, CL_FALSE, 0, sizeof(T), &in);
+  }
   template <typename T> [[nodiscard]] auto read_vector(const Buffer &b, bool blocking = true) {
     const size_t rawSize{b.size()};
     assert(rawSize % sizeof(T) == 0);
@@ -1,8 +1,14 @@
 #include "spdlog/spdlog.h"
 class Address;
 
-int start_gpu_miner(const Address&, std::string, uint16_t, std::string)
+int start_gpu_miner(const Address&, std::string, uint16_t, std::string, size_t, bool)
 {
     spdlog::error("Miner was compiled without GPU support. GPU mining not available.");
     return -1;
 }
+
+int start_gpu_benchmark(std::string)
+{
+    spdlog::error("Miner was compiled without GPU support. GPU benchmark not available.");
+    return -1;
+}
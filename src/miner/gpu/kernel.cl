@@ -97,3 +97,51 @@ void kernel mine(const global u32 *data76, global u32 *args, global u32 *hashes)
     }
   }
 }
+
+// Janushash prefilter: the sha256t part (sha256 of the double sha256 header
+// hash) is computed on the device, headers whose sha256t lies in
+// [janus_lower, janus_upper) are returned to the host which computes the
+// verushash part. Bounds are compared against the leading 64 bits of the
+// big endian hash. Every launch gets its own output buffer with the
+// candidate count in front such that launches can overlap.
+#define JANUS_SLOTS 1024
+volatile __global u64 janus_lower;
+volatile __global u64 janus_upper;
+
+void kernel set_janus_window(u64 lower, u64 upper) {
+  janus_lower = lower;
+  janus_upper = upper;
+}
+
+// job holds the sha256 state after the first header block and the header
+// words 16 to 18, only the last block is hashed per nonce
+void kernel mine_janus(const global u32 *job, global u32 *out) {
+  const u32 gid = get_global_id(0);
+
+  u32 buf[16] = {0};
+  for (int i = 0; i < 3; ++i)
+    buf[i] = job[8 + i];
+  buf[3] = gid;
+
+  sha256_ctx_t ctx;
+  sha256_init(&ctx);
+  for (int i = 0; i < 8; ++i)
+    ctx.h[i] = job[i];
+  ctx.len = 64;
+  sha256_update(&ctx, buf, 16);
+  sha256_final(&ctx);
+  for (int r = 0; r < 2; ++r) {
+    u32 a[16] = {0};
+    for (int i = 0; i < 8; ++i)
+      a[i] = ctx.h[i];
+    sha256_init(&ctx);
+    sha256_update(&ctx, a, 32);
+    sha256_final(&ctx);
+  }
+  const u64 prefix = ((u64)ctx.h[0] << 32) | ctx.h[1];
+  if (prefix >= janus_lower && prefix < janus_upper) {
+    u32 c = atomic_inc(&out[0]);
+    if (c < JANUS_SLOTS)
+      out[1 + c] = gid;
+  }
+}
@@ -1,21 +1,42 @@
 #pragma once
+#include "affinity.hpp"
 #include "api_call.hpp"
 #include "block/block.hpp"
 #include "block/header/difficulty.hpp"
 #include "block/header/header_impl.hpp"
+#include "candidate_queue.hpp"
 #include "crypto/address.hpp"
 #include "helpers.hpp"
+#include "task_watcher.hpp"
 #include "worker.hpp"
 #include <iostream>
 #include <vector>
+
+// sha256t ok, verushash pending
+struct JanusCandidate {
+    std::shared_ptr<const JanusJob> job;
+    uint64_t generation { 0 };
+    uint32_t nonce { 0 };
+};
+
 class DevicePool {
     friend class DeviceWorker;
 
 public:
-    DevicePool(const Address& address, const std::vector<CL::Device>& devices, std::string host, uint16_t port)
-        : address(address)
+    // with verifierThreads > 0 the devices only produce Janushash candidates
+    // which are verified by a shared set of CPU threads
+    DevicePool(const Address& address, const std::vector<CL::Device>& devices, std::string host, uint16_t port, size_t verifierThreads = 0, bool pin = false)
+        : pinning(pin && verifierThreads > 0)
+        , address(address)
         , api(host, port)
+        , watcher(address, host, port, [this](Block&& b) {
+            std::lock_guard l(m);
+            pushedTask = std::move(b);
+            wakeup_nolock();
+        })
     {
+        for (size_t i = 0; i < verifierThreads; ++i)
+            verifiers.emplace_back([this, i](std::stop_token st) { verify(st, i); });
         for (auto& d : devices) {
             workers.push_back(std::make_unique<DeviceWorker>(d, *this));
         }
@@ -25,6 +46,19 @@ public:
 
     }
     bool empty() const { return workers.empty(); }
+    bool hybrid() const { return !verifiers.empty(); }
+
+    // candidates which do not fit are dropped, they all have the same
+    // chance and the devices produce more than the CPU threads can verify
+    void push_candidates(const std::shared_ptr<const JanusJob>& job, uint64_t generation, std::span<const uint32_t> nonces)
+    {
+        for (auto n : nonces) {
+            if (!candidates.try_push({ job, generation, n })) {
+                dropped += 1;
+            }
+        }
+    }
+    uint64_t task_generation() const { return generation; }
 
     void notify_mined(const Block& b)
     {
@@ -43,6 +77,7 @@ public:
         if (task.has_value() && b.header == task->header)
             return;
         blockSeed = randuint32() % 20000;
+        generation += 1;
         task = b;
         for (auto& w : workers)
             w->set_block(b);
@@ -54,11 +89,11 @@ public:
         using namespace std::chrono;
 
         constexpr auto printInterval { 10s };
-        constexpr auto pollInterval { 500ms };
         auto nextPrint = steady_clock::now() + printInterval;
-        auto nextPoll = steady_clock::now() + pollInterval;
+        assign_work(api.get_mining(address));
         while (true) {
             decltype(minedBlock) tmpMined;
+            decltype(pushedTask) tmpPushed;
             {
                 std::unique_lock ul(m);
                 while (true) {
@@ -69,17 +104,16 @@ public:
                         print_hashrate();
                         nextPrint = steady_clock::now() + printInterval;
                     }
-                    if (steady_clock::now() >= nextPoll) {
-                        wakeup = true;
-                    }
                     if (wakeup) {
                         wakeup = false;
                         break;
                     }
-                    cv.wait_until(ul, std::min(nextPrint, nextPoll));
+                    cv.wait_until(ul, nextPrint);
                 }
                 tmpMined = minedBlock;
                 minedBlock.reset();
+                tmpPushed = std::move(pushedTask);
+                pushedTask.reset();
             }
             // did waked up
 
@@ -96,16 +130,39 @@ public:
                 }
                 submitted = true;
             }
-            if (submitted || steady_clock::now() >= nextPoll) {
-                nextPoll = steady_clock::now() + pollInterval;
-                auto block = api.get_mining(address);
-                assign_work(block);
+            if (submitted) {
+                assign_work(api.get_mining(address));
+            } else if (tmpPushed) { // new task pushed by the node
+                assign_work(*tmpPushed);
             }
         }
         std::cout << "End" << std::endl;
     }
 
 private:
+    void verify(std::stop_token st, size_t index)
+    {
+        using namespace std::chrono;
+        pinning.pin(index);
+        size_t idle { 0 };
+        while (!st.stop_requested()) {
+            auto c { candidates.try_pop() };
+            if (!c) {
+                std::this_thread::sleep_for(++idle < 100 ? microseconds(50) : milliseconds(1));
+                continue;
+            }
+            idle = 0;
+            if (c->generation != generation)
+                continue; // stale
+            const uint32_t nonce { hton32(c->nonce) };
+            verified += 1;
+            if (c->job->midstate.validPOW(nonce, c->job->block.height)) {
+                Block b { c->job->block };
+                b.header.set_nonce(nonce);
+                notify_mined(b);
+            }
+        }
+    }
     void print_hashrate()
     {
         std::vector<std::pair<std::string, uint64_t>> hashrates;
@@ -128,6 +185,13 @@ private:
             auto [val, unit] = format_hashrate(hr);
             spdlog::info("   {}: {} {}/s", name, val, unit);
         }
+        if (hybrid()) {
+            auto now { std::chrono::steady_clock::now() };
+            auto ms { std::max(std::chrono::duration_cast<std::chrono::milliseconds>(now - lastVerifyCheckpoint).count(), int64_t(1)) };
+            lastVerifyCheckpoint = now;
+            auto [val, unit] = format_hashrate(verified.exchange(0) * 1000 / ms);
+            spdlog::info("   CPU verushash ({} threads): {} {}/s, {} candidates dropped", verifiers.size(), val, unit, dropped.exchange(0));
+        }
     }
     void wakeup_nolock()
     {
@@ -139,11 +203,21 @@ private:
     bool wakeup { false };
     std::atomic<bool> shutdown { false };
     std::optional<Block> minedBlock;
+    std::optional<Block> pushedTask;
 
     std::atomic_int64_t blockSeed { 0 };
     uint64_t minedcount { 0 };
     std::optional<Block> task;
+    std::atomic<uint64_t> generation { 0 }; // incremented on new task
+
+    CandidateQueue<JanusCandidate> candidates { 1 << 16 };
+    std::atomic<uint64_t> verified { 0 };
+    std::atomic<uint64_t> dropped { 0 };
+    std::chrono::steady_clock::time_point lastVerifyCheckpoint { std::chrono::steady_clock::now() };
     std::vector<std::unique_ptr<DeviceWorker>> workers;
+    ThreadPinning pinning;
+    std::vector<std::jthread> verifiers; // destroyed before the queue
     Address address;
     API api;
+    TaskWatcher watcher;
 };
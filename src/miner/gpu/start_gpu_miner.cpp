@@ -62,15 +62,13 @@ auto read_file(std::string path)
     return s;
 }
 
-int start_gpu_miner(const Address& address, std::string host, uint16_t port, std::string gpus)
+// devices of the --gpus list, empty if there are none
+std::vector<CL::Device> select_devices(std::string gpus)
 {
-    srand(time(0));
-
-    using namespace std::chrono;
     auto gpu_devices { all_gpu_devices() };
     if (gpu_devices.empty()) {
         std::cerr << "No GPUs detected. Check OpenCL installation!\n";
-        return -1;
+        return {};
     }
     cout << "OpenCL installations for the following GPUs were detected:\n";
     for (size_t i = 0; i < gpu_devices.size(); ++i) {
@@ -92,12 +90,37 @@ int start_gpu_miner(const Address& address, std::string host, uint16_t port, std
             dv.push_back(d);
             cout << "[" << i << "]: " << d.name() << endl;
         }
-        if (dv.size() == 0) {
+        if (dv.size() == 0)
             spdlog::error("No GPUs selected.");
-            return -1;
-        }
     }
+    return dv;
+}
+
+int start_gpu_miner(const Address& address, std::string host, uint16_t port, std::string gpus, size_t verifierThreads, bool pin)
+{
+    srand(time(0));
 
-    DevicePool(address, dv, host, port).run();
+    using namespace std::chrono;
+    auto dv { select_devices(gpus) };
+    if (dv.empty())
+        return -1;
+
+    if (verifierThreads > 0)
+        spdlog::info("Hybrid mining: Janushash candidates are verified by {} CPU threads.", verifierThreads);
+    DevicePool(address, dv, host, port, verifierThreads, pin).run();
+    return 0;
+}
+
+int start_gpu_benchmark(std::string gpus)
+{
+    auto dv { select_devices(gpus) };
+    if (dv.empty())
+        return -1;
+    for (auto& d : dv) {
+        const std::string name { d.name() };
+        spdlog::info("Benchmarking {}.", name);
+        save_tuning(name, DeviceWorker::autotune(d, name));
+    }
+    spdlog::info("GPU configurations saved to gpu_tuning.json.");
     return 0;
 }
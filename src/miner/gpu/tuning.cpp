@@ -0,0 +1,51 @@
+#include "tuning.hpp"
+#include "nlohmann/json.hpp"
+#include "spdlog/spdlog.h"
+#include <fstream>
+
+namespace {
+constexpr const char* cacheFile { "gpu_tuning.json" };
+
+nlohmann::json read_cache()
+{
+    std::ifstream f(cacheFile);
+    if (!f)
+        return nlohmann::json::object();
+    auto j { nlohmann::json::parse(f, nullptr, false) };
+    if (!j.is_object()) {
+        spdlog::warn("Ignoring malformed {}.", cacheFile);
+        return nlohmann::json::object();
+    }
+    return j;
+}
+}
+
+std::optional<GpuTuning> load_tuning(const std::string& deviceName)
+{
+    auto j { read_cache() };
+    auto iter { j.find(deviceName) };
+    if (iter == j.end())
+        return {};
+    try {
+        return GpuTuning {
+            .vectSize = iter->at("vectSize").get<uint32_t>(),
+            .localSize = iter->at("localSize").get<uint32_t>(),
+            .hashesPerStep = iter->at("hashesPerStep").get<uint32_t>()
+        };
+    } catch (nlohmann::json::exception&) {
+        return {};
+    }
+}
+
+void save_tuning(const std::string& deviceName, const GpuTuning& t)
+{
+    auto j { read_cache() };
+    j[deviceName] = {
+        { "vectSize", t.vectSize },
+        { "localSize", t.localSize },
+        { "hashesPerStep", t.hashesPerStep }
+    };
+    std::ofstream f(cacheFile);
+    if (!(f << j.dump(1)))
+        spdlog::warn("Cannot write {}.", cacheFile);
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <string>
+
+// launch configuration of a device, found by the autotuner of DeviceWorker
+struct GpuTuning {
+    uint32_t vectSize { 2 }; // VECT_SIZE of the kernel build
+    uint32_t localSize { 0 }; // 0: chosen by the driver
+    uint32_t hashesPerStep { 1 };
+};
+
+// tuning results are cached per device name in gpu_tuning.json
+std::optional<GpuTuning> load_tuning(const std::string& deviceName);
+void save_tuning(const std::string& deviceName, const GpuTuning&);
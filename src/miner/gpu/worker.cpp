@@ -5,8 +5,29 @@
 #include "helpers.hpp"
 #include "pool.hpp"
 #include "block/body/view.hpp"
+#include "block/header/custom_float.hpp"
+#include "general/params.hpp"
 #include <iostream>
 
+namespace {
+// leading 64 bits of the hash at which CustomFloat(hash) reaches f < 1
+uint64_t hash_prefix(CustomFloat f)
+{
+    assert(f.exponent() <= 0 && f.exponent() >= -32);
+    return uint64_t(f.mantissa()) << (32 + f.exponent());
+}
+
+// sha256t values worth a verushash evaluation: smaller ones are rejected
+// since JANUSV5, larger ones than the clamp value of JANUSV6 lower the
+// chance of the hash product
+std::pair<uint64_t, uint64_t> janus_window(NonzeroHeight height)
+{
+    constexpr CustomFloat lower(-9, 3306097748); // 0.0015034391929775724
+    constexpr CustomFloat upper(-7, 2748779069); // 0.005
+    return { height.value() > JANUSV5RETARGETSTART ? hash_prefix(lower) : 0, hash_prefix(upper) };
+}
+}
+
 void DeviceWorker::init_mining(MinerDevice& miner)
 {
     hashesTried = 0;
@@ -17,11 +38,35 @@ void DeviceWorker::init_mining(MinerDevice& miner)
     BodyView bv(b.body.view());
 
     randOffset = randuint32();
-    b.header.set_merkleroot(bv.merkleRoot());
+    b.header.set_merkleroot(bv.merkleRoot(b.height));
 
     std::span<uint8_t,76> c(b.header.data(),b.header.data()+76);
     miner.set_block_header(c);
-    miner.set_target(b.header.target_v1().binary());
+    janus = HeaderView::uses_verushash(b.height);
+    if (janus) {
+        auto [lower, upper] { janus_window(b.height) };
+        miner.set_janus_window(lower, upper);
+        janusTask = { std::make_shared<const JanusJob>(b), pool.task_generation() };
+        miner.set_janus_job(janusTask.job->midstate);
+    } else {
+        miner.set_target(b.header.target_v1().binary());
+    }
+}
+
+void DeviceWorker::verify_candidates(const JanusTask& t, std::span<const uint32_t> nonces)
+{
+    if (pool.hybrid()) {
+        pool.push_candidates(t.job, t.generation, nonces);
+        return;
+    }
+    for (auto n : nonces) {
+        if (t.job->midstate.validPOW(hton32(n), t.job->block.height)) {
+            Block b { t.job->block };
+            b.header.set_nonce(hton32(n));
+            notify_mined(b);
+            return;
+        }
+    }
 }
 
 void DeviceWorker::notify_mined(const Block& b)
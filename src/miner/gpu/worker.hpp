@@ -1,31 +1,53 @@
 #pragma once
 #include "block/block.hpp"
+#include "block/header/midstate.hpp"
 #include "cl_function.hxx"
 #include "cl_helper.hpp"
 #include "general/hex.hpp"
+#include "general/reader.hpp"
 #include "kernel.hpp"
 #include "spdlog/spdlog.h"
+#include "tuning.hpp"
 #include <arpa/inet.h>
 #include <condition_variable>
+#include <deque>
 #include <iostream>
+#include <memory>
 #include <optional>
 #include <span>
 #include <thread>
 class MinerDevice {
     static constexpr size_t numSlots = 8;
+
+public:
+    static constexpr size_t janusSlots = 1024; // JANUS_SLOTS in kernel.cl
+    static constexpr size_t janusDepth = 3; // Janushash ranges in flight
+
+private:
+    // sha256 midstate of the header followed by the big endian words of
+    // header bytes 64 to 75, the kernel appends the nonce
+    using JanusJobData = std::array<uint32_t, 11>;
+    struct JanusRange {
+        JanusJobData header;
+        std::array<uint32_t, janusSlots + 1> result; // count, nonces
+        CL::Buffer headerBuffer;
+        CL::Buffer resultBuffer;
+        cl::Event read;
+    };
+
     static cl::Program::Sources fetch_sources()
     {
         std::string code { kernel, sizeof(kernel) };
         // auto code{read_file("kernel.cl")};
         return cl::Program::Sources { { code.data(), code.size() } };
     };
-    auto build_program(cl::Context context)
+    auto build_program(cl::Context context, uint32_t vectSize)
     {
         cl::Program program(context, fetch_sources());
         try {
             program.build(
-                "-cl-std=CL2.0 -DVECT_SIZE=2 -DDGST_R0=3 -DDGST_R1=7 -DDGST_R2=2 "
-                "-DDGST_R3=6 -DDGST_ELEM=8 -DKERNEL_STATIC");
+                ("-cl-std=CL2.0 -DVECT_SIZE=" + std::to_string(vectSize) + " -DDGST_R0=3 -DDGST_R1=7 -DDGST_R2=2 "
+                 "-DDGST_R3=6 -DDGST_ELEM=8 -DKERNEL_STATIC").c_str());
             return program;
         } catch (cl::BuildError& e) {
             auto logs { e.getBuildLog() };
@@ -39,13 +61,23 @@ class MinerDevice {
     }
 
 public:
-    MinerDevice(cl::Device device)
-        : context({ device })
-        , program(build_program(context))
+    MinerDevice(cl::Device device, const GpuTuning& tuning = {})
+        : localSize(tuning.localSize)
+        , context({ device })
+        , program(build_program(context, tuning.vectSize))
         , queue(context, device)
         , reset_counter_fun(program, "reset_counter")
         , set_target_fun(program, "set_target")
-        , mine_fun(program, "mine") {};
+        , mine_fun(program, "mine")
+        , set_janus_window_fun(program, "set_janus_window")
+        , mine_janus_fun(program, "mine_janus")
+    {
+        for (auto& r : janusRanges) {
+            r.headerBuffer = CL::Buffer(context, CL_MEM_READ_ONLY, sizeof(r.header));
+            r.resultBuffer = CL::Buffer(context, CL_MEM_READ_WRITE, sizeof(r.result));
+        }
+    };
+    void set_local_size(uint32_t n) { localSize = n; }
     void set_block_header(std::span<uint8_t, 76> h)
     {
         memcpy(blockHeader.data(), h.data(), h.size());
@@ -60,9 +92,54 @@ public:
     {
         cl::EnqueueArgs eargs(queue,
             offset == 0 ? cl::NullRange : cl::NDRange(offset),
-            cl::NDRange(nHashes), cl::NullRange);
+            cl::NDRange(nHashes), local_range());
         return mine_fun.run(queue, eargs, blockHeader);
     }
+    // sha256t prefix bounds of returned Janushash candidates
+    void set_janus_window(uint64_t lower, uint64_t upper)
+    {
+        cl::EnqueueArgs nd1(queue, cl::NDRange(1));
+        set_janus_window_fun.run(queue, nd1, lower, upper);
+    }
+
+    // Janushash ranges are pipelined: up to janusDepth ranges are enqueued
+    // with their own copy of the current block header and their own result
+    // buffer, such that the device continues with the next range while the
+    // host reads and verifies the candidates of the previous one. A new
+    // block header takes effect at the next enqueued range.
+    size_t janus_pending() const { return janusPending; }
+    void set_janus_job(const HeaderMidstate& m)
+    {
+        std::copy(m.sha256().state().begin(), m.sha256().state().end(), janusJob.begin());
+        for (size_t i = 0; i < 3; ++i)
+            janusJob[8 + i] = readuint32(blockHeader.data() + 64 + 4 * i);
+    }
+    void enqueue_janus(uint32_t nHashes, uint32_t offset)
+    {
+        assert(janusPending < janusDepth);
+        auto& r { janusRanges[(janusHead + janusPending) % janusDepth] };
+        r.header = janusJob;
+        queue.write_async(r.headerBuffer, r.header);
+        queue.enqueueFillBuffer(r.resultBuffer, uint32_t(0), 0, sizeof(uint32_t));
+        cl::EnqueueArgs eargs(queue,
+            offset == 0 ? cl::NullRange : cl::NDRange(offset),
+            cl::NDRange(nHashes), local_range());
+        mine_janus_fun(eargs, r.headerBuffer, r.resultBuffer);
+        r.read = queue.read_async(r.resultBuffer, r.result);
+        queue.flush();
+        janusPending += 1;
+    }
+    // waits for the oldest range, the returned candidate nonces are valid
+    // until the next call of enqueue_janus
+    std::span<const uint32_t> wait_janus()
+    {
+        assert(janusPending > 0);
+        auto& r { janusRanges[janusHead] };
+        r.read.wait();
+        janusHead = (janusHead + 1) % janusDepth;
+        janusPending -= 1;
+        return std::span(r.result).subspan(1, std::min(size_t(r.result[0]), janusSlots));
+    }
     auto reset_counter()
     {
         cl::EnqueueArgs nd1(queue, cl::NDRange(1));
@@ -70,10 +147,15 @@ public:
     }
 
 private:
+    // non-uniform work groups (OpenCL 2.0) allow any nHashes
+    cl::NDRange local_range() const { return localSize ? cl::NDRange(localSize) : cl::NullRange; }
+
+    uint32_t localSize;
     cl::Context context;
     cl::Program program;
 
-    std::array<uint8_t, 76> blockHeader;
+    std::array<uint8_t, 76> blockHeader {};
+    JanusJobData janusJob {};
     CL::CommandQueue queue;
     CLFunction<>::Returning<uint32_t> reset_counter_fun;
     CLFunction<uint32_t>::Returning<> set_target_fun;
@@ -81,16 +163,33 @@ private:
     CLFunction<std::array<uint8_t, 76>>::Returning<std::array<uint32_t, numSlots>,
         std::array<std::array<uint8_t, 32>, numSlots>>
         mine_fun;
+    CLFunction<uint64_t, uint64_t>::Returning<> set_janus_window_fun;
+    cl::KernelFunctor<CL::Buffer, CL::Buffer> mine_janus_fun;
+    std::array<JanusRange, janusDepth> janusRanges;
+    size_t janusHead { 0 };
+    size_t janusPending { 0 };
 };
 class DevicePool;
+struct JanusJob {
+    JanusJob(Block b)
+        : block(std::move(b))
+        , midstate(block.header)
+    {
+    }
+    Block block;
+    HeaderMidstate midstate;
+};
+struct JanusTask {
+    std::shared_ptr<const JanusJob> job;
+    uint64_t generation { 0 }; // of the pool's task
+};
 class DeviceWorker {
 public:
     DeviceWorker(const CL::Device& device, DevicePool& pool)
         : pool(pool)
-        , miner(device)
         , deviceName(device.name())
     {
-        tune();
+        tune(device);
     };
     DeviceWorker(const DeviceWorker&) = delete;
     DeviceWorker(DeviceWorker&&) = delete;
@@ -126,18 +225,71 @@ public:
     void start_mining(){
         thread = std::jthread([=, this]() { run(); });
     }
+    // Benchmarks the Janushash kernel over vector widths and work-group
+    // sizes and picks the batch size per configuration such that a range
+    // takes about 100ms.
+    static GpuTuning autotune(const CL::Device& device, const std::string& deviceName)
+    {
+        const size_t maxLocal { device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>() };
+        GpuTuning best;
+        double bestRate { 0 };
+        for (uint32_t vectSize : { 1, 2, 4 }) {
+            std::unique_ptr<MinerDevice> m;
+            try {
+                m = std::make_unique<MinerDevice>(device, GpuTuning { .vectSize = vectSize });
+            } catch (cl::Error& e) {
+                spdlog::warn("Skipping vector size {} on {}: {}", vectSize, deviceName, e.what());
+                continue;
+            }
+            for (uint32_t localSize : { 0, 64, 128, 256 }) {
+                if (localSize > maxLocal)
+                    continue;
+                m->set_local_size(localSize);
+                auto [n, rate] { benchmark(*m) };
+                spdlog::info("{}: vector size {}, local size {}, batch {}: {} hashes/s", deviceName, vectSize, localSize, n, uint64_t(rate));
+                if (rate > bestRate) {
+                    bestRate = rate;
+                    best = { .vectSize = vectSize, .localSize = localSize, .hashesPerStep = n };
+                }
+            }
+        }
+        spdlog::info("Tuned {}: vector size {}, local size {}, batch {}.",
+            deviceName, best.vectSize, best.localSize, best.hashesPerStep);
+        return best;
+    }
+
 private:
-    void tune() {
+    // uses the cached tuning of the device, tunes and caches it otherwise
+    void tune(const CL::Device& device)
+    {
+        if (auto t { load_tuning(deviceName) }) {
+            spdlog::info("Using cached tuning for {} (vector size {}, local size {}, batch {}).",
+                deviceName, t->vectSize, t->localSize, t->hashesPerStep);
+            miner = std::make_unique<MinerDevice>(device, *t);
+            hashesPerStep = t->hashesPerStep;
+            return;
+        }
+        spdlog::info("Tuning {}.", deviceName);
+        auto best { autotune(device, deviceName) };
+        save_tuning(deviceName, best);
+        miner = std::make_unique<MinerDevice>(device, best);
+        hashesPerStep = best.hashesPerStep;
+    }
+    // batch size and hashrate of a range taking about 100ms
+    static std::pair<uint32_t, double> benchmark(MinerDevice& m)
+    {
         using namespace std::literals::chrono_literals;
         using namespace std::chrono;
-        spdlog::info("Tuning {}.", deviceName);
+        m.set_janus_window(0, 0); // no candidates
+        uint32_t n { 1 };
         while (true) {
-            auto start = std::chrono::steady_clock::now();
-            miner.mine(hashesPerStep, 0);
-            auto duration { steady_clock::now() - start };
-            if (duration > 100ms || 2 * size_t(hashesPerStep) > std::numeric_limits<uint32_t>::max())
-                break;
-            hashesPerStep *= 2;
+            auto start = steady_clock::now();
+            m.enqueue_janus(n, 0);
+            m.wait_janus();
+            auto elapsed { steady_clock::now() - start };
+            if (elapsed > 100ms || 2 * size_t(n) > std::numeric_limits<uint32_t>::max())
+                return { n, n / duration<double>(elapsed).count() };
+            n *= 2;
         }
     }
 
@@ -158,14 +310,14 @@ private:
             }
             if (tmpTask.has_value()) {
                 currentTask = *tmpTask;
-                init_mining(miner);
+                init_mining(*miner);
             }
             if (currentTask) {
                 if (!lastHashrateCheckpoint.has_value()) {
                     lastHashrateCheckpoint = std::chrono::steady_clock::now();
                     spdlog::info("Now mining on {}.", deviceName);
                 }
-                mine(miner);
+                mine(*miner);
             } else {
                 std::this_thread::sleep_for(100ms);
             }
@@ -183,28 +335,50 @@ private:
         }
         auto nHashes { std::min(std::numeric_limits<uint32_t>::max() - hashesTried,
             hashesPerStep) };
-        auto [args, hashes] = miner.mine(nHashes, hashesTried + randOffset);
-        auto [found] = miner.reset_counter();
-        if (found > 0) {
-            auto& h { currentTask->header };
-            h.set_nonce(hton32(args[0]));
-            notify_mined(currentTask.value());
+        if (janus) {
+            miner.enqueue_janus(nHashes, hashesTried + randOffset);
+            inflight.push_back(janusTask);
+            if (miner.janus_pending() == MinerDevice::janusDepth)
+                collect_janus(miner);
+        } else {
+            while (miner.janus_pending() > 0)
+                collect_janus(miner);
+            auto [args, hashes] = miner.mine(nHashes, hashesTried + randOffset);
+            auto [found] = miner.reset_counter();
+            if (found > 0) {
+                auto& h { currentTask->header };
+                h.set_nonce(hton32(args[0]));
+                notify_mined(currentTask.value());
+            }
         }
 
         hashesTried += nHashes;
         hashCounter += nHashes;
     };
 
+    void collect_janus(MinerDevice& miner)
+    {
+        auto nonces { miner.wait_janus() };
+        verify_candidates(inflight.front(), nonces);
+        inflight.pop_front();
+    }
+
     void init_mining(MinerDevice&);
+    // computes the verushash part of the device's Janushash candidates or
+    // hands them to the pool's CPU threads in hybrid mode
+    void verify_candidates(const JanusTask&, std::span<const uint32_t> nonces);
     void notify_mined(const Block&);
 
     // thread variables
     uint32_t hashesPerStep { 1u };
     uint32_t hashesTried { 0 };
     uint32_t randOffset { 0 };
+    bool janus { false };
+    JanusTask janusTask; // block of enqueued Janushash ranges
+    std::deque<JanusTask> inflight; // per pending range
     std::optional<Block> nextTask;
     DevicePool& pool;
-    MinerDevice miner;
+    std::unique_ptr<MinerDevice> miner;
 
     // external variables
     std::optional<std::chrono::steady_clock::time_point> lastHashrateCheckpoint;
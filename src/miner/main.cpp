@@ -1,10 +1,12 @@
 #include "api_call.hpp"
+#include "benchmark.hpp"
 #include "block/body/view.hpp"
 #include "block/header/generator.hpp"
 #include "block/header/header_impl.hpp"
 #include "block/header/view_inline.hpp"
 #include "cmdline/cmdline.h"
 #include "communication/create_payment.hpp"
+#include "cpu/tuning.hpp"
 #include "cpu/workerpool.hpp"
 #include "crypto/crypto.hpp"
 #include "general/hex.hpp"
@@ -22,37 +24,60 @@
 #include <sstream>
 using namespace std;
 
-int start_gpu_miner(const Address& address, std::string host, uint16_t port, std::string gpus);
+int start_gpu_miner(const Address& address, std::string host, uint16_t port, std::string gpus, size_t verifierThreads, bool pin);
 int process(gengetopt_args_info& ai)
 {
     try {
+        if (ai.benchmark_given) {
+            if (ai.benchmark_arg <= 0)
+                throw std::runtime_error("Illegal value " + to_string(ai.benchmark_arg) + " for option --benchmark.");
+            return run_benchmark(ai.benchmark_arg, ai.pin_given, ai.gpu_given, ai.gpus_given ? ai.gpus_arg : "");
+        }
+        if (!ai.address_given)
+            throw std::runtime_error("Option --address is required.");
         std::string host { ai.host_arg };
         uint16_t port(ai.port_arg);
         spdlog::info("Node RPC is {}:{}", host, port);
         if (ai.threads_arg < 0)
             throw std::runtime_error("Illegal value " + to_string(ai.threads_arg) + " for option --threads.");
         Address address(ai.address_arg);
+        auto tuning { load_cpu_tuning() };
+        if (tuning && tuning->portableVerus) {
+            spdlog::info("Using portable verushash as benchmarked in cpu_tuning.json.");
+            Verus::use_portable(true);
+        }
         if (ai.gpu_given) { // GPU mining
             spdlog::info("GPU is used for mining.");
-            if (ai.threads_given) {
-                spdlog::warn("Ignoring --threads as this argument is for CPU mining.");
+            size_t verifierThreads { 0 };
+            if (ai.threads_given) { // hybrid mining
+                verifierThreads = ai.threads_arg;
+                if (verifierThreads == 0)
+                    verifierThreads = std::thread::hardware_concurrency();
             }
             std::string gpus;
             if (ai.gpus_given) {
                 gpus.assign(ai.gpus_arg);
             }
-            start_gpu_miner(address,host,port,gpus);
+            if (ai.pin_given && verifierThreads == 0)
+                spdlog::warn("Ignoring --pin as GPU mining uses no CPU threads without --threads.");
+            start_gpu_miner(address, host, port, gpus, verifierThreads, ai.pin_given);
         } else { // CPU mining
             spdlog::info("CPU is used for mining.");
             if (ai.gpus_given) {
                 spdlog::warn("Ignoring --gpus as this argument is for GPU mining.");
             }
             size_t threads = ai.threads_arg;
+            if (!ai.threads_given && tuning && tuning->threads > 0) {
+                threads = tuning->threads;
+                spdlog::info("Using {} threads as benchmarked in cpu_tuning.json.", threads);
+            }
             if (threads == 0)
                 threads = std::thread::hardware_concurrency();
             spdlog::info("Starting worker pool with {} threads", threads);
 
-            Workerpool wp(address, threads, host, port);
+            if (ai.pin_given)
+                spdlog::info("Pinning worker threads to CPU cores.");
+            Workerpool wp(address, threads, host, port, ai.pin_given);
             wp.run();
         }
     } catch (std::runtime_error& e) {
@@ -0,0 +1,48 @@
+#pragma once
+#include "api_call.hpp"
+#include "crypto/address.hpp"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+
+// Receives mining tasks pushed by the node (long-poll on
+// /chain/mine/:address/wait) in a background thread and passes them to
+// onTask. Falls back to polling if the node does not support pushes.
+class TaskWatcher {
+public:
+    TaskWatcher(const Address& address, std::string host, uint16_t port, std::function<void(Block&&)> onTask)
+        : address(address)
+        , api(host, port)
+        , onTask(std::move(onTask))
+        , t(&TaskWatcher::run, this)
+    {
+    }
+    ~TaskWatcher()
+    {
+        shutdown = true;
+        t.join();
+    }
+
+private:
+    void run()
+    {
+        using namespace std::chrono;
+        while (!shutdown) {
+            auto b { api.wait_mining(address) };
+            if (shutdown)
+                break;
+            if (!b) {
+                std::this_thread::sleep_for(milliseconds(700));
+                b = api.get_mining(address);
+            }
+            onTask(std::move(*b));
+        }
+    }
+
+    Address address;
+    API api; // own client, httplib clients are not shared between threads
+    std::function<void(Block&&)> onTask;
+    std::atomic<bool> shutdown { false };
+    std::thread t;
+};
@@ -17,7 +17,7 @@ namespace HeaderDownload {
 class Downloader;
 }
 namespace chainserver {
-struct TransactionIds;
+class TransactionIds;
 }
 struct NodeVersion {
     /* data */
@@ -26,15 +26,19 @@ class Header;
 
 using PeersCb = std::function<void(std::vector<API::Peerinfo>&)>;
 using ResultCb = std::function<void(const tl::expected<void, int32_t>&)>;
+using MempoolInsertCb = std::function<void(const tl::expected<API::MempoolInsertResults, int32_t>&)>;
 using BalanceCb = std::function<void(const tl::expected<API::Balance, int32_t>&)>;
+using BalancesCb = std::function<void(const tl::expected<API::Balances, int32_t>&)>;
 
 // using OffensesCb = std::function<void(const tl::expected<std, int32_t>&)>;
-using MempoolCb = std::function<void(const tl::expected<API::MempoolEntries, int32_t>&)>;
+using MempoolCb = std::function<void(const tl::expected<API::MempoolPage, int32_t>&)>;
+using FeeEstimateCb = std::function<void(const tl::expected<API::FeeEstimate, int32_t>&)>;
 using MempoolTxsCb = std::function<void(std::vector<std::optional<TransferTxExchangeMessage>>&)>;
 using MiningCb = std::function<void(const tl::expected<MiningTask, int32_t>&)>;
 using TxcacheCb = std::function<void(const tl::expected<chainserver::TransactionIds, int32_t>&)>;
 using HashrateCb = std::function<void(const tl::expected<API::HashrateInfo, int32_t>&)>;
 using HashrateChartCb = std::function<void(const tl::expected<API::HashrateChart, int32_t>&)>;
+using ChainStatsCb = std::function<void(const tl::expected<API::ChainStats, int32_t>&)>;
 
 using HeadCb = std::function<void(const tl::expected<API::Head, int32_t>&)>;
 using RoundCb = std::function<void(const tl::expected<API::Round16Bit, int32_t>&)>;
@@ -43,9 +47,13 @@ using HeaderCb = std::function<void(const tl::expected<std::pair<NonzeroHeight,H
 using HashCb = std::function<void(const tl::expected<Hash, int32_t>&)>;
 using GridCb = std::function<void(const tl::expected<Grid, int32_t>&)>;
 using TxCb = std::function<void(const tl::expected<API::Transaction, int32_t>&)>;
+using TxProofCb = std::function<void(const tl::expected<API::TxProof, int32_t>&)>;
 using LatestTxsCb = std::function<void(const tl::expected<API::TransactionsByBlocks, int32_t>&)>;
 using BlockCb = std::function<void(const tl::expected<API::Block, int32_t>&)>;
+using BlocksCb = std::function<void(const std::vector<API::Block>&)>;
 using HistoryCb = std::function<void(const tl::expected<API::AccountHistory, int32_t>&)>;
+using HistoryExportCb = std::function<void(const tl::expected<API::HistoryExport, int32_t>&)>;
+using OverviewCb = std::function<void(const tl::expected<API::ChainOverview, int32_t>&)>;
 using RichlistCb = std::function<void(const tl::expected<API::Richlist, int32_t>&)>;
 
 using VersionCb = std::function<void(const tl::expected<NodeVersion, int32_t>&)>;
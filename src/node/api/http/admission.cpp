@@ -0,0 +1,53 @@
+#include "admission.hpp"
+#include <algorithm>
+
+auto Admission::classify(std::string_view pattern) -> Class
+{
+    auto starts = [&](std::string_view prefix) { return pattern.starts_with(prefix); };
+    if (starts("/peers/") || starts("/tools/") || starts("/debug/") || starts("/chain/headers/"))
+        return Class::Local;
+    if (starts("/account/") || starts("/chain/blocks/") || starts("/chain/stats/") || pattern == "/chain/block/:id")
+        return Class::Read;
+    return Class::Queue;
+}
+
+bool Admission::allow(std::string_view ip)
+{
+    if (rate == 0)
+        return true;
+    auto now { clock::now() };
+    if (now - pruned > std::chrono::minutes(1)) {
+        // full buckets carry no state
+        std::erase_if(buckets, [&](auto& p) {
+            auto& b { p.second };
+            return b.tokens + rate * std::chrono::duration<double>(now - b.refilled).count() >= burst;
+        });
+        pruned = now;
+    }
+    auto [iter, inserted] { buckets.try_emplace(std::string(ip), Bucket { burst, now }) };
+    auto& b { iter->second };
+    b.tokens = std::min(burst, b.tokens + rate * std::chrono::duration<double>(now - b.refilled).count());
+    b.refilled = now;
+    if (b.tokens < 1)
+        return false;
+    b.tokens -= 1;
+    return true;
+}
+
+bool Admission::acquire(Class c)
+{
+    if (c == Class::Local)
+        return true;
+    auto& n { inflight[size_t(c)] };
+    if (n.fetch_add(1, std::memory_order_relaxed) >= maxInflight) {
+        n.fetch_sub(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+void Admission::release(Class c)
+{
+    if (c != Class::Local)
+        inflight[size_t(c)].fetch_sub(1, std::memory_order_relaxed);
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+// Sheds API requests before they reach the chainserver: a token bucket per
+// client ip (per HTTP worker) and a bound on the requests in flight per
+// endpoint class (shared by all workers).
+class Admission {
+    using clock = std::chrono::steady_clock;
+
+public:
+    enum class Class : uint8_t {
+        Local, // answered without the chainserver queue, only rate limited
+        Queue, // events on the chainserver queue
+        Read, // database reads on the API read pool
+    };
+    static Class classify(std::string_view pattern);
+
+    Admission(double rate, size_t maxInflight)
+        : rate(rate)
+        , burst(2 * rate)
+        , maxInflight(maxInflight)
+    {
+    }
+    [[nodiscard]] bool allow(std::string_view ip);
+    [[nodiscard]] bool acquire(Class);
+    void release(Class);
+
+private:
+    struct Bucket {
+        double tokens;
+        clock::time_point refilled;
+    };
+    const double rate; // tokens per second, 0 disables the buckets
+    const double burst;
+    const size_t maxInflight;
+    std::unordered_map<std::string, Bucket> buckets; // by binary ip
+    clock::time_point pruned { clock::now() };
+    static inline std::array<std::atomic<size_t>, 3> inflight {};
+};
@@ -4,12 +4,18 @@
 #include "chainserver/transaction_ids.hpp"
 #include "communication/mining_task.hpp"
 #include "general/hex.hpp"
+#include "general/metrics.hpp"
+#include "general/thread_settings.hpp"
+#include "general/trace.hpp"
 #include "json.hpp"
 #include "spdlog/spdlog.h"
 #include "version.hpp"
 #include <charconv>
 #include <iostream>
 #include <type_traits>
+#ifdef WARTHOG_ZSTD
+#include <zstd.h>
+#endif
 using namespace std::placeholders;
 
 namespace {
@@ -56,11 +62,68 @@ struct ParameterParser {
     {
         return Address(sv);
     }
+    operator IPv4()
+    {
+        if (auto ip { IPv4::parse(sv) })
+            return *ip;
+        throw Error(EMALFORMED);
+    }
 };
-void send_json(uWS::HttpResponse<false>* res, const std::string& s)
+void send_json(uWS::HttpResponse<false>* res, std::string_view s, bool zstd = false)
 {
-    res->writeHeader("Content-type", "application/json; charset=utf-8");
-    res->end(s, true);
+    // replies deferred to the loop are not corked by uWS, corking sends
+    // headers and body in one write
+    res->cork([&]() {
+        res->writeHeader("Content-type", "application/json; charset=utf-8");
+        if (zstd)
+            res->writeHeader("Content-Encoding", "zstd");
+        res->end(s, true);
+    });
+}
+
+void send_json(uWS::HttpResponse<false>* res, const HTTPReply& r, bool acceptsZstd)
+{
+    if (acceptsZstd && r.zstd)
+        send_json(res, *r.zstd, true);
+    else
+        send_json(res, r.json);
+}
+
+bool accepts_zstd(uWS::HttpRequest* req)
+{
+#ifdef WARTHOG_ZSTD
+    return req->getHeader("accept-encoding").find("zstd") != std::string_view::npos;
+#else
+    (void)req;
+    return false;
+#endif
+}
+
+// websocket subscribers buffering more are closed, slow consumers must not
+// hold back or grow the memory of the event publishing
+constexpr unsigned wsMaxBackpressure { 16 << 20 };
+constexpr const char feedChainTopic[] { "feed/chain" }; // live feeds only
+constexpr const char feedMempoolTopic[] { "feed/mempool" };
+
+HTTPReply make_reply(std::string json, bool compress)
+{
+    HTTPReply r { std::move(json), {} };
+#ifdef WARTHOG_ZSTD
+    // smaller replies fit into few packets anyway
+    constexpr size_t compressThreshold { 1024 };
+    if (compress && r.json.size() >= compressThreshold) {
+        constexpr int level { 3 }; // fast, the node pays for it
+        std::string out(ZSTD_compressBound(r.json.size()), '\0');
+        auto n { ZSTD_compress(out.data(), out.size(), r.json.data(), r.json.size(), level) };
+        if (!ZSTD_isError(n) && n < r.json.size()) {
+            out.resize(n);
+            r.zstd = std::move(out);
+        }
+    }
+#else
+    (void)compress;
+#endif
+    return r;
 }
 
 void nav(uWS::HttpResponse<false>* res, uWS::HttpRequest*)
@@ -79,39 +142,59 @@ void nav(uWS::HttpResponse<false>* res, uWS::HttpRequest*)
         <h2>Transaction endpoints</h2>
         <ul>
             <li>POST <a href=/transaction/add>/transaction/add</a> </li>
+            <li>POST <a href=/transaction/add_batch>/transaction/add_batch</a> </li>
             <li>GET <a href=/transaction/mempool>/transaction/mempool</a></li>
+            <li>GET <a href=/transaction/mempool/:offset/:limit>/transaction/mempool/:offset/:limit</a></li>
+            <li>GET <a href=/transaction/feeestimate>/transaction/feeestimate</a></li>
             <li>GET <a href=/transaction/lookup/:txid>/transaction/lookup/:txid </a></li>
             <li>GET <a href=/transaction/latest>/transaction/lookup/latest </a></li>
+            <li>GET <a href=/transaction/proof/:txid>/transaction/proof/:txid </a></li>
+            <li>GET <a href=/transaction/proof/id/:historyId>/transaction/proof/id/:historyId </a></li>
         </ul>
         <h2>Chain endpoints</h2>
         <ul>
             <li>GET <a href=/chain/head>/chain/head</a></li>
             <li>GET <a href=/chain/grid>/chain/grid</a></li>
+            <li>GET <a href=/chain/overview>/chain/overview</a></li>
             <li>GET <a href=/chain/block/:id/hash>/chain/block/:id/hash</a></li>
             <li>GET <a href=/chain/signed_snapshot>/chain/signed_snapshot</a></li>
             <li>GET <a href=/chain/block/:id/header>/chain/block/:id/header</a></li>
             <li>GET <a href=/chain/block/:id>/chain/block/:id</a></li>
+            <li>GET <a href=/chain/blocks/:from/:to>/chain/blocks/:from/:to</a> (NDJSON, to exclusive)</li>
+            <li>GET <a href=/chain/headers/:from/:to>/chain/headers/:from/:to</a> (binary, to exclusive)</li>
             <li>GET <a href=/chain/mine/:address>/chain/mine/:address</a></li>
+            <li>GET <a href=/chain/mine/:address/wait>/chain/mine/:address/wait</a> (long-poll)</li>
+            <li>WEBSOCKET <a href=/ws/chain/mine/:address>/ws/chain/mine/:address</a></li>
             <li>GET <a href=/chain/txcache>/chain/txcache</a></li>
             <li>GET <a href=/chain/hashrate>/chain/hashrate</a></li>
             <li>GET <a href=/chain/hashrate/chart/:from/:to>/chain/hashrate/chart/:from/:to</a></li>
+            <li>GET <a href=/chain/hashrate/chart/:from/:to/:step>/chain/hashrate/chart/:from/:to/:step</a></li>
+            <li>GET <a href=/chain/stats/:from/:to/:bucketSeconds>/chain/stats/:from/:to/:bucketSeconds</a> (timestamps, to exclusive)</li>
             <li>POST <a href=/chain/append>/chain/append</a></li>
         </ul>
         <h2>Account endpoints</h2>
         <ul>
             <li>GET <a href=/account/:account/balance>/account/:account/balance</a></li>
+            <li>POST <a href=/account/balances>/account/balances</a></li>
+            <li>GET <a href=/account/:account/export/:format>/account/:account/export/:format</a> (format csv or ndjson, streamed)</li>
             <li>GET <a href=/account/:account/history/:beforeTxIndex>/account/:account/history/:beforeTxIndex</a></li>
+            <li>GET <a href=/account/:account/history/:beforeTxIndex/:limit>/account/:account/history/:beforeTxIndex/:limit</a></li>
+            <li>GET <a href=/account/:account/mempool/:offset/:limit>/account/:account/mempool/:offset/:limit</a></li>
             <li>GET <a href=/account/richlist>/account/richlist</a></li>
+            <li>WEBSOCKET <a href=/ws/account/:account>/ws/account/:account</a></li>
+            <li>WEBSOCKET <a href=/ws/chain/feed/:height>/ws/chain/feed/:height</a></li>
         </ul>
         <h2>Peers endpoints</h2>
         <ul>
             <li>GET <a href=/peers/ip_count>/peers/ip_count</a></li>
             <li>GET <a href=/peers/banned>/peers/banned</a></li>
             <li>GET <a href=/peers/unban>/peers/unban</a></li>
+            <li>GET <a href=/peers/ban/:ip/:prefix/:seconds>/peers/ban/:ip/:prefix/:seconds</a></li>
             <li>GET <a href=/peers/offenses/:page>/peers/offenses/:page</a></li>
             <li>GET <a href=/peers/connected>/peers/connected</a></li>
             <li>GET <a href=/peers/endpoints>/peers/endpoints</a></li>
             <li>GET <a href=/peers/connect_timers>/peers/connect_timers</a></li>
+            <li>GET <a href=/peers/traffic>/peers/traffic</a></li>
         </ul>
         <h2>Tools endpoints</h2>
         <ul>
@@ -122,51 +205,77 @@ void nav(uWS::HttpResponse<false>* res, uWS::HttpRequest*)
         <h2>Debug endpoints</h2>
         <ul>
             <li>GET <a href=/debug/header_download>/debug/header_download</a></li>
+            <li>GET <a href=/debug/trace>/debug/trace</a> (Chrome trace JSON)</li>
+            <li>GET <a href=/debug/trace/start>/debug/trace/start</a></li>
+            <li>GET <a href=/debug/trace/stop>/debug/trace/stop</a></li>
+            <li>GET <a href=/debug/block_latency>/debug/block_latency</a></li>
+            <li>GET <a href=/metrics>/metrics</a> (Prometheus)</li>
         </ul>
     </body>
 </html>
     )HTML";
     res->end(s, true);
 }
+
+void get_metrics(uWS::HttpResponse<false>* res, uWS::HttpRequest*)
+{
+    res->writeHeader("Content-type", "text/plain; version=0.0.4; charset=utf-8");
+    res->end(metrics::prometheus(), true);
+}
 } // namespace
 
-void HTTPEndpoint::work()
+void HTTPWorker::work()
 {
+    trace::set_thread_name("http");
     app.get("/", &nav);
+    app.get("/metrics", &get_metrics);
 
     // transaction endpoints
     post("/transaction/add", parse_payment_create, put_mempool);
+    post("/transaction/add_batch", parse_payment_create_batch, put_mempool_batch);
     get("/transaction/mempool", get_mempool);
+    get_2("/transaction/mempool/:offset/:limit", get_mempool_page);
+    get("/transaction/feeestimate", get_fee_estimate);
     get_1("/transaction/lookup/:txid", lookup_tx);
-    get("/transaction/latest", get_latest_transactions);
+    get_1("/transaction/proof/:txid", lookup_tx_proof);
+    get_1("/transaction/proof/id/:historyId", lookup_tx_proof_by_id);
+    get_cached("/transaction/latest", CacheScope::Head, get_latest_transactions);
 
     // Chain endpoints
-    get("/chain/head", get_block_head, jsonmsg::serialize<API::Head>);
+    get_cached("/chain/head", CacheScope::Head, get_block_head, jsonmsg::serialize<API::Head>);
     get("/chain/grid", get_chain_grid);
+    get("/chain/overview", get_chain_overview);
     get_1("/chain/block/:id/hash", get_chain_hash);
     get_1("/chain/block/:id/header", get_chain_header);
     get_1("/chain/block/:id", get_chain_block);
-    get_1("/chain/mine/:account", get_chain_mine);
+    get_1_cached("/chain/mine/:account", CacheScope::Mining, get_chain_mine);
     get_1("/chain/mine/:account/log", get_chain_mine_log);
     get("/chain/signed_snapshot", get_signed_snapshot);
     get("/chain/txcache", get_txcache);
     get("/chain/hashrate", get_hashrate);
     get_2("/chain/hashrate/chart/:from/:to", get_hashrate_chart);
+    get_3("/chain/hashrate/chart/:from/:to/:step", get_hashrate_chart_sampled);
+    get_3("/chain/stats/:from/:to/:bucketSeconds", get_chain_stats);
     post("/chain/append", parse_mining_task, put_chain_append);
 
     // Account endpoints
     get_1("/account/:account/balance", get_account_balance);
+    post("/account/balances", parse_balances_request, get_account_balances);
     get_2("/account/:account/history/:beforeTxIndex", get_account_history);
-    get("/account/richlist", get_account_richlist);
+    get_3("/account/:account/history/:beforeTxIndex/:limit", get_account_history_page);
+    get_3("/account/:account/mempool/:offset/:limit", get_account_mempool);
+    get_cached("/account/richlist", CacheScope::Head, get_account_richlist);
 
     // peers endpoints
     get("/peers/ip_count", inspect_conman, jsonmsg::ip_counter);
     get("/peers/banned", get_banned_peers);
     get("/peers/unban", unban_peers);
+    get_3("/peers/ban/:ip/:prefix/:seconds", ban_peers);
     get_1("/peers/offenses/:page", get_offenses);
     get("/peers/connected", get_connected_peers2);
     get("/peers/endpoints", inspect_eventloop, jsonmsg::endpoints);
     get("/peers/connect_timers", inspect_eventloop, jsonmsg::connect_timers);
+    get("/peers/traffic", get_peer_traffic, jsonmsg::peer_traffic);
 
     // tools endpoints
     get_1("/tools/encode16bit/from_e8/:feeE8", get_round16bit_e8);
@@ -175,107 +284,189 @@ void HTTPEndpoint::work()
 
     // debug endpoints
     get("/debug/header_download", inspect_eventloop, jsonmsg::header_download);
+    get("/debug/trace", get_trace, jsonmsg::chrome_trace);
+    get("/debug/trace/start", start_tracing);
+    get("/debug/trace/stop", stop_tracing);
+    get("/debug/memory", get_memory_usage, jsonmsg::memory_usage);
+    get("/debug/block_latency", get_block_latency, jsonmsg::block_latency);
     app.ws<int>("/ws_sneak_peek", {
+            .maxBackpressure = wsMaxBackpressure,
+            .closeOnBackpressureLimit = true,
             .open = [](auto* ws) { ws->subscribe(API::Block::WEBSOCKET_EVENT); },
     });
-    app.listen(bind.ipv4.to_string(), bind.port, std::bind(&HTTPEndpoint::on_listen, this, _1));
+    mining_routes();
+    account_routes();
+    feed_routes();
+    block_stream_routes();
+    app.listen(bind.ipv4.to_string(), bind.port, std::bind(&HTTPWorker::on_listen, this, _1));
     lc.loop->run();
 }
 
-HTTPEndpoint::HTTPEndpoint(const Config& c)
+HTTPWorker::HTTPWorker(const Config& c)
     : bind(c.jsonrpc.bind)
+    , admission(c.jsonrpc.rateLimit, c.jsonrpc.maxInflight)
     , app(lc.loop)
 {
-    spdlog::info("RPC endpoint is {}.", bind.to_string());
-    t = std::thread(&HTTPEndpoint::work, this);
+    t = std::thread([this, s = c.threads.http]() {
+        apply_thread_settings(s, "http");
+        work();
+    });
 }
 
-void HTTPEndpoint::get(std::string pattern, auto asyncfun, auto serializer)
+SerializedEvent::SerializedEvent(WebsocketEvent e)
+    : event(std::move(e))
+{
+    std::visit([&](auto& e) {
+        using T = std::decay_t<decltype(e)>;
+        if constexpr (std::is_same_v<T, API::Block>)
+            block = jsonmsg::dump_compact(e);
+        if constexpr (!std::is_same_v<T, API::MiningUpdate>)
+            feed = jsonmsg::dump_feed_event(e);
+    },
+        event);
+}
+
+HTTPEndpoint::HTTPEndpoint(const Config& c)
+{
+    spdlog::info("RPC endpoint is {} ({} threads).", c.jsonrpc.bind.to_string(), c.jsonrpc.threads);
+    for (size_t i = 0; i < c.jsonrpc.threads; ++i)
+        workers.push_back(std::make_unique<HTTPWorker>(c));
+}
+
+void HTTPWorker::get(std::string pattern, auto asyncfun, auto serializer)
 {
     app.get(pattern,
-        [this, asyncfun, serializer, pattern](auto* res, auto* req) {
+        [this, asyncfun, serializer, pattern, cls = Admission::classify(pattern)](auto* res, auto* req) {
             spdlog::debug("GET {}", req->getUrl());
+            TRACE_ZONE("http.request");
+            if (!admit(res, cls))
+                return;
+            const bool zstd { accepts_zstd(req) };
             asyncfun(
-                [this, res, serializer](auto& data) {
-                    async_reply(res, serializer(data));
+                [this, res, serializer, zstd](auto& data) {
+                    async_reply(res, serializer(data), zstd);
                 });
-            pendingRequests.insert(res);
+            pendingRequests.emplace(res, Pending { zstd, cls });
             res->onAborted([this, res]() { on_aborted(res); });
         });
 }
 
-void HTTPEndpoint::get(std::string pattern, auto asyncfun)
+void HTTPWorker::get(std::string pattern, auto asyncfun)
 {
     app.get(pattern,
-        [this, asyncfun, pattern](auto* res, auto* req) {
+        [this, asyncfun, pattern, cls = Admission::classify(pattern)](auto* res, auto* req) {
             spdlog::debug("GET {}", req->getUrl());
+            TRACE_ZONE("http.request");
+            if (!admit(res, cls))
+                return;
+            const bool zstd { accepts_zstd(req) };
             asyncfun(
-                [this, res](auto& data) {
-                    async_reply(res, jsonmsg::serialize(data));
+                [this, res, zstd](auto& data) {
+                    async_reply(res, jsonmsg::serialize(data), zstd);
                 });
-            pendingRequests.insert(res);
+            pendingRequests.emplace(res, Pending { zstd, cls });
             res->onAborted([this, res]() { on_aborted(res); });
         });
 }
 
-void HTTPEndpoint::get_1(std::string pattern, auto asyncfun)
+void HTTPWorker::get_1(std::string pattern, auto asyncfun)
 {
     app.get(pattern,
-        [this, asyncfun, pattern](auto* res, auto* req) {
+        [this, asyncfun, pattern, cls = Admission::classify(pattern)](auto* res, auto* req) {
             spdlog::debug("GET {}", req->getUrl());
+            TRACE_ZONE("http.request");
+            if (!admit(res, cls))
+                return;
             try {
                 ParameterParser p1 { req->getParameter(0) };
+                const bool zstd { accepts_zstd(req) };
                 asyncfun(p1,
-                    [this, res](auto& data) {
-                        async_reply(res, jsonmsg::serialize(data));
+                    [this, res, zstd](auto& data) {
+                        async_reply(res, jsonmsg::serialize(data), zstd);
                     });
-                pendingRequests.insert(res);
+                pendingRequests.emplace(res, Pending { zstd, cls });
                 res->onAborted([this, res]() { on_aborted(res); });
             } catch (Error e) {
+                admission.release(cls);
                 send_json(res, jsonmsg::serialize(tl::make_unexpected(e.e)));
             }
         });
 }
-void HTTPEndpoint::get_2(std::string pattern, auto asyncfun)
+void HTTPWorker::get_2(std::string pattern, auto asyncfun)
 {
     app.get(pattern,
-        [this, asyncfun, pattern](auto* res, auto* req) {
+        [this, asyncfun, pattern, cls = Admission::classify(pattern)](auto* res, auto* req) {
             spdlog::debug("GET {}", req->getUrl());
+            TRACE_ZONE("http.request");
+            if (!admit(res, cls))
+                return;
             try {
                 ParameterParser p1 { req->getParameter(0) };
                 ParameterParser p2 { req->getParameter(1) };
+                const bool zstd { accepts_zstd(req) };
                 asyncfun(p1, p2,
-                    [this, res](auto& data) {
-                        async_reply(res, jsonmsg::serialize(data));
+                    [this, res, zstd](auto& data) {
+                        async_reply(res, jsonmsg::serialize(data), zstd);
+                    });
+                pendingRequests.emplace(res, Pending { zstd, cls });
+                res->onAborted([this, res]() { on_aborted(res); });
+            } catch (Error e) {
+                admission.release(cls);
+                send_json(res, jsonmsg::serialize(tl::make_unexpected(e.e)));
+            }
+        });
+}
+
+void HTTPWorker::get_3(std::string pattern, auto asyncfun)
+{
+    app.get(pattern,
+        [this, asyncfun, pattern, cls = Admission::classify(pattern)](auto* res, auto* req) {
+            spdlog::debug("GET {}", req->getUrl());
+            TRACE_ZONE("http.request");
+            if (!admit(res, cls))
+                return;
+            try {
+                ParameterParser p1 { req->getParameter(0) };
+                ParameterParser p2 { req->getParameter(1) };
+                ParameterParser p3 { req->getParameter(2) };
+                const bool zstd { accepts_zstd(req) };
+                asyncfun(p1, p2, p3,
+                    [this, res, zstd](auto& data) {
+                        async_reply(res, jsonmsg::serialize(data), zstd);
                     });
-                pendingRequests.insert(res);
+                pendingRequests.emplace(res, Pending { zstd, cls });
                 res->onAborted([this, res]() { on_aborted(res); });
             } catch (Error e) {
+                admission.release(cls);
                 send_json(res, jsonmsg::serialize(tl::make_unexpected(e.e)));
             }
         });
 }
 
-void HTTPEndpoint::post(std::string pattern, auto parser, auto asyncfun)
+void HTTPWorker::post(std::string pattern, auto parser, auto asyncfun)
 {
     app.post(pattern,
-        [this, pattern, parser = std::move(parser), asyncfun = std::move(asyncfun)](auto* res, uWS::HttpRequest* req) {
+        [this, pattern, parser = std::move(parser), asyncfun = std::move(asyncfun), cls = Admission::classify(pattern)](auto* res, uWS::HttpRequest* req) {
             spdlog::debug("POST {}", req->getUrl());
+            TRACE_ZONE("http.request");
+            if (!admit(res, cls))
+                return;
             std::vector<uint8_t> body;
 
-            pendingRequests.insert(res);
+            const bool zstd { accepts_zstd(req) };
+            pendingRequests.emplace(res, Pending { zstd, cls });
             res->onData(
-                [this, asyncfun = std::move(asyncfun), parser = std::move(parser), res, body = std::move(body)](std::string_view data, bool last) mutable {
+                [this, asyncfun = std::move(asyncfun), parser = std::move(parser), res, zstd, body = std::move(body)](std::string_view data, bool last) mutable {
                     body.insert(body.end(), data.begin(), data.end());
                     if (last) {
                         try {
                             asyncfun(parser(body),
-                                [this, res](auto& data) {
-                                    async_reply(res, jsonmsg::serialize(data));
+                                [this, res, zstd](auto& data) {
+                                    async_reply(res, jsonmsg::serialize(data), zstd);
                                 });
                         } catch (Error e) {
                             auto ser = jsonmsg::serialize(tl::make_unexpected(e.e));
-                            async_reply(res, ser);
+                            async_reply(res, ser, false);
                         }
                     }
                 });
@@ -283,44 +474,662 @@ void HTTPEndpoint::post(std::string pattern, auto parser, auto asyncfun)
         });
 }
 
-void HTTPEndpoint::shutdown()
+namespace {
+// bounds staleness of fields not covered by the invalidation events,
+// e.g. the signed snapshot in /chain/head or mining task timestamps
+constexpr auto cachedReplyMaxAge { std::chrono::seconds(1) };
+}
+
+void HTTPWorker::get_cached(std::string pattern, CacheScope scope, auto asyncfun, auto serializer)
+{
+    app.get(pattern,
+        [this, asyncfun, serializer, pattern, scope](auto* res, auto* req) {
+            spdlog::debug("GET {}", req->getUrl());
+            TRACE_ZONE("http.request");
+            if (!admit(res, Admission::Class::Local))
+                return;
+            reply_cached(res, accepts_zstd(req), pattern, scope, [asyncfun, serializer](auto cb) {
+                asyncfun([cb, serializer](auto& data) { cb(serializer(data)); });
+            });
+        });
+}
+
+void HTTPWorker::get_cached(std::string pattern, CacheScope scope, auto asyncfun)
+{
+    get_cached(std::move(pattern), scope, asyncfun, [](auto& data) { return jsonmsg::serialize(data); });
+}
+
+void HTTPWorker::get_1_cached(std::string pattern, CacheScope scope, auto asyncfun)
+{
+    app.get(pattern,
+        [this, asyncfun, pattern, scope](auto* res, auto* req) {
+            spdlog::debug("GET {}", req->getUrl());
+            TRACE_ZONE("http.request");
+            if (!admit(res, Admission::Class::Local))
+                return;
+            try {
+                ParameterParser p1 { req->getParameter(0) };
+                reply_cached(res, accepts_zstd(req), std::string(req->getUrl()), scope, [asyncfun, p1](auto cb) mutable {
+                    asyncfun(p1, [cb](auto& data) { cb(jsonmsg::serialize(data)); });
+                });
+            } catch (Error e) {
+                send_json(res, jsonmsg::serialize(tl::make_unexpected(e.e)));
+            }
+        });
+}
+
+void HTTPWorker::reply_cached(uWS::HttpResponse<false>* res, bool zstd, std::string key, CacheScope scope, auto fetch)
+{
+    auto [iter, inserted] { cachedReplies.try_emplace(key, CachedReply { scope, generation(scope) }) };
+    auto& c { iter->second };
+    if (!c.fetching && c.reply && c.generation == generation(scope)
+        && std::chrono::steady_clock::now() < c.expires) {
+        send_json(res, *c.reply, zstd);
+        return;
+    }
+    c.waiters.push_back(res);
+    // identical requests share one fetch, they are only rate limited
+    pendingRequests.emplace(res, Pending { zstd, Admission::Class::Local });
+    res->onAborted([this, res]() { on_aborted(res); });
+    if (c.fetching)
+        return; // reply is shared with the pending fetch
+    c.fetching = true;
+    c.generation = generation(scope);
+    // shared replies are compressed regardless of the first requester
+    fetch([this, key = std::move(key)](std::string json) {
+        lc.loop->defer([this, key, r = make_reply(std::move(json), true)]() mutable {
+            on_cached_reply(key, std::move(r));
+        });
+    });
+}
+
+void HTTPWorker::on_cached_reply(const std::string& key, HTTPReply r)
+{
+    auto iter { cachedReplies.find(key) };
+    if (iter == cachedReplies.end())
+        return;
+    auto& c { iter->second };
+    c.fetching = false;
+    for (auto* res : std::exchange(c.waiters, {}))
+        send_reply(res, r);
+    if (c.generation != generation(c.scope)) {
+        cachedReplies.erase(iter); // outdated while fetching
+        return;
+    }
+    c.reply = std::move(r);
+    c.expires = std::chrono::steady_clock::now() + cachedReplyMaxAge;
+}
+
+void HTTPWorker::invalidate_cached(CacheScope scope)
+{
+    generation(scope) += 1;
+    std::erase_if(cachedReplies, [&](auto& p) {
+        return p.second.scope == scope && !p.second.fetching;
+    });
+}
+
+void HTTPWorker::shutdown()
 {
     bshutdown = true;
+    if (miningTimer != nullptr) {
+        us_timer_close(miningTimer);
+        miningTimer = nullptr;
+    }
     if (listen_socket != nullptr) {
         us_listen_socket_close(0, listen_socket);
         listen_socket = nullptr;
     }
 }
 
-void HTTPEndpoint::on_event(WebsocketEvent&& e)
+void HTTPWorker::on_event(const SerializedEvent& e)
 {
-    std::visit([&](auto&& e) {
-        handle_event(std::move(e));
+    std::visit([&](auto& event) {
+        handle_event(event, e);
     },
-        std::move(e));
+        e.event);
+}
+
+void HTTPWorker::handle_event(const API::Block& b, const SerializedEvent& e)
+{
+    invalidate_cached(CacheScope::Head);
+    app.publish(b.WEBSOCKET_EVENT, e.block, uWS::OpCode::TEXT);
+    if (!accountSubscriptions.empty())
+        notify_accounts(b);
+    app.publish(feedChainTopic, e.feed, uWS::OpCode::TEXT);
+    for (auto& [_, f] : feeds)
+        f.backlog.push_back(b);
+}
+
+void HTTPWorker::handle_event(const API::Rollback& r, const SerializedEvent& e)
+{
+    app.publish(feedChainTopic, e.feed, uWS::OpCode::TEXT);
+    for (auto& [_, f] : feeds) {
+        // blocks above r.length in the backlog were disconnected as well
+        std::erase_if(f.backlog, [&](auto& b) { return b.height > r.length; });
+        if (r.length >= f.next)
+            continue;
+        f.next = (r.length + 1).nonzero_assert();
+        f.ws->send(e.feed, uWS::OpCode::TEXT);
+    }
+}
+
+void HTTPWorker::handle_event(const API::MempoolChange&, const SerializedEvent& e)
+{
+    app.publish(feedMempoolTopic, e.feed, uWS::OpCode::TEXT);
+}
+
+namespace {
+constexpr auto miningRefreshInterval { std::chrono::seconds(2) }; // new timestamp
+std::string mining_topic(const Address& a)
+{
+    return "mine/" + a.to_string();
+}
+}
+
+void HTTPWorker::mining_routes()
+{
+    // long-poll: replies with the next mining task after the chain head
+    // or block template changed, at the latest after miningRefreshInterval
+    app.get("/chain/mine/:account/wait", [this](auto* res, auto* req) {
+        spdlog::debug("GET {}", req->getUrl());
+        TRACE_ZONE("http.request");
+        if (!admit(res, Admission::Class::Local))
+            return;
+        try {
+            Address a { ParameterParser { req->getParameter(0) } };
+            mining_subscription(a).waiters.push_back(res);
+            pendingRequests.emplace(res, Pending { false, Admission::Class::Local }); // small replies
+            res->onAborted([this, res]() { on_aborted(res); });
+        } catch (Error e) {
+            send_json(res, jsonmsg::serialize(tl::make_unexpected(e.e)));
+        }
+    });
+
+    // websocket: pushes a mining task on open and on every change
+    app.ws<MiningWsData>("/ws/chain/mine/:account", {
+            .maxBackpressure = wsMaxBackpressure,
+            .closeOnBackpressureLimit = true,
+            .upgrade = [](auto* res, auto* req, auto* context) {
+                try {
+                    Address a { ParameterParser { req->getParameter(0) } };
+                    res->template upgrade<MiningWsData>({ a },
+                        req->getHeader("sec-websocket-key"),
+                        req->getHeader("sec-websocket-protocol"),
+                        req->getHeader("sec-websocket-extensions"),
+                        context);
+                } catch (Error e) {
+                    send_json(res, jsonmsg::serialize(tl::make_unexpected(e.e)));
+                }
+            },
+            .open = [this](auto* ws) {
+                auto& a { *ws->getUserData()->address };
+                ws->subscribe(mining_topic(a));
+                mining_subscription(a).websockets += 1;
+                fetch_mining(a);
+            },
+            .close = [this](auto* ws, int, std::string_view) {
+                auto iter { miningSubscriptions.find(*ws->getUserData()->address) };
+                if (iter != miningSubscriptions.end()) {
+                    iter->second.websockets -= 1;
+                    release_mining_subscription(iter);
+                }
+            },
+        });
+
+    miningTimer = us_create_timer((us_loop_t*)lc.loop, 0, sizeof(HTTPWorker*));
+    *(HTTPWorker**)us_timer_ext(miningTimer) = this;
+    us_timer_set(
+        miningTimer, [](us_timer_t* t) {
+            (*(HTTPWorker**)us_timer_ext(t))->on_mining_timer();
+        },
+        500, 500);
+}
+
+auto HTTPWorker::mining_subscription(const Address& a) -> MiningSubscription&
+{
+    auto [iter, inserted] { miningSubscriptions.try_emplace(a) };
+    if (inserted)
+        iter->second.refresh = std::chrono::steady_clock::now() + miningRefreshInterval;
+    return iter->second;
+}
+
+void HTTPWorker::release_mining_subscription(MiningSubscriptions::iterator iter)
+{
+    auto& s { iter->second };
+    if (s.websockets == 0 && s.waiters.empty() && !s.fetching)
+        miningSubscriptions.erase(iter);
 }
 
-void HTTPEndpoint::handle_event(const API::Block& b)
+void HTTPWorker::fetch_mining(const Address& a)
 {
-    auto txt { jsonmsg::to_json(b).dump() };
-    app.publish(b.WEBSOCKET_EVENT, txt, uWS::OpCode::TEXT);
+    auto& s { miningSubscriptions.at(a) };
+    if (s.fetching) {
+        s.outdated = true;
+        return;
+    }
+    s.fetching = true;
+    s.refresh = std::chrono::steady_clock::now() + miningRefreshInterval;
+    get_chain_mine(a, [this, a](auto& mt) {
+        lc.loop->defer([this, a, json = jsonmsg::serialize(mt)]() mutable {
+            on_mining_task(a, std::move(json));
+        });
+    });
+}
+
+void HTTPWorker::on_mining_task(const Address& a, std::string json)
+{
+    auto iter { miningSubscriptions.find(a) };
+    if (iter == miningSubscriptions.end())
+        return;
+    auto& s { iter->second };
+    s.fetching = false;
+    if (s.websockets > 0)
+        app.publish(mining_topic(a), json, uWS::OpCode::TEXT);
+    const HTTPReply r { std::move(json), {} };
+    for (auto* res : std::exchange(s.waiters, {}))
+        send_reply(res, r);
+    if (std::exchange(s.outdated, false))
+        fetch_mining(a);
+    else
+        release_mining_subscription(iter);
+}
+
+void HTTPWorker::on_mining_timer()
+{
+    auto now { std::chrono::steady_clock::now() };
+    for (auto& [a, s] : miningSubscriptions) {
+        if (now >= s.refresh)
+            fetch_mining(a);
+    }
+}
+
+void HTTPWorker::handle_event(const API::MiningUpdate& u, const SerializedEvent&)
+{
+    invalidate_cached(CacheScope::Mining);
+    if (u.headChanged) // also covers rollbacks which publish no blocks
+        invalidate_cached(CacheScope::Head);
+    for (auto& [a, s] : miningSubscriptions)
+        fetch_mining(a);
+}
+
+namespace {
+std::string account_topic(const Address& a)
+{
+    return "account/" + a.to_string();
+}
+}
+
+void HTTPWorker::account_routes()
+{
+    app.ws<AccountWsData>("/ws/account/:account", {
+            .maxBackpressure = wsMaxBackpressure,
+            .closeOnBackpressureLimit = true,
+            .upgrade = [](auto* res, auto* req, auto* context) {
+                try {
+                    Address a { ParameterParser { req->getParameter(0) } };
+                    res->template upgrade<AccountWsData>({ a },
+                        req->getHeader("sec-websocket-key"),
+                        req->getHeader("sec-websocket-protocol"),
+                        req->getHeader("sec-websocket-extensions"),
+                        context);
+                } catch (Error e) {
+                    send_json(res, jsonmsg::serialize(tl::make_unexpected(e.e)));
+                }
+            },
+            .open = [this](auto* ws) {
+                auto& a { *ws->getUserData()->address };
+                ws->subscribe(account_topic(a));
+                accountSubscriptions[a] += 1;
+            },
+            .close = [this](auto* ws, int, std::string_view) {
+                auto iter { accountSubscriptions.find(*ws->getUserData()->address) };
+                if (iter != accountSubscriptions.end() && --iter->second == 0)
+                    accountSubscriptions.erase(iter);
+            },
+        });
+
+    app.get("/account/:account/export/:format", [this](auto* res, auto* req) {
+        spdlog::debug("GET {}", req->getUrl());
+        TRACE_ZONE("http.request");
+        try {
+            Address a { ParameterParser { req->getParameter(0) } };
+            const auto format { req->getParameter(1) };
+            if (format != "csv" && format != "ndjson")
+                throw Error(EMALFORMED);
+            if (!admit(res, Admission::Class::Read))
+                return;
+            historyExports.emplace(res, HistoryExportStream { .address = a, .csv = format == "csv" });
+            res->onAborted([this, res]() {
+                if (historyExports.erase(res))
+                    admission.release(Admission::Class::Read);
+            });
+            fetch_history_export(res);
+        } catch (Error e) {
+            send_json(res, jsonmsg::serialize(tl::make_unexpected(e.e)));
+        }
+    });
+}
+
+void HTTPWorker::fetch_history_export(uWS::HttpResponse<false>* res)
+{
+    auto iter { historyExports.find(res) };
+    if (iter == historyExports.end() || iter->second.fetching)
+        return;
+    auto& s { iter->second };
+    s.fetching = true;
+    get_account_history_export(s.address, s.afterId, [this, res](auto& chunk) {
+        lc.loop->defer([this, res, chunk]() { on_history_export(res, chunk); });
+    });
+}
+
+void HTTPWorker::on_history_export(uWS::HttpResponse<false>* res, const tl::expected<API::HistoryExport, int32_t>& chunk)
+{
+    auto iter { historyExports.find(res) };
+    if (iter == historyExports.end())
+        return; // aborted
+    auto& s { iter->second };
+    s.fetching = false;
+    const bool first { s.afterId == 0 };
+    if (!chunk) {
+        historyExports.erase(iter);
+        admission.release(Admission::Class::Read);
+        if (first)
+            send_json(res, jsonmsg::serialize(tl::make_unexpected(chunk.error())));
+        else
+            res->end();
+        return;
+    }
+    std::string lines;
+    if (first) {
+        res->writeHeader("Content-type", s.csv ? "text/csv; charset=utf-8" : "application/x-ndjson; charset=utf-8");
+        if (s.csv)
+            lines = jsonmsg::historyCsvHeader;
+    }
+    jsonmsg::append_history_export(lines, *chunk, s.csv);
+    if (!chunk->entries.empty())
+        s.afterId = chunk->entries.back().id.value();
+    if (!chunk->more) {
+        historyExports.erase(iter);
+        admission.release(Admission::Class::Read);
+        res->end(lines);
+        return;
+    }
+    if (res->write(lines))
+        fetch_history_export(res);
+    else
+        res->onWritable([this, res](uintmax_t) {
+            fetch_history_export(res);
+            return true;
+        });
+}
+
+void HTTPWorker::notify_accounts(const API::Block& b)
+{
+    std::vector<Address> touched;
+    auto add = [&](const Address& a) {
+        if (accountSubscriptions.contains(a))
+            touched.push_back(a);
+    };
+    for (auto& r : b.rewards)
+        add(r.toAddress);
+    for (auto& t : b.transfers) {
+        add(t.fromAddress);
+        add(t.toAddress);
+    }
+    std::sort(touched.begin(), touched.end());
+    touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+    if (touched.empty())
+        return;
+
+    auto block { std::make_shared<const API::Block>(b) };
+    for (auto& a : touched) {
+        get_account_balance(a, [this, a, block](const tl::expected<API::Balance, int32_t>& balance) {
+            if (!balance)
+                return;
+            lc.loop->defer([this, a, json = jsonmsg::dump_account_event(*block, a, *balance)]() {
+                app.publish(account_topic(a), json, uWS::OpCode::TEXT);
+            });
+        });
+    }
+}
+
+namespace {
+constexpr uint32_t blockStreamChunk { 32 }; // blocks per database read
 }
 
-void HTTPEndpoint::send_reply(uWS::HttpResponse<false>* res, const std::string& s)
+void HTTPWorker::block_stream_routes()
 {
+    app.get("/chain/blocks/:from/:to", [this](auto* res, auto* req) {
+        spdlog::debug("GET {}", req->getUrl());
+        TRACE_ZONE("http.request");
+        try {
+            NonzeroHeight from { ParameterParser { req->getParameter(0) } };
+            Height to { ParameterParser { req->getParameter(1) } };
+            if (to <= from)
+                throw Error(EMALFORMED);
+            if (!admit(res, Admission::Class::Read))
+                return;
+            blockStreams.emplace(res, BlockStream { .next = from, .to = to });
+            res->onAborted([this, res]() {
+                if (blockStreams.erase(res))
+                    admission.release(Admission::Class::Read);
+            });
+            res->writeHeader("Content-type", "application/x-ndjson; charset=utf-8");
+            fetch_block_stream(res);
+        } catch (Error e) {
+            send_json(res, jsonmsg::serialize(tl::make_unexpected(e.e)));
+        }
+    });
+
+    app.get("/chain/headers/:from/:to", [this](auto* res, auto* req) {
+        spdlog::debug("GET {}", req->getUrl());
+        TRACE_ZONE("http.request");
+        try {
+            NonzeroHeight from { ParameterParser { req->getParameter(0) } };
+            Height to { ParameterParser { req->getParameter(1) } };
+            if (to <= from)
+                throw Error(EMALFORMED);
+            if (!admit(res, Admission::Class::Local))
+                return;
+            headerStreams.emplace(res, HeaderStream { .chain { get_chain_headers() }, .next = from, .to = to });
+            res->onAborted([this, res]() { headerStreams.erase(res); });
+            res->writeHeader("Content-type", "application/octet-stream");
+            write_header_stream(res);
+        } catch (Error e) {
+            send_json(res, jsonmsg::serialize(tl::make_unexpected(e.e)));
+        }
+    });
+}
+
+void HTTPWorker::write_header_stream(uWS::HttpResponse<false>* res)
+{
+    auto iter { headerStreams.find(res) };
+    if (iter == headerStreams.end())
+        return;
+    auto& s { iter->second };
+    auto& hc { s.chain.headers() };
+    const Height to { std::min(s.to, hc.length() + 1) };
+    while (s.next < to) {
+        const NonzeroHeight end { std::min(to.value(), s.next.value() + HEADERBATCHSIZE) };
+        bool writable { true };
+        for (auto& span : hc.header_spans(s.next, end))
+            writable = res->write({ reinterpret_cast<const char*>(span.data()), span.size() });
+        s.next = end;
+        if (!writable && s.next < to) {
+            res->onWritable([this, res](uintmax_t) {
+                write_header_stream(res);
+                return true;
+            });
+            return;
+        }
+    }
+    headerStreams.erase(iter);
+    res->end();
+}
+
+void HTTPWorker::fetch_block_stream(uWS::HttpResponse<false>* res)
+{
+    auto iter { blockStreams.find(res) };
+    if (iter == blockStreams.end() || iter->second.fetching)
+        return;
+    auto& s { iter->second };
+    s.fetching = true;
+    const Height end { std::min(s.to.value(), s.next.value() + blockStreamChunk) };
+    get_chain_blocks(s.next, end, [this, res](auto& blocks) {
+        lc.loop->defer([this, res, blocks]() { on_block_stream(res, blocks); });
+    });
+}
+
+void HTTPWorker::on_block_stream(uWS::HttpResponse<false>* res, const std::vector<API::Block>& blocks)
+{
+    auto iter { blockStreams.find(res) };
+    if (iter == blockStreams.end())
+        return; // aborted
+    auto& s { iter->second };
+    s.fetching = false;
+    std::string lines;
+    for (auto& b : blocks) {
+        lines += jsonmsg::dump_compact(b);
+        lines += '\n';
+    }
+    if (!blocks.empty())
+        s.next = blocks.back().height + 1;
+    if (blocks.empty() || s.next >= s.to) { // done or beyond the chain head
+        blockStreams.erase(iter);
+        admission.release(Admission::Class::Read);
+        res->end(lines);
+        return;
+    }
+    if (res->write(lines))
+        fetch_block_stream(res);
+    else
+        res->onWritable([this, res](uintmax_t) {
+            fetch_block_stream(res);
+            return true;
+        });
+}
+
+namespace {
+// replay pauses while more is buffered on the socket
+constexpr size_t feedBackpressure { 1 << 20 };
+}
+
+void HTTPWorker::feed_routes()
+{
+    app.ws<FeedWsData>("/ws/chain/feed/:height", {
+            .maxBackpressure = 64 * feedBackpressure,
+            .closeOnBackpressureLimit = true,
+            .upgrade = [this](auto* res, auto* req, auto* context) {
+                try {
+                    Height h { uint32_t(ParameterParser { req->getParameter(0) }) };
+                    h.nonzero_throw(EBADHEIGHT);
+                    res->template upgrade<FeedWsData>({ nextFeedId++, h },
+                        req->getHeader("sec-websocket-key"),
+                        req->getHeader("sec-websocket-protocol"),
+                        req->getHeader("sec-websocket-extensions"),
+                        context);
+                } catch (Error e) {
+                    send_json(res, jsonmsg::serialize(tl::make_unexpected(e.e)));
+                }
+            },
+            .open = [this](auto* ws) {
+                auto& d { *ws->getUserData() };
+                ws->subscribe(feedMempoolTopic);
+                feeds.emplace(d.id, Feed { .ws = ws, .next = d.from.nonzero_assert() });
+                replay_feed(d.id);
+            },
+            .drain = [this](auto* ws) {
+                replay_feed(ws->getUserData()->id);
+            },
+            .close = [this](auto* ws, int, std::string_view) {
+                feeds.erase(ws->getUserData()->id);
+            },
+        });
+}
+
+void HTTPWorker::replay_feed(uint64_t id)
+{
+    auto iter { feeds.find(id) };
+    if (iter == feeds.end())
+        return;
+    auto& f { iter->second };
+    if (f.fetching || f.ws->getBufferedAmount() > feedBackpressure)
+        return;
+    f.fetching = true;
+    get_chain_block(API::HeightOrHash { Height(f.next) }, [this, id](auto& b) {
+        lc.loop->defer([this, id, b]() { on_feed_block(id, b); });
+    });
+}
+
+void HTTPWorker::on_feed_block(uint64_t id, const tl::expected<API::Block, int32_t>& b)
+{
+    auto iter { feeds.find(id) };
+    if (iter == feeds.end())
+        return;
+    auto& f { iter->second };
+    f.fetching = false;
+    if (b.has_value()) {
+        feed_connected(f, *b);
+        replay_feed(id);
+        return;
+    }
+    // beyond the chain head, blocks published meanwhile follow and
+    // further events are received as a topic subscriber
+    for (auto& lb : f.backlog)
+        feed_connected(f, lb);
+    f.ws->subscribe(feedChainTopic);
+    feeds.erase(iter);
+}
+
+void HTTPWorker::feed_connected(Feed& f, const API::Block& b)
+{
+    // skips blocks that were already sent by the replay
+    if (b.height != f.next)
+        return;
+    f.ws->send(jsonmsg::dump_feed_event(b), uWS::OpCode::TEXT);
+    f.next = b.height + 1;
+}
+
+void HTTPWorker::async_reply(uWS::HttpResponse<false>* res, std::string json, bool zstd)
+{
+    lc.loop->defer([this, res, r = make_reply(std::move(json), zstd)]() {
+        send_reply(res, r);
+    });
+}
+
+void HTTPWorker::send_reply(uWS::HttpResponse<false>* res, const HTTPReply& r)
+{
+    TRACE_ZONE("http.reply");
     auto iter = pendingRequests.find(res);
     if (iter != pendingRequests.end()) {
-        send_json(res, s);
+        send_json(res, r, iter->second.zstd);
+        admission.release(iter->second.admitted);
         pendingRequests.erase(iter);
     }
 }
 
-void HTTPEndpoint::on_aborted(uWS::HttpResponse<false>* res)
+bool HTTPWorker::admit(uWS::HttpResponse<false>* res, Admission::Class c)
 {
-    pendingRequests.erase(res);
+    if (admission.allow(res->getRemoteAddress()) && admission.acquire(c))
+        return true;
+    static auto& shed { metrics::counter("warthog_api_shed_total",
+        "API requests rejected by the rate or in-flight limits") };
+    shed.inc();
+    res->writeStatus("429 Too Many Requests");
+    send_json(res, jsonmsg::serialize(tl::make_unexpected(ERATELIMIT)));
+    return false;
+}
+
+void HTTPWorker::on_aborted(uWS::HttpResponse<false>* res)
+{
+    auto iter = pendingRequests.find(res);
+    if (iter != pendingRequests.end()) {
+        admission.release(iter->second.admitted);
+        pendingRequests.erase(iter);
+    }
 }
 
-void HTTPEndpoint::on_listen(us_listen_socket_t* ls)
+void HTTPWorker::on_listen(us_listen_socket_t* ls)
 {
     listen_socket = ls;
     if (listen_socket) {
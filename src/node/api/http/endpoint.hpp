@@ -1,62 +1,235 @@
 #pragma once
 #define UWS_NO_ZLIB
+#include "admission.hpp"
 #include "api/types/all.hpp"
 #include "block/block.hpp"
+#include "eventloop/types/chainstate.hpp"
 #include "general/tcp_util.hpp"
 #include "uwebsockets/App.h"
+#include <chrono>
+#include <map>
+#include <memory>
 #include <thread>
+#include <unordered_map>
 #include <variant>
 
-using WebsocketEvent = std::variant<API::Block>;
+using WebsocketEvent = std::variant<API::Block, API::MiningUpdate, API::Rollback, API::MempoolChange>;
+
+// event together with its websocket messages, serialized once by the
+// endpoint and published to the topics of every worker
+struct SerializedEvent {
+    SerializedEvent(WebsocketEvent);
+    WebsocketEvent event;
+    std::string block; // /ws_sneak_peek message, blocks only
+    std::string feed; // chain feed message, empty for mining updates
+};
+
+// serialized reply, large replies carry a zstd compressed copy for clients
+// that accept it
+struct HTTPReply {
+    std::string json;
+    std::optional<std::string> zstd;
+};
 
 struct Config;
-class HTTPEndpoint {
+// One uWS event loop thread serving the API. All workers listen on the same
+// port (uSockets enables SO_REUSEPORT) such that the kernel distributes
+// connections, each worker owns its pending requests and reply cache.
+class HTTPWorker {
 public:
-    HTTPEndpoint(const Config&);
-    ~HTTPEndpoint()
+    HTTPWorker(const Config&);
+    ~HTTPWorker()
     {
-        lc.loop->defer(std::bind(&HTTPEndpoint::shutdown, this));
+        lc.loop->defer(std::bind(&HTTPWorker::shutdown, this));
         t.join();
     }
-    void push_event(WebsocketEvent e)
+    void push_event(std::shared_ptr<const SerializedEvent> e)
     {
-        lc.loop->defer([this, e = std::move(e)]() mutable {
-            on_event(std::move(e));
+        lc.loop->defer([this, e = std::move(e)]() {
+            on_event(*e);
         });
     };
 
 private:
-    void async_reply(uWS::HttpResponse<false>* res, std::string reply)
-    {
-        lc.loop->defer(std::bind(&HTTPEndpoint::send_reply, this, res, std::move(reply)));
-    }
+    // compresses on the calling thread, off the event loop
+    void async_reply(uWS::HttpResponse<false>* res, std::string json, bool zstd);
     void work();
     void shutdown();
-    void on_event(WebsocketEvent&& e);
+    void on_event(const SerializedEvent&);
 
-    void send_reply(uWS::HttpResponse<false>* res, const std::string& s);
+    void send_reply(uWS::HttpResponse<false>* res, const HTTPReply&);
+    // replies 429 if the client exceeds its rate or the class its limit
+    [[nodiscard]] bool admit(uWS::HttpResponse<false>* res, Admission::Class);
     void get(std::string pattern, auto asyncfun, auto serializer);
     void get(std::string pattern, auto asyncfun);
     void get_1(std::string pattern, auto asyncfun);
     void get_2(std::string pattern, auto asyncfun);
+    void get_3(std::string pattern, auto asyncfun);
     void post(std::string pattern, auto parser, auto asyncfun);
 
+    //////////////////////////////
+    // serialized replies of hot read endpoints, shared by identical
+    // requests until the chain head (or the mining template) changes
+    enum class CacheScope { Head,
+        Mining };
+    struct CachedReply {
+        CacheScope scope;
+        uint64_t generation; // of the scope when fetched
+        bool fetching { false };
+        std::optional<HTTPReply> reply {};
+        std::chrono::steady_clock::time_point expires {};
+        std::vector<uWS::HttpResponse<false>*> waiters {};
+    };
+    void get_cached(std::string pattern, CacheScope, auto asyncfun, auto serializer);
+    void get_cached(std::string pattern, CacheScope, auto asyncfun);
+    void get_1_cached(std::string pattern, CacheScope, auto asyncfun);
+    void reply_cached(uWS::HttpResponse<false>* res, bool zstd, std::string key, CacheScope, auto fetch);
+    void on_cached_reply(const std::string& key, HTTPReply);
+    void invalidate_cached(CacheScope);
+    uint64_t& generation(CacheScope s) { return s == CacheScope::Head ? headGeneration : miningGeneration; }
+
     //////////////////////////////
     // handlers
     void on_aborted(uWS::HttpResponse<false>* res);
     void on_listen(us_listen_socket_t* ls);
 
     //////////////////////////////
-    // handlers for websocket events
-    void handle_event(const API::Block&);
+    // handlers for websocket events, subscribers receive the serialized
+    // messages via uWS topics, sockets exceeding their backpressure limit
+    // are closed instead of buffering without bound
+    void handle_event(const API::Block&, const SerializedEvent&);
+    void handle_event(const API::MiningUpdate&, const SerializedEvent&);
+    void handle_event(const API::Rollback&, const SerializedEvent&);
+    void handle_event(const API::MempoolChange&, const SerializedEvent&);
+
+    //////////////////////////////
+    // push based mining tasks (websocket and long-poll)
+    struct MiningSubscription {
+        size_t websockets { 0 };
+        std::vector<uWS::HttpResponse<false>*> waiters; // long-poll requests
+        std::chrono::steady_clock::time_point refresh; // next periodic refresh
+        bool fetching { false };
+        bool outdated { false }; // changed while fetching
+    };
+    using MiningSubscriptions = std::map<Address, MiningSubscription, Address::Comparator>;
+    struct MiningWsData {
+        std::optional<Address> address;
+    };
+    void mining_routes();
+    MiningSubscription& mining_subscription(const Address&);
+    void release_mining_subscription(MiningSubscriptions::iterator);
+    void fetch_mining(const Address&);
+    void on_mining_task(const Address&, std::string json);
+    void on_mining_timer();
+
+    //////////////////////////////
+    // address subscriptions: websockets are notified of every block that
+    // touches their address, together with the balance after it
+    struct AddressHasher {
+        size_t operator()(const Address& a) const
+        {
+            size_t h;
+            memcpy(&h, a.data(), sizeof(h));
+            return h;
+        }
+    };
+    struct AccountWsData {
+        std::optional<Address> address;
+    };
+    void account_routes();
+    void notify_accounts(const API::Block&);
+
+    //////////////////////////////
+    // block ranges streamed as NDJSON, read in chunks from the database and
+    // paused while the client does not keep up
+    struct BlockStream {
+        NonzeroHeight next;
+        Height to; // exclusive
+        bool fetching { false };
+    };
+    void block_stream_routes();
+    void fetch_block_stream(uWS::HttpResponse<false>*);
+    void on_block_stream(uWS::HttpResponse<false>*, const std::vector<API::Block>&);
+
+    //////////////////////////////
+    // account history exported as CSV or NDJSON, oldest first, one read
+    // pool query per chunk which resumes after the last exported id
+    struct HistoryExportStream {
+        Address address;
+        bool csv;
+        uint64_t afterId { 0 };
+        bool fetching { false };
+    };
+    void fetch_history_export(uWS::HttpResponse<false>*);
+    void on_history_export(uWS::HttpResponse<false>*, const tl::expected<API::HistoryExport, int32_t>&);
+
+    //////////////////////////////
+    // raw 80 byte headers streamed from the batches of a chain snapshot
+    struct HeaderStream {
+        ConsensusSlave chain; // keeps the batches alive
+        NonzeroHeight next;
+        Height to; // exclusive
+    };
+    void write_header_stream(uWS::HttpResponse<false>*);
+
+    //////////////////////////////
+    // chain event feed: connected blocks are replayed from the database
+    // starting at a height given by the client, after reaching the chain
+    // head connected, disconnected and mempool events are streamed live.
+    // Only replaying feeds are tracked, live feeds are topic subscribers.
+    struct FeedWsData {
+        uint64_t id { 0 };
+        Height from { 0 };
+    };
+    using FeedSocket = uWS::WebSocket<false, true, FeedWsData>;
+    struct Feed {
+        FeedSocket* ws;
+        NonzeroHeight next; // height of the next connected event
+        bool fetching { false };
+        std::vector<API::Block> backlog {}; // live blocks during the replay
+    };
+    void feed_routes();
+    void replay_feed(uint64_t id);
+    void on_feed_block(uint64_t id, const tl::expected<API::Block, int32_t>&);
+    void feed_connected(Feed&, const API::Block&);
 
     //////////////////////////////
     // variables
-    std::set<uWS::HttpResponse<false>*> pendingRequests;
+    struct Pending {
+        bool zstd; // client accepts zstd
+        Admission::Class admitted;
+    };
+    std::map<uWS::HttpResponse<false>*, Pending> pendingRequests;
+    std::map<std::string, CachedReply> cachedReplies; // by url
+    uint64_t headGeneration { 0 };
+    uint64_t miningGeneration { 0 };
+    MiningSubscriptions miningSubscriptions;
+    std::unordered_map<Address, size_t, AddressHasher> accountSubscriptions; // websockets per address
+    std::map<uWS::HttpResponse<false>*, BlockStream> blockStreams;
+    std::map<uWS::HttpResponse<false>*, HeaderStream> headerStreams;
+    std::map<uWS::HttpResponse<false>*, HistoryExportStream> historyExports;
+    std::map<uint64_t, Feed> feeds; // replaying
+    uint64_t nextFeedId { 0 };
+    us_timer_t* miningTimer { nullptr };
     EndpointAddress bind;
+    Admission admission;
     us_listen_socket_t* listen_socket = nullptr;
     const uWS::LoopCleaner lc;
     uWS::App app;
     bool bshutdown = false;
     std::thread t;
 };
+
+class HTTPEndpoint {
+public:
+    HTTPEndpoint(const Config&);
+    void push_event(const WebsocketEvent& e)
+    {
+        auto serialized { std::make_shared<const SerializedEvent>(e) };
+        for (auto& w : workers)
+            w->push_event(serialized);
+    }
+
+private:
+    std::vector<std::unique_ptr<HTTPWorker>> workers;
+};
@@ -3,6 +3,7 @@
 #include "block/header/header_impl.hpp"
 #include "block/header/view.hpp"
 #include "chainserver/transaction_ids.hpp"
+#include "communication/messages.hpp"
 #include "communication/mining_task.hpp"
 #include "crypto/crypto.hpp"
 #include "eventloop/eventloop.hpp"
@@ -34,9 +35,9 @@ struct Inspector {
         auto& m = e.connections;
         return std::tuple { &m.verified, &m.failedAddresses.data(), &m.unverifiedAddresses, &m.pendingOutgoing };
     }
-    static auto& ip_counter(const Conman& c)
+    static const SharedIpCounter& ip_counter(const Conman& c)
     {
-        return c.perIpCounter;
+        return *c.perIpCounter;
     }
     static auto header_download(const Eventloop& e)
     {
@@ -47,7 +48,7 @@ struct Inspector {
         j["leaderListSize"] = d.leaderList.size();
         j["config"] = json {
             { "maxLeaders", d.maxLeaders },
-            { "pendingDepth", d.pendingDepth }
+            { "pendingDepth", d.pending_depth() }
         };
         {
             json qb;
@@ -68,25 +69,24 @@ struct Inspector {
     {
         auto now = steady_clock::now();
         auto& m = c.connections;
-        using VerIter = decltype(c.connections)::VerIter;
-        using PinIter = decltype(c.connections)::PinIter;
         json j;
         json verifiers = json::array();
         json pins = json::array();
-        for (auto& [t, v] : m.timer) {
+        auto timers { m.timer };
+        std::sort(timers.begin(), timers.end(), [](auto& t1, auto& t2) { return t1.expires < t2.expires; });
+        for (auto& t : timers) {
+            if (!m.active(t))
+                continue;
             json e;
-            e["expiresSeconds"] = duration_cast<seconds>(t - now).count();
-            if (std::holds_alternative<VerIter>(v)) {
-                auto& iter = std::get<VerIter>(v);
-                auto& n = iter->second;
-                e["endpoint"] = iter->first.to_string();
+            e["expiresSeconds"] = duration_cast<seconds>(t.expires - now).count();
+            e["endpoint"] = t.address.to_string();
+            if (!t.pin) {
+                auto& n = m.verified.find(t.address)->second;
                 e["seenSecondsAgo"] = n.outboundConnection ? 0 : duration_cast<seconds>(now - n.lastVerified).count();
+                e["score"] = n.score();
                 verifiers.push_back(e);
             } else {
-                assert(std::holds_alternative<PinIter>(v));
-                auto& iter = std::get<PinIter>(v);
-                e["endpoint"] = iter->first.to_string();
-                e["sleepOnFailedSeconds"] = iter->second.sleepSeconds;
+                e["sleepOnFailedSeconds"] = m.pinned.find(t.address)->second.sleepSeconds;
                 pins.push_back(e);
             }
         }
@@ -97,8 +97,7 @@ struct Inspector {
 };
 
 namespace {
-template <typename T>
-json verified_json(const std::map<EndpointAddress, T>& map)
+json verified_json(const auto& map)
 {
     using namespace std::chrono;
     auto now = steady_clock::now();
@@ -108,12 +107,16 @@ json verified_json(const std::map<EndpointAddress, T>& map)
         j["endpoint"] = a.to_string();
         j["seenSecondsAgo"] = n.outboundConnection ? 0 : duration_cast<seconds>(now - n.lastVerified).count();
         j["outboundConnection"] = n.outboundConnection;
+        j["successes"] = n.successes;
+        j["failures"] = n.failures;
+        if (n.latency)
+            j["latencyMs"] = n.latency->count();
 
         e.push_back(j);
     }
     return e;
 }
-json pending_json(const std::map<EndpointAddress, std::chrono::steady_clock::time_point>& m)
+json pending_json(const auto& m)
 {
     auto now = steady_clock::now();
     json e = json::array();
@@ -144,66 +147,61 @@ json grid_json(const Grid& g)
     return out;
 }
 
-json header_json(const Header& header, NonzeroHeight height)
+void write_header(jsonmsg::JsonWriter& w, const Header& header, NonzeroHeight height)
 {
-    auto verusHash{verus_hash(header)};
-    auto blockHash{header.hash()};
-    auto sha256tHash{hashSHA256(blockHash)};
+    auto verusHash { verus_hash(header) };
+    auto blockHash { header.hash() };
+    auto sha256tHash { hashSHA256(blockHash) };
     auto target { header.target(height) };
     uint32_t targetBE = hton32(target.binary());
-    json h;
-    h["raw"] = serialize_hex(header.data(), header.size());
-    h["timestamp"] = header.timestamp();
-    h["utc"] = format_utc(header.timestamp());
-    h["target"] = serialize_hex(targetBE);
-    h["difficulty"] = target.difficulty();
-    h["hash"] = serialize_hex(header.hash());
-    h["pow"] = json{
-        {"hashVerus",serialize_hex(verusHash)},
-        {"hashSha256t",serialize_hex(sha256tHash)},
-        {"floatVerus",CustomFloat(verusHash).to_double()},
-        {"floatSha256t",CustomFloat(sha256tHash).to_double()},
-    };
-    h["merkleroot"] = serialize_hex(header.merkleroot());
-    h["nonce"] = serialize_hex(header.nonce());
-    h["prevHash"] = serialize_hex(header.prevhash());
-    h["version"] = serialize_hex(header.version());
-    return h;
-}
-
-[[nodiscard]] json body_json(const API::Block& b)
-{
-    json out;
-    { // rewards
-        json a = json::array();
-        for (auto& r : b.rewards) {
-            json elem;
-            elem["txHash"] = serialize_hex(r.txhash);
-            elem["toAddress"] = r.toAddress.to_string();
-            elem["amount"] = r.amount.to_string();
-            elem["amountE8"] = r.amount.E8();
-            a.push_back(elem);
-        }
-        out["rewards"] = a;
-    }
-    { // transfers
-        json a = json::array();
-        for (auto& t : b.transfers) {
-            json elem;
-            elem["fromAddress"] = t.fromAddress.to_string();
-            elem["fee"] = t.fee.to_string();
-            elem["feeE8"] = t.fee.E8();
-            elem["nonceId"] = t.nonceId;
-            elem["pinHeight"] = t.pinHeight;
-            elem["txHash"] = serialize_hex(t.txhash);
-            elem["toAddress"] = t.toAddress.to_string();
-            elem["amount"] = t.amount.to_string();
-            elem["amountE8"] = t.amount.E8();
-            a.push_back(elem);
-        }
-        out["transfers"] = a;
+    w.begin_object()
+        .field("difficulty", target.difficulty())
+        .hex_field("hash", blockHash)
+        .hex_field("merkleroot", header.merkleroot())
+        .field("nonce", serialize_hex(header.nonce()))
+        .key("pow")
+        .begin_object()
+        .field("floatSha256t", CustomFloat(sha256tHash).to_double())
+        .field("floatVerus", CustomFloat(verusHash).to_double())
+        .hex_field("hashSha256t", sha256tHash)
+        .hex_field("hashVerus", verusHash)
+        .end_object()
+        .hex_field("prevHash", header.prevhash())
+        .key("raw")
+        .hex(header.data(), header.size())
+        .field("target", serialize_hex(targetBE))
+        .field("timestamp", header.timestamp())
+        .field("utc", format_utc(header.timestamp()))
+        .field("version", serialize_hex(header.version()))
+        .end_object();
+}
+
+void write_body(jsonmsg::JsonWriter& w, const API::Block& b)
+{
+    w.begin_object().key("rewards").begin_array();
+    for (auto& r : b.rewards) {
+        w.begin_object()
+            .field("amount", r.amount.to_string())
+            .field("amountE8", r.amount.E8())
+            .field("toAddress", r.toAddress.to_string())
+            .hex_field("txHash", r.txhash)
+            .end_object();
     }
-    return out;
+    w.end_array().key("transfers").begin_array();
+    for (auto& t : b.transfers) {
+        w.begin_object()
+            .field("amount", t.amount.to_string())
+            .field("amountE8", t.amount.E8())
+            .field("fee", t.fee.to_string())
+            .field("feeE8", t.fee.E8())
+            .field("fromAddress", t.fromAddress.to_string())
+            .field("nonceId", t.nonceId)
+            .field("pinHeight", t.pinHeight)
+            .field("toAddress", t.toAddress.to_string())
+            .hex_field("txHash", t.txhash)
+            .end_object();
+    }
+    w.end_array().end_object();
 }
 
 } // namespace
@@ -267,11 +265,11 @@ json to_json(const API::Head& h)
     return j;
 }
 
-json to_json(const std::pair<NonzeroHeight, Header>& h)
+void write_json(JsonWriter& w, const std::pair<NonzeroHeight, Header>& h)
 {
-    return json {
-        { "header", header_json(h.second, h.first) }
-    };
+    w.begin_object().key("header");
+    write_header(w, h.second, h.first);
+    w.end_object();
 }
 
 json to_json(const MiningTask& mt)
@@ -284,25 +282,43 @@ json to_json(const MiningTask& mt)
     j["height"] = height;
     return j;
 }
-json to_json(const API::MempoolEntries& entries)
-{
-    json j;
-    json a = json::array();
-    for (auto& e : entries.entries) {
-        json elem;
-        elem["fromAddress"] = e.from_address(e.txHash).to_string();
-        elem["pinHeight"] = e.pin_height();
-        elem["txHash"] = serialize_hex(e.txHash);
-        elem["nonceId"] = e.nonce_id();
-        elem["fee"] = e.fee().to_string();
-        elem["feeE8"] = e.fee().E8();
-        elem["toAddress"] = e.toAddr.to_string();
-        elem["amount"] = e.amount.to_string();
-        elem["amountE8"] = e.amount.E8();
-        a.push_back(elem);
-    }
-    j["data"] = a;
-    return j;
+void write_json(JsonWriter& w, const API::MempoolPage& p)
+{
+    auto write_row { [&](const mempool::Snapshot::Row& r) {
+        auto& [txid, v] { r.entry };
+        w.begin_object()
+            .field("amount", v.amount.to_string())
+            .field("amountE8", v.amount.E8())
+            .field("fee", v.fee.uncompact().to_string())
+            .field("feeE8", v.fee.uncompact().E8())
+            .field("fromAddress", r.from.to_string())
+            .field("nonceId", txid.nonceId)
+            .field("pinHeight", txid.pinHeight)
+            .field("toAddress", v.toAddr.to_string())
+            .hex_field("txHash", v.hash)
+            .end_object();
+    } };
+    auto& rows { p.snapshot->rows };
+    size_t total { 0 };
+    w.begin_object().key("data").begin_array();
+    if (p.address) { // matches are counted in full, only the page is written
+        for (auto& r : rows) {
+            if (r.from != *p.address && r.entry.second.toAddr != *p.address)
+                continue;
+            if (total >= p.offset && total - p.offset < p.limit)
+                write_row(r);
+            total += 1;
+        }
+    } else {
+        total = rows.size();
+        for (size_t i { p.offset }; i < total && i - p.offset < p.limit; ++i)
+            write_row(rows[i]);
+    }
+    w.end_array()
+        .field("offset", p.offset)
+        .field("total", total)
+        .field("version", p.snapshot->version)
+        .end_object();
 }
 
 json to_json(const API::Transaction& tx)
@@ -313,74 +329,225 @@ json to_json(const API::Transaction& tx)
         tx);
 }
 
-json to_json(const API::TransactionsByBlocks& txs)
+void write_json(JsonWriter& w, const API::TransactionsByBlocks& txs)
 {
-    json arr = json::array();
-    for (auto iter = txs.blocks_reversed.begin(); iter != txs.blocks_reversed.end(); ++iter) {
-        auto& block{*iter};
-        arr.push_back(
-            json {
-                { "header", header_json(block.header, block.height) },
-                { "body", body_json(block) },
-                { "timestamp", block.header.timestamp() },
-                { "utc", format_utc(block.header.timestamp()) },
-                { "confirmations", block.confirmations },
-                { "height", block.height } });
+    w.begin_object()
+        .field("count", txs.count)
+        .field("fromId", txs.fromId)
+        .key("perBlock")
+        .begin_array();
+    for (auto& block : txs.blocks_reversed)
+        write_json(w, block);
+    w.end_array().end_object();
+}
+
+void write_json(JsonWriter& w, const API::Block& block)
+{
+    HeaderView hv(block.header.data());
+    w.begin_object().key("body");
+    write_body(w, block);
+    w.field("confirmations", block.confirmations).key("header");
+    write_header(w, block.header, block.height);
+    w.field("height", block.height)
+        .field("timestamp", hv.timestamp())
+        .field("utc", format_utc(hv.timestamp()))
+        .end_object();
+}
+
+std::string dump_compact(const API::Block& block)
+{
+    std::string out;
+    JsonWriter w(out, false);
+    write_json(w, block);
+    return out;
+}
+
+std::string dump_account_event(const API::Block& b, const Address& a, const API::Balance& balance)
+{
+    API::Block filtered(b.header, b.height, b.confirmations);
+    for (auto& r : b.rewards) {
+        if (r.toAddress == a)
+            filtered.rewards.push_back(r);
     }
-    return json {
-        { "fromId", txs.fromId },
-        { "count", txs.count },
-        { "perBlock", arr }
-    };
+    for (auto& t : b.transfers) {
+        if (t.fromAddress == a || t.toAddress == a)
+            filtered.transfers.push_back(t);
+    }
+    std::string out;
+    JsonWriter w(out, false);
+    w.begin_object()
+        .field("address", a.to_string())
+        .field("balance", balance.balance.to_string())
+        .field("balanceE8", balance.balance.E8())
+        .hex_field("blockHash", b.header.hash())
+        .field("height", b.height)
+        .key("transactions");
+    write_body(w, filtered);
+    w.end_object();
+    return out;
+}
+
+std::string dump_feed_event(const API::Block& b)
+{
+    std::string out;
+    JsonWriter w(out, false);
+    w.begin_object().key("block");
+    write_json(w, b);
+    w.field("type", "connected").end_object();
+    return out;
+}
 
-    return arr;
+void append_history_export(std::string& out, const API::HistoryExport& h, bool csv)
+{
+    for (auto& e : h.entries) {
+        if (csv) {
+            out += std::to_string(e.id.value()) + ',' + std::to_string(e.height.value()) + ','
+                + std::to_string(e.timestamp) + ',' + format_utc(e.timestamp) + ','
+                + (e.fromAddress ? "transfer," : "reward,") + serialize_hex(e.txhash) + ','
+                + (e.fromAddress ? e.fromAddress->to_string() : "") + ',' + e.toAddress.to_string() + ','
+                + e.amount.to_string() + ',' + e.fee.to_string() + '\n';
+            continue;
+        }
+        JsonWriter w(out, false);
+        w.begin_object()
+            .field("amount", e.amount.to_string())
+            .field("amountE8", e.amount.E8())
+            .field("fee", e.fee.to_string())
+            .field("feeE8", e.fee.E8())
+            .key("fromAddress");
+        if (e.fromAddress)
+            w.value(e.fromAddress->to_string());
+        else
+            w.value(nullptr);
+        w.field("height", e.height)
+            .field("id", e.id)
+            .field("timestamp", e.timestamp)
+            .field("toAddress", e.toAddress.to_string())
+            .hex_field("txHash", e.txhash)
+            .field("type", e.fromAddress ? "transfer" : "reward")
+            .field("utc", format_utc(e.timestamp))
+            .end_object();
+        out += '\n';
+    }
 }
 
-json to_json(const API::Block& block)
+std::string dump_feed_event(const API::Rollback& r)
 {
-    json j;
-    HeaderView hv(block.header.data());
-    j["header"] = header_json(block.header, block.height);
-    j["body"] = body_json(block);
-    j["timestamp"] = hv.timestamp();
-    j["utc"] = format_utc(hv.timestamp());
-    j["confirmations"] = block.confirmations;
-    j["height"] = block.height;
-    return j;
+    std::string out;
+    JsonWriter w(out, false);
+    w.begin_object()
+        .field("length", r.length)
+        .field("type", "disconnected")
+        .end_object();
+    return out;
 }
 
-json to_json(const API::AccountHistory& h)
+std::string dump_feed_event(const API::MempoolChange& c)
 {
-    json a = json::array();
+    auto txid = [](JsonWriter& w, const TransactionId& id) -> JsonWriter& {
+        return w.field("accountId", id.accountId.value())
+            .field("nonceId", id.nonceId)
+            .field("pinHeight", id.pinHeight);
+    };
+    std::string out;
+    JsonWriter w(out, false);
+    w.begin_object().key("added").begin_array();
+    for (auto& [id, hash] : c.added) {
+        w.begin_object();
+        txid(w, id).hex_field("txHash", hash).end_object();
+    }
+    w.end_array().key("removed").begin_array();
+    for (auto& id : c.removed) {
+        w.begin_object();
+        txid(w, id).end_object();
+    }
+    w.end_array().field("type", "mempool").end_object();
+    return out;
+}
+
+void write_json(JsonWriter& w, const API::AccountHistory& h)
+{
+    w.begin_object()
+        .field("balance", h.balance.to_string())
+        .field("balanceE8", h.balance.E8())
+        .field("count", h.count)
+        .field("countExact", h.count < API::AccountHistory::MAXCOUNT)
+        .field("fromId", h.fromId)
+        .key("nextCursor");
+    if (h.nextCursor)
+        w.value(*h.nextCursor);
+    else
+        w.value(nullptr);
+    w.key("perBlock")
+        .begin_array();
     auto& reversed = h.blocks_reversed;
     for (size_t i = 0; i < reversed.size(); ++i) {
         auto& b = reversed[reversed.size() - 1 - i];
-        json elem;
-        elem["height"] = b.height;
-        elem["confirmations"] = b.confirmations;
-        elem["transactions"] = body_json(b);
-        a.push_back(elem);
+        w.begin_object()
+            .field("confirmations", b.confirmations)
+            .field("height", b.height)
+            .key("transactions");
+        write_body(w, b);
+        w.end_object();
     }
-    json j;
-    j["perBlock"] = a;
-    j["fromId"] = h.fromId;
-    j["balance"] = h.balance.to_string();
-    j["balanceE8"] = h.balance.E8();
-    return j;
+    w.end_array().end_object();
 }
 
-json to_json(const API::Richlist& l)
+void write_json(JsonWriter& w, const API::Richlist& l)
 {
-    json a = json::array();
+    w.begin_array();
     for (auto& [address, balance] : l.entries) {
-        json elem;
-        elem["address"] = address.to_string();
-        elem["balance"] = balance.to_string();
-        elem["balanceE8"] = balance.E8();
-        a.push_back(elem);
+        w.begin_object()
+            .field("address", address.to_string())
+            .field("balance", balance.to_string())
+            .field("balanceE8", balance.E8())
+            .end_object();
+    }
+    w.end_array();
+}
+
+void write_json(JsonWriter& w, const API::MempoolInsertResults& r)
+{
+    w.begin_array();
+    for (auto c : r.codes) {
+        w.begin_object().field("code", c).key("error");
+        if (c == 0)
+            w.value(nullptr);
+        else
+            w.value(Error(c).strerror());
+        w.end_object();
+    }
+    w.end_array();
+}
+
+void write_json(JsonWriter& w, const API::Balances& b)
+{
+    w.begin_array();
+    for (auto& e : b.entries) {
+        w.begin_object();
+        if (!e) {
+            w.field("code", e.error()).field("error", Error(e.error()).strerror());
+        } else {
+            auto& [balance, latestHistoryId] { *e };
+            w.field("code", 0).key("error").value(nullptr);
+            w.key("accountId");
+            if (auto v { balance.accountId.value() }; v > 0)
+                w.value(v);
+            else
+                w.value(nullptr);
+            w.field("balance", balance.balance.to_string())
+                .field("balanceE8", balance.balance.E8())
+                .key("latestHistoryId");
+            if (latestHistoryId)
+                w.value(latestHistoryId->value());
+            else
+                w.value(nullptr);
+        }
+        w.end_object();
     }
-    return a;
+    w.end_array();
 }
+
 json to_json(const API::HashrateInfo& hi)
 {
     return json {
@@ -388,18 +555,104 @@ json to_json(const API::HashrateInfo& hi)
     };
 }
 
-json to_json(const API::HashrateChart& c)
+json to_json(const API::FeeEstimate& e)
 {
-    json data(json::array());
-    for (const auto& v : c.chart) {
-        data.push_back(v);
+    auto funds = [](const std::optional<Funds>& f) {
+        return f ? json { { "fee", f->to_string() }, { "feeE8", f->E8() } } : json(nullptr);
+    };
+    json targets(json::array());
+    for (auto& t : e.targets) {
+        targets.push_back(json {
+            { "blocks", t.blocks },
+            { "estimate", funds(t.fee) } });
     }
     return json {
-        { "range", json { { "min", c.range.begin }, { "max", c.range.end } } },
-        { "data", data }
+        { "targets", targets },
+        { "includedMedian", funds(e.includedMedian) },
+        { "samples", e.samples }
+    };
+}
+
+json to_json(const API::ChainOverview& o)
+{
+    return json {
+        { "head", to_json(o.head) },
+        { "hashrate", to_json(o.hashrate) },
+        { "feeEstimate", to_json(o.feeEstimate) }
     };
 }
 
+void write_json(JsonWriter& w, const API::TxProof& p)
+{
+    auto& b { p.branch };
+    w.begin_object()
+        .key("branch")
+        .begin_object()
+        .field("legacy", b.legacy)
+        .key("seed")
+        .hex(b.seed)
+        .key("steps")
+        .begin_array();
+    for (auto& s : b.steps) {
+        w.begin_object().key("sibling");
+        if (s.sibling)
+            w.hex(*s.sibling);
+        else
+            w.value(nullptr);
+        w.field("siblingLeft", s.siblingLeft).end_object();
+    }
+    w.end_array()
+        .end_object()
+        .key("header");
+    write_header(w, p.header, p.height);
+    w.field("height", p.height)
+        .field("historyId", p.historyId)
+        .key("leaf")
+        .hex(p.leaf.data(), p.leaf.size())
+        .hex_field("leafHash", hashSHA256(p.leaf.data(), p.leaf.size()))
+        .field("leafIndex", p.leafIndex)
+        .hex_field("txHash", p.txhash)
+        .end_object();
+}
+
+void write_json(JsonWriter& w, const API::HashrateChart& c)
+{
+    w.begin_object().key("data").begin_array();
+    for (const auto& v : c.chart)
+        w.value(v);
+    w.end_array()
+        .key("range")
+        .begin_object()
+        .field("max", c.range.end)
+        .field("min", c.range.begin)
+        .end_object()
+        .field("step", c.step)
+        .end_object();
+}
+
+void write_json(JsonWriter& w, const API::ChainStats& s)
+{
+    w.begin_object().field("bucketSeconds", s.bucketSeconds).key("buckets").begin_array();
+    for (auto& b : s.buckets) {
+        w.begin_object()
+            .field("accounts", b.accounts)
+            .field("begin", b.begin)
+            .field("blocks", b.blocks)
+            .field("feesE8", b.fees.E8())
+            .field("firstHeight", b.firstHeight)
+            .field("lastHeight", b.lastHeight)
+            .field("newAccounts", b.newAccounts)
+            .field("rewardsE8", b.rewards.E8())
+            .field("supply", b.supply.to_string())
+            .field("supplyE8", b.supply.E8())
+            .field("transactions", b.transactions)
+            .field("transfers", b.transfers)
+            .field("volumeE8", b.volume.E8())
+            .end_object();
+    }
+    w.end_array().end_object();
+}
+
 json to_json(const OffenseEntry& e)
 {
     return json {
@@ -541,4 +794,95 @@ std::string ip_counter(const Conman& e)
     return j.dump(1);
 }
 
+std::string peer_traffic(const std::vector<Conman::APIPeerdata>& peers)
+{
+    auto to_json { [](const Traffic::Counts& c) {
+        return json {
+            { "rxMessages", c.rxMessages },
+            { "rxBytes", c.rxBytes },
+            { "txMessages", c.txMessages },
+            { "txBytes", c.txBytes },
+            { "processSeconds", c.processNs * 1e-9 }
+        };
+    } };
+    json j = json::array();
+    for (auto& p : peers) {
+        Traffic::Counts total;
+        json types = json::object();
+        for (size_t i = 0; i < p.traffic.size(); ++i) {
+            auto& c { p.traffic[i] };
+            if (c.rxMessages == 0 && c.txMessages == 0)
+                continue;
+            total.rxMessages += c.rxMessages;
+            total.rxBytes += c.rxBytes;
+            total.txMessages += c.txMessages;
+            total.txBytes += c.txBytes;
+            total.processNs += c.processNs;
+            types[messages::name(i)] = to_json(c);
+        }
+        json elem(to_json(total));
+        elem["id"] = p.id;
+        elem["endpoint"] = p.address.to_string();
+        elem["sinceTimestamp"] = p.since;
+        elem["types"] = std::move(types);
+        j.push_back(std::move(elem));
+    }
+    return j.dump(1);
+}
+
+// Chrome trace event format, can be loaded in chrome://tracing or Perfetto
+std::string chrome_trace(const std::vector<trace::ThreadEvents>& threads)
+{
+    json events = json::array();
+    for (auto& t : threads) {
+        events.push_back(json {
+            { "name", "thread_name" },
+            { "ph", "M" },
+            { "pid", 1 },
+            { "tid", t.tid },
+            { "args", json { { "name", t.name } } } });
+        for (auto& e : t.events) {
+            events.push_back(json {
+                { "name", e.name },
+                { "ph", "X" },
+                { "pid", 1 },
+                { "tid", t.tid },
+                { "ts", e.beginNs / 1000.0 },
+                { "dur", e.durationNs / 1000.0 } });
+        }
+    }
+    return json { { "traceEvents", std::move(events) }, { "displayTimeUnit", "ms" } }.dump();
+}
+
+std::string memory_usage(const memory_budget::Report& r)
+{
+    json components = json::array();
+    for (auto& c : r.components) {
+        components.push_back(json {
+            { "name", c.name },
+            { "priority", c.priority },
+            { "usageBytes", c.usage },
+            { "limitBytes", c.limit ? json(*c.limit) : json(nullptr) } });
+    }
+    return json { { "budgetBytes", r.total ? json(*r.total) : json(nullptr) }, { "components", std::move(components) } }.dump(1);
+}
+
+std::string block_latency(const std::vector<block_latency::Trace>& traces)
+{
+    using namespace std::chrono;
+    json arr = json::array();
+    for (auto& t : traces) {
+        json stages = json::object();
+        for (size_t i = 0; i < block_latency::nStages; ++i) {
+            auto& d { t.stages[i] };
+            stages[std::string(block_latency::name(block_latency::Stage(i)))] = d ? json(duration<double, std::milli>(*d).count()) : json(nullptr);
+        }
+        arr.push_back(json {
+            { "height", t.height.value() },
+            { "startedAt", duration_cast<milliseconds>(t.started.time_since_epoch()).count() },
+            { "stagesMs", std::move(stages) } });
+    }
+    return arr.dump(1);
+}
+
 } // namespace jsonmsg
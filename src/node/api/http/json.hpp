@@ -1,5 +1,6 @@
 #include "api/interface.hpp"
 #include "general/errors.hpp"
+#include "json_writer.hpp"
 #include "nlohmann/json.hpp"
 struct Head;
 class Hash;
@@ -11,20 +12,41 @@ nlohmann::json to_json(const Grid&);
 nlohmann::json to_json(const NodeVersion&);
 nlohmann::json to_json(const Hash&);
 nlohmann::json to_json(const API::Head&);
-nlohmann::json to_json(const std::pair<NonzeroHeight,Header>&);
 nlohmann::json to_json(const MiningTask&);
-nlohmann::json to_json(const API::MempoolEntries&);
 nlohmann::json to_json(const API::Transaction&);
-nlohmann::json to_json(const API::TransactionsByBlocks&);
-nlohmann::json to_json(const API::Block&);
-nlohmann::json to_json(const API::AccountHistory&);
-nlohmann::json to_json(const API::Richlist&);
 nlohmann::json to_json(const API::HashrateInfo&);
-nlohmann::json to_json(const API::HashrateChart&);
+nlohmann::json to_json(const API::FeeEstimate&);
+nlohmann::json to_json(const API::ChainOverview&);
 nlohmann::json to_json(const OffenseEntry& e);
 nlohmann::json to_json(const std::optional<SignedSnapshot>&);
 nlohmann::json to_json(const chainserver::TransactionIds&);
 nlohmann::json to_json(const API::Round16Bit&);
+// large responses are streamed without building a json tree
+void write_json(JsonWriter&, const std::pair<NonzeroHeight, Header>&);
+void write_json(JsonWriter&, const API::MempoolPage&);
+void write_json(JsonWriter&, const API::TransactionsByBlocks&);
+void write_json(JsonWriter&, const API::Block&);
+void write_json(JsonWriter&, const API::AccountHistory&);
+void write_json(JsonWriter&, const API::Richlist&);
+void write_json(JsonWriter&, const API::HashrateChart&);
+void write_json(JsonWriter&, const API::ChainStats&);
+void write_json(JsonWriter&, const API::MempoolInsertResults&);
+void write_json(JsonWriter&, const API::Balances&);
+void write_json(JsonWriter&, const API::TxProof&);
+std::string dump_compact(const API::Block&); // websocket events
+// address subscription event: the address's transactions in the block
+std::string dump_account_event(const API::Block&, const Address&, const API::Balance&);
+// chain event feed
+std::string dump_feed_event(const API::Block&);
+std::string dump_feed_event(const API::Rollback&);
+std::string dump_feed_event(const API::MempoolChange&);
+// account history export lines
+constexpr std::string_view historyCsvHeader { "id,height,timestamp,utc,type,txHash,fromAddress,toAddress,amount,fee\n" };
+void append_history_export(std::string& out, const API::HistoryExport&, bool csv);
+
+template <typename T>
+concept Streamed = requires(JsonWriter& w, const T& t) { write_json(w, t); };
+
 template <typename T>
 inline nlohmann::json to_json(const std::vector<T>& e)
 {
@@ -70,10 +92,21 @@ std::string serialize(const tl::expected<T, int32_t>& e)
 {
     if (!e.has_value())
         return status(e.error());
-    return nlohmann::json {
-        { "code", 0 },
-        { "data", to_json(*e) }
-    }.dump(1);
+    if constexpr (Streamed<T>) {
+        // reused buffer, the result is copied out with its exact size
+        thread_local std::string buf;
+        buf.clear();
+        JsonWriter w(buf);
+        w.begin_object().field("code", 0).key("data");
+        write_json(w, *e);
+        w.end_object();
+        return buf;
+    } else {
+        return nlohmann::json {
+            { "code", 0 },
+            { "data", to_json(*e) }
+        }.dump(1);
+    }
 }
 
 inline std::string serialize(const std::vector<PeerDB::BanEntry>& banned)
@@ -95,6 +128,10 @@ std::string endpoints(const Eventloop&);
 std::string connect_timers(const Eventloop&);
 std::string header_download(const Eventloop&);
 std::string ip_counter(const Conman&);
+std::string peer_traffic(const std::vector<Conman::APIPeerdata>&);
+std::string chrome_trace(const std::vector<trace::ThreadEvents>&);
+std::string memory_usage(const memory_budget::Report&);
+std::string block_latency(const std::vector<block_latency::Trace>&);
 
 
 }
@@ -0,0 +1,105 @@
+#include "json_writer.hpp"
+#include "general/hex.hpp"
+#include "nlohmann/json.hpp"
+#include <array>
+#include <cassert>
+#include <cmath>
+
+namespace jsonmsg {
+JsonWriter& JsonWriter::value(double d)
+{
+    element();
+    if (!std::isfinite(d)) {
+        out += "null";
+        return *this;
+    }
+    // same shortest round-trip representation as nlohmann::json
+    std::array<char, 64> buf;
+    auto end { nlohmann::detail::to_chars(buf.data(), buf.data() + buf.size(), d) };
+    out.append(buf.data(), end);
+    return *this;
+}
+
+JsonWriter& JsonWriter::hex(const uint8_t* data, size_t size)
+{
+    element();
+    const size_t n { out.size() };
+    out.resize(n + 2 * size + 2);
+    out[n] = '"';
+    serialize_hex(data, size, out.data() + n + 1);
+    out.back() = '"';
+    return *this;
+}
+
+JsonWriter& JsonWriter::open(char c)
+{
+    element();
+    out += c;
+    nonempty.push_back(false);
+    return *this;
+}
+
+JsonWriter& JsonWriter::close(char c)
+{
+    assert(!nonempty.empty());
+    const bool ne { nonempty.back() };
+    nonempty.pop_back();
+    if (ne && pretty) {
+        out += '\n';
+        out.append(nonempty.size(), ' ');
+    }
+    out += c;
+    return *this;
+}
+
+void JsonWriter::separate()
+{
+    assert(!nonempty.empty());
+    if (nonempty.back())
+        out += ',';
+    nonempty.back() = true;
+    if (pretty) {
+        out += '\n';
+        out.append(nonempty.size(), ' ');
+    }
+}
+
+void JsonWriter::string(std::string_view s)
+{
+    out += '"';
+    for (char c : s) {
+        switch (c) {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\b':
+            out += "\\b";
+            break;
+        case '\f':
+            out += "\\f";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        case '\r':
+            out += "\\r";
+            break;
+        case '\t':
+            out += "\\t";
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                constexpr char hex[] = "0123456789abcdef";
+                out += "\\u00";
+                out += hex[c >> 4];
+                out += hex[c & 0xF];
+            } else {
+                out += c;
+            }
+        }
+    }
+}
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include "general/view.hpp"
+#include "general/with_uint64.hpp"
+#include <array>
+#include <charconv>
+#include <concepts>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace jsonmsg {
+// Streaming JSON writer appending directly to a string buffer instead of
+// building an nlohmann::json tree. The pretty format matches
+// nlohmann::json::dump(1) such that converted serializers produce the
+// same output, object keys must therefore be written in sorted order.
+class JsonWriter {
+public:
+    JsonWriter(std::string& out, bool pretty = true)
+        : out(out)
+        , pretty(pretty)
+    {
+    }
+
+    JsonWriter& begin_object() { return open('{'); }
+    JsonWriter& end_object() { return close('}'); }
+    JsonWriter& begin_array() { return open('['); }
+    JsonWriter& end_array() { return close(']'); }
+    JsonWriter& key(std::string_view k)
+    {
+        separate();
+        string(k);
+        out += pretty ? "\": " : "\":";
+        afterKey = true;
+        return *this;
+    }
+
+    JsonWriter& value(std::string_view s)
+    {
+        element();
+        string(s);
+        out += '"';
+        return *this;
+    }
+    JsonWriter& value(const char* s) { return value(std::string_view(s)); }
+    JsonWriter& value(const std::string& s) { return value(std::string_view(s)); }
+    JsonWriter& value(bool b)
+    {
+        element();
+        out += b ? "true" : "false";
+        return *this;
+    }
+    JsonWriter& value(std::nullptr_t)
+    {
+        element();
+        out += "null";
+        return *this;
+    }
+    JsonWriter& value(double d);
+    template <typename T>
+    requires(std::integral<T> && !std::same_as<T, bool>)
+    JsonWriter& value(T v)
+    {
+        element();
+        char buf[24];
+        auto res { std::to_chars(buf, buf + sizeof(buf), v) };
+        out.append(buf, res.ptr);
+        return *this;
+    }
+    JsonWriter& value(const IsUint32& v) { return value(v.value()); }
+    JsonWriter& value(const IsUint64& v) { return value(v.value()); }
+
+    // hex string encoded directly into the buffer
+    JsonWriter& hex(const uint8_t* data, size_t size);
+    template <size_t N>
+    JsonWriter& hex(const std::array<uint8_t, N>& a) { return hex(a.data(), N); }
+    template <size_t N>
+    JsonWriter& hex(View<N> v) { return hex(v.data(), N); }
+
+    template <typename T>
+    JsonWriter& field(std::string_view k, const T& v)
+    {
+        key(k);
+        return value(v);
+    }
+    template <typename T>
+    JsonWriter& hex_field(std::string_view k, const T& v)
+    {
+        key(k);
+        return hex(v);
+    }
+
+private:
+    JsonWriter& open(char c);
+    JsonWriter& close(char c);
+    void separate(); // newline and indentation before a member or element
+    void element()
+    {
+        if (!std::exchange(afterKey, false) && !nonempty.empty())
+            separate();
+    }
+    void string(std::string_view); // opening quote and escaped content
+
+    std::string& out;
+    const bool pretty;
+    bool afterKey { false };
+    std::vector<bool> nonempty; // per open container
+};
+}
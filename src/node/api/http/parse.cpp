@@ -118,12 +118,67 @@ RecoverableSignature extract_signature(const nlohmann::json& json)
 }
 }
 
+namespace {
+PaymentCreateMessage extract_payment_create(const nlohmann::json& parsed)
+{
+    return PaymentCreateMessage(
+        extract_pin_height(parsed), extract_nonce_id(parsed), NonceReserved::zero(), extract_fee(parsed), extract_to_addr(parsed), extract_funds(parsed), extract_signature(parsed));
+}
+}
+
 PaymentCreateMessage parse_payment_create(const std::vector<uint8_t>& s)
 {
     try {
         json parsed = json::parse(s);
-        return PaymentCreateMessage(
-            extract_pin_height(parsed), extract_nonce_id(parsed), NonceReserved::zero(), extract_fee(parsed), extract_to_addr(parsed), extract_funds(parsed), extract_signature(parsed));
+        return extract_payment_create(parsed);
+    } catch (const json::exception& e) {
+        throw Error(EMALFORMED);
+    }
+}
+
+API::PaymentCreateBatch parse_payment_create_batch(const std::vector<uint8_t>& s)
+{
+    try {
+        json parsed = json::parse(s);
+        if (!parsed.is_array())
+            throw Error(EMALFORMED);
+        if (parsed.size() > API::PaymentCreateBatch::MAXENTRIES)
+            throw Error(ETXBATCHSIZE);
+        API::PaymentCreateBatch res;
+        res.entries.reserve(parsed.size());
+        for (auto& p : parsed) {
+            try {
+                res.entries.push_back(extract_payment_create(p));
+            } catch (Error e) {
+                res.entries.push_back(tl::make_unexpected(e.e));
+            }
+        }
+        return res;
+    } catch (const json::exception& e) {
+        throw Error(EMALFORMED);
+    }
+}
+
+API::BalancesRequest parse_balances_request(const std::vector<uint8_t>& s)
+{
+    try {
+        json parsed = json::parse(s);
+        auto& addresses { parsed.at("addresses") };
+        if (!addresses.is_array())
+            throw Error(EMALFORMED);
+        if (addresses.size() > API::BalancesRequest::MAXENTRIES)
+            throw Error(EADDRBATCHSIZE);
+        API::BalancesRequest res;
+        res.latestHistory = parsed.value("latestHistory", false);
+        res.addresses.reserve(addresses.size());
+        for (auto& a : addresses) {
+            try {
+                res.addresses.push_back(Address(a.get<std::string>()));
+            } catch (...) {
+                res.addresses.push_back(tl::make_unexpected(EBADADDRESS));
+            }
+        }
+        return res;
     } catch (const json::exception& e) {
         throw Error(EMALFORMED);
     }
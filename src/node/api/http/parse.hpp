@@ -1,6 +1,9 @@
 #pragma once
 #include "communication/create_payment.hpp"
+#include "api/types/all.hpp"
 #include "communication/mining_task.hpp"
 MiningTask parse_mining_task(const std::vector<uint8_t>& s);
 PaymentCreateMessage parse_payment_create(const std::vector<uint8_t>& s);
+API::PaymentCreateBatch parse_payment_create_batch(const std::vector<uint8_t>& s);
+API::BalancesRequest parse_balances_request(const std::vector<uint8_t>& s);
 Funds parse_funds(const std::vector<uint8_t>& s);
@@ -3,6 +3,7 @@
 #include "asyncio/conman.hpp"
 #include "chainserver/server.hpp"
 #include "eventloop/eventloop.hpp"
+#include "general/coroutine.hpp"
 #include "global/globals.hpp"
 #include "api/types/all.hpp"
 
@@ -12,9 +13,24 @@ void put_mempool(PaymentCreateMessage &&m, ResultCb cb)
     global().pcs->api_put_mempool(std::move(m), std::move(cb));
 }
 
+void put_mempool_batch(API::PaymentCreateBatch&& b, MempoolInsertCb cb)
+{
+    global().pcs->api_put_mempool_batch(std::move(b), std::move(cb));
+}
+
 void get_mempool(MempoolCb cb)
 {
-    global().pcs->api_get_mempool(std::move(cb));
+    global().pcs->api_get_mempool(0, API::MempoolPage::DEFAULTLIMIT, {}, std::move(cb));
+}
+
+void get_mempool_page(size_t offset, uint32_t limit, MempoolCb cb)
+{
+    global().pcs->api_get_mempool(offset, limit, {}, std::move(cb));
+}
+
+void get_fee_estimate(FeeEstimateCb cb)
+{
+    global().pcs->api_get_fee_estimate(std::move(cb));
 }
 
 void lookup_tx(const Hash hash, TxCb f)
@@ -22,6 +38,16 @@ void lookup_tx(const Hash hash, TxCb f)
     global().pcs->api_lookup_tx(hash, std::move(f));
 }
 
+void lookup_tx_proof(const Hash hash, TxProofCb f)
+{
+    global().pcs->api_lookup_tx_proof(hash, std::move(f));
+}
+
+void lookup_tx_proof_by_id(uint64_t historyId, TxProofCb f)
+{
+    global().pcs->api_lookup_tx_proof(HistoryId { historyId }, std::move(f));
+}
+
 void get_latest_transactions(LatestTxsCb f){
     global().pcs->api_lookup_latest_txs(std::move(f));
 };
@@ -36,6 +62,10 @@ void unban_peers(ResultCb&& f)
 {
     global().pps->async_unban(std::move(f));
 }
+void ban_peers(IPv4 net, uint8_t prefix, uint32_t seconds, ResultCb&& f)
+{
+    global().pps->async_ban_range(net, prefix, seconds, std::move(f));
+}
 void get_offense_entries(ResultCb&& f)
 {
     global().pps->async_unban(std::move(f));
@@ -48,6 +78,12 @@ void get_connected_peers2(PeersCb&& cb)
 {
     global().pel->api_get_peers(std::move(cb));
 }
+void get_peer_traffic(std::function<void(std::vector<Conman::APIPeerdata>&)>&& cb)
+{
+    global().pcm->async_get_peers([cb = std::move(cb)](std::vector<Conman::APIPeerdata> peers) {
+        cb(peers);
+    });
+}
 
 void get_round16bit_e8(uint64_t e8, RoundCb cb){
     cb(API::Round16Bit{Funds(e8)});
@@ -93,6 +129,16 @@ void get_chain_block(API::HeightOrHash hh, BlockCb cb)
     global().pcs->api_get_block(hh, cb);
 }
 
+void get_chain_blocks(NonzeroHeight from, Height to, BlocksCb cb)
+{
+    global().pcs->api_get_blocks(from, to, cb);
+}
+
+ConsensusSlave get_chain_headers()
+{
+    return global().pcs->get_chainstate();
+}
+
 void get_txcache(TxcacheCb&& cb)
 {
     global().pcs->api_get_txcache(std::move(cb));
@@ -104,7 +150,15 @@ void get_hashrate(HashrateCb&& cb)
 }
 void get_hashrate_chart(NonzeroHeight from, NonzeroHeight to, HashrateChartCb&& cb)
 {
-    global().pel->api_get_hashrate_chart(from,to,std::move(cb));
+    global().pel->api_get_hashrate_chart(from, to, 1, std::move(cb));
+}
+void get_hashrate_chart_sampled(NonzeroHeight from, NonzeroHeight to, uint32_t step, HashrateChartCb&& cb)
+{
+    global().pel->api_get_hashrate_chart(from, to, step, std::move(cb));
+}
+void get_chain_stats(uint32_t from, uint32_t to, uint32_t bucketSeconds, ChainStatsCb cb)
+{
+    global().pcs->api_get_chain_stats(from, to, bucketSeconds, std::move(cb));
 }
 
 void put_chain_append(MiningTask&& mt, ResultCb f)
@@ -116,16 +170,58 @@ void get_signed_snapshot(Eventloop::SignedSnapshotCb&& cb)
     global().pel->defer(std::move(cb));
 }
 
+namespace {
+coro::Detached chain_overview(OverviewCb cb)
+{
+    auto head { co_await coro::call(get_block_head) };
+    if (!head)
+        co_return cb(tl::make_unexpected(head.error()));
+    auto hashrate { co_await coro::call(get_hashrate) };
+    if (!hashrate)
+        co_return cb(tl::make_unexpected(hashrate.error()));
+    auto fee { co_await coro::call(get_fee_estimate) };
+    if (!fee)
+        co_return cb(tl::make_unexpected(fee.error()));
+    cb(API::ChainOverview { std::move(*head), *hashrate, std::move(*fee) });
+}
+}
+
+void get_chain_overview(OverviewCb cb)
+{
+    chain_overview(std::move(cb));
+}
+
 // account functions
 void get_account_balance(const Address& address, BalanceCb f)
 {
     global().pcs->api_get_balance(address, f);
 }
 
+void get_account_balances(API::BalancesRequest&& r, BalancesCb f)
+{
+    global().pcs->api_get_balances(std::move(r), std::move(f));
+}
+
 void get_account_history(const Address& address, uint64_t beforeId,
     HistoryCb f)
 {
-    global().pcs->api_get_history(address, beforeId, f);
+    global().pcs->api_get_history(address, beforeId, API::AccountHistory::DEFAULTLIMIT, f);
+}
+
+void get_account_history_page(const Address& address, uint64_t beforeId,
+    uint32_t limit, HistoryCb f)
+{
+    global().pcs->api_get_history(address, beforeId, limit, f);
+}
+
+void get_account_history_export(const Address& address, uint64_t afterId, HistoryExportCb f)
+{
+    global().pcs->api_get_history_export(address, afterId, std::move(f));
+}
+
+void get_account_mempool(const Address& address, size_t offset, uint32_t limit, MempoolCb f)
+{
+    global().pcs->api_get_mempool(offset, limit, address, std::move(f));
 }
 
 void get_account_richlist(RichlistCb f)
@@ -142,3 +238,30 @@ void inspect_eventloop(std::function<void(const Eventloop& e)>&& cb)
 {
     global().pel->api_inspect(std::move(cb));
 }
+
+void start_tracing(ResultCb&& cb)
+{
+    trace::set_enabled(true);
+    cb({});
+}
+
+void stop_tracing(ResultCb&& cb)
+{
+    trace::set_enabled(false);
+    cb({});
+}
+
+void get_trace(std::function<void(const std::vector<trace::ThreadEvents>&)>&& cb)
+{
+    cb(trace::collect());
+}
+
+void get_memory_usage(std::function<void(const memory_budget::Report&)>&& cb)
+{
+    cb(memory_budget::report());
+}
+
+void get_block_latency(std::function<void(const std::vector<block_latency::Trace>&)>&& cb)
+{
+    cb(block_latency::recent());
+}
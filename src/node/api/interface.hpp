@@ -3,18 +3,27 @@
 #include "asyncio/conman.hpp"
 #include "callbacks.hpp"
 #include "eventloop/eventloop.hpp"
+#include "general/block_latency.hpp"
+#include "general/memory_budget.hpp"
+#include "general/trace.hpp"
 #include "global/globals.hpp"
 
 // mempool cbunctions
 void put_mempool(PaymentCreateMessage&&, ResultCb);
+void put_mempool_batch(API::PaymentCreateBatch&&, MempoolInsertCb);
 void get_mempool(MempoolCb cb);
+void get_mempool_page(size_t offset, uint32_t limit, MempoolCb cb);
+void get_fee_estimate(FeeEstimateCb cb);
 void lookup_tx(const Hash hash, TxCb f);
+void lookup_tx_proof(const Hash hash, TxProofCb f);
+void lookup_tx_proof_by_id(uint64_t historyId, TxProofCb f);
 
 void get_latest_transactions(LatestTxsCb f);
 
 // peer db functions
 void get_banned_peers(PeerServer::BannedCB&& cb);
 void unban_peers(ResultCb&& cb);
+void ban_peers(IPv4 net, uint8_t prefix, uint32_t seconds, ResultCb&& cb);
 
 inline void get_offenses(Page page, PeerServer::OffensesCb&& cb)
 {
@@ -27,6 +36,7 @@ void get_failed_addresses(PeerServer::BannedCB cb);
 void get_verified_addresses(PeerServer::BannedCB cb);
 
 void get_connected_peers2(PeersCb&& cb);
+void get_peer_traffic(std::function<void(std::vector<Conman::APIPeerdata>&)>&& cb);
 
 // tools functions
 void get_round16bit_e8(uint64_t e8, RoundCb cb);
@@ -41,20 +51,40 @@ void get_chain_header(API::HeightOrHash, HeaderCb cb);
 void get_chain_hash(Height height, HashCb cb);
 void get_chain_grid(GridCb cb);
 void get_chain_block(API::HeightOrHash, BlockCb cb);
+void get_chain_blocks(NonzeroHeight from, Height to, BlocksCb cb);
+ConsensusSlave get_chain_headers(); // published headers, no chainserver roundtrip
 void get_txcache(TxcacheCb&& cb);
 void get_hashrate(HashrateCb&& cb);
 void get_hashrate_chart(NonzeroHeight from, NonzeroHeight to, HashrateChartCb&& cb);
+void get_hashrate_chart_sampled(NonzeroHeight from, NonzeroHeight to, uint32_t step, HashrateChartCb&& cb);
 void put_chain_append(MiningTask&& mt, ResultCb cb);
 void get_signed_snapshot(Eventloop::SignedSnapshotCb&& cb);
+void get_chain_overview(OverviewCb cb); // awaits chainserver and eventloop
+void get_chain_stats(uint32_t from, uint32_t to, uint32_t bucketSeconds, ChainStatsCb cb);
 
 // sync functions
 void get_headerdownload(HeaderdownloadCb f);
 
 // account functions
 void get_account_balance(const Address& address, BalanceCb cb);
+void get_account_balances(API::BalancesRequest&&, BalancesCb cb);
 void get_account_history(const Address& address, uint64_t end, HistoryCb cb);
+void get_account_history_page(const Address& address, uint64_t end, uint32_t limit, HistoryCb cb);
+void get_account_history_export(const Address& address, uint64_t afterId, HistoryExportCb cb);
+void get_account_mempool(const Address& address, size_t offset, uint32_t limit, MempoolCb cb);
 void get_account_richlist(RichlistCb cb);
 
 // endpoints function
 void inspect_eventloop(std::function<void(const Eventloop& e)>&&);
 void inspect_conman(std::function<void(const Conman& c)>&&);
+
+// tracing functions
+void start_tracing(ResultCb&& cb);
+void stop_tracing(ResultCb&& cb);
+void get_trace(std::function<void(const std::vector<trace::ThreadEvents>&)>&& cb);
+
+// memory functions
+void get_memory_usage(std::function<void(const memory_budget::Report&)>&& cb);
+
+// block latency functions
+void get_block_latency(std::function<void(const std::vector<block_latency::Trace>&)>&& cb);
@@ -0,0 +1,553 @@
+#include "server.hpp"
+#include "api/http/json.hpp"
+#include "api/interface.hpp"
+#include "block/body/view.hpp"
+#include "block/header/difficulty.hpp"
+#include "block/header/header_impl.hpp"
+#include "block/header/view.hpp"
+#include "config/config.hpp"
+#include "crypto/hasher_sha256.hpp"
+#include "crypto/verushash/verushash.hpp"
+#include "general/errors.hpp"
+#include "general/hex.hpp"
+#include "general/task_pool.hpp"
+#include "spdlog/spdlog.h"
+#include <algorithm>
+#include <charconv>
+using nlohmann::json;
+
+namespace {
+constexpr size_t maxLine { 1 << 14 }; // requests are short
+constexpr size_t maxWriteBuffer { 1 << 24 }; // jobs carry the block body
+constexpr unsigned idleTimeout { 600 }; // seconds without a request
+constexpr size_t maxJobs { 4 }; // per address, shares for older jobs are stale
+constexpr size_t flushShares { 64 }; // queued shares validated without waiting for the timer
+constexpr int timerInterval { 100 }; // ms
+constexpr auto jobRefreshInterval { std::chrono::seconds(10) }; // new timestamp
+
+// error codes of stratum implementations
+enum Reject : int32_t {
+    OTHER = 20,
+    JOBNOTFOUND = 21,
+    DUPLICATE = 22,
+    LOWDIFFICULTY = 23,
+    UNAUTHORIZED = 24,
+    NOTSUBSCRIBED = 25,
+};
+
+const char* reject_message(int32_t code)
+{
+    switch (code) {
+    case JOBNOTFOUND:
+        return "Job not found";
+    case DUPLICATE:
+        return "Duplicate share";
+    case LOWDIFFICULTY:
+        return "Low difficulty share";
+    case UNAUTHORIZED:
+        return "Unauthorized worker";
+    case NOTSUBSCRIBED:
+        return "Not subscribed";
+    }
+    return "Invalid share";
+}
+
+StratumServer& server_of(us_socket_t* s)
+{
+    return **(StratumServer**)us_socket_context_ext(0, us_socket_context(0, s));
+}
+}
+
+StratumServer::StratumServer(const Config& c)
+    : initialDifficulty(c.stratum.difficulty)
+    , shareInterval(c.stratum.shareInterval)
+    , bind(*c.stratum.bind)
+{
+    spdlog::info("Stratum pool server is {}.", bind.to_string());
+    t = std::thread(&StratumServer::work, this);
+}
+
+void StratumServer::work()
+{
+    context = us_create_socket_context(0, (us_loop_t*)lc.loop, sizeof(StratumServer*), {});
+    *(StratumServer**)us_socket_context_ext(0, context) = this;
+    us_socket_context_on_open(0, context, [](us_socket_t* s, int, char*, int) {
+        server_of(s).on_open(s);
+        return s;
+    });
+    us_socket_context_on_close(0, context, [](us_socket_t* s, int, void*) {
+        server_of(s).on_close(s);
+        return s;
+    });
+    us_socket_context_on_data(0, context, [](us_socket_t* s, char* data, int length) {
+        server_of(s).on_data(s, { data, size_t(length) });
+        return s;
+    });
+    us_socket_context_on_writable(0, context, [](us_socket_t* s) {
+        server_of(s).on_writable(s);
+        return s;
+    });
+    us_socket_context_on_timeout(0, context, [](us_socket_t* s) {
+        return us_socket_close(0, s, 0, nullptr);
+    });
+    us_socket_context_on_end(0, context, [](us_socket_t* s) {
+        return us_socket_close(0, s, 0, nullptr);
+    });
+
+    timer = us_create_timer((us_loop_t*)lc.loop, 0, sizeof(StratumServer*));
+    *(StratumServer**)us_timer_ext(timer) = this;
+    us_timer_set(
+        timer, [](us_timer_t* t) {
+            (*(StratumServer**)us_timer_ext(t))->on_timer();
+        },
+        timerInterval, timerInterval);
+
+    listen_socket = us_socket_context_listen(0, context, bind.ipv4.to_string().c_str(), bind.port, 0, sizeof(uint64_t));
+    if (!listen_socket)
+        throw std::runtime_error("Cannot listen on " + bind.to_string());
+    lc.loop->run();
+    us_socket_context_free(0, context);
+}
+
+void StratumServer::shutdown()
+{
+    bshutdown = true;
+    if (timer != nullptr) {
+        us_timer_close(timer);
+        timer = nullptr;
+    }
+    if (listen_socket != nullptr) {
+        us_listen_socket_close(0, listen_socket);
+        listen_socket = nullptr;
+    }
+    std::vector<us_socket_t*> sockets;
+    for (auto& [id, c] : connections)
+        sockets.push_back(c.socket);
+    for (auto* s : sockets)
+        us_socket_close(0, s, 0, nullptr);
+}
+
+void StratumServer::handle_event(const API::MiningUpdate& u)
+{
+    for (auto& [a, m] : miners) {
+        if (u.headChanged) { // shares of the old head are stale
+            m.jobs.clear();
+            m.clean = true;
+        }
+        fetch_job(a);
+    }
+}
+
+//////////////////////////////
+// connections
+
+void StratumServer::on_open(us_socket_t* s)
+{
+    if (bshutdown) {
+        us_socket_close(0, s, 0, nullptr);
+        return;
+    }
+    const uint64_t id { nextConnectionId++ };
+    *(uint64_t*)us_socket_ext(0, s) = id;
+    connections.emplace(id, Connection { .id = id, .socket = s, .extranonce = nextExtranonce++, .difficulty = initialDifficulty, .retargetStart = steady_clock::now() });
+    us_socket_timeout(0, s, idleTimeout);
+}
+
+void StratumServer::on_close(us_socket_t* s)
+{
+    auto iter { connections.find(*(uint64_t*)us_socket_ext(0, s)) };
+    if (iter == connections.end())
+        return;
+    if (auto& a { iter->second.address }) {
+        auto m { miners.find(*a) };
+        m->second.connections -= 1;
+        release_miners(m);
+    }
+    connections.erase(iter);
+}
+
+auto StratumServer::connection(us_socket_t* s) -> Connection*
+{
+    auto iter { connections.find(*(uint64_t*)us_socket_ext(0, s)) };
+    if (iter == connections.end())
+        return nullptr;
+    return &iter->second;
+}
+
+void StratumServer::on_data(us_socket_t* s, std::string_view data)
+{
+    auto c { connection(s) };
+    if (!c)
+        return;
+    us_socket_timeout(0, s, idleTimeout);
+    auto& buf { c->readBuffer };
+    buf.append(data);
+    // requests only close deferred, the connection stays valid
+    size_t begin { 0 }, end;
+    while ((end = buf.find('\n', begin)) != std::string::npos) {
+        std::string_view line { buf.data() + begin, end - begin };
+        if (line.ends_with('\r'))
+            line.remove_suffix(1);
+        if (!line.empty())
+            on_line(*c, line);
+        begin = end + 1;
+    }
+    buf.erase(0, begin);
+    if (buf.size() > maxLine)
+        close(c->id);
+}
+
+void StratumServer::on_writable(us_socket_t* s)
+{
+    auto c { connection(s) };
+    if (!c || c->writeBuffer.empty())
+        return;
+    int n { us_socket_write(0, s, c->writeBuffer.data(), c->writeBuffer.size(), 0) };
+    c->writeBuffer.erase(0, n);
+}
+
+void StratumServer::on_line(Connection& c, std::string_view line)
+{
+    json id;
+    try {
+        auto req { json::parse(line) };
+        id = req.value("id", json());
+        auto method { req.at("method").get<std::string>() };
+        auto params { req.value("params", json::array()) };
+        if (method == "mining.subscribe")
+            subscribe(c, id);
+        else if (method == "mining.authorize")
+            authorize(c, id, params);
+        else if (method == "mining.suggest_difficulty")
+            suggest_difficulty(c, id, params);
+        else if (method == "mining.submit")
+            submit(c, id, params);
+        else
+            reply_error(c, id, OTHER, "Unknown method");
+    } catch (const json::exception&) {
+        reply_error(c, id, OTHER, "Malformed request");
+    } catch (const Error& e) {
+        reply_error(c, id, OTHER, e.strerror());
+    }
+}
+
+void StratumServer::on_timer()
+{
+    if (!pendingShares.empty())
+        flush_shares();
+    auto now { steady_clock::now() };
+    for (auto& [a, m] : miners) {
+        if (m.connections > 0 && now >= m.refresh)
+            fetch_job(a);
+    }
+    for (auto& [id, c] : connections)
+        retarget(c, now);
+}
+
+void StratumServer::send(Connection& c, std::string line)
+{
+    if (c.writeBuffer.empty()) {
+        int n { us_socket_write(0, c.socket, line.data(), line.size(), 0) };
+        if (size_t(n) == line.size())
+            return;
+        line.erase(0, n);
+    }
+    c.writeBuffer += line;
+    if (c.writeBuffer.size() > maxWriteBuffer) {
+        c.writeBuffer.clear();
+        close(c.id);
+    }
+}
+
+void StratumServer::reply(Connection& c, const json& requestId, json result)
+{
+    send(c, json { { "id", requestId }, { "result", std::move(result) }, { "error", nullptr } });
+}
+
+void StratumServer::reply_error(Connection& c, const json& requestId, int code, std::string_view message)
+{
+    send(c, json { { "id", requestId }, { "result", nullptr }, { "error", json::array({ code, std::string(message), nullptr }) } });
+}
+
+void StratumServer::close(uint64_t connectionId)
+{
+    lc.loop->defer([this, connectionId]() {
+        auto iter { connections.find(connectionId) };
+        if (iter != connections.end())
+            us_socket_close(0, iter->second.socket, 0, nullptr);
+    });
+}
+
+//////////////////////////////
+// requests
+
+void StratumServer::subscribe(Connection& c, const json& id)
+{
+    c.subscribed = true;
+    const std::array<uint8_t, 2> extranonce { uint8_t(c.extranonce >> 8), uint8_t(c.extranonce) };
+    reply(c, id, json::array({ json::array({ json::array({ "mining.notify", std::to_string(c.id) }) }), serialize_hex(extranonce), 2 }));
+    set_difficulty(c, c.difficulty);
+}
+
+void StratumServer::authorize(Connection& c, const json& id, const json& params)
+{
+    if (!c.subscribed)
+        return reply_error(c, id, NOTSUBSCRIBED, reject_message(NOTSUBSCRIBED));
+    // like other pools accept "address.worker"
+    auto user { params.at(0).get<std::string>() };
+    Address a { std::string_view(user).substr(0, user.find('.')) };
+    if (c.address) {
+        if (*c.address == a)
+            return reply(c, id, true);
+        auto m { miners.find(*c.address) };
+        m->second.connections -= 1;
+        release_miners(m);
+    }
+    c.address = a;
+    auto [iter, inserted] { miners.try_emplace(a) };
+    auto& m { iter->second };
+    m.connections += 1;
+    reply(c, id, true);
+    if (!m.jobs.empty())
+        notify(c, m.jobs.back(), true);
+    else
+        fetch_job(a);
+}
+
+void StratumServer::suggest_difficulty(Connection& c, const json& id, const json& params)
+{
+    auto d { params.at(0).get<double>() };
+    reply(c, id, true);
+    set_difficulty(c, std::max(d, 1.0));
+}
+
+void StratumServer::submit(Connection& c, const json& id, const json& params)
+{
+    if (!c.address)
+        return reply_error(c, id, UNAUTHORIZED, reject_message(UNAUTHORIZED));
+    auto& m { miners.at(*c.address) };
+
+    auto jobId { params.at(0).get<std::string>() };
+    uint64_t jid;
+    auto r { std::from_chars(jobId.data(), jobId.data() + jobId.size(), jid) };
+    auto job { std::find_if(m.jobs.begin(), m.jobs.end(), [&](auto& j) { return j.id == jid; }) };
+    if (r.ec != std::errc {} || job == m.jobs.end())
+        return reply_error(c, id, JOBNOTFOUND, reject_message(JOBNOTFOUND));
+
+    std::array<uint8_t, 4> seed;
+    Header header;
+    if (!parse_hex(params.at(1).get<std::string>(), seed) || !parse_hex(params.at(2).get<std::string>(), header))
+        return reply_error(c, id, OTHER, "Malformed share");
+    if (seed[0] != uint8_t(c.extranonce >> 8) || seed[1] != uint8_t(c.extranonce))
+        return reply_error(c, id, OTHER, "Wrong extranonce");
+
+    // only merkle root and nonce are up to the miner
+    auto& jh { job->task->block.header };
+    constexpr size_t offset_merkleroot { HeaderView::offset_merkleroot };
+    constexpr size_t offset_version { HeaderView::offset_version };
+    constexpr size_t offset_nonce { HeaderView::offset_nonce };
+    if (memcmp(header.data(), jh.data(), offset_merkleroot) != 0
+        || memcmp(header.data() + offset_version, jh.data() + offset_version, offset_nonce - offset_version) != 0)
+        return reply_error(c, id, OTHER, "Header does not match job");
+    if (!job->submitted.insert(header).second)
+        return reply_error(c, id, DUPLICATE, reject_message(DUPLICATE));
+
+    pendingShares.push_back({ .connectionId = c.id,
+        .requestId = id,
+        .difficulty = c.difficulty,
+        .task = job->task,
+        .seed = seed,
+        .header = header });
+    if (pendingShares.size() >= flushShares)
+        flush_shares();
+}
+
+void StratumServer::set_difficulty(Connection& c, double d)
+{
+    c.difficulty = d;
+    c.shares = 0;
+    c.retargetStart = steady_clock::now();
+    send(c, json { { "id", nullptr }, { "method", "mining.set_difficulty" }, { "params", json::array({ d }) } });
+}
+
+void StratumServer::retarget(Connection& c, steady_clock::time_point now)
+{
+    // aim at one share per shareInterval, retarget after 32 shares or 6
+    // intervals but ignore deviations within a factor of 2
+    if (shareInterval.count() == 0 || !c.address)
+        return;
+    using namespace std::chrono;
+    auto elapsed { duration_cast<duration<double>>(now - c.retargetStart) };
+    if (c.shares < 32 && elapsed < 6 * shareInterval)
+        return;
+    const double factor { std::clamp(c.shares * shareInterval / elapsed, 0.25, 4.0) };
+    if (factor > 0.5 && factor < 2.0) {
+        c.shares = 0;
+        c.retargetStart = now;
+        return;
+    }
+    set_difficulty(c, std::max(c.difficulty * factor, 1.0));
+}
+
+//////////////////////////////
+// jobs
+
+void StratumServer::fetch_job(const Address& a)
+{
+    auto& m { miners.at(a) };
+    if (m.fetching) {
+        m.outdated = true;
+        return;
+    }
+    m.fetching = true;
+    m.refresh = steady_clock::now() + jobRefreshInterval;
+    get_chain_mine(a, [this, a](auto& mt) {
+        lc.loop->defer([this, a, mt]() mutable {
+            on_mining_task(a, std::move(mt));
+        });
+    });
+}
+
+void StratumServer::on_mining_task(const Address& a, tl::expected<MiningTask, int32_t> mt)
+{
+    auto iter { miners.find(a) };
+    if (iter == miners.end())
+        return;
+    auto& m { iter->second };
+    m.fetching = false;
+    if (mt) {
+        const bool clean { std::exchange(m.clean, false) };
+        if (clean)
+            m.jobs.clear();
+        const uint64_t id { nextJobId++ };
+        auto params { json::array({ std::to_string(id), jsonmsg::to_json(*mt), false }) };
+        auto& job { m.jobs.emplace_back(Job {
+            .id = id,
+            .task = std::make_shared<const MiningTask>(std::move(*mt)) }) };
+        for (bool c : { false, true }) {
+            params[2] = c;
+            job.notification[c] = json { { "id", nullptr }, { "method", "mining.notify" }, { "params", params } }.dump() + '\n';
+        }
+        if (m.jobs.size() > maxJobs)
+            m.jobs.pop_front();
+        for (auto& [id, c] : connections) {
+            if (c.address == a)
+                notify(c, m.jobs.back(), clean);
+        }
+    } else {
+        spdlog::debug("Stratum: no mining task for {}: {}", a.to_string(), Error(mt.error()).strerror());
+    }
+    if (std::exchange(m.outdated, false))
+        fetch_job(a);
+    else
+        release_miners(iter);
+}
+
+void StratumServer::release_miners(MinersMap::iterator iter)
+{
+    auto& m { iter->second };
+    if (m.connections == 0 && !m.fetching)
+        miners.erase(iter);
+}
+
+//////////////////////////////
+// share validation
+
+void StratumServer::flush_shares()
+{
+    task_pool().submit([this, shares = std::exchange(pendingShares, {})]() mutable {
+        auto results { validate(shares) };
+        lc.loop->defer([this, shares = std::move(shares), results = std::move(results)]() mutable {
+            on_validated(std::move(shares), std::move(results));
+        });
+    });
+}
+
+auto StratumServer::validate(const std::vector<Share>& shares) -> std::vector<ShareResult>
+{
+    std::vector<ShareResult> res(shares.size());
+    // chunks of shares such that the hashes interleave lanes
+    constexpr size_t chunk { 16 };
+    task_pool().parallel_for((shares.size() + chunk - 1) / chunk, [&](size_t c) {
+        const size_t begin { c * chunk };
+        const size_t n { std::min(begin + chunk, shares.size()) - begin };
+
+        // merkle roots, miners submit many shares per seed
+        std::map<std::pair<const MiningTask*, std::array<uint8_t, 4>>, Hash> roots;
+        std::vector<Header> headers;
+        for (size_t i = begin; i < begin + n; ++i) {
+            auto& s { shares[i] };
+            auto [iter, inserted] { roots.try_emplace({ s.task.get(), s.seed }) };
+            if (inserted) {
+                auto body { s.task->block.body.data() };
+                memcpy(body.data(), s.seed.data(), s.seed.size());
+                iter->second = BodyContainer(std::move(body)).view().merkleRoot(s.task->block.height);
+            }
+            if (iter->second != s.header.merkleroot())
+                res[i].error = OTHER;
+            headers.push_back(s.header);
+        }
+
+        Hash inner[chunk], hashes[chunk];
+        hashSHA256_batch(headers.front().data(), HeaderView::bytesize, sizeof(Header), n, inner);
+        hashSHA256_batch(inner[0].data(), 32, sizeof(Hash), n, hashes);
+        std::vector<std::span<const uint8_t>> verusInputs;
+        for (size_t i = 0; i < n; ++i) {
+            if (HeaderView::uses_verushash(shares[begin + i].task->block.height))
+                verusInputs.push_back({ headers[i].data(), headers[i].size() });
+        }
+        Hash verusHashes[chunk];
+        verus_hash_batch(verusInputs, verusHashes);
+
+        size_t v { 0 };
+        for (size_t i = 0; i < n; ++i) {
+            auto& s { shares[begin + i] };
+            auto& r { res[begin + i] };
+            auto height { s.task->block.height };
+            HeaderView hv { headers[i].data() };
+            bool share;
+            if (HeaderView::uses_verushash(height)) {
+                auto& verusHash { verusHashes[v++] };
+                share = hv.validPOW(hashes[i], height, verusHash, TargetV2(s.difficulty));
+                r.solved = hv.validPOW(hashes[i], height, verusHash);
+            } else {
+                share = TargetV1(s.difficulty).compatible(hashes[i]);
+                r.solved = hv.validPOW(hashes[i], height);
+            }
+            if (r.error != 0)
+                r.solved = false;
+            else if (!share && !r.solved)
+                r.error = LOWDIFFICULTY;
+        }
+    });
+    return res;
+}
+
+void StratumServer::on_validated(std::vector<Share> shares, std::vector<ShareResult> results)
+{
+    for (size_t i = 0; i < shares.size(); ++i) {
+        auto& s { shares[i] };
+        auto& r { results[i] };
+        if (r.solved) {
+            MiningTask mt { s.task->block };
+            memcpy(mt.block.body.data().data(), s.seed.data(), s.seed.size());
+            mt.block.header = s.header;
+            const auto height { mt.block.height };
+            spdlog::info("Stratum share solves block {}", height.value());
+            put_chain_append(std::move(mt), [height](auto& res) {
+                if (!res)
+                    spdlog::warn("Stratum block {} rejected: {}", height.value(), Error(res.error()).strerror());
+            });
+        }
+        auto iter { connections.find(s.connectionId) };
+        if (iter == connections.end())
+            continue;
+        auto& c { iter->second };
+        if (r.error != 0) {
+            reply_error(c, s.requestId, r.error, reject_message(r.error));
+        } else {
+            c.shares += 1;
+            reply(c, s.requestId, true);
+        }
+    }
+}
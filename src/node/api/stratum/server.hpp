@@ -0,0 +1,149 @@
+#pragma once
+#include "api/types/all.hpp"
+#include "communication/mining_task.hpp"
+#include "crypto/address.hpp"
+#include "expected.hpp"
+#include "general/tcp_util.hpp"
+#include "nlohmann/json.hpp"
+#include "uwebsockets/Loop.h"
+#include <array>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <memory>
+#include <set>
+#include <thread>
+
+struct Config;
+// Pool protocol server in the style of stratum: line delimited JSON-RPC over
+// plain TCP. Miners subscribe, authorize with the address to mine to and
+// get a job pushed on every change of the block template instead of polling
+// /chain/mine. Shares are checked against the per-connection difficulty in
+// batches on the task pool such that the multi-lane SHA256 and verushash
+// process many shares at once, shares solving the block are appended.
+//
+// Requests (params):
+//   mining.subscribe          -> [[["mining.notify", id]], extranonce1, 2]
+//   mining.authorize          [address] -> true
+//   mining.suggest_difficulty [difficulty] -> true
+//   mining.submit             [jobId, seed, header] -> true
+// Notifications by the server:
+//   mining.set_difficulty     [difficulty]
+//   mining.notify             [jobId, {header, body, height, difficulty}, clean]
+// The seed is the hex of the first 4 body bytes, its first 2 bytes must be
+// extranonce1 which is unique per connection. The header must be the job
+// header with the merkle root of the seeded body and the nonce changed.
+class StratumServer {
+public:
+    StratumServer(const Config&);
+    ~StratumServer()
+    {
+        lc.loop->defer(std::bind(&StratumServer::shutdown, this));
+        t.join();
+    }
+    void push_event(API::MiningUpdate u)
+    {
+        lc.loop->defer([this, u]() { handle_event(u); });
+    }
+
+private:
+    using steady_clock = std::chrono::steady_clock;
+    struct Job {
+        uint64_t id;
+        std::shared_ptr<const MiningTask> task;
+        std::array<std::string, 2> notification {}; // serialized mining.notify, index is the clean flag
+        std::set<Header> submitted {}; // rejects duplicate shares
+    };
+    struct Connection {
+        uint64_t id;
+        us_socket_t* socket;
+        uint16_t extranonce;
+        bool subscribed { false };
+        std::optional<Address> address {};
+        double difficulty;
+        std::string readBuffer {};
+        std::string writeBuffer {}; // not yet accepted by the kernel
+        size_t shares { 0 }; // accepted since retargetStart
+        steady_clock::time_point retargetStart;
+    };
+    struct Miners { // connections mining to the same address share jobs
+        size_t connections { 0 };
+        std::deque<Job> jobs; // newest last
+        steady_clock::time_point refresh; // next periodic job (new timestamp)
+        bool fetching { false };
+        bool outdated { false }; // changed while fetching
+        bool clean { false }; // next job invalidates the previous ones
+    };
+    using MinersMap = std::map<Address, Miners, Address::Comparator>;
+    struct Share {
+        uint64_t connectionId;
+        nlohmann::json requestId;
+        double difficulty;
+        std::shared_ptr<const MiningTask> task;
+        std::array<uint8_t, 4> seed;
+        Header header;
+    };
+    struct ShareResult {
+        int32_t error { 0 };
+        bool solved { false }; // valid block
+    };
+
+    void work();
+    void shutdown();
+    void handle_event(const API::MiningUpdate&);
+
+    //////////////////////////////
+    // connections
+    void on_open(us_socket_t*);
+    void on_close(us_socket_t*);
+    void on_data(us_socket_t*, std::string_view);
+    void on_writable(us_socket_t*);
+    void on_line(Connection&, std::string_view);
+    void on_timer();
+    Connection* connection(us_socket_t*);
+    void send(Connection&, std::string line);
+    void send(Connection& c, const nlohmann::json& j) { send(c, j.dump() + '\n'); }
+    void reply(Connection&, const nlohmann::json& requestId, nlohmann::json result);
+    void reply_error(Connection&, const nlohmann::json& requestId, int code, std::string_view message);
+    void close(uint64_t connectionId); // deferred, the connection may be in use
+
+    //////////////////////////////
+    // requests
+    void subscribe(Connection&, const nlohmann::json& id);
+    void authorize(Connection&, const nlohmann::json& id, const nlohmann::json& params);
+    void suggest_difficulty(Connection&, const nlohmann::json& id, const nlohmann::json& params);
+    void submit(Connection&, const nlohmann::json& id, const nlohmann::json& params);
+    void set_difficulty(Connection&, double);
+    void retarget(Connection&, steady_clock::time_point now);
+
+    //////////////////////////////
+    // jobs
+    void fetch_job(const Address&);
+    void on_mining_task(const Address&, tl::expected<MiningTask, int32_t>);
+    void notify(Connection& c, const Job& j, bool clean) { send(c, j.notification[clean]); }
+    void release_miners(MinersMap::iterator);
+
+    //////////////////////////////
+    // share validation
+    void flush_shares();
+    static std::vector<ShareResult> validate(const std::vector<Share>&);
+    void on_validated(std::vector<Share>, std::vector<ShareResult>);
+
+    //////////////////////////////
+    // variables
+    const double initialDifficulty;
+    const std::chrono::seconds shareInterval;
+    std::map<uint64_t, Connection> connections;
+    MinersMap miners;
+    std::vector<Share> pendingShares;
+    uint64_t nextConnectionId { 0 };
+    uint64_t nextJobId { 0 };
+    uint16_t nextExtranonce { 0 };
+    us_socket_context_t* context { nullptr };
+    us_timer_t* timer { nullptr };
+    EndpointAddress bind;
+    us_listen_socket_t* listen_socket = nullptr;
+    const uWS::LoopCleaner lc;
+    bool bshutdown = false;
+    std::thread t;
+};
@@ -1,16 +1,20 @@
 #pragma once
 
 #include "block/body/primitives.hpp"
+#include "block/body/view.hpp"
 #include "block/chain/history/index.hpp"
 #include "block/chain/signed_snapshot.hpp"
 #include "block/chain/worksum.hpp"
 #include "block/header/difficulty_declaration.hpp"
 #include "block/header/header.hpp"
+#include "communication/create_payment.hpp"
 #include "crypto/address.hpp"
 #include "db/offense_entry.hpp"
 #include "eventloop/peer_chain.hpp"
 #include "general/funds.hpp"
 #include "general/tcp_util.hpp"
+#include "mempool/snapshot.hpp"
+#include "expected.hpp"
 #include "height_or_hash.hpp"
 #include <variant>
 #include <vector>
@@ -48,10 +52,32 @@ struct TransferTransaction {
     NonceId nonceId;
     PinHeight pinHeight { PinHeight::undef() };
 };
+// merkle inclusion proof of a reward or transfer
+struct TxProof {
+    Hash txhash;
+    HistoryId historyId;
+    NonzeroHeight height;
+    Header header;
+    size_t leafIndex;
+    std::vector<uint8_t> leaf; // body bytes of the transaction
+    MerkleBranch branch;
+};
 struct Balance {
     AccountId accountId;
     Funds balance;
 };
+// mining tasks changed (new chain head or block template)
+struct MiningUpdate {
+    bool headChanged { true }; // false if only the block template changed
+};
+// blocks above length were disconnected
+struct Rollback {
+    Height length;
+};
+struct MempoolChange {
+    std::vector<std::pair<TransactionId, Hash>> added;
+    std::vector<TransactionId> removed;
+};
 struct Block {
     static constexpr const char WEBSOCKET_EVENT[] = "Block";
     struct Transfer {
@@ -86,10 +112,31 @@ struct Block {
     }
 };
 struct AccountHistory {
+    static constexpr uint32_t DEFAULTLIMIT = 100;
+    static constexpr uint32_t MAXLIMIT = 1000;
+    static constexpr size_t MAXCOUNT = 100000; // count is exact below
     Funds balance;
     HistoryId fromId;
+    std::optional<HistoryId> nextCursor; // set if older entries exist
+    size_t count { 0 }; // number of entries, capped at MAXCOUNT
     std::vector<API::Block> blocks_reversed;
 };
+// chunk of an account history export, oldest first
+struct HistoryExport {
+    static constexpr uint32_t CHUNKSIZE = 1000;
+    struct Entry {
+        HistoryId id;
+        NonzeroHeight height;
+        uint32_t timestamp;
+        Hash txhash;
+        std::optional<Address> fromAddress; // empty for rewards
+        Address toAddress;
+        Funds amount;
+        Funds fee;
+    };
+    std::vector<Entry> entries;
+    bool more { false }; // newer entries exist
+};
 struct TransactionsByBlocks {
     size_t count { 0 };
     HistoryId fromId;
@@ -98,11 +145,24 @@ struct TransactionsByBlocks {
 struct Richlist {
     std::vector<std::pair<Address, Funds>> entries;
 };
-struct MempoolEntry : public TransferTxExchangeMessage {
-    Hash txHash;
-};
-struct MempoolEntries {
-    std::vector<MempoolEntry> entries;
+// page of the fee ordered mempool, written from the shared snapshot when
+// the reply is serialized
+struct MempoolPage {
+    static constexpr uint32_t DEFAULTLIMIT = 100;
+    static constexpr uint32_t MAXLIMIT = 1000;
+    std::shared_ptr<const mempool::Snapshot> snapshot;
+    size_t offset { 0 };
+    uint32_t limit { DEFAULTLIMIT };
+    std::optional<Address> address; // sender or recipient
+};
+struct FeeEstimate {
+    struct Target {
+        uint32_t blocks;
+        std::optional<Funds> fee; // empty without enough samples
+    };
+    std::vector<Target> targets;
+    std::optional<Funds> includedMedian;
+    size_t samples;
 };
 struct OffenseHistory {
     std::vector<Hash> hashes;
@@ -111,6 +171,12 @@ struct OffenseHistory {
 struct HashrateInfo {
     uint64_t by100Blocks;
 };
+// chain head with hashrate and fee estimate in one reply
+struct ChainOverview {
+    Head head;
+    HashrateInfo hashrate;
+    FeeEstimate feeEstimate;
+};
 
 struct HashrateChartRequest {
     Height begin;
@@ -119,9 +185,33 @@ struct HashrateChartRequest {
 
 struct HashrateChart {
     HashrateChartRequest range;
+    uint32_t step { 1 }; // heights between chart points
     std::vector<double> chart;
 };
 
+// block aggregates bucketed by block timestamp, buckets without blocks
+// are omitted
+struct ChainStats {
+    static constexpr uint32_t MAXBUCKETS = 1000;
+    struct Bucket {
+        uint32_t begin; // timestamp
+        NonzeroHeight firstHeight;
+        NonzeroHeight lastHeight;
+        uint32_t blocks;
+        uint64_t transfers;
+        Funds volume;
+        Funds fees;
+        Funds rewards;
+        uint64_t newAccounts;
+        // running totals after the last block of the bucket
+        Funds supply;
+        uint64_t accounts;
+        uint64_t transactions;
+    };
+    uint32_t bucketSeconds;
+    std::vector<Bucket> buckets;
+};
+
 struct Peerinfo {
     IPv4 ip;
     bool initialized;
@@ -136,6 +226,26 @@ struct Round16Bit {
     Funds original;
 };
 
+struct PaymentCreateBatch {
+    static constexpr size_t MAXENTRIES = 10000;
+    std::vector<tl::expected<PaymentCreateMessage, int32_t>> entries; // with parse errors
+};
+struct MempoolInsertResults {
+    std::vector<int32_t> codes; // per submitted transaction
+};
+struct BalancesRequest {
+    static constexpr size_t MAXENTRIES = 10000;
+    std::vector<tl::expected<Address, int32_t>> addresses; // with parse errors
+    bool latestHistory { false };
+};
+struct Balances {
+    struct Entry {
+        Balance balance;
+        std::optional<HistoryId> latestHistoryId; // if requested and any
+    };
+    std::vector<tl::expected<Entry, int32_t>> entries; // in request order
+};
+
 using OffenseEntry = ::OffenseEntry;
 
 }
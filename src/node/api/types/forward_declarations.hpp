@@ -1,20 +1,31 @@
 #pragma once
 #include <variant>
 namespace API {
-struct MempoolEntries;
+struct MempoolPage;
+struct FeeEstimate;
 struct TransferTransaction;
 struct Head;
 struct RewardTransaction;
 struct Balance;
 struct HashrateInfo;
+struct ChainOverview;
 struct Block;
 struct AccountHistory;
+struct HistoryExport;
 struct TransactionsByBlocks;
 struct HashrateChart;
 struct HashrateChartRequest;
+struct ChainStats;
 struct Richlist;
 struct Peerinfo;
 struct HeightOrHash;
 struct Round16Bit;
+struct PaymentCreateBatch;
+struct MempoolInsertResults;
+struct BalancesRequest;
+struct Balances;
+struct Rollback;
+struct MempoolChange;
+struct TxProof;
 using Transaction = std::variant<RewardTransaction, TransferTransaction>;
 }
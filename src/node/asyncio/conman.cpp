@@ -1,7 +1,14 @@
 #include "conman.hpp"
 #include "connection.hpp"
 #include "eventloop/eventloop.hpp"
+#include "general/thread_settings.hpp"
+#include "general/trace.hpp"
 #include "global/globals.hpp"
+#include "config/config.hpp"
+#include <map>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 static constexpr bool debug_refcount = false;
 
 //////////////////////////////
@@ -15,6 +22,7 @@ void Conman::new_connection_caller(uv_stream_t* server, int status)
 }
 void Conman::wakeup_caller(uv_async_t* handle)
 {
+    TRACE_ZONE("conman.events");
     Conman& cm = (*reinterpret_cast<Conman*>(handle->data));
     cm.on_wakeup();
 }
@@ -34,27 +42,51 @@ void Conman::reconnect_closed_cb(uv_handle_t* handle)
     ReconnectTimer& timer = (*reinterpret_cast<ReconnectTimer*>(handle->data));
     timer.conman->on_reconnect_closed(timer);
 }
+void Conman::shaping_caller(uv_timer_t* handle)
+{
+    Conman& cm = (*reinterpret_cast<Conman*>(handle->data));
+    cm.on_shaping_timer();
+}
+void Conman::replay_caller(uv_timer_t* handle)
+{
+    Conman& cm = (*reinterpret_cast<Conman*>(handle->data));
+    cm.on_replay_timer();
+}
 
 // ip counting
 bool Conman::count(IPv4 ip)
 {
-    return perIpCounter.insert(ip, max_conn_per_ip);
+    return perIpCounter->insert(ip, max_conn_per_ip);
 }
 void Conman::count_force(IPv4 ip)
 {
-    perIpCounter.insert(ip);
+    perIpCounter->insert(ip);
 }
 void Conman::uncount(IPv4 ip)
 {
-    perIpCounter.erase(ip);
+    perIpCounter->erase(ip);
 }
 
-// reference counting
+// connection registry, removal swaps with the last entry such that
+// seed nodes with many peers pay neither tree nodes nor lookups
+Connection& Conman::link(Connection* pcon)
+{
+    pcon->conmanIndex = connections.size();
+    connections.push_back(pcon);
+    addref("connection");
+    return *pcon;
+}
 void Conman::unlink(Connection* const pcon)
 {
-    connections.erase(pcon);
+    auto i { pcon->conmanIndex };
+    assert(i < connections.size() && connections[i] == pcon);
+    connections[i] = connections.back();
+    connections[i]->conmanIndex = i;
+    connections.pop_back();
     unref("connection");
 }
+
+// reference counting
 void Conman::addref(const char* tag)
 {
     std::unique_lock<std::mutex> lock(mutex);
@@ -76,38 +108,140 @@ void Conman::unref(const char* tag)
 
 void Conman::async_send(Connection* pcon) // CALLED BY PROCESSING THREAD
 {
-    std::unique_lock<std::mutex> lock(mutex);
-    events.push(Send { pcon });
-    uv_async_send(&wakeup);
+    async_add_event(Send { pcon });
+}
+void Conman::async_resume_read(Connection* pcon) // CALLED BY PROCESSING THREAD
+{
+    async_add_event(ResumeRead { pcon });
 }
 void Conman::async_delete(Connection* pcon) // POTENTIALLY CALLED BY OTHER THREAD
 {
-    std::unique_lock<std::mutex> lock(mutex);
-    events.push(Delete { pcon });
-    uv_async_send(&wakeup);
+    async_add_event(Delete { pcon });
 }
 void Conman::async_close(Connection* pcon,
     int32_t error) // POTENTIALLY CALLED BY OTHER THREAD
 {
-    std::unique_lock<std::mutex> lock(mutex);
-    events.push(Close { pcon, error });
-    uv_async_send(&wakeup);
+    async_add_event(Close { pcon, error });
 }
-void Conman::async_validate(Connection* c, bool accept, int64_t rowid)
+
+void Conman::async_get_peers(PeersCB cb)
 {
-    std::unique_lock<std::mutex> lock(mutex);
-    c->addref("validate");
-    events.push(Validation { c, accept, rowid });
-    uv_async_send(&wakeup);
+    if (shards.empty())
+        return async_add_event(GetPeers { std::move(cb) });
+
+    // collect the peers of all shards, the last one calls back
+    struct Collector {
+        std::mutex m;
+        size_t remaining;
+        std::vector<APIPeerdata> data;
+        PeersCB cb;
+    };
+    auto c { std::make_shared<Collector>() };
+    c->remaining = shards.size() + 1;
+    c->cb = std::move(cb);
+    auto collect { [c](std::vector<APIPeerdata> d) {
+        std::unique_lock l(c->m);
+        c->data.insert(c->data.end(), d.begin(), d.end());
+        if (--c->remaining == 0) {
+            l.unlock();
+            c->cb(std::move(c->data));
+        }
+    } };
+    async_add_event(GetPeers { collect });
+    for (auto& s : shards)
+        s->conman->async_add_event(GetPeers { collect });
+}
+
+void Conman::async_connect(std::vector<EndpointAddress> as)
+{
+    if (as.empty())
+        return;
+    if (shards.empty())
+        return async_add_event(ConnectBatch { std::move(as) });
+    std::map<Conman*, std::vector<EndpointAddress>> byShard;
+    for (auto& a : as)
+        byShard[&next_shard()].push_back(a);
+    for (auto& [c, v] : byShard)
+        c->async_add_event(ConnectBatch { std::move(v) });
+}
+
+Conman& Conman::next_shard()
+{
+    if (shards.empty())
+        return *this;
+    const size_t i { nextShard.fetch_add(1, std::memory_order_relaxed) % (shards.size() + 1) };
+    return i == 0 ? *this : *shards[i - 1]->conman;
+}
+
+Conman::Conman(uv_loop_t* l, const Conman& primary, const Config& config)
+    : peerServer(primary.peerServer)
+    , uvLoop(l)
+    , listening(false)
+    , bindAddress(config.node.bind)
+    , perIpCounter(primary.perIpCounter)
+    , shaper(primary.shaper)
+    , recorder(primary.recorder)
+{
+    server.data = wakeup.data = shapingTimer.data = replayTimer.data = nullptr;
+    init_wakeup();
+    init_shaping();
+}
+
+void Conman::init_wakeup()
+{
+    if (int i = uv_async_init(uvLoop, &wakeup, wakeup_caller); i < 0)
+        throw std::runtime_error(
+            "Cannot start connection manager (memory will leak): " + std::string(errors::err_name(i)));
+    wakeup.data = this;
+    addref("wakeup");
+}
+
+void Conman::init_shaping()
+{
+    if (!shaper->limited())
+        return;
+    if (int i = uv_timer_init(uvLoop, &shapingTimer); i < 0)
+        throw std::runtime_error(
+            "Cannot start upload shaping timer: " + std::string(errors::err_name(i)));
+    shapingTimer.data = this;
+    addref("shaping timer");
+    uv_timer_start(&shapingTimer, shaping_caller, 50, 50);
+}
+
+void Conman::init_replay(const Config& config)
+{
+    if (config.capture.replay.empty())
+        return;
+    replay.reset(new Replay {
+        .reader { config.capture.replay },
+        .paced = config.capture.replayPaced,
+        .started {},
+        .firstMicros {},
+        .pending {},
+        .connections {},
+    });
+    if (int i = uv_timer_init(uvLoop, &replayTimer); i < 0)
+        throw std::runtime_error(
+            "Cannot start session replay timer: " + std::string(errors::err_name(i)));
+    replayTimer.data = this;
+    addref("replay timer");
+    // starts once the other components are up
+    uv_timer_start(&replayTimer, replay_caller, 1000, 1);
+    spdlog::info("Replaying recorded sessions from {}", config.capture.replay);
 }
 
 Conman::Conman(uv_loop_t* l, PeerServer& peerServer, const Config& config,
     int backlog)
     : peerServer(peerServer)
+    , uvLoop(l)
+    , listening(true)
     , bindAddress(config.node.bind)
+    , perIpCounter(std::make_shared<SharedIpCounter>())
+    , shaper(std::make_shared<UploadShaper>(1000 * config.node.uploadLimitInbound, 1000 * config.node.uploadLimitOutbound))
+    , recorder(config.capture.file.empty() ? nullptr : std::make_shared<SessionRecorder>(config.capture.file, config.capture.peers))
 {
     int i;
-    server.data = wakeup.data = nullptr;
+    server.data = wakeup.data = shapingTimer.data = replayTimer.data = nullptr;
     if ((i = uv_tcp_init(l, &server)))
         throw std::runtime_error("Cannot initialize TCP Server");
     server.data = this;
@@ -120,16 +254,42 @@ Conman::Conman(uv_loop_t* l, PeerServer& peerServer, const Config& config,
     if ((i = uv_listen((uv_stream_t*)&server, backlog,
              new_connection_caller)))
         goto error;
-    if ((i = uv_async_init(l, &wakeup, wakeup_caller) < 0))
-        goto error;
-    wakeup.data = this;
-    addref("wakeup");
+    init_wakeup();
+    init_shaping();
+    init_replay(config);
+
+    for (size_t j = 1; j < config.node.ioThreads; ++j) {
+        auto& s { *shards.emplace_back(std::make_unique<Shard>()) };
+        if ((i = uv_loop_init(&s.loop)))
+            goto error;
+        s.conman.reset(new Conman(&s.loop, *this, config));
+    }
+    // threads are started only after all fallible setup, a throw must
+    // not destroy joinable threads
+    for (auto& p : shards) {
+        p->thread = std::thread([&s = *p, settings = config.threads.uv]() {
+            trace::set_thread_name("conman shard");
+            apply_thread_settings(settings, "conman shard");
+            uv_run(&s.loop, UV_RUN_DEFAULT);
+            uv_loop_close(&s.loop);
+        });
+    }
+    if (shards.size() > 0)
+        spdlog::info("Handling peer connections on {} libuv loops.", shards.size() + 1);
 
     return;
 error:
     throw std::runtime_error(
         "Cannot start connection manager (memory will leak): " + std::string(errors::err_name(i)));
 }
+
+Conman::~Conman()
+{
+    for (auto& s : shards) {
+        if (s->thread.joinable())
+            s->thread.join();
+    }
+}
 void Conman::on_connect(int status)
 {
     if (status != 0) {
@@ -137,21 +297,47 @@ void Conman::on_connect(int status)
             std::string(errors::err_name(status)), status);
         return;
     }
-    auto p = connections.emplace(new Connection(*this, true));
-    auto& conn = **p.first;
-    addref("connection");
+#ifndef _WIN32
+    if (auto& target { next_shard() }; &target != this) {
+        // accept here and hand the socket over to the shard's loop
+        auto t { new uv_tcp_t };
+        if ((status = uv_tcp_init(loop(), t))) {
+            delete t;
+            return;
+        }
+        uv_os_fd_t fd;
+        uv_os_sock_t sock { -1 };
+        if (uv_accept((uv_stream_t*)&server, (uv_stream_t*)t) == 0
+            && uv_fileno((uv_handle_t*)t, &fd) == 0)
+            sock = ::dup(fd);
+        uv_close((uv_handle_t*)t, [](uv_handle_t* h) { delete (uv_tcp_t*)h; });
+        if (sock < 0) {
+            spdlog::error("Failed to hand over accepted connection");
+            return;
+        }
+        target.async_add_event(Adopt { sock });
+        return;
+    }
+#endif
+    auto& conn { link(new Connection(*this, true)) };
     if (status = conn.accept(); status != 0)
         return conn.close(status);
-    peerServer.async_validate(*this, &conn);
+    validate(conn);
 }
-void Conman::on_wakeup()
+
+void Conman::validate(Connection& c)
 {
-    decltype(events) tmp;
-    { // lock for very short time (swap)
-        std::unique_lock<std::mutex> lock(mutex);
-        std::swap(tmp, events);
+    if (auto rowid { peerServer.validate(c.peer_address().ipv4) }) {
+        c.logrow = *rowid;
+        c.start_read();
+    } else {
+        c.close(EREFUSED);
     }
+}
 
+void Conman::on_wakeup()
+{
+    auto tmp { events.pop_all() };
     while (!tmp.empty()) {
         std::visit([&](auto& e) { handle_event(std::move(e)); }, tmp.front());
         tmp.pop();
@@ -170,6 +356,75 @@ void Conman::on_reconnect_closed(ReconnectTimer& t)
     unref("reconnect closed");
 }
 
+void Conman::on_shaping_timer()
+{
+    for (Connection* c : connections) {
+        if (c->state != Connection::State::CONNECTED)
+            continue;
+        if (int r = c->send_buffers())
+            c->close(r);
+    }
+}
+
+void Conman::on_replay_timer()
+{
+    auto& r { *replay };
+    using namespace std::chrono;
+    const auto now { steady_clock::now() };
+    if (r.started == steady_clock::time_point {})
+        r.started = now;
+    for (size_t n = 0; n < 1000; ++n) { // bounded work per tick
+        if (!r.pending) {
+            r.pending = r.reader.next();
+            if (!r.pending) {
+                // done once the eventloop extracted everything
+                for (auto& [_, c] : r.connections) {
+                    std::unique_lock<std::mutex> lock(c->mutex);
+                    if (!c->readbuffers.empty())
+                        return;
+                }
+                const double s { duration<double>(now - r.started).count() };
+                spdlog::info("Replayed {} messages of {} connections in {:.3f} s ({:.0f} messages/s), {} skipped after close",
+                    r.messages, r.connections.size(), s, r.messages / std::max(s, 1e-6), r.skipped);
+                return stop_replay();
+            }
+        }
+        auto& rec { *r.pending };
+        if (!r.firstMicros)
+            r.firstMicros = rec.micros;
+        if (r.paced && now - r.started < microseconds(rec.micros - *r.firstMicros))
+            return;
+        auto [iter, inserted] { r.connections.try_emplace(rec.connectionId, nullptr) };
+        if (inserted) {
+            auto& c { link(new Connection(*this, true)) };
+            c.addref("replay");
+            c.start_replayed(rec.ip);
+            iter->second = &c;
+        }
+        Connection& c { *iter->second };
+        if (c.state == Connection::State::CLOSING)
+            r.skipped += 1;
+        else if (!c.push_replayed(rec.wire))
+            return; // read queue full, keeps the recorded order
+        else
+            r.messages += 1;
+        r.pending.reset();
+    }
+}
+
+void Conman::stop_replay()
+{
+    if (!replay)
+        return;
+    uv_timer_stop(&replayTimer);
+    uv_close((uv_handle_t*)&replayTimer, close_caller);
+    for (auto& [_, c] : replay->connections) {
+        c->close(EREPLAYEND);
+        c->unref("replay");
+    }
+    replay.reset();
+}
+
 void Conman::handle_event(Delete&& e)
 {
     assert(e.c->state == Connection::State::CLOSING);
@@ -204,17 +459,9 @@ void Conman::handle_event(Send&& e)
 {
     e.c->send_buffers();
 }
-
-void Conman::handle_event(Validation&& e)
+void Conman::handle_event(ResumeRead&& e)
 {
-    Connection* c = e.c;
-    c->unref("validate");
-    c->logrow = e.rowid;
-    if (e.accept) { // accept
-        c->start_read();
-    } else {
-        c->close(EREFUSED);
-    }
+    e.c->resume_read();
 }
 
 void Conman::handle_event(GetPeers&& e)
@@ -224,6 +471,8 @@ void Conman::handle_event(GetPeers&& e)
         APIPeerdata item;
         item.address = c->peerAddress;
         item.since = c->connected_since;
+        item.id = c->id;
+        item.traffic = c->traffic.snapshot();
         data.push_back(item);
     }
     e.cb(std::move(data));
@@ -236,17 +485,48 @@ void Conman::handle_event(Connect&& c)
     }
 }
 
+void Conman::handle_event(ConnectBatch&& c)
+{
+    if (closing)
+        return;
+    for (auto& a : c.addresses)
+        connect(a, {});
+}
+
 void Conman::handle_event(Inspect&& e)
 {
     e.callback(*this);
 }
 
+void Conman::handle_event(Adopt&& e)
+{
+    if (closing) {
+#ifndef _WIN32
+        ::close(e.sock);
+#endif
+        return;
+    }
+    auto& conn { link(new Connection(*this, true)) };
+    if (int status = conn.adopt(e.sock); status != 0)
+        return conn.close(status);
+    validate(conn);
+}
+
+void Conman::handle_event(Shutdown&& e)
+{
+    close(e.reason);
+}
+
 void Conman::close(int32_t reason)
 {
     if (closing == true)
         return;
     closing = true;
-    global().pel->async_shutdown(reason);
+    if (listening) {
+        global().pel->async_shutdown(reason);
+        for (auto& s : shards)
+            s->conman->async_add_event(Shutdown { reason });
+    }
     // uv_async_send(&wakeup);
     if (server.data != nullptr) {
         uv_close((uv_handle_t*)&server, close_caller);
@@ -255,12 +535,18 @@ void Conman::close(int32_t reason)
         c->reconnectSleep.reset(); // avoid reconnect
         c->close(reason);
     }
+    if (shapingTimer.data != nullptr) {
+        uv_timer_stop(&shapingTimer);
+        uv_close((uv_handle_t*)&shapingTimer, close_caller);
+    }
+    stop_replay();
     for (auto& t : reconnectTimers) {
         t.nextReconnectSleep = 0;
         uv_timer_stop(&t.uv_timer);
         uv_close((uv_handle_t*)&t.uv_timer, reconnect_closed_cb);
     }
-    peerServer.async_shutdown();
+    if (listening)
+        peerServer.async_shutdown();
     if (closing && refcount == 1) { // 1 for the wakeup callback
         uv_close((uv_handle_t*)&wakeup, close_caller);
     }
@@ -268,9 +554,7 @@ void Conman::close(int32_t reason)
 
 void Conman::connect(EndpointAddress a, std::optional<uint32_t> reconnectSleep)
 {
-    auto p = connections.emplace(new Connection(*this, false, reconnectSleep));
-    auto& conn = **p.first;
-    addref("connection");
+    auto& conn { link(new Connection(*this, false, reconnectSleep)) };
     if (int i = conn.connect(a)) {
         conn.close(i);
         connection_log().error("Cannot connect: {}", errors::err_name(i));
@@ -1,15 +1,28 @@
 #pragma once
+#include "general/mpsc_queue.hpp"
 #include "helpers/per_ip_counter.hpp"
+#include "helpers/session_capture.hpp"
+#include "helpers/traffic.hpp"
+#include "helpers/upload_shaper.hpp"
 #include "peerserver/peerserver.hpp"
+#include <atomic>
 #include <list>
+#include <map>
+#include <memory>
 #include <set>
+#include <thread>
 
-#define DEFAULT_BACKLOG 128
+#define DEFAULT_BACKLOG 1024
 
 struct Config;
 struct Inspector;
 class Connection;
 class PeerServer;
+// Connection manager of a libuv loop. The Conman constructed on the main
+// loop listens on the P2P port and starts node.ioThreads-1 shards, each a
+// Conman with its own loop and thread. Accepted sockets and outbound
+// connects are distributed round-robin over all shards, per IP limits are
+// counted globally.
 class Conman {
     static constexpr size_t max_conn_per_ip = 3;
     friend class Connection;
@@ -26,57 +39,75 @@ private:
     static void close_caller(uv_handle_t* handle);
     static void reconnect_caller(uv_timer_t* handle);
     static void reconnect_closed_cb(uv_handle_t* handle);
+    static void shaping_caller(uv_timer_t* handle);
+    static void replay_caller(uv_timer_t* handle);
 
     //////////////////////////////
     // Private methods
     void on_connect(int status);
+    void validate(Connection&); // inbound, starts reading if not banned
     void on_wakeup();
     void on_reconnect_wakeup(ReconnectTimer& t);
     void on_reconnect_closed(ReconnectTimer& t);
+    void on_shaping_timer();
+    void on_replay_timer();
+    Conman& next_shard(); // round-robin over this and the shards
 
     // ip counting
     bool count(IPv4);
     void count_force(IPv4);
     void uncount(IPv4);
 
-    // reference counting
+    // connection registry
+    Connection& link(Connection* pcon);
     void unlink(Connection* const pcon);
+
+    // reference counting
     void addref(const char*);
     void unref(const char*);
 
     void async_send(Connection* pcon); // CALLED BY PROCESSING THREAD
+    void async_resume_read(Connection* pcon); // CALLED BY PROCESSING THREAD
     void async_delete(Connection* pcon); // POTENTIALLY CALLED BY OTHER THREAD
     void async_close(Connection* pcon, int32_t error); // POTENTIALLY CALLED BY OTHER THREAD
-    void async_validate(Connection* c, bool accept, int64_t rowid); // CALLED BY OTHER THREAD
 
 public:
     struct APIPeerdata {
         EndpointAddress address;
         uint32_t since;
+        uint64_t id;
+        Traffic::Snapshot traffic;
     };
     using PeersCB = std::function<void(std::vector<APIPeerdata>)>;
 
-    void async_get_peers(PeersCB cb)
-    {
-        async_add_event(GetPeers { std::move(cb) });
-    }
+    void async_get_peers(PeersCB cb);
     void async_connect(EndpointAddress a, std::optional<uint32_t> reconnectSleep = {})
     {
-        async_add_event(Connect { a, reconnectSleep });
+        next_shard().async_add_event(Connect { a, reconnectSleep });
     }
+    void async_connect(std::vector<EndpointAddress>); // one event per shard
     void async_inspect(std::function<void(const Conman&)>&& cb)
     {
         async_add_event(Inspect { std::move(cb) });
     }
-    uv_loop_t* loop() { return server.loop; }
+    uv_loop_t* loop() { return uvLoop; }
 
     Conman(uv_loop_t* l, PeerServer& peerdb, const Config&,
         int backlog = DEFAULT_BACKLOG);
+    ~Conman();
     void connect(EndpointAddress, std::optional<uint32_t> reconnectSleep = 0);
     void close(int32_t reason);
 
 private:
+    Conman(uv_loop_t* l, const Conman& primary, const Config&); // shard
+    void init_wakeup();
+    void init_shaping();
+    void init_replay(const Config&);
+    void stop_replay();
+
     PeerServer& peerServer;
+    uv_loop_t* const uvLoop;
+    const bool listening; // false for shards
     struct ReconnectTimer {
         Conman* conman;
         uv_timer_t uv_timer;
@@ -87,13 +118,39 @@ private:
     const EndpointAddress bindAddress;
     //--------------------------------------
     // data accessed by libuv thread
-    PerIpCounter perIpCounter;
-    std::set<Connection*> connections;
+    std::shared_ptr<SharedIpCounter> perIpCounter;
+    std::shared_ptr<UploadShaper> shaper; // shared by the shards
+    std::shared_ptr<SessionRecorder> recorder; // shared by the shards
+    std::vector<Connection*> connections; // unordered, indexed by Connection::conmanIndex
     std::list<ReconnectTimer> reconnectTimers;
     int refcount { 0 }; // count connections + tcp_handle + wakeup
     bool closing = false;
     uv_tcp_t server;
     uv_async_t wakeup;
+    uv_timer_t shapingTimer; // resumes bulk sends throttled by the shaper
+
+    // recorded sessions fed into the eventloop, only in the listening Conman
+    struct Replay {
+        SessionReader reader;
+        bool paced;
+        std::chrono::steady_clock::time_point started;
+        std::optional<uint64_t> firstMicros; // recorded time of the first message
+        std::optional<SessionRecord> pending;
+        std::map<uint64_t, Connection*> connections; // by recorded id, referenced
+        size_t messages { 0 };
+        size_t skipped { 0 }; // of connections closed by the eventloop
+    };
+    std::unique_ptr<Replay> replay;
+    uv_timer_t replayTimer;
+
+    // shards, only set in the listening Conman
+    struct Shard {
+        uv_loop_t loop;
+        std::unique_ptr<Conman> conman;
+        std::thread thread;
+    };
+    std::vector<std::unique_ptr<Shard>> shards;
+    std::atomic<size_t> nextShard { 0 };
 
     // MESSAGE QUEUE
     struct Delete {
@@ -106,10 +163,8 @@ private:
     struct Send {
         Connection* c;
     };
-    struct Validation {
+    struct ResumeRead {
         Connection* c;
-        bool accept;
-        int64_t rowid;
     };
     struct GetPeers {
         PeersCB cb;
@@ -118,27 +173,39 @@ private:
         EndpointAddress a;
         std::optional<uint32_t> reconnectSleep;
     };
+    struct ConnectBatch {
+        std::vector<EndpointAddress> addresses;
+    };
     struct Inspect {
         std::function<void(const Conman&)> callback;
     };
-    using Event = std::variant<Delete, Close, Send, Validation, GetPeers, Connect, Inspect>;
+    struct Adopt { // socket accepted by the listening Conman
+        uv_os_sock_t sock;
+    };
+    struct Shutdown {
+        int32_t reason;
+    };
+    using Event = std::variant<Delete, Close, Send, ResumeRead, GetPeers, Connect, ConnectBatch, Inspect, Adopt, Shutdown>;
     void async_add_event(Event e)
     {
-        std::unique_lock<std::mutex> lock(mutex);
-        events.push(std::move(e));
-        uv_async_send(&wakeup);
+        if (events.push(std::move(e))) // one wakeup covers all pending events
+            uv_async_send(&wakeup);
     }
     //--------------------------------------
-    // uv-mutex  locked shared members (message queues for uv thread)
+    // uv-mutex  locked shared members
     std::mutex mutex;
-    std::queue<Event> events;
+    // lock-free message queue for uv thread
+    MPSCQueue<Event> events;
 
     // handle_event functions
     void handle_event(Delete&&);
     void handle_event(Close&&);
     void handle_event(Send&&);
-    void handle_event(Validation&&);
+    void handle_event(ResumeRead&&);
     void handle_event(GetPeers&&);
     void handle_event(Connect&&);
+    void handle_event(ConnectBatch&&);
     void handle_event(Inspect&&);
+    void handle_event(Adopt&&);
+    void handle_event(Shutdown&&);
 };
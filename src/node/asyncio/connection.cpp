@@ -1,9 +1,16 @@
 #include "connection.hpp"
 #include "eventloop/eventloop.hpp"
+#include "general/logging.hpp"
+#include "general/trace.hpp"
 #include "global/globals.hpp"
 #include "version.hpp"
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 
 static constexpr bool debug_refcount = true;
+// connection floods must not stall the libuv loops on log writes
+static LogLimiter connectionEvents { "connection events", 50 };
 //////////////////////////////
 // static members to be used as c callback functions in libuv
 //////////////////////////////
@@ -16,6 +23,7 @@ void Connection::alloc_caller(uv_handle_t* handle, size_t suggested_size,
 
 void Connection::write_caller(uv_write_t* req, int status)
 {
+    TRACE_ZONE("conman.write");
     Connection& con = (*reinterpret_cast<Connection*>(req->data));
     con.write_cb(status);
 }
@@ -23,6 +31,7 @@ void Connection::write_caller(uv_write_t* req, int status)
 void Connection::read_caller(uv_stream_t* stream, ssize_t nread,
     const uv_buf_t* buf)
 {
+    TRACE_ZONE("conman.read");
     Connection& con = (*reinterpret_cast<Connection*>(stream->data));
     con.read_cb(nread, buf);
 }
@@ -51,10 +60,14 @@ void Connection::close_caller(uv_handle_t* handle)
 
 void Connection::write_cb(int status)
 {
+    bool pending;
     {
         std::unique_lock<std::mutex> lock(mutex);
-        bufferedbytes -= buffers.front().buf.len;
-        buffers.erase(buffers.begin());
+        bufferedbytes -= writeBatch.bytes;
+        writeBatch.buffers.clear();
+        writeBatch.bufs.clear();
+        writeBatch.bytes = 0;
+        pending = !buffers.empty() || !bulkBuffers.empty();
     }
     if (state != State::CONNECTED && state != State::HANDSHAKE)
         return;
@@ -62,6 +75,10 @@ void Connection::write_cb(int status)
         close(status);
         return;
     }
+    if (pending) {
+        if (int r = send_buffers())
+            close(r);
+    }
 }
 void Connection::read_cb(ssize_t nread, const uv_buf_t* /*buf*/)
 {
@@ -143,19 +160,21 @@ void Connection::read_cb(ssize_t nread, const uv_buf_t* /*buf*/)
             return;
         }
     }
-    if (stagebuffer.body.bytes.size() != 0 && stagebuffer.pos == 8 + stagebuffer.body.bytes.size()) {
-        if (stagebuffer.finished()) {
-            spdlog::debug("Received complete message");
+    if (stagebuffer.finished()) {
+        spdlog::debug("Received complete message");
+        traffic.on_received(stagebuffer.type(), stagebuffer.bsize + 8);
+        if (auto& r { conman.recorder }; r && r->selected(peerAddress.ipv4))
+            r->record(id, peerAddress.ipv4, std::span(stagebuffer.header, 8), stagebuffer.body.bytes());
 
-            {
-                std::unique_lock<std::mutex> lock(mutex);
-                readbuffers.push_back(std::move(stagebuffer));
-                stagebuffer.pos = 0;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            readbuffers.push_back(std::move(stagebuffer));
+            if (readbuffers.size() >= maxReadQueue && !readPaused) {
+                readPaused = true;
+                uv_read_stop((uv_stream_t*)&tcp);
             }
-            eventloop_notify();
-        } else {
-            stagebuffer.realloc();
         }
+        eventloop_notify();
     }
 }
 void Connection::alloc_cb(size_t /*suggested_size*/, uv_buf_t* buf)
@@ -171,8 +190,8 @@ void Connection::alloc_cb(size_t /*suggested_size*/, uv_buf_t* buf)
         return;
     }
     size_t offset = stagebuffer.pos - 8;
-    buf->base = (char*)stagebuffer.body.bytes.data() + offset;
-    buf->len = stagebuffer.body.bytes.size() - offset;
+    buf->base = (char*)stagebuffer.body.slab.data() + offset;
+    buf->len = stagebuffer.bsize - offset;
 }
 void Connection::connect_cb(int status)
 {
@@ -181,7 +200,7 @@ void Connection::connect_cb(int status)
         return;
     }
     state = State::HANDSHAKE;
-    conman.perIpCounter.insert(peerAddress.ipv4);
+    conman.count_force(peerAddress.ipv4);
 
     if ((status = start_read()))
         close(status);
@@ -189,19 +208,16 @@ void Connection::connect_cb(int status)
         send_handshake();
 }
 
-uint64_t Connection::idcounter = 1; // global counter of ids
+std::atomic<uint64_t> Connection::idcounter = 1; // global counter of ids
 
 Connection::Connection(Conman& conman, bool inbound, std::optional<uint32_t> reconnectSeconds)
     : reconnectSleep(reconnectSeconds)
     , inbound(inbound)
-    , id(idcounter++)
+    , id(next_id())
     , connected_since(now_timestamp())
     , conman(conman)
     , handshakedata(new Handshakedata())
-    , buffercursor(buffers.end())
 {
-    if (idcounter == 0)
-        idcounter = 1; // id shall never be 0
     tcp.data = nullptr;
     timer.data = nullptr;
 }
@@ -238,25 +254,79 @@ void Connection::send_handshake_ack()
 int Connection::send_buffers()
 {
     std::unique_lock<std::mutex> lock(mutex);
-    while (buffercursor != buffers.end()) {
-        buffercursor->write_t.data = this;
-        if (int r = uv_write(&buffercursor->write_t, (uv_stream_t*)&tcp,
-                &buffercursor->buf, 1, write_caller))
-            return r;
-        ++buffercursor;
+    sendScheduled = false;
+    auto& b { writeBatch };
+    if (b.in_flight() || (buffers.empty() && bulkBuffers.empty()))
+        return 0;
+    // relay buffers first, bulk buffers only within the upload limit
+    auto& shaper { *conman.shaper };
+    auto take = [&](Fifo<Writebuffer>& from) {
+        auto& wb { b.buffers.emplace_back(std::move(from.front())) };
+        from.pop_front();
+        b.bufs.push_back(wb.buf);
+        b.bytes += wb.buf.len;
+        shaper.consume(inbound, wb.buf.len);
+    };
+    auto batch_full = [&]() {
+        return b.bytes >= WriteBatch::maxBytes || b.buffers.size() >= WriteBatch::maxBuffers;
+    };
+    while (!buffers.empty() && !batch_full())
+        take(buffers);
+    while (!bulkBuffers.empty() && !batch_full() && shaper.allow_bulk(inbound))
+        take(bulkBuffers);
+    if (!b.in_flight())
+        return 0; // throttled, retried on the conman's shaping timer
+    b.write_t.data = this;
+    if (int r = uv_write(&b.write_t, (uv_stream_t*)&tcp, b.bufs.data(),
+            b.bufs.size(), write_caller)) {
+        bufferedbytes -= b.bytes;
+        b.buffers.clear();
+        b.bufs.clear();
+        b.bytes = 0;
+        return r;
     }
     return 0;
 }
 
+uint64_t Connection::next_id()
+{
+    uint64_t id;
+    while ((id = idcounter.fetch_add(1, std::memory_order_relaxed)) == 0)
+        ; // id shall never be 0
+    return id;
+}
+
 int Connection::accept()
 {
     int i;
-    if ((i = uv_tcp_init(conman.server.loop, &tcp)))
+    if ((i = uv_tcp_init(conman.loop(), &tcp)))
         return i;
     if ((i = uv_accept((uv_stream_t*)&conman.server, (uv_stream_t*)&tcp)))
         return i;
     tcp.data = this;
     addref("tcp");
+    return accepted();
+}
+
+int Connection::adopt(uv_os_sock_t sock)
+{
+    int i;
+    if ((i = uv_tcp_init(conman.loop(), &tcp)))
+        return i;
+    if ((i = uv_tcp_open(&tcp, sock))) {
+#ifndef _WIN32
+        ::close(sock);
+#endif
+        return i;
+    }
+    tcp.data = this;
+    addref("tcp");
+    return accepted();
+}
+
+int Connection::accepted()
+{
+    int i;
 
     // extract ip and port
     sockaddr_storage storage;
@@ -268,7 +338,8 @@ int Connection::accept()
     sockaddr_in* addr_i4 = (struct sockaddr_in*)&storage;
     peerAddress.ipv4 = IPv4(ntoh32(uint32_t(addr_i4->sin_addr.s_addr)));
     peerAddress.port = addr_i4->sin_port;
-    connection_log().info("{} new incoming", to_string());
+    if (connectionEvents.allow())
+        connection_log().info("{} new incoming", to_string());
     if (!conman.count(peerAddress.ipv4)) {
         return EMAXCONNECTIONS;
     };
@@ -283,7 +354,7 @@ int Connection::start_read()
         return 0;
     }
     handshakedata.reset(new Handshakedata());
-    assert(uv_timer_init(conman.server.loop, &timer) == 0);
+    assert(uv_timer_init(conman.loop(), &timer) == 0);
     assert(uv_timer_start(&timer, timeout_caller, 5000, 0) == 0);
     timer.data = this;
     addref("timer");
@@ -292,10 +363,67 @@ int Connection::start_read()
     return 0;
 }
 
+void Connection::resume_read()
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!readPaused || readbuffers.size() >= maxReadQueue / 2)
+            return;
+        readPaused = false;
+    }
+    if (state != State::CONNECTED)
+        return;
+    if (int i = uv_read_start((uv_stream_t*)&tcp, alloc_caller, read_caller))
+        close(i);
+}
+
+void Connection::start_replayed(IPv4 ip)
+{
+    replayed = true;
+    peerAddress = EndpointAddress(ip, 0);
+    peerEndpointPort = 0;
+    peerVersion = version;
+    handshakedata.reset();
+    conman.count_force(ip);
+    state = State::CONNECTED;
+}
+
+bool Connection::push_replayed(std::span<const uint8_t> wire)
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (readbuffers.size() >= maxReadQueue)
+            return false;
+    }
+    Rcvbuffer b;
+    if (wire.size() < 10) {
+        close(EMSGLEN);
+        return true;
+    }
+    memcpy(b.header, wire.data(), sizeof(b.header));
+    if (int r = b.allocate_body()) {
+        close(r);
+        return true;
+    }
+    if (wire.size() != b.bsize + 8) {
+        close(EMSGLEN);
+        return true;
+    }
+    memcpy(b.body.slab.data(), wire.data() + 8, b.bsize);
+    b.pos = b.bsize + 8;
+    traffic.on_received(b.type(), b.pos);
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        readbuffers.push_back(std::move(b));
+    }
+    eventloop_notify();
+    return true;
+}
+
 int Connection::connect(EndpointAddress a)
 {
     int i;
-    if ((i = uv_tcp_init(conman.server.loop, &tcp)))
+    if ((i = uv_tcp_init(conman.loop(), &tcp)))
         return i;
     tcp.data = this;
     addref("tcp");
@@ -304,7 +432,8 @@ int Connection::connect(EndpointAddress a)
     uv_connect_t* p = new uv_connect_t;
     p->data = this;
     auto addr { a.sock_addr() };
-    connection_log().info("{} connecting ", to_string());
+    if (connectionEvents.allow())
+        connection_log().info("{} connecting ", to_string());
     if (i = uv_tcp_connect(p, &tcp, (const sockaddr*)&addr, connect_caller); i != 0) {
         delete p;
     } else {
@@ -319,7 +448,7 @@ void Connection::close(int errcode)
     if (state == State::CLOSING)
         return;
     if (state != State::CONNECTING) {
-        conman.perIpCounter.erase(peerAddress.ipv4);
+        conman.uncount(peerAddress.ipv4);
     }
 
     if (errors::is_malicious(errcode)) {
@@ -332,19 +461,22 @@ void Connection::close(int errcode)
     }
 
     state = State::CLOSING;
-    connection_log().info("{} closed: {} ({})",
-        to_string(), errors::err_name(errcode), errors::strerror(errcode));
-    conman.peerServer.async_register_close(peerAddress.ipv4, errcode, logrow);
+    if (connectionEvents.allow())
+        connection_log().info("{} closed: {} ({})",
+            to_string(), errors::err_name(errcode), errors::strerror(errcode));
+    if (!replayed) // recorded offenses must not ban the original peer
+        conman.peerServer.async_register_close(peerAddress.ipv4, errcode, logrow);
     if (eventloopref) {
         global().pel->async_erase(this);
     }
     std::unique_lock<std::mutex> lock(mutex);
 
     // delete unsent buffers
-    while (buffercursor != buffers.end()) {
-        bufferedbytes -= buffercursor->buf.len;
-        buffers.erase(buffercursor++);
-    }
+    auto unbuffer = [&](Writebuffer& wb) { bufferedbytes -= wb.buf.len; };
+    buffers.for_each(unbuffer);
+    bulkBuffers.for_each(unbuffer);
+    buffers.clear();
+    bulkBuffers.clear();
 
     if (tcp.data != nullptr)
         uv_close((uv_handle_t*)&tcp, close_caller);
@@ -374,12 +506,19 @@ void Connection::addref_locked(const char* tag)
 //////////////////////////////
 
 // CALLED BY OTHER THREAD
-std::vector<Rcvbuffer> Connection::extractMessages()
+Connection::Extracted Connection::extract_messages(size_t max)
 {
     std::unique_lock<std::mutex> lock(mutex);
-    std::vector<Rcvbuffer> tmp;
-    tmp.swap(readbuffers);
-    return tmp;
+    Extracted res { .messages {}, .more = false };
+    res.messages.reserve(std::min(max, readbuffers.size()));
+    while (res.messages.size() < max && !readbuffers.empty()) {
+        res.messages.push_back(std::move(readbuffers.front()));
+        readbuffers.pop_front();
+    }
+    res.more = !readbuffers.empty();
+    if (readPaused && readbuffers.size() < maxReadQueue / 2)
+        conman.async_resume_read(this);
+    return res;
 }
 
 std::string Connection::to_string() const
@@ -425,23 +564,47 @@ void Connection::unref(const char* tag)
 }
 
 // CALLED BY OTHER THREAD
-void Connection::async_send(std::unique_ptr<char[]>&& data, size_t size)
+template <typename... Args>
+void Connection::async_send_emplace(bool bulk, Args&&... args)
 {
+    if (replayed)
+        return;
     std::unique_lock<std::mutex> lock(mutex);
-    buffers.emplace_back(std::move(data), size);
-    bufferedbytes += size;
-    if (buffercursor == buffers.end())
-        --buffercursor;
+    auto& wb { (bulk ? bulkBuffers : buffers).emplace_back(std::forward<Args>(args)...) };
+    bufferedbytes += wb.buf.len;
     if (bufferedbytes >= MAXBUFFER) {
         async_close(EBUFFERFULL);
     }
-    conman.async_send(this);
+    // an in flight batch flushes the queue on completion
+    if (!sendScheduled && !writeBatch.in_flight()) {
+        sendScheduled = true;
+        conman.async_send(this);
+    }
+}
+
+void Connection::async_send(std::unique_ptr<char[]>&& data, size_t size, bool bulk)
+{
+    async_send_emplace(bulk, std::move(data), size);
+}
+
+void Connection::async_send(SharedSndbuffer data, bool bulk)
+{
+    async_send_emplace(bulk, std::move(data));
 }
 
 void Connection::asyncsend(Sndbuffer&& msg)
 {
     msg.writeChecksum();
-    async_send(std::move(msg.ptr), msg.fullsize());
+    const uint8_t type = msg.ptr[9];
+    traffic.on_sent(type, msg.fullsize());
+    async_send(std::move(msg.ptr), msg.fullsize(), UploadShaper::bulk(type));
+}
+
+void Connection::asyncsend(const SharedSndbuffer& msg)
+{
+    const uint8_t type = msg.data()[9];
+    traffic.on_sent(type, msg.fullsize());
+    async_send(msg, UploadShaper::bulk(type));
 }
 
 void Connection::async_close(int32_t errcode) { conman.async_close(this, errcode); }
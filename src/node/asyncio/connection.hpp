@@ -3,6 +3,8 @@
 #include "communication/buffers/sndbuffer.hpp"
 #include "conman.hpp"
 #include "eventloop/types/conref_declaration.hpp"
+#include "helpers/fifo.hpp"
+#include "helpers/traffic.hpp"
 
 class Connection final {
 private:
@@ -10,14 +12,35 @@ private:
     // Conman using delete It must be created with new
     friend class Conman;
     struct Writebuffer {
-        uv_write_t write_t;
         uv_buf_t buf;
         Writebuffer(std::unique_ptr<char[]>&& data, size_t size)
+            : owned(std::move(data))
         {
             buf.len = size;
-            buf.base = data.release();
+            buf.base = owned.get();
+        }
+        Writebuffer(SharedSndbuffer data)
+            : shared(std::move(data))
+        {
+            buf.len = shared->fullsize();
+            buf.base = const_cast<char*>(shared->data()); // libuv does not write
         }
-        ~Writebuffer() { delete[] buf.base; }
+
+    private:
+        std::unique_ptr<char[]> owned;
+        std::optional<SharedSndbuffer> shared;
+    };
+    // Pending buffers are gathered into a single uv_write with one uv_buf_t
+    // per message. Only one batch is in flight, messages queued meanwhile
+    // are flushed together when it completes.
+    struct WriteBatch {
+        static constexpr size_t maxBytes = 256 * 1024;
+        static constexpr size_t maxBuffers = 1024; // IOV_MAX on most systems
+        uv_write_t write_t;
+        std::vector<Writebuffer> buffers;
+        std::vector<uv_buf_t> bufs;
+        size_t bytes { 0 };
+        bool in_flight() const { return !buffers.empty(); }
     };
     struct Handshakedata {
         std::array<uint8_t, 25> recvbuf; // 14 bytes for "WARTHOG GRUNT!" and 4
@@ -66,20 +89,33 @@ private:
 
     //////////////////////////////
     // mutex protected methods
-    void async_send(std::unique_ptr<char[]>&& data, size_t size);
+    void async_send(std::unique_ptr<char[]>&& data, size_t size, bool bulk = false);
+    void async_send(SharedSndbuffer data, bool bulk);
+    template <typename... Args>
+    void async_send_emplace(bool bulk, Args&&... args);
 
 public:
+    // Received messages are buffered until the eventloop extracts them.
+    // Reading from the socket is paused while maxReadQueue messages are
+    // buffered and resumed once the eventloop drained half of them.
+    static constexpr size_t maxReadQueue = 64;
+    struct Extracted {
+        std::vector<Rcvbuffer> messages;
+        bool more; // further messages remain buffered
+    };
     enum class State { CONNECTING,
         HANDSHAKE,
         CONNECTED,
         CLOSING,
     };
-    std::vector<Rcvbuffer> extractMessages();
+    Extracted extract_messages(size_t max);
     void eventloop_unref(const char* tag);
     void asyncsend(Sndbuffer&& msg);
+    void asyncsend(const SharedSndbuffer& msg);
     void async_close(int errcode);
     [[nodiscard]] EndpointAddress peer_address() { return peerAddress; }
     [[nodiscard]] EndpointAddress peer_endpoint() { return EndpointAddress { peerAddress.ipv4, peerEndpointPort }; }
+    [[nodiscard]] uint32_t peer_version() const { return peerVersion; }
 
 private:
     void unref(const char* tag);
@@ -99,36 +135,51 @@ private:
     //////////////////////////////
     // Connection initialization
     int accept();
+    int adopt(uv_os_sock_t); // socket accepted on another loop
+    int accepted();
     int connect(EndpointAddress);
     int start_read();
+    void resume_read();
     void eventloop_notify();
 
+    //////////////////////////////
+    // replay of recorded sessions, without socket and discarding sends
+    void start_replayed(IPv4);
+    // feeds a recorded wire message as if read from the socket, returns
+    // false while the read queue is full
+    bool push_replayed(std::span<const uint8_t> wire);
+
 public:
     // data accessed by eventloop thread
     bool eventloop_erased = false;
     bool eventloop_registered = false;
+    bool eventloop_queued = false; // has buffered messages not yet extracted
+    size_t eventloop_sync_queued = 0; // extracted messages in the sync queue
     std::optional<uint32_t> reconnectSleep;
     const bool inbound;
     const uint64_t id;
     const uint32_t connected_since;
     Coniter dataiter;
+    Traffic traffic; // thread safe
 
     // methods not requiring mutex
     std::string to_string() const;
 
 private:
-    static uint64_t
-        idcounter; // not synchronized, only create connections in one thread
+    static uint64_t next_id();
+    static std::atomic<uint64_t> idcounter; // shared by all Conman shards
 
     //////////////////////////////
     // data accessed by libuv thread
     Conman& conman;
+    size_t conmanIndex; // position in the conman's connection registry
     Rcvbuffer stagebuffer;
     std::unique_ptr<Handshakedata> handshakedata;
     uint32_t peerVersion;
     int64_t logrow = -1;
     State state;
     bool eventloopref = false; // whether the eventloop took notice of this connection
+    bool replayed = false; // set before the eventloop takes notice
     EndpointAddress peerAddress;
     uint16_t peerEndpointPort;
     uv_tcp_t tcp;
@@ -138,9 +189,12 @@ private:
     // Mutex locked members
     std::mutex mutex;
     int refcount { 0 };
-    std::list<Writebuffer> buffers; // FIFO queue
+    Fifo<Writebuffer> buffers; // unsent relay buffers
+    Fifo<Writebuffer> bulkBuffers; // unsent sync replies, shaped and sent after relay buffers
+    WriteBatch writeBatch;
+    bool sendScheduled = false; // Send event pending in conman
     std::set<EndpointAddress> reconnect;
-    uint32_t bufferedbytes = 0;
-    std::list<Writebuffer>::iterator buffercursor;
-    std::vector<Rcvbuffer> readbuffers;
+    uint32_t bufferedbytes = 0; // unsent and in flight, bounded by MAXBUFFER
+    Fifo<Rcvbuffer> readbuffers;
+    bool readPaused = false;
 };
@@ -0,0 +1,65 @@
+#pragma once
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <optional>
+
+// FIFO queue on a ring buffer that owns no memory while empty. Unlike
+// std::deque, which allocates a node even when empty, idle connections
+// cost nothing here, the ring is released once drained.
+template <typename T>
+class Fifo {
+public:
+    bool empty() const { return n == 0; }
+    size_t size() const { return n; }
+    T& front()
+    {
+        assert(n > 0);
+        return *ring[head];
+    }
+    template <typename... Args>
+    T& emplace_back(Args&&... args)
+    {
+        if (n == capacity)
+            grow();
+        auto& slot { ring[(head + n) & (capacity - 1)] };
+        slot.emplace(std::forward<Args>(args)...);
+        n += 1;
+        return *slot;
+    }
+    void push_back(T&& t) { emplace_back(std::move(t)); }
+    void pop_front()
+    {
+        assert(n > 0);
+        ring[head].reset();
+        head = (head + 1) & (capacity - 1);
+        if (--n == 0)
+            clear();
+    }
+    void clear()
+    {
+        ring.reset();
+        capacity = head = n = 0;
+    }
+    void for_each(auto&& f)
+    {
+        for (size_t i = 0; i < n; ++i)
+            f(*ring[(head + i) & (capacity - 1)]);
+    }
+
+private:
+    void grow()
+    {
+        const size_t newCapacity { capacity == 0 ? 4 : 2 * capacity };
+        auto r { std::make_unique<std::optional<T>[]>(newCapacity) };
+        for (size_t i = 0; i < n; ++i)
+            r[i].emplace(std::move(*ring[(head + i) & (capacity - 1)]));
+        ring = std::move(r);
+        capacity = newCapacity;
+        head = 0;
+    }
+    std::unique_ptr<std::optional<T>[]> ring;
+    size_t capacity { 0 }; // power of two
+    size_t head { 0 };
+    size_t n { 0 };
+};
@@ -3,6 +3,7 @@
 #include "general/tcp_util.hpp"
 #include <limits>
 #include <map>
+#include <mutex>
 
 class PerIpCounter {
 public:
@@ -14,3 +15,28 @@ public:
 private:
     std::map<IPv4, size_t> counts;
 };
+
+// PerIpCounter shared by the connection manager shards running on
+// different threads such that limits stay global
+class SharedIpCounter {
+public:
+    bool insert(IPv4 ip, size_t max = std::numeric_limits<size_t>::max())
+    {
+        std::lock_guard l(m);
+        return counter.insert(ip, max);
+    }
+    void erase(IPv4 ip)
+    {
+        std::lock_guard l(m);
+        counter.erase(ip);
+    }
+    auto data() const
+    {
+        std::lock_guard l(m);
+        return counter.data();
+    }
+
+private:
+    mutable std::mutex m;
+    PerIpCounter counter;
+};
@@ -0,0 +1,69 @@
+#include "session_capture.hpp"
+#include "general/reader.hpp"
+#include "general/writer.hpp"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+constexpr char magic[8] { 'W', 'A', 'R', 'T', 'C', 'A', 'P', '1' };
+constexpr size_t recordHeaderSize { 8 + 8 + 4 + 4 };
+constexpr size_t maxWireSize { 64 * 1024 * 1024 };
+}
+
+SessionRecorder::SessionRecorder(const std::string& path, std::vector<IPv4> peers)
+    : peers(std::move(peers))
+    , started(std::chrono::steady_clock::now())
+    , f(path, std::ios::binary | std::ios::trunc)
+{
+    if (!f)
+        throw std::runtime_error("Cannot open capture file " + path);
+    f.write(magic, sizeof(magic));
+}
+
+bool SessionRecorder::selected(IPv4 ip) const
+{
+    return peers.empty() || std::ranges::find(peers, ip) != peers.end();
+}
+
+void SessionRecorder::record(uint64_t connectionId, IPv4 ip, std::span<const uint8_t> prefix, std::span<const uint8_t> body)
+{
+    using namespace std::chrono;
+    const uint64_t micros = duration_cast<microseconds>(steady_clock::now() - started).count();
+    std::array<uint8_t, recordHeaderSize> h;
+    Writer(h.data(), h.size()) << micros << connectionId << ip.data << uint32_t(prefix.size() + body.size());
+    std::lock_guard l(m);
+    f.write(reinterpret_cast<const char*>(h.data()), h.size());
+    f.write(reinterpret_cast<const char*>(prefix.data()), prefix.size());
+    f.write(reinterpret_cast<const char*>(body.data()), body.size());
+}
+
+SessionReader::SessionReader(const std::string& path)
+    : f(path, std::ios::binary)
+{
+    char m[sizeof(magic)];
+    if (!f || !f.read(m, sizeof(m)) || memcmp(m, magic, sizeof(m)) != 0)
+        throw std::runtime_error("Cannot open recording " + path);
+}
+
+std::optional<SessionRecord> SessionReader::next()
+{
+    std::array<uint8_t, recordHeaderSize> h;
+    if (!f.read(reinterpret_cast<char*>(h.data()), h.size()))
+        return {};
+    Reader r(h);
+    SessionRecord rec {
+        .micros = r.uint64(),
+        .connectionId = r.uint64(),
+        .ip = IPv4(r.uint32()),
+        .wire {},
+    };
+    const uint32_t len { r.uint32() };
+    if (len > maxWireSize)
+        throw std::runtime_error("Corrupted recording, message length " + std::to_string(len));
+    rec.wire.resize(len);
+    if (!f.read(reinterpret_cast<char*>(rec.wire.data()), len))
+        return {}; // truncated by an unclean shutdown
+    return rec;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include "general/tcp_util.hpp"
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+// Recordings of inbound p2p sessions (config capture.file) for replaying
+// real message mixes into the eventloop (config capture.replay).
+//
+// File: 8 byte magic, then records of uint64 microseconds since the start
+// of the recording, uint64 connection id, uint32 peer IPv4, uint32 length
+// and the message as on the wire (size, checksum, type and payload).
+struct SessionRecord {
+    uint64_t micros;
+    uint64_t connectionId;
+    IPv4 ip;
+    std::vector<uint8_t> wire;
+};
+
+// shared by the connection manager shards
+class SessionRecorder {
+public:
+    SessionRecorder(const std::string& path, std::vector<IPv4> peers);
+    bool selected(IPv4 ip) const;
+    // wire message given as its 8 byte size and checksum prefix and body
+    void record(uint64_t connectionId, IPv4 ip, std::span<const uint8_t> prefix, std::span<const uint8_t> body);
+
+private:
+    const std::vector<IPv4> peers; // all if empty
+    const std::chrono::steady_clock::time_point started;
+    std::mutex m;
+    std::ofstream f;
+};
+
+class SessionReader {
+public:
+    SessionReader(const std::string& path);
+    std::optional<SessionRecord> next();
+
+private:
+    std::ifstream f;
+};
@@ -0,0 +1,75 @@
+#include "traffic.hpp"
+#include "communication/messages.hpp"
+#include "general/metrics.hpp"
+
+namespace {
+struct TypeMetrics {
+    metrics::Counter& messages;
+    metrics::Counter& bytes;
+};
+
+TypeMetrics& type_metrics(bool received, size_t slot)
+{
+    using Table = std::array<TypeMetrics*, Traffic::ntypes>;
+    auto make_table { [](const char* direction) {
+        Table res;
+        for (size_t i = 0; i < res.size(); ++i) {
+            const char* type { messages::name(i) };
+            res[i] = new TypeMetrics {
+                metrics::counter("warthog_p2p_messages_total",
+                    "Number of peer messages by direction and type",
+                    { { "direction", direction }, { "type", type } }),
+                metrics::counter("warthog_p2p_bytes_total",
+                    "Size of peer messages including the header by direction and type",
+                    { { "direction", direction }, { "type", type } })
+            };
+        }
+        return res;
+    } };
+    static const Table rx { make_table("rx") };
+    static const Table tx { make_table("tx") };
+    return *(received ? rx : tx)[slot];
+}
+}
+
+void Traffic::on_received(uint8_t type, size_t bytes)
+{
+    const size_t i { slot(type) };
+    slots[i].rxMessages.fetch_add(1, std::memory_order_relaxed);
+    slots[i].rxBytes.fetch_add(bytes, std::memory_order_relaxed);
+    auto& m { type_metrics(true, i) };
+    m.messages.inc();
+    m.bytes.inc(bytes);
+}
+
+void Traffic::on_sent(uint8_t type, size_t bytes)
+{
+    const size_t i { slot(type) };
+    slots[i].txMessages.fetch_add(1, std::memory_order_relaxed);
+    slots[i].txBytes.fetch_add(bytes, std::memory_order_relaxed);
+    auto& m { type_metrics(false, i) };
+    m.messages.inc();
+    m.bytes.inc(bytes);
+}
+
+void Traffic::on_processed(uint8_t type, std::chrono::steady_clock::duration d)
+{
+    using namespace std::chrono;
+    slots[slot(type)].processNs.fetch_add(duration_cast<nanoseconds>(d).count(), std::memory_order_relaxed);
+}
+
+auto Traffic::snapshot() const -> Snapshot
+{
+    Snapshot res;
+    for (size_t i = 0; i < ntypes; ++i) {
+        auto& s { slots[i] };
+        res[i] = {
+            .rxMessages = s.rxMessages.load(std::memory_order_relaxed),
+            .rxBytes = s.rxBytes.load(std::memory_order_relaxed),
+            .txMessages = s.txMessages.load(std::memory_order_relaxed),
+            .txBytes = s.txBytes.load(std::memory_order_relaxed),
+            .processNs = s.processNs.load(std::memory_order_relaxed)
+        };
+    }
+    return res;
+}
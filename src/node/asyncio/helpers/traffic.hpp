@@ -0,0 +1,39 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Message statistics of a connection by message type. Bytes are counted on
+// the connection manager thread, processing time on the eventloop thread,
+// API requests read snapshots. Every update also feeds the process wide
+// warthog_p2p_* metrics.
+class Traffic {
+public:
+    static constexpr size_t ntypes = 32; // larger type bytes share the last slot
+    struct Counts {
+        uint64_t rxMessages { 0 };
+        uint64_t rxBytes { 0 };
+        uint64_t txMessages { 0 };
+        uint64_t txBytes { 0 };
+        uint64_t processNs { 0 }; // parsing and handling of received messages
+    };
+    using Snapshot = std::array<Counts, ntypes>;
+
+    void on_received(uint8_t type, size_t bytes);
+    void on_sent(uint8_t type, size_t bytes);
+    void on_processed(uint8_t type, std::chrono::steady_clock::duration);
+    [[nodiscard]] Snapshot snapshot() const;
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> rxMessages { 0 };
+        std::atomic<uint64_t> rxBytes { 0 };
+        std::atomic<uint64_t> txMessages { 0 };
+        std::atomic<uint64_t> txBytes { 0 };
+        std::atomic<uint64_t> processNs { 0 };
+    };
+    static size_t slot(uint8_t type) { return type < ntypes ? type : ntypes - 1; }
+    std::array<Slot, ntypes> slots;
+};
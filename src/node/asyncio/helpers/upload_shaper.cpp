@@ -0,0 +1,48 @@
+#include "upload_shaper.hpp"
+#include "communication/messages.hpp"
+#include <algorithm>
+
+UploadShaper::UploadShaper(size_t inboundRate, size_t outboundRate)
+    : buckets { Bucket { inboundRate, double(inboundRate), clock::now() },
+        Bucket { outboundRate, double(outboundRate), clock::now() } }
+{
+}
+
+bool UploadShaper::bulk(uint8_t msgtype)
+{
+    switch (msgtype) {
+    case BatchrepMsg::msgcode:
+    case BlockrepMsg::msgcode:
+    case BatchrepDeltaMsg::msgcode:
+    case BlockrepZstdMsg::msgcode:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void UploadShaper::Bucket::refill(clock::time_point now)
+{
+    // bursts of up to one second
+    const double elapsed { std::chrono::duration<double>(now - refilled).count() };
+    tokens = std::min(tokens + elapsed * double(rate), double(rate));
+    refilled = now;
+}
+
+bool UploadShaper::allow_bulk(bool inbound)
+{
+    std::lock_guard l(m);
+    auto& b { bucket(inbound) };
+    if (b.rate == 0)
+        return true;
+    b.refill(clock::now());
+    return b.tokens > 0;
+}
+
+void UploadShaper::consume(bool inbound, size_t bytes)
+{
+    std::lock_guard l(m);
+    auto& b { bucket(inbound) };
+    if (b.rate != 0)
+        b.tokens -= double(bytes);
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+// Token buckets limiting the upload rate of the peer classes (inbound and
+// outbound connections), shared by the connection manager shards. Relay
+// messages are never held back and only consume tokens, bulk replies
+// serving sync wait until the bucket of their class is positive again.
+class UploadShaper {
+public:
+    // rates in bytes per second, 0 disables the limit of the class
+    UploadShaper(size_t inboundRate, size_t outboundRate);
+    static bool bulk(uint8_t msgtype);
+    bool limited() const { return buckets[0].rate != 0 || buckets[1].rate != 0; }
+    bool allow_bulk(bool inbound);
+    void consume(bool inbound, size_t bytes);
+
+private:
+    using clock = std::chrono::steady_clock;
+    struct Bucket {
+        size_t rate;
+        double tokens; // negative after large messages
+        clock::time_point refilled;
+        void refill(clock::time_point now);
+    };
+    Bucket& bucket(bool inbound) { return buckets[inbound ? 0 : 1]; }
+    std::mutex m;
+    std::array<Bucket, 2> buckets;
+};
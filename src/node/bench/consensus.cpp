@@ -0,0 +1,257 @@
+// Microbenchmarks of consensus hot paths. Every benchmark prints one JSON
+// line {"benchmark":..., "iterations":..., "ns_per_op":...} such that
+// results of different builds can be compared by scripts.
+//
+// usage: wart-bench [filter] [min_seconds]
+#include "block/body/container.hpp"
+#include "block/body/primitives.hpp"
+#include "block/body/view.hpp"
+#include "block/chain/worksum.hpp"
+#include "block/header/custom_float.hpp"
+#include "block/header/header_impl.hpp"
+#include "block/header/view_inline.hpp"
+#include "communication/create_payment.hpp"
+#include "communication/buffers/sndbuffer.hpp"
+#include "communication/messages.hpp"
+#include "crypto/crypto.hpp"
+#include "crypto/hasher_sha256.hpp"
+#include "crypto/verushash/verushash.hpp"
+#include "general/reader.hpp"
+#include "general/writer.hpp"
+#include "mempool/mempool.hpp"
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+
+namespace {
+std::string filter;
+double minSeconds { 0.5 };
+volatile uint64_t sink;
+
+void consume(std::span<const uint8_t> s)
+{
+    if (s.size() > 0)
+        sink = sink + s[0];
+}
+void consume(uint64_t v) { sink = sink + v; }
+
+// calls f() repeatedly, f performs opsPerCall operations per call
+template <typename F>
+void bench(const char* name, size_t opsPerCall, F&& f)
+{
+    if (!filter.empty() && std::string(name).find(filter) == std::string::npos)
+        return;
+    using namespace std::chrono;
+    f(); // warm up
+    size_t calls { 1 };
+    while (true) {
+        auto begin { steady_clock::now() };
+        for (size_t i = 0; i < calls; ++i)
+            f();
+        const double s { duration<double>(steady_clock::now() - begin).count() };
+        if (s >= minSeconds) {
+            const size_t ops { calls * opsPerCall };
+            printf("{\"benchmark\":\"%s\",\"iterations\":%zu,\"ns_per_op\":%.3f}\n",
+                name, ops, s * 1e9 / ops);
+            fflush(stdout);
+            return;
+        }
+        calls *= 2;
+    }
+}
+
+std::mt19937_64 rng(42);
+
+Header random_header()
+{
+    Header h;
+    for (auto& c : h)
+        c = rng();
+    // valid target: 30 to 59 leading zeros and 22 significant bits
+    const uint32_t zeros = 30 + rng() % 30;
+    Writer(h.data() + HeaderView::offset_target, 4) << uint32_t((zeros << 22) | 0x00200000u | (rng() & 0x001fffffu));
+    return h;
+}
+
+std::vector<uint8_t> random_body(size_t nTransfers)
+{
+    std::vector<uint8_t> b(4 + 4 + BodyView::AddressSize + 2 + BodyView::RewardSize
+        + 4 + BodyView::TransferSize * nTransfers);
+    for (auto& c : b)
+        c = rng();
+    Writer w(b);
+    w << uint32_t(0) << uint32_t(1);
+    w.skip(BodyView::AddressSize);
+    w << uint16_t(1);
+    w.skip(BodyView::RewardSize);
+    w << uint32_t(nTransfers);
+    return b;
+}
+
+struct Transactions {
+    Transactions(size_t n)
+        : pinHash(hashSHA256(random_header().data(), 80))
+        , from { key.pubkey().address(), Funds(uint64_t(1000000) * n) }
+    {
+        const PinHeight pin { Height(0) };
+        const Address to { PrivKey().pubkey().address() };
+        for (size_t i = 0; i < n; ++i) {
+            PaymentCreateMessage pcm(pin, pinHash, key,
+                CompactUInt::compact(Funds(uint64_t(1000 + rng() % 100000))),
+                to, Funds(uint64_t(100)), NonceId(uint32_t(i)));
+            txs.push_back({ AccountId(1), pcm });
+            hashes.push_back(txs.back().txhash(pinHash));
+        }
+    }
+    void insert_all(mempool::Mempool& mp) const
+    {
+        for (size_t i = 0; i < txs.size(); ++i)
+            mp.insert_tx(txs[i], TransactionHeight(txs[i].pin_height(), AccountHeight(0)), hashes[i], from);
+    }
+    PrivKey key;
+    Hash pinHash;
+    AddressFunds from;
+    std::vector<TransferTxExchangeMessage> txs;
+    std::vector<TxHash> hashes;
+};
+
+void bench_hashing()
+{
+    const Header h { random_header() };
+    bench("verus_hash", 1, [&] { consume(verus_hash(h)); });
+    bench("header_hash", 1, [&] { consume(h.hash()); });
+
+    const NonzeroHeight height { 2000000u };
+    const Hash hash { h.hash() };
+    bench("header_valid_pow", 1, [&] { consume(h.validPOW(hash, height)); });
+}
+
+void bench_custom_float()
+{
+    std::vector<CustomFloat> v;
+    for (size_t i = 0; i < 256; ++i)
+        v.push_back(CustomFloat::from_double(double(rng() % 1000000 + 1) / 1000.0));
+    bench("custom_float_mul", v.size(), [&] {
+        auto a { CustomFloat::from_double(1.0) };
+        for (auto& x : v)
+            a = a * x;
+        consume(a.to_double() > 1);
+    });
+    bench("custom_float_add", v.size(), [&] {
+        auto a { CustomFloat::from_double(0.0) };
+        for (auto& x : v)
+            a = a + x;
+        consume(a.to_double() > 1);
+    });
+    bench("custom_float_log2", v.size(), [&] {
+        for (auto& x : v)
+            consume(log2(x).to_double() > 1);
+    });
+    bench("custom_float_pow2", v.size(), [&] {
+        for (auto& x : v)
+            consume(pow2(x).to_double() > 1);
+    });
+}
+
+void bench_worksum()
+{
+    std::vector<Header> headers;
+    for (size_t i = 0; i < 256; ++i)
+        headers.push_back(random_header());
+    const NonzeroHeight height { 2000000u };
+    bench("worksum_from_target", headers.size(), [&] {
+        Worksum w;
+        for (auto& h : headers)
+            w += Worksum(h.target(height));
+        consume(w.getFragments()[0]);
+    });
+    std::vector<Worksum> ws;
+    for (auto& h : headers)
+        ws.push_back(Worksum(h.target(height)));
+    bench("worksum_add", ws.size(), [&] {
+        Worksum w;
+        for (auto& x : ws)
+            w += x;
+        consume(w.getFragments()[0]);
+    });
+    bench("worksum_mul", ws.size(), [&] {
+        Worksum w { ws[0] };
+        for (size_t i = 0; i < ws.size(); ++i)
+            w *= 3;
+        consume(w.getFragments()[0]);
+    });
+    bench("worksum_compare", ws.size(), [&] {
+        uint64_t n { 0 };
+        for (size_t i = 1; i < ws.size(); ++i)
+            n += ws[i - 1] < ws[i];
+        consume(n);
+    });
+}
+
+void bench_body()
+{
+    // full block
+    const size_t nTransfers { (MAXBLOCKSIZE - 64) / BodyView::TransferSize };
+    const auto body { random_body(nTransfers) };
+    assert(BodyView(body).valid());
+    bench("body_view_parse", 1, [&] { consume(BodyView(body).valid()); });
+    const BodyView bv(body);
+    bench("body_merkle_root", 1, [&] { consume(bv.merkleRoot(Height(2000000))); });
+}
+
+void bench_mempool()
+{
+    const Transactions t(1000);
+    bench("mempool_insert_tx", t.txs.size(), [&] {
+        mempool::Mempool mp(false);
+        t.insert_all(mp);
+    });
+    mempool::Mempool mp(false);
+    t.insert_all(mp);
+    bench("mempool_get_payments_100", 1, [&] {
+        consume(mp.get_payments(100, false).size());
+    });
+}
+
+template <typename T>
+T roundtrip(const T& msg)
+{
+    Sndbuffer sb = msg;
+    Reader r({ reinterpret_cast<const uint8_t*>(sb.ptr.get()) + 10, sb.len - 10 });
+    return T::from_reader(r);
+}
+
+void bench_messages()
+{
+    const PingMsg ping(SignedSnapshot::Priority {});
+    bench("message_ping_roundtrip", 1, [&] { consume(roundtrip(ping).maxAddresses); });
+
+    std::vector<BodyContainer> bodies;
+    for (size_t i = 0; i < 10; ++i)
+        bodies.push_back(random_body(100));
+    const BlockrepMsg rep(0, std::move(bodies));
+    bench("message_blockrep_roundtrip", 1, [&] {
+        Sndbuffer sb = rep;
+        Reader r({ reinterpret_cast<const uint8_t*>(sb.ptr.get()) + 10, sb.len - 10 });
+        consume(BlockrepView::from_reader(r).blocks.size());
+    });
+}
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 1)
+        filter = argv[1];
+    if (argc > 2)
+        minSeconds = std::stod(argv[2]);
+    ECC_Start();
+    bench_hashing();
+    bench_custom_float();
+    bench_worksum();
+    bench_body();
+    bench_mempool();
+    bench_messages();
+    ECC_Stop();
+}
@@ -0,0 +1,120 @@
+#include "compact.hpp"
+#include "block/body/view.hpp"
+#include "general/errors.hpp"
+#include "general/reader.hpp"
+#include "general/writer.hpp"
+#include "mempool/mempool.hpp"
+#include <cstring>
+
+namespace {
+// size of the body up to and including the transfer count
+size_t prefix_size(std::span<const uint8_t> s, uint32_t& nTransfers)
+{
+    Reader r { s };
+    r.skip(4); // for mining
+    r.skip(BodyView::AddressSize * size_t(r.uint32()));
+    r.skip(BodyView::RewardSize * size_t(r.uint16()));
+    nTransfers = r.uint32();
+    return r.cursor() - s.data();
+}
+}
+
+CompactBody::CompactBody(const BodyView& bv, std::span<const uint32_t> prefill)
+{
+    assert(bv.valid());
+    std::span<const uint8_t> s { bv.data(), bv.size() };
+    uint32_t nTransfers;
+    const size_t prefix { prefix_size(s, nTransfers) };
+    const uint8_t* transfers { s.data() + prefix };
+
+    // only strictly increasing indices of existing transfers are served
+    std::vector<uint32_t> indices;
+    for (auto i : prefill) {
+        if (i >= nTransfers || (indices.size() > 0 && i <= indices.back()))
+            continue;
+        indices.push_back(i);
+    }
+
+    bytes.resize(prefix + TransferSize * nTransfers + 4 + PrefilledSize * indices.size());
+    Writer w(bytes);
+    w << Range(s.data(), prefix);
+    for (size_t i = 0; i < nTransfers; ++i) {
+        auto t { transfers + i * BodyView::TransferSize };
+        w << Range(t, 16) // fromId, pinNonce
+          << Range(t + 18, 8); // toId
+    }
+    w << uint32_t(indices.size());
+    for (auto i : indices) {
+        auto t { transfers + i * BodyView::TransferSize };
+        w << i
+          << Range(t + 16, 2) // compactFee
+          << Range(t + 26, 8 + 65); // amount, signature
+    }
+    assert(w.remaining() == 0);
+}
+
+CompactBody::CompactBody(Reader& r)
+{
+    auto s { r.span() };
+    if (s.size() > MaxSize)
+        throw Error(EMALFORMED);
+    bytes.assign(s.begin(), s.end());
+}
+
+Writer& operator<<(Writer& w, const CompactBody& b)
+{
+    return w << (uint32_t)b.bytes.size() << Range(b.bytes);
+}
+
+auto CompactBody::reconstruct(NonzeroHeight height, const mempool::Mempool& mempool) const -> Reconstructed
+{
+    uint32_t nTransfers;
+    const size_t prefix { prefix_size(bytes, nTransfers) };
+    if (nTransfers > MaxTransfers)
+        throw Error(EMALFORMED);
+    Reader r { std::span(bytes).subspan(prefix) };
+    const auto compact { r.take_span(TransferSize * nTransfers) };
+    const uint32_t nPrefilled { r.uint32() };
+    if (r.remaining() != size_t(nPrefilled) * PrefilledSize)
+        throw Error(EMALFORMED);
+
+    std::vector<uint8_t> out(prefix + BodyView::TransferSize * nTransfers);
+    if (out.size() > MAXBLOCKSIZE)
+        throw Error(EMALFORMED);
+    memcpy(out.data(), bytes.data(), prefix);
+
+    Reconstructed res;
+    const PinFloor pinFloor { PrevHeight(height) };
+    uint32_t p { 0 }; // consumed prefilled transfers
+    for (uint32_t i = 0; i < nTransfers; ++i) {
+        const uint8_t* c { compact.data() + i * TransferSize };
+        Writer w(out.data() + prefix + i * BodyView::TransferSize, BodyView::TransferSize);
+        w << Range(c, 16); // fromId, pinNonce
+        if (p < nPrefilled && readuint32(r.cursor()) == i) {
+            r.skip(4);
+            auto filled { r.take_span(PrefilledSize - 4) };
+            w << Range(filled.data(), 2) // compactFee
+              << Range(c + 16, 8) // toId
+              << Range(filled.data() + 2, 8 + 65); // amount, signature
+            p += 1;
+            continue;
+        }
+        Reader cr({ c, TransferSize });
+        AccountId fromId { cr.uint64() };
+        PinNonce pinNonce { cr };
+        auto tx { mempool[TransactionId(fromId, pinNonce.pin_height(pinFloor), pinNonce.id)] };
+        if (!tx) {
+            res.missing.push_back(i);
+            continue;
+        }
+        w << tx->compactFee
+          << Range(c + 16, 8) // toId
+          << tx->amount
+          << tx->signature;
+    }
+    if (p != nPrefilled) // prefilled indices not increasing or out of range
+        throw Error(EMALFORMED);
+    if (res.missing.empty())
+        res.body.emplace(std::move(out));
+    return res;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "block/body/container.hpp"
+#include "block/chain/height.hpp"
+#include "general/params.hpp"
+#include <optional>
+#include <span>
+#include <vector>
+
+class Reader;
+class Writer;
+class BodyView;
+namespace mempool {
+class Mempool;
+}
+
+// Block body for relay to peers that already know most transfers from
+// their mempool. Address and reward sections are sent verbatim, a transfer
+// is reduced to fromId, pinNonce and toId (which identify its
+// TransactionId), compactFee, amount and signature are looked up in the
+// receiver's mempool. Transfers the receiver reported missing are attached
+// in full ("prefilled").
+class CompactBody {
+public:
+    static constexpr size_t TransferSize = 8 + 8 + 8;
+    static constexpr size_t PrefilledSize = 4 + 2 + 8 + 65;
+    static constexpr size_t MaxTransfers = MAXBLOCKSIZE / (34 + 65);
+    static constexpr size_t MaxSize = MAXBLOCKSIZE + 4 + 4 * MaxTransfers;
+
+    CompactBody(const BodyView&, std::span<const uint32_t> prefill = {});
+    CompactBody(Reader& r);
+    friend Writer& operator<<(Writer&, const CompactBody&);
+    size_t serialized_size() const { return bytes.size() + 4; }
+
+    struct Reconstructed {
+        std::optional<BodyContainer> body;
+        std::vector<uint32_t> missing; // indices of transfers not in mempool
+    };
+    // throws Error(EMALFORMED) on malformed input
+    [[nodiscard]] Reconstructed reconstruct(NonzeroHeight, const mempool::Mempool&) const;
+
+private:
+    std::vector<uint8_t> bytes;
+};
@@ -1,6 +1,7 @@
 #include "generator.hpp"
 #include "spdlog/spdlog.h"
 #include "db/chain_db.hpp"
+#include <set>
 
 struct TransferTxExchangeMessage;
 
@@ -32,12 +33,22 @@ class BlockGenerator {
         {
         }
 
+        // looks up the addresses with few queries before getId() is called
+        void prefetch(std::vector<AddressView> addresses)
+        {
+            for (auto& [address, v] : db.lookup_addresses(addresses))
+                cache.emplace(address, std::get<0>(v));
+            for (auto a : addresses)
+                prefetched.emplace(a);
+        }
         AccountId getId(const AddressView address)
         {
             if (auto iter = cache.find(address); iter != cache.end()) {
                 return iter->second;
             }
-            auto p = db.lookup_address(address);
+            std::optional<std::tuple<AccountId, Funds>> p;
+            if (!prefetched.contains(address))
+                p = db.lookup_address(address);
             if (p) { // not present in database
                 auto [id, _] = *p;
                 cache.emplace(address, id);
@@ -49,7 +60,11 @@ class BlockGenerator {
                 return id;
             }
         }
-        void clear() { newEntries.clear(); }
+        void clear()
+        {
+            newEntries.clear();
+            prefetched.clear();
+        }
         size_t binarysize() { return 4 + 20 * newEntries.size(); }
         uint8_t* write(uint8_t* out);
 
@@ -58,6 +73,7 @@ class BlockGenerator {
         AccountId nextStateId;
         std::vector<AddressView> newEntries;
         std::map<Address, AccountId, Address::Comparator> cache;
+        std::set<Address, Address::Comparator> prefetched; // by prefetch(), not in cache means new
     };
 
     class PaymentSection {
@@ -125,6 +141,13 @@ BodyContainer BlockGenerator::gen_block(NonzeroHeight height,
     )
 {
     nas.clear();
+    std::vector<AddressView> addresses;
+    addresses.reserve(payouts.size() + payments.size());
+    for (auto& p : payouts)
+        addresses.push_back(p.to);
+    for (auto& pmsg : payments)
+        addresses.push_back(pmsg.toAddr);
+    nas.prefetch(std::move(addresses));
 
     // Payouts
     if (payouts.size() > std::numeric_limits<uint16_t>::max()) {
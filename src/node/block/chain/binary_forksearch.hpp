@@ -25,3 +25,40 @@ template <typename T1, typename T2>
     size_t res = binary_forksearch(v1, v2, lower, len);
     return {res,res != len};
 }
+
+// Same result as binary_forksearch but probes backwards from upper in
+// doubling steps first. Forks between peers are usually close to the tips,
+// then only O(log(upper - fork)) positions are compared.
+// equal(pos) must return whether position pos matches.
+template <typename Equal>
+[[nodiscard]] inline size_t gallop_forksearch(Equal&& equal, size_t lower, size_t upper)
+{
+    size_t step = 1;
+    while (upper > lower) {
+        size_t pos = (upper - lower > step ? upper - step : lower);
+        if (equal(pos)) {
+            lower = pos + 1;
+            break;
+        }
+        upper = pos;
+        step *= 2;
+    }
+    while (upper > lower) {
+        size_t pos = lower + (upper - lower) / 2;
+        if (equal(pos))
+            lower = pos + 1;
+        else
+            upper = pos;
+    }
+    return upper;
+}
+
+template <typename T1, typename T2>
+[[nodiscard]] inline std::pair<size_t, bool> gallop_forksearch(const T1& v1, const T2& v2, size_t lower = 0)
+{
+    const size_t s1 = v1.size();
+    const size_t s2 = v2.size();
+    const size_t len = (s1 > s2 ? s2 : s1);
+    size_t res = gallop_forksearch([&](size_t pos) { return v1[pos] == v2[pos]; }, lower, len);
+    return { res, res != len };
+}
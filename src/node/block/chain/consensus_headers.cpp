@@ -1,6 +1,10 @@
 #include "consensus_headers.hpp"
+#include "block/chain/pow_cache.hpp"
+#include "crypto/verushash/verushash.hpp"
 #include "general/now.hpp"
+#include "general/task_pool.hpp"
 #include "spdlog/spdlog.h"
+#include <cstring>
 
 HeaderVerifier::HeaderVerifier(const SharedBatch& b)
     : nextTarget(TargetV1())
@@ -15,8 +19,7 @@ HeaderVerifier::HeaderVerifier(const SharedBatch& b)
     while (tmp->lower_height() > latestRetargetHeight) {
         tmp = &tmp->prev();
     }
-    HeaderView uhv = tmp->getBatch()[latestRetargetHeight - tmp->lower_height()];
-    latestRetargetTime = uhv.timestamp();
+    latestRetargetTime = tmp->work_series().timestamp_at(latestRetargetHeight.nonzero_assert());
 
     timeValidator.clear();
     bool override = false;
@@ -34,14 +37,14 @@ HeaderVerifier::HeaderVerifier(const SharedBatch& b)
         if (latestRetargetHeight == 1) {
             nextTarget = TargetV1::genesis();
         } else {
-            nextTarget = finalHeader.target(length.nonzero_assert());
+            nextTarget = b.work_series().target_at(length.nonzero_assert());
             if (length.retarget_floor() == length) { // need retarget
                 auto prevRetargetHeight = (length - 1).retarget_floor();
                 while (tmp->lower_height() > prevRetargetHeight) {
                     tmp = &tmp->prev();
                 }
-                HeaderView lhv = tmp->getBatch()[prevRetargetHeight - tmp->lower_height()];
-                nextTarget.scale(finalHeader.timestamp() - lhv.timestamp(),
+                const auto ltime { tmp->work_series().timestamp_at(prevRetargetHeight.nonzero_assert()) };
+                nextTarget.scale(finalHeader.timestamp() - ltime,
                     BLOCKTIME * (length - prevRetargetHeight), length + 1);
             }
         }
@@ -53,12 +56,81 @@ HeaderVerifier::HeaderVerifier(const SharedBatch& b)
     }
 }
 
-tl::expected<HeaderVerifier, ChainError> HeaderVerifier::copy_apply(const std::optional<SignedSnapshot>& sp, const Batch& b, Height heightOffset) const
+tl::expected<HeaderVerifier, ChainError> HeaderVerifier::copy_apply(const std::optional<SignedSnapshot>& sp, const Batch& b, Height heightOffset, TaskPool* pool, PowCache* powCache) const
 {
     HeaderVerifier res { *this };
     assert(heightOffset == length);
+
+    // PoW validity only depends on the header itself
+    std::vector<Hash> hashes;
+    std::vector<uint8_t> validPOW; // no std::vector<bool>, written concurrently
+    if (pool) {
+        hashes.resize(b.size());
+        validPOW.resize(b.size());
+        std::vector<uint8_t> cached(b.size()); // validPOW[i] known
+        if (powCache) {
+            for (size_t i = 0; i < b.size(); ++i) {
+                hashes[i] = HeaderView(b[i]).hash();
+                if (auto v { powCache->lookup(hashes[i], (heightOffset + 1 + i).nonzero_assert()) }) {
+                    validPOW[i] = *v;
+                    cached[i] = true;
+                }
+            }
+        }
+        // chunks of headers such that verushash can interleave lanes
+        constexpr size_t chunk { 16 };
+        pool->parallel_for((b.size() + chunk - 1) / chunk, [&](size_t c) {
+            const size_t begin { c * chunk };
+            const size_t end { std::min(begin + chunk, b.size()) };
+            std::vector<std::span<const uint8_t>> verusInputs;
+            for (size_t i = begin; i < end; ++i) {
+                if (cached[i])
+                    continue;
+                HeaderView hv { b[i] };
+                if (!powCache)
+                    hashes[i] = hv.hash();
+                if (HeaderView::uses_verushash((heightOffset + 1 + i).nonzero_assert()))
+                    verusInputs.push_back({ hv.data(), hv.size() });
+            }
+            Hash verusHashes[chunk];
+            verus_hash_batch(verusInputs, verusHashes);
+            // consecutive uncached headers with equal target and rules are
+            // checked together, the target version is fixed within such a run
+            size_t v { 0 };
+            for (size_t i = begin; i < end;) {
+                if (cached[i]) {
+                    i += 1;
+                    continue;
+                }
+                HeaderView hv { b[i] };
+                auto height { (heightOffset + 1 + i).nonzero_assert() };
+                size_t j { i + 1 };
+                for (; j < end && !cached[j]; ++j) {
+                    auto h { (heightOffset + 1 + j).nonzero_assert() };
+                    if (!HeaderView::same_pow_rules(height, h) || memcmp(b[j].data() + HeaderView::offset_target, hv.data() + HeaderView::offset_target, 4) != 0)
+                        break;
+                }
+                const uint8_t* rawTarget { hv.data() + HeaderView::offset_target };
+                if (!HeaderView::uses_verushash(height)) {
+                    HeaderView::validPOW_batch(&hashes[i], j - i, TargetV1::from_raw(rawTarget), &validPOW[i]);
+                    i = j;
+                    continue;
+                }
+                HeaderView::validPOW_batch(&hashes[i], &verusHashes[v], j - i, height, TargetV2::from_raw(rawTarget), &validPOW[i]);
+                v += j - i;
+                i = j;
+            }
+        });
+        if (powCache) {
+            for (size_t i = 0; i < b.size(); ++i)
+                if (!cached[i])
+                    powCache->insert(hashes[i], (heightOffset + 1 + i).nonzero_assert(), validPOW[i]);
+        }
+    }
+
     for (size_t i = 0; i < b.size(); ++i) {
-        auto e { res.prepare_append(sp, b[i]) };
+        auto e { pool ? res.prepare_append(sp, b[i], hashes[i], validPOW[i])
+                      : res.prepare_append(sp, b[i]) };
         auto height { (heightOffset + 1 + i).nonzero_assert() };
         if (!e.has_value()) {
             return tl::make_unexpected(ChainError(e.error(), height));
@@ -133,7 +205,11 @@ void HeaderVerifier::append(NonzeroHeight newlength, const PreparedAppend& p)
 
 auto HeaderVerifier::prepare_append(const std::optional<SignedSnapshot>& sp, HeaderView hv) const -> tl::expected<PreparedAppend, int32_t>
 {
-    auto hash { hv.hash() };
+    return prepare_append(sp, hv, hv.hash(), {});
+}
+
+auto HeaderVerifier::prepare_append(const std::optional<SignedSnapshot>& sp, HeaderView hv, const Hash& hash, std::optional<bool> validPOW) const -> tl::expected<PreparedAppend, int32_t>
+{
     NonzeroHeight appendHeight { height() + 1 };
 
     // Check header link
@@ -150,8 +226,8 @@ auto HeaderVerifier::prepare_append(const std::optional<SignedSnapshot>& sp, Hea
     if (hv.target(appendHeight) != nextTarget)
         return tl::make_unexpected(EDIFFICULTY);
 
-    // Check POW
-    if (!hv.validPOW(hash, appendHeight)) {
+    // Check POW (unless already checked)
+    if (!(validPOW ? *validPOW : hv.validPOW(hash, appendHeight))) {
         return tl::make_unexpected(EPOW);
     }
 
@@ -185,20 +261,21 @@ void HeaderVerifier::initialize(const ExtendableHeaderchain& hc,
     //////////////////////////////
     timeValidator.clear();
     // now fill timestamp vaildator
-    if (hc.incompleteBatch.size() >= timeValidator.N) {
-        for (size_t i = hc.incompleteBatch.size() - timeValidator.N;
-             i < hc.incompleteBatch.size(); ++i) {
-            timeValidator.append(hc.incompleteBatch[i].timestamp());
+    auto& incomplete { *hc.incompleteBatch };
+    if (incomplete.size() >= timeValidator.N) {
+        for (size_t i = incomplete.size() - timeValidator.N;
+             i < incomplete.size(); ++i) {
+            timeValidator.append(incomplete[i].timestamp());
         }
     } else {
-        if (hc.completeBatches.size() > 0) {
-            const SharedBatchView& sb = hc.completeBatches.back();
-            size_t rem = timeValidator.N - hc.incompleteBatch.size();
+        if (hc.completeBatches->size() > 0) {
+            const SharedBatchView& sb = hc.completeBatches->back();
+            size_t rem = timeValidator.N - incomplete.size();
             for (size_t i = sb.size() - rem; i < sb.size(); ++i)
                 timeValidator.append(sb.getBatch()[i].timestamp());
         }
-        for (size_t i = 0; i < hc.incompleteBatch.size(); ++i)
-            timeValidator.append(hc.incompleteBatch[i].timestamp());
+        for (size_t i = 0; i < incomplete.size(); ++i)
+            timeValidator.append(incomplete[i].timestamp());
     }
 
     //////////////////////////////
@@ -250,16 +327,17 @@ void ExtendableHeaderchain::shrink(Height newlength)
 {
     assert(newlength <= length());
     size_t numComplete = newlength.complete_batches();
-    if (numComplete == completeBatches.size()) {
+    if (numComplete == completeBatches->size()) {
         // only need to shrink incompleteBatch
-        incompleteBatch.shrink(newlength.incomplete_batch_size());
+        incompleteBatch.mut().shrink(newlength.incomplete_batch_size());
     } else {
-        incompleteBatch = completeBatches[numComplete].getBatch();
-        incompleteBatch.shrink(newlength.incomplete_batch_size());
-        completeBatches.erase(completeBatches.begin() + numComplete,
-            completeBatches.end());
-        if (completeBatches.size() > 0)
-            finalPin = completeBatches.back();
+        auto& cb { completeBatches.mut() };
+        Batch b { cb[numComplete].getBatch() };
+        b.shrink(newlength.incomplete_batch_size());
+        incompleteBatch = std::move(b);
+        cb.erase(cb.begin() + numComplete, cb.end());
+        if (cb.size() > 0)
+            finalPin = cb.back();
         else
             finalPin = SharedBatch();
     }
@@ -273,22 +351,30 @@ ExtendableHeaderchain::ExtendableHeaderchain()
 
 ExtendableHeaderchain::ExtendableHeaderchain(
     std::vector<Batch>&& init,
+    std::span<const Worksum> batchWork,
     BatchRegistry& br)
 {
     // p.first
     Height incompleteHeightOffset { 0 };
     Worksum totalWork;
+    std::vector<SharedBatchView> cb;
+    Batch incomplete;
     for (size_t i = 0; i < init.size(); ++i) {
-        incompleteBatch = std::move(init[i]);
-        if (incompleteBatch.complete()) {
-            finalPin = br.share(std::move(incompleteBatch), finalPin);
-            completeBatches.push_back(finalPin);
-            incompleteBatch.clear();
+        incomplete = std::move(init[i]);
+        if (incomplete.complete()) {
+            if (i < batchWork.size())
+                finalPin = br.share(std::move(incomplete), finalPin, batchWork[i]);
+            else
+                finalPin = br.share(std::move(incomplete), finalPin);
+            cb.push_back(finalPin);
+            incomplete.clear();
             incompleteHeightOffset = finalPin.upper_height();
             totalWork = finalPin.total_work();
         }
     }
-    totalWork += incompleteBatch.worksum(incompleteHeightOffset);
+    totalWork += incomplete.worksum(incompleteHeightOffset);
+    completeBatches = std::move(cb);
+    incompleteBatch = std::move(incomplete);
     initialize();
     assert(totalWork == total_work());
 }
@@ -316,11 +402,12 @@ void ExtendableHeaderchain::append(const HeaderVerifier::PreparedAppend& p,
     BatchRegistry& br)
 {
     worksum += checker.next_target();
-    incompleteBatch.append(p.hv);
-    if (incompleteBatch.complete()) {
-        finalPin = br.share(std::move(incompleteBatch), finalPin, worksum);
-        completeBatches.push_back(finalPin);
-        incompleteBatch.clear();
+    auto& incomplete { incompleteBatch.mut() };
+    incomplete.append(p.hv);
+    if (incomplete.complete()) {
+        finalPin = br.share(std::move(incomplete), finalPin, worksum);
+        completeBatches.mut().push_back(finalPin);
+        incompleteBatch.reset();
     }
     checker.append(length().nonzero_assert(), p);
 }
@@ -11,6 +11,8 @@ struct MiningData {
 };
 
 class ExtendableHeaderchain;
+class TaskPool;
+class PowCache;
 
 class HeaderVerifier {
 
@@ -21,7 +23,9 @@ public:
     };
     HeaderVerifier();
     HeaderVerifier(const HeaderVerifier&, const Batch&, Height heightOffset);
-    tl::expected<HeaderVerifier, ChainError> copy_apply(const std::optional<SignedSnapshot>& sp, const Batch& b, Height heightOffset) const;
+    // PoW of the batch headers is validated in parallel when a pool is
+    // passed, results of headers found in the cache are reused
+    tl::expected<HeaderVerifier, ChainError> copy_apply(const std::optional<SignedSnapshot>& sp, const Batch& b, Height heightOffset, TaskPool* pool = nullptr, PowCache* powCache = nullptr) const;
     HeaderVerifier(const SharedBatch&);
     // void clear();
     [[nodiscard]] auto prepare_append(const std::optional<SignedSnapshot>& sp, HeaderView hv) const -> tl::expected<PreparedAppend, int32_t>;
@@ -35,6 +39,9 @@ public:
     auto next_target() const { return nextTarget; }
     auto get_valid_timestamp() const { return std::max(timeValidator.get_valid_timestamp(),latestRetargetTime+1); }
 
+private:
+    [[nodiscard]] auto prepare_append(const std::optional<SignedSnapshot>& sp, HeaderView hv, const Hash& hash, std::optional<bool> validPOW) const -> tl::expected<PreparedAppend, int32_t>;
+
 private:
     Height length { 0 };
     //
@@ -55,7 +62,8 @@ class ExtendableHeaderchain : public Headerchain {
 public:
     // Constructors
     ExtendableHeaderchain();
-    ExtendableHeaderchain(std::vector<Batch>&&, BatchRegistry& br);
+    // batchWork optionally holds the known cumulative worksum of complete batches
+    ExtendableHeaderchain(std::vector<Batch>&&, std::span<const Worksum> batchWork, BatchRegistry& br);
     ExtendableHeaderchain(const Headerchain&, Height height);
     ExtendableHeaderchain(Headerchain&&);
     ExtendableHeaderchain(const ExtendableHeaderchain&) = default;
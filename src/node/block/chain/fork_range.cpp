@@ -6,7 +6,7 @@
 ForkRange::ForkRange(const Headerchain& hc, const Grid& g, Batchslot begin)
 {
     // OK
-    auto [i, forked] = binary_forksearch(hc.grid_view(), g, begin.index());
+    auto [i, forked] = gallop_forksearch(hc.grid_view(), g, begin.index());
     Batchslot s(i);
     if (forked) {
         *this = { s.lower(), s.upper() };
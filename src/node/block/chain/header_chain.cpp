@@ -10,7 +10,7 @@ using namespace std;
 std::optional<HeaderView> HeaderchainSkeleton::inefficient_get_header(NonzeroHeight h) const
 {
     const SharedBatch* p = &finalPin;
-    const Batch* b = &incompleteBatch;
+    const Batch* b = &*incompleteBatch;
     Height bStart { p->upper_height() + 1 };
     while (h <= p->upper_height()) {
         // assert(p->slot().has_value());
@@ -26,10 +26,10 @@ HeaderchainAppend Headerchain::get_append(Height prevLength) const
 {
     return {
         .completeBatches {
-            completeBatches.begin() + prevLength.value() / HEADERBATCHSIZE,
-            completeBatches.end() },
+            completeBatches->begin() + prevLength.value() / HEADERBATCHSIZE,
+            completeBatches->end() },
         .finalPin { finalPin },
-        .incompleteBatch { incompleteBatch }
+        .incompleteBatch { *incompleteBatch }
     };
 }
 
@@ -38,13 +38,16 @@ std::pair<Height, AppendMsg> Headerchain::apply_append(HeaderchainAppend&& updat
     Worksum prevWorksum = worksum;
     Height h(length());
     assert(update.completeBatches.size() > 0 || update.incompleteBatch.size() > 0);
-    const Batchslot batchOffset { uint32_t(completeBatches.size()) };
-    completeBatches.insert(completeBatches.end(),
-        update.completeBatches.begin(),
-        update.completeBatches.end());
+    const Batchslot batchOffset { uint32_t(completeBatches->size()) };
+    if (update.completeBatches.size() > 0) {
+        auto& cb { completeBatches.mut() };
+        cb.insert(cb.end(),
+            update.completeBatches.begin(),
+            update.completeBatches.end());
+    }
     incompleteBatch = std::move(update.incompleteBatch);
     finalPin = std::move(update.finalPin);
-    initialize_worksum();
+    initialize_worksum(h);
     assert(worksum > prevWorksum);
     return { h, { length().nonzero_assert(), worksum, grid(batchOffset) } };
 }
@@ -55,10 +58,10 @@ HeaderchainFork Headerchain::get_fork(NonzeroHeight forkHeight, Descriptor descr
     auto shrinkLength { forkHeight - 1 };
     return HeaderchainFork {
         .completeBatches {
-            completeBatches.begin() + shrinkLength.complete_batches(),
-            completeBatches.end() },
+            completeBatches->begin() + shrinkLength.complete_batches(),
+            completeBatches->end() },
         .finalPin { finalPin },
-        .incompleteBatch = incompleteBatch,
+        .incompleteBatch = *incompleteBatch,
         .shrinkLength = shrinkLength,
         .descriptor = descriptor
     };
@@ -70,16 +73,17 @@ ForkMsg Headerchain::apply_fork(HeaderchainFork&& update)
     assert(update.completeBatches.size() > 0 || update.incompleteBatch.size() > 0);
 
     size_t nComplete = update.shrinkLength.complete_batches();
-    completeBatches.erase(completeBatches.begin() + nComplete, completeBatches.end());
-
-    assert(completeBatches.size() == nComplete);
-    const Batchslot batchOffset { uint32_t(completeBatches.size()) };
-    completeBatches.insert(completeBatches.end(),
-        update.completeBatches.begin(),
-        update.completeBatches.end());
-    incompleteBatch.swap(update.incompleteBatch);
+    if (nComplete != completeBatches->size() || update.completeBatches.size() > 0) {
+        auto& cb { completeBatches.mut() };
+        cb.erase(cb.begin() + nComplete, cb.end());
+        cb.insert(cb.end(),
+            update.completeBatches.begin(),
+            update.completeBatches.end());
+    }
+    const Batchslot batchOffset { uint32_t(nComplete) };
+    incompleteBatch = std::move(update.incompleteBatch);
     finalPin = std::move(update.finalPin);
-    initialize_worksum();
+    initialize_worksum(update.shrinkLength);
     assert(worksum > prevWorksum);
     return ForkMsg(
         update.descriptor,
@@ -96,115 +100,100 @@ void Headerchain::shrink(Height shrinkLength)
 
     size_t nIncomplete = shrinkLength.incomplete_batch_size();
     size_t nComplete = shrinkLength.complete_batches();
-    if (nComplete == completeBatches.size()) {
-        incompleteBatch.shrink(nIncomplete);
+    if (nComplete == completeBatches->size()) {
+        incompleteBatch.mut().shrink(nIncomplete);
     } else {
-        assert(nComplete < completeBatches.size());
-        incompleteBatch = completeBatches[nComplete].getBatch();
-        incompleteBatch.shrink(nIncomplete);
-        completeBatches.erase(completeBatches.begin() + nComplete, completeBatches.end());
+        assert(nComplete < completeBatches->size());
+        auto& cb { completeBatches.mut() };
+        Batch b { cb[nComplete].getBatch() };
+        b.shrink(nIncomplete);
+        incompleteBatch = std::move(b);
+        cb.erase(cb.begin() + nComplete, cb.end());
         if (nComplete > 0) {
-            finalPin = completeBatches.back();
+            finalPin = cb.back();
         } else {
             finalPin = SharedBatch {};
         }
     }
-    initialize_worksum();
+    initialize_worksum(shrinkLength);
     assert(worksum < prevWorksum);
 }
 
+const WorkSeries& Headerchain::work_series(NonzeroHeight h) const
+{
+    Batchslot s(h);
+    auto& cb { *completeBatches };
+    return s.index() == cb.size() ? *incompleteSeries : cb[s.index()].work_series();
+}
+
+double Headerchain::hashrate(NonzeroHeight lower, NonzeroHeight upper) const
+{
+    auto& l { work_series(lower) };
+    auto& u { work_series(upper) };
+    const auto ltime { l.timestamp_at(lower) };
+    const auto utime { u.timestamp_at(upper) };
+    if (ltime >= utime)
+        return double(std::numeric_limits<uint64_t>::max());
+    assert(upper > lower);
+    return (u.work_at(upper) - l.work_at(lower)) / (utime - ltime);
+}
+
 uint64_t Headerchain::hashrate(uint32_t nblocks) const
 {
     if (length() < Height(2))
         return 0;
     NonzeroHeight lower { length().value() > nblocks ? (length() - nblocks).nonzero_assert() : NonzeroHeight { 1u } };
     NonzeroHeight upper { length().nonzero_assert() };
-    auto ltime { operator[](lower).timestamp() };
-    auto utime { operator[](upper).timestamp() };
-    if (ltime >= utime)
-        return std::numeric_limits<uint64_t>::max();
-    auto seconds { utime - ltime };
-    auto nBlocks { upper - lower };
-    assert(nBlocks > 0);
-    return sum_work(lower + 1, upper + 1).getdouble() / seconds;
+    return hashrate(lower, upper);
 }
 
-API::HashrateChart Headerchain::hashrate_chart(NonzeroHeight reqmin, NonzeroHeight reqmax, const uint32_t nblocks) const
+API::HashrateChart Headerchain::hashrate_chart(NonzeroHeight reqmin, NonzeroHeight reqmax, const uint32_t nblocks, uint32_t step) const
 {
     const auto max { std::min(Height(reqmax), length()) };
     const auto min { std::max(reqmin, NonzeroHeight(2u)) };
     if (max < min)
         return { .range { .begin { min }, .end { max } }, .chart {} };
+    step = std::max(step, 1u);
 
     std::vector<double> chart;
-
-    NonzeroHeight lower { min.value() > nblocks ? (min - nblocks).nonzero_assert() : NonzeroHeight { 1u } };
-    NonzeroHeight upper { min };
-    auto worksum { sum_work(lower + 1, upper + 1) };
-    auto ltime { operator[](lower).timestamp() };
-    auto utime { operator[](upper).timestamp() };
-    auto compute_hashrate = [&ltime, &utime, &lower, &upper, &worksum]() {
-        if (ltime >= utime)
-            return double(std::numeric_limits<uint64_t>::max());
-        auto seconds { utime - ltime };
-        auto nBlocks { upper - lower };
-        assert(nBlocks > 0);
-        return worksum.getdouble() / seconds;
-    };
-    chart.push_back(compute_hashrate());
-    for (auto h { min + 1}; h <= max; ++h) {
-        NonzeroHeight l { h.value() > nblocks ? (h - nblocks).nonzero_assert() : NonzeroHeight { 1u } };
-        NonzeroHeight u { h };
-        ltime = operator[](l).timestamp();
-        utime = operator[](u).timestamp();
-        if (l!=lower) {
-            assert(l == lower+1);
-            worksum -= operator[](l).target(l);
-            lower=l;
-        }
-        if (u != upper) {
-            assert(u == upper+1);
-            worksum += operator[](upper).target(upper);
-            upper=u;
-        }
-        chart.push_back(compute_hashrate());
+    chart.reserve((max - min) / step + 1);
+    for (auto h { min }; h <= max; h = h + step) {
+        NonzeroHeight lower { h.value() > nblocks ? (h - nblocks).nonzero_assert() : NonzeroHeight { 1u } };
+        chart.push_back(hashrate(lower, h));
     }
-    assert(chart.size() == max-min+1);
     assert(chart.size() != 0);
-    return {.range{.begin{min},.end{max}},.chart{std::move(chart)}};
+    return { .range { .begin { min }, .end { max } }, .step = step, .chart { std::move(chart) } };
 }
 
-Batch Headerchain::get_headers(NonzeroHeight begin, NonzeroHeight end) const
+HeaderSpans Headerchain::header_spans(NonzeroHeight begin, NonzeroHeight end) const
 {
     assert(end - begin <= HEADERBATCHSIZE);
     if (end > length()) {
         end = (length() + 1).nonzero_assert();
     }
-    if (end <= begin)
-        return Batch {};
-
+    HeaderSpans spans;
     Height h = begin;
-    std::vector<uint8_t> tmp;
     while (h < end) {
         Batchslot bs(h);
         const Batch* p = operator[](bs);
         if (!p)
             break;
         uint32_t offset = h - bs.lower();
-        auto cpy_begin = p->data() + Header::byte_size() * offset;
-        uint32_t n1 = end - h;
-        uint32_t n2 = bs.upper() + 1 - h;
-        uint32_t n;
-        if (n1 <= n2) {
-            n = n1;
-        } else {
-            n = n2;
-        }
+        uint32_t n = std::min(uint32_t(end - h), uint32_t(bs.upper() + 1 - h));
         h = h + n;
-        auto cpy_end = cpy_begin + n * Header::byte_size();
-        assert(size_t(cpy_end - p->data()) <= p->size() * Header::byte_size());
-        std::copy(cpy_begin, cpy_end, std::back_inserter(tmp));
+        assert(offset + n <= p->size());
+        spans.push_back({ p->data() + Header::byte_size() * offset, n * Header::byte_size() });
     }
+    return spans;
+}
+
+Batch Headerchain::get_headers(NonzeroHeight begin, NonzeroHeight end) const
+{
+    auto spans { header_spans(begin, end) };
+    std::vector<uint8_t> tmp;
+    tmp.reserve(HEADERBATCHSIZE * Header::byte_size());
+    for (auto& s : spans)
+        tmp.insert(tmp.end(), s.begin(), s.end());
     return Batch(std::move(tmp));
 }
 
@@ -215,20 +204,29 @@ std::optional<HeaderView> Headerchain::get_header(Height h) const
     auto s = Batchslot(h);
     size_t i = s.index();
     size_t rem = h - s.lower();
-    if (i < completeBatches.size()) {
-        return completeBatches[i].getHeader(rem);
+    if (i < completeBatches->size()) {
+        return (*completeBatches)[i].getHeader(rem);
     } else {
-        return incompleteBatch.get_header(rem);
+        return incompleteBatch->get_header(rem);
     }
 }
 
 ForkHeight fork_height(const Headerchain& h1, const Headerchain& h2, NonzeroHeight startHeight)
 {
     Batchslot bs(startHeight);
-    auto [f, _] = binary_forksearch(h1.completeBatches, h2.completeBatches, bs.index());
-    const Batch& b1 = (f < h1.completeBatches.size() ? h1.completeBatches[f].getBatch() : h1.incompleteBatch);
-    const Batch& b2 = (f < h2.completeBatches.size() ? h2.completeBatches[f].getBatch() : h2.incompleteBatch);
-    auto [forkIndex, forked] = binary_forksearch(b1, b2);
+    auto& c1 { *h1.completeBatches };
+    auto& c2 { *h2.completeBatches };
+    const size_t len { std::min(c1.size(), c2.size()) };
+    // Batches shared in the registry compare by identity. Otherwise equal
+    // batch-end headers imply equal batches because every header commits
+    // to its predecessor, so no header is hashed in either level.
+    const size_t f { gallop_forksearch([&](size_t i) {
+        return c1[i] == c2[i] || c1[i].getBatch().last() == c2[i].getBatch().last();
+    },
+        std::min(bs.index(), len), len) };
+    const Batch& b1 = (f < c1.size() ? c1[f].getBatch() : *h1.incompleteBatch);
+    const Batch& b2 = (f < c2.size() ? c2[f].getBatch() : *h2.incompleteBatch);
+    auto [forkIndex, forked] = gallop_forksearch(b1, b2);
     return { NonzeroHeight(uint32_t(f * HEADERBATCHSIZE + forkIndex + 1)), forked };
 }
 
@@ -236,11 +234,13 @@ Headerchain::Headerchain(HeaderchainSkeleton skeleton)
     : HeaderchainSkeleton(std::move(skeleton))
 {
     const SharedBatch* p = &finalPin;
+    std::vector<SharedBatchView> cb;
     while (p->valid()) {
-        completeBatches.push_back(SharedBatchView(*p));
+        cb.push_back(SharedBatchView(*p));
         p = &p->prev();
     }
-    std::reverse(completeBatches.begin(), completeBatches.end());
+    std::reverse(cb.begin(), cb.end());
+    completeBatches = std::move(cb);
     initialize_worksum();
 }
 Headerchain::Headerchain(const Headerchain& from, Height subheight)
@@ -249,12 +249,11 @@ Headerchain::Headerchain(const Headerchain& from, Height subheight)
         throw std::out_of_range("Cannot extract subchain of length " + to_string(subheight) + " from chain of length " + to_string(from.length()));
     Batchslot bs(subheight);
     const size_t I = bs.index() + 1;
-    for (size_t i = 0; i < I; ++i) {
-        completeBatches.push_back(from.completeBatches[i]);
-    }
-    const Batch& b = (from.completeBatches.size() == I ? from.incompleteBatch : from.completeBatches[I].getBatch());
-    incompleteBatch = b;
-    incompleteBatch.shrink(subheight - bs.lower());
+    auto& fc { *from.completeBatches };
+    completeBatches = std::vector<SharedBatchView>(fc.begin(), fc.begin() + I);
+    Batch b { fc.size() == I ? *from.incompleteBatch : fc[I].getBatch() };
+    b.shrink(subheight - bs.lower());
+    incompleteBatch = std::move(b);
     initialize_worksum();
 }
 
@@ -266,10 +265,10 @@ const Headerchain::HeaderViewNoHash Headerchain::operator[](NonzeroHeight h) con
     size_t i = bs.index();
     size_t rem = h - bs.lower();
     assert(((h - 1).value() % HEADERBATCHSIZE) == rem);
-    if (i < completeBatches.size()) {
-        return static_cast<Headerchain::HeaderViewNoHash>(completeBatches[i].getBatch()[rem]);
+    if (i < completeBatches->size()) {
+        return static_cast<Headerchain::HeaderViewNoHash>((*completeBatches)[i].getBatch()[rem]);
     } else {
-        return incompleteBatch[rem];
+        return (*incompleteBatch)[rem];
     }
 }
 
@@ -278,13 +277,19 @@ Grid Headerchain::grid(Batchslot begin) const
     return { *this, begin };
 }
 
-void Headerchain::initialize_worksum()
+void Headerchain::initialize_worksum(Height unchanged)
 {
-    assert(Height(completeBatches.size() * HEADERBATCHSIZE) == finalPin.upper_height());
-    worksum = incompleteBatch.worksum(finalPin.upper_height());
-    if (completeBatches.size() > 0) {
-        worksum += completeBatches.back().total_work();
+    const Height offset { finalPin.upper_height() };
+    assert(Height(completeBatches->size() * HEADERBATCHSIZE) == offset);
+    incompleteWork = WorkPrefix(*incompleteBatch, offset, finalPin.total_work());
+    if (incompleteSeries->lower() != offset || unchanged <= offset) {
+        incompleteSeries = WorkSeries(*incompleteBatch, *incompleteWork, offset);
+    } else {
+        auto& s { incompleteSeries.mut() };
+        s.shrink(unchanged);
+        s.extend(*incompleteBatch, *incompleteWork);
     }
+    worksum = incompleteWork->total();
     auto ws2 = sum_work(NonzeroHeight(1u), (length() + 1).nonzero_assert());
     assert(worksum == ws2);
 }
@@ -323,17 +328,17 @@ Worksum Headerchain::sum_work(const NonzeroHeight beginHeight,
         return {};
     assert(h <= length());
     Batchslot s(h);
-    SharedBatchView prev(s == Batchslot(0) ? SharedBatchView() : completeBatches[s.index() - 1]);
-    auto& incomplete { s.index() == completeBatches.size() ? incompleteBatch : completeBatches[s.index()].getBatch() };
-    assert(s.offset() == prev.upper_height());
-    Worksum w(prev.total_work() + incomplete.worksum(s.offset(), h - s.offset()));
+    auto& cb { *completeBatches };
+    Worksum w(s.index() == cb.size() ? incompleteWork->at(h) : cb[s.index()].total_work_at(h));
     assert(w == sum_work(NonzeroHeight(1u), (h + 1).nonzero_assert()));
     return w;
 }
 
 void Headerchain::clear()
 {
-    completeBatches.clear();
-    incompleteBatch.clear();
+    completeBatches.reset();
+    incompleteBatch.reset();
+    incompleteWork.reset();
+    incompleteSeries.reset();
     worksum.setzero();
 }
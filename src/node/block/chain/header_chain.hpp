@@ -3,6 +3,7 @@
 #include "block/header/view_inline.hpp"
 #include "communication/messages.hpp"
 #include "api/types/forward_declarations.hpp"
+#include "general/copy_on_write.hpp"
 
 struct HeaderchainAppend {
     std::vector<SharedBatchView> completeBatches;
@@ -30,17 +31,19 @@ public:
         , incompleteBatch(std::move(incompleteBatch)) {};
 
     std::optional<HeaderView> inefficient_get_header(NonzeroHeight h) const;
-    Height length() const { return finalPin.upper_height() + incompleteBatch.size(); };
-    const Batch& incomplete_batch() { return incompleteBatch; }
+    Height length() const { return finalPin.upper_height() + incompleteBatch->size(); };
+    const Batch& incomplete_batch() { return *incompleteBatch; }
 
 protected:
     HeaderchainSkeleton() {};
     SharedBatch finalPin;
-    Batch incompleteBatch;
+    CopyOnWrite<Batch> incompleteBatch;
 };
 
 class Headerchain;
 [[nodiscard]] ForkHeight fork_height(const Headerchain& h1, const Headerchain& h2, NonzeroHeight startHeight = { 1u });
+// Batch storage is shared between copies and only copied on modification,
+// such that pins and concurrent snapshots are O(1)
 class Headerchain : public HeaderchainSkeleton {
     struct HeaderViewNoHash : public HeaderView {
         HeaderViewNoHash(const HeaderView& hv)
@@ -83,15 +86,19 @@ public:
 
     void shrink(Height shrinkLength);
     uint64_t hashrate(uint32_t nblocks) const;
-    API::HashrateChart hashrate_chart(NonzeroHeight min, NonzeroHeight max, uint32_t nblocks) const;
+    // every step-th height from min on, averaged over nblocks
+    API::HashrateChart hashrate_chart(NonzeroHeight min, NonzeroHeight max, uint32_t nblocks, uint32_t step = 1) const;
 
-    size_t nonempty_batch_size() const { return completeBatches.size() + (incompleteBatch.size() > 0 ? 1 : 0); }
+    size_t nonempty_batch_size() const { return completeBatches->size() + (incompleteBatch->size() > 0 ? 1 : 0); }
     Batch get_headers(NonzeroHeight begin, NonzeroHeight end) const;
-    GridView grid_view() const { return completeBatches; }
+    // same headers as get_headers without copying, valid until the chain
+    // is modified
+    HeaderSpans header_spans(NonzeroHeight begin, NonzeroHeight end) const;
+    GridView grid_view() const { return *completeBatches; }
     std::optional<HeaderView> get_header(Height) const;
     [[nodiscard]] Height length() const
     {
-        return finalPin.upper_height() + incompleteBatch.size();
+        return finalPin.upper_height() + incompleteBatch->size();
     }
     Headerchain() {};
     explicit Headerchain(HeaderchainSkeleton);
@@ -105,24 +112,29 @@ public:
     const Batch* operator[](Batchslot bs) const
     {
         size_t index = bs.index();
-        if (index > completeBatches.size())
+        if (index > completeBatches->size())
             return nullptr;
-        if (index == completeBatches.size()) {
-            return &incompleteBatch;
+        if (index == completeBatches->size()) {
+            return &*incompleteBatch;
         }
-        return &completeBatches[index].getBatch();
+        return &(*completeBatches)[index].getBatch();
     };
     Worksum total_work() const { return worksum; }
-    const std::vector<SharedBatchView>& complete_batches() const { return completeBatches; }
+    const std::vector<SharedBatchView>& complete_batches() const { return *completeBatches; }
     [[nodiscard]] Worksum total_work_at(Height) const;
+    [[nodiscard]] uint32_t timestamp_at(NonzeroHeight h) const { return work_series(h).timestamp_at(h); }
+    [[nodiscard]] Target target_at(NonzeroHeight h) const { return work_series(h).target_at(h); }
     [[nodiscard]] std::optional<Hash> get_hash(Height h) const
     {
         if (h > length())
             return {};
         if (length() == 0)
             return Hash::genesis();
-        if (h == length())
+        if (h == length()) {
+            if (incompleteBatch->size() == 0)
+                return finalPin.hash(h); // cached in batch registry
             return static_cast<HeaderView>(operator[](h.nonzero_assert())).hash();
+        }
         return operator[]((h + 1).nonzero_assert()).prevhash();
     };
     [[nodiscard]] Hash hash_at(Height height) const
@@ -137,10 +149,15 @@ public:
 
 protected: // methods
     const HeaderView header_view(uint32_t height) const;
-    void initialize_worksum();
+    // heights up to unchanged kept their headers since the last call
+    void initialize_worksum(Height unchanged = Height(0));
+    const WorkSeries& work_series(NonzeroHeight) const;
+    double hashrate(NonzeroHeight lower, NonzeroHeight upper) const;
     [[nodiscard]] Worksum sum_work(const NonzeroHeight begin, const NonzeroHeight end) const;
 
 protected: // variables
-    std::vector<SharedBatchView> completeBatches;
+    CopyOnWrite<std::vector<SharedBatchView>> completeBatches;
+    CopyOnWrite<WorkPrefix> incompleteWork;
+    CopyOnWrite<WorkSeries> incompleteSeries;
     Worksum worksum;
 };
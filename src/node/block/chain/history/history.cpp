@@ -1,56 +1,85 @@
 #include "history.hpp"
 #include "block/chain/header_chain.hpp"
+#include "signature_cache.hpp"
 
-VerifiedTransfer TransferInternal::verify(const Headerchain& hc, NonzeroHeight height) const
+auto TransferInternal::hash_input(const Headerchain& hc, NonzeroHeight height) const -> HashInput
+{
+    assert(height <= hc.length() + 1);
+    assert(!toAddress.is_null());
+    PinHeight pinHeight(pinNonce.pin_height(PinFloor { PrevHeight(height) }));
+    HashInput in;
+    in << hc.hash_at(pinHeight)
+       << pinHeight
+       << pinNonce.id
+       << pinNonce.reserved
+       << compactFee
+       << toAddress
+       << amount;
+    return in;
+}
+
+VerifiedTransfer TransferInternal::verify(const Headerchain& hc, NonzeroHeight height, const Hash& hash, SignatureCache* cache) const
 {
     assert(height <= hc.length() + 1);
     assert(!fromAddress.is_null());
     assert(!toAddress.is_null());
     const PinFloor pinFloor { PrevHeight(height) };
     PinHeight pinHeight(pinNonce.pin_height(pinFloor));
-    Hash pinHash { hc.hash_at(pinHeight) };
-    return VerifiedTransfer(*this, pinHeight, pinHash);
+    return VerifiedTransfer(*this, pinHeight, hash, cache);
+}
+
+VerifiedTransfer TransferInternal::trust(const Headerchain& hc, NonzeroHeight height, const Hash& hash) const
+{
+    assert(height <= hc.length() + 1);
+    const PinFloor pinFloor { PrevHeight(height) };
+    return VerifiedTransfer(*this, pinNonce.pin_height(pinFloor), hash);
+}
+
+auto RewardInternal::hash_input() const -> HashInput
+{
+    HashInput in;
+    in << toAddress
+       << amount
+       << height
+       << offset;
+    return in;
 }
 
 Hash RewardInternal::hash() const
 {
-    return HasherSHA256()
-        << toAddress
-        << amount
-        << height
-        << offset;
+    auto in { hash_input() };
+    return hashSHA256(in.data(), in.size());
 }
 
-bool VerifiedTransfer::valid_signature() const
+bool VerifiedTransfer::valid_signature(SignatureCache* cache) const
 {
     assert(!ti.fromAddress.is_null());
     assert(!ti.toAddress.is_null());
-    auto recovered = recover_address();
-    return recovered == ti.fromAddress;
+    auto recovered { cache ? cache->recover(ti.signature, hash) : ti.signature.recover_address(hash) };
+    return recovered && *recovered == ti.fromAddress;
 }
-VerifiedTransfer::VerifiedTransfer(const TransferInternal& ti, PinHeight pinHeight, HashView pinHash)
+VerifiedTransfer::VerifiedTransfer(const TransferInternal& ti, PinHeight pinHeight, const Hash& hash, SignatureCache* cache)
     : ti(ti)
     , id { ti.fromAccountId, pinHeight, ti.pinNonce.id }
-    , hash(HasherSHA256()
-          << pinHash
-          << pinHeight
-          << ti.pinNonce.id
-          << ti.pinNonce.reserved
-          << ti.compactFee
-          << ti.toAddress
-          << ti.amount)
-{
-    if (!valid_signature())
+    , hash(hash)
+{
+    if (!valid_signature(cache))
         throw Error(ECORRUPTEDSIG);
 }
+VerifiedTransfer::VerifiedTransfer(const TransferInternal& ti, PinHeight pinHeight, const Hash& hash)
+    : ti(ti)
+    , id { ti.fromAccountId, pinHeight, ti.pinNonce.id }
+    , hash(hash)
+{
+}
 
 namespace history {
-Entry::Entry(const RewardInternal& p)
+Entry::Entry(const RewardInternal& p, const Hash& hash)
+    : hash(hash)
 {
     data = serialize(RewardData {
         p.toAccountId,
         p.amount });
-    hash = p.hash();
 }
 
 Entry::Entry(const VerifiedTransfer& p)
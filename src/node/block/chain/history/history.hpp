@@ -4,12 +4,15 @@
 #include "crypto/hasher_sha256.hpp"
 #include <variant>
 class Headerchain;
+class SignatureCache;
 struct RewardInternal {
     AccountId toAccountId;
     Funds amount;
     NonzeroHeight height;
     uint16_t offset; // id of payout in block
     AddressView toAddress { nullptr };
+    using HashInput = SHA256Input<20 + 8 + 4 + 2>;
+    HashInput hash_input() const;
     Hash hash() const;
     RewardInternal(AccountId toAccountId, Funds amount, NonzeroHeight height,
         uint16_t offset)
@@ -30,7 +33,12 @@ struct TransferInternal {
     AddressView fromAddress { nullptr };
     AddressView toAddress { nullptr };
     RecoverableSignature signature;
-    VerifiedTransfer verify(const Headerchain&, NonzeroHeight) const;
+    using HashInput = SHA256Input<32 + 4 + 4 + 3 + 8 + 20 + 8>;
+    HashInput hash_input(const Headerchain&, NonzeroHeight) const;
+    // hash must be the hash of hash_input()
+    VerifiedTransfer verify(const Headerchain&, NonzeroHeight, const Hash& hash, SignatureCache* = nullptr) const;
+    // skips the signature check, for blocks of a trusted primary
+    VerifiedTransfer trust(const Headerchain&, NonzeroHeight, const Hash& hash) const;
     TransferInternal(AccountId from, CompactUInt compactFee, AccountId to,
         Funds amount, PinNonce pinNonce, View<65> signdata)
         : fromAccountId(from)
@@ -45,12 +53,9 @@ struct TransferInternal {
 
 class VerifiedTransfer {
     friend struct TransferInternal;
-    VerifiedTransfer(const TransferInternal&, PinHeight pinHeight, HashView pinHash);
-    Address recover_address() const
-    {
-        return ti.signature.recover_pubkey(hash).address();
-    }
-    bool valid_signature() const;
+    VerifiedTransfer(const TransferInternal&, PinHeight pinHeight, const Hash& hash, SignatureCache*);
+    VerifiedTransfer(const TransferInternal&, PinHeight pinHeight, const Hash& hash);
+    bool valid_signature(SignatureCache*) const;
 
 public:
     const TransferInternal& ti;
@@ -80,7 +85,7 @@ struct RewardData {
 };
 using Data = std::variant<TransferData, RewardData>;
 struct Entry {
-    Entry(const RewardInternal& p);
+    Entry(const RewardInternal& p, const Hash& hash);
     Entry(const VerifiedTransfer& p);
     Hash hash;
     std::vector<uint8_t> data;
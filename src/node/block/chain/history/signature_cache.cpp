@@ -0,0 +1,36 @@
+#include "signature_cache.hpp"
+#include "general/memory_budget.hpp"
+
+namespace {
+// key, address and hash node plus the order slot
+constexpr size_t approxEntryBytes = 192;
+memory_budget::Component& budget()
+{
+    static auto& c { memory_budget::component("signature_cache", 1, 10000 * approxEntryBytes) };
+    return c;
+}
+}
+
+std::optional<Address> SignatureCache::recover(const RecoverableSignature& signature, const Hash& txhash)
+{
+    Key key { txhash, signature.serialize() };
+    {
+        std::lock_guard l(m);
+        if (auto iter { entries.find(key) }; iter != entries.end())
+            return iter->second;
+    }
+    auto address { signature.recover_address(txhash) };
+    if (!address)
+        return {};
+    std::lock_guard l(m);
+    auto [iter, inserted] { entries.try_emplace(key, *address) };
+    if (inserted) {
+        order.push_back(&iter->first);
+        while (!order.empty() && order.size() > budget().max_entries(approxEntryBytes, capacity)) {
+            entries.erase(entries.find(*order.front()));
+            order.pop_front();
+        }
+        budget().set_usage(order.size() * approxEntryBytes);
+    }
+    return address;
+}
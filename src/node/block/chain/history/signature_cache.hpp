@@ -0,0 +1,37 @@
+#pragma once
+#include "crypto/crypto.hpp"
+#include "crypto/hash.hpp"
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+// Signer addresses of transfers recovered on mempool admission such that
+// blocks of already seen transactions skip secp256k1 recovery. Entries are
+// keyed by transaction hash and signature because the hash does not commit
+// to the signature. The oldest entries are evicted first. Thread safe.
+class SignatureCache {
+public:
+    static constexpr size_t capacity = 100000; // default mempool size
+
+    // nullopt for invalid signatures, which are not cached
+    std::optional<Address> recover(const RecoverableSignature&, const Hash& txhash);
+
+private:
+    struct Key {
+        Hash txhash;
+        std::array<uint8_t, 65> signature;
+        bool operator==(const Key&) const = default;
+    };
+    struct KeyHasher {
+        size_t operator()(const Key& k) const
+        {
+            size_t h;
+            memcpy(&h, k.txhash.data(), sizeof(h));
+            return h;
+        }
+    };
+    std::mutex m;
+    std::unordered_map<Key, Address, KeyHasher> entries;
+    std::deque<const Key*> order; // insertion order, node keys are stable
+};
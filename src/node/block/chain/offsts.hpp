@@ -3,11 +3,21 @@
 #include "block/chain/height.hpp"
 #include "block/chain/history/index.hpp"
 #include <algorithm>
+#include <bit>
+#include <span>
 
+// Maps ids to the height of the block that introduced them, data holds the
+// first id of every block. Lookups search a shadow copy of data in
+// Eytzinger (BFS) order whose top levels stay cached and whose deeper levels
+// are prefetched, entries appended after the last rebuild form a short
+// sorted tail searched separately.
 template <typename HeightType, typename T>
 struct Heights {
     Heights(std::vector<T> data = {})
-        : data(std::move(data)) {};
+        : data(std::move(data))
+    {
+        rebuild_index();
+    };
     const T& at(NonzeroHeight h) const
     {
         return data.at((h - 1).value());
@@ -16,21 +26,60 @@ struct Heights {
     {
         assert(size() >= newlength.value());
         data.erase(data.begin() + newlength.value(), data.end());
+        if (indexed > data.size())
+            rebuild_index();
     }
     void append(T v)
     {
         data.push_back(std::move(v));
+        update_index();
     }
     [[nodiscard]] HeightType height(const T& t) const
     {
-        auto iter = std::upper_bound(data.begin(), data.end(),
-            t);
-        assert(iter != data.begin());
-        return HeightType(uint32_t((iter - 1) - data.begin() + 1));
+        const uint64_t v { t.value() };
+        const size_t n { indexed };
+        size_t k { 1 };
+        while (k <= n) {
+            // descendants three levels down share one cache line
+            __builtin_prefetch(keys.data() + std::min(8 * k, n));
+            k = 2 * k + (keys[k] <= v);
+        }
+        k >>= std::countr_one(k) + 1; // first key > v, 0 if none
+        size_t i;
+        if (k != 0)
+            i = ranks[k];
+        else
+            i = std::upper_bound(data.begin() + n, data.end(), t) - data.begin();
+        assert(i != 0);
+        return HeightType(uint32_t(i));
+    }
+
+    // heights of ascending ids, one merge pass over data galloping from the
+    // previous match
+    [[nodiscard]] std::vector<HeightType> heights(std::span<const T> ascending) const
+    {
+        std::vector<HeightType> res;
+        res.reserve(ascending.size());
+        size_t lo { 0 }; // data[lo - 1] <= current id
+        for (auto& t : ascending) {
+            size_t step { 1 };
+            size_t hi { lo };
+            while (hi < data.size() && data[hi] <= t) {
+                lo = hi + 1;
+                hi += step;
+                step *= 2;
+            }
+            hi = std::min(hi, data.size());
+            lo = std::upper_bound(data.begin() + lo, data.begin() + hi, t) - data.begin();
+            assert(lo != 0);
+            res.push_back(HeightType(uint32_t(lo)));
+        }
+        return res;
     }
     void append_vector(const std::vector<T>& v)
     {
         data.insert(data.end(), v.begin(), v.end());
+        update_index();
     }
     size_t size() const
     {
@@ -38,7 +87,37 @@ struct Heights {
     }
 
 protected:
+    // rebuilds once the tail grows beyond 1/64 of the index such that
+    // appends stay amortized constant
+    void update_index()
+    {
+        if (data.size() - indexed > std::max(indexed / 64, size_t(1024)))
+            rebuild_index();
+    }
+    void rebuild_index()
+    {
+        indexed = data.size();
+        keys.resize(indexed + 1);
+        ranks.resize(indexed + 1);
+        size_t i { 0 };
+        fill_index(i, 1);
+    }
+    void fill_index(size_t& i, size_t k)
+    {
+        if (k > indexed)
+            return;
+        fill_index(i, 2 * k);
+        keys[k] = data[i].value();
+        ranks[k] = uint32_t(i); // ids up to the key preceding data[i]
+        i += 1;
+        fill_index(i, 2 * k + 1);
+    }
     std::vector<T> data;
+
+    // Eytzinger shadow index over data[0, indexed), 1-based
+    size_t indexed { 0 };
+    std::vector<uint64_t> keys;
+    std::vector<uint32_t> ranks;
 };
 using HistoryHeights = Heights<NonzeroHeight, HistoryId>;
 using AccountHeights = Heights<AccountHeight, AccountId>;
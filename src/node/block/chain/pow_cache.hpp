@@ -0,0 +1,61 @@
+#pragma once
+#include "block/chain/height.hpp"
+#include "crypto/hash.hpp"
+#include <cstring>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+// Proof of work results of recently checked headers by header hash. Peers
+// announce new blocks within milliseconds of each other and the incomplete
+// final batch of every leader is checked again on each new block, cached
+// headers skip the (verus) hashing. The result only depends on the header
+// bytes and its height, entries are evicted first in first out.
+class PowCache {
+public:
+    PowCache(size_t capacity)
+        : capacity(capacity)
+    {
+        ring.reserve(capacity);
+    }
+    [[nodiscard]] std::optional<bool> lookup(const Hash& hash, NonzeroHeight height) const
+    {
+        auto iter { map.find(hash) };
+        if (iter == map.end() || iter->second.height != height)
+            return {};
+        return iter->second.valid;
+    }
+    void insert(const Hash& hash, NonzeroHeight height, bool valid)
+    {
+        auto [iter, inserted] { map.try_emplace(hash, Entry { height, valid }) };
+        if (!inserted) {
+            iter->second = { height, valid };
+            return;
+        }
+        if (ring.size() < capacity) {
+            ring.push_back(hash);
+        } else {
+            map.erase(ring[next]);
+            ring[next] = hash;
+            next = (next + 1) % capacity;
+        }
+    }
+
+private:
+    struct Entry {
+        NonzeroHeight height;
+        bool valid;
+    };
+    struct Hasher {
+        size_t operator()(const Hash& h) const
+        {
+            size_t res;
+            memcpy(&res, h.data(), sizeof(res));
+            return res;
+        }
+    };
+    size_t capacity;
+    size_t next { 0 }; // oldest ring entry once full
+    std::vector<Hash> ring;
+    std::unordered_map<Hash, Entry, Hasher> map;
+};
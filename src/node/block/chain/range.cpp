@@ -4,7 +4,7 @@
 bool BlockRange::valid()
 {
     return lower <= upper
-        && (upper - lower + 1 <= MAXBLOCKBATCHSIZE);
+        && (upper - lower + 1 <= MAXBLOCKRANGESIZE);
 }
 
 Writer& operator<<(Writer& w, BlockRange br)
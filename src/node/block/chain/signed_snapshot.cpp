@@ -6,13 +6,62 @@
 #include "spdlog/spdlog.h"
 #include <algorithm>
 #include <array>
+#include <cstring>
+#include <deque>
+#include <mutex>
 #include <string_view>
 
+namespace {
+// Importance of recently verified snapshots by height, hash and signature.
+// Every peer relays the same snapshot in its InitMsg and rollback messages,
+// each distinct one is recovered (ECDSA) once. Snapshots are parsed on
+// several threads.
+class VerifiedSnapshots {
+public:
+    using Key = std::array<uint8_t, SignedSnapshot::binary_size>;
+    static Key key(NonzeroHeight h, const Hash& hash, const RecoverableSignature& sig)
+    {
+        Key k;
+        const uint32_t height { h.value() };
+        memcpy(k.data(), &height, 4);
+        memcpy(k.data() + 4, hash.data(), 32);
+        sig.serialize(k.data() + 36);
+        return k;
+    }
+    std::optional<uint16_t> lookup(const Key& k)
+    {
+        std::lock_guard l(m);
+        for (auto& [key, importance] : entries)
+            if (key == k)
+                return importance;
+        return {};
+    }
+    void insert(const Key& k, uint16_t importance)
+    {
+        std::lock_guard l(m);
+        entries.push_back({ k, importance });
+        if (entries.size() > capacity)
+            entries.pop_front();
+    }
+
+private:
+    static constexpr size_t capacity { 32 };
+    std::mutex m;
+    std::deque<std::pair<Key, uint16_t>> entries;
+} verifiedSnapshots;
+}
+
 SignedSnapshot::Priority::Priority(Reader& r)
     : Priority({r.uint16(), Height(r)}) {}
-uint16_t SignedSnapshot::get_importance()
+uint16_t SignedSnapshot::get_importance(NonzeroHeight height)
 {
-    return SnapshotSigner::get_importance(signature.recover_pubkey(hash));
+    const auto k { VerifiedSnapshots::key(height, hash, signature) };
+    if (auto importance { verifiedSnapshots.lookup(k) })
+        return *importance;
+    // throws for signatures of non-leaders, these are not cached
+    const auto importance { SnapshotSigner::get_importance(signature.recover_pubkey(hash)) };
+    verifiedSnapshots.insert(k, importance);
+    return importance;
 }
 
 bool SignedSnapshot::compatible(const Headerchain& hc) const
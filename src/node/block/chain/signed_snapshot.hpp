@@ -62,7 +62,7 @@ private:
     SignedSnapshot(NonzeroHeight height, HashView hash, RecoverableSignature signature)
         : hash(hash)
         , signature(signature)
-        , priority { get_importance(), height } {}
+        , priority { get_importance(height), height } {}
     SignedSnapshot(NonzeroPriority p, HashView hash, RecoverableSignature signature)
         : hash(hash)
         , signature(signature)
@@ -70,7 +70,8 @@ private:
     {
         assert(p.height != 0);
     }
-    uint16_t get_importance();
+    // verifies the signature, cached for snapshots relayed by many peers
+    uint16_t get_importance(NonzeroHeight);
 };
 
 class SnapshotSigner {
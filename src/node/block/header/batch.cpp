@@ -1,8 +1,10 @@
 #include "batch.hpp"
 #include "block/chain/header_chain.hpp"
 #include "block/header/header_impl.hpp"
+#include "crypto/hasher_sha256.hpp"
 #include "general/now.hpp"
 #include "timestamprule.hpp"
+#include <algorithm>
 
 namespace {
 auto last_element_vector(const Headerchain& hc, Batchslot begin)
@@ -61,14 +63,99 @@ Worksum Batch::worksum(const Height offset, uint32_t maxElements) const
     return sum;
 }
 
-bool Batch::valid_inner_links()
+WorkPrefix::WorkPrefix(const Batch& b, Height offset, const Worksum& before)
+    : offset(offset)
+    , upper(offset + b.size())
+    , before(before)
+{
+    Worksum sum { before };
+    Height lower { offset };
+    while (lower < upper) {
+        // the header at height h is weighted by the target valid from
+        // retarget_floor(h - 1) on, find the last height of this segment
+        const uint32_t rf { ::retarget_floor(lower.value()) };
+        uint32_t l { lower.value() + 1 }, u { upper.value() };
+        while (l < u) {
+            uint32_t m { l + (u - l + 1) / 2 };
+            if (::retarget_floor(m - 1) == rf)
+                l = m;
+            else
+                u = m - 1;
+        }
+        NonzeroHeight h { (lower + 1).nonzero_assert() };
+        auto header = b.get_header(lower - offset);
+        assert(header);
+        Segment s { lower, sum, header->target(h) };
+        Worksum w { s.perHeader };
+        w *= l - lower.value();
+        sum += w;
+        segments.push_back(s);
+        lower = Height(l);
+    }
+}
+
+void WorkSeries::extend(const Batch& b, const WorkPrefix& wp)
+{
+    work.reserve(b.size());
+    timestamps.reserve(b.size());
+    for (size_t i = work.size(); i < b.size(); ++i) {
+        const NonzeroHeight h { (offset + uint32_t(i + 1)).nonzero_assert() };
+        const auto header { b[i] };
+        work.push_back(wp.at(h).getdouble());
+        timestamps.push_back(header.timestamp());
+        auto target { header.target(h) };
+        if (targets.empty() || targets.back().target != target)
+            targets.push_back({ uint32_t(i), std::move(target) });
+    }
+}
+
+const Target& WorkSeries::target_at(NonzeroHeight h) const
+{
+    const uint32_t i { h - offset - 1 };
+    assert(i < work.size());
+    auto iter { std::partition_point(targets.begin(), targets.end(),
+        [&](const TargetRun& r) { return r.begin <= i; }) };
+    assert(iter != targets.begin());
+    return (iter - 1)->target;
+}
+
+void WorkSeries::shrink(Height length)
+{
+    const size_t n { length > offset ? length - offset : 0 };
+    if (n < work.size()) {
+        work.resize(n);
+        timestamps.resize(n);
+        while (!targets.empty() && targets.back().begin >= n)
+            targets.pop_back();
+    }
+}
+
+Worksum WorkPrefix::at(Height h) const
+{
+    assert(h >= offset && h <= upper);
+    if (h == offset)
+        return before;
+    auto iter { std::partition_point(segments.begin(), segments.end(),
+        [&](const Segment& s) { return s.lower < h; }) };
+    assert(iter != segments.begin());
+    auto& s { *(iter - 1) };
+    Worksum w { s.perHeader };
+    w *= h - s.lower;
+    return w += s.sum;
+}
+
+bool Batch::valid_inner_links() const
 {
     if (size() <= 1)
         return true;
     const size_t N = size();
-    size_t i = 0;
-    for (i = 1; i < N; ++i) {
-        if (operator[](i - 1).hash() != operator[](i).prevhash())
+
+    // double SHA256 of all but the last header (multi-buffer)
+    std::vector<Hash> inner(N - 1), hashes(N - 1);
+    hashSHA256_batch(data(), HeaderView::bytesize, HeaderView::bytesize, N - 1, inner.data());
+    hashSHA256_batch(inner.front().data(), 32, sizeof(Hash), N - 1, hashes.data());
+    for (size_t i = 1; i < N; ++i) {
+        if (hashes[i - 1] != operator[](i).prevhash())
             return false;
     }
     return true;
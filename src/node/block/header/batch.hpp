@@ -1,9 +1,10 @@
 #pragma once
 #include "block/chain/pin.hpp"
+#include "block/chain/worksum.hpp"
+#include "block/header/difficulty_declaration.hpp"
 #include "general/errors.hpp"
 #include <span>
 
-class Worksum;
 class Headerchain;
 class Headervec {
 public:
@@ -121,7 +122,70 @@ public:
     using Headervec::Headervec;
     bool complete() const { return size() == HEADERBATCHSIZE; }
     Worksum worksum(Height offset, uint32_t maxElements = HEADERBATCHSIZE) const;
-    bool valid_inner_links();
+    bool valid_inner_links() const;
+};
+
+// consecutive headers spread over several batches, referenced in place
+using HeaderSpans = std::vector<std::span<const uint8_t>>;
+
+// Work prefix sums of a batch at its retarget heights. The headers between
+// two retargets share one target, so the total work at any height in the
+// batch is a single multiply-add.
+class WorkPrefix {
+public:
+    WorkPrefix() { }
+    WorkPrefix(const Batch&, Height offset, const Worksum& before);
+    // total work of heights 1 to h, offset <= h <= offset + batch size
+    Worksum at(Height h) const;
+    Worksum total() const { return at(upper); }
+
+private:
+    struct Segment {
+        Height lower; // total work at lower is sum
+        Worksum sum;
+        Worksum perHeader;
+    };
+    Height offset { 0 };
+    Height upper { 0 };
+    Worksum before;
+    std::vector<Segment> segments;
+};
+
+// Side tables of a batch with the total work as double and the timestamp
+// per height and the decoded targets per retarget run. Header derived queries read them instead
+// of decoding headers, hashrates over any window are two lookups and a
+// division.
+class WorkSeries {
+public:
+    WorkSeries() { }
+    WorkSeries(Height offset)
+        : offset(offset)
+    {
+    }
+    WorkSeries(const Batch& b, const WorkPrefix& wp, Height offset)
+        : offset(offset)
+    {
+        extend(b, wp);
+    }
+    // appends the heights of b beyond the current end
+    void extend(const Batch& b, const WorkPrefix&);
+    // keeps heights up to length
+    void shrink(Height length);
+    Height lower() const { return offset; } // entries start at lower + 1
+    Height upper() const { return offset + uint32_t(work.size()); }
+    double work_at(NonzeroHeight h) const { return work[h - offset - 1]; }
+    uint32_t timestamp_at(NonzeroHeight h) const { return timestamps[h - offset - 1]; }
+    const Target& target_at(NonzeroHeight h) const;
+
+private:
+    struct TargetRun {
+        uint32_t begin; // index of the first height with this target
+        Target target;
+    };
+    Height offset { 0 };
+    std::vector<double> work;
+    std::vector<uint32_t> timestamps;
+    std::vector<TargetRun> targets;
 };
 
 class Grid : public Headervec {
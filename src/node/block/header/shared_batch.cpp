@@ -1,4 +1,5 @@
 #include "block/chain/consensus_headers.hpp"
+#include "general/memory_budget.hpp"
 
 SharedBatch::~SharedBatch()
 {
@@ -84,14 +85,16 @@ SharedBatch BatchRegistry::share(Batch&& headerbatch, const SharedBatch& prev, W
     auto iter = headers.find(key);
     if (iter == headers.end()) {
         // check prevalid
-        return headers.try_emplace(
-                          key,
-                          *this, std::move(headerbatch), totalWork, SharedBatch(prev.data.iter))
-            .first;
+        auto& node { *headers.try_emplace(
+                              key,
+                              *this, std::move(headerbatch), totalWork, SharedBatch(prev.data.iter))
+                         .first };
+        report_usage();
+        return &node;
     } else {
         assert(headerbatch == iter->second.batch);
         assert(totalWork == iter->second.totalWork);
-        return SharedBatch(iter);
+        return SharedBatch(&*iter);
     }
 }
 
@@ -101,7 +104,7 @@ SharedBatchView BatchRegistry::find_last_template(const T& t)
     Batchslot a(0);
     Batchslot b(t.slot_end());
     Batchslot c(a);
-    Maptype::iterator a_iter;
+    Maptype::value_type* a_iter { nullptr };
     while (true) {
         if (b == Batchslot(0))
             return {};
@@ -111,7 +114,7 @@ SharedBatchView BatchRegistry::find_last_template(const T& t)
             b = c;
         else {
             a = c;
-            a_iter = iter;
+            a_iter = &*iter;
         }
         if (b - a == 1) {
             return SharedBatchView(a_iter);
@@ -140,11 +143,20 @@ void BatchRegistry::dec_ref(SharedBatch::iter_type iter)
             break;
         auto tmp = nd.prev.data;
         nd.prev.data.raw = 0;
-        headers.erase(iter);
+        const auto key { iter->first };
+        headers.erase(key);
         if (tmp.raw == 0)
             break;
         iter = tmp.iter;
     }
+    report_usage();
+}
+
+void BatchRegistry::report_usage()
+{
+    // shared by all chains, not evictable
+    static auto& c { memory_budget::component("header_batches", 0) };
+    c.set_usage(headers.size() * HEADERBATCHSIZE * 80);
 }
 
 bool BatchRegistry::verify(SharedBatchView v, const SignedSnapshot& ss)
@@ -168,7 +180,7 @@ std::optional<Hash> Nodedata::hash_at(NonzeroHeight h)
 {
     auto uh { upper_height() };
     if (uh == h) {
-        return batch.get_header(h - lower_height()).value().hash();
+        return header_hash(h - lower_height());
     }
     auto h1 { h + 1 };
     auto pnode = this;
@@ -185,3 +197,14 @@ std::optional<Hash> Nodedata::hash_at(NonzeroHeight h)
         assert(uh == lh);
     }
 }
+
+Hash Nodedata::header_hash(size_t id) const
+{
+    assert(id < batch.size());
+    if (id + 1 < batch.size())
+        return Hash { batch[id + 1].prevhash() };
+    std::unique_lock l(hashMutex);
+    if (!lastHash)
+        lastHash = batch[id].hash();
+    return *lastHash;
+}
@@ -2,15 +2,40 @@
 #include "batch.hpp"
 #include "block/chain/worksum.hpp"
 #include <mutex>
+#include <unordered_map>
 
 class BatchRegistry;
 struct Nodedata;
 class HeaderVerifier;
 class SignedSnapshot;
+
+// Registry keys are batch-end headers. Their merkle roots are uniformly
+// distributed, a slice of them is a sufficient hash.
+struct BatchKeyHasher {
+    using arr80 = std::array<uint8_t, 80>;
+    using is_transparent = std::true_type;
+    size_t operator()(const arr80& arr) const { return hash(arr.data()); }
+    size_t operator()(HeaderView hv) const { return hash(hv.data()); }
+
+private:
+    static size_t hash(const uint8_t* p)
+    {
+        size_t h;
+        memcpy(&h, p + HeaderView::offset_merkleroot, sizeof(h));
+        return h;
+    }
+};
+struct BatchKeyEqual {
+    using arr80 = std::array<uint8_t, 80>;
+    using is_transparent = std::true_type;
+    bool operator()(const arr80& a1, const arr80& a2) const { return a1 == a2; }
+    bool operator()(const arr80& arr, HeaderView hv) const { return memcmp(arr.data(), hv.data(), 80) == 0; }
+    bool operator()(HeaderView hv, const arr80& arr) const { return memcmp(hv.data(), arr.data(), 80) == 0; }
+};
 class SharedBatchView {
     friend class BatchRegistry;
-    using Maptype = std::map<std::array<uint8_t, 80>, Nodedata, HeaderView::HeaderComparator>;
-    using iter_type = Maptype::iterator;
+    using Maptype = std::unordered_map<std::array<uint8_t, 80>, Nodedata, BatchKeyHasher, BatchKeyEqual>;
+    using iter_type = Maptype::value_type*; // stable across rehashes
     friend class SharedBatch;
 
 public:
@@ -22,8 +47,11 @@ public:
     Height lower_height() const;
     std::optional<Batchslot> slot() const;
     std::optional<HeaderView> getHeader(size_t id) const;
+    Hash header_hash(size_t id) const;
     const Batch& getBatch() const;
     Worksum total_work() const;
+    Worksum total_work_at(Height h) const;
+    const WorkSeries& work_series() const;
     bool operator==(const SharedBatchView& rhs) const;
 
 private:
@@ -36,8 +64,8 @@ private:
 };
 
 class SharedBatch {
-    using Maptype = std::map<std::array<uint8_t, 80>, Nodedata, HeaderView::HeaderComparator>;
-    using iter_type = Maptype::iterator;
+    using Maptype = std::unordered_map<std::array<uint8_t, 80>, Nodedata, BatchKeyHasher, BatchKeyEqual>;
+    using iter_type = Maptype::value_type*; // stable across rehashes
     friend struct Nodedata;
 
 
@@ -61,8 +89,11 @@ public:
     Height lower_height() const { return view().lower_height(); }
     std::optional<HeaderView> getHeader(size_t id) const { return view().getHeader(id); }
     [[nodiscard]] HeaderView operator[](Height h) const { return getHeader(h - lower_height()).value(); }
+    [[nodiscard]] Hash hash(Height h) const { return view().header_hash(h - lower_height()); }
     const Batch& getBatch() const { return view().getBatch(); }
     const Worksum total_work() const { return view().total_work(); }
+    Worksum total_work_at(Height h) const { return view().total_work_at(h); }
+    const WorkSeries& work_series() const { return view().work_series(); }
     HeaderVerifier verifier() const;
     const SharedBatch& prev() const;
     bool valid() const { return view().valid(); }
@@ -88,10 +119,14 @@ struct Nodedata {
         , totalWork(totalWork)
         , prev(std::move(parent))
         , slot { prev.valid() ? prev.slot().value() + 1 : Batchslot(0) }
+        , work(batch, slot.offset(), prev.total_work())
+        , series(batch, work, slot.offset())
     {
+        assert(work.total() == totalWork);
     }
     ~Nodedata();
     std::optional<Hash> hash_at(NonzeroHeight);
+    Hash header_hash(size_t id) const;
     Height upper_height() const
     {
         return slot.upper();
@@ -106,6 +141,14 @@ struct Nodedata {
     Worksum totalWork;
     SharedBatch prev;
     Batchslot slot;
+    WorkPrefix work;
+    WorkSeries series;
+
+private:
+    // Every header but the last stores the hash of its predecessor, only
+    // the last one is hashed, at most once.
+    mutable std::mutex hashMutex;
+    mutable std::optional<Hash> lastHash;
 };
 
 inline bool SharedBatchView::operator==(const SharedBatchView& rhs) const
@@ -125,6 +168,12 @@ inline std::optional<HeaderView> SharedBatchView::getHeader(size_t id) const
     return {};
 }
 
+inline Hash SharedBatchView::header_hash(size_t id) const
+{
+    assert(valid());
+    return data.iter->second.header_hash(id);
+}
+
 inline std::optional<Batchslot> SharedBatchView::slot() const
 {
     if (valid()) {
@@ -142,6 +191,16 @@ inline Worksum SharedBatchView::total_work() const
 {
     return (valid() ? data.iter->second.totalWork : Worksum {});
 }
+inline Worksum SharedBatchView::total_work_at(Height h) const
+{
+    assert(valid());
+    return data.iter->second.work.at(h);
+}
+inline const WorkSeries& SharedBatchView::work_series() const
+{
+    assert(valid());
+    return data.iter->second.series;
+}
 inline Height SharedBatchView::upper_height() const
 {
     if (valid())
@@ -164,7 +223,7 @@ inline const SharedBatch& SharedBatch::prev() const
 
 class BatchRegistry {
     friend class SharedBatch;
-    using Maptype = std::map<std::array<uint8_t, 80>, Nodedata, HeaderView::HeaderComparator>;
+    using Maptype = SharedBatchView::Maptype;
 
 public:
     ~BatchRegistry()
@@ -181,6 +240,7 @@ private: // private methods
     SharedBatchView find_last_template(const T& batches);
     void dec_ref(SharedBatch::iter_type iter);
     bool verify(SharedBatchView, const SignedSnapshot&);
+    void report_usage(); // m must be held
 
 private: // private data
     std::recursive_mutex m;
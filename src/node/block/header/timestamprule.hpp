@@ -1,5 +1,6 @@
 #pragma once
 #include "general/params.hpp"
+#include <algorithm>
 #include <array>
 #include <cstddef>
 
@@ -12,8 +13,8 @@ public:
     void clear()
     {
         tmax = 0;
-        for (size_t i = 0; i < N; ++i)
-            data[i] = 0;
+        data.fill(0);
+        sorted.fill(0);
     }
     bool valid(const uint64_t tnew) const
     {
@@ -24,24 +25,15 @@ public:
         if (tnew + TOLERANCEMINUTES * 60 < tmax)
             return false;
 
-        // check median rule
-        size_t n = 0;
-        for (auto t : data) {
-            constexpr size_t bound = N / 2;
-            if (tnew >= t) {
-                n += 1;
-                if (n > bound) {
-                    return true;
-                }
-            }
-        }
-        return false;
+        // median rule: more than N/2 of the window are not above tnew
+        return tnew >= sorted[N / 2];
     }
     uint32_t get_valid_timestamp() const;
     void append(uint64_t tnew)
     {
         if (tmax > tnew)
             tmax = tnew;
+        sorted_replace(data[pos], tnew);
         data[pos++] = tnew;
         if (pos >= N)
             pos = 0;
@@ -50,7 +42,23 @@ public:
     static constexpr uint32_t N = MEDIAN_N;
 
 private:
+    // binary searches and a shift between the two positions
+    void sorted_replace(uint64_t evicted, uint64_t tnew)
+    {
+        auto from { std::lower_bound(sorted.begin(), sorted.end(), evicted) };
+        if (tnew >= evicted) {
+            auto to { std::upper_bound(from, sorted.end(), tnew) };
+            std::move(from + 1, to, from);
+            *(to - 1) = tnew;
+        } else {
+            auto to { std::upper_bound(sorted.begin(), from, tnew) };
+            std::move_backward(to, from, from + 1);
+            *to = tnew;
+        }
+    }
+
     size_t pos = 0;
     uint64_t tmax = 0;
-    std::array<uint64_t, N> data;
+    std::array<uint64_t, N> data {}; // ring buffer in append order
+    std::array<uint64_t, N> sorted {}; // same values in ascending order
 };
@@ -0,0 +1,59 @@
+// Export and import of state snapshots to bootstrap new nodes without
+// replaying the chain from genesis. The imported database contains the
+// chain state at the signed snapshot height, wart-node then syncs the
+// remaining blocks from its peers.
+//
+// usage: wart-bootstrap export <chaindb> <snapshotfile> [--prune-history]
+//        wart-bootstrap import <snapshotfile> <newchaindb>
+#include "crypto/crypto.hpp"
+#include "db/chain_db.hpp"
+#include "general/errors.hpp"
+#include "spdlog/spdlog.h"
+#include <filesystem>
+#include <iostream>
+
+namespace {
+struct ECC {
+    ECC() { ECC_Start(); }
+    ~ECC() { ECC_Stop(); }
+};
+
+int usage()
+{
+    std::cerr << "usage: wart-bootstrap export <chaindb> <snapshotfile> [--prune-history]\n"
+                 "       wart-bootstrap import <snapshotfile> <newchaindb>\n";
+    return 1;
+}
+}
+
+int main(int argc, char** argv)
+{
+    ECC ecc;
+    if (argc < 4)
+        return usage();
+    const std::string mode { argv[1] };
+    try {
+        if (mode == "export") {
+            const bool prune { argc > 4 && std::string(argv[4]) == "--prune-history" };
+            ChainDB db(argv[2]);
+            db.export_state_snapshot(argv[3], prune);
+            return 0;
+        }
+        if (mode == "import") {
+            if (std::filesystem::exists(argv[3])) {
+                spdlog::error("{} already exists", argv[3]);
+                return 1;
+            }
+            ChainDB db(argv[3], SQLiteProfile::Sync);
+            db.import_state_snapshot(argv[2]);
+            return 0;
+        }
+    } catch (std::exception& e) {
+        spdlog::error("{}", e.what());
+        return 1;
+    } catch (Error& e) {
+        spdlog::error("{}", e.strerror());
+        return 1;
+    }
+    return usage();
+}
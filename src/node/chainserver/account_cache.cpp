@@ -1,6 +1,6 @@
 #include "account_cache.hpp"
-#include "db/chain_db.hpp"
-#include "general/address_funds.hpp"
+#include "general/memory_budget.hpp"
+#include <cassert>
 
 namespace chainserver {
 const AddressFunds& AccountCache::operator[](AccountId id)
@@ -8,8 +8,93 @@ const AddressFunds& AccountCache::operator[](AccountId id)
     auto iter = map.find(id);
     if (iter != map.end())
         return iter->second;
-    auto p = db.fetch_account(id);
+    auto p = fetch(id);
     return map.emplace(id, p).first->second;
 }
 
+void PersistentAccountCache::touch(std::list<AccountId>::iterator iter)
+{
+    lru.splice(lru.begin(), lru, iter);
+}
+
+std::optional<AddressFunds> PersistentAccountCache::lookup(AccountId id)
+{
+    auto iter = byId.find(id);
+    if (iter == byId.end())
+        return {};
+    touch(iter->second.lruIter);
+    return iter->second.addressFunds;
+}
+
+std::optional<std::tuple<AccountId, Funds>> PersistentAccountCache::lookup(const AddressView address)
+{
+    auto iter = byAddress.find(Address(address));
+    if (iter == byAddress.end())
+        return {};
+    auto& e { byId.at(iter->second) };
+    touch(e.lruIter);
+    return std::tuple<AccountId, Funds> { iter->second, e.addressFunds.funds };
+}
+
+namespace {
+// entry with its lru node and both map nodes
+constexpr size_t approxEntryBytes = 256;
+memory_budget::Component& budget()
+{
+    static auto& c { memory_budget::component("account_cache", 2, 10000 * approxEntryBytes) };
+    return c;
+}
+}
+
+void PersistentAccountCache::insert(AccountId id, const AddressFunds& af)
+{
+    if (maxSize == 0)
+        return;
+    auto iter = byId.find(id);
+    if (iter != byId.end()) {
+        assert(iter->second.addressFunds.address == af.address);
+        iter->second.addressFunds = af;
+        touch(iter->second.lruIter);
+        return;
+    }
+    // the budget may have shrunk below the current size
+    while (!byId.empty() && byId.size() >= budget().max_entries(approxEntryBytes, maxSize)) {
+        auto evictId { lru.back() };
+        auto evictIter { byId.find(evictId) };
+        byAddress.erase(evictIter->second.addressFunds.address);
+        byId.erase(evictIter);
+        lru.pop_back();
+    }
+    lru.push_front(id);
+    byId.emplace(id, Entry { af, lru.begin() });
+    byAddress.emplace(af.address, id);
+    budget().set_usage(byId.size() * approxEntryBytes);
+}
+
+void PersistentAccountCache::set_balance(AccountId id, Funds balance)
+{
+    auto iter = byId.find(id);
+    if (iter != byId.end())
+        iter->second.addressFunds.funds = balance;
+}
+
+void PersistentAccountCache::erase_from(AccountId id)
+{
+    auto iter { byId.lower_bound(id) };
+    while (iter != byId.end()) {
+        byAddress.erase(iter->second.addressFunds.address);
+        lru.erase(iter->second.lruIter);
+        iter = byId.erase(iter);
+    }
+    budget().set_usage(byId.size() * approxEntryBytes);
+}
+
+void PersistentAccountCache::clear()
+{
+    lru.clear();
+    byId.clear();
+    byAddress.clear();
+    budget().set_usage(0);
+}
+
 }
@@ -1,12 +1,15 @@
 #pragma once
 #include "block/body/account_id.hpp"
-#include<map>
-class ChainDB;
-class AddressFunds;
+#include "general/address_funds.hpp"
+#include <functional>
+#include <list>
+#include <map>
+#include <optional>
 namespace chainserver {
 struct AccountCache {
-    AccountCache(const ChainDB& db)
-        : db(db)
+    template <typename DB> // ChainDB or ChainDBReader
+    AccountCache(const DB& db)
+        : fetch([&db](AccountId id) { return db.fetch_account(id); })
     {
     }
 
@@ -15,6 +18,38 @@ public:
 
 private:
     std::map<AccountId, AddressFunds> map;
-    const ChainDB& db;
+    std::function<AddressFunds(AccountId)> fetch;
+};
+
+// Long-lived bounded LRU cache of the State table, owned by ChainDB.
+// It is write-through: ChainDB updates it on every State modification
+// and clears it when a ChainDBTransaction is rolled back.
+class PersistentAccountCache {
+public:
+    PersistentAccountCache(size_t maxSize = 100000)
+        : maxSize(maxSize)
+    {
+    }
+
+    [[nodiscard]] std::optional<AddressFunds> lookup(AccountId id);
+    [[nodiscard]] std::optional<std::tuple<AccountId, Funds>> lookup(const AddressView address);
+    void insert(AccountId id, const AddressFunds& af);
+    void set_balance(AccountId id, Funds balance);
+    void erase_from(AccountId id);
+    void clear();
+    size_t size() const { return byId.size(); }
+
+private:
+    void touch(std::list<AccountId>::iterator);
+
+private:
+    struct Entry {
+        AddressFunds addressFunds;
+        std::list<AccountId>::iterator lruIter;
+    };
+    size_t maxSize;
+    std::list<AccountId> lru; // front is most recently used
+    std::map<AccountId, Entry> byId;
+    std::map<Address, AccountId> byAddress;
 };
 }
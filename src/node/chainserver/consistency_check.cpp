@@ -0,0 +1,208 @@
+#include "consistency_check.hpp"
+#include "db/chain_db_reader.hpp"
+#include "general/hex.hpp"
+#include "general/metrics.hpp"
+#include "general/task_pool.hpp"
+#include "general/thread_settings.hpp"
+#include "general/trace.hpp"
+#include "global/globals.hpp"
+#include "spdlog/spdlog.h"
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+namespace chainserver {
+namespace {
+    using namespace std::chrono;
+    constexpr auto startDelay { seconds(30) }; // let startup and sync settle first
+    constexpr auto slicePause { milliseconds(100) };
+    constexpr auto retryPause { seconds(10) };
+    constexpr auto auditInterval { minutes(10) };
+    constexpr size_t sliceBatches { 4 };
+    constexpr size_t auditAccounts { 16 };
+    constexpr size_t auditMaxEntries { 100000 }; // skip accounts with longer history
+
+    metrics::Counter& errors()
+    {
+        static auto& c { metrics::counter("warthog_consistency_errors_total",
+            "Number of inconsistencies found by the background chain database verification") };
+        return c;
+    }
+
+    // returns an error description, empty if the batch is consistent
+    std::string check_batch(const std::vector<SharedBatchView>& cb, size_t k, const std::vector<Hash>& stored)
+    {
+        const Batch& b { cb[k].getBatch() };
+        const Height offset(uint32_t(k * HEADERBATCHSIZE));
+        if (!b.complete() || !b.valid_inner_links())
+            return "broken header links";
+        if (k > 0 && b.first().prevhash() != cb[k - 1].getBatch().last().hash())
+            return "header batch does not link to its predecessor";
+        const Worksum prev { k > 0 ? cb[k - 1].total_work() : Worksum() };
+        if (prev + b.worksum(offset) != cb[k].total_work())
+            return "stored worksum does not match the headers";
+        // inner links are verified, so consecutive prevhashes are the hashes
+        for (size_t i = 0; i + 1 < HEADERBATCHSIZE; ++i)
+            if (stored[i] != b[i + 1].prevhash())
+                return "consensus block at height " + std::to_string(offset.value() + i + 1) + " does not match the header";
+        if (stored.back() != b.last().hash())
+            return "consensus block at height " + std::to_string(offset.value() + HEADERBATCHSIZE) + " does not match the header";
+        return {};
+    }
+}
+
+ConsistencyCheck::ConsistencyCheck(const std::string& dbPath, HeadersFn headers)
+    : cursorPath(dbPath + ".verified")
+    , headers(std::move(headers))
+    , reader(std::make_unique<ChainDBReader>(dbPath))
+{
+    if (auto c { load_cursor() })
+        cursor = *c;
+    thread = std::thread(&ConsistencyCheck::work, this);
+}
+
+ConsistencyCheck::~ConsistencyCheck()
+{
+    {
+        std::unique_lock l(m);
+        closing = true;
+    }
+    cv.notify_all();
+    thread.join();
+}
+
+bool ConsistencyCheck::wait(milliseconds d)
+{
+    std::unique_lock l(m);
+    return cv.wait_for(l, d, [&]() { return closing; });
+}
+
+void ConsistencyCheck::report(const std::string& msg)
+{
+    spdlog::error("Chain database inconsistency: {}", msg);
+    errors().inc();
+}
+
+void ConsistencyCheck::work()
+{
+    trace::set_thread_name("verifier");
+    apply_thread_settings(config().threads.verifier, "verifier");
+    if (wait(startDelay))
+        return;
+    bool logged { false };
+    while (true) {
+        milliseconds pause { slicePause };
+        try {
+            const Headerchain hc { headers() };
+            const auto& cb { hc.complete_batches() };
+            if (cursor.batches > cb.size()
+                || (cursor.batches > 0 && cb[cursor.batches - 1].getBatch().last().hash() != cursor.hash)) {
+                spdlog::info("Chain was rolled back below the verified headers, restarting verification");
+                cursor = {};
+                logged = false;
+            }
+            if (cursor.batches < cb.size()) {
+                const size_t end { std::min(cb.size(), cursor.batches + sliceBatches) };
+                if (verify_slice(hc, cursor.batches, end)) {
+                    cursor = { end, cb[end - 1].getBatch().last().hash() };
+                    save_cursor();
+                } else
+                    pause = retryPause;
+            } else {
+                if (!logged) {
+                    spdlog::info("Verified {} header batches of the chain database", cursor.batches);
+                    logged = true;
+                }
+                audit_balances();
+                pause = auditInterval;
+            }
+        } catch (std::exception& e) {
+            spdlog::warn("Chain database verification failed: {}", e.what());
+            pause = retryPause;
+        }
+        if (wait(pause))
+            return;
+    }
+}
+
+bool ConsistencyCheck::verify_slice(const Headerchain& hc, size_t begin, size_t end)
+{
+    const auto& cb { hc.complete_batches() };
+    const size_t n { end - begin };
+    std::vector<std::vector<Hash>> stored(n);
+    for (size_t i = 0; i < n; ++i) {
+        const uint32_t lower(uint32_t((begin + i) * HEADERBATCHSIZE + 1));
+        stored[i] = reader->consensus_hashes(NonzeroHeight(lower), NonzeroHeight(lower + HEADERBATCHSIZE));
+        if (stored[i].size() != HEADERBATCHSIZE)
+            return false; // not committed yet
+    }
+
+    std::vector<std::string> errs(n);
+    task_pool().parallel_for(n, [&](size_t i) {
+        errs[i] = check_batch(cb, begin + i, stored[i]);
+    });
+
+    std::optional<Headerchain> current;
+    for (size_t i = 0; i < n; ++i) {
+        if (errs[i].empty())
+            continue;
+        // tell corruption from a fork written between the header snapshot
+        // and the database read
+        if (!current)
+            current = headers();
+        const auto& ccb { current->complete_batches() };
+        if (ccb.size() <= begin + i || !(ccb[begin + i] == cb[begin + i]))
+            return false;
+        report(errs[i]);
+    }
+    return true;
+}
+
+void ConsistencyCheck::audit_balances()
+{
+    const AccountId maxId { reader->max_account_id() };
+    if (maxId.value() == 0)
+        return;
+    std::mt19937_64 rng { std::random_device {}() };
+    std::uniform_int_distribution<uint64_t> dist(1, maxId.value());
+    for (size_t i = 0; i < auditAccounts; ++i) {
+        const AccountId id { dist(rng) };
+        auto a { reader->audit_balance(id, auditMaxEntries) };
+        if (a && a->first != a->second)
+            report("balance " + a->first.to_string() + " of account " + std::to_string(id.value())
+                + " does not match its history sum " + a->second.to_string());
+    }
+}
+
+auto ConsistencyCheck::load_cursor() const -> std::optional<Cursor>
+{
+    std::ifstream f(cursorPath);
+    size_t batches;
+    std::string hex;
+    if (!(f >> batches >> hex))
+        return {};
+    Cursor c { batches, {} };
+    if (!parse_hex(hex, c.hash))
+        return {};
+    return c;
+}
+
+void ConsistencyCheck::save_cursor() const
+{
+    // write to temporary file first such that the cursor is never partial
+    const auto tmp { cursorPath + ".tmp" };
+    {
+        std::ofstream f(tmp, std::ios::trunc);
+        f << cursor.batches << ' ' << serialize_hex(cursor.hash) << '\n';
+        f.flush();
+        if (!f.good()) {
+            spdlog::warn("Cannot write verification cursor to {}", tmp);
+            return;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, cursorPath, ec);
+    if (ec)
+        spdlog::warn("Cannot write verification cursor to {}: {}", cursorPath, ec.message());
+}
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include "block/chain/header_chain.hpp"
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+class ChainDBReader;
+namespace chainserver {
+
+// Background verification of the chain database (config db.verify) such
+// that startup can trust the loaded headers, worksums and balances without
+// a long serial pass. Runs on its own low priority thread (config
+// threads.verifier) with its own read-only connection:
+//
+// - complete header batches are checked slice by slice on the task pool:
+//   inner links, link to the previous batch, worksum and the block hashes
+//   stored in the consensus table,
+// - the number of verified batches is persisted next to the chain database
+//   in "<chaindb>.verified" together with the hash of the last verified
+//   header, verification resumes there after restarts unless the chain
+//   was rolled back below,
+// - once all batches are verified, balances of random accounts are
+//   compared against the sum of their history from time to time.
+//
+// Inconsistencies are logged and counted in warthog_consistency_errors_total.
+class ConsistencyCheck {
+public:
+    // returns a snapshot of the current consensus headers
+    using HeadersFn = std::function<Headerchain()>;
+    ConsistencyCheck(const std::string& dbPath, HeadersFn headers);
+    ConsistencyCheck(const ConsistencyCheck&) = delete;
+    ~ConsistencyCheck();
+
+private:
+    struct Cursor {
+        size_t batches { 0 };
+        Hash hash; // of the last verified header
+    };
+    void work();
+    // returns whether the slice could be verified completely
+    bool verify_slice(const Headerchain&, size_t begin, size_t end);
+    void audit_balances();
+    std::optional<Cursor> load_cursor() const;
+    void save_cursor() const;
+    void report(const std::string& msg);
+    bool wait(std::chrono::milliseconds);
+
+private:
+    const std::string cursorPath;
+    const HeadersFn headers;
+    std::unique_ptr<ChainDBReader> reader;
+    Cursor cursor;
+
+    std::mutex m;
+    std::condition_variable cv;
+    bool closing { false };
+    std::thread thread;
+};
+}
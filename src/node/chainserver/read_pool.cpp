@@ -0,0 +1,44 @@
+#include "read_pool.hpp"
+#include "db/chain_db_reader.hpp"
+
+namespace chainserver {
+ReadPool::ReadPool(const std::string& dbPath, size_t nConnections)
+{
+    for (size_t i = 0; i < nConnections; ++i)
+        readers.push_back(std::make_unique<ChainDBReader>(dbPath));
+    for (auto& r : readers)
+        threads.emplace_back(&ReadPool::work, this, std::ref(*r));
+}
+
+ReadPool::~ReadPool()
+{
+    {
+        std::unique_lock l(m);
+        closing = true;
+    }
+    cv.notify_all();
+    for (auto& t : threads)
+        t.join();
+}
+
+void ReadPool::async(Job job)
+{
+    std::unique_lock l(m);
+    jobs.push(std::move(job));
+    cv.notify_one();
+}
+
+void ReadPool::work(ChainDBReader& reader)
+{
+    while (true) {
+        std::unique_lock l(m);
+        cv.wait(l, [&]() { return closing || !jobs.empty(); });
+        if (closing)
+            return;
+        auto job { std::move(jobs.front()) };
+        jobs.pop();
+        l.unlock();
+        job(reader);
+    }
+}
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+class ChainDBReader;
+namespace chainserver {
+
+// Threads with one read-only chain database connection each,
+// API read queries are run here instead of the chainserver thread.
+class ReadPool {
+public:
+    using Job = std::function<void(ChainDBReader&)>;
+    ReadPool(const std::string& dbPath, size_t nConnections);
+    ReadPool(const ReadPool&) = delete;
+    ~ReadPool();
+
+    void async(Job job);
+
+private:
+    void work(ChainDBReader& reader);
+
+private:
+    std::mutex m;
+    std::condition_variable cv;
+    std::queue<Job> jobs;
+    bool closing { false };
+    std::vector<std::unique_ptr<ChainDBReader>> readers;
+    std::vector<std::thread> threads;
+};
+}
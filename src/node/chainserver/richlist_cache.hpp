@@ -0,0 +1,30 @@
+#pragma once
+#include "api/types/all.hpp"
+#include <mutex>
+
+namespace chainserver {
+// Caches the richlist for the current chain head. Balances only change
+// when the head changes (append, fork, rollback), so the head hash is
+// an exact cache key.
+class RichlistCache {
+public:
+    template <typename Lookup>
+    API::Richlist get(const Hash& head, Lookup&& lookup)
+    {
+        std::unique_lock l(m);
+        if (!cached || cachedHead != head) {
+            l.unlock();
+            auto richlist { lookup() };
+            l.lock();
+            cachedHead = head;
+            cached = std::move(richlist);
+        }
+        return *cached;
+    }
+
+private:
+    std::mutex m;
+    Hash cachedHead;
+    std::optional<API::Richlist> cached;
+};
+}
@@ -1,10 +1,27 @@
 #include "server.hpp"
+#include "api/http/endpoint.hpp"
+#include "api/stratum/server.hpp"
 #include "api/types/all.hpp"
 #include "block/header/header_impl.hpp"
+#include "db/chain_db_reader.hpp"
 #include "eventloop/eventloop.hpp"
+#include "general/block_latency.hpp"
 #include "general/hex.hpp"
+#include "general/metrics.hpp"
+#include "general/thread_settings.hpp"
+#include "general/trace.hpp"
 #include "global/globals.hpp"
+#include "mempool/dump.hpp"
 #include "spdlog/spdlog.h"
+#include "state/api_reads.hpp"
+
+template <typename T>
+tl::expected<T, int32_t> noval_to_err(std::optional<T>&& v)
+{
+    if (v)
+        return *v;
+    return tl::make_unexpected(ENOTFOUND);
+}
 
 bool ChainServer::is_busy()
 
@@ -18,7 +35,7 @@ Batch ChainServer::get_headers(BatchSelector selector)
     return state.get_headers_concurrent(selector);
 }
 
-std::optional<HeaderView> ChainServer::get_descriptor_header(Descriptor descriptor, Height height)
+std::optional<Header> ChainServer::get_descriptor_header(Descriptor descriptor, Height height)
 {
     return state.get_header_concurrent(descriptor, height);
 }
@@ -28,11 +45,18 @@ ConsensusSlave ChainServer::get_chainstate()
     return state.get_chainstate_concurrent();
 }
 
-ChainServer::ChainServer(ChainDB& db, BatchRegistry& br, std::optional<SnapshotSigner> snapshotSigner)
+ChainServer::ChainServer(ChainDB& db, BatchRegistry& br, std::optional<SnapshotSigner> snapshotSigner, size_t apiReadConnections)
     : db(db)
     , batchRegistry(br)
     , state(db, br, snapshotSigner)
-{
+    , readPool(db.path(), apiReadConnections)
+{
+    state.set_publisher([this](chainserver::state_update::StateUpdate&& u) {
+        global().pel->async_state_update(std::move(u));
+        notify_mining();
+    });
+    if (config().data.verify)
+        consistencyCheck.emplace(db.path(), [this]() { return state.get_chainstate_concurrent().headers(); });
     worker = std::thread(&ChainServer::workerfun, this);
 }
 
@@ -46,6 +70,11 @@ void ChainServer::api_mining_append(Block&& block, ResultCb callback)
     defer_maybe_busy(MiningAppend { std::move(block), std::move(callback) });
 }
 
+void ChainServer::async_append_pushed(Block&& block, ResultCb callback)
+{
+    defer_maybe_busy(MiningAppend { std::move(block), std::move(callback), true });
+}
+
 void ChainServer::async_set_synced(bool synced)
 {
     spdlog::debug("Set synced {}", synced);
@@ -57,15 +86,45 @@ void ChainServer::async_put_mempool(std::vector<TransferTxExchangeMessage> txs)
     defer(PutMempoolBatch { std::move(txs) });
 }
 
+std::string ChainServer::mempool_path() const
+{
+    return db.path() + ".mempool";
+}
+
+void ChainServer::restore_mempool()
+{
+    // transactions pinned outside the window are rejected before their
+    // signatures are recovered
+    auto txs { mempool::load_dump(mempool_path()) };
+    if (txs.size() > 0) {
+        spdlog::info("Restoring {} mempool transactions", txs.size());
+        async_put_mempool(std::move(txs));
+    }
+}
+
 void ChainServer::api_put_mempool(PaymentCreateMessage m,
     ResultCb callback)
 {
     defer_maybe_busy(PutMempool { std::move(m), std::move(callback) });
 }
 
+void ChainServer::api_put_mempool_batch(API::PaymentCreateBatch b, MempoolInsertCb callback)
+{
+    defer_maybe_busy(PutMempoolPayments { std::move(b), std::move(callback) });
+}
+
 void ChainServer::api_get_balance(const Address& a, BalanceCb callback)
 {
-    defer_maybe_busy(GetBalance { a, std::move(callback) });
+    readPool.async([a, callback = std::move(callback)](ChainDBReader& r) {
+        callback(chainserver::api_reads::balance(r, a));
+    });
+}
+
+void ChainServer::api_get_balances(API::BalancesRequest req, BalancesCb callback)
+{
+    readPool.async([req = std::move(req), callback = std::move(callback)](ChainDBReader& r) {
+        callback(r.lookup_balances(req));
+    });
 }
 
 void ChainServer::api_get_grid(GridCb callback)
@@ -73,9 +132,16 @@ void ChainServer::api_get_grid(GridCb callback)
     defer_maybe_busy(GetGrid { std::move(callback) });
 }
 
-void ChainServer::api_get_mempool(MempoolCb callback)
+void ChainServer::api_get_mempool(size_t offset, uint32_t limit, std::optional<Address> address, MempoolCb callback)
+{
+    if (limit == 0 || limit > API::MempoolPage::MAXLIMIT)
+        return callback(tl::make_unexpected(EPAGESIZE));
+    defer_maybe_busy(GetMempool { offset, limit, std::move(address), std::move(callback) });
+}
+
+void ChainServer::api_get_fee_estimate(FeeEstimateCb callback)
 {
-    defer_maybe_busy(GetMempool { std::move(callback) });
+    defer_maybe_busy(GetFeeEstimate { std::move(callback) });
 }
 
 void ChainServer::api_lookup_tx(const HashView hash,
@@ -83,6 +149,10 @@ void ChainServer::api_lookup_tx(const HashView hash,
 {
     defer_maybe_busy(LookupTxHash { hash, std::move(callback) });
 }
+void ChainServer::api_lookup_tx_proof(std::variant<Hash, HistoryId> id, TxProofCb callback)
+{
+    defer_maybe_busy(LookupTxProof { std::move(id), std::move(callback) });
+}
 void ChainServer::api_lookup_latest_txs(LatestTxsCb callback)
 {
     defer_maybe_busy(LookupLatestTxs { std::move(callback) });
@@ -94,14 +164,46 @@ void ChainServer::async_get_head(HeadCb callback)
 }
 
 void ChainServer::api_get_history(const Address& address, uint64_t beforeId,
-    HistoryCb callback)
+    uint32_t limit, HistoryCb callback)
+{
+    if (limit == 0 || limit > API::AccountHistory::MAXLIMIT)
+        return callback(tl::make_unexpected(EPAGESIZE));
+    readPool.async([this, address, beforeId, limit, callback = std::move(callback)](ChainDBReader& r) {
+        auto history { state.read_chainstate_concurrent([&](const chainserver::Chainstate& cs, Height committed) {
+            return chainserver::api_reads::history(r, cs, committed, address, beforeId, limit);
+        }) };
+        callback(noval_to_err(std::move(history)));
+    });
+}
+
+void ChainServer::api_get_history_export(const Address& address, uint64_t afterId, HistoryExportCb callback)
 {
-    defer_maybe_busy(GetHistory { address, beforeId, std::move(callback) });
+    readPool.async([this, address, afterId, callback = std::move(callback)](ChainDBReader& r) {
+        auto chunk { state.read_chainstate_concurrent([&](const chainserver::Chainstate& cs, Height committed) {
+            return chainserver::api_reads::history_export(r, cs, committed, address, afterId);
+        }) };
+        callback(noval_to_err(std::move(chunk)));
+    });
 }
 
 void ChainServer::api_get_richlist(RichlistCb callback)
 {
-    defer_maybe_busy(GetRichlist { std::move(callback) });
+    readPool.async([this, callback = std::move(callback)](ChainDBReader& r) {
+        auto richlist { state.read_chainstate_concurrent([&](const chainserver::Chainstate& cs, Height committed) {
+            // keyed by the committed head, the chainstate can be ahead
+            const Hash head { committed < cs.length() ? cs.headers().get_hash(committed).value() : Hash(cs.final_hash()) };
+            return richlistCache.get(head, [&]() { return r.lookup_richlist(100); });
+        }) };
+        callback(richlist);
+    });
+}
+void ChainServer::api_get_chain_stats(uint32_t from, uint32_t to, uint32_t bucketSeconds, ChainStatsCb callback)
+{
+    if (bucketSeconds == 0 || to <= from || (to - from - 1) / bucketSeconds >= API::ChainStats::MAXBUCKETS)
+        return callback(tl::make_unexpected(ESTATSRANGE));
+    readPool.async([from, to, bucketSeconds, callback = std::move(callback)](ChainDBReader& r) {
+        callback(r.lookup_chain_stats(from, to, bucketSeconds));
+    });
 }
 void ChainServer::api_get_mining(const Address& address, bool log, MiningCb callback)
 {
@@ -124,7 +226,16 @@ void ChainServer::api_get_hash(Height height, HashCb callback)
 
 void ChainServer::api_get_block(API::HeightOrHash hoh, BlockCb callback)
 {
-    defer_maybe_busy(GetBlock { hoh, std::move(callback) });
+    readPool.async([this, hoh, callback = std::move(callback)](ChainDBReader& r) {
+        callback(noval_to_err(state.api_get_block_concurrent(r, hoh)));
+    });
+}
+
+void ChainServer::api_get_blocks(NonzeroHeight from, Height to, BlocksCb callback)
+{
+    readPool.async([this, from, to, callback = std::move(callback)](ChainDBReader& r) {
+        callback(state.api_get_blocks_concurrent(r, from, to));
+    });
 }
 
 void ChainServer::async_get_blocks(DescriptedBlockRange range, getBlocksCb&& callback)
@@ -132,6 +243,11 @@ void ChainServer::async_get_blocks(DescriptedBlockRange range, getBlocksCb&& cal
     defer(GetBlocks { range, std::move(callback) });
 }
 
+void ChainServer::async_get_blockrep(DescriptedBlockRange range, uint32_t nonce, getBlockrepCb&& callback)
+{
+    defer(GetBlockrep { range, nonce, std::move(callback) });
+}
+
 void ChainServer::async_stage_request(stage_operation::Operation r)
 {
     std::visit([&](auto req) {
@@ -149,39 +265,129 @@ void ChainServer::close()
 {
     std::unique_lock<std::mutex> ul(mutex);
     closing = true;
-    haswork = true;
     cv.notify_one();
 }
 
+bool ChainServer::has_events() const
+{
+    for (auto& q : events) {
+        if (!q.empty())
+            return true;
+    }
+    return false;
+}
+
+void ChainServer::update_queue_depth() const
+{
+    static auto& depth { metrics::gauge("warthog_chainserver_queue_depth",
+        "Number of events queued for the chain server") };
+    size_t n { 0 };
+    for (auto& q : events)
+        n += q.size();
+    depth.set(n);
+}
+
+namespace {
+metrics::Histogram& event_histogram(size_t eventIndex)
+{
+    // indexed by the alternatives of ChainServer::Event
+    constexpr std::array names {
+        "mining_append", "put_mempool", "put_mempool_payments", "get_grid", "get_mempool",
+        "get_fee_estimate", "lookup_txids", "lookup_txhash", "lookup_txproof", "lookup_latest_txs",
+        "set_synced", "get_head", "get_header", "get_hash", "get_mining", "get_txcache",
+        "get_blocks", "get_blockrep", "stage_add", "stage_set", "put_mempool_batch",
+        "set_signed_pin"
+    };
+    static_assert(names.size() == std::variant_size_v<ChainServer::Event>);
+    static const auto histograms { [&]() {
+        std::array<metrics::Histogram*, names.size()> res;
+        for (size_t i = 0; i < names.size(); ++i)
+            res[i] = &metrics::histogram("warthog_chainserver_event_seconds",
+                "Duration of handling a chain server event", { { "event", names[i] } });
+        return res;
+    }() };
+    return *histograms[eventIndex];
+}
+}
+
+auto ChainServer::pop_event() -> Event
+{
+    for (auto& q : events) {
+        if (q.empty())
+            continue;
+        Event e { std::move(q.front()) };
+        q.pop();
+        if (auto p { std::get_if<PutMempoolBatch>(&e) }) {
+            // coalesce consecutive mempool batches
+            while (!q.empty() && std::holds_alternative<PutMempoolBatch>(q.front())) {
+                auto& txs { std::get<PutMempoolBatch>(q.front()).txs };
+                p->txs.insert(p->txs.end(),
+                    std::make_move_iterator(txs.begin()),
+                    std::make_move_iterator(txs.end()));
+                q.pop();
+            }
+        }
+        return e;
+    }
+    throw std::runtime_error("BUG: no chainserver event to pop");
+}
+
 void ChainServer::workerfun()
 {
-    // initialization
+    trace::set_thread_name("chainserver");
+    apply_thread_settings(config().threads.chainserver, "chainserver");
+    bool slicePending { false };
     while (true) {
+        std::optional<Event> e;
         {
             std::unique_lock<std::mutex> ul(mutex);
-            while (!haswork) {
-                cv.wait(ul);
+            // wake up regularly for expired group commits, immediately
+            // for the next garbage collection or vacuum slice
+            using namespace std::chrono;
+            cv.wait_for(ul, slicePending ? seconds(0) : seconds(1), [&]() { return closing || has_events(); });
+            if (closing)
+                break;
+            // one event at a time such that high priority events
+            // are handled next even when a long queue is pending
+            if (has_events()) {
+                e.emplace(pop_event());
+                update_queue_depth();
             }
         }
-        haswork = false;
-        if (closing)
-            break;
-        state.garbage_collect();
-
-        { // work
-            decltype(events) tmpq;
-            {
-                std::unique_lock<std::mutex> ul(mutex);
-                std::swap(tmpq, events);
-            }
-            while (!tmpq.empty()) {
-                std::visit([&](auto&& e) {
-                    handle_event(std::move(e));
-                },
-                    tmpq.front());
-                tmpq.pop();
-            }
+        {
+            TRACE_ZONE("chainserver.maintenance");
+            state.commit_deferred(true);
+            slicePending = state.garbage_collect(!e.has_value());
+            slicePending = state.maintain_db(!e.has_value()) || slicePending;
         }
+        if (!e)
+            continue;
+        {
+            TRACE_ZONE("chainserver.event");
+            metrics::ScopeTimer st(event_histogram(e->index()));
+            std::visit([&](auto&& e) {
+                handle_event(std::move(e));
+            },
+                std::move(*e));
+        }
+        notify_mining();
+    }
+    mempool::save_dump(mempool_path(), state.mempool_payments());
+}
+
+void ChainServer::notify_mining()
+{
+    // push based mining clients of the HTTP endpoint and the pool server
+    // fetch new tasks
+    auto v { state.mining_version() };
+    if (v != miningVersion) {
+        const bool headChanged { !miningVersion || v.descriptor != miningVersion->descriptor || v.length != miningVersion->length };
+        miningVersion = v;
+        if (headChanged)
+            block_latency::mark_through(block_latency::Stage::Template, v.length);
+        http_endpoint().push_event(API::MiningUpdate { headChanged });
+        if (auto s { global().stratumServer })
+            s->push_event(API::MiningUpdate { headChanged });
     }
 }
 
@@ -197,13 +403,19 @@ int32_t ChainServer::append_gentx(const PaymentCreateMessage& m)
 void ChainServer::handle_event(MiningAppend&& e)
 {
     try {
-        auto res = state.append_mined_block(e.block);
-        global().pel->async_state_update(std::move(res));
-        spdlog::info("Accepted new block #{}", state.chainlength().value());
+        auto res { state.append_mined_block(e.block, e.pushed) };
+        if (!e.pushed) // pushed blocks are relayed before their body is checked
+            global().pel->async_push_block(e.block);
+        if (res)
+            global().pel->async_state_update(std::move(*res));
+        spdlog::info("Accepted {} block #{}", e.pushed ? "pushed" : "new", state.chainlength().value());
         e.callback({});
     } catch (Error err) {
-        spdlog::info("Rejected new block #{}: {}", (state.chainlength() + 1).value(),
-            err.strerror());
+        if (e.pushed)
+            spdlog::debug("Rejected pushed block #{}: {}", e.block.height.value(), err.strerror());
+        else
+            spdlog::info("Rejected new block #{}: {}", (state.chainlength() + 1).value(),
+                err.strerror());
         e.callback(tl::make_unexpected(err.e));
     }
 }
@@ -213,14 +425,14 @@ void ChainServer::handle_event(GetGrid&& e)
     e.callback(state.get_headers().grid());
 }
 
-void ChainServer::handle_event(GetBalance&& e)
+void ChainServer::handle_event(GetMempool&& e)
 {
-    e.callback(state.api_get_address(e.address));
+    e.callback(state.api_get_mempool(e.offset, e.limit, std::move(e.address)));
 }
 
-void ChainServer::handle_event(GetMempool&& e)
+void ChainServer::handle_event(GetFeeEstimate&& e)
 {
-    e.callback(state.api_get_mempool(100));
+    e.callback(state.api_get_fee_estimate());
 }
 
 void ChainServer::handle_event(LookupTxids&& e)
@@ -231,17 +443,14 @@ void ChainServer::handle_event(LookupTxids&& e)
     e.callback(out);
 }
 
-template <typename T>
-tl::expected<T, int32_t> noval_to_err(std::optional<T>&& v)
+void ChainServer::handle_event(LookupTxHash&& e)
 {
-    if (v)
-        return *v;
-    return tl::make_unexpected(ENOTFOUND);
+    e.callback(noval_to_err(state.api_get_tx(e.hash)));
 }
 
-void ChainServer::handle_event(LookupTxHash&& e)
+void ChainServer::handle_event(LookupTxProof&& e)
 {
-    e.callback(noval_to_err(state.api_get_tx(e.hash)));
+    e.callback(noval_to_err(state.api_get_tx_proof(e.id)));
 }
 
 void ChainServer::handle_event(LookupLatestTxs&& e)
@@ -252,18 +461,10 @@ void ChainServer::handle_event(LookupLatestTxs&& e)
 void ChainServer::handle_event(SetSynced&& e)
 {
     state.set_sync_state(e.synced);
-}
-
-void ChainServer::handle_event(GetHistory&& e)
-{
-    auto history { state.api_get_history(e.address, e.beforeId) };
-    e.callback(noval_to_err(std::move(history)));
-}
-
-void ChainServer::handle_event(GetRichlist&& e)
-{
-    auto richlist { state.api_get_richlist(100) };
-    e.callback(std::move(richlist));
+    if (e.synced && db.profile() == SQLiteProfile::Sync) {
+        spdlog::info("Node is synced, switching chain database to durable settings");
+        db.set_profile(SQLiteProfile::Durable);
+    }
 }
 
 void ChainServer::handle_event(GetHead&& e)
@@ -281,11 +482,6 @@ void ChainServer::handle_event(GetHash&& e)
     e.callback(noval_to_err(state.get_hash(e.height)));
 }
 
-void ChainServer::handle_event(GetBlock&& e)
-{
-    e.callback(noval_to_err(state.api_get_block(e.heightOrHash)));
-}
-
 void ChainServer::handle_event(GetMining&& e)
 {
     auto mt = state.mining_task(e.address,e.log);
@@ -302,6 +498,11 @@ void ChainServer::handle_event(GetBlocks&& e)
     e.callback(state.get_blocks(e.range));
 }
 
+void ChainServer::handle_event(GetBlockrep&& e)
+{
+    e.callback(state.get_blockrep(e.range, e.nonce));
+}
+
 void ChainServer::handle_event(stage_operation::StageSetOperation&& r)
 {
     global().pel->async_stage_action(state.set_stage(std::move(r.headers)));
@@ -309,7 +510,7 @@ void ChainServer::handle_event(stage_operation::StageSetOperation&& r)
 
 void ChainServer::handle_event(stage_operation::StageAddOperation&& r)
 {
-    auto [stageAddResult, delta] { state.add_stage(r.blocks, r.headers) };
+    auto [stageAddResult, delta] { state.add_stage(r.blocks, r.headers, r.bodiesChecked) };
     if (delta)
         global().pel->async_state_update(std::move(*delta));
     global().pel->async_stage_action(std::move(stageAddResult));
@@ -323,6 +524,14 @@ void ChainServer::handle_event(PutMempool&& e)
         e.callback({});
 }
 
+void ChainServer::handle_event(PutMempoolPayments&& e)
+{
+    auto [codes, log] { state.append_gentxs(e.batch) };
+    if (log.size() > 0)
+        global().pel->async_mempool_update(std::move(log));
+    e.callback(API::MempoolInsertResults { std::move(codes) });
+}
+
 void ChainServer::handle_event(PutMempoolBatch&& mb)
 {
     auto [_, log] { state.insert_txs(mb.txs) };
@@ -2,14 +2,19 @@
 #include "api/callbacks.hpp"
 #include "communication/create_payment.hpp"
 #include "communication/stage_operation/request.hpp"
+#include "consistency_check.hpp"
+#include "read_pool.hpp"
+#include "richlist_cache.hpp"
 #include "state/state.hpp"
 #include "api/types/height_or_hash.hpp"
+#include <array>
 #include <condition_variable>
 #include <queue>
 #include <thread>
 
 class ChainServer {
     using getBlocksCb = std::function<void(std::vector<BodyContainer>&&)>;
+    using getBlockrepCb = std::function<void(std::optional<Sndbuffer>&&)>;
 
 private:
     void garbage_collect();
@@ -25,7 +30,7 @@ private:
 public:
     // can be called concurrently
     Batch get_headers(BatchSelector selector);
-    std::optional<HeaderView> get_descriptor_header(Descriptor descriptor, Height height);
+    std::optional<Header> get_descriptor_header(Descriptor descriptor, Height height);
     ConsensusSlave get_chainstate();
 
     void shutdown_join()
@@ -39,21 +44,28 @@ public:
     struct MiningAppend {
         Block block;
         ResultCb callback;
+        bool pushed { false }; // received unsolicited from a peer
     };
     struct PutMempool {
         PaymentCreateMessage m;
         ResultCb callback;
     };
+    struct PutMempoolPayments {
+        API::PaymentCreateBatch batch;
+        MempoolInsertCb callback;
+    };
     struct GetGrid {
         GridCb callback;
     };
-    struct GetBalance {
-        Address address;
-        BalanceCb callback;
-    };
     struct GetMempool {
+        size_t offset;
+        uint32_t limit;
+        std::optional<Address> address;
         MempoolCb callback;
     };
+    struct GetFeeEstimate {
+        FeeEstimateCb callback;
+    };
     struct LookupTxids {
         Height maxHeight;
         std::vector<TransactionId> txids;
@@ -63,20 +75,16 @@ public:
         const Hash hash;
         TxCb callback;
     };
+    struct LookupTxProof {
+        std::variant<Hash, HistoryId> id;
+        TxProofCb callback;
+    };
     struct LookupLatestTxs {
         LatestTxsCb callback;
     };
     struct SetSynced {
         bool synced;
     };
-    struct GetHistory {
-        const Address& address;
-        uint64_t beforeId;
-        HistoryCb callback;
-    };
-    struct GetRichlist {
-        RichlistCb callback;
-    };
     struct GetHead {
         HeadCb callback;
     };
@@ -88,10 +96,6 @@ public:
         Height height;
         HashCb callback;
     };
-    struct GetBlock {
-        API::HeightOrHash heightOrHash;
-        BlockCb callback;
-    };
     struct GetMining {
         Address address;
         bool log;
@@ -104,6 +108,11 @@ public:
         DescriptedBlockRange range;
         getBlocksCb callback;
     };
+    struct GetBlockrep {
+        DescriptedBlockRange range;
+        uint32_t nonce;
+        getBlockrepCb callback;
+    };
     struct PutMempoolBatch {
         std::vector<TransferTxExchangeMessage> txs;
     };
@@ -115,52 +124,69 @@ public:
     using Event = std::variant<
         MiningAppend,
         PutMempool,
+        PutMempoolPayments,
         GetGrid,
-        GetBalance,
         GetMempool,
+        GetFeeEstimate,
         LookupTxids,
         LookupTxHash,
+        LookupTxProof,
         LookupLatestTxs,
         SetSynced,
-        GetHistory,
-        GetRichlist,
         GetHead,
         GetHeader,
         GetHash,
-        GetBlock,
         GetMining,
         GetTxcache,
         GetBlocks,
+        GetBlockrep,
         stage_operation::StageAddOperation,
         stage_operation::StageSetOperation,
         PutMempoolBatch,
         SetSignedPin>;
 
 private:
+    // event priorities, lower value is processed first
+    template <typename T>
+    static constexpr size_t priority()
+    {
+        if constexpr (std::is_same_v<T, MiningAppend>)
+            return 0;
+        else if constexpr (std::is_same_v<T, stage_operation::StageAddOperation>
+            || std::is_same_v<T, stage_operation::StageSetOperation>
+            || std::is_same_v<T, SetSignedPin>)
+            return 1;
+        else
+            return 2;
+    }
+    static constexpr size_t NPRIORITIES = 3;
+
     template <typename T>
     void defer(T&& e)
     {
+        using Type = std::decay_t<T>;
         std::unique_lock l(mutex);
-        haswork = true;
-        events.emplace(std::forward<T>(e));
+        events[priority<Type>()].emplace(std::forward<T>(e));
+        update_queue_depth();
         cv.notify_one();
     }
 
     template <typename T>
     void defer_maybe_busy(T&& e)
     {
+        using Type = std::decay_t<T>;
         std::unique_lock l(mutex);
         if (switching)
             e.callback(tl::make_unexpected(ESWITCHING));
         else {
-            haswork = true;
-            events.emplace(std::forward<T>(e));
+            events[priority<Type>()].emplace(std::forward<T>(e));
+            update_queue_depth();
             cv.notify_one();
         }
     }
 
 public:
-    ChainServer(ChainDB& b, BatchRegistry&, std::optional<SnapshotSigner> snapshotSigner);
+    ChainServer(ChainDB& b, BatchRegistry&, std::optional<SnapshotSigner> snapshotSigner, size_t apiReadConnections);
     ~ChainServer();
 
     bool is_busy();
@@ -168,26 +194,37 @@ public:
     void async_set_synced(bool synced);
 
     void async_put_mempool(std::vector<TransferTxExchangeMessage> txs);
+    // reinserts the transactions saved on shutdown, globals must be set
+    void restore_mempool();
     void async_get_head(HeadCb callback);
 
     // API methods
     void api_mining_append(Block&&, ResultCb);
+    void async_append_pushed(Block&&, ResultCb);
     void api_put_mempool(PaymentCreateMessage, ResultCb cb);
+    void api_put_mempool_batch(API::PaymentCreateBatch, MempoolInsertCb cb);
     void api_get_balance(const Address& a, BalanceCb callback);
+    void api_get_balances(API::BalancesRequest, BalancesCb callback);
     void api_get_grid(GridCb);
-    void api_get_mempool(MempoolCb callback);
+    void api_get_mempool(size_t offset, uint32_t limit, std::optional<Address> address, MempoolCb callback);
+    void api_get_fee_estimate(FeeEstimateCb callback);
     void api_lookup_tx(const HashView hash, TxCb callback);
+    void api_lookup_tx_proof(std::variant<Hash, HistoryId> id, TxProofCb callback);
     void api_lookup_latest_txs(LatestTxsCb callback);
-    void api_get_history(const Address& address, uint64_t beforeId, HistoryCb callback);
+    void api_get_history(const Address& address, uint64_t beforeId, uint32_t limit, HistoryCb callback);
+    void api_get_history_export(const Address& address, uint64_t afterId, HistoryExportCb callback);
     void api_get_richlist(RichlistCb callback);
+    void api_get_chain_stats(uint32_t from, uint32_t to, uint32_t bucketSeconds, ChainStatsCb callback);
     void api_get_header(API::HeightOrHash, HeaderCb callback);
     void api_get_hash(Height height, HashCb callback);
     void api_get_block(API::HeightOrHash, BlockCb callback);
+    void api_get_blocks(NonzeroHeight from, Height to, BlocksCb callback);
     void api_get_mining(const Address& a, bool log, MiningCb callback);
     void api_get_txcache(TxcacheCb callback);
 
     void async_set_signed_checkpoint(SignedSnapshot);
     void async_get_blocks(DescriptedBlockRange, getBlocksCb&&);
+    void async_get_blockrep(DescriptedBlockRange, uint32_t nonce, getBlockrepCb&&);
 
     void async_stage_request(stage_operation::Operation);
 
@@ -195,28 +232,33 @@ private:
     void close();
     ChainError apply_stage(ChainDBTransaction&& t);
     void workerfun();
+    bool has_events() const; // mutex must be held
+    void update_queue_depth() const; // mutex must be held
+    Event pop_event(); // mutex must be held
 
     int32_t append_gentx(const PaymentCreateMessage&);
+    std::string mempool_path() const;
+    void notify_mining();
 
 private:
     void handle_event(MiningAppend&&);
     void handle_event(PutMempool&&);
+    void handle_event(PutMempoolPayments&&);
     void handle_event(GetGrid&&);
-    void handle_event(GetBalance&&);
     void handle_event(GetMempool&&);
+    void handle_event(GetFeeEstimate&&);
     void handle_event(LookupTxids&&);
     void handle_event(LookupTxHash&&);
+    void handle_event(LookupTxProof&&);
     void handle_event(LookupLatestTxs&&);
     void handle_event(SetSynced&& e);
-    void handle_event(GetHistory&&);
-    void handle_event(GetRichlist&&);
     void handle_event(GetHead&&);
     void handle_event(GetHeader&&);
     void handle_event(GetHash&&);
-    void handle_event(GetBlock&&);
     void handle_event(GetMining&&);
     void handle_event(GetTxcache&&);
     void handle_event(GetBlocks&&);
+    void handle_event(GetBlockrep&&);
     void handle_event(stage_operation::StageSetOperation&&);
     void handle_event(stage_operation::StageAddOperation&&);
     void handle_event(PutMempoolBatch&&);
@@ -228,12 +270,18 @@ private:
 
     // state variables
     chainserver::State state;
+    std::optional<chainserver::State::MiningVersion> miningVersion; // last announced
+
+    // API reads
+    chainserver::RichlistCache richlistCache;
+    chainserver::ReadPool readPool;
+
+    std::optional<chainserver::ConsistencyCheck> consistencyCheck; // config db.verify
 
     // mutex protected variables
     std::mutex mutex;
-    std::queue<Event> events;
+    std::array<std::queue<Event>, NPRIORITIES> events; // indexed by priority
     //
-    bool haswork = false;
     bool closing = false;
     bool switching = false; // doing chain switch?
     std::thread worker;
@@ -0,0 +1,219 @@
+#pragma once
+#include "api/types/all.hpp"
+#include "api/types/height_or_hash.hpp"
+#include "block/chain/history/history.hpp"
+#include "chainserver/account_cache.hpp"
+#include "helpers/consensus.hpp"
+#include <algorithm>
+#include <limits>
+
+// API read queries shared by the chainserver (ChainDB) and the
+// API read pool (ChainDBReader). The chainstate can be ahead of the
+// database while writes are group committed, reads are limited to the
+// committed chain length (State::read_chainstate_concurrent).
+namespace chainserver::api_reads {
+
+template <typename DB>
+API::Balance balance(DB& db, AddressView address)
+{
+    if (auto p = db.lookup_address(address); p) {
+        return API::Balance {
+            std::get<0>(*p),
+            std::get<1>(*p)
+        };
+    } else {
+        return API::Balance {
+            AccountId { 0 },
+            Funds { 0 }
+        };
+    }
+}
+
+// history id of the first entry above the committed chain length
+inline HistoryId committed_history_end(const Chainstate& cs, Height committed)
+{
+    if (committed < cs.length())
+        return cs.historyOffset((committed + 1).nonzero_assert());
+    return HistoryId { std::numeric_limits<uint64_t>::max() };
+}
+
+template <typename DB>
+std::optional<API::Block> block(DB& db, const Chainstate& cs, Height committed, Height zh)
+{
+    const Height chainlength { cs.length() };
+    if (zh == 0 || zh > std::min(chainlength, committed))
+        return {};
+    auto h { zh.nonzero_assert() };
+    PinFloor pinFloor { PrevHeight(h) };
+    auto lower = cs.historyOffset(h);
+    auto upper = (h == chainlength ? HistoryId { 0 }
+                                   : cs.historyOffset(h + 1));
+    auto entries = db.lookupHistoryRange(lower, upper);
+    auto header = cs.headers()[h];
+    API::Block b(header, h, chainlength - h + 1);
+
+    AccountCache cache(db);
+    for (auto [hash, data] : entries) {
+        b.push_history(hash, data, cache, pinFloor);
+    }
+    return b;
+}
+
+// consecutive blocks [from, to) of which those above the chain length are
+// omitted, their history is read with one range lookup
+template <typename DB>
+std::vector<API::Block> blocks(DB& db, const Chainstate& cs, Height committed, NonzeroHeight from, Height to)
+{
+    const Height chainlength { cs.length() };
+    to = std::min(to, std::min(chainlength, committed) + 1);
+    std::vector<API::Block> res;
+    if (to <= from)
+        return res;
+    const bool toTip { to == chainlength + 1 };
+    auto entries { db.lookupHistoryRange(cs.historyOffset(from),
+        toTip ? HistoryId { 0 } : cs.historyOffset(to.nonzero_assert())) };
+    res.reserve(to - from);
+    AccountCache cache(db);
+    size_t i { 0 };
+    for (NonzeroHeight h { from }; h < to; ++h) {
+        auto& b { res.emplace_back(cs.headers()[h], h, chainlength - h + 1) };
+        const size_t end { h == chainlength ? entries.size()
+                                            : i + (cs.historyOffset(h + 1) - cs.historyOffset(h)) };
+        PinFloor pinFloor { PrevHeight(h) };
+        for (; i < end && i < entries.size(); ++i)
+            b.push_history(entries[i].first, entries[i].second, cache, pinFloor);
+    }
+    return res;
+}
+
+template <typename DB>
+std::optional<API::Block> block(DB& db, const Chainstate& cs, Height committed, const API::HeightOrHash& hh)
+{
+    if (std::holds_alternative<Height>(hh.data)) {
+        return block(db, cs, committed, std::get<Height>(hh.data));
+    }
+    auto h { cs.consensus_height(std::get<Hash>(hh.data)) };
+    if (!h.has_value())
+        return {};
+    return block(db, cs, committed, *h);
+}
+
+template <typename DB>
+std::optional<API::AccountHistory> history(DB& db, const Chainstate& cs, Height committed, const Address& a, uint64_t beforeId, uint32_t limit)
+{
+    auto p = db.lookup_address(a);
+    if (!p)
+        return {};
+    auto& [accountId, balance] = *p;
+    const Height chainlength { cs.length() };
+
+    // ids are stored as signed integers
+    const int64_t before { int64_t(std::min(beforeId, uint64_t(std::numeric_limits<int64_t>::max()))) };
+    auto page { db.lookup_history_desc(accountId, before, limit) };
+    auto& entries_desc { page.entries_desc };
+    // committed entries of blocks the chainstate has forked away from
+    const HistoryId historyEnd { committed_history_end(cs, committed) };
+    std::erase_if(entries_desc, [&](auto& e) { return std::get<0>(e) >= historyEnd; });
+    std::vector<API::Block> blocks_reversed;
+    PinFloor pinFloor { 0 };
+    auto firstHistoryId = HistoryId { 0 };
+    auto nextHistoryOffset = HistoryId { 0 };
+    AccountCache cache(db);
+
+    std::vector<HistoryId> ids;
+    ids.reserve(entries_desc.size());
+    for (auto iter = entries_desc.rbegin(); iter != entries_desc.rend(); ++iter)
+        ids.push_back(std::get<0>(*iter));
+    const auto heights { cs.history_heights(ids) };
+
+    auto prevHistoryId = HistoryId { 0 };
+    size_t i { 0 };
+    for (auto iter = entries_desc.rbegin(); iter != entries_desc.rend(); ++iter, ++i) {
+        auto& [historyId, txid, data] = *iter;
+        if (firstHistoryId == HistoryId { 0 })
+            firstHistoryId = historyId;
+        assert(prevHistoryId < historyId);
+        prevHistoryId = historyId;
+        if (historyId >= nextHistoryOffset) {
+            auto height { heights[i] };
+            pinFloor = PinFloor(PrevHeight(height));
+            auto header = cs.headers()[height];
+            bool b = height == chainlength;
+            nextHistoryOffset = (b
+                    ? HistoryId { std::numeric_limits<uint64_t>::max() }
+                    : cs.historyOffset(height + 1));
+            blocks_reversed.push_back(
+                API::Block(header, height, 1 + (chainlength - height)));
+        }
+        API::Block& b = blocks_reversed.back();
+        b.push_history(txid, data, cache, pinFloor);
+    }
+
+    std::optional<HistoryId> nextCursor;
+    if (page.more)
+        nextCursor = firstHistoryId;
+    return API::AccountHistory {
+        .balance = balance,
+        .fromId = firstHistoryId,
+        .nextCursor = nextCursor,
+        .count = db.count_history(accountId, API::AccountHistory::MAXCOUNT),
+        .blocks_reversed = blocks_reversed
+    };
+}
+
+// next chunk of an account history export after the history id afterId,
+// consecutive chunks resume the scan on the AccountHistory primary key
+template <typename DB>
+std::optional<API::HistoryExport> history_export(DB& db, const Chainstate& cs, Height committed, const Address& a, uint64_t afterId)
+{
+    auto p = db.lookup_address(a);
+    if (!p)
+        return {};
+    const int64_t after { int64_t(std::min(afterId, uint64_t(std::numeric_limits<int64_t>::max()))) };
+    auto rows { db.lookup_history_asc(std::get<0>(*p), after, API::HistoryExport::CHUNKSIZE + 1) };
+    API::HistoryExport out;
+    if (rows.size() > API::HistoryExport::CHUNKSIZE) {
+        rows.pop_back();
+        out.more = true;
+    }
+    // committed entries of blocks the chainstate has forked away from
+    const HistoryId historyEnd { committed_history_end(cs, committed) };
+    if (std::erase_if(rows, [&](auto& r) { return std::get<0>(r) >= historyEnd; }) > 0)
+        out.more = false;
+    std::vector<HistoryId> ids;
+    ids.reserve(rows.size());
+    for (auto& r : rows)
+        ids.push_back(std::get<0>(r));
+    const auto heights { cs.history_heights(ids) };
+
+    AccountCache cache(db);
+    out.entries.reserve(rows.size());
+    for (size_t i = 0; i < rows.size(); ++i) {
+        auto& [historyId, txid, data] = rows[i];
+        auto parsed { history::parse(data) };
+        if (!parsed)
+            throw std::runtime_error("Cannot parse raw transaction data, database error.");
+        const NonzeroHeight height { heights[i] };
+        auto& e { out.entries.emplace_back(API::HistoryExport::Entry {
+            .id = historyId,
+            .height = height,
+            .timestamp = cs.headers()[height].timestamp(),
+            .txhash = txid,
+            .fromAddress {},
+            .toAddress {},
+            .amount = Funds { 0 },
+            .fee = Funds { 0 } }) };
+        if (auto* t { std::get_if<history::TransferData>(&*parsed) }) {
+            e.fromAddress = cache[t->fromAccountId].address;
+            e.toAddress = cache[t->toAccountId].address;
+            e.amount = t->amount;
+            e.fee = t->compactFee.uncompact();
+        } else {
+            auto& r { std::get<history::RewardData>(*parsed) };
+            e.toAddress = cache[r.toAccountId].address;
+            e.amount = r.miningReward;
+        }
+    }
+    return out;
+}
+}
@@ -0,0 +1,77 @@
+#include "block_hash_index.hpp"
+#include "block/chain/header_chain.hpp"
+#include "general/reader.hpp"
+#include <algorithm>
+#include <cassert>
+
+namespace chainserver {
+namespace {
+constexpr size_t minSlots { 1024 };
+}
+
+// the leading bytes of block hashes are zero by proof of work
+size_t BlockHashIndex::slot_index(const Hash& h) const
+{
+    return (uint64_t(readuint32(h.data() + 24)) * slots.size()) >> 32;
+}
+
+uint32_t BlockHashIndex::tag(const Hash& h)
+{
+    return readuint32(h.data() + 28);
+}
+
+void BlockHashIndex::insert(const Hash& hash, NonzeroHeight height)
+{
+    size_t i { slot_index(hash) };
+    while (slots[i].height != 0)
+        i = (i + 1 == slots.size() ? 0 : i + 1);
+    slots[i] = { tag(hash), height.value() };
+    used += 1;
+}
+
+void BlockHashIndex::rebuild(const Headerchain& hc)
+{
+    // load 2/3 after the rebuild, rebuilt again at 3/4
+    slots.assign(std::max(minSlots, size_t(hc.length().value()) * 3 / 2), Slot { 0, 0 });
+    used = 0;
+    stale = 0;
+    for (NonzeroHeight h { 1u }; h <= hc.length(); ++h)
+        insert(hc.hash_at(h), h);
+    indexed = hc.length();
+}
+
+void BlockHashIndex::append(const Headerchain& hc)
+{
+    assert(indexed <= hc.length());
+    const size_t n { hc.length().value() - indexed.value() };
+    if ((used + n) * 4 > slots.size() * 3 || stale * 4 > used)
+        return rebuild(hc);
+    for (NonzeroHeight h { (indexed + 1).nonzero_assert() }; h <= hc.length(); ++h)
+        insert(hc.hash_at(h), h);
+    indexed = hc.length();
+}
+
+void BlockHashIndex::shrink(Height newLength)
+{
+    if (newLength >= indexed)
+        return;
+    stale += indexed.value() - newLength.value();
+    indexed = newLength;
+}
+
+std::optional<NonzeroHeight> BlockHashIndex::find(const Headerchain& hc, const Hash& hash) const
+{
+    if (slots.empty())
+        return {};
+    const uint32_t t { tag(hash) };
+    for (size_t i { slot_index(hash) }; slots[i].height != 0; i = (i + 1 == slots.size() ? 0 : i + 1)) {
+        auto& s { slots[i] };
+        if (s.tag != t || s.height > indexed.value())
+            continue;
+        const NonzeroHeight h { s.height };
+        if (hc.hash_at(h) == hash)
+            return h;
+    }
+    return {};
+}
+}
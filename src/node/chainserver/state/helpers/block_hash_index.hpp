@@ -0,0 +1,38 @@
+#pragma once
+#include "block/chain/height.hpp"
+#include "crypto/hash.hpp"
+#include <cstdint>
+#include <optional>
+#include <vector>
+class Headerchain;
+
+namespace chainserver {
+// Consensus heights by block hash for API lookups by hash. Open addressing
+// table of 32 bit hash tags and heights, 8 bytes per slot, filled from the
+// header chain where hashes below the tip are the previous hashes of the
+// next headers. Tags may collide and heights removed by rollbacks are only
+// dropped when the table is rebuilt, so candidates are verified against
+// the headers.
+class BlockHashIndex {
+public:
+    // indexes the heights above the indexed length up to hc.length()
+    void append(const Headerchain& hc);
+    void shrink(Height newLength);
+    [[nodiscard]] std::optional<NonzeroHeight> find(const Headerchain& hc, const Hash&) const;
+
+private:
+    struct Slot {
+        uint32_t tag;
+        uint32_t height; // 0 if empty
+    };
+    size_t slot_index(const Hash&) const;
+    static uint32_t tag(const Hash&);
+    void insert(const Hash&, NonzeroHeight);
+    void rebuild(const Headerchain& hc);
+
+    std::vector<Slot> slots;
+    size_t used { 0 }; // occupied slots, stale ones included
+    size_t stale { 0 };
+    Height indexed { 0 };
+};
+}
@@ -1,6 +1,7 @@
 #include "consensus.hpp"
 #include "communication/create_payment.hpp"
 #include "db/chain_db.hpp"
+#include "general/task_pool.hpp"
 #include "global/globals.hpp"
 #include <spdlog/spdlog.h>
 namespace chainserver {
@@ -11,16 +12,17 @@ Chainstate::Chainstate(const ChainDB& db, BatchRegistry& br)
 }
 
 Chainstate::Chainstate(
-    std::tuple<std::vector<Batch>, HistoryHeights, AccountHeights> init,
+    std::tuple<ConsensusHeaders, HistoryHeights, AccountHeights> init,
     const ChainDB& db,
     BatchRegistry& br)
     : db(db)
-    , headerchain(std::move(std::get<0>(init)), br)
+    , headerchain(std::move(std::get<0>(init).batches), std::get<0>(init).batchWork, br)
     , historyOffsets(std::move(std::get<1>(init)))
     , accountOffsets(std::move(std::get<2>(init)))
     , chainTxIds(db.fetch_tx_ids(length()))
 {
     assert(this->historyOffsets.size() == headerchain.length());
+    hashIndex.append(headerchain);
     spdlog::info("Cache has {} entries", chainTxIds.size());
 }
 
@@ -40,6 +42,8 @@ void Chainstate::fork(Chainstate::ForkData&& fd)
 
     // adapt header chain and offsets
     headerchain = std::move(fd.stage);
+    hashIndex.shrink(fd.rollbackResult.shrinkLength);
+    hashIndex.append(headerchain);
     historyOffsets.shrink(fd.rollbackResult.shrinkLength);
     historyOffsets.append_vector(fd.appendResult.newHistoryOffsets);
     accountOffsets.shrink(fd.rollbackResult.shrinkLength);
@@ -90,6 +94,7 @@ auto Chainstate::rollback(const RollbackResult& rb) -> HeaderchainRollback
 
     // adapt header chain and offsets
     headerchain.shrink(rb.shrinkLength);
+    hashIndex.shrink(rb.shrinkLength);
     historyOffsets.shrink(rb.shrinkLength);
     accountOffsets.shrink(rb.shrinkLength);
     assert_equal_length();
@@ -140,6 +145,7 @@ auto Chainstate::append(AppendMulti ad) -> HeaderchainAppend
 
     // adapt header chain and offsets
     headerchain = std::move(ad.patchedChain);
+    hashIndex.append(headerchain);
     historyOffsets.append_vector(ad.appendResult.newHistoryOffsets);
     accountOffsets.append_vector(ad.appendResult.newAccountOffsets);
     assert_equal_length();
@@ -168,6 +174,7 @@ auto Chainstate::append(AppendSingle d) -> HeaderchainAppend
 
     // adapt header chain and offsets
     headerchain.append(d.prepared, *global().pbr);
+    hashIndex.append(headerchain);
     historyOffsets.append(d.newHistoryOffset);
     accountOffsets.append(d.newAccountOffset);
     assert_equal_length();
@@ -202,17 +209,99 @@ int32_t Chainstate::insert_tx(const TransferTxExchangeMessage& pm)
     if (pm.amount.is_zero())
         return EZEROAMOUNT;
     auto txHash { pm.txhash(*h) };
-    if (pm.from_address(txHash) == pm.toAddr)
+    auto from { signatureCache.recover(pm.signature, txHash) };
+    if (!from)
+        return ECORRUPTEDSIG;
+    if (*from == pm.toAddr)
         return ESELFSEND;
 
     auto p = db.lookup_account(pm.from_id());
     if (!p)
         return ENOTFOUND;
+    if (p->address != *from)
+        return EFAKEACCID;
     TransactionHeight th(pm.pin_height(), account_height(pm.from_id()));
-    return _mempool.insert_tx(pm, th, txHash, *p);
+    return _mempool.insert_recovered_tx(pm, th, txHash, *p);
+}
+
+std::vector<int32_t> Chainstate::insert_txs(const std::vector<TransferTxExchangeMessage>& txs)
+{
+    const size_t n { txs.size() };
+    std::vector<int32_t> res(n, 0);
+
+    // stateless checks and transaction hashes
+    std::vector<std::optional<TxHash>> hashes(n);
+    for (size_t i = 0; i < n; ++i) {
+        auto& pm { txs[i] };
+        if (pm.pin_height() < (length() + 1).pin_begin()) {
+            res[i] = EPINHEIGHT;
+            continue;
+        }
+        if (txids().contains(pm.txid)) {
+            res[i] = ENONCE;
+            continue;
+        }
+        auto h = headers().get_hash(pm.pin_height());
+        if (!h) {
+            res[i] = EPINHEIGHT;
+            continue;
+        }
+        if (pm.amount.is_zero()) {
+            res[i] = EZEROAMOUNT;
+            continue;
+        }
+        hashes[i] = pm.txhash(*h);
+    }
+
+    // signature recovery
+    std::vector<std::optional<Address>> from(n);
+    task_pool().parallel_for(n, [&](size_t i) {
+        if (!hashes[i])
+            return;
+        from[i] = signatureCache.recover(txs[i].signature, *hashes[i]);
+        if (!from[i])
+            res[i] = ECORRUPTEDSIG;
+    });
+
+    // sender accounts
+    std::vector<AccountId> ids;
+    for (size_t i = 0; i < n; ++i) {
+        if (!from[i])
+            continue;
+        if (*from[i] == txs[i].toAddr)
+            res[i] = ESELFSEND;
+        else
+            ids.push_back(txs[i].from_id());
+    }
+    auto accounts { db.lookup_accounts(std::move(ids)) };
+
+    // insertion in order of arrival
+    for (size_t i = 0; i < n; ++i) {
+        if (!from[i] || res[i] != 0)
+            continue;
+        auto& pm { txs[i] };
+        auto iter { accounts.find(pm.from_id()) };
+        if (iter == accounts.end()) {
+            res[i] = ENOTFOUND;
+            continue;
+        }
+        if (iter->second.address != *from[i]) {
+            res[i] = EFAKEACCID;
+            continue;
+        }
+        TransactionHeight th(pm.pin_height(), account_height(pm.from_id()));
+        res[i] = _mempool.insert_recovered_tx(pm, th, *hashes[i], iter->second);
+    }
+    return res;
 }
 
 int32_t Chainstate::insert_tx(const PaymentCreateMessage& m)
+{
+    AddressLookup accounts;
+    return insert_tx(m, accounts);
+}
+
+int32_t Chainstate::insert_tx(const PaymentCreateMessage& m, AddressLookup& accounts)
 {
     try {
         PinHeight pinHeight = m.pinHeight;
@@ -224,10 +313,16 @@ int32_t Chainstate::insert_tx(const PaymentCreateMessage& m)
             return EZEROAMOUNT;
         auto pinHash = headers().hash_at(pinHeight);
         auto txhash { m.tx_hash(pinHash) };
-        auto fromAddr = m.from_address(txhash);
+        auto recovered { signatureCache.recover(m.signature, txhash) };
+        if (!recovered)
+            return ECORRUPTEDSIG;
+        auto& fromAddr { *recovered };
         if (fromAddr == m.toAddr)
             return ESELFSEND;
-        auto p = db.lookup_address(fromAddr);
+        auto iter { accounts.find(fromAddr) };
+        if (iter == accounts.end())
+            iter = accounts.emplace(fromAddr, db.lookup_address(fromAddr)).first;
+        auto& p { iter->second };
         if (!p)
             return ENOTFOUND;
         auto& [accountId, balance] = *p;
@@ -236,12 +331,32 @@ int32_t Chainstate::insert_tx(const PaymentCreateMessage& m)
         if (txids().contains(pm.txid))
             return ENONCE;
         TransactionHeight th(pinHeight, account_height(accountId));
-        return _mempool.insert_tx(pm, th, txhash, af);
+        return _mempool.insert_recovered_tx(pm, th, txhash, af);
     } catch (Error e) {
         return e.e;
     }
 }
 
+auto Chainstate::lookup_senders(const std::vector<tl::expected<PaymentCreateMessage, int32_t>>& entries) -> AddressLookup
+{
+    // signers are cached such that insert_tx() does not recover again
+    std::vector<Address> senders;
+    for (auto& e : entries) {
+        if (!e || e->pinHeight > length() || e->pinHeight < (length() + 1).pin_begin())
+            continue;
+        auto txhash { e->tx_hash(headers().hash_at(e->pinHeight)) };
+        if (auto a { signatureCache.recover(e->signature, txhash) })
+            senders.push_back(*a);
+    }
+    auto found { db.lookup_addresses(std::vector<AddressView>(senders.begin(), senders.end())) };
+    AddressLookup res;
+    for (auto& a : senders) {
+        auto iter { found.find(a) };
+        res.emplace(a, iter == found.end() ? std::nullopt : std::optional(iter->second));
+    }
+    return res;
+}
+
 void Chainstate::prune_txids()
 {
     chainTxIds.prune(length());
@@ -6,9 +6,14 @@
 #include "block/chain/consensus_headers.hpp"
 #include "block/chain/offsts.hpp"
 #include "block/chain/history/index.hpp"
+#include "block/chain/history/signature_cache.hpp"
 #include "mempool/mempool.hpp"
 #include "db/chain/deletion_key.hpp"
+#include "db/header_store.hpp"
+#include "block_hash_index.hpp"
+#include "undo_ring.hpp"
 #include <cstdint>
+#include <map>
 
 class ChainDB;
 namespace chainserver {
@@ -22,6 +27,7 @@ struct AppendBlocksResult {
     std::vector<HistoryId> newHistoryOffsets;
     std::vector<AccountId> newAccountOffsets;
     TransactionIds newTxIds;
+    UndoRing undo;
 };
 
 struct Chainstate {
@@ -57,7 +63,15 @@ struct Chainstate {
     [[nodiscard]] auto append(AppendSingle) -> HeaderchainAppend;
 
     [[nodiscard]] int32_t insert_tx(const TransferTxExchangeMessage& m);
+    // admission of a batch of relayed transactions: signatures are recovered
+    // in parallel and sender accounts are looked up with one bulk query
+    [[nodiscard]] std::vector<int32_t> insert_txs(const std::vector<TransferTxExchangeMessage>&);
     [[nodiscard]] int32_t insert_tx(const PaymentCreateMessage& m);
+    // account lookups shared by the transactions of one batch
+    using AddressLookup = std::map<Address, std::optional<std::tuple<AccountId, Funds>>, Address::Comparator>;
+    [[nodiscard]] int32_t insert_tx(const PaymentCreateMessage& m, AddressLookup&);
+    // recovers the signers of a batch and looks them up with few queries
+    [[nodiscard]] AddressLookup lookup_senders(const std::vector<tl::expected<PaymentCreateMessage, int32_t>>&);
 
     // const functions
     Worksum work_with_new_block() const{return headerchain.total_work() + headerchain.next_target();};
@@ -67,8 +81,10 @@ struct Chainstate {
     auto prepare_append(const std::optional<SignedSnapshot>& sp, HeaderView hv) const { return headerchain.prepare_append(sp, hv); }
     Height length() const { return headerchain.length(); }
     Descriptor descriptor() const { return dsc; }
+    std::optional<NonzeroHeight> consensus_height(const Hash& hash) const { return hashIndex.find(headerchain, hash); }
     const auto& txids() const { return chainTxIds; }
     const auto& mempool() const { return _mempool; }
+    SignatureCache& signature_cache() const { return signatureCache; }
     inline auto historyOffset(NonzeroHeight height) const
     {
         return historyOffsets.at(height);
@@ -77,6 +93,10 @@ struct Chainstate {
     {
         return historyOffsets.height(historyIndex);
     }
+    auto history_heights(std::span<const HistoryId> ascending) const
+    {
+        return historyOffsets.heights(ascending);
+    }
     auto account_height(AccountId id) const
     {
         return accountOffsets.height(id);
@@ -84,7 +104,7 @@ struct Chainstate {
 
 protected:
     void prune_txids();
-    Chainstate(std::tuple<std::vector<Batch>, HistoryHeights, AccountHeights> init,
+    Chainstate(std::tuple<ConsensusHeaders, HistoryHeights, AccountHeights> init,
         const ChainDB& db, BatchRegistry& br);
 
 private:
@@ -92,10 +112,12 @@ private:
     uint32_t dsc = 0;
     void assert_equal_length();
     ExtendableHeaderchain headerchain;
+    BlockHashIndex hashIndex;
     HistoryHeights historyOffsets;
     AccountHeights accountOffsets;
     TransactionIds chainTxIds; // replay protection
     mempool::Mempool _mempool;
+    mutable SignatureCache signatureCache; // shared with block application
 };
 
 }
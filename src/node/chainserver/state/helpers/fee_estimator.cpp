@@ -0,0 +1,116 @@
+#include "fee_estimator.hpp"
+#include <algorithm>
+
+namespace chainserver {
+void FeeEstimator::on_mempool(const mempool::Log& log, Height chainlength)
+{
+    // transactions erased by an earlier log were not included
+    erased.clear();
+    for (auto& a : log) {
+        std::visit([&](auto& action) {
+            using T = std::decay_t<decltype(action)>;
+            if constexpr (std::is_same_v<T, mempool::Put>) {
+                auto& [txid, v] { action.entry };
+                auto [iter, inserted] { pending.try_emplace(txid, Seen { v.hash, chainlength, bucket(v.fee) }) };
+                if (!inserted) { // replaced by a fee bump, keep the first sighting
+                    byHash.erase(iter->second.hash);
+                    iter->second.hash = v.hash;
+                    iter->second.bucket = bucket(v.fee);
+                }
+                byHash.emplace(v.hash, txid);
+            } else {
+                auto iter { pending.find(action.id) };
+                if (iter == pending.end())
+                    return;
+                byHash.erase(iter->second.hash);
+                erased.emplace(iter->second.hash, iter->second);
+                pending.erase(iter);
+            }
+        },
+            a);
+    }
+}
+
+void FeeEstimator::resolve(const Hash& txhash, NonzeroHeight height, Record& r)
+{
+    auto add = [&](const Seen& s) {
+        if (s.height < height)
+            r.waits.push_back({ s.bucket, height - s.height });
+    };
+    if (auto iter { byHash.find(txhash) }; iter != byHash.end()) {
+        auto p { pending.find(iter->second) };
+        add(p->second);
+        pending.erase(p);
+        byHash.erase(iter);
+    } else if (auto iter { erased.find(txhash) }; iter != erased.end()) {
+        add(iter->second);
+        erased.erase(iter);
+    }
+}
+
+void FeeEstimator::on_block(const API::Block& b)
+{
+    // a rollback replaces the records of the orphaned blocks
+    while (!records.empty() && records.back().height >= b.height)
+        records.pop_back();
+
+    Record r { .height { b.height }, .waits {}, .fees {} };
+    r.fees.reserve(b.transfers.size());
+    for (auto& t : b.transfers) {
+        r.fees.push_back(t.fee);
+        resolve(t.txhash, b.height, r);
+    }
+    records.push_back(std::move(r));
+    while (records.size() > WINDOW)
+        records.pop_front();
+}
+
+API::FeeEstimate FeeEstimator::estimate(Height chainlength) const
+{
+    constexpr size_t N { TARGETS.size() };
+    std::vector<size_t> included(NBUCKETS);
+    std::vector<std::array<size_t, N>> within(NBUCKETS), stuck(NBUCKETS);
+    std::vector<Funds> fees;
+    size_t samples { 0 };
+    for (auto& r : records) {
+        for (auto& [b, wait] : r.waits) {
+            included[b] += 1;
+            for (size_t i = 0; i < N; ++i)
+                within[b][i] += (wait <= TARGETS[i]);
+        }
+        samples += r.waits.size();
+        fees.insert(fees.end(), r.fees.begin(), r.fees.end());
+    }
+    for (auto& [_, s] : pending) {
+        const uint32_t waited { s.height < chainlength ? chainlength - s.height : 0 };
+        for (size_t i = 0; i < N; ++i)
+            stuck[s.bucket][i] += (waited > TARGETS[i]);
+    }
+
+    API::FeeEstimate res { .targets {}, .includedMedian {}, .samples = samples };
+    for (size_t i = 0; i < N; ++i) {
+        // Buckets are grouped from the highest fee downwards until a group
+        // has enough samples, the estimate is the lowest group in which
+        // enough transactions were included in time.
+        std::optional<Funds> fee;
+        size_t total { 0 }, ok { 0 };
+        for (size_t b = NBUCKETS; b-- > 0;) {
+            total += included[b] + stuck[b][i];
+            ok += within[b][i];
+            if (total < MINSAMPLES)
+                continue;
+            if (ok < SUCCESS * total)
+                break;
+            fee = bucket_fee(b);
+            total = ok = 0;
+        }
+        res.targets.push_back({ .blocks = TARGETS[i], .fee = fee });
+    }
+    if (!fees.empty()) {
+        auto mid { fees.begin() + fees.size() / 2 };
+        std::nth_element(fees.begin(), mid, fees.end());
+        res.includedMedian = *mid;
+    }
+    return res;
+}
+}
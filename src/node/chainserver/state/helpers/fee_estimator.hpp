@@ -0,0 +1,49 @@
+#pragma once
+#include "api/types/all.hpp"
+#include "mempool/log.hpp"
+#include <array>
+#include <deque>
+#include <map>
+
+namespace chainserver {
+// Estimates the fee needed for inclusion within a number of blocks from how
+// long mempool transactions waited before a block included them. Fees are
+// grouped by the upper 8 bits of their compact representation (about 19%
+// apart), outcomes of the last WINDOW blocks are kept.
+class FeeEstimator {
+public:
+    static constexpr size_t WINDOW = 360; // blocks
+    static constexpr std::array<uint32_t, 5> TARGETS { 1, 2, 3, 6, 12 };
+
+    // Logs must be fed in order, blocks may come before or after the log
+    // that erases their transactions from the mempool.
+    void on_mempool(const mempool::Log&, Height chainlength);
+    void on_block(const API::Block&);
+
+    API::FeeEstimate estimate(Height chainlength) const;
+
+private:
+    static constexpr size_t NBUCKETS = 256;
+    static constexpr size_t MINSAMPLES = 20; // per group of buckets
+    static constexpr double SUCCESS = 0.85;
+    static uint8_t bucket(CompactUInt fee) { return fee.value() >> 8; }
+    static Funds bucket_fee(size_t b) { return CompactUInt(uint16_t(b << 8)); }
+
+    struct Seen {
+        Hash hash;
+        Height height;
+        uint8_t bucket;
+    };
+    struct Record {
+        NonzeroHeight height;
+        std::vector<std::pair<uint8_t, uint32_t>> waits; // bucket, blocks waited
+        std::vector<Funds> fees; // of all included transfers
+    };
+    void resolve(const Hash&, NonzeroHeight, Record&);
+
+    std::map<TransactionId, Seen> pending;
+    std::map<Hash, TransactionId> byHash;
+    std::map<Hash, Seen> erased; // since the last log, may still be included
+    std::deque<Record> records;
+};
+}
@@ -0,0 +1,63 @@
+#include "latest_txs.hpp"
+
+namespace chainserver {
+void LatestTxs::push(const API::Block& b, HistoryId beginId)
+{
+    erase_above(b.height - 1);
+    Entry e { beginId, b };
+    if (e.size() == 0)
+        return;
+    total += e.size();
+    blocks.push_back(std::move(e));
+    while (total - blocks.front().size() >= capacity) {
+        total -= blocks.front().size();
+        blocks.pop_front();
+    }
+}
+
+void LatestTxs::apply(const state_update::ChainstateUpdate& u)
+{
+    if (auto p { std::get_if<state_update::Fork>(&u) })
+        erase_above(p->shrinkLength);
+    else if (auto p { std::get_if<state_update::RollbackData>(&u) }; p && p->data)
+        erase_above(p->data->rollback.shrinkLength);
+}
+
+void LatestTxs::assign(const API::TransactionsByBlocks& feed, HistoryId nextId)
+{
+    blocks.clear();
+    total = 0;
+    HistoryId end { nextId };
+    for (auto& b : feed.blocks_reversed) {
+        Entry e { HistoryId(0), b };
+        e.beginId = end - e.size();
+        end = e.beginId;
+        total += e.size();
+        blocks.push_front(std::move(e));
+    }
+}
+
+void LatestTxs::erase_above(Height h)
+{
+    while (!blocks.empty() && blocks.back().block.height > h) {
+        total -= blocks.back().size();
+        blocks.pop_back();
+    }
+}
+
+std::optional<API::TransactionsByBlocks> LatestTxs::get(size_t n, Height chainlength) const
+{
+    // history ids start with 1
+    const bool all { !blocks.empty() && blocks.front().beginId == HistoryId(1) };
+    if (total < n && !all)
+        return {};
+    API::TransactionsByBlocks res { .fromId { HistoryId(1) }, .blocks_reversed {} };
+    for (auto iter { blocks.rbegin() }; iter != blocks.rend() && res.count < n; ++iter) {
+        auto& b { res.blocks_reversed.emplace_back(iter->block) };
+        b.confirmations = chainlength - b.height + 1;
+        res.count += iter->size();
+        res.fromId = iter->beginId;
+    }
+    return res;
+}
+}
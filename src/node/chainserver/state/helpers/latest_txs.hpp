@@ -0,0 +1,37 @@
+#pragma once
+#include "api/types/all.hpp"
+#include "chainserver/state/update/chainstate_update.hpp"
+#include <deque>
+
+namespace chainserver {
+// The most recent confirmed transactions grouped by block, such that the
+// latest transactions feed is served from memory. Blocks are pushed as
+// they are applied and dropped on rollback, the oldest blocks are dropped
+// once enough newer transactions are held.
+class LatestTxs {
+public:
+    LatestTxs(size_t capacity)
+        : capacity(capacity) {};
+
+    // beginId is the history id of the first transaction in the block
+    void push(const API::Block&, HistoryId beginId);
+    void apply(const state_update::ChainstateUpdate&);
+    // replaces the contents by a feed read from the database
+    void assign(const API::TransactionsByBlocks&, HistoryId nextId);
+
+    // empty if fewer than n transactions are held but older ones exist
+    std::optional<API::TransactionsByBlocks> get(size_t n, Height chainlength) const;
+
+private:
+    struct Entry {
+        HistoryId beginId;
+        API::Block block;
+        size_t size() const { return block.transfers.size() + block.rewards.size(); }
+    };
+    void erase_above(Height);
+
+    const size_t capacity;
+    std::deque<Entry> blocks;
+    size_t total { 0 };
+};
+}
@@ -53,24 +53,31 @@ void BlockCache::handle(ChainSchedule cs)
     chains.erase(cs.iter);
 }
 
-void BlockCache::garbage_collect(ChainDB& db)
+bool BlockCache::garbage_collect(ChainDB& db, size_t chunkSize, std::chrono::steady_clock::time_point deadline)
 {
     std::unique_lock l(mutex);
     if (chains.size() == 0)
-        return;
+        return true;
 
     auto now = std::chrono::system_clock::now();
     for (auto iter { gcSchedule.begin() }; iter != gcSchedule.end();) {
         auto& [t, entry] { *iter };
         if (t > now)
             break;
-        db.garbage_collect_blocks(entry.deletionKey);
+        // the schedule entry is kept until all its blocks are deleted
+        while (!db.garbage_collect_blocks(entry.deletionKey, chunkSize)) {
+            if (std::chrono::steady_clock::now() > deadline)
+                return false;
+        }
         std::visit([&](auto& data) {
             handle(data);
         },
             entry.data);
         gcSchedule.erase(iter++);
+        if (std::chrono::steady_clock::now() > deadline)
+            return iter == gcSchedule.end() || iter->first > now;
     }
+    return true;
 }
 std::vector<Hash> BlockCache::get_hashes(const DescriptedBlockRange& r) const
 {
@@ -4,13 +4,21 @@
 class ChainDB;
 
 namespace chainserver {
+// Headers of past consensus chains by descriptor, which peers and pins may
+// still reference, and the delayed deletion of their blocks. A past chain
+// is a copy of the consensus headers at the time of the fork or rollback.
+// Headerchain copies share the registered batches and the copy on write
+// batch vector and incomplete batch with the consensus chain, so an entry
+// only owns what the consensus chain modified after it was added.
 class BlockCache {
 public:
     [[nodiscard]] std::shared_ptr<Headerchain> add_old_chain(const Chainstate&, DeletionKey); //OK
     void schedule_discard(DeletionKey); 
     Batch get_batch(const BatchSelector& s) const;
     std::optional<HeaderView> get_header(Descriptor descriptor, Height height) const;
-    void garbage_collect(ChainDB&);
+    // deletes due blocks in chunks of chunkSize until the deadline,
+    // returns whether all due blocks are deleted
+    [[nodiscard]] bool garbage_collect(ChainDB&, size_t chunkSize, std::chrono::steady_clock::time_point deadline);
     std::vector<Hash> get_hashes(const DescriptedBlockRange&) const;
 
 private:
@@ -0,0 +1,113 @@
+#include "recent_blocks.hpp"
+#include "block/header/header_impl.hpp"
+#include "general/memory_budget.hpp"
+
+namespace chainserver {
+namespace {
+// raw body and parsed block of a full block
+constexpr size_t approxEntryBytes = 4 * MAXBLOCKSIZE;
+memory_budget::Component& budget()
+{
+    static auto& c { memory_budget::component("recent_blocks", 1, 8 * approxEntryBytes) };
+    return c;
+}
+}
+
+auto RecentBlocks::find(uint32_t height) const -> Entry*
+{
+    auto iter { entries.find(height) };
+    if (iter == entries.end())
+        return nullptr;
+    lru.splice(lru.begin(), lru, iter->second.lru);
+    return &iter->second;
+}
+
+std::optional<API::Block> RecentBlocks::api_block(Height h, Height chainlength) const
+{
+    std::unique_lock l(mutex);
+    auto e { find(h.value()) };
+    if (!e || !e->block || h > chainlength)
+        return {};
+    auto b { *e->block };
+    b.confirmations = chainlength - h + 1;
+    return b;
+}
+
+std::optional<API::Block> RecentBlocks::api_block(const Hash& hash, Height chainlength) const
+{
+    Height h { 0 };
+    {
+        std::unique_lock l(mutex);
+        auto iter { heights.find(hash) };
+        if (iter == heights.end())
+            return {};
+        h = Height(iter->second);
+    }
+    return api_block(h, chainlength);
+}
+
+auto RecentBlocks::body(NonzeroHeight h, const Hash& hash) const -> RawBody
+{
+    std::unique_lock l(mutex);
+    auto e { find(h.value()) };
+    if (!e || e->hash != hash)
+        return {};
+    return e->body;
+}
+
+auto RecentBlocks::entry(NonzeroHeight h, const Hash& hash) -> Entry&
+{
+    if (auto e { find(h.value()) }) {
+        if (e->hash != hash) { // stale entry of a previous chain
+            heights.erase(e->hash);
+            heights[hash] = h.value();
+            e->hash = hash;
+            e->block.reset();
+            e->body.reset();
+        }
+        return *e;
+    }
+    while (!entries.empty() && entries.size() >= budget().max_entries(approxEntryBytes, capacity)) {
+        auto iter { entries.find(lru.back()) };
+        heights.erase(iter->second.hash);
+        entries.erase(iter);
+        lru.pop_back();
+    }
+    lru.push_front(h.value());
+    heights[hash] = h.value();
+    auto& e { entries.try_emplace(h.value(), Entry { hash, {}, {}, lru.begin() }).first->second };
+    budget().set_usage(entries.size() * approxEntryBytes);
+    return e;
+}
+
+void RecentBlocks::insert(const API::Block& b)
+{
+    std::unique_lock l(mutex);
+    entry(b.height, b.header.hash()).block = b;
+}
+
+void RecentBlocks::insert(NonzeroHeight h, const Hash& hash, RawBody body)
+{
+    std::unique_lock l(mutex);
+    entry(h, hash).body = std::move(body);
+}
+
+void RecentBlocks::erase_above(Height h)
+{
+    for (auto iter { entries.upper_bound(h.value()) }; iter != entries.end();) {
+        heights.erase(iter->second.hash);
+        lru.erase(iter->second.lru);
+        iter = entries.erase(iter);
+    }
+    budget().set_usage(entries.size() * approxEntryBytes);
+}
+
+void RecentBlocks::apply(const state_update::ChainstateUpdate& u)
+{
+    std::unique_lock l(mutex);
+    if (auto p { std::get_if<state_update::Fork>(&u) })
+        erase_above(p->shrinkLength);
+    else if (auto p { std::get_if<state_update::RollbackData>(&u) }; p && p->data)
+        erase_above(p->data->rollback.shrinkLength);
+}
+}
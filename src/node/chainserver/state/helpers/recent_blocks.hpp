@@ -0,0 +1,52 @@
+#pragma once
+#include "api/types/all.hpp"
+#include "chainserver/state/update/chainstate_update.hpp"
+#include "crypto/hash.hpp"
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace chainserver {
+// Bounded LRU of recent consensus blocks, parsed for API queries and raw
+// bodies for peers. Explorer and peer traffic concentrates on the chain
+// tip. Entries are keyed by height and dropped on rollback or fork.
+class RecentBlocks {
+public:
+    using RawBody = std::shared_ptr<const std::vector<uint8_t>>;
+    RecentBlocks(size_t capacity)
+        : capacity(capacity) {};
+
+    // confirmations are recomputed for the passed chain length
+    std::optional<API::Block> api_block(Height, Height chainlength) const;
+    std::optional<API::Block> api_block(const Hash&, Height chainlength) const;
+    RawBody body(NonzeroHeight, const Hash&) const;
+    // only blocks close to the tip are worth caching
+    bool near_tip(NonzeroHeight h, Height chainlength) const
+    {
+        return h.value() + capacity > chainlength.value();
+    }
+
+    void insert(const API::Block&);
+    void insert(NonzeroHeight, const Hash&, RawBody);
+    void apply(const state_update::ChainstateUpdate&);
+
+private:
+    struct Entry {
+        Hash hash;
+        std::optional<API::Block> block;
+        RawBody body;
+        std::list<uint32_t>::iterator lru;
+    };
+    // mutex must be held
+    Entry* find(uint32_t height) const;
+    Entry& entry(NonzeroHeight, const Hash&);
+    void erase_above(Height);
+
+    const size_t capacity;
+    mutable std::mutex mutex;
+    mutable std::list<uint32_t> lru; // heights, most recently used first
+    mutable std::map<uint32_t, Entry> entries;
+    std::map<Hash, uint32_t> heights;
+};
+}
@@ -0,0 +1,42 @@
+#include "undo_ring.hpp"
+#include "block/chain/header_chain.hpp"
+
+namespace chainserver {
+void UndoRing::push(Block b)
+{
+    shrink(b.height - 1);
+    if (!blocks.empty() && blocks.back().height + 1 != b.height)
+        blocks.clear();
+    blocks.push_back(std::move(b));
+    if (blocks.size() > capacity)
+        blocks.pop_front();
+}
+
+void UndoRing::append(UndoRing&& newer)
+{
+    for (auto& b : newer.blocks)
+        push(std::move(b));
+    newer.blocks.clear();
+}
+
+auto UndoRing::get(NonzeroHeight begin, Height end, const Headerchain& hc) const -> std::vector<const Block*>
+{
+    if (blocks.empty() || begin < blocks.front().height || end > blocks.back().height + 1)
+        return {};
+    std::vector<const Block*> res;
+    for (auto& b : blocks) {
+        if (b.height < begin || b.height >= end)
+            continue;
+        if (b.hash != hc.hash_at(b.height))
+            return {};
+        res.push_back(&b);
+    }
+    return res;
+}
+
+void UndoRing::shrink(Height length)
+{
+    while (!blocks.empty() && blocks.back().height > length)
+        blocks.pop_back();
+}
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include "block/body/primitives.hpp"
+#include "crypto/hash.hpp"
+#include <deque>
+
+class Headerchain;
+namespace chainserver {
+// Undo data and transfers of the most recent consensus blocks. Shallow
+// rollbacks at the tip take them from here instead of reading and parsing
+// bodies and undo blobs from the database.
+class UndoRing {
+public:
+    static constexpr size_t capacity = 8;
+    struct Block {
+        NonzeroHeight height;
+        Hash hash;
+        std::vector<TransferTxExchangeMessage> transfers; // body order
+        std::vector<uint8_t> undo;
+    };
+
+    void push(Block);
+    // blocks of the newer ring replace ours from their first height on
+    void append(UndoRing&& newer);
+    void shrink(Height length); // on rollback
+
+    // blocks begin..end-1 in chain order, empty unless all are present
+    // and match the passed headers
+    std::vector<const Block*> get(NonzeroHeight begin, Height end, const Headerchain&) const;
+
+private:
+    std::deque<Block> blocks;
+};
+}
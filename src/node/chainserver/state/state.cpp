@@ -9,15 +9,31 @@
 #include "block/header/generator.hpp"
 #include "block/header/header_impl.hpp"
 #include "communication/create_payment.hpp"
+#include "crypto/hasher_sha256.hpp"
 #include "db/chain_db.hpp"
+#include "db/chain_db_reader.hpp"
 #include "eventloop/types/chainstate.hpp"
+#include "general/block_latency.hpp"
 #include "general/hex.hpp"
+#include "general/metrics.hpp"
+#include "general/task_pool.hpp"
+#include "general/writer.hpp"
 #include "global/globals.hpp"
 #include "spdlog/spdlog.h"
+#include "api_reads.hpp"
 #include "transactions/apply_stage.hpp"
 #include "transactions/block_applier.hpp"
 #include <ranges>
 namespace chainserver {
+namespace {
+template <typename T>
+void push_event(const T& e)
+{
+    // no endpoint when driven without networking (wart-replay)
+    if (auto p { global().httpEndpoint })
+        p->push_event(e);
+}
+}
 
 State::State(ChainDB& db, BatchRegistry& br, std::optional<SnapshotSigner> snapshotSigner)
     : db(db)
@@ -26,7 +42,19 @@ State::State(ChainDB& db, BatchRegistry& br, std::optional<SnapshotSigner> snaps
     , signedSnapshot(db.get_signed_snapshot())
     , chainstate(db, br)
     , nextGarbageCollect(std::chrono::steady_clock::now())
+    , nextMaintenance(std::chrono::steady_clock::now())
 {
+    set_committed();
+    publish_headers();
+}
+
+State::~State()
+{
+    try {
+        commit_deferred();
+    } catch (const std::exception& e) {
+        spdlog::error("Cannot commit deferred chain database writes: {}", e.what());
+    }
 }
 
 std::optional<std::pair<NonzeroHeight, Header>> State::get_header(Height h) const
@@ -49,14 +77,7 @@ auto State::api_get_header(API::HeightOrHash& hh) const -> std::optional<std::pa
 
 std::optional<NonzeroHeight> State::consensus_height(const Hash& hash) const
 {
-    auto o { db.lookup_block_height(hash) };
-    if (!o.has_value())
-        return {};
-    auto& h { o.value() };
-    auto hash2 { chainstate.headers().get_hash(h) };
-    if (!hash2.has_value() || *hash2 != hash)
-        return {};
-    return h;
+    return chainstate.consensus_height(hash);
 }
 
 std::optional<Hash> State::get_hash(Height h) const
@@ -64,37 +85,6 @@ std::optional<Hash> State::get_hash(Height h) const
     return chainstate.headers().get_hash(h);
 }
 
-std::optional<API::Block> State::api_get_block(const API::HeightOrHash& hh) const
-{
-    if (std::holds_alternative<Height>(hh.data)) {
-        return api_get_block(std::get<Height>(hh.data));
-    }
-    auto h { consensus_height(std::get<Hash>(hh.data)) };
-    if (!h.has_value())
-        return {};
-    return api_get_block(*h);
-}
-
-std::optional<API::Block> State::api_get_block(Height zh) const
-{
-    if (zh == 0 || zh > chainlength())
-        return {};
-    auto h { zh.nonzero_assert() };
-    PinFloor pinFloor { PrevHeight(h) };
-    auto lower = chainstate.historyOffset(h);
-    auto upper = (h == chainlength() ? HistoryId { 0 }
-                                     : chainstate.historyOffset(h + 1));
-    auto entries = db.lookupHistoryRange(lower, upper);
-    auto header = chainstate.headers()[h];
-    API::Block b(header, h, chainlength() - h + 1);
-
-    chainserver::AccountCache cache(db);
-    for (auto [hash, data] : entries) {
-        b.push_history(hash, data, cache, pinFloor);
-    }
-    return b;
-}
-
 auto State::api_tx_cache() const -> const TransactionIds
 {
     return chainstate.txids();
@@ -133,7 +123,7 @@ std::optional<API::Transaction> State::api_get_tx(const HashView txHash) const
                 .toAddress = db.fetch_account(d.toAccountId).address,
                 .confirmations = (chainlength() - h) + 1,
                 .height = h,
-                .timestamp = chainstate.headers()[h].timestamp(),
+                .timestamp = chainstate.headers().timestamp_at(h),
                 .amount = d.amount,
                 .fromAddress = db.fetch_account(d.fromAccountId).address,
                 .fee = d.compactFee,
@@ -148,7 +138,7 @@ std::optional<API::Transaction> State::api_get_tx(const HashView txHash) const
                 .toAddress = db.fetch_account(d.toAccountId).address,
                 .confirmations = (chainlength() - h) + 1,
                 .height = h,
-                .timestamp = chainstate.headers()[h].timestamp(),
+                .timestamp = chainstate.headers().timestamp_at(h),
                 .amount = d.miningReward
             };
         }
@@ -156,7 +146,51 @@ std::optional<API::Transaction> State::api_get_tx(const HashView txHash) const
     return {};
 }
 
-auto State::api_get_latest_txs(size_t N) const -> API::TransactionsByBlocks
+auto State::api_get_tx_proof(const std::variant<Hash, HistoryId>& id) -> std::optional<API::TxProof>
+{
+    std::optional<std::pair<Hash, HistoryId>> entry;
+    if (auto hash { std::get_if<Hash>(&id) }) {
+        if (auto p { db.lookup_history(*hash) })
+            entry.emplace(*hash, p->second);
+    } else if (auto historyId { std::get<HistoryId>(id) }; historyId != HistoryId { 0 }) {
+        auto range { db.lookupHistoryRange(historyId, historyId + 1) };
+        if (!range.empty())
+            entry.emplace(range.front().first, historyId);
+    }
+    if (!entry)
+        return {};
+    auto& [txhash, historyId] { *entry };
+
+    const NonzeroHeight h { chainstate.history_height(historyId) };
+    auto bodies { get_blocks({ chainstate.descriptor(), h, h }) };
+    if (bodies.empty())
+        return {};
+    const BodyView bv { bodies.front().view() };
+    const size_t leaf { bv.leaf_offset_history() + (historyId - chainstate.historyOffset(h)) };
+    if (!bv.valid() || leaf >= bv.leaf_count())
+        return {};
+    auto data { bv.leaf_data(leaf) };
+    return API::TxProof {
+        .txhash = txhash,
+        .historyId = historyId,
+        .height = h,
+        .header = chainstate.headers()[h],
+        .leafIndex = leaf,
+        .leaf { data.begin(), data.end() },
+        .branch = bv.merkle_branch(h, leaf)
+    };
+}
+
+auto State::api_get_latest_txs(size_t N) -> API::TransactionsByBlocks
+{
+    if (auto res { latestTxs.get(N, chainlength()) })
+        return *res;
+    auto res { db_latest_txs(N) };
+    latestTxs.assign(res, db.next_history_id());
+    return res;
+}
+
+auto State::db_latest_txs(size_t N) const -> API::TransactionsByBlocks
 {
     HistoryId upper { db.next_history_id() };
     // note: history ids start with 1
@@ -184,7 +218,7 @@ auto State::api_get_latest_txs(size_t N) const -> API::TransactionsByBlocks
         auto id { upper - 1 - i };
         if (id < beginId) { // start new tmp block
             res.blocks_reversed.push_back(block);
-            tmp = update_tmp(upper - 1);
+            tmp = update_tmp(id);
         }
 
         auto& [hash, data] = lookup[lookup.size() - 1 - i];
@@ -195,33 +229,113 @@ auto State::api_get_latest_txs(size_t N) const -> API::TransactionsByBlocks
     return res;
 }
 
-void State::garbage_collect()
+bool State::garbage_collect(bool idle)
 {
     // garbage collect old unused blocks
     using namespace std::chrono;
-    if (auto n = steady_clock::now(); n > nextGarbageCollect) {
+    auto n = steady_clock::now();
+    if (!gcPending) {
+        if (n <= nextGarbageCollect)
+            return false;
+        gcPending = true;
+    }
+    if (!idle && n <= nextGarbageCollect + maxGcDelay)
+        return true;
+    commit_deferred();
+    auto tr = db.transaction();
+    const bool done { blockCache.garbage_collect(db, gcChunk, n + gcSlice) };
+    if (done) {
+        prune_blocks();
+        gcPending = false;
         nextGarbageCollect = n + minutes(5);
-        auto tr = db.transaction();
-        blockCache.garbage_collect(db);
-        tr.commit();
     }
+    tr.commit();
+    return !done;
+}
+
+bool State::maintain_db(bool idle)
+{
+    using namespace std::chrono;
+    auto n = steady_clock::now();
+    if (!idle || gcPending || (!vacuuming && n <= nextMaintenance))
+        return false;
+    commit_deferred();
+    static auto& freeGauge { metrics::gauge("warthog_db_free_pages",
+        "Unused pages in the chain database file") };
+    static auto& walGauge { metrics::gauge("warthog_db_wal_bytes",
+        "Size of the chain database WAL file") };
+    const auto s { db.space_stats() };
+    freeGauge.set(s.freePages);
+    walGauge.set(int64_t(s.walBytes));
+
+    // start above 5% free pages and continue down to 1%
+    if (db.incremental_vacuum_enabled()) {
+        if (s.freePages >= vacuumPages && s.freePages * 20 > s.pages)
+            vacuuming = true;
+        else if (s.freePages * 100 <= s.pages || s.freePages == 0)
+            vacuuming = false;
+        if (vacuuming) {
+            db.incremental_vacuum(vacuumPages);
+            return true;
+        }
+    }
+
+    // passive checkpoints copy what was written since the last one, the
+    // WAL file is only reset when it grew large and readers allow it
+    nextMaintenance = n + maintenanceInterval;
+    if (s.walBytes == 0)
+        return false;
+    if (db.checkpoint_wal(false) && s.walBytes >= walTruncateBytes) {
+        if (db.checkpoint_wal(true))
+            spdlog::debug("Reset WAL file of {} MiB", s.walBytes >> 20);
+    }
+    return false;
+}
+
+void State::prune_blocks()
+{
+    // keep what is needed to roll back to the signed snapshot and
+    // to load the transaction ids of the chain
+    std::optional<Height> finalized;
+    if (signedSnapshot)
+        finalized = TransactionIds::block_range(signedSnapshot->height()).first - 1;
+
+    if (config().data.archiveBlocks) {
+        if (finalized && db.archive_blocks(*finalized))
+            spdlog::debug("Archived block bodies up to height {}", db.archived_height().value());
+        return;
+    }
+    const auto depth { config().data.pruneDepth };
+    if (depth == 0 || chainlength().value() <= depth)
+        return;
+    Height upper { chainlength() - depth };
+    if (finalized && finalized->value() < upper.value())
+        upper = *finalized;
+    // bound transaction size on first pruning of a long chain
+    const Height pruned { db.pruned_height() };
+    if (upper.value() > pruned.value() + 10000)
+        upper = pruned + 10000;
+    if (upper.value() <= pruned.value())
+        return;
+    spdlog::debug("Pruning block bodies up to height {}", upper.value());
+    db.prune_blocks(upper, config().data.pruneHistory);
 }
 
 Batch State::get_headers_concurrent(BatchSelector s)
 {
-    std::unique_lock<std::mutex> lcons(chainstateMutex);
-    if (s.descriptor == chainstate.descriptor()) {
-        return chainstate.headers().get_headers(s.startHeight, s.end());
+    auto p { publishedHeaders.load(std::memory_order_acquire) };
+    if (s.descriptor == p->descriptor) {
+        return p->headers.get_headers(s.startHeight, s.end());
     } else {
         return blockCache.get_batch(s);
     }
 }
 
-std::optional<HeaderView> State::get_header_concurrent(Descriptor descriptor, Height height)
+std::optional<Header> State::get_header_concurrent(Descriptor descriptor, Height height)
 {
-    std::unique_lock<std::mutex> lcons(chainstateMutex);
-    if (descriptor == chainstate.descriptor()) {
-        return chainstate.headers().get_header(height);
+    auto p { publishedHeaders.load(std::memory_order_acquire) };
+    if (descriptor == p->descriptor) {
+        return p->headers.get_header(height);
     } else {
         return blockCache.get_header(descriptor, height);
     }
@@ -229,28 +343,91 @@ std::optional<HeaderView> State::get_header_concurrent(Descriptor descriptor, He
 
 ConsensusSlave State::get_chainstate_concurrent()
 {
-    std::unique_lock<std::mutex> l(chainstateMutex);
-    return { signedSnapshot, chainstate.descriptor(), chainstate.headers() };
+    auto p { publishedHeaders.load(std::memory_order_acquire) };
+    return { p->signedSnapshot, p->descriptor, p->headers };
+}
+
+void State::publish_headers()
+{
+    // chains replaced by a fork are in the block cache before their
+    // descriptor is unpublished
+    publishedHeaders.store(std::make_shared<const PublishedHeaders>(PublishedHeaders {
+                               .signedSnapshot { signedSnapshot },
+                               .descriptor { chainstate.descriptor() },
+                               .headers { chainstate.headers() } }),
+        std::memory_order_release);
+}
+
+auto State::api_get_block_concurrent(ChainDBReader& r, const API::HeightOrHash& hoh) -> std::optional<API::Block>
+{
+    return read_chainstate_concurrent([&](const Chainstate& cs, Height committed) -> std::optional<API::Block> {
+        const Height length { cs.length() };
+        auto cached { std::holds_alternative<Height>(hoh.data)
+                ? recentBlocks.api_block(std::get<Height>(hoh.data), length)
+                : recentBlocks.api_block(std::get<Hash>(hoh.data), length) };
+        if (cached)
+            return cached;
+        auto b { api_reads::block(r, cs, committed, hoh) };
+        if (b && recentBlocks.near_tip(b->height, length))
+            recentBlocks.insert(*b);
+        return b;
+    });
+}
+
+auto State::api_get_blocks_concurrent(ChainDBReader& r, NonzeroHeight from, Height to) -> std::vector<API::Block>
+{
+    return read_chainstate_concurrent([&](const Chainstate& cs, Height committed) {
+        return api_reads::blocks(r, cs, committed, from, to);
+    });
 }
 
 MiningTask State::mining_task(const Address& a, bool log)
 {
     auto md = chainstate.mining_data();
 
-    auto payments { chainstate.mempool().get_payments(50,log) };
-    Funds totalfee { 0 };
-    for (auto& p : payments)
-        totalfee += p.fee();
+    auto& blockTemplate { chainstate.mempool().block_template(50, log) };
+    NonzeroHeight height { (chainlength() + 1).nonzero_assert() };
+
+    const auto version { mining_version() };
+    if (miningTemplate && miningTemplate->version != version)
+        miningTemplate.reset();
+    if (miningTemplate) {
+        // a new payout address would shift the ids of the new addresses
+        // in the body, these tasks are generated from scratch
+        if (auto p { db.lookup_address(a) }) {
+            auto& t { *miningTemplate };
+            auto body { t.body };
+            auto reward { body.data().data() + t.rewardOffset };
+            const uint64_t id { hton64(std::get<0>(*p).value()) };
+            memcpy(reward, &id, 8);
+            const auto leaf { hashSHA256(reward, BodyView::RewardSize) };
+            HeaderGenerator hg(md.prevhash, t.rewardBranch.root(leaf), md.target, md.timestamp);
+            return { .block {
+                .height = height,
+                .header = hg.serialize(0),
+                .body = std::move(body),
+            } };
+        }
+    }
+
     std::vector<Payout>
-        payouts { { a, md.reward + totalfee } };
+        payouts { { a, md.reward + blockTemplate.totalFee } };
 
     // mempool should have deleted out of window transactions
-    auto body { generate_body(db, (chainlength() + 1).nonzero_assert(), payouts, payments) };
+    auto body { generate_body(db, height, payouts, blockTemplate.payments) };
     BodyView bv(body.view());
     if (!bv.valid())
         spdlog::error("Cannot create mining task, body invalid");
+    else if (!miningTemplate && db.lookup_address(a)) {
+        const auto leaf { bv.leaf_offset_history() }; // the single reward
+        miningTemplate = MiningTemplate {
+            .version = version,
+            .body = body,
+            .rewardOffset = size_t(bv.leaf_data(leaf).data() - body.data().data()),
+            .rewardBranch = bv.merkle_branch(height, leaf),
+        };
+    }
 
-    NonzeroHeight height{(chainlength() + 1).nonzero_assert()};
     HeaderGenerator hg(md.prevhash, bv, md.target, md.timestamp, height);
     return { .block {
         .height = height,
@@ -266,7 +443,7 @@ stage_operation::StageSetResult State::set_stage(Headerchain&& hc)
     }
 
     auto l { hc.length() };
-    auto t = db.transaction();
+    auto t { begin_transaction() };
     NonzeroHeight fh1 { fork_height(chainstate.headers(), hc) };
     NonzeroHeight fh2 { fork_height(stage, hc) };
     std::optional<NonzeroHeight> newProtectBegin;
@@ -294,7 +471,7 @@ stage_operation::StageSetResult State::set_stage(Headerchain&& hc)
             break;
         db.protect_stage_assert_scheduled(*id);
     }
-    t.commit();
+    commit(t);
 
     stage.shrink(h - 1);
     if (h > newProtectBegin) {
@@ -305,19 +482,53 @@ stage_operation::StageSetResult State::set_stage(Headerchain&& hc)
     return { h };
 }
 
-auto State::add_stage(const std::vector<Block>& blocks, const Headerchain& hc) -> std::pair<stage_operation::StageAddResult, std::optional<StateUpdate>>
+namespace {
+metrics::Histogram& add_stage_phase(std::string_view phase)
 {
+    return metrics::histogram("warthog_add_stage_phase_seconds",
+        "Duration of the phases of adding blocks to the stage", { { "phase", phase } });
+}
+}
+
+auto State::add_stage(const std::vector<Block>& blocks, const Headerchain& hc, bool bodiesChecked) -> std::pair<stage_operation::StageAddResult, std::optional<StateUpdate>>
+{
+    static auto& bodyPhase { add_stage_phase("body_checks") };
+    static auto& insertPhase { add_stage_phase("insert") };
+    static auto& applyPhase { add_stage_phase("apply") };
+    static auto& commitPhase { add_stage_phase("commit") };
     if (signedSnapshot && !signedSnapshot->compatible(stage)) {
         return { { { ELEADERMISMATCH, signedSnapshot->height() } }, {} };
     }
 
     assert(blocks.size() > 0);
+    block_latency::mark(block_latency::Stage::Staged, blocks.front().height, blocks.back().height);
     ChainError err { Error(0), blocks.back().height + 1 };
-    auto transaction = db.transaction();
+    auto transaction { begin_transaction() };
+    for (auto& b : blocks)
+        deferredBytes += b.body.size();
 
     assert(hc.length() >= stage.length());
     assert(hc.hash_at(stage.length()) == stage.hash_at(stage.length()));
-    for (auto& b : blocks) {
+
+    // body checks do not depend on the stage, run them in parallel
+    // ahead of the sequential header and database pass unless the
+    // downloader already did
+    std::vector<int32_t> bodyErrors(blocks.size(), 0);
+    if (!bodiesChecked) {
+        metrics::ScopeTimer st(bodyPhase);
+        task_pool().parallel_for(blocks.size(), [&](size_t i) {
+            auto& b { blocks[i] };
+            BodyView bv(b.body.view());
+            if (!bv.valid())
+                bodyErrors[i] = EMALFORMED;
+            else if (b.header.merkleroot() != bv.merkleRoot(b.height))
+                bodyErrors[i] = EMROOT;
+        });
+    }
+
+    std::optional<metrics::ScopeTimer> insertTimer(std::in_place, insertPhase);
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        auto& b { blocks[i] };
         assert(hc.length() >= b.height);
         assert(hc[b.height] == b.header);
 
@@ -328,24 +539,24 @@ auto State::add_stage(const std::vector<Block>& blocks, const Headerchain& hc) -
             err = { prepared.error(), b.height };
             break;
         }
-        BodyView bv(b.body.view());
-        if (b.header.merkleroot() != bv.merkleRoot(b.height)) {
-            err = { EMROOT, b.height };
-            break;
-        }
-        if (!bv.valid()) {
-            err = { EMALFORMED, b.height };
+        if (bodyErrors[i] != 0) {
+            err = { bodyErrors[i], b.height };
             break;
         }
         db.insert_protect(b);
         stage.append(prepared.value(), batchRegistry);
     }
+    insertTimer.reset();
     if (stage.total_work() > chainstate.headers().total_work()) {
+        metrics::ScopeTimer st(applyPhase);
         auto [error, update, apiBlocks] { apply_stage(std::move(transaction)) };
 
         // publish websocket events
         for (auto& b : apiBlocks) {
-            http_endpoint().push_event(b);
+            block_latency::mark(block_latency::Stage::Applied, b.height);
+            feeEstimator.on_block(b);
+            latestTxs.push(b, chainstate.historyOffset(b.height));
+            push_event(b);
         }
 
         if (error.is_error())
@@ -353,7 +564,8 @@ auto State::add_stage(const std::vector<Block>& blocks, const Headerchain& hc) -
         else
             return { { err }, update };
     } else {
-        transaction.commit();
+        metrics::ScopeTimer st(commitPhase);
+        commit(transaction);
         return { { err }, {} };
     }
 }
@@ -367,50 +579,69 @@ RollbackResult State::rollback(const Height newlength) const
     const PinFloor newPinFloor { PrevHeight(beginHeight) };
     Height endHeight(chainlength() + 1);
 
-    // load ids
-    auto ids { db.consensus_block_ids(beginHeight, endHeight) };
-    assert(ids.size() == endHeight - beginHeight);
+    // stream undo data from the tip down, the pre-fork balance of an
+    // account is the one recorded by the lowest block touching it, such
+    // that every touched account is written exactly once
     std::optional<AccountId> oldAccountStart;
     std::map<AccountId, Funds> balanceMap;
-    for (size_t i = 0; i < ids.size(); ++i) {
-        const auto id { ids[i] };
-        NonzeroHeight height = beginHeight + i;
-        PinFloor pinFloor { PrevHeight(height) };
-        auto u = db.get_block_undo(id);
-        if (!u)
-            throw std::runtime_error("Database corrupted (could not load block)");
-        auto& [header, body, undo] = *u;
-
-        BodyView bv(body);
-        if (!bv.valid())
-            throw std::runtime_error(
-                "Database corrupted (invalid block body at height " + std::to_string(height) + ".");
-
-        for (auto t : bv.transfers()) {
-            PinHeight pinHeight = t.pinHeight(pinFloor);
-            if (pinHeight <= newPinFloor) {
-                // extract transaction to mempool
-                auto toAddress { db.lookup_account(t.toAccountId())->address };
-                toMempool.push_back(
-                    TransferTxExchangeMessage(t, pinHeight, toAddress));
-            }
-        }
-
-        // roll back state modifications
+    auto restore_balances = [&](std::span<const uint8_t> undo) {
         RollbackView rbv(undo);
-        if (i == 0) {
-            oldAccountStart = rbv.getBeginNewAccounts();
-        }
+        oldAccountStart = rbv.getBeginNewAccounts();
         const size_t N = rbv.nAccounts();
         for (size_t j = 0; j < N; ++j) {
             auto entry = rbv.accountBalance(j);
-            const Funds bal { entry.balance() };
             const AccountId id { entry.id() };
-            if (id < oldAccountStart) {
-                balanceMap.try_emplace(id, bal);
-            }
+            if (id < oldAccountStart)
+                balanceMap.insert_or_assign(id, entry.balance());
         }
+    };
+
+    // shallow rollbacks are served from memory
+    auto recent { undoRing.get(beginHeight, endHeight, chainstate.headers()) };
+    for (auto iter { recent.rbegin() }; iter != recent.rend(); ++iter) {
+        auto& b { **iter };
+        const size_t n0 { toMempool.size() };
+        for (auto& t : b.transfers) {
+            if (t.pin_height() <= newPinFloor)
+                toMempool.push_back(t);
+        }
+        std::reverse(toMempool.begin() + n0, toMempool.end());
+        restore_balances(b.undo);
     }
+
+    std::map<AccountId, Address> toAddresses;
+    if (recent.empty()) {
+        db.visit_consensus_undo(beginHeight, endHeight, [&](NonzeroHeight height, std::span<const uint8_t> body, std::span<const uint8_t> undo) {
+            PinFloor pinFloor { PrevHeight(height) };
+            BodyView bv(body);
+            if (!bv.valid())
+                throw std::runtime_error(
+                    "Database corrupted (invalid block body at height " + std::to_string(height) + ".");
+
+            const size_t n0 { toMempool.size() };
+            for (auto t : bv.transfers()) {
+                PinHeight pinHeight = t.pinHeight(pinFloor);
+                if (pinHeight <= newPinFloor) {
+                    // extract transaction to mempool
+                    auto iter { toAddresses.find(t.toAccountId()) };
+                    if (iter == toAddresses.end())
+                        iter = toAddresses.emplace(t.toAccountId(), db.lookup_account(t.toAccountId())->address).first;
+                    toMempool.push_back(
+                        TransferTxExchangeMessage(t, pinHeight, iter->second));
+                }
+            }
+            // reversed per block here and once overall below to restore chain order
+            std::reverse(toMempool.begin() + n0, toMempool.end());
+
+            // roll back state modifications
+            restore_balances(undo);
+        });
+    }
+    // transactions in chain order
+    std::reverse(toMempool.begin(), toMempool.end());
+
+    // accounts created after the fork are deleted below
+    balanceMap.erase(balanceMap.lower_bound(*oldAccountStart), balanceMap.end());
     db.delete_history_from((newlength + 1).nonzero_assert());
     db.delete_state_from(*oldAccountStart);
     auto dk { db.delete_consensus_from((newlength + 1).nonzero_assert()) };
@@ -443,6 +674,7 @@ auto State::apply_stage(ChainDBTransaction&& t) -> std::tuple<ChainError, std::o
             db.delete_bad_block(stage.hash_at(h));
         stage.shrink(error.height() - 1);
         if (stage.total_work_at(error.height() - 1) <= chainstate.headers().total_work()) {
+            tr.discard(*this);
             return { error, {}, {} };
         }
     }
@@ -469,12 +701,16 @@ auto State::apply_signed_snapshot(SignedSnapshot&& ssnew) -> std::optional<State
             .signedSnapshot { *signedSnapshot } },
         .mempoolUpdate {},
     };
+    commit_deferred();
     auto db_t { db.transaction() };
+    std::unique_lock ul(chainstateMutex, std::defer_lock); // held until commit for API readers
     if (!signedSnapshot->compatible(chainstate.headers())) {
         assert(signedSnapshot->height() <= chainlength());
         auto rb { rollback(signedSnapshot->height() - 1) };
+        push_event(API::Rollback { rb.shrinkLength });
 
-        std::unique_lock<std::mutex> ul(chainstateMutex);
+        ul.lock();
+        undoRing.shrink(rb.shrinkLength);
         auto headers_ptr { blockCache.add_old_chain(chainstate, rb.deletionKey) };
 
         res.chainstateUpdate = state_update::RollbackData {
@@ -484,23 +720,30 @@ auto State::apply_signed_snapshot(SignedSnapshot&& ssnew) -> std::optional<State
             } },
             .signedSnapshot { *signedSnapshot }
         };
-        res.mempoolUpdate = chainstate.pop_mempool_log();
+        res.mempoolUpdate = pop_mempool_log();
+        recentBlocks.apply(res.chainstateUpdate);
+        latestTxs.apply(res.chainstateUpdate);
     } else {
         assert(chainstate.pop_mempool_log().size() == 0);
     };
 
+    publish_headers();
     db.set_consensus_work(chainstate.headers().total_work());
     db.set_signed_snapshot(*signedSnapshot);
     db_t.commit();
+    set_committed();
 
     return res;
 }
 
-auto State::append_mined_block(const Block& b) -> StateUpdate
+auto State::append_mined_block(const Block& b, bool pushed) -> std::optional<StateUpdate>
 {
     auto nextHeight { (chainlength() + 1).nonzero_assert() };
     if (nextHeight != b.height)
         throw Error(EMINEDDEPRECATED);
+    // pushed blocks might also have been downloaded into the stage
+    if (pushed && db.lookup_block_id(b.header.hash()))
+        throw Error(EMINEDDEPRECATED);
     BodyView bv(b.body.view());
     auto prepared { chainstate.prepare_append(signedSnapshot, b.header) };
     if (!prepared.has_value())
@@ -511,11 +754,13 @@ auto State::append_mined_block(const Block& b) -> StateUpdate
         throw Error(EMALFORMED);
     if (chainlength() + 1 != b.height)
         throw Error(EBADHEIGHT);
+    block_latency::begin(b.height, block_latency::Stage::Staged);
 
     const auto nextAccountId { db.next_state_id() };
     const auto nextHistoryId { db.next_history_id() };
 
     // do db transaction for new block
+    commit_deferred();
     auto transaction = db.transaction();
 
     auto [blockId, inserted] { db.insert_protect(b) };
@@ -524,27 +769,27 @@ auto State::append_mined_block(const Block& b) -> StateUpdate
         throw Error(EMINEDDEPRECATED);
     }
 
-    chainserver::BlockApplier e { db, chainstate.headers(), chainstate.txids(), false };
+    chainserver::BlockApplier e { db, chainstate.headers(), chainstate.txids(), task_pool(), chainstate.signature_cache(), false };
     auto apiBlock { e.apply_block(bv, b.header, nextHeight, blockId) };
-    http_endpoint().push_event(apiBlock);
+    block_latency::mark(block_latency::Stage::Applied, nextHeight);
+    feeEstimator.on_block(apiBlock);
+    latestTxs.push(apiBlock, nextHistoryId);
+    push_event(apiBlock);
     db.set_consensus_work(chainstate.work_with_new_block());
-    transaction.commit();
 
-    std::unique_lock<std::mutex> ul(chainstateMutex);
+    undoRing.append(e.move_undo());
+    std::unique_lock ul(chainstateMutex);
     auto headerchainAppend = chainstate.append(Chainstate::AppendSingle {
         .signedSnapshot { signedSnapshot },
         .prepared { prepared.value() },
         .newTxIds { e.move_new_txids() },
         .newHistoryOffset { nextHistoryId },
         .newAccountOffset { nextAccountId } });
-    ul.unlock();
-
-    return {
-        .chainstateUpdate { state_update::Append {
-            headerchainAppend,
-            try_sign_chainstate() } },
-        .mempoolUpdate { chainstate.pop_mempool_log() }
-    };
+    return publish_commit({ .chainstateUpdate { state_update::Append {
+                                headerchainAppend,
+                                try_sign_chainstate() } },
+                              .mempoolUpdate { pop_mempool_log() } },
+        transaction);
 }
 
 tl::expected<mempool::Log, Error> State::append_gentx(const PaymentCreateMessage& m)
@@ -555,32 +800,54 @@ tl::expected<mempool::Log, Error> State::append_gentx(const PaymentCreateMessage
         return tl::make_unexpected(err);
     }
     spdlog::info("Added new transaction to mempool");
-    return chainstate.pop_mempool_log();
+    return pop_mempool_log();
 }
 
-API::Balance State::api_get_address(AddressView address)
+auto State::append_gentxs(const API::PaymentCreateBatch& b) -> std::pair<std::vector<int32_t>, mempool::Log>
 {
-    if (auto p = db.lookup_address(address); p) {
-        return API::Balance {
-            std::get<0>(*p),
-            std::get<1>(*p)
-        };
-    } else {
-        return API::Balance {
-            AccountId { 0 },
-            Funds { 0 }
-        };
+    std::vector<int32_t> res;
+    res.reserve(b.entries.size());
+    auto accounts { chainstate.lookup_senders(b.entries) };
+    size_t added { 0 };
+    for (auto& e : b.entries) {
+        res.push_back(e ? chainstate.insert_tx(*e, accounts) : e.error());
+        if (res.back() == 0)
+            added += 1;
     }
+    spdlog::info("Added {} of {} new transactions to mempool", added, b.entries.size());
+    return { res, pop_mempool_log() };
 }
 
 auto State::insert_txs(const TxVec& txs) -> std::pair<std::vector<int32_t>, mempool::Log>
 {
-    std::vector<int32_t> res;
-    res.reserve(txs.size());
-    for (auto& tx : txs) {
-        res.push_back(chainstate.insert_tx(tx));
+    auto res { chainstate.insert_txs(txs) };
+    return { std::move(res), pop_mempool_log() };
+}
+
+mempool::Log State::pop_mempool_log()
+{
+    auto log { chainstate.pop_mempool_log() };
+    feeEstimator.on_mempool(log, chainlength());
+    if (!log.empty()) {
+        API::MempoolChange c;
+        for (auto& a : log) {
+            std::visit([&](auto& action) {
+                using T = std::decay_t<decltype(action)>;
+                if constexpr (std::is_same_v<T, mempool::Put>)
+                    c.added.push_back({ action.entry.first, action.entry.second.hash });
+                else
+                    c.removed.push_back(action.id);
+            },
+                a);
+        }
+        push_event(c);
     }
-    return { res, chainstate.pop_mempool_log() };
+    return log;
+}
+
+auto State::api_get_fee_estimate() const -> API::FeeEstimate
+{
+    return feeEstimator.estimate(chainlength());
 }
 
 API::Head State::api_get_head() const
@@ -598,86 +865,60 @@ API::Head State::api_get_head() const
     };
 }
 
-auto State::api_get_mempool(size_t) -> API::MempoolEntries
+auto State::mempool_payments() const -> TxVec
 {
-    std::vector<Hash> hashes;
-    auto entries = chainstate.mempool().get_payments(100, false, &hashes);
-    assert(hashes.size() == entries.size());
-    API::MempoolEntries out;
-    for (size_t i = 0; i < hashes.size(); ++i) {
-        out.entries.push_back(API::MempoolEntry {
-            entries[i], hashes[i] });
-    }
-    return out;
+    auto& mp { chainstate.mempool() };
+    return mp.get_payments(mp.size(), false);
 }
 
-auto State::api_get_history(Address a, uint64_t beforeId) -> std::optional<API::AccountHistory>
+auto State::api_get_mempool(size_t offset, uint32_t limit, std::optional<Address> address) const -> API::MempoolPage
 {
-    auto p = db.lookup_address(a);
-    if (!p)
-        return {};
-    auto& [accountId, balance] = *p;
-
-    std::vector entries_desc = db.lookup_history_100_desc(accountId, beforeId);
-    std::vector<API::Block> blocks_reversed;
-    PinFloor pinFloor { 0 };
-    auto firstHistoryId = HistoryId { 0 };
-    auto nextHistoryOffset = HistoryId { 0 };
-    chainserver::AccountCache cache(db);
-
-    auto prevHistoryId = HistoryId { 0 };
-    for (auto iter = entries_desc.rbegin(); iter != entries_desc.rend();++iter) {
-        auto& [historyId, txid, data] =*iter;
-        if (firstHistoryId == HistoryId { 0 })
-            firstHistoryId = historyId;
-        assert(prevHistoryId < historyId);
-        prevHistoryId = historyId;
-        if (historyId >= nextHistoryOffset) {
-            auto height { chainstate.history_height(historyId) };
-            pinFloor = PinFloor(PrevHeight(height));
-            auto header = chainstate.headers()[height];
-            bool b = height == chainlength();
-            nextHistoryOffset = (b
-                    ? HistoryId { std::numeric_limits<uint64_t>::max() }
-                    : chainstate.historyOffset(height + 1));
-            blocks_reversed.push_back(
-                API::Block(header, height, 1 + (chainlength() - height)));
-        }
-        API::Block& b = blocks_reversed.back();
-        b.push_history(txid, data, cache, pinFloor);
-    }
-
-    return API::AccountHistory {
-        .balance = balance,
-        .fromId = firstHistoryId,
-        .blocks_reversed = blocks_reversed
+    return {
+        .snapshot { chainstate.mempool().snapshot() },
+        .offset = offset,
+        .limit = limit,
+        .address { std::move(address) }
     };
 }
 
-auto State::api_get_richlist(size_t N) -> API::Richlist
-{
-    return db.lookup_richlist(N);
-}
-
-auto State::get_blocks(DescriptedBlockRange range) -> std::vector<BodyContainer>
+auto State::block_hashes(DescriptedBlockRange range) const -> std::optional<std::vector<Hash>>
 {
     assert(range.lower != 0);
     assert(range.upper >= range.lower);
-    std::vector<Hash> hashes(range.upper - range.lower + 1);
-    std::vector<BodyContainer> res;
+    if (range.lower <= db.pruned_height())
+        return {}; // bodies not available
     if (range.descriptor == chainstate.descriptor()) {
         if (chainstate.length() < range.upper)
             return {};
+        std::vector<Hash> hashes(range.upper - range.lower + 1);
         for (Height h = range.lower; h < range.upper + 1; ++h) {
             hashes[h - range.lower] = chainstate.headers().hash_at(h);
         }
-    } else {
-        hashes = blockCache.get_hashes(range);
+        return hashes;
     }
-    for (size_t i = 0; i < hashes.size(); ++i) {
-        auto hash { hashes[i] };
+    return blockCache.get_hashes(range);
+}
+
+auto State::get_blocks(DescriptedBlockRange range) -> std::vector<BodyContainer>
+{
+    auto hashes { block_hashes(range) };
+    if (!hashes)
+        return {};
+    const bool consensus { range.descriptor == chainstate.descriptor() };
+    std::vector<BodyContainer> res;
+    for (size_t i = 0; i < hashes->size(); ++i) {
+        auto& hash { (*hashes)[i] };
+        const NonzeroHeight h { range.lower + i };
+        if (consensus) {
+            if (auto cached { recentBlocks.body(h, hash) }) {
+                res.push_back(*cached);
+                continue;
+            }
+        }
         auto b { db.get_block(hash) };
         if (b) {
+            if (consensus && recentBlocks.near_tip(h, chainlength()))
+                recentBlocks.insert(h, hash, std::make_shared<const std::vector<uint8_t>>(b->second.body.data()));
             res.push_back(std::move(b->second.body));
         } else {
             spdlog::error("BUG: no block with hash {} in db.", serialize_hex(hash));
@@ -687,6 +928,57 @@ auto State::get_blocks(DescriptedBlockRange range) -> std::vector<BodyContainer>
     return res;
 }
 
+auto State::get_blockrep(DescriptedBlockRange range, uint32_t nonce) -> std::optional<Sndbuffer>
+{
+    auto hashes { block_hashes(range) };
+    if (!hashes)
+        return {};
+    const bool consensus { range.descriptor == chainstate.descriptor() };
+    std::vector<RecentBlocks::RawBody> cached(hashes->size());
+    std::vector<size_t> lengths;
+    lengths.reserve(hashes->size());
+    // ranges longer than MAXBLOCKBATCHSIZE are answered with the prefix
+    // that fits into the byte budget
+    const bool budgeted { range.length() > MAXBLOCKBATCHSIZE };
+    size_t size { 4 };
+    for (size_t i = 0; i < hashes->size(); ++i) {
+        auto& hash { (*hashes)[i] };
+        if (consensus)
+            cached[i] = recentBlocks.body(range.lower + i, hash);
+        size_t n;
+        if (cached[i]) {
+            n = cached[i]->size();
+        } else {
+            auto s { db.body_size(hash) };
+            if (!s) {
+                spdlog::error("BUG: no block with hash {} in db.", serialize_hex(hash));
+                return {};
+            }
+            n = *s;
+        }
+        size += 4 + n;
+        if (budgeted && i > 0 && size > BlockrepMsg::maxSize)
+            break;
+        lengths.push_back(n);
+    }
+    return BlockrepMsg::direct_send(nonce, lengths, [&](size_t i, Writer& w) {
+        if (cached[i]) {
+            w << Range(*cached[i]);
+            return true;
+        }
+        const NonzeroHeight h { range.lower + i };
+        bool ok { false };
+        bool found { db.visit_body((*hashes)[i], [&](std::span<const uint8_t> body) {
+            if (!(ok = (body.size() == lengths[i])))
+                return;
+            w << Range(body.data(), body.size());
+            if (consensus && recentBlocks.near_tip(h, chainlength()))
+                recentBlocks.insert(h, (*hashes)[i], std::make_shared<const std::vector<uint8_t>>(body.begin(), body.end()));
+        }) };
+        return found && ok;
+    });
+}
+
 auto State::get_mempool_tx(TransactionId txid) const -> std::optional<TransferTxExchangeMessage>
 {
     return chainstate.mempool()[txid];
@@ -696,7 +988,12 @@ auto State::commit_fork(RollbackResult&& rr, AppendBlocksResult&& abr) -> StateU
 {
     assert(!signedSnapshot || signedSnapshot->compatible(stage));
     auto forkHeight { (rr.shrinkLength + 1).nonzero_assert() };
+    push_event(API::Rollback { rr.shrinkLength });
     auto headers_ptr { blockCache.add_old_chain(chainstate, rr.deletionKey) };
+    undoRing.shrink(rr.shrinkLength);
+    undoRing.append(std::move(abr.undo));
+    if (rr.shrinkLength.value() < committedLength.load(std::memory_order_relaxed))
+        committedLength.store(rr.shrinkLength.value(), std::memory_order_release);
     chainstate.fork(chainserver::Chainstate::ForkData {
         .stage { stage },
         .rollbackResult { std::move(rr) },
@@ -709,15 +1006,19 @@ auto State::commit_fork(RollbackResult&& rr, AppendBlocksResult&& abr) -> StateU
         try_sign_chainstate()
     };
 
-    return StateUpdate {
+    StateUpdate res {
         .chainstateUpdate { std::move(forkMsg) },
-        .mempoolUpdate { chainstate.pop_mempool_log() },
+        .mempoolUpdate { pop_mempool_log() },
     };
+    recentBlocks.apply(res.chainstateUpdate);
+    latestTxs.apply(res.chainstateUpdate);
+    return res;
 }
 
 auto State::commit_append(AppendBlocksResult&& abr) -> StateUpdate
 {
     assert(!signedSnapshot || signedSnapshot->compatible(stage));
+    undoRing.append(std::move(abr.undo));
     auto headerchainAppend { chainstate.append(Chainstate::AppendMulti {
         .patchedChain = stage,
         .appendResult { std::move(abr) },
@@ -729,10 +1030,75 @@ auto State::commit_append(AppendBlocksResult&& abr) -> StateUpdate
                 headerchainAppend,
                 try_sign_chainstate(),
             } },
-        .mempoolUpdate { chainstate.pop_mempool_log() }
+        .mempoolUpdate { pop_mempool_log() }
     };
 }
 
+auto State::publish_commit(StateUpdate&& update, ChainDBTransaction& transaction) -> std::optional<StateUpdate>
+{
+    publish_headers();
+    if (!publisher) {
+        commit(transaction);
+        return std::move(update);
+    }
+    publisher(std::move(update));
+    try {
+        commit(transaction);
+    } catch (...) {
+        // the in-memory chain state is ahead of the database, same as
+        // for a failed commit without publisher
+        spdlog::critical("Database commit of published chain state failed");
+        throw;
+    }
+    return {};
+}
+
+ChainDBTransaction State::begin_transaction()
+{
+    if (!deferredTransaction) {
+        deferredSince = std::chrono::steady_clock::now();
+        deferredBytes = 0;
+        return db.transaction();
+    }
+    ChainDBTransaction t { std::move(*deferredTransaction) };
+    deferredTransaction.reset();
+    t.set_savepoint();
+    return t;
+}
+
+void State::commit(ChainDBTransaction& t)
+{
+    if (groupCommit && deferredBytes < maxDeferredBytes
+        && std::chrono::steady_clock::now() < deferredSince + maxDeferredAge) {
+        deferredTransaction = std::make_unique<ChainDBTransaction>(std::move(t));
+        return;
+    }
+    t.commit();
+    set_committed();
+    block_latency::mark_through(block_latency::Stage::Committed, chainlength());
+}
+
+void State::discard(ChainDBTransaction& t)
+{
+    // earlier operations of a group commit are kept
+    if (t.has_savepoint()) {
+        t.rollback_to_savepoint();
+        deferredTransaction = std::make_unique<ChainDBTransaction>(std::move(t));
+    }
+}
+
+void State::commit_deferred(bool expiredOnly)
+{
+    if (!deferredTransaction)
+        return;
+    if (expiredOnly && std::chrono::steady_clock::now() < deferredSince + maxDeferredAge)
+        return;
+    deferredTransaction->commit();
+    deferredTransaction.reset();
+    set_committed();
+    block_latency::mark_through(block_latency::Stage::Committed, chainlength());
+}
+
 std::optional<SignedSnapshot> State::try_sign_chainstate()
 {
     if ((!signedSnapshot.has_value() || (signedSnapshot->height() < chainstate.length()))
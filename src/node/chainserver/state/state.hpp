@@ -1,14 +1,23 @@
 #pragma once
 #include "api/types/forward_declarations.hpp"
+#include "block/body/view.hpp"
 #include "block/chain/range.hpp"
+#include "communication/buffers/sndbuffer.hpp"
 #include "communication/messages.hpp"
 #include "communication/mining_task.hpp"
 #include "communication/stage_operation/result.hpp"
+#include "general/fair_shared_mutex.hpp"
 #include "helpers/consensus.hpp"
+#include "helpers/fee_estimator.hpp"
+#include "helpers/latest_txs.hpp"
 #include "helpers/past_chains.hpp"
+#include "helpers/recent_blocks.hpp"
+#include "helpers/undo_ring.hpp"
+#include <atomic>
 #include <chrono>
 
 class ChainDB;
+class ChainDBReader;
 struct Block;
 
 class ChainDBTransaction;
@@ -23,17 +32,57 @@ class State {
 public:
     // constructor/destructor
     State(ChainDB& b, BatchRegistry&, std::optional<SnapshotSigner> snapshotSigner);
+    ~State();
 
-    // concurrent methods
+    // Receives chain state updates as soon as the new chain state is in
+    // memory, before the database commit, such that relaying and mining
+    // on new blocks overlaps with the commit. Updates handed to the
+    // publisher are not returned by the methods below.
+    using Publisher = std::function<void(StateUpdate&&)>;
+    void set_publisher(Publisher p) { publisher = std::move(p); }
+
+    // concurrent methods, the header getters read a published snapshot
+    // and never wait for the chainserver
     Batch get_headers_concurrent(BatchSelector selector);
-    std::optional<HeaderView> get_header_concurrent(Descriptor descriptor, Height height);
+    std::optional<Header> get_header_concurrent(Descriptor descriptor, Height height);
     ConsensusSlave get_chainstate_concurrent();
+    // for API reads from other threads, f is called with the chainstate
+    // and the chain length of the committed database state, database
+    // reads on other connections must not go beyond it
+    template <typename F>
+    auto read_chainstate_concurrent(F&& f)
+    {
+        std::shared_lock l(chainstateMutex);
+        return f(std::as_const(chainstate), Height(committedLength.load(std::memory_order_acquire)));
+    }
+    auto api_get_block_concurrent(ChainDBReader&, const API::HeightOrHash&) -> std::optional<API::Block>;
+    auto api_get_blocks_concurrent(ChainDBReader&, NonzeroHeight from, Height to) -> std::vector<API::Block>;
 
     // normal methods
-    void garbage_collect();
+    // Deletes stale blocks in slices of at most gcSlice while the event
+    // queue is idle, a busy queue delays the deletion by at most
+    // maxGcDelay. Returns whether a collection is unfinished.
+    bool garbage_collect(bool idle);
+    // Returns free pages to the file system and checkpoints the WAL while
+    // the event queue is idle, vacuuming in slices of vacuumPages once
+    // the free page ratio is high. Returns whether a slice is pending.
+    bool maintain_db(bool idle);
     auto mining_task(const Address& a, bool log) -> MiningTask;
+    // changes whenever mining tasks change (chain head or block template)
+    struct MiningVersion {
+        Descriptor descriptor;
+        Height length;
+        uint64_t templateVersion;
+        bool operator==(const MiningVersion&) const = default;
+    };
+    auto mining_version() const -> MiningVersion
+    {
+        return { chainstate.descriptor(), chainstate.headers().length(),
+            chainstate.mempool().block_template_version() };
+    }
 
     auto append_gentx(const PaymentCreateMessage& ) -> tl::expected<mempool::Log, Error>;
+    auto append_gentxs(const API::PaymentCreateBatch&) -> std::pair<std::vector<int32_t>, mempool::Log>;
     auto chainlength() const -> Height { return chainstate.headers().length(); }
 
     // mempool
@@ -41,42 +90,53 @@ public:
 
     // stage methods
     auto set_stage(Headerchain&& hc) -> stage_operation::StageSetResult;
-    auto add_stage(const std::vector<Block>& blocks, const Headerchain&) -> std::pair<stage_operation::StageAddResult, std::optional<StateUpdate>>;
+    auto add_stage(const std::vector<Block>& blocks, const Headerchain&, bool bodiesChecked = false) -> std::pair<stage_operation::StageAddResult, std::optional<StateUpdate>>;
 
-    // synced state notification
+    // synced state notification, database writes are group committed
+    // while not synced
     void set_sync_state(bool synced)
     {
+        groupCommit = !synced;
         if (synced) {
+            commit_deferred();
             signAfter = std::min(signAfter,
                 std::chrono::steady_clock::now() + std::chrono::seconds(5));
         } else {
             signAfter = tp::max();
         }
     }
+    // commits group committed writes, with expiredOnly only once they
+    // reached their maximal age
+    void commit_deferred(bool expiredOnly = false);
 
     // general getters
     auto get_header(Height h) const -> std::optional<std::pair<NonzeroHeight,Header>>;
     auto get_headers() const { return chainstate.headers(); }
     auto get_hash(Height h) const -> std::optional<Hash>;
     auto get_blocks(DescriptedBlockRange) -> std::vector<BodyContainer>;
+    // BlockrepMsg serialized directly from the database bodies
+    auto get_blockrep(DescriptedBlockRange, uint32_t nonce) -> std::optional<Sndbuffer>;
     auto get_mempool_tx(TransactionId) const -> std::optional<TransferTxExchangeMessage>;
 
     // api getters
-    auto api_get_address(AddressView) -> API::Balance;
     auto api_get_head() const -> API::Head;
-    auto api_get_history(Address a, uint64_t beforeId) -> std::optional<API::AccountHistory>;
-    auto api_get_richlist(size_t N) -> API::Richlist;
-    auto api_get_mempool(size_t) -> API::MempoolEntries;
+    auto api_get_mempool(size_t offset, uint32_t limit, std::optional<Address> address) const -> API::MempoolPage;
+    auto mempool_payments() const -> TxVec; // all, by fee
+    auto api_get_fee_estimate() const -> API::FeeEstimate;
     auto api_get_tx(HashView hash) const -> std::optional<API::Transaction>;
-    auto api_get_latest_txs(size_t N=100) const -> API::TransactionsByBlocks;
+    auto api_get_tx_proof(const std::variant<Hash, HistoryId>&) -> std::optional<API::TxProof>;
+    auto api_get_latest_txs(size_t N=100) -> API::TransactionsByBlocks;
     auto api_get_header(API::HeightOrHash& h) const -> std::optional<std::pair<NonzeroHeight,Header>>;
-    auto api_get_block(const API::HeightOrHash& h) const -> std::optional<API::Block>;
     auto api_tx_cache() const -> const TransactionIds;
 
 private:
     // delegated getters 
-    auto api_get_block(Height h) const -> std::optional<API::Block>;
     std::optional<NonzeroHeight> consensus_height(const Hash&) const;
+    std::optional<std::vector<Hash>> block_hashes(DescriptedBlockRange) const;
+    auto db_latest_txs(size_t N) const -> API::TransactionsByBlocks;
+
+    // mempool log of the chainstate, also fed to the fee estimator
+    [[nodiscard]] mempool::Log pop_mempool_log();
 
     // transactions
     [[nodiscard]] auto apply_stage(ChainDBTransaction&& t) -> std::tuple<ChainError, std::optional<StateUpdate>, std::vector<API::Block>>;
@@ -84,16 +144,30 @@ private:
 public:
     [[nodiscard]] auto apply_signed_snapshot(SignedSnapshot&& sp) -> std::optional<StateUpdate>;
     //  stageUpdate;
-    [[nodiscard]] auto append_mined_block(const Block&) -> StateUpdate;
+    // pushed blocks were received unsolicited from a peer instead of mined
+    [[nodiscard]] auto append_mined_block(const Block&, bool pushed = false) -> std::optional<StateUpdate>;
 
 private:
     // transaction helpers
     [[nodiscard]] chainserver::RollbackResult rollback(const Height newlength) const;
+    void prune_blocks(); // according to config().data.pruneDepth
 
     // finalize helpers
     [[nodiscard]] auto commit_fork(RollbackResult&& rr, AppendBlocksResult&&) -> StateUpdate;
     [[nodiscard]] auto commit_append(AppendBlocksResult&& abr) -> StateUpdate;
     std::optional<SignedSnapshot> try_sign_chainstate();
+    // publishes the update if there is a publisher, then commits
+    [[nodiscard]] auto publish_commit(StateUpdate&&, ChainDBTransaction&) -> std::optional<StateUpdate>;
+
+    // Group commit: during initial sync a committed transaction stays open
+    // for the next operation until it is older than maxDeferredAge or
+    // holds more than maxDeferredBytes of block data. A crash loses the
+    // deferred writes only, the node restarts from the last committed
+    // chain. Resumed transactions get a savepoint such that a failed
+    // operation does not discard the earlier ones.
+    [[nodiscard]] ChainDBTransaction begin_transaction();
+    void commit(ChainDBTransaction&);
+    void discard(ChainDBTransaction&); // instead of destructing a failed one
 
 private:
     using tp = std::chrono::steady_clock::time_point;
@@ -105,11 +179,60 @@ private:
     tp signAfter { tp::max() };
     bool signingEnabled { true };
 
-    std::mutex chainstateMutex; // protects pastChains and chainstate
+    FairSharedMutex chainstateMutex; // protects pastChains and chainstate, held during db commits of chainstate changes
+
+    // Immutable copy of the consensus headers, replaced whenever they or
+    // the signed snapshot change. Readers on other threads load the
+    // current version, older versions live as long as readers hold them.
+    struct PublishedHeaders {
+        std::optional<SignedSnapshot> signedSnapshot;
+        Descriptor descriptor;
+        Headerchain headers;
+    };
+    void publish_headers();
+    std::atomic<std::shared_ptr<const PublishedHeaders>> publishedHeaders;
     BlockCache blockCache;
+    RecentBlocks recentBlocks { 64 };
+    FeeEstimator feeEstimator;
+    LatestTxs latestTxs { 100 };
+    UndoRing undoRing;
     chainserver::Chainstate chainstate;
 
     ExtendableHeaderchain stage;
+
+    // mining task body of the current MiningVersion, tasks for other payout
+    // addresses already in the database patch the account id of the reward
+    // and recompute the merkle root along the branch of its leaf
+    struct MiningTemplate {
+        MiningVersion version;
+        BodyContainer body;
+        size_t rewardOffset; // of the reward's account id in body
+        MerkleBranch rewardBranch;
+    };
+    std::optional<MiningTemplate> miningTemplate;
     std::chrono::steady_clock::time_point nextGarbageCollect;
+    bool gcPending { false };
+    static constexpr auto gcSlice { std::chrono::milliseconds(50) };
+    static constexpr auto maxGcDelay { std::chrono::minutes(1) };
+    static constexpr size_t gcChunk { 500 }; // blocks per delete statement
+    std::chrono::steady_clock::time_point nextMaintenance;
+    bool vacuuming { false };
+    static constexpr auto maintenanceInterval { std::chrono::seconds(10) };
+    static constexpr int64_t vacuumPages { 256 };
+    static constexpr uint64_t walTruncateBytes { 64 * 1024 * 1024 };
+    Publisher publisher;
+
+    static constexpr auto maxDeferredAge { std::chrono::seconds(5) };
+    static constexpr size_t maxDeferredBytes { 64 * 1024 * 1024 };
+    bool groupCommit { true };
+    // Chain length of the committed database state. Group commits keep
+    // the chainstate ahead of the database for readers on other
+    // connections, it is set after every commit and lowered to the fork
+    // height when the chainstate forks before the commit.
+    std::atomic<uint32_t> committedLength { 0 };
+    void set_committed() { committedLength.store(chainlength().value(), std::memory_order_release); }
+    std::unique_ptr<ChainDBTransaction> deferredTransaction;
+    tp deferredSince;
+    size_t deferredBytes { 0 };
 };
 }
@@ -4,6 +4,8 @@
 #include "block_applier.hpp"
 #include "general/hex.hpp"
 #include "general/now.hpp"
+#include "general/task_pool.hpp"
+#include "global/globals.hpp"
 #include <fstream>
 
 namespace chainserver {
@@ -20,7 +22,8 @@ ApplyStageTransaction::ApplyStageTransaction(const State& s, ChainDBTransaction&
     applyResult = AppendBlocksResult {};
     auto& res { applyResult.value() };
     auto& baseTxIds { rb ? rb->chainTxIds : ccs.chainstate.txids() };
-    chainserver::BlockApplier ba { ccs.db, ccs.stage, baseTxIds, true };
+    // a follower's stage only holds blocks of its trusted primary
+    chainserver::BlockApplier ba { ccs.db, ccs.stage, baseTxIds, task_pool(), ccs.chainstate.signature_cache(), true, config().node.follow.has_value() };
     std::vector<API::Block> apiBlocks;
     for (NonzeroHeight h = (chainlength + 1).nonzero_assert(); h <= ccs.stage.length(); ++h) {
         auto historyId { ccs.db.next_history_id() };
@@ -45,6 +48,7 @@ ApplyStageTransaction::ApplyStageTransaction(const State& s, ChainDBTransaction&
             std::ofstream f(fname);
             f << serialize_hex(b.body.data());
             res.newTxIds = ba.move_new_txids();
+            res.undo = ba.move_undo();
             return { apiBlocks, { e, h } };
         }
         res.newHistoryOffsets.push_back(historyId);
@@ -52,6 +56,7 @@ ApplyStageTransaction::ApplyStageTransaction(const State& s, ChainDBTransaction&
         chainlength = h;
     }
     res.newTxIds = ba.move_new_txids();
+    res.undo = ba.move_undo();
     return { apiBlocks, { Error(0), (ccs.stage.length() + 1).nonzero_assert() } };
 }
 
@@ -66,16 +71,22 @@ void ApplyStageTransaction::consider_rollback(Height shrinkLength)
     assert(chainlength == shrinkLength);
 }
 
-auto ApplyStageTransaction::commit(State& cs) -> StateUpdate
+auto ApplyStageTransaction::commit(State& cs) -> std::optional<StateUpdate>
 {
     assert(!commited);
     assert(applyResult);
     commited = true;
 
-    std::unique_lock<std::mutex> ul(cs.chainstateMutex);
+    std::unique_lock ul(cs.chainstateMutex);
     auto result { rb ? cs.commit_fork(std::move(*rb), std::move(*applyResult))
                      : cs.commit_append(std::move(*applyResult)) };
-    transaction.commit();
-    return result;
+    return cs.publish_commit(std::move(result), transaction);
+}
+
+void ApplyStageTransaction::discard(State& cs)
+{
+    assert(!commited);
+    commited = true;
+    cs.discard(transaction);
 }
 }
@@ -11,7 +11,8 @@ public:
 
     void consider_rollback(Height shrinkLength);
     [[nodiscard]] std::pair<std::vector<API::Block>,ChainError> apply_stage_blocks();
-    [[nodiscard]] StateUpdate commit(State&);
+    [[nodiscard]] std::optional<StateUpdate> commit(State&);
+    void discard(State&); // keeps group committed writes of earlier operations
 
 private:
     const State& ccs; // const ref
@@ -6,6 +6,12 @@
 #include "block/chain/history/history.hpp"
 #include "db/chain_db.hpp"
 #include "general/log_compressed.hpp"
+#include "general/metrics.hpp"
+#include "general/task_pool.hpp"
+#include "spdlog/spdlog.h"
+#include <exception>
+#include <map>
+#include <set>
 
 namespace {
 
@@ -15,31 +21,46 @@ class BalanceChecker {
         friend class BalanceChecker;
 
     public:
+        AccountFlow(std::pmr::memory_resource* r)
+            : referredPayout(r)
+            , referredFrom(r)
+            , referredTo(r)
+        {
+        }
         Funds in() const { return _in; }
         Funds out() const { return _out; }
 
     private:
         Funds _in { 0 };
         Funds _out { 0 };
-        std::vector<size_t> referredPayout;
-        std::vector<size_t> referredFrom;
-        std::vector<size_t> referredTo;
+        std::pmr::vector<size_t> referredPayout;
+        std::pmr::vector<size_t> referredFrom;
+        std::pmr::vector<size_t> referredTo;
     };
 
     class OldAccountFlow : public AccountFlow {
         friend class BalanceChecker;
+        using AccountFlow::AccountFlow;
         Address address;
     };
 
 public:
     BalanceChecker(AccountId beginNewAccountId,
-        const BodyView& bv, NonzeroHeight height)
+        const BodyView& bv, NonzeroHeight height, std::pmr::memory_resource* r)
         : beginNewAccountId(beginNewAccountId)
         , endNewAccountId(beginNewAccountId + bv.getNAddresses())
         , bv(bv)
-        , newAccounts(endNewAccountId - beginNewAccountId)
+        , arena(r)
+        , oldAccounts(r)
+        , newAccounts(r)
         , height(height)
+        , payouts(r)
+        , payments(r)
     { // OK
+        const size_t n { endNewAccountId - beginNewAccountId };
+        newAccounts.reserve(n);
+        for (size_t i = 0; i < n; ++i)
+            newAccounts.emplace_back(r);
     }
 
     void register_reward(AccountId to, Funds amount, uint16_t offset) // OK
@@ -123,21 +144,21 @@ public:
         return 0;
     }
     auto& getOldAccounts() { return oldAccounts; } // OK
-    const std::vector<AccountFlow>& get_new_accounts() const { return newAccounts; } // OK
+    const auto& get_new_accounts() const { return newAccounts; } // OK
     AccountId get_account_id(size_t newElementOffset) // OK
     {
         assert(newElementOffset < newAccounts.size());
         return beginNewAccountId + newElementOffset;
     };
     AddressView get_new_address(size_t i) { return bv.get_address(i); } // OK
-    const std::vector<TransferInternal>& get_transfers() { return payments; };
-    const std::vector<RewardInternal>& get_rewards() { return payouts; };
+    const auto& get_transfers() { return payments; };
+    const auto& get_rewards() { return payouts; };
 
 protected:
     AccountFlow& account_flow(AccountId i)
     {
         if (i < beginNewAccountId) {
-            return oldAccounts[i];
+            return oldAccounts.try_emplace(i, arena).first->second;
         } else {
             assert(i < endNewAccountId);
             return newAccounts[i.value() - beginNewAccountId.value()];
@@ -149,16 +170,17 @@ private:
     AccountId beginNewAccountId;
     AccountId endNewAccountId;
     const BodyView& bv;
-    std::map<AccountId, OldAccountFlow> oldAccounts;
-    std::vector<AccountFlow> newAccounts;
+    std::pmr::memory_resource* arena;
+    std::pmr::map<AccountId, OldAccountFlow> oldAccounts;
+    std::pmr::vector<AccountFlow> newAccounts;
     NonzeroHeight height;
-    std::vector<RewardInternal> payouts;
-    std::vector<TransferInternal> payments;
+    std::pmr::vector<RewardInternal> payouts;
+    std::pmr::vector<TransferInternal> payments;
 };
 
 struct InsertHistoryEntry {
-    InsertHistoryEntry(const RewardInternal& p, HistoryId historyId)
-        : he(p)
+    InsertHistoryEntry(const RewardInternal& p, const Hash& hash, HistoryId historyId)
+        : he(p, hash)
         , historyId(historyId)
     {
     }
@@ -172,14 +194,16 @@ struct InsertHistoryEntry {
 };
 
 struct HistoryEntries {
-    HistoryEntries(HistoryId nextHistoryId)
+    HistoryEntries(HistoryId nextHistoryId, std::pmr::memory_resource* r)
         : nextHistoryId(nextHistoryId)
+        , insertHistory(r)
+        , insertAccountHistory(r)
     {
     }
     HistoryId nextHistoryId;
-    [[nodiscard]] const auto& push_reward(const RewardInternal& r)
+    [[nodiscard]] const auto& push_reward(const RewardInternal& r, const Hash& hash)
     {
-        auto& e { insertHistory.emplace_back(r, nextHistoryId) };
+        auto& e { insertHistory.emplace_back(r, hash, nextHistoryId) };
         insertAccountHistory.emplace_back(r.toAccountId, nextHistoryId);
         ++nextHistoryId;
         return e;
@@ -197,37 +221,74 @@ struct HistoryEntries {
     void write(ChainDB& db)
     {
         // insert history for payouts and payments
-        for (auto& p : insertHistory) {
-            auto inserted { db.insertHistory(p.he.hash, p.he.data) };
-            assert(p.historyId == inserted);
-        }
-        // insert account history
-        for (auto p : insertAccountHistory) {
-            db.insertAccountHistory(p.first, p.second);
-        }
+        assert(insertHistory.empty() || insertHistory.front().historyId == db.next_history_id());
+        std::pmr::vector<std::pair<HashView, std::span<const uint8_t>>> rows(insertHistory.get_allocator());
+        rows.reserve(insertHistory.size());
+        for (auto& p : insertHistory)
+            rows.emplace_back(p.he.hash, p.he.data);
+        db.insert_history(rows);
+        // insert account history in primary key order
+        std::sort(insertAccountHistory.begin(), insertAccountHistory.end());
+        db.insert_account_history(insertAccountHistory);
     }
-    std::vector<InsertHistoryEntry> insertHistory;
-    std::vector<std::pair<AccountId, HistoryId>> insertAccountHistory;
+    std::pmr::vector<InsertHistoryEntry> insertHistory;
+    std::pmr::vector<std::pair<AccountId, HistoryId>> insertAccountHistory;
 };
 
 } // namespace
 
 namespace chainserver {
 struct Preparation {
-    std::set<TransactionId> txset;
-    std::vector<std::pair<AccountId, Funds>> updateBalances;
-    std::vector<std::tuple<AddressView, Funds, AccountId>> insertBalances;
-    std::vector<API::Block::Reward> apiRewards;
+    std::set<TransactionId> txset; // merged into the new transaction ids
+    std::pmr::vector<std::pair<AccountId, Funds>> updateBalances;
+    std::pmr::vector<std::tuple<AddressView, Funds, AccountId>> insertBalances;
+    StateCommitment commitmentDelta; // added to the previous commitment
+    std::vector<API::Block::Reward> apiRewards; // moved into the API::Block
     std::vector<API::Block::Transfer> apiTransfers;
     HistoryEntries historyEntries;
     RollbackGenerator rg;
-    Preparation(HistoryId nextHistoryId, AccountId beginNewAccountId)
-        : historyEntries(nextHistoryId)
+    Preparation(HistoryId nextHistoryId, AccountId beginNewAccountId, std::pmr::memory_resource* r)
+        : updateBalances(r)
+        , insertBalances(r)
+        , historyEntries(nextHistoryId, r)
         , rg(beginNewAccountId)
     {
     }
 };
 
+BlockArena::BlockArena()
+    : initial(new std::byte[initialSize])
+    , arena(initial.get(), initialSize)
+{
+}
+
+void BlockArena::reset()
+{
+    if (allocations == 0)
+        return;
+    static auto& blocks { metrics::counter("warthog_block_arena_blocks_total",
+        "Number of block preparations using the block arena") };
+    static auto& allocs { metrics::counter("warthog_block_arena_allocations_total",
+        "Number of allocations of block preparations") };
+    static auto& allocBytes { metrics::counter("warthog_block_arena_bytes_total",
+        "Bytes allocated by block preparations") };
+    static auto& last { metrics::gauge("warthog_block_arena_last_allocations",
+        "Number of allocations of the last block preparation") };
+    blocks.inc();
+    allocs.inc(allocations);
+    allocBytes.inc(bytes);
+    last.set(allocations);
+    arena.release();
+    allocations = bytes = 0;
+}
+
+void* BlockArena::do_allocate(size_t n, size_t alignment)
+{
+    allocations += 1;
+    bytes += n;
+    return arena.allocate(n, alignment);
+}
+
 Preparation BlockApplier::Preparer::prepare(const BodyView& bv, const NonzeroHeight height) const
 {
     if (!bv.valid())
@@ -242,18 +303,18 @@ Preparation BlockApplier::Preparer::prepare(const BodyView& bv, const NonzeroHei
 
     // Read new address section
     const AccountId beginNewAccountId = db.next_state_id(); // they start from this index
-    Preparation res(db.next_history_id(), beginNewAccountId);
-    BalanceChecker balanceChecker(beginNewAccountId, bv, height);
+    Preparation res(db.next_history_id(), beginNewAccountId, &arena);
+    BalanceChecker balanceChecker(beginNewAccountId, bv, height, &arena);
 
     { // verify address policy
-        std::set<AddressView> newAddresses;
+        std::pmr::set<AddressView> newAddresses(&arena);
         // Check uniqueness of new addresses
         for (auto address : bv.addresses()) {
             if (newAddresses.emplace(address).second == false)
                 throw Error(EADDRPOLICY);
-            if (db.lookup_address(address))
-                throw Error(EADDRPOLICY);
         }
+        if (!db.lookup_addresses(std::vector<AddressView>(newAddresses.begin(), newAddresses.end())).empty())
+            throw Error(EADDRPOLICY);
     }
 
     // Read reward section
@@ -267,8 +328,10 @@ Preparation BlockApplier::Preparer::prepare(const BodyView& bv, const NonzeroHei
     }
 
     // Read transfer section
+    const bool logCompressed { spdlog::should_log(spdlog::level::debug) };
     for (auto t : bv.transfers()) {
-        log_compressed(t);
+        if (logCompressed)
+            log_compressed(t);
         balanceChecker.register_transfer(t, height);
     }
 
@@ -278,12 +341,17 @@ Preparation BlockApplier::Preparer::prepare(const BodyView& bv, const NonzeroHei
     // loop through old accounts and
     // load previous balances and addresses from database
     auto& oldAccounts = balanceChecker.getOldAccounts();
+    std::vector<AccountId> oldIds;
+    oldIds.reserve(oldAccounts.size());
+    for (auto& [id, _] : oldAccounts)
+        oldIds.push_back(id);
+    const auto lookups { db.lookup_accounts(std::move(oldIds)) };
     for (auto& [id, accountflow] : oldAccounts) {
-        if (auto p = db.lookup_account(id); p) {
+        if (auto p = lookups.find(id); p != lookups.end()) {
             // account lookup successful
 
-            auto& [address, balance] = *p;
-            res.rg.register_balance(id, p->funds);
+            auto& [address, balance] = p->second;
+            res.rg.register_balance(id, balance);
             balanceChecker.set_address(accountflow, address);
 
             // check that balances are correct
@@ -291,6 +359,8 @@ Preparation BlockApplier::Preparer::prepare(const BodyView& bv, const NonzeroHei
                 throw Error(EBALANCE); // insufficient balance
             Funds newbalance { accountflow.in() + balance - accountflow.out() };
             res.updateBalances.push_back(std::make_pair(id, newbalance));
+            res.commitmentDelta.remove(id, address, balance);
+            res.commitmentDelta.add(id, address, newbalance);
         } else {
             throw Error(EINVACCOUNT); // invalid account id (not found in database)
         }
@@ -309,14 +379,40 @@ Preparation BlockApplier::Preparer::prepare(const BodyView& bv, const NonzeroHei
         AddressView address = balanceChecker.get_new_address(i);
         AccountId accountId = balanceChecker.get_account_id(i);
         res.insertBalances.emplace_back(address, balance, accountId);
+        res.commitmentDelta.add(accountId, address, balance);
     }
 
     // generate history for payments and check signatures
     // and check for unique transaction ids
 
-    for (auto& r : balanceChecker.get_rewards()) {
-        assert(!r.toAddress.is_null());
-        auto& ref { res.historyEntries.push_reward(r) };
+    // the reward and transaction hashes are independent, hash them with
+    // the multi-buffer SHA256
+    auto& rewards { balanceChecker.get_rewards() };
+    auto& transfers { balanceChecker.get_transfers() };
+    std::pmr::vector<Hash> rewardHashes(rewards.size(), &arena);
+    std::pmr::vector<Hash> transferHashes(transfers.size(), &arena);
+    {
+        std::pmr::vector<RewardInternal::HashInput> inputs(&arena);
+        inputs.reserve(rewards.size());
+        for (auto& r : rewards) {
+            assert(!r.toAddress.is_null());
+            inputs.push_back(r.hash_input());
+        }
+        if (!inputs.empty())
+            hashSHA256_batch(inputs[0].data(), inputs[0].size(), sizeof(inputs[0]), inputs.size(), rewardHashes.data());
+    }
+    {
+        std::pmr::vector<TransferInternal::HashInput> inputs(&arena);
+        inputs.reserve(transfers.size());
+        for (auto& t : transfers)
+            inputs.push_back(t.hash_input(hc, height));
+        if (!inputs.empty())
+            hashSHA256_batch(inputs[0].data(), inputs[0].size(), sizeof(inputs[0]), inputs.size(), transferHashes.data());
+    }
+
+    for (size_t i = 0; i < rewards.size(); ++i) {
+        auto& r { rewards[i] };
+        auto& ref { res.historyEntries.push_reward(r, rewardHashes[i]) };
 
         res.apiRewards.push_back({
             .txhash { ref.he.hash },
@@ -324,8 +420,33 @@ Preparation BlockApplier::Preparer::prepare(const BodyView& bv, const NonzeroHei
             .amount { r.amount },
         });
     }
-    for (auto& tr : balanceChecker.get_transfers()) {
-        auto verified { tr.verify(hc, height) };
+    // recover signatures in parallel, errors are thrown in order below
+    // (parallel_for requires non-throwing functions)
+    std::pmr::vector<std::optional<VerifiedTransfer>> verifiedTransfers(transfers.size(), &arena);
+    std::pmr::vector<std::exception_ptr> verifyErrors(transfers.size(), &arena);
+    {
+        static auto& recovery { metrics::histogram("warthog_signature_recovery_seconds",
+            "Duration of recovering the transfer signatures of a block") };
+        metrics::ScopeTimer st(recovery);
+        if (trustSignatures) {
+            for (size_t i = 0; i < transfers.size(); ++i)
+                verifiedTransfers[i].emplace(transfers[i].trust(hc, height, transferHashes[i]));
+        } else {
+            pool.parallel_for(transfers.size(), [&](size_t i) {
+                try {
+                    verifiedTransfers[i].emplace(transfers[i].verify(hc, height, transferHashes[i], &signatures));
+                } catch (...) {
+                    verifyErrors[i] = std::current_exception();
+                }
+            });
+        }
+    }
+
+    for (size_t i = 0; i < transfers.size(); ++i) {
+        if (verifyErrors[i])
+            std::rethrow_exception(verifyErrors[i]);
+        auto& tr { transfers[i] };
+        auto& verified { *verifiedTransfers[i] };
         TransactionId tid { verified.id };
 
         // check for duplicate txid (also within current block)
@@ -349,7 +470,15 @@ Preparation BlockApplier::Preparer::prepare(const BodyView& bv, const NonzeroHei
 
 API::Block BlockApplier::apply_block(const BodyView& bv, HeaderView hv, NonzeroHeight height, BlockId blockId)
 {
+    arena.reset(); // temporaries of the previous block are gone
     auto prepared { preparer.prepare(bv, height) }; // call const function
+    if (!commitment) {
+        commitment = db.get_state_commitment(height - 1);
+        if (!commitment) { // chain applied before commitments were stored
+            spdlog::info("Computing the state commitment at height {}", (height - 1).value());
+            commitment = db.compute_state_commitment();
+        }
+    }
 
     // ABOVE NO DB MODIFICATIONS
     //////////////////////////////
@@ -361,6 +490,25 @@ API::Block BlockApplier::apply_block(const BodyView& bv, HeaderView hv, NonzeroH
     try {
         preparer.newTxIds.merge(std::move(prepared.txset));
 
+        // aggregates, before the balances are written
+        ChainDB::BlockStats stats {
+            .timestamp = hv.timestamp(),
+            .transfers = uint32_t(prepared.apiTransfers.size()),
+            .volume = Funds(0),
+            .fees = Funds(0),
+            .rewards = Funds(0),
+            .newAccounts = uint32_t(prepared.insertBalances.size()),
+            .accounts = prepared.rg.begin_new_accounts().value() - 1 + prepared.insertBalances.size(),
+            .transactions = db.next_history_id().value() - 1 + prepared.apiRewards.size() + prepared.apiTransfers.size(),
+        };
+        for (auto& t : prepared.apiTransfers) {
+            stats.volume += t.amount;
+            stats.fees += t.fee;
+        }
+        for (auto& r : prepared.apiRewards)
+            stats.rewards += r.amount;
+        db.insert_block_stats(height, stats);
+
         // update old balances
         for (auto& [accId, bal] : prepared.updateBalances)
             db.set_balance(accId, bal);
@@ -370,15 +518,27 @@ API::Block BlockApplier::apply_block(const BodyView& bv, HeaderView hv, NonzeroH
             db.insertStateEntry(addr, bal, accId);
 
         // write undo data
-        db.set_block_undo(blockId, prepared.rg.serialze());
+        auto undoData { prepared.rg.serialze() };
+        db.set_block_undo(blockId, undoData);
 
         // write consensus data
-        db.insert_consensus(height, blockId, db.next_history_id(), prepared.rg.begin_new_accounts());
+        db.insert_consensus(height, blockId, hv, db.next_history_id(), prepared.rg.begin_new_accounts());
+        *commitment += prepared.commitmentDelta;
+        db.insert_state_commitment(height, *commitment);
 
         prepared.historyEntries.write(db);
         API::Block b(hv, height, 0);
         b.rewards = std::move(prepared.apiRewards);
         b.transfers = std::move(prepared.apiTransfers);
+
+        UndoRing::Block ub { .height { height }, .hash { hv.hash() }, .transfers {}, .undo { std::move(undoData) } };
+        ub.transfers.reserve(b.transfers.size());
+        size_t i { 0 };
+        for (auto t : bv.transfers()) {
+            auto& api { b.transfers[i++] };
+            ub.transfers.emplace_back(t, api.pinHeight, api.toAddress);
+        }
+        undo.push(std::move(ub));
         return b;
     } catch (Error e) {
         throw std::runtime_error(std::string("Unexpected exception: ") + __PRETTY_FUNCTION__ + ":" + e.strerror());
@@ -2,35 +2,73 @@
 #include "crypto/address.hpp"
 #include "../../transaction_ids.hpp"
 #include "api/types/forward_declarations.hpp"
+#include "../helpers/undo_ring.hpp"
+#include "chainserver/state_commitment.hpp"
+#include <memory>
+#include <memory_resource>
+#include <optional>
 class ChainDB;
 class Headerchain;
 class BodyView;
 class BlockId;
 class HeaderView;
+class TaskPool;
+class SignatureCache;
 
 namespace chainserver {
 struct Preparation;
+
+// Temporaries of a block preparation are allocated from a monotonic arena
+// which is reset before the next block. The number of allocations per block
+// is exported as metrics.
+class BlockArena : public std::pmr::memory_resource {
+public:
+    BlockArena();
+    ~BlockArena() { reset(); }
+    void reset();
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void*, size_t, size_t) override { }
+    bool do_is_equal(const std::pmr::memory_resource& o) const noexcept override { return this == &o; }
+
+    static constexpr size_t initialSize = 256 * 1024; // covers typical blocks
+    std::unique_ptr<std::byte[]> initial;
+    std::pmr::monotonic_buffer_resource arena;
+    size_t allocations { 0 };
+    size_t bytes { 0 };
+};
+
 struct BlockApplier {
-    BlockApplier(ChainDB& db, const Headerchain& hc, const std::set<TransactionId, ByPinHeight>& baseTxIds, bool fromStage)
-        : preparer { db, hc, baseTxIds, {} }
+    // trustSignatures skips the signature recovery (follower mode)
+    BlockApplier(ChainDB& db, const Headerchain& hc, const TransactionIds& baseTxIds, TaskPool& pool, SignatureCache& signatures, bool fromStage, bool trustSignatures = false)
+        : preparer { db, hc, baseTxIds, pool, signatures, arena, trustSignatures, {} }
         , db(db)
         , fromStage(fromStage)
     {
     }
     TransactionIds&& move_new_txids() { return std::move(preparer.newTxIds); };
+    UndoRing&& move_undo() { return std::move(undo); };
     [[nodiscard]] API::Block apply_block(const BodyView& bv, HeaderView, NonzeroHeight height, BlockId blockId);
 
 private: // private methods
     struct Preparer {
         const ChainDB& db; // preparer cannot modify db!
         const Headerchain& hc;
-        const std::set<TransactionId, ByPinHeight>& baseTxIds;
+        const TransactionIds& baseTxIds;
+        TaskPool& pool; // for parallel signature recovery
+        SignatureCache& signatures; // recovered on mempool admission
+        std::pmr::memory_resource& arena;
+        const bool trustSignatures;
         TransactionIds newTxIds;
         Preparation prepare(const BodyView& bv, const NonzeroHeight height) const;
     };
 
 private: // private data
+    BlockArena arena;
     Preparer preparer;
+    UndoRing undo; // of the last applied blocks
+    std::optional<StateCommitment> commitment; // loaded on the first block
     ChainDB& db;
     bool fromStage;
 };
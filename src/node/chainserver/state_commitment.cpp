@@ -0,0 +1,73 @@
+#include "state_commitment.hpp"
+#include "crypto/hasher_sha256.hpp"
+#include "general/reader.hpp"
+#include "general/writer.hpp"
+
+namespace chainserver {
+namespace {
+using Limbs = std::array<uint64_t, 4>;
+Limbs element(AccountId id, AddressView address, Funds balance)
+{
+    Hash h { HasherSHA256() << id << address << balance };
+    Reader r(h);
+    Limbs l;
+    for (size_t i = 4; i-- > 0;)
+        l[i] = r.uint64();
+    return l;
+}
+
+void add_limbs(Limbs& a, const Limbs& b)
+{
+    uint64_t carry { 0 };
+    for (size_t i = 0; i < 4; ++i) {
+        const uint64_t s { a[i] + b[i] };
+        const uint64_t c { s < a[i] };
+        a[i] = s + carry;
+        carry = c | (a[i] < s);
+    }
+}
+
+void sub_limbs(Limbs& a, const Limbs& b)
+{
+    uint64_t borrow { 0 };
+    for (size_t i = 0; i < 4; ++i) {
+        const uint64_t d { a[i] - b[i] };
+        const uint64_t c { a[i] < b[i] };
+        a[i] = d - borrow;
+        borrow = c | (d < borrow);
+    }
+}
+}
+
+StateCommitment::StateCommitment(const Hash& h)
+{
+    Reader r(h);
+    for (size_t i = 4; i-- > 0;)
+        limbs[i] = r.uint64();
+}
+
+void StateCommitment::add(AccountId id, AddressView address, Funds balance)
+{
+    add_limbs(limbs, element(id, address, balance));
+}
+
+void StateCommitment::remove(AccountId id, AddressView address, Funds balance)
+{
+    sub_limbs(limbs, element(id, address, balance));
+}
+
+StateCommitment& StateCommitment::operator+=(const StateCommitment& other)
+{
+    add_limbs(limbs, other.limbs);
+    return *this;
+}
+
+Hash StateCommitment::hash() const
+{
+    Hash h;
+    Writer w(h.data(), h.size());
+    for (size_t i = 4; i-- > 0;)
+        w << limbs[i];
+    return h;
+}
+}
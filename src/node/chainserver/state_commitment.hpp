@@ -0,0 +1,29 @@
+#pragma once
+#include "block/body/account_id.hpp"
+#include "crypto/address.hpp"
+#include "crypto/hash.hpp"
+#include "general/funds.hpp"
+#include <array>
+#include <cstdint>
+
+namespace chainserver {
+// Commitment to the account state as the sum modulo 2^256 of
+// sha256(account id, address, balance) over all accounts. The sum does not
+// depend on the order of accounts, a balance change is applied by removing
+// the old and adding the new entry, and differences of two states can be
+// accumulated separately and added later. ChainDB keeps the commitment of
+// every consensus height, it is not part of consensus.
+class StateCommitment {
+public:
+    StateCommitment() = default; // empty state
+    explicit StateCommitment(const Hash&);
+    void add(AccountId, AddressView, Funds balance);
+    void remove(AccountId, AddressView, Funds balance);
+    StateCommitment& operator+=(const StateCommitment&);
+    Hash hash() const;
+    bool operator==(const StateCommitment&) const = default;
+
+private:
+    std::array<uint64_t, 4> limbs {}; // least significant first
+};
+}
@@ -0,0 +1,162 @@
+#include "transaction_ids.hpp"
+#include <algorithm>
+#include <bit>
+
+namespace chainserver {
+namespace {
+constexpr size_t bitsPerEntry { 10 };
+constexpr size_t minCapacity { 1024 };
+
+uint64_t mix(uint64_t x)
+{
+    // splitmix64 finalizer
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+uint64_t hash(const TransactionId& id)
+{
+    return mix(id.accountId.value() ^ mix((uint64_t(id.pinHeight.value()) << 32) | id.nonceId.value()));
+}
+}
+
+void TransactionIds::BloomFilter::reset(size_t capacity)
+{
+    cap = std::max(capacity, minCapacity);
+    blocks.assign(std::bit_ceil(cap * bitsPerEntry / 512), Block {});
+}
+
+// the block is selected by the low bits of h, six 9 bit positions within
+// the block are taken from a second hash
+void TransactionIds::BloomFilter::add(const TransactionId& id)
+{
+    const auto h { hash(id) };
+    auto& b { blocks[index(h)] };
+    for (uint64_t bits { mix(h) }, i { 0 }; i < 6; ++i, bits >>= 9)
+        b.words[(bits >> 6) & 7] |= uint64_t(1) << (bits & 63);
+}
+
+bool TransactionIds::BloomFilter::may_contain(const TransactionId& id) const
+{
+    if (blocks.empty())
+        return false;
+    const auto h { hash(id) };
+    auto& b { blocks[index(h)] };
+    for (uint64_t bits { mix(h) }, i { 0 }; i < 6; ++i, bits >>= 9) {
+        if ((b.words[(bits >> 6) & 7] & (uint64_t(1) << (bits & 63))) == 0)
+            return false;
+    }
+    return true;
+}
+
+bool TransactionIds::contains(const TransactionId& id) const
+{
+    if (!filter.may_contain(id))
+        return false;
+    auto iter { buckets.find(id.pinHeight) };
+    if (iter == buckets.end())
+        return false;
+    return std::binary_search(iter->second.begin(), iter->second.end(), id);
+}
+
+bool TransactionIds::insert(const TransactionId& id)
+{
+    auto& b { buckets.try_emplace(id.pinHeight).first->second };
+    auto iter { std::lower_bound(b.begin(), b.end(), id) };
+    if (iter != b.end() && *iter == id)
+        return false;
+    b.insert(iter, id);
+    n += 1;
+    filter_add(id);
+    return true;
+}
+
+bool TransactionIds::assign(std::vector<TransactionId>&& ids)
+{
+    std::sort(ids.begin(), ids.end(), ByPinHeight());
+    if (std::adjacent_find(ids.begin(), ids.end()) != ids.end())
+        return false;
+    buckets.clear();
+    auto begin { ids.begin() };
+    while (begin != ids.end()) {
+        auto end { std::find_if(begin, ids.end(), [&](auto& id) { return id.pinHeight != begin->pinHeight; }) };
+        buckets.emplace_hint(buckets.end(), begin->pinHeight, Bucket(begin, end));
+        begin = end;
+    }
+    n = ids.size();
+    rebuild_filter();
+    return true;
+}
+
+void TransactionIds::merge(TransactionIds&& other)
+{
+    if (buckets.empty()) {
+        *this = std::move(other);
+        return;
+    }
+    for (auto& [pinHeight, bucket] : other.buckets)
+        merge_bucket(pinHeight, bucket);
+    other = {};
+}
+
+void TransactionIds::merge(std::vector<TransactionId>&& ids)
+{
+    std::sort(ids.begin(), ids.end(), ByPinHeight());
+    auto begin { ids.begin() };
+    Bucket bucket;
+    while (begin != ids.end()) {
+        auto end { std::find_if(begin, ids.end(), [&](auto& id) { return id.pinHeight != begin->pinHeight; }) };
+        bucket.assign(begin, end);
+        merge_bucket(begin->pinHeight, bucket);
+        begin = end;
+    }
+}
+
+void TransactionIds::merge_bucket(const PinHeight& pinHeight, const Bucket& sorted)
+{
+    auto& b { buckets.try_emplace(pinHeight).first->second };
+    const size_t before { b.size() };
+    b.insert(b.end(), sorted.begin(), sorted.end());
+    std::inplace_merge(b.begin(), b.begin() + before, b.end());
+    b.erase(std::unique(b.begin(), b.end()), b.end());
+    n += b.size() - before;
+    if (n > filter.capacity()) {
+        rebuild_filter();
+    } else {
+        for (auto& id : sorted)
+            filter.add(id);
+    }
+}
+
+void TransactionIds::filter_add(const TransactionId& id)
+{
+    if (n > filter.capacity())
+        rebuild_filter();
+    else
+        filter.add(id);
+}
+
+void TransactionIds::prune(Height length)
+{
+    const Height minPinHeight { (length + 1).pin_begin() };
+    auto end { buckets.lower_bound(PinHeight(minPinHeight)) };
+    if (end == buckets.begin())
+        return;
+    for (auto iter { buckets.begin() }; iter != end; ++iter)
+        n -= iter->second.size();
+    buckets.erase(buckets.begin(), end);
+    // Bloom filters cannot delete
+    rebuild_filter();
+}
+
+void TransactionIds::rebuild_filter()
+{
+    filter.reset(2 * n);
+    for (auto& [_, b] : buckets)
+        for (auto& id : b)
+            filter.add(id);
+}
+}
@@ -1,6 +1,8 @@
 #pragma once
 #include "block/body/transaction_id.hpp"
-#include <set>
+#include <cstdint>
+#include <map>
+#include <vector>
 namespace chainserver {
 
 struct ByPinHeight {
@@ -11,7 +13,52 @@ struct ByPinHeight {
         return tid1.pinHeight < tid2.pinHeight;
     }
 };
-struct TransactionIds : public std::set<TransactionId, ByPinHeight> {
+
+// Transaction ids of the pin window for replay protection. Ids are stored
+// in sorted vectors per pin height such that pruning drops whole buckets.
+// A blocked Bloom filter in front answers the common negative membership
+// test with a single cache line access. Iteration is ordered by ByPinHeight.
+class TransactionIds {
+    using Bucket = std::vector<TransactionId>; // sorted
+    using Buckets = std::map<PinHeight, Bucket>;
+
+public:
+    class const_iterator {
+    public:
+        using value_type = TransactionId;
+        using difference_type = std::ptrdiff_t;
+        using reference = const TransactionId&;
+        using pointer = const TransactionId*;
+        using iterator_category = std::forward_iterator_tag;
+        const_iterator() = default;
+        reference operator*() const { return iter->second[i]; }
+        pointer operator->() const { return &iter->second[i]; }
+        const_iterator& operator++()
+        {
+            if (++i == iter->second.size()) {
+                ++iter;
+                i = 0;
+            }
+            return *this;
+        }
+        const_iterator operator++(int)
+        {
+            auto tmp { *this };
+            ++*this;
+            return tmp;
+        }
+        bool operator==(const const_iterator&) const = default;
+
+    private:
+        friend class TransactionIds;
+        const_iterator(Buckets::const_iterator iter)
+            : iter(iter)
+        {
+        }
+        Buckets::const_iterator iter;
+        size_t i { 0 };
+    };
+
     static std::pair<Height, Height> block_range(Height length)
     {
         Height upper { length + 1 }; // height of next block
@@ -19,12 +66,44 @@ struct TransactionIds : public std::set<TransactionId, ByPinHeight> {
                                               // the same pinHeight
         return { lower, upper };
     }
-    void prune(Height length)
+    [[nodiscard]] bool contains(const TransactionId&) const;
+    bool insert(const TransactionId&); // false if already present
+    // bulk load replacing the content, false if ids contain duplicates
+    [[nodiscard]] bool assign(std::vector<TransactionId>&& ids);
+    void merge(TransactionIds&&);
+    template <typename Range>
+    void merge(const Range& ids)
     {
-        const Height minPinHeight { (length + 1).pin_begin() };
-        auto iter = begin();
-        while (iter != end() && iter->pinHeight < minPinHeight)
-            erase(iter++);
+        merge(std::vector<TransactionId>(ids.begin(), ids.end()));
     }
+    void prune(Height length);
+    size_t size() const { return n; }
+    const_iterator begin() const { return { buckets.begin() }; }
+    const_iterator end() const { return { buckets.end() }; }
+
+private:
+    class BloomFilter {
+    public:
+        void reset(size_t capacity);
+        size_t capacity() const { return cap; }
+        void add(const TransactionId&);
+        [[nodiscard]] bool may_contain(const TransactionId&) const;
+
+    private:
+        struct alignas(64) Block {
+            uint64_t words[8];
+        };
+        size_t index(uint64_t h) const { return h & (blocks.size() - 1); }
+        size_t cap { 0 }; // allocated on the first insert
+        std::vector<Block> blocks;
+    };
+    void merge(std::vector<TransactionId>&&);
+    void merge_bucket(const PinHeight&, const Bucket& sorted);
+    void filter_add(const TransactionId&);
+    void rebuild_filter();
+
+    Buckets buckets;
+    size_t n { 0 };
+    BloomFilter filter;
 };
 }
@@ -3,12 +3,27 @@
 
 bool Rcvbuffer::verify()
 {
-    auto h = hashSHA256(body.bytes);
+    auto b { body.bytes() };
+    auto h = hashSHA256(b.data(), b.size());
     if (memcmp(header + 4, h.data(), 4) != 0) {
         return false;
     };
     return true;
 }
+
+std::vector<bool> Rcvbuffer::verify(std::span<const Rcvbuffer> buffers)
+{
+    std::vector<std::span<const uint8_t>> bodies;
+    bodies.reserve(buffers.size());
+    for (auto& b : buffers)
+        bodies.push_back(b.body.bytes());
+    std::vector<Hash> hashes(buffers.size());
+    hashSHA256_batch(bodies, hashes.data());
+    std::vector<bool> res(buffers.size());
+    for (size_t i = 0; i < buffers.size(); ++i)
+        res[i] = memcmp(buffers[i].header + 4, hashes[i].data(), 4) == 0;
+    return res;
+}
 namespace {
 template <typename V, uint8_t prevcode>
 V check(uint8_t, Reader&)
@@ -1,10 +1,12 @@
 #pragma once
 
+#include "communication/buffers/slab_pool.hpp"
 #include "communication/messages.hpp"
 #include "general/errors.hpp"
 #include "general/reader.hpp"
 #include <cstdint>
 #include <cstring>
+#include <utility>
 
 class Rcvbuffer {
     friend class Connection;
@@ -15,12 +17,13 @@ public:
     {
         return Reader(body.msg());
     }
-    std::vector<uint8_t>&& extractBody() { return std::move(body.bytes); }
     uint32_t bodysize()
     {
         return readuint32(header);
     }
     bool verify();
+    // checksum verification of many messages at once (multi-buffer SHA256)
+    static std::vector<bool> verify(std::span<const Rcvbuffer> buffers);
     uint8_t type() { return header[9]; }
     Rcvbuffer() {};
     Rcvbuffer(Rcvbuffer&& buf)
@@ -28,7 +31,17 @@ public:
         memcpy(header, buf.header, sizeof(header));
         body = std::move(buf.body);
         pos = buf.pos;
+        bsize = buf.bsize;
         buf.pos = 0;
+        buf.bsize = 0;
+    }
+    Rcvbuffer& operator=(Rcvbuffer&& buf)
+    {
+        memcpy(header, buf.header, sizeof(header));
+        body = std::move(buf.body);
+        pos = std::exchange(buf.pos, 0);
+        bsize = std::exchange(buf.bsize, 0);
+        return *this;
     }
     messages::Msg parse();
 
@@ -36,7 +49,8 @@ private: // private methods
     void clear()
     {
         pos = 0;
-        body.bytes.clear();
+        bsize = 0;
+        body.slab = {};
     }
     int32_t allocate_body()
     {
@@ -51,17 +65,13 @@ private: // private methods
         if (bsize < 2 || bsize > 2 + sb) {
             return EMSGLEN;
         }
-        // Now allocate
-        body.bytes.resize(std::min(bsize, size_t(1024ul)));
+        // Now allocate full body at once, libuv reads directly into it
+        body.slab = SlabPool::acquire(bsize);
         // Copy additional bytes into body (needed for checksum)
-        body.bytes[0] = header[8];
-        body.bytes[1] = header[9];
+        body.slab.data()[0] = header[8];
+        body.slab.data()[1] = header[9];
         return 0;
     }
-    void realloc()
-    {
-        body.bytes.resize(std::min(bsize, body.bytes.size() + size_t(1024ul)));
-    }
     bool finished()
     {
         return bsize > 0 && bsize + 8 == pos;
@@ -71,8 +81,9 @@ private: // private members
     uint8_t header[10]; // 4 bytes body size + 4 bytes checksum + 2 bytes message
                         // type,
     struct Body {
-        std::vector<uint8_t> bytes;
-        std::span<const uint8_t> msg() const { return std::span(bytes).subspan(2); };
+        SlabPool::Slab slab;
+        std::span<const uint8_t> bytes() const { return slab.span(); };
+        std::span<const uint8_t> msg() const { return bytes().subspan(2); };
     } body;
     size_t pos = 0;
     size_t bsize = 0;
@@ -0,0 +1,45 @@
+#include "slab_pool.hpp"
+#include <array>
+#include <bit>
+#include <mutex>
+#include <vector>
+
+namespace {
+constexpr size_t unpooled { size_t(-1) };
+std::mutex m;
+std::array<std::vector<std::unique_ptr<uint8_t[]>>, 32> freeSlabs;
+}
+
+void SlabPool::Slab::release()
+{
+    if (!ptr)
+        return;
+    len = 0;
+    if (sizeClass == unpooled) {
+        ptr.reset();
+        return;
+    }
+    const size_t maxCached { std::max(size_t(1), classBudget >> sizeClass) };
+    std::unique_lock l(m);
+    auto& v { freeSlabs[sizeClass] };
+    if (v.size() < maxCached)
+        v.push_back(std::move(ptr));
+    ptr.reset();
+}
+
+auto SlabPool::acquire(size_t size) -> Slab
+{
+    const size_t shift { std::max(minShift, size_t(std::bit_width(size - 1))) };
+    if (size == 0 || shift > maxShift)
+        return { std::unique_ptr<uint8_t[]>(new uint8_t[size]), unpooled, size };
+    {
+        std::unique_lock l(m);
+        auto& v { freeSlabs[shift] };
+        if (!v.empty()) {
+            auto p { std::move(v.back()) };
+            v.pop_back();
+            return { std::move(p), shift, size };
+        }
+    }
+    return { std::unique_ptr<uint8_t[]>(new uint8_t[size_t(1) << shift]), shift, size };
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <utility>
+
+// Process wide pool of power of two sized memory slabs used as message
+// receive buffers. Slabs are returned to the pool on destruction such
+// that large messages (block batches) do not allocate over and over.
+class SlabPool {
+    static constexpr size_t minShift = 10; // 1 KiB
+    static constexpr size_t maxShift = 21; // 2 MiB
+    static constexpr size_t classBudget = 1 << 20; // cached bytes per size class
+
+public:
+    class Slab {
+        friend class SlabPool;
+        Slab(std::unique_ptr<uint8_t[]> data, size_t sizeClass, size_t size)
+            : ptr(std::move(data))
+            , sizeClass(sizeClass)
+            , len(size)
+        {
+        }
+
+    public:
+        Slab() = default;
+        Slab(Slab&&) = default;
+        Slab& operator=(Slab&& other)
+        {
+            release();
+            ptr = std::move(other.ptr);
+            sizeClass = other.sizeClass;
+            len = std::exchange(other.len, 0);
+            return *this;
+        }
+        ~Slab() { release(); }
+        uint8_t* data() { return ptr.get(); }
+        const uint8_t* data() const { return ptr.get(); }
+        size_t size() const { return len; }
+        std::span<const uint8_t> span() const { return { ptr.get(), len }; }
+
+    private:
+        void release();
+        std::unique_ptr<uint8_t[]> ptr;
+        size_t sizeClass { 0 };
+        size_t len { 0 };
+    };
+
+    // thread safe
+    static Slab acquire(size_t size);
+};
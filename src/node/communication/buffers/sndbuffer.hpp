@@ -20,3 +20,20 @@ class Sndbuffer {
 		size_t msgsize() { return len - 10; }
 		size_t fullsize() { return len; }
 };
+
+// Immutable, refcounted send buffer for messages broadcast to many peers.
+// Checksum is written once and all connections reference the same data.
+class SharedSndbuffer {
+	public:
+		SharedSndbuffer(Sndbuffer&& sb)
+			: len(sb.fullsize()) {
+				sb.writeChecksum();
+				ptr = std::move(sb.ptr);
+			}
+		const char* data() const { return ptr.get(); }
+		size_t fullsize() const { return len; }
+
+	private:
+		size_t len;
+		std::shared_ptr<const char[]> ptr;
+};
@@ -9,7 +9,11 @@
 #include "general/reader.hpp"
 #include "general/writer.hpp"
 #include "mempool/entry.hpp"
+#include <array>
 #include <tuple>
+#ifdef WARTHOG_ZSTD
+#include <zstd.h>
+#endif
 
 namespace {
 struct MessageWriter {
@@ -50,6 +54,111 @@ private:
     Sndbuffer sb;
     Writer writer;
 };
+// unsigned LEB128 with zigzag for signed values
+void write_varint(std::vector<uint8_t>& out, int64_t i)
+{
+    uint64_t v { (uint64_t(i) << 1) ^ uint64_t(i >> 63) };
+    while (v >= 0x80) {
+        out.push_back(uint8_t(v) | 0x80);
+        v >>= 7;
+    }
+    out.push_back(uint8_t(v));
+}
+int64_t read_varint(Reader& r)
+{
+    uint64_t v { 0 };
+    for (size_t shift = 0;; shift += 7) {
+        if (shift > 63)
+            throw Error(EMALFORMED);
+        uint8_t b { r.uint8() };
+        v |= uint64_t(b & 0x7F) << shift;
+        if ((b & 0x80) == 0)
+            break;
+    }
+    return int64_t(v >> 1) ^ -int64_t(v & 1);
+}
+
+// header delta encoding of BatchrepDeltaMsg: the first header is complete,
+// every following header is a flag byte, the target unless repeated, the
+// merkle root, the version unless repeated, the timestamp difference and
+// the nonce. The prevhash is the hash of the preceding header.
+enum DeltaFlags : uint8_t {
+    SAMETARGET = 1,
+    SAMEVERSION = 2
+};
+std::vector<uint8_t> delta_encode(const HeaderSpans& spans)
+{
+    std::vector<uint8_t> out;
+    const uint8_t* prev { nullptr };
+    auto append = [&](const uint8_t* p, size_t offset, size_t len) {
+        out.insert(out.end(), p + offset, p + offset + len);
+    };
+    for (auto& s : spans) {
+        for (const uint8_t* h { s.data() }; h != s.data() + s.size(); h += HeaderView::bytesize) {
+            if (!prev) {
+                out.reserve(HeaderView::bytesize + HEADERBATCHSIZE * 45);
+                out.insert(out.end(), h, h + HeaderView::bytesize);
+                prev = h;
+                continue;
+            }
+            const bool sameTarget { memcmp(h + HeaderView::offset_target, prev + HeaderView::offset_target, 4) == 0 };
+            const bool sameVersion { memcmp(h + HeaderView::offset_version, prev + HeaderView::offset_version, 4) == 0 };
+            out.push_back((sameTarget ? SAMETARGET : 0) | (sameVersion ? SAMEVERSION : 0));
+            if (!sameTarget)
+                append(h, HeaderView::offset_target, 4);
+            append(h, HeaderView::offset_merkleroot, 32);
+            if (!sameVersion)
+                append(h, HeaderView::offset_version, 4);
+            write_varint(out, int64_t(readuint32(h + HeaderView::offset_timestamp)) - int64_t(readuint32(prev + HeaderView::offset_timestamp)));
+            append(h, HeaderView::offset_nonce, 4);
+            prev = h;
+        }
+    }
+    return out;
+}
+Batch delta_decode(Reader& r)
+{
+    std::vector<uint8_t> bytes;
+    if (r.remaining() == 0)
+        return Batch(std::move(bytes));
+    bytes.reserve(HeaderView::bytesize * HEADERBATCHSIZE);
+    auto first { r.take_span(HeaderView::bytesize) };
+    bytes.assign(first.begin(), first.end());
+    while (r.remaining() != 0) {
+        if (bytes.size() == HeaderView::bytesize * HEADERBATCHSIZE)
+            throw Error(EBATCHSIZE);
+        const size_t prevPos { bytes.size() - HeaderView::bytesize };
+        bytes.resize(bytes.size() + HeaderView::bytesize);
+        uint8_t* prev { bytes.data() + prevPos };
+        uint8_t* h { prev + HeaderView::bytesize };
+        auto copy = [&](size_t offset, size_t len) {
+            auto s { r.take_span(len) };
+            memcpy(h + offset, s.data(), len);
+        };
+        const uint8_t flags { r.uint8() };
+        if (flags & ~(SAMETARGET | SAMEVERSION))
+            throw Error(EMALFORMED);
+        auto prevhash { HeaderView(prev).hash() };
+        memcpy(h + HeaderView::offset_prevhash, prevhash.data(), 32);
+        if (flags & SAMETARGET)
+            memcpy(h + HeaderView::offset_target, prev + HeaderView::offset_target, 4);
+        else
+            copy(HeaderView::offset_target, 4);
+        copy(HeaderView::offset_merkleroot, 32);
+        if (flags & SAMEVERSION)
+            memcpy(h + HeaderView::offset_version, prev + HeaderView::offset_version, 4);
+        else
+            copy(HeaderView::offset_version, 4);
+        const int64_t timestamp { int64_t(readuint32(prev + HeaderView::offset_timestamp)) + read_varint(r) };
+        if (timestamp < 0 || timestamp > int64_t(std::numeric_limits<uint32_t>::max()))
+            throw Error(EMALFORMED);
+        const uint32_t t { hton32(uint32_t(timestamp)) };
+        memcpy(h + HeaderView::offset_timestamp, &t, 4);
+        copy(HeaderView::offset_nonce, 4);
+    }
+    return Batch(std::move(bytes));
+}
+
 void throw_if_inconsistent(Height length, Worksum worksum)
 {
     if ((length == 0) != worksum.is_zero()) {
@@ -70,24 +179,48 @@ MessageWriter MsgCode<M>::gen_msg(size_t len)
     return { msgcode, len };
 }
 
+template <typename... Fields>
+Reader FixedLayout<Fields...>::take(Reader& r)
+{
+    return r.take_span(size);
+}
+static_assert(PingMsg::Layout::size <= PingMsg::maxSize);
+static_assert(BlockreqMsg::Layout::size <= BlockreqMsg::maxSize);
+
 RandNonce::RandNonce()
     : WithNonce { uint32_t(rand()) } {}
 InitMsg::InitMsg(Reader& r)
-    : descriptor(r.uint32())
-    , sp { r.uint16(), Height(r.uint32()) }
-    , chainLength(r.uint32())
-    , worksum(r.worksum())
-    , grid(r.span())
+    : InitMsg(Layout::take(r), r)
 {
+}
+
+InitMsg::InitMsg(Reader&& f, Reader& r)
+    : descriptor(f.uint32())
+    , sp { f.uint16(), Height(f.uint32()) }
+    , chainLength(f.uint32())
+    , worksum(f.worksum())
+    , grid(r.take_span(f.uint32()))
+{
+    if (r.remaining() != 0)
+        capabilities = r.uint8();
     if (grid.slot_end().upper() <= chainLength)
         throw Error(EGRIDMISMATCH);
     throw_if_inconsistent(chainLength, worksum);
 }
 
-Sndbuffer InitMsg::serialize_chainstate(const ConsensusSlave& cs)
+uint8_t capability::ours()
+{
+#ifdef WARTHOG_ZSTD
+    return HEADERDELTA | ZSTD | TXRECON | BLOCKPUSH | BLOCKBUDGET;
+#else
+    return HEADERDELTA | TXRECON | BLOCKPUSH | BLOCKBUDGET;
+#endif
+}
+
+Sndbuffer InitMsg::serialize_chainstate(const ConsensusSlave& cs, bool withCapabilities)
 {
     const size_t N = cs.headers().complete_batches().size();
-    size_t len = 4 + 2 + 4 + 4 + 32 + 4 + N * 80;
+    size_t len = Layout::size + N * 80 + (withCapabilities ? 1 : 0);
     auto& sp { cs.get_signed_snapshot_priority() };
     auto mw { gen_msg(len) };
     mw << cs.descriptor()
@@ -97,6 +230,8 @@ Sndbuffer InitMsg::serialize_chainstate(const ConsensusSlave& cs)
        << cs.total_work()
        << (uint32_t)(cs.headers().complete_batches().size() * 80)
        << Range(cs.grid().raw());
+    if (withCapabilities)
+        mw << capability::ours();
     return mw;
 }
 
@@ -111,11 +246,12 @@ ForkMsg::ForkMsg(Descriptor descriptor, NonzeroHeight chainLength, Worksum works
 }
 auto ForkMsg::from_reader(Reader& r) -> ForkMsg
 {
+    auto f { Layout::take(r) };
     return ForkMsg {
-        r.uint32(),
-        Height(r.uint32()).nonzero_throw(EZEROHEIGHT),
-        r.worksum(),
-        Height(r.uint32()).nonzero_throw(EFORKHEIGHT),
+        f.uint32(),
+        Height(f.uint32()).nonzero_throw(EZEROHEIGHT),
+        f.worksum(),
+        Height(f.uint32()).nonzero_throw(EFORKHEIGHT),
         r.rest()
     };
 }
@@ -123,7 +259,7 @@ auto ForkMsg::from_reader(Reader& r) -> ForkMsg
 ForkMsg::operator Sndbuffer() const
 {
     // assert(grid.size() > 0); // because it is a fork
-    return gen_msg(4 + 4 + 32 + 4 + grid.raw().size())
+    return gen_msg(Layout::size + grid.raw().size())
         << descriptor << chainLength << worksum << forkHeight
         << grid.raw();
 }
@@ -139,16 +275,17 @@ AppendMsg::AppendMsg(NonzeroHeight newLength,
 }
 auto AppendMsg::from_reader(Reader& r) -> AppendMsg
 {
+    auto f { Layout::take(r) };
     return {
-        r,
-        r.worksum(),
+        f,
+        f.worksum(),
         r.rest()
     };
 }
 
 AppendMsg::operator Sndbuffer() const
 {
-    return gen_msg(4 + 32 + grid.raw().size())
+    return gen_msg(Layout::size + grid.raw().size())
         << newLength
         << worksum
         << grid.raw();
@@ -156,17 +293,18 @@ AppendMsg::operator Sndbuffer() const
 
 auto SignedPinRollbackMsg::from_reader(Reader& r) -> SignedPinRollbackMsg
 {
+    auto f { Layout::take(r) };
     return {
-        r,
-        r,
-        r.worksum(),
-        r.uint32()
+        f,
+        f,
+        f.worksum(),
+        f.uint32()
     };
 }
 
 SignedPinRollbackMsg::operator Sndbuffer() const
 {
-    return gen_msg(signedSnapshot.binary_size + 4 + 32 + 4)
+    return gen_msg(Layout::size)
         << signedSnapshot
         << shrinkLength
         << worksum
@@ -175,11 +313,12 @@ SignedPinRollbackMsg::operator Sndbuffer() const
 
 auto PingMsg::from_reader(Reader& r) -> PingMsg
 {
+    auto f { Layout::take(r) };
     return PingMsg {
-        r.uint32(),
-        r,
-        r.uint16(),
-        r.uint16()
+        f.uint32(),
+        f,
+        f.uint16(),
+        f.uint16()
     };
 }
 // : RandNonce(r.uint32()),
@@ -187,7 +326,7 @@ auto PingMsg::from_reader(Reader& r) -> PingMsg
 
 PingMsg::operator Sndbuffer() const
 {
-    return gen_msg(4 + 2 + 4 + 2 + 2)
+    return gen_msg(Layout::size)
         << nonce
         << sp.importance
         << sp.height
@@ -255,14 +394,15 @@ std::string BatchreqMsg::log_str() const
 
 auto BatchreqMsg::from_reader(Reader& r) -> BatchreqMsg
 {
-    return { r.uint32(), r };
+    auto f { Layout::take(r) };
+    return { f.uint32(), f };
 }
 
 BatchreqMsg::operator Sndbuffer() const
 {
     assert(selector.startHeight != 0);
     auto& s = selector;
-    return gen_msg(4 + 4 + 4 + 2)
+    return gen_msg(Layout::size)
         << nonce
         << s.descriptor
         << s.startHeight
@@ -276,12 +416,13 @@ std::string ProbereqMsg::log_str() const
 
 auto ProbereqMsg::from_reader(Reader& r) -> ProbereqMsg
 {
-    return { r.uint32(), r.uint32(), Height(r).nonzero_throw(EPROBEHEIGHT) };
+    auto f { Layout::take(r) };
+    return { f.uint32(), f.uint32(), Height(f).nonzero_throw(EPROBEHEIGHT) };
 }
 
 ProbereqMsg::operator Sndbuffer() const
 {
-    return gen_msg(12) << nonce << descriptor << height;
+    return gen_msg(Layout::size) << nonce << descriptor << height;
 }
 
 auto ProberepMsg::from_reader(Reader& r) -> ProberepMsg
@@ -327,15 +468,32 @@ ProberepMsg::operator Sndbuffer() const
     return w;
 }
 
-auto BatchrepMsg::from_reader(Reader& r) -> BatchrepMsg
+auto BatchrepView::from_reader(Reader& r) -> BatchrepView
 {
-    return { r.uint32(), r.rest() };
+    auto nonce = r.uint32();
+    auto headers { r.rest() };
+    if (headers.size() % HeaderView::bytesize)
+        throw Error(EMALFORMED);
+    if (headers.size() > HeaderView::bytesize * HEADERBATCHSIZE)
+        throw Error(EBATCHSIZE);
+    return { nonce, headers };
 }
 
 BatchrepMsg::operator Sndbuffer() const
 {
-    return gen_msg(4 + batch.raw().size())
-        << nonce << Range(batch.raw());
+    return serialize(nonce, { batch.raw() });
+}
+
+Sndbuffer BatchrepMsg::serialize(uint32_t nonce, const HeaderSpans& spans)
+{
+    size_t len { 4 };
+    for (auto& s : spans)
+        len += s.size();
+    auto mw { gen_msg(len) };
+    mw << nonce;
+    for (auto& s : spans)
+        mw << Range(s.data(), s.size());
+    return mw;
 }
 
 std::string BlockreqMsg::log_str() const
@@ -345,27 +503,38 @@ std::string BlockreqMsg::log_str() const
 
 BlockreqMsg::operator Sndbuffer() const
 {
-    return gen_msg(16)
+    return gen_msg(Layout::size)
         << nonce
         << range;
 }
 
 auto BlockreqMsg::from_reader(Reader& r) -> BlockreqMsg
 {
-    return { r.uint32(), r };
+    auto f { Layout::take(r) };
+    return { f.uint32(), f };
 }
 
-auto BlockrepMsg::from_reader(Reader& r) -> BlockrepMsg
+auto BlockrepView::from_reader(Reader& r) -> BlockrepView
 {
-    // return
     auto nonce = r.uint32();
-    std::vector<BodyContainer> bodies;
+    std::vector<std::span<const uint8_t>> bodies;
     while (r.remaining() != 0) {
-        bodies.push_back({ r });
+        auto s { r.span() };
+        if (s.size() > MAXBLOCKSIZE)
+            throw Error(EBLOCKSIZE);
+        bodies.push_back(s);
     }
     return { nonce, std::move(bodies) };
 }
 
+BlockrepView::BlockrepView(const BlockrepMsg& m)
+    : WithNonce { m.nonce }
+{
+    blocks.reserve(m.blocks.size());
+    for (auto& b : m.blocks)
+        blocks.push_back(b.data());
+}
+
 BlockrepMsg::operator Sndbuffer() const
 {
     size_t size = 0;
@@ -380,24 +549,46 @@ BlockrepMsg::operator Sndbuffer() const
     return mw;
 }
 
+std::optional<Sndbuffer> BlockrepMsg::direct_send(uint32_t nonce, const std::vector<size_t>& lengths,
+    const std::function<bool(size_t, Writer&)>& writeBody)
+{
+    size_t size = 4;
+    for (auto l : lengths)
+        size += 4 + l;
+    Sndbuffer sb(msgcode, size);
+    Writer w(sb.msgdata(), sb.msgsize());
+    w << nonce;
+    for (size_t i = 0; i < lengths.size(); ++i) {
+        w << uint32_t(lengths[i]);
+        if (!writeBody(i, w))
+            return {};
+    }
+    assert(w.remaining() == 0);
+    return sb;
+}
+
 auto TxsubscribeMsg::from_reader(Reader& r) -> TxsubscribeMsg
 {
+    auto f { Layout::take(r) };
     return {
-        r.uint32(), r
+        f.uint32(), f
     };
 }
 
 TxsubscribeMsg::operator Sndbuffer() const
 {
-    return gen_msg(8) << nonce << upper;
+    return gen_msg(Layout::size) << nonce << upper;
 }
 
 Sndbuffer TxnotifyMsg::direct_send(send_iter begin, send_iter end)
 {
-    auto mw { gen_msg(4 + (end - begin) * TransactionId::bytesize) };
-    mw << RandNonce().nonce;
+    assert(end - begin <= std::numeric_limits<uint16_t>::max());
+    auto mw { gen_msg(4 + 2 + (end - begin) * (TransactionId::bytesize + 2)) };
+    mw << RandNonce().nonce
+       << (uint16_t)(end - begin);
     for (auto iter = begin; iter != end; ++iter) {
-        mw << iter->first;
+        mw << iter->first
+           << iter->second.fee;
     }
     return mw;
 }
@@ -420,9 +611,8 @@ TxnotifyMsg::operator Sndbuffer() const
 {
     assert(txids.size() <= std::numeric_limits<uint16_t>::max());
     assert(this->txids.size() > 0);
-    auto mw { gen_msg(4 + txids.size() * TransactionId::bytesize) };
+    auto mw { gen_msg(4 + 2 + txids.size() * (TransactionId::bytesize + 2)) };
     mw << nonce;
-    assert(txids.size() <= std::numeric_limits<uint16_t>::max());
     mw << (uint16_t)txids.size();
     for (auto& t : txids) {
         mw << t.txid
@@ -500,15 +690,210 @@ TxrepMsg::operator Sndbuffer() const
 }
 auto LeaderMsg::from_reader(Reader& r) -> LeaderMsg
 {
-    return { r };
+    auto f { Layout::take(r) };
+    return { f };
 }
 
 LeaderMsg::operator Sndbuffer() const
 {
-    return gen_msg(signedSnapshot.binary_size)
+    return gen_msg(Layout::size)
         << signedSnapshot;
 }
 
+std::string CompactreqMsg::log_str() const
+{
+    return "compactreq [" + std::to_string(range.lower) + "," + std::to_string(range.upper) + "]";
+}
+
+auto CompactreqMsg::from_reader(Reader& r) -> CompactreqMsg
+{
+    auto nonce { r.uint32() };
+    DescriptedBlockRange range { r };
+    std::vector<uint32_t> prefill;
+    while (r.remaining() != 0) {
+        prefill.push_back(r.uint32());
+        if (prefill.size() > CompactBody::MaxTransfers)
+            throw Error(EMALFORMED);
+    }
+    if (prefill.size() > 0 && range.lower != range.upper)
+        throw Error(EMALFORMED);
+    return { nonce, range, std::move(prefill) };
+}
+
+CompactreqMsg::operator Sndbuffer() const
+{
+    auto mw { gen_msg(16 + 4 * prefill.size()) };
+    mw << nonce << range;
+    for (auto i : prefill)
+        mw << i;
+    return mw;
+}
+
+auto CompactrepMsg::from_reader(Reader& r) -> CompactrepMsg
+{
+    auto nonce = r.uint32();
+    std::vector<CompactBody> bodies;
+    while (r.remaining() != 0) {
+        bodies.push_back({ r });
+    }
+    return { nonce, std::move(bodies) };
+}
+
+CompactrepMsg::operator Sndbuffer() const
+{
+    size_t size = 0;
+    for (auto& b : blocks) {
+        size += b.serialized_size();
+    }
+    auto mw { gen_msg(4 + size) };
+    mw << nonce;
+    for (auto& b : blocks)
+        mw << b;
+
+    return mw;
+}
+
+auto BatchrepDeltaMsg::from_reader(Reader& r) -> BatchrepDeltaMsg
+{
+    auto nonce = r.uint32();
+    return { nonce, delta_decode(r) };
+}
+
+BatchrepDeltaMsg::operator Sndbuffer() const
+{
+    return serialize(nonce, { batch.raw() });
+}
+
+Sndbuffer BatchrepDeltaMsg::serialize(uint32_t nonce, const HeaderSpans& spans)
+{
+    auto encoded { delta_encode(spans) };
+    return gen_msg(4 + encoded.size())
+        << nonce << Range(encoded);
+}
+
+auto BlockrepZstdMsg::from_reader(Reader& r) -> BlockrepZstdMsg
+{
+#ifdef WARTHOG_ZSTD
+    BlockrepZstdMsg m { r.uint32() };
+    const uint32_t size { r.uint32() };
+    if (size > BlockrepMsg::maxSize - 4)
+        throw Error(EMALFORMED);
+    auto compressed { r.rest() };
+    std::vector<uint8_t> bodies(size);
+    auto n { ZSTD_decompress(bodies.data(), bodies.size(), compressed.data(), compressed.size()) };
+    if (ZSTD_isError(n) || n != size)
+        throw Error(EMALFORMED);
+    Reader rb(bodies);
+    while (rb.remaining() != 0)
+        m.blocks.push_back(BodyContainer(rb.span()));
+    return m;
+#else
+    // we never announce capability::ZSTD
+    (void)r;
+    throw Error(EMSGTYPE);
+#endif
+}
+
+std::optional<Sndbuffer> BlockrepZstdMsg::compress(Sndbuffer& blockrep)
+{
+#ifdef WARTHOG_ZSTD
+    constexpr int level { 3 }; // fast, the serving node pays for it
+    assert(blockrep.msgsize() >= 4);
+    const uint8_t* bodies { blockrep.msgdata() + 4 };
+    const size_t size { blockrep.msgsize() - 4 };
+    std::vector<uint8_t> out(ZSTD_compressBound(size));
+    auto n { ZSTD_compress(out.data(), out.size(), bodies, size, level) };
+    if (ZSTD_isError(n) || n + 4 >= size)
+        return {};
+    Sndbuffer sb(msgcode, 4 + 4 + n);
+    Writer w(sb.msgdata(), sb.msgsize());
+    w << Range(blockrep.msgdata(), 4) // nonce
+      << uint32_t(size) << Range(out.data(), n);
+    return sb;
+#else
+    (void)blockrep;
+    return {};
+#endif
+}
+
+auto TxreconreqMsg::from_reader(Reader& r) -> TxreconreqMsg
+{
+    auto nonce { r.uint32() };
+    auto salt { r.uint64() };
+    size_t n { r.uint16() };
+    if (n < mempool::TxSketch::MINCELLS || n > mempool::TxSketch::MAXCELLS
+        || n % mempool::TxSketch::HASHES != 0)
+        throw Error(EMALFORMED);
+    std::vector<mempool::TxSketch::Cell> cells(n);
+    for (auto& c : cells) {
+        c.count = int32_t(r.uint32());
+        c.keySum = r.uint64();
+        c.hashSum = r.uint64();
+    }
+    return { nonce, { salt, std::move(cells) } };
+}
+
+TxreconreqMsg::operator Sndbuffer() const
+{
+    auto& cells { sketch.cells() };
+    auto mw { gen_msg(4 + 8 + 2 + cells.size() * mempool::TxSketch::cellsize) };
+    mw << nonce
+       << sketch.salt()
+       << (uint16_t)cells.size();
+    for (auto& c : cells) {
+        mw << uint32_t(c.count)
+           << c.keySum
+           << c.hashSum;
+    }
+    return mw;
+}
+
+auto TxreconrepMsg::from_reader(Reader& r) -> TxreconrepMsg
+{
+    TxreconrepMsg m { r.uint32(), {} };
+    if (r.uint8() == 0)
+        return m;
+    auto difference { r.uint16() };
+    size_t n { r.uint16() };
+    if (n > difference || n > mempool::TxSketch::MAXCELLS)
+        throw Error(EMALFORMED);
+    std::vector<uint64_t> missing;
+    for (size_t i = 0; i < n; ++i)
+        missing.push_back(r.uint64());
+    m.decoded = Decoded { difference, std::move(missing) };
+    return m;
+}
+
+TxreconrepMsg::operator Sndbuffer() const
+{
+    if (!decoded)
+        return gen_msg(4 + 1) << nonce << false;
+    auto& missing { decoded->missing };
+    auto mw { gen_msg(4 + 1 + 2 + 2 + missing.size() * 8) };
+    mw << nonce << true
+       << decoded->difference
+       << (uint16_t)missing.size();
+    for (auto id : missing)
+        mw << id;
+    return mw;
+}
+
+auto BlockpushMsg::from_reader(Reader& r) -> BlockpushMsg
+{
+    auto height { Height(r.uint32()).nonzero_throw(EZEROHEIGHT) };
+    Header header { r.view<HeaderView>() };
+    BodyContainer body { r };
+    if (body.size() > MAXBLOCKSIZE)
+        throw Error(EBLOCKSIZE);
+    return Block { height, header, std::move(body) };
+}
+
+BlockpushMsg::operator Sndbuffer() const
+{
+    return gen_msg(4 + 80 + block.body.serialized_size())
+        << block.height << block.header << block.body;
+}
+
 namespace {
 template <uint8_t prevcode>
 size_t size_bound(uint8_t)
@@ -556,4 +941,17 @@ size_t size_bound(uint8_t msgtype)
 {
     return TypeExtractor<messages::Msg>::size_bound(msgtype);
 }
+
+const char* name(uint8_t msgtype)
+{
+    // message codes coincide with the variant indices
+    constexpr std::array<const char*, std::variant_size_v<Msg>> names {
+        "init", "fork", "append", "signed_pin_rollback", "ping", "pong",
+        "batchreq", "batchrep", "probereq", "proberep", "blockreq", "blockrep",
+        "txnotify", "txreq", "txrep", "leader", "compactreq", "compactrep",
+        "batchrep_delta", "blockrep_zstd", "txreconreq", "txreconrep",
+        "blockpush"
+    };
+    return msgtype < names.size() ? names[msgtype] : "unknown";
+}
 }
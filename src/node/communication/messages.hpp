@@ -1,4 +1,6 @@
 #pragma once
+#include "block/block.hpp"
+#include "block/body/compact.hpp"
 #include "block/body/container.hpp"
 #include "block/body/primitives.hpp"
 #include "block/body/transaction_id.hpp"
@@ -10,15 +12,19 @@
 #include "general/descriptor.hpp"
 #include "general/params.hpp"
 #include "general/tcp_util.hpp"
+#include "mempool/reconciliation.hpp"
 #include <array>
 #include <chrono>
 #include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <optional>
+#include <type_traits>
 #include <variant>
 #include <vector>
 
 class Reader;
+class Writer;
 class Sndbuffer;
 class ConsensusSlave;
 namespace mempool {
@@ -44,19 +50,72 @@ struct MsgCode {
     static MessageWriter gen_msg(size_t len);
 };
 
+// Serialized size of the fixed-size fields of messages
+template <typename T>
+struct WireSize;
+template <>
+struct WireSize<uint8_t> : std::integral_constant<size_t, 1> { };
+template <>
+struct WireSize<uint16_t> : std::integral_constant<size_t, 2> { };
+template <>
+struct WireSize<uint32_t> : std::integral_constant<size_t, 4> { };
+template <>
+struct WireSize<Descriptor> : std::integral_constant<size_t, 4> { };
+template <>
+struct WireSize<Height> : std::integral_constant<size_t, 4> { };
+template <>
+struct WireSize<NonzeroHeight> : std::integral_constant<size_t, 4> { };
+template <>
+struct WireSize<Worksum> : std::integral_constant<size_t, 32> { };
+template <>
+struct WireSize<SignedSnapshot::Priority> : std::integral_constant<size_t, 2 + 4> { };
+template <>
+struct WireSize<SignedSnapshot> : std::integral_constant<size_t, SignedSnapshot::binary_size> { };
+template <>
+struct WireSize<DescriptedBlockRange> : std::integral_constant<size_t, 4 + 4 + 4> { };
+
+// Fixed-size fields at the start of a message, in wire order. Serialization
+// sizes and maxSize are derived from it and parsing checks the bounds of
+// all fields at once.
+template <typename... Fields>
+struct FixedLayout {
+    static constexpr size_t size { (size_t(0) + ... + WireSize<Fields>::value) };
+    // reads from the returned reader stay within the checked prefix
+    static Reader take(Reader& r);
+};
+
+// Peers from this version on append capability flags to InitMsg
+constexpr uint32_t CAPABILITIESVERSION = (0u << 16) | (1u << 8) | 20u;
+namespace capability {
+constexpr uint8_t HEADERDELTA = 1; // understands BatchrepDeltaMsg
+constexpr uint8_t ZSTD = 2; // understands BlockrepZstdMsg
+constexpr uint8_t TXRECON = 4; // understands TxreconreqMsg and TxreconrepMsg
+constexpr uint8_t BLOCKPUSH = 8; // accepts unsolicited BlockpushMsg
+constexpr uint8_t BLOCKBUDGET = 16; // accepts BlockreqMsg ranges up to MAXBLOCKRANGESIZE, replies a prefix within MAXBLOCKREPSIZE
+// capabilities of this build
+uint8_t ours();
+}
+
 struct InitMsg : public MsgCode<0> {
+    using Layout = FixedLayout<Descriptor, SignedSnapshot::Priority, Height, Worksum, uint32_t>;
     InitMsg(Reader& r);
     static constexpr size_t maxSize = 100000;
-    static Sndbuffer serialize_chainstate(const ConsensusSlave&);
+    // capabilities are only appended for peers that parse them
+    static Sndbuffer serialize_chainstate(const ConsensusSlave&, bool withCapabilities);
 
     Descriptor descriptor;
     SignedSnapshot::Priority sp;
     Height chainLength;
     Worksum worksum;
     Grid grid;
+    uint8_t capabilities { 0 };
+
+private:
+    InitMsg(Reader&& fixed, Reader& r);
 };
 
 struct ForkMsg : public MsgCode<1> {
+    using Layout = FixedLayout<Descriptor, NonzeroHeight, Worksum, NonzeroHeight>;
     static constexpr size_t maxSize = 20000;
     static auto from_reader(Reader& r) -> ForkMsg;
     ForkMsg(Descriptor descriptor, NonzeroHeight chainLength, Worksum worksum, NonzeroHeight forkHeight, Grid grid);
@@ -70,6 +129,7 @@ struct ForkMsg : public MsgCode<1> {
 };
 
 struct AppendMsg : public MsgCode<2> {
+    using Layout = FixedLayout<NonzeroHeight, Worksum>;
     static constexpr size_t maxSize = 4 + 4 + 32 + 80 * 100;
     static AppendMsg from_reader(Reader& r);
     AppendMsg(
@@ -84,6 +144,7 @@ struct AppendMsg : public MsgCode<2> {
 };
 
 struct SignedPinRollbackMsg : public MsgCode<3> {
+    using Layout = FixedLayout<SignedSnapshot, Height, Worksum, Descriptor>;
     static SignedPinRollbackMsg from_reader(Reader& r);
     SignedPinRollbackMsg(
         SignedSnapshot signedPin,
@@ -100,11 +161,12 @@ struct SignedPinRollbackMsg : public MsgCode<3> {
     Height shrinkLength { 0 };
     Worksum worksum;
     Descriptor descriptor;
-    static constexpr size_t maxSize = SignedSnapshot::binary_size + 4 + 32 + 4;
+    static constexpr size_t maxSize = Layout::size;
 };
 
 struct PingMsg : public RandNonce, public MsgCode<4> {
-    static constexpr size_t maxSize = 30; // actually 14 but be generous to avoid bugs;
+    using Layout = FixedLayout<uint32_t, SignedSnapshot::Priority, uint16_t, uint16_t>;
+    static constexpr size_t maxSize = 30; // actually Layout::size but be generous to avoid bugs;
     PingMsg(SignedSnapshot::Priority sp, uint16_t maxAddresses = 5, uint16_t maxTransactions = 100)
         : sp(sp)
         , maxAddresses(maxAddresses)
@@ -149,7 +211,8 @@ struct BatchSelector {
 };
 
 struct BatchreqMsg : public RandNonce, public MsgCode<6> {
-    static constexpr size_t maxSize = 14;
+    using Layout = FixedLayout<uint32_t, Descriptor, NonzeroHeight, uint16_t>;
+    static constexpr size_t maxSize = Layout::size;
     std::string log_str() const;
     static BatchreqMsg from_reader(Reader& r);
     BatchreqMsg(BatchSelector selector)
@@ -163,20 +226,35 @@ struct BatchreqMsg : public RandNonce, public MsgCode<6> {
 
 struct BatchrepMsg : public WithNonce, public MsgCode<7> {
     static constexpr size_t maxSize = 4 + HEADERBATCHSIZE * 80;
-    BatchrepMsg(Reader& r);
     BatchrepMsg(uint32_t nonce, Batch b)
         : WithNonce { nonce }
         , batch(std::move(b))
     {
     }
-    static BatchrepMsg from_reader(Reader& r);
     operator Sndbuffer() const;
+    // writes the headers directly into the send buffer
+    static Sndbuffer serialize(uint32_t nonce, const HeaderSpans&);
 
     Batch batch;
 };
 
+// received BatchrepMsg, the headers reference the receive buffer and are
+// only copied into a Batch if they are retained
+struct BatchrepView : public WithNonce, public MsgCode<7> {
+    static constexpr size_t maxSize = BatchrepMsg::maxSize;
+    static BatchrepView from_reader(Reader& r);
+    BatchrepView(uint32_t nonce, std::span<const uint8_t> headers)
+        : WithNonce { nonce }
+        , headers(headers) {};
+    size_t size() const { return headers.size() / HeaderView::bytesize; }
+    Batch batch() const { return Batch(headers); }
+
+    std::span<const uint8_t> headers;
+};
+
 struct ProbereqMsg : public RandNonce, public MsgCode<8> {
-    static constexpr size_t maxSize = 12;
+    using Layout = FixedLayout<uint32_t, Descriptor, NonzeroHeight>;
+    static constexpr size_t maxSize = Layout::size;
     std::string log_str() const;
     static ProbereqMsg from_reader(Reader& r);
     ProbereqMsg(Descriptor descriptor, NonzeroHeight height)
@@ -217,7 +295,8 @@ struct ProberepMsg : public WithNonce, public MsgCode<9> {
 };
 
 struct BlockreqMsg : public RandNonce, public MsgCode<10> {
-    static constexpr size_t maxSize = 48;
+    using Layout = FixedLayout<uint32_t, DescriptedBlockRange>;
+    static constexpr size_t maxSize = 48; // actually Layout::size
 
     // methods
     std::string log_str() const;
@@ -237,13 +316,16 @@ private:
 };
 
 struct BlockrepMsg : public WithNonce, public MsgCode<11> {
-    static constexpr size_t maxSize = MAXBLOCKBATCHSIZE * (4 + MAXBLOCKSIZE);
+    static constexpr size_t maxSize = MAXBLOCKREPSIZE;
 
     // methods
-    static BlockrepMsg from_reader(Reader& r);
     BlockrepMsg(uint32_t nonce, std::vector<BodyContainer> b)
         : WithNonce { nonce }
         , blocks(std::move(b)) {};
+    // serializes bodies without BodyContainer copies, writeBody(i, w) must
+    // write lengths[i] bytes and returns false if the body is unavailable
+    static std::optional<Sndbuffer> direct_send(uint32_t nonce, const std::vector<size_t>& lengths,
+        const std::function<bool(size_t, Writer&)>& writeBody);
     operator Sndbuffer() const;
     bool empty() const { return blocks.empty(); }
 
@@ -251,6 +333,22 @@ struct BlockrepMsg : public WithNonce, public MsgCode<11> {
     std::vector<BodyContainer> blocks;
 };
 
+// received BlockrepMsg, the bodies reference the receive buffer and are
+// validated in place, only retained bodies are copied into BodyContainers
+struct BlockrepView : public WithNonce, public MsgCode<11> {
+    static constexpr size_t maxSize = BlockrepMsg::maxSize;
+    static BlockrepView from_reader(Reader& r);
+    BlockrepView(uint32_t nonce, std::vector<std::span<const uint8_t>> b)
+        : WithNonce { nonce }
+        , blocks(std::move(b)) {};
+    // references the bodies of an owning message
+    BlockrepView(const BlockrepMsg&);
+    bool empty() const { return blocks.empty(); }
+
+    // data
+    std::vector<std::span<const uint8_t>> blocks;
+};
+
 struct TxsubscribeMsg : public RandNonce, public MsgCode<12> {
     TxsubscribeMsg(Height upper)
         : upper(upper) {};
@@ -260,7 +358,8 @@ struct TxsubscribeMsg : public RandNonce, public MsgCode<12> {
     static TxsubscribeMsg from_reader(Reader& r);
     operator Sndbuffer() const;
     Height upper;
-    static constexpr size_t maxSize = 8;
+    using Layout = FixedLayout<uint32_t, Height>;
+    static constexpr size_t maxSize = Layout::size;
 };
 
 struct TxnotifyMsg : public RandNonce, public MsgCode<13> {
@@ -276,7 +375,7 @@ struct TxnotifyMsg : public RandNonce, public MsgCode<13> {
     static Sndbuffer direct_send(send_iter begin, send_iter end);
     operator Sndbuffer() const;
     std::vector<TxidWithFee> txids;
-    static constexpr size_t maxSize = 4 + TxnotifyMsg::MAXENTRIES * TransactionId::bytesize;
+    static constexpr size_t maxSize = 4 + 2 + TxnotifyMsg::MAXENTRIES * (TransactionId::bytesize + 2);
 };
 
 struct TxreqMsg : public RandNonce, public MsgCode<14> {
@@ -305,7 +404,8 @@ struct TxrepMsg : public RandNonce, public MsgCode<15> {
 };
 
 struct LeaderMsg : public MsgCode<16> {
-    static constexpr size_t maxSize = 4 + 32 + 65;
+    using Layout = FixedLayout<SignedSnapshot>;
+    static constexpr size_t maxSize = Layout::size;
     static LeaderMsg from_reader(Reader& r);
     LeaderMsg(SignedSnapshot snapshot)
         : signedSnapshot(std::move(snapshot)) {};
@@ -315,8 +415,124 @@ struct LeaderMsg : public MsgCode<16> {
     SignedSnapshot signedSnapshot;
 };
 
+// Peers from this version on understand CompactreqMsg and CompactrepMsg
+constexpr uint32_t COMPACTBLOCKSVERSION = (0u << 16) | (1u << 8) | 19u;
+
+struct CompactreqMsg : public RandNonce, public MsgCode<17> {
+    static constexpr size_t maxSize = 20 + 4 * CompactBody::MaxTransfers;
+
+    // methods
+    std::string log_str() const;
+    CompactreqMsg(DescriptedBlockRange range, std::vector<uint32_t> prefill = {})
+        : range(range)
+        , prefill(std::move(prefill)) {};
+    CompactreqMsg(uint32_t nonce, DescriptedBlockRange range, std::vector<uint32_t> prefill)
+        : RandNonce(nonce)
+        , range(range)
+        , prefill(std::move(prefill)) {};
+    static CompactreqMsg from_reader(Reader& r);
+    operator Sndbuffer() const;
+
+    // data
+    DescriptedBlockRange range;
+    std::vector<uint32_t> prefill; // transfer indices to send in full, only for single blocks
+};
+
+struct CompactrepMsg : public WithNonce, public MsgCode<18> {
+    static constexpr size_t maxSize = 4 + MAXBLOCKBATCHSIZE * (4 + CompactBody::MaxSize);
+
+    // methods
+    static CompactrepMsg from_reader(Reader& r);
+    CompactrepMsg(uint32_t nonce, std::vector<CompactBody> b)
+        : WithNonce { nonce }
+        , blocks(std::move(b)) {};
+    operator Sndbuffer() const;
+    bool empty() const { return blocks.empty(); }
+
+    // data
+    std::vector<CompactBody> blocks;
+};
+
+// BatchrepMsg for peers with capability::HEADERDELTA. Prevhashes are
+// omitted, repeated targets and versions are flagged and timestamps are
+// varint encoded differences.
+struct BatchrepDeltaMsg : public WithNonce, public MsgCode<19> {
+    static constexpr size_t maxSize = BatchrepMsg::maxSize;
+    static BatchrepDeltaMsg from_reader(Reader& r);
+    BatchrepDeltaMsg(uint32_t nonce, Batch b)
+        : WithNonce { nonce }
+        , batch(std::move(b))
+    {
+    }
+    operator Sndbuffer() const;
+    static Sndbuffer serialize(uint32_t nonce, const HeaderSpans&);
+
+    Batch batch;
+};
+
+// BlockrepMsg for peers with capability::ZSTD, the bodies are compressed
+// as one zstd frame
+struct BlockrepZstdMsg : public WithNonce, public MsgCode<20> {
+    static constexpr size_t maxSize = BlockrepMsg::maxSize;
+    static BlockrepZstdMsg from_reader(Reader& r);
+    // compresses a serialized BlockrepMsg, empty if that does not pay off
+    static std::optional<Sndbuffer> compress(Sndbuffer& blockrep);
+
+    std::vector<BodyContainer> blocks;
+};
+
+// Sketch of the sender's best mempool entries, sent by the outbound side of
+// connections between peers with capability::TXRECON instead of
+// transaction ids in PongMsg.
+struct TxreconreqMsg : public RandNonce, public MsgCode<21> {
+    static constexpr size_t maxSize = 4 + 8 + 2 + mempool::TxSketch::MAXCELLS * mempool::TxSketch::cellsize;
+    TxreconreqMsg(mempool::TxSketch sketch)
+        : sketch(std::move(sketch)) {};
+    TxreconreqMsg(uint32_t nonce, mempool::TxSketch sketch)
+        : RandNonce(nonce)
+        , sketch(std::move(sketch)) {};
+    static TxreconreqMsg from_reader(Reader& r);
+    operator Sndbuffer() const;
+
+    mempool::TxSketch sketch;
+};
+
+// Short ids of the requester's transactions we do not have, our own extra
+// transactions are sent in a TxnotifyMsg. Empty if the sketch difference
+// could not be decoded, both sides then fall back to announcing their
+// full sets.
+struct TxreconrepMsg : public WithNonce, public MsgCode<22> {
+    static constexpr size_t maxSize = 4 + 1 + 2 + 2 + mempool::TxSketch::MAXCELLS * 8;
+    struct Decoded {
+        uint16_t difference; // size of the symmetric difference
+        std::vector<uint64_t> missing;
+    };
+    TxreconrepMsg(uint32_t nonce, std::optional<Decoded> decoded)
+        : WithNonce { nonce }
+        , decoded(std::move(decoded)) {};
+    static TxreconrepMsg from_reader(Reader& r);
+    operator Sndbuffer() const;
+
+    std::optional<Decoded> decoded;
+};
+
+// Freshly mined block pushed unsolicited to a few fast peers with
+// capability::BLOCKPUSH. Receivers relay it as soon as its proof of work
+// checks out and append it without a BlockreqMsg round-trip.
+struct BlockpushMsg : public MsgCode<23> {
+    static constexpr size_t maxSize = 4 + 80 + 4 + MAXBLOCKSIZE;
+    static BlockpushMsg from_reader(Reader& r);
+    BlockpushMsg(Block b)
+        : block(std::move(b)) {};
+    operator Sndbuffer() const;
+
+    Block block;
+};
+
 namespace messages {
 [[nodiscard]] size_t size_bound(uint8_t msgtype);
+// name of the message type for logs and metrics, "unknown" for invalid types
+[[nodiscard]] const char* name(uint8_t msgtype);
 
-using Msg = std::variant<InitMsg, ForkMsg, AppendMsg, SignedPinRollbackMsg, PingMsg, PongMsg, BatchreqMsg, BatchrepMsg, ProbereqMsg, ProberepMsg, BlockreqMsg, BlockrepMsg, TxnotifyMsg, TxreqMsg, TxrepMsg, LeaderMsg>;
+using Msg = std::variant<InitMsg, ForkMsg, AppendMsg, SignedPinRollbackMsg, PingMsg, PongMsg, BatchreqMsg, BatchrepView, ProbereqMsg, ProberepMsg, BlockreqMsg, BlockrepView, TxnotifyMsg, TxreqMsg, TxrepMsg, LeaderMsg, CompactreqMsg, CompactrepMsg, BatchrepDeltaMsg, BlockrepZstdMsg, TxreconreqMsg, TxreconrepMsg, BlockpushMsg>;
 } // namespace messages
@@ -12,6 +12,9 @@ struct StageSetOperation {
 struct StageAddOperation {
     Headerchain headers;// LATER: remove if no more bugs
     std::vector<Block> blocks;
+    // bodies were parsed and matched against the header merkle roots by
+    // the block downloader when they arrived
+    bool bodiesChecked { false };
 };
 
 using Operation = std::variant<StageSetOperation, StageAddOperation>;
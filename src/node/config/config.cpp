@@ -106,6 +106,41 @@ toml::array& array_ref(toml::node& n)
     }
     throw std::runtime_error("Expecting array at line "s + std::to_string(n.source().begin.line) + ".");
 }
+void parse_thread_settings(Config::ThreadSettings& s, toml::node& n)
+{
+    auto t { n.as_table() };
+    if (!t)
+        throw std::runtime_error("Expecting table at line "s + std::to_string(n.source().begin.line) + ".");
+    for (auto& [k, v] : *t) {
+        if (k == "cores") {
+            s.cores.clear();
+            for (auto& e : array_ref(v)) {
+                auto c { fetch<int64_t>(e) };
+                if (c < 0 || c >= 1024)
+                    throw std::runtime_error("Invalid core at line "s + std::to_string(e.source().begin.line) + ", expected value in [0,1023].");
+                s.cores.push_back(c);
+            }
+        } else if (k == "nice") {
+            auto p { fetch<int64_t>(v) };
+            if (p < -20 || p > 19)
+                throw std::runtime_error("Invalid nice at line "s + std::to_string(v.source().begin.line) + ", expected value in [-20,19].");
+            s.nice = p;
+        } else
+            warning_config(k);
+    }
+}
+
+toml::table dump_thread_settings(const Config::ThreadSettings& s)
+{
+    toml::array cores;
+    for (auto c : s.cores)
+        cores.push_back(int64_t(c));
+    toml::table t { { "cores", cores } };
+    if (s.nice)
+        t.insert_or_assign("nice", int64_t(*s.nice));
+    return t;
+}
+
 std::vector<EndpointAddress> parse_endpoints(std::string csv)
 {
     std::vector<EndpointAddress> out;
@@ -206,6 +241,23 @@ int Config::process_gengetopt(gengetopt_args_info& ai)
                             data.chaindb = fetch<std::string>(v);
                         else if (k == "peers-db")
                             data.peersdb = fetch<std::string>(v);
+                        else if (k == "chain-db-profile") {
+                            auto p { parse_sqlite_profile(fetch<std::string>(v)) };
+                            if (!p)
+                                throw std::runtime_error("Invalid chain-db-profile at line "s + std::to_string(v.source().begin.line) + ", expected \"sync\", \"balanced\" or \"durable\".");
+                            data.chaindbProfile = *p;
+                        } else if (k == "prune-depth") {
+                            auto n { fetch<int64_t>(v) };
+                            if (n != 0 && (n < Data::minPruneDepth || n > std::numeric_limits<uint32_t>::max()))
+                                throw std::runtime_error("Invalid prune-depth at line "s + std::to_string(v.source().begin.line) + ", expected 0 or at least " + std::to_string(Data::minPruneDepth) + ".");
+                            data.pruneDepth = n;
+                        } else if (k == "prune-history") {
+                            data.pruneHistory = fetch<bool>(v);
+                        } else if (k == "archive-blocks") {
+                            data.archiveBlocks = fetch<bool>(v);
+                        } else if (k == "verify") {
+                            data.verify = fetch<bool>(v);
+                        }
                         else
                             warning_config(k);
                     }
@@ -213,7 +265,44 @@ int Config::process_gengetopt(gengetopt_args_info& ai)
                     for (auto& [k, v] : *t) {
                         if (k == "bind")
                             jsonrpc.bind = fetch_endpointaddress(v);
-                        else
+                        else if (k == "read-connections") {
+                            auto n { fetch<int64_t>(v) };
+                            if (n < 1 || n > 64)
+                                throw std::runtime_error("Invalid read-connections at line "s + std::to_string(v.source().begin.line) + ", expected value in [1,64].");
+                            jsonrpc.readConnections = n;
+                        } else if (k == "threads") {
+                            auto n { fetch<int64_t>(v) };
+                            if (n < 1 || n > 64)
+                                throw std::runtime_error("Invalid threads at line "s + std::to_string(v.source().begin.line) + ", expected value in [1,64].");
+                            jsonrpc.threads = n;
+                        } else if (k == "rate-limit") {
+                            auto d { fetch<double>(v) };
+                            if (!(d >= 0.0))
+                                throw std::runtime_error("Invalid rate-limit at line "s + std::to_string(v.source().begin.line) + ", expected non-negative value.");
+                            jsonrpc.rateLimit = d;
+                        } else if (k == "max-inflight") {
+                            auto n { fetch<int64_t>(v) };
+                            if (n < 1 || n > 65536)
+                                throw std::runtime_error("Invalid max-inflight at line "s + std::to_string(v.source().begin.line) + ", expected value in [1,65536].");
+                            jsonrpc.maxInflight = n;
+                        } else
+                            warning_config(k);
+                    }
+                } else if (key == "stratum") {
+                    for (auto& [k, v] : *t) {
+                        if (k == "bind")
+                            stratum.bind = fetch_endpointaddress(v);
+                        else if (k == "difficulty") {
+                            auto d { fetch<double>(v) };
+                            if (!(d >= 1.0))
+                                throw std::runtime_error("Invalid difficulty at line "s + std::to_string(v.source().begin.line) + ", expected value of at least 1.");
+                            stratum.difficulty = d;
+                        } else if (k == "share-interval") {
+                            auto n { fetch<int64_t>(v) };
+                            if (n < 0 || n > 3600)
+                                throw std::runtime_error("Invalid share-interval at line "s + std::to_string(v.source().begin.line) + ", expected value in [0,3600].");
+                            stratum.shareInterval = n;
+                        } else
                             warning_config(k);
                     }
                 } else if (key == "node") {
@@ -226,6 +315,8 @@ int Config::process_gengetopt(gengetopt_args_info& ai)
                             for (auto& e : c) {
                                 peers.connect.push_back(fetch_endpointaddress(e));
                             }
+                        } else if (k == "follow") {
+                            node.follow = fetch_endpointaddress(v);
                         } else if (k == "leader-key") {
                             node.snapshotSigner = parse_leader_key(fetch<std::string>(v));
                         } else if (k == "enable-ban") {
@@ -234,13 +325,81 @@ int Config::process_gengetopt(gengetopt_args_info& ai)
                             peers.allowLocalhostIp = fetch<bool>(v);
                         } else if (k == "log-communication") {
                             node.logCommunication = fetch<bool>(v);
+                        } else if (k == "io-threads") {
+                            auto n { fetch<int64_t>(v) };
+                            if (n < 1 || n > 64)
+                                throw std::runtime_error("Invalid io-threads at line "s + std::to_string(v.source().begin.line) + ", expected value in [1,64].");
+                            node.ioThreads = n;
+                        } else if (k == "block-push-peers") {
+                            auto n { fetch<int64_t>(v) };
+                            if (n < 0 || n > 16)
+                                throw std::runtime_error("Invalid block-push-peers at line "s + std::to_string(v.source().begin.line) + ", expected value in [0,16].");
+                            node.blockPushPeers = n;
+                        } else if (k == "upload-limit-inbound") {
+                            auto n { fetch<int64_t>(v) };
+                            if (n < 0)
+                                throw std::runtime_error("Invalid upload-limit-inbound at line "s + std::to_string(v.source().begin.line) + ", expected kB/s >= 0.");
+                            node.uploadLimitInbound = n;
+                        } else if (k == "upload-limit-outbound") {
+                            auto n { fetch<int64_t>(v) };
+                            if (n < 0)
+                                throw std::runtime_error("Invalid upload-limit-outbound at line "s + std::to_string(v.source().begin.line) + ", expected kB/s >= 0.");
+                            node.uploadLimitOutbound = n;
                         } else
                             warning_config(k);
                     }
+                } else if (key == "capture") {
+                    for (auto& [k, v] : *t) {
+                        if (k == "file") {
+                            capture.file = fetch<std::string>(v);
+                        } else if (k == "peers") {
+                            capture.peers.clear();
+                            for (auto& e : array_ref(v)) {
+                                auto ip { IPv4::parse(fetch<std::string>(e)) };
+                                if (!ip)
+                                    throw std::runtime_error("Invalid peer IP at line "s + std::to_string(e.source().begin.line) + ".");
+                                capture.peers.push_back(*ip);
+                            }
+                        } else if (k == "replay") {
+                            capture.replay = fetch<std::string>(v);
+                        } else if (k == "replay-paced") {
+                            capture.replayPaced = fetch<bool>(v);
+                        } else
+                            warning_config(k);
+                    }
+                } else if (key == "memory") {
+                    for (auto& [k, v] : *t) {
+                        if (k == "budget") {
+                            auto n { fetch<int64_t>(v) };
+                            if (n < 0 || n > (int64_t(1) << 30))
+                                throw std::runtime_error("Invalid budget at line "s + std::to_string(v.source().begin.line) + ", expected MiB >= 0.");
+                            memory.budget = n;
+                        } else
+                            warning_config(k);
+                    }
+                } else if (key == "threads") {
+                    for (auto& [k, v] : *t) {
+                        if (k == "chainserver")
+                            parse_thread_settings(threads.chainserver, v);
+                        else if (k == "eventloop")
+                            parse_thread_settings(threads.eventloop, v);
+                        else if (k == "peerserver")
+                            parse_thread_settings(threads.peerserver, v);
+                        else if (k == "http")
+                            parse_thread_settings(threads.http, v);
+                        else if (k == "uv")
+                            parse_thread_settings(threads.uv, v);
+                        else if (k == "verifier")
+                            parse_thread_settings(threads.verifier, v);
+                        else
+                            warning_config(k);
+                    }
                 } else {
                     warning_config(key);
                 }
             }
+            if (data.archiveBlocks && data.pruneDepth != 0)
+                throw std::runtime_error("Configuration settings archive-blocks and prune-depth cannot be combined.");
             if (ai.test_given) {
                 std::cout << "Configuration file \"" + filename + "\" is vaild.\n";
                 return 0;
@@ -297,17 +456,61 @@ std::string Config::dump()
     toml::table tbl;
     tbl.insert_or_assign("jsonrpc", toml::table {
                                         { "bind", jsonrpc.bind.to_string() },
+                                        { "read-connections", int64_t(jsonrpc.readConnections) },
+                                        { "threads", int64_t(jsonrpc.threads) },
+                                        { "rate-limit", jsonrpc.rateLimit },
+                                        { "max-inflight", int64_t(jsonrpc.maxInflight) },
                                     });
+    toml::table stratumTbl {
+        { "difficulty", stratum.difficulty },
+        { "share-interval", int64_t(stratum.shareInterval) },
+    };
+    if (stratum.bind)
+        stratumTbl.insert_or_assign("bind", stratum.bind->to_string());
+    tbl.insert_or_assign("stratum", std::move(stratumTbl));
 
     toml::array connect;
     for (auto ea : peers.connect) {
         connect.push_back(ea.to_string());
     }
-    tbl.insert_or_assign("node", toml::table { { "bind", node.bind.to_string() }, { "connect", connect }, { "enable-ban", peers.enableBan }, { "allow-localhost-ip", peers.allowLocalhostIp }, { "log-communication", (bool)node.logCommunication } });
+    toml::table nodeTbl { { "bind", node.bind.to_string() }, { "connect", connect }, { "io-threads", int64_t(node.ioThreads) }, { "block-push-peers", int64_t(node.blockPushPeers) }, { "upload-limit-inbound", int64_t(node.uploadLimitInbound) }, { "upload-limit-outbound", int64_t(node.uploadLimitOutbound) }, { "enable-ban", peers.enableBan }, { "allow-localhost-ip", peers.allowLocalhostIp }, { "log-communication", (bool)node.logCommunication } };
+    if (node.follow)
+        nodeTbl.insert_or_assign("follow", node.follow->to_string());
+    tbl.insert_or_assign("node", std::move(nodeTbl));
     tbl.insert_or_assign("db", toml::table {
                                    { "chain-db", data.chaindb },
                                    { "peers-db", data.peersdb },
+                                   { "chain-db-profile", to_string(data.chaindbProfile) },
+                                   { "prune-depth", int64_t(data.pruneDepth) },
+                                   { "prune-history", data.pruneHistory },
+                                   { "archive-blocks", data.archiveBlocks },
+                                   { "verify", data.verify },
                                });
+    tbl.insert_or_assign("memory", toml::table { { "budget", int64_t(memory.budget) } });
+    toml::array capturePeers;
+    for (auto ip : capture.peers)
+        capturePeers.push_back(ip.to_string());
+    tbl.insert_or_assign("capture", toml::table {
+                                        { "file", capture.file },
+                                        { "peers", capturePeers },
+                                        { "replay", capture.replay },
+                                        { "replay-paced", capture.replayPaced },
+                                    });
+    toml::table threadsTbl;
+    const std::pair<const char*, const ThreadSettings*> roles[] {
+        { "chainserver", &threads.chainserver },
+        { "eventloop", &threads.eventloop },
+        { "peerserver", &threads.peerserver },
+        { "http", &threads.http },
+        { "uv", &threads.uv },
+        { "verifier", &threads.verifier },
+    };
+    for (auto& [name, s] : roles) {
+        if (!s->empty())
+            threadsTbl.insert_or_assign(name, dump_thread_settings(*s));
+    }
+    if (!threadsTbl.empty())
+        tbl.insert_or_assign("threads", std::move(threadsTbl));
     stringstream ss;
     ss << tbl;
     return ss.str();
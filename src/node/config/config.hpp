@@ -1,6 +1,7 @@
 #pragma once
 
 #include "block/chain/signed_snapshot.hpp"
+#include "db/sqlite_profile.hpp"
 #include "general/tcp_util.hpp"
 #include <atomic>
 struct gengetopt_args_info;
@@ -8,13 +9,37 @@ struct Config {
     struct Data {
         std::string chaindb;
         std::string peersdb;
+        SQLiteProfile chaindbProfile { SQLiteProfile::Balanced };
+        uint32_t pruneDepth { 0 }; // keep bodies of this many latest blocks, 0 keeps all
+        bool pruneHistory { false }; // also drop history of pruned blocks
+        bool archiveBlocks { false }; // move finalized bodies to segment files
+        bool verify { true }; // background consistency check of the chain db
+        static constexpr uint32_t minPruneDepth { 10000 };
     } data;
     struct JSONRPC {
         EndpointAddress bind;
+        size_t readConnections { 2 }; // read-only db connections for API queries
+        size_t threads { 1 }; // HTTP event loops sharing the port
+        double rateLimit { 50 }; // requests per second and client ip, 0 disables
+        size_t maxInflight { 256 }; // chainserver bound requests per endpoint class
     } jsonrpc;
+    struct Stratum {
+        std::optional<EndpointAddress> bind; // pool server is disabled if unset
+        double difficulty { 1e6 }; // initial share difficulty of connections
+        uint32_t shareInterval { 10 }; // vardiff target seconds per share, 0 disables vardiff
+    } stratum;
     struct Node {
         std::optional<SnapshotSigner> snapshotSigner;
         EndpointAddress bind;
+        size_t ioThreads { 1 }; // libuv loops handling peer connections
+        size_t blockPushPeers { 0 }; // fastest peers our mined blocks are pushed to, 0 disables
+        // upload limits in kB/s of inbound and outbound peers, sync replies
+        // wait for relay traffic and the limit, 0 disables
+        size_t uploadLimitInbound { 0 };
+        size_t uploadLimitOutbound { 0 };
+        // follower mode: the only peer, its blocks are applied without
+        // signature verification
+        std::optional<EndpointAddress> follow;
         std::atomic<bool> logCommunication { false };
     } node;
     struct Peers {
@@ -22,6 +47,31 @@ struct Config {
         std::vector<EndpointAddress> connect;
         bool enableBan { false };
     } peers;
+    struct Memory {
+        size_t budget { 0 }; // MiB shared by the caches and the mempool, 0 keeps their own caps
+    } memory;
+    // inbound p2p messages of selected peers are recorded to a file which
+    // can be replayed into the eventloop without sockets for benchmarking
+    struct Capture {
+        std::string file; // no recording if empty
+        std::vector<IPv4> peers; // all peers if empty
+        std::string replay; // recording replayed at startup
+        bool replayPaced { false }; // keep recorded timing instead of full speed
+    } capture;
+    // cpu affinity and scheduling priority of the long-running threads
+    struct ThreadSettings {
+        std::vector<uint32_t> cores; // not pinned if empty
+        std::optional<int> nice; // -20 (highest priority) to 19
+        bool empty() const { return cores.empty() && !nice; }
+    };
+    struct Threads {
+        ThreadSettings chainserver;
+        ThreadSettings eventloop;
+        ThreadSettings peerserver;
+        ThreadSettings http;
+        ThreadSettings uv; // libuv loops of the peer connections
+        ThreadSettings verifier { {}, 19 }; // background consistency check
+    } threads;
     bool localDebug { false };
 
     std::string dump();
@@ -0,0 +1,169 @@
+#include "block_archive.hpp"
+#include "general/reader.hpp"
+#include "general/writer.hpp"
+#include <array>
+#include <cassert>
+#include <filesystem>
+#include <spdlog/spdlog.h>
+#ifdef WARTHOG_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+constexpr std::array<uint8_t, 8> magic { 'W', 'A', 'R', 'T', 'S', 'E', 'G', '1' };
+constexpr size_t headerSize { 8 + 4 + 4 + 1 };
+constexpr size_t entrySize { 8 + 4 + 4 };
+constexpr size_t maxOpenSegments { 8 };
+
+enum Compression : uint8_t {
+    NONE = 0,
+    ZSTD = 1
+};
+
+std::vector<uint8_t> compress(const std::vector<uint8_t>& in, uint8_t& compression)
+{
+#ifdef WARTHOG_ZSTD
+    std::vector<uint8_t> out(ZSTD_compressBound(in.size()));
+    auto n { ZSTD_compress(out.data(), out.size(), in.data(), in.size(), 19) };
+    if (ZSTD_isError(n))
+        throw std::runtime_error(std::string("Cannot compress block body: ") + ZSTD_getErrorName(n));
+    out.resize(n);
+    compression = ZSTD;
+    return out;
+#else
+    compression = NONE;
+    return in;
+#endif
+}
+
+std::optional<std::vector<uint8_t>> decompress(std::vector<uint8_t>&& in, uint8_t compression, size_t length)
+{
+    if (compression == NONE)
+        return std::move(in);
+#ifdef WARTHOG_ZSTD
+    if (compression == ZSTD) {
+        std::vector<uint8_t> out(length);
+        auto n { ZSTD_decompress(out.data(), out.size(), in.data(), in.size()) };
+        if (ZSTD_isError(n) || n != length)
+            return {};
+        return out;
+    }
+#else
+    (void)length;
+#endif
+    spdlog::error("Block archive segment uses unsupported compression {}", compression);
+    return {};
+}
+}
+
+BlockArchive::BlockArchive(const std::string& dbpath)
+    : dir(dbpath + ".archive")
+{
+}
+
+std::string BlockArchive::segment_path(size_t index) const
+{
+    return dir + "/" + std::to_string(index) + ".seg";
+}
+
+void BlockArchive::write_segment(size_t index, const std::vector<std::vector<uint8_t>>& bodies)
+{
+    assert(bodies.size() == SEGMENTSIZE);
+    segments.erase(index);
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+
+    uint8_t compression { NONE };
+    std::vector<std::vector<uint8_t>> stored;
+    stored.reserve(bodies.size());
+    for (auto& b : bodies)
+        stored.push_back(compress(b, compression));
+
+    std::vector<uint8_t> head(headerSize + bodies.size() * entrySize);
+    Writer w(head);
+    w << magic << segment_begin(index).value() << uint32_t(bodies.size()) << compression;
+    uint64_t offset { head.size() };
+    for (size_t i = 0; i < bodies.size(); ++i) {
+        w << offset << uint32_t(stored[i].size()) << uint32_t(bodies[i].size());
+        offset += stored[i].size();
+    }
+
+    // write to temporary file first such that segments are never partial
+    const auto path { segment_path(index) };
+    const auto tmp { path + ".tmp" };
+    {
+        std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+        f.write(reinterpret_cast<const char*>(head.data()), head.size());
+        for (auto& s : stored)
+            f.write(reinterpret_cast<const char*>(s.data()), s.size());
+        f.flush();
+        if (!f.good())
+            throw std::runtime_error("Cannot write block archive segment " + tmp);
+    }
+    std::filesystem::rename(tmp, path, ec);
+    if (ec)
+        throw std::runtime_error("Cannot write block archive segment " + path + ": " + ec.message());
+}
+
+auto BlockArchive::open_segment(size_t index) const -> Segment*
+{
+    if (auto iter { segments.find(index) }; iter != segments.end())
+        return &iter->second;
+    std::ifstream f(segment_path(index), std::ios::binary);
+    if (!f)
+        return nullptr;
+    std::array<uint8_t, headerSize> h;
+    if (!f.read(reinterpret_cast<char*>(h.data()), h.size()))
+        return nullptr;
+    Reader r(h);
+    if (std::array<uint8_t, 8>(r) != magic || r.uint32() != segment_begin(index).value())
+        return nullptr;
+    const uint32_t count { r.uint32() };
+    const uint8_t compression { r.uint8() };
+    if (count != SEGMENTSIZE)
+        return nullptr;
+    std::vector<uint8_t> bytes(count * entrySize);
+    if (!f.read(reinterpret_cast<char*>(bytes.data()), bytes.size()))
+        return nullptr;
+    Reader ri(bytes);
+    std::vector<Entry> entries;
+    entries.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        const uint64_t offset { ri.uint64() };
+        const uint32_t stored { ri.uint32() };
+        entries.push_back({ offset, stored, ri.uint32() });
+    }
+    if (segments.size() >= maxOpenSegments)
+        segments.erase(segments.begin());
+    auto& s { segments[index] };
+    s = { std::move(f), compression, std::move(entries) };
+    return &s;
+}
+
+std::optional<std::vector<uint8_t>> BlockArchive::get(NonzeroHeight height) const
+{
+    const size_t index { segment_index(height) };
+    auto s { open_segment(index) };
+    if (!s) {
+        spdlog::error("Block archive segment {} is missing or corrupted", segment_path(index));
+        return {};
+    }
+    auto& e { s->index[height.value() - segment_begin(index).value()] };
+    std::vector<uint8_t> stored(e.storedLength);
+    s->f.clear();
+    s->f.seekg(e.offset);
+    if (!s->f.read(reinterpret_cast<char*>(stored.data()), stored.size())) {
+        segments.erase(index);
+        return {};
+    }
+    return decompress(std::move(stored), s->compression, e.length);
+}
+
+std::optional<size_t> BlockArchive::length(NonzeroHeight height) const
+{
+    const size_t index { segment_index(height) };
+    auto s { open_segment(index) };
+    if (!s)
+        return {};
+    return s->index[height.value() - segment_begin(index).value()].length;
+}
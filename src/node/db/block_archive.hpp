@@ -0,0 +1,50 @@
+#pragma once
+#include "block/chain/height.hpp"
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Immutable segment files holding the bodies of finalized consensus blocks
+// which archive nodes move out of the Blocks table. Segment i holds the
+// heights [i*SEGMENTSIZE+1, (i+1)*SEGMENTSIZE] and is stored as
+// "<db>.archive/<i>.seg":
+//
+//   "WARTSEG1", uint32 first height, uint32 count, uint8 compression
+//   count times (uint64 offset, uint32 stored length, uint32 length)
+//   stored bodies in height order
+//
+// Bodies are compressed individually (zstd if the node was built with it)
+// such that a lookup only reads and decompresses one body.
+class BlockArchive {
+public:
+    static constexpr uint32_t SEGMENTSIZE { 4096 };
+    BlockArchive(const std::string& dbpath);
+
+    static size_t segment_index(NonzeroHeight h) { return (h.value() - 1) / SEGMENTSIZE; }
+    static NonzeroHeight segment_begin(size_t i) { return NonzeroHeight(uint32_t(i * SEGMENTSIZE + 1)); }
+
+    // bodies of a full segment in height order, replaces an existing file
+    void write_segment(size_t index, const std::vector<std::vector<uint8_t>>& bodies);
+    [[nodiscard]] std::optional<std::vector<uint8_t>> get(NonzeroHeight) const;
+    [[nodiscard]] std::optional<size_t> length(NonzeroHeight) const; // uncompressed
+
+private:
+    struct Entry {
+        uint64_t offset;
+        uint32_t storedLength;
+        uint32_t length;
+    };
+    struct Segment {
+        std::ifstream f;
+        uint8_t compression;
+        std::vector<Entry> index;
+    };
+    std::string segment_path(size_t index) const;
+    Segment* open_segment(size_t index) const;
+
+    std::string dir;
+    mutable std::map<size_t, Segment> segments; // open segments
+};
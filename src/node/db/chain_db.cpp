@@ -8,7 +8,11 @@
 #include "general/now.hpp"
 #include "sqlite3.h"
 #include <array>
+#include <filesystem>
 #include <spdlog/spdlog.h>
+#ifdef WARTHOG_ZSTD
+#include <zstd.h>
+#endif
 
 ChainDB::Cache ChainDB::Cache::init(SQLite::Database& db)
 {
@@ -19,34 +23,112 @@ ChainDB::Cache ChainDB::Cache::init(SQLite::Database& db)
                       .getInt64();
     if (hid < 0)
         throw std::runtime_error("Database corrupted, negative history id.");
+    auto property = [&](int64_t id) {
+        int64_t v = db.execAndGet("SELECT coalesce(max(block_id),0) FROM `Consensus` WHERE `height`="
+                                  + std::to_string(id))
+                        .getInt64();
+        if (v < 0)
+            throw std::runtime_error("Database corrupted, negative consensus property.");
+        return Height(uint32_t(v));
+    };
     return {
         .maxStateId { maxStateId },
         .nextHistoryId = HistoryId{uint64_t(hid)},
-        .deletionKey { 2 }
+        .deletionKey { 2 },
+        .prunedHeight = property(PRUNEDID),
+        .archivedHeight = property(ARCHIVEDID)
     };
 }
 
+namespace {
+enum UndoCompression : int64_t {
+    NONE = 0,
+    ZSTD = 1
+};
+
+// compressed only if it saves space
+std::vector<uint8_t> compress_undo(const std::vector<uint8_t>& undo, int64_t& compression)
+{
+    compression = NONE;
+#ifdef WARTHOG_ZSTD
+    std::vector<uint8_t> out(ZSTD_compressBound(undo.size()));
+    auto n { ZSTD_compress(out.data(), out.size(), undo.data(), undo.size(), 3) };
+    if (!ZSTD_isError(n) && n < undo.size()) {
+        out.resize(n);
+        compression = ZSTD;
+        return out;
+    }
+#endif
+    return undo;
+}
+
+std::vector<uint8_t> decompress_undo(std::span<const uint8_t> stored, int64_t compression, int64_t length)
+{
+    if (compression == NONE)
+        return { stored.begin(), stored.end() };
+#ifdef WARTHOG_ZSTD
+    if (compression == ZSTD) {
+        std::vector<uint8_t> out(length);
+        auto n { ZSTD_decompress(out.data(), out.size(), stored.data(), stored.size()) };
+        if (!ZSTD_isError(n) && int64_t(n) == length)
+            return out;
+    }
+#else
+    (void)length;
+#endif
+    throw std::runtime_error("Cannot load undo data (compression " + std::to_string(compression) + ")");
+}
+
+std::string multi_row_insert(std::string_view prefix, std::string_view row, size_t n)
+{
+    std::string s { prefix };
+    for (size_t i = 0; i < n; ++i) {
+        if (i > 0)
+            s += ',';
+        s += row;
+    }
+    return s;
+}
+}
+
 ChainDBTransaction ChainDB::transaction()
 {
     return ChainDBTransaction(*this);
 }
-ChainDB::ChainDB(const std::string& path)
+ChainDB::ChainDB(const std::string& path, SQLiteProfile profile)
     : db(path, SQLite::OPEN_READWRITE | SQLite::OPEN_CREATE)
     , fl(path)
+    , activeProfile(profile)
     , createTables(db)
     , cache(Cache::init(db))
+    , headerStore(path)
+    , archive(path)
     , stmtBlockInsert(db, "INSERT INTO \"Blocks\" ( `height`, `header`, `body` "
                           ", `hash`) VALUES (?,?,?,?)")
-    , stmtUndoSet(db, "UPDATE \"Blocks\" SET `undo`=? WHERE `ROWID`=?")
+    , stmtBlockInsertPruned(db, "INSERT INTO \"Blocks\" ( `height`, `header`, `body` "
+                                ", `hash`) VALUES (?,?,x'',?)")
+    , stmtUndoSet(db, "INSERT OR REPLACE INTO `Undo` (`block_id`,`compression`,`length`,`undo`) VALUES (?,?,?,?)")
     , stmtBlockGetUndo(
-          db, "SELECT `header`,`body`, `undo` FROM \"Blocks\" WHERE `ROWID`=?")
+          db, "SELECT b.header, b.body, u.compression, u.length, u.undo FROM `Blocks` b "
+              "LEFT JOIN `Undo` u ON u.block_id=b.ROWID WHERE b.ROWID=?")
+    , stmtConsensusUndoRange(db, "SELECT c.height, b.body, u.compression, u.length, u.undo FROM `Consensus` c "
+                                 "JOIN `Blocks` b ON b.ROWID=c.block_id LEFT JOIN `Undo` u ON u.block_id=c.block_id "
+                                 "WHERE c.height>=? AND c.height<? ORDER BY c.height DESC")
     , stmtBlockById(
           db, "SELECT `height`, `header`, `body` FROM \"Blocks\" WHERE `ROWID`=?;")
     , stmtBlockByHash(
           db, "SELECT ROWID, `height`, `header`, `body` FROM \"Blocks\" WHERE `hash`=?;")
+    , stmtBlockBodySize(
+          db, "SELECT `height`, length(`body`) FROM \"Blocks\" WHERE `hash`=?;")
+    , stmtBlockBody(
+          db, "SELECT `height`, `body` FROM \"Blocks\" WHERE `hash`=?;")
     , stmtConsensusHeaders(db, "SELECT c.height, c.history_cursor, c.account_cursor, b.header "
                                "FROM `Blocks` b JOIN `Consensus` c ON "
                                "b.ROWID=c.block_id ORDER BY c.height ASC;")
+    , stmtConsensusCursors(db, "SELECT `height`, `history_cursor`, `account_cursor` "
+                               "FROM `Consensus` WHERE `height`>0 ORDER BY `height` ASC;")
+    , stmtConsensusHeader(db, "SELECT b.header FROM `Blocks` b JOIN `Consensus` c ON "
+                              "b.ROWID=c.block_id WHERE c.height=?;")
     , stmtConsensusInsert(db, "INSERT INTO \"Consensus\" ( `height`, "
                               "`block_id`, `history_cursor`, `account_cursor`) VALUES (?,?,?,?)")
     , stmtConsensusSetProperty(
@@ -62,6 +144,15 @@ ChainDB::ChainDB(const std::string& path)
           db, "SELECT `height`, `block_id` FROM \"Consensus\" ORDER BY "
               "`height` DESC LIMIT 1;")
     , stmtConsensusDeleteFrom(db, "DELETE FROM `Consensus` WHERE `height`>=?")
+    // the supply changes by the payouts minus the fees taken from senders
+    , stmtBlockStatsInsert(db, "INSERT OR REPLACE INTO `BlockStats` (`height`,`timestamp`,`transfers`,"
+                               "`volume`,`fees`,`rewards`,`new_accounts`,`supply`,`accounts`,`transactions`) "
+                               "SELECT ?1,?2,?3,?4,?5,?6,?7,coalesce((SELECT `supply` FROM `BlockStats` "
+                               "WHERE `height`=?1-1),(SELECT coalesce(sum(`balance`),0) FROM `State`))+?6-?5,?8,?9")
+    , stmtBlockStatsDeleteFrom(db, "DELETE FROM `BlockStats` WHERE `height`>=?")
+    , stmtStateCommitmentInsert(db, "INSERT OR REPLACE INTO `StateCommitment` (`height`,`commitment`) VALUES (?,?)")
+    , stmtStateCommitmentGet(db, "SELECT `commitment` FROM `StateCommitment` WHERE `height`=?")
+    , stmtStateCommitmentDeleteFrom(db, "DELETE FROM `StateCommitment` WHERE `height`>=?")
 
     , stmtScheduleExists(db, "SELECT EXISTS(SELECT 1 FROM `Deleteschedule` WHERE `block_id`=?)")
     , stmtScheduleInsert(db, "INSERT INTO `Deleteschedule` (`block_id`,`deletion_key`) VALUES (?,?)")
@@ -72,8 +163,15 @@ ChainDB::ChainDB(const std::string& path)
 
     , stmtDeleteGCBlocks(
           db, "DELETE FROM `Blocks` WHERE ROWID IN (SELECT `block_id`  FROM "
-              "`Deleteschedule` WHERE `deletion_key`<=? AND `deletion_key` > 0 )")
-    , stmtDeleteGCRefs(db, "DELETE  FROM `Deleteschedule` WHERE `deletion_key`<=? AND `deletion_key` > 0")
+              "`Deleteschedule` WHERE `deletion_key`<=? AND `deletion_key` > 0 "
+              "ORDER BY `block_id` LIMIT ?)")
+    , stmtDeleteGCRefs(db, "DELETE FROM `Deleteschedule` WHERE `block_id` IN (SELECT `block_id` FROM "
+                           "`Deleteschedule` WHERE `deletion_key`<=? AND `deletion_key` > 0 "
+                           "ORDER BY `block_id` LIMIT ?)")
+    , stmtBlockPrune(db, "UPDATE `Blocks` SET `body`=x'' WHERE ROWID IN "
+                         "(SELECT `block_id` FROM `Consensus` WHERE `height`>? AND `height`<=?)")
+    , stmtUndoPrune(db, "DELETE FROM `Undo` WHERE `block_id` IN "
+                        "(SELECT `block_id` FROM `Consensus` WHERE `height`>? AND `height`<=?)")
 
     , stmtStateInsert(db, "INSERT INTO \"State\" ( `ROWID`, `address`, "
                           "`balance`) VALUES (?,?,?)")
@@ -85,6 +183,7 @@ ChainDB::ChainDB(const std::string& path)
     , stmtBadblockGet(db, "SELECT `height`, `header` FROM `Badblocks`")
     , stmtAccountLookup(
           db, "SELECT `Address`, `Balance` FROM `State` WHERE ROWID=?")
+    , stmtAccountLookupMulti(db, multi_row_insert("SELECT ROWID, `Address`, `Balance` FROM `State` WHERE ROWID IN (", "?", accountLookupRows) + ")")
     , stmtRichlistLookup(
           db, "SELECT Address, Balance FROM `State` ORDER BY `Balance` DESC LIMIT ?")
     , stmtHistoryInsert(db, "INSERT INTO `History` (`id`,`hash`, `data`"
@@ -96,28 +195,133 @@ ChainDB::ChainDB(const std::string& path)
           "SELECT `hash`, `data` FROM `History` WHERE `id`>=? AND`id`<?")
     , stmtAccountHistoryInsert(db, "INSERT INTO `AccountHistory` "
                                    "(`account_id`,`history_id`) VALUES (?,?)")
+    , stmtHistoryInsertMulti(db, multi_row_insert("INSERT INTO `History` (`id`,`hash`, `data`) VALUES ", "(?,?,?)", historyInsertRows))
+    , stmtAccountHistoryInsertMulti(db, multi_row_insert("INSERT INTO `AccountHistory` (`account_id`,`history_id`) VALUES ", "(?,?)", accountHistoryInsertRows))
     , stmtAccountHistoryDeleteFrom(
           db, "DELETE FROM `AccountHistory` WHERE `history_id`>=?")
+    , stmtHistoryDeleteBelow(db, "DELETE FROM `History` WHERE `id`<?")
+    , stmtAccountHistoryDeleteBelow(
+          db, "DELETE FROM `AccountHistory` WHERE `history_id`<?")
     , stmtBlockIdSelect(
           db, "SELECT `ROWID` FROM `Blocks` WHERE `hash`=?")
-    , stmtBlockHeightSelect(
-          db, "SELECT `height` FROM `Blocks` WHERE `hash`=?")
     , stmtBlockDelete(db, "DELETE FROM `Blocks` WHERE ROWID = ?")
 
     // BELOW STATEMENTS REQUIRED FOR INDEXING NODES
     //
     , stmtAddressLookup(
           db, "SELECT `ROWID`,`balance` FROM `State` WHERE `address`=?")
-    , stmtHistoryById(db, "SELECT h.id, `hash`,`data` FROM `History` `h` JOIN "
-                          "`AccountHistory` `ah` ON h.id=`ah`.history_id WHERE "
-                          "ah.`account_id`=? AND h.id<? ORDER BY h.id DESC LIMIT 100")
-{
+    , stmtAddressLookupMulti(db, multi_row_insert("SELECT ROWID, `address`, `balance` FROM `State` WHERE `address` IN (", "?", addressLookupRows) + ")")
+    // constrain and order by the AccountHistory primary key such that
+    // the scan runs on its (account_id, history_id) index
+    , stmtHistoryById(db, "SELECT ah.history_id, `hash`,`data` FROM `AccountHistory` `ah` "
+                          "JOIN `History` `h` ON h.id=`ah`.history_id WHERE "
+                          "ah.`account_id`=? AND ah.history_id<? ORDER BY ah.history_id DESC LIMIT ?")
+    , stmtHistoryCount(db, "SELECT COUNT(*) FROM (SELECT 1 FROM `AccountHistory` "
+                           "WHERE `account_id`=? LIMIT ?)")
+
+    , stmtStateExport(db, "SELECT ROWID, `address`, `balance` FROM `State` WHERE ROWID<? ORDER BY ROWID ASC")
+    , stmtHistoryExport(db, "SELECT `id`, `hash`, `data` FROM `History` WHERE `id`>=? AND `id`<? ORDER BY `id` ASC")
+    , stmtAccountHistoryExport(db, "SELECT `account_id`, `history_id` FROM `AccountHistory` WHERE `history_id`>=? AND `history_id`<?")
+{
+    set_profile(profile);
+    set_lookup_indices(true);
+    incrementalVacuum = db.execAndGet("PRAGMA auto_vacuum").getInt() == 2;
 
     //
     // Do DELETESCHEDULE cleanup
     db.exec("UPDATE `Deleteschedule` SET `deletion_key`=1");
 }
 
+void ChainDB::set_profile(SQLiteProfile profile)
+{
+    db.exec("PRAGMA journal_mode = WAL");
+    db.exec("PRAGMA temp_store = MEMORY");
+    // checkpoints are scheduled in idle time by the chainserver, the
+    // automatic checkpoint on commit is only a backstop
+    db.exec("PRAGMA wal_autocheckpoint = 16384");
+    switch (profile) {
+    case SQLiteProfile::Sync:
+        db.exec("PRAGMA synchronous = OFF");
+        db.exec("PRAGMA cache_size = -262144"); // 256 MiB
+        db.exec("PRAGMA mmap_size = 1073741824"); // 1 GiB
+        break;
+    case SQLiteProfile::Balanced:
+        db.exec("PRAGMA synchronous = NORMAL");
+        db.exec("PRAGMA cache_size = -65536"); // 64 MiB
+        db.exec("PRAGMA mmap_size = 268435456"); // 256 MiB
+        break;
+    case SQLiteProfile::Durable:
+        db.exec("PRAGMA synchronous = FULL");
+        db.exec("PRAGMA cache_size = -65536"); // 64 MiB
+        db.exec("PRAGMA mmap_size = 0");
+        break;
+    }
+    activeProfile = profile;
+}
+
+void ChainDB::set_lookup_indices(bool enabled)
+{
+    if (!enabled) {
+        db.exec("DROP INDEX IF EXISTS `account_history_index`");
+        db.exec("DROP INDEX IF EXISTS `history_hash_index`");
+        db.exec("DROP INDEX IF EXISTS `state_address_index`");
+        return;
+    }
+    const int64_t n { db.execAndGet("SELECT count(*) FROM sqlite_master WHERE type='index' AND "
+                                    "name IN ('account_history_index','history_hash_index','state_address_index')")
+                          .getInt64() };
+    if (n == 3)
+        return;
+    spdlog::info("Building lookup indices, this may take a while");
+    db.exec("CREATE INDEX IF NOT EXISTS `account_history_index` ON "
+            "`AccountHistory` (`history_id` ASC)");
+    // transaction lookup by hash, maintained by history inserts and
+    // deletions (rollback, pruning)
+    db.exec("CREATE INDEX IF NOT EXISTS `history_hash_index` ON "
+            "`History` (`hash`)");
+    // covers balance lookups by address such that they do not touch the
+    // State table itself (ROWID is part of every index)
+    db.exec("CREATE INDEX IF NOT EXISTS `state_address_index` ON "
+            "`State` (`address`, `balance`)");
+}
+
+void ChainDB::CreateTables::migrate(SQLite::Database& db)
+{
+    const int64_t version { db.execAndGet("PRAGMA user_version").getInt64() };
+    if (version >= schemaVersion)
+        return;
+    SQLite::Transaction t(db);
+    if (version < 1) {
+        // databases of early versions may hold AccountHistory as a ROWID
+        // table with a separate primary key index
+        const std::string sql { db.execAndGet("SELECT sql FROM sqlite_master WHERE "
+                                              "type='table' AND name='AccountHistory'")
+                                    .getString() };
+        if (sql.find("WITHOUT ROWID") == std::string::npos) {
+            spdlog::info("Migrating AccountHistory to a clustered table, this may take a while");
+            db.exec("CREATE TABLE `AccountHistory_new` (`account_id` INTEGER, `history_id` INTEGER, "
+                    "PRIMARY KEY(`account_id`,`history_id`)) WITHOUT ROWID");
+            db.exec("INSERT INTO `AccountHistory_new` SELECT `account_id`, `history_id` FROM "
+                    "`AccountHistory` ORDER BY `account_id`, `history_id`");
+            db.exec("DROP TABLE `AccountHistory`"); // drops its indices
+            db.exec("ALTER TABLE `AccountHistory_new` RENAME TO `AccountHistory`");
+        }
+    }
+    if (version < 2) {
+        const int64_t hasUndo { db.execAndGet("SELECT count(*) FROM pragma_table_info('Blocks') "
+                                              "WHERE name='undo'")
+                                    .getInt64() };
+        if (hasUndo) {
+            spdlog::info("Moving undo data to a separate table, this may take a while");
+            db.exec("INSERT OR REPLACE INTO `Undo` (`block_id`,`compression`,`length`,`undo`) "
+                    "SELECT ROWID, 0, length(`undo`), `undo` FROM `Blocks` WHERE `undo` IS NOT NULL");
+            db.exec("UPDATE `Blocks` SET `undo`=NULL WHERE `undo` IS NOT NULL"); // column stays unused
+        }
+    }
+    db.exec("PRAGMA user_version = " + std::to_string(schemaVersion));
+    t.commit();
+}
+
 void ChainDB::insertStateEntry(const AddressView address, Funds balance,
     AccountId verifyNextStateId)
 {
@@ -125,6 +329,7 @@ void ChainDB::insertStateEntry(const AddressView address, Funds balance,
         throw std::runtime_error("Internal error, state id inconsistent.");
     stmtStateInsert.run(cache.maxStateId + 1, address, balance);
     cache.maxStateId++;
+    accountCache.insert(cache.maxStateId, { address, balance });
 }
 
 void ChainDB::delete_state_from(AccountId fromAccountId)
@@ -135,6 +340,7 @@ void ChainDB::delete_state_from(AccountId fromAccountId)
     } else {
         cache.maxStateId = fromAccountId - 1;
         stmtStateDeleteFrom.run(fromAccountId);
+        accountCache.erase_from(fromAccountId);
     }
 }
 
@@ -186,10 +392,90 @@ std::vector<BlockId> ChainDB::consensus_block_ids(Height begin,
     return out;
 }
 
-void ChainDB::garbage_collect_blocks(DeletionKey dk)
+bool ChainDB::garbage_collect_blocks(DeletionKey dk, size_t maxBlocks)
 {
-    stmtDeleteGCBlocks.run(dk.value());
-    stmtDeleteGCRefs.run(dk.value());
+    // same order and limit such that both delete the same schedule rows
+    stmtDeleteGCBlocks.run(dk.value(), int64_t(maxBlocks));
+    return stmtDeleteGCRefs.run(dk.value(), int64_t(maxBlocks)) < maxBlocks;
+}
+
+auto ChainDB::space_stats() -> SpaceStats
+{
+    std::error_code ec;
+    const auto walBytes { std::filesystem::file_size(path() + "-wal", ec) };
+    return {
+        .pageSize { db.execAndGet("PRAGMA page_size").getInt64() },
+        .pages { db.execAndGet("PRAGMA page_count").getInt64() },
+        .freePages { db.execAndGet("PRAGMA freelist_count").getInt64() },
+        .walBytes { ec ? 0 : uint64_t(walBytes) },
+    };
+}
+
+void ChainDB::incremental_vacuum(int64_t maxPages)
+{
+    db.exec("PRAGMA incremental_vacuum(" + std::to_string(maxPages) + ")");
+}
+
+bool ChainDB::checkpoint_wal(bool truncate)
+{
+    // result row is (busy, frames in WAL, frames checkpointed)
+    SQLite::Statement s(db, truncate ? "PRAGMA wal_checkpoint(TRUNCATE)" : "PRAGMA wal_checkpoint(PASSIVE)");
+    if (!s.executeStep())
+        return false;
+    return s.getColumn(0).getInt() == 0 && s.getColumn(1).getInt64() == s.getColumn(2).getInt64();
+}
+
+void ChainDB::prune_blocks(Height upper, bool pruneHistory)
+{
+    if (upper <= cache.prunedHeight)
+        return;
+    stmtBlockPrune.run(cache.prunedHeight, upper);
+    stmtUndoPrune.run(cache.prunedHeight, upper);
+    if (pruneHistory) {
+        const int64_t historyCursor = stmtConsensusSelectHistory.one(upper + 1).get<int64_t>(0);
+        stmtHistoryDeleteBelow.run(historyCursor);
+        stmtAccountHistoryDeleteBelow.run(historyCursor);
+    }
+    stmtConsensusSetProperty.run(PRUNEDID, upper);
+    cache.prunedHeight = upper;
+}
+
+bool ChainDB::archive_blocks(Height upper)
+{
+    const size_t index { cache.archivedHeight.value() / BlockArchive::SEGMENTSIZE };
+    const NonzeroHeight begin { BlockArchive::segment_begin(index) };
+    const Height end { begin + BlockArchive::SEGMENTSIZE };
+    if (end.value() > upper.value() + 1 || begin <= cache.prunedHeight)
+        return false;
+    assert(cache.archivedHeight + 1 == begin);
+    std::vector<std::vector<uint8_t>> bodies;
+    bodies.reserve(BlockArchive::SEGMENTSIZE);
+    for (auto id : consensus_block_ids(begin, end)) {
+        auto o { stmtBlockById.one(id) };
+        if (!o.has_value())
+            throw std::runtime_error("Database corrupted (consensus block id " + std::to_string(id.value()) + " not available)");
+        bodies.push_back(o.get_vector(2));
+        if (bodies.back().empty())
+            throw std::runtime_error("Cannot archive blocks, body at height " + std::to_string(o.get<Height>(0).value()) + " is missing");
+    }
+    if (bodies.size() != BlockArchive::SEGMENTSIZE)
+        throw std::runtime_error("Cannot load block ids.");
+    archive.write_segment(index, bodies);
+    const Height last { end - 1 };
+    stmtBlockPrune.run(cache.archivedHeight, last);
+    stmtUndoPrune.run(cache.archivedHeight, last);
+    stmtConsensusSetProperty.run(ARCHIVEDID, last);
+    cache.archivedHeight = last;
+    return true;
+}
+
+void ChainDB::load_archived_body(Block& b) const
+{
+    if (b.body.size() > 0 || b.height > cache.archivedHeight)
+        return;
+    // a consensus block = the only block at this height with empty body
+    if (auto body { archive.get(b.height) })
+        b.body = std::move(*body);
 }
 
 DeletionKey ChainDB::schedule_protected_all()
@@ -230,6 +516,9 @@ DeletionKey ChainDB::delete_consensus_from(NonzeroHeight height)
     auto dk { cache.deletionKey++ };
     stmtScheduleConsensus.run(dk.value(), height);
     stmtConsensusDeleteFrom.run(height);
+    stmtBlockStatsDeleteFrom.run(height);
+    stmtStateCommitmentDeleteFrom.run(height);
+    headerStore.shrink(height - 1);
     return dk;
 }
 
@@ -242,11 +531,13 @@ std::optional<Block> ChainDB::get_block(BlockId id) const
     if (h == 0) {
         throw std::runtime_error("Database corrupted, block has height 0");
     }
-    return Block {
+    Block b {
         .height = h.nonzero_assert(),
         .header = o.get_array<80>(1),
         .body = o.get_vector(2)
     };
+    load_archived_body(b);
+    return b;
 }
 
 std::optional<std::pair<BlockId, Block>> ChainDB::get_block(HashView hash) const
@@ -254,17 +545,49 @@ std::optional<std::pair<BlockId, Block>> ChainDB::get_block(HashView hash) const
     auto o = stmtBlockByHash.one(hash);
     if (!o.has_value())
         return {};
-    Height h { o.get<Height>(0) };
+    Height h { o.get<Height>(1) };
     if (h == 0) {
         throw std::runtime_error("Database corrupted, block has height 0");
     }
-    return std::pair<BlockId, Block> {
+    std::pair<BlockId, Block> res {
         o.get<BlockId>(0),
         Block {
             .height = h.nonzero_assert(),
             .header = o.get_array<80>(2),
             .body = o.get_vector(3) }
     };
+    load_archived_body(res.second);
+    return res;
+}
+
+std::optional<size_t> ChainDB::body_size(HashView hash) const
+{
+    auto o = stmtBlockBodySize.one(hash);
+    if (!o.has_value())
+        return {};
+    Height h { o.get<Height>(0) };
+    size_t n(o.get<int64_t>(1));
+    if (n == 0 && h != 0 && h <= cache.archivedHeight)
+        return archive.length(h.nonzero_assert());
+    return n;
+}
+
+bool ChainDB::visit_body(HashView hash, const std::function<void(std::span<const uint8_t>)>& cb) const
+{
+    auto o = stmtBlockBody.one(hash);
+    if (!o.has_value())
+        return false;
+    Height h { o.get<Height>(0) };
+    auto body { o.get_blob(1) };
+    if (body.size() == 0 && h != 0 && h <= cache.archivedHeight) {
+        auto archived { archive.get(h.nonzero_assert()) };
+        if (!archived)
+            return false;
+        cb(*archived);
+        return true;
+    }
+    cb(body);
+    return true;
 }
 
 std::pair<BlockId, bool> ChainDB::insert_protect(const Block& b)
@@ -292,28 +615,107 @@ ChainDB::get_block_undo(BlockId id) const
     return std::tuple<Header, RawBody, RawUndo> {
         a.get_array<80>(0),
         { a.get_vector(1) },
-        { a.get_vector(2) }
+        { decompress_undo(a.get_blob(4), a.get<int64_t>(2), a.get<int64_t>(3)) }
     };
 }
 
+void ChainDB::visit_consensus_undo(Height begin, Height end,
+    const std::function<void(NonzeroHeight, std::span<const uint8_t>, std::span<const uint8_t>)>& cb) const
+{
+    assert(begin.value() > 0 && end >= begin);
+    int64_t expected { int64_t(end.value()) - 1 };
+    stmtConsensusUndoRange.for_each([&](Statement2::Row& r) {
+        const int64_t h { r.get<int64_t>(0) };
+        if (h != expected)
+            throw std::runtime_error("Database corrupted (consensus block at height " + std::to_string(expected) + " missing)");
+        expected -= 1;
+        const int64_t compression { r.get<int64_t>(2) };
+        if (compression == NONE) {
+            cb(Height(h).nonzero_assert(), r.get_blob(1), r.get_blob(4));
+        } else {
+            auto undo { decompress_undo(r.get_blob(4), compression, r.get<int64_t>(3)) };
+            cb(Height(h).nonzero_assert(), r.get_blob(1), undo);
+        }
+    },
+        begin, end);
+    if (expected + 1 != int64_t(begin.value()))
+        throw std::runtime_error("Database corrupted (consensus block at height " + std::to_string(expected) + " missing)");
+}
+
 void ChainDB::set_block_undo(BlockId id, const std::vector<uint8_t>& undo)
 {
-    stmtUndoSet.run(undo, id);
+    int64_t compression;
+    auto stored { compress_undo(undo, compression) };
+    stmtUndoSet.run(id, compression, int64_t(undo.size()), stored);
 }
 
-void ChainDB::insert_consensus(NonzeroHeight height, BlockId blockId, HistoryId historyCursor, AccountId accountCursor)
+void ChainDB::insert_consensus(NonzeroHeight height, BlockId blockId, HeaderView header, HistoryId historyCursor, AccountId accountCursor)
 {
     stmtConsensusInsert.run(height, blockId, historyCursor, accountCursor);
     stmtScheduleDelete2.run(blockId);
+    headerStore.append(height, header);
 }
 
-std::tuple<std::vector<Batch>, HistoryHeights, AccountHeights> ChainDB::getConsensusHeaders() const
+void ChainDB::insert_block_stats(NonzeroHeight height, const BlockStats& s)
+{
+    stmtBlockStatsInsert.run(height, s.timestamp, s.transfers, s.volume, s.fees, s.rewards,
+        s.newAccounts, s.accounts, s.transactions);
+}
+
+void ChainDB::insert_state_commitment(NonzeroHeight height, const chainserver::StateCommitment& c)
+{
+    stmtStateCommitmentInsert.run(height, c.hash());
+}
+
+std::optional<chainserver::StateCommitment> ChainDB::get_state_commitment(Height height) const
+{
+    if (height == 0)
+        return chainserver::StateCommitment {};
+    auto o { stmtStateCommitmentGet.one(height) };
+    if (!o.has_value())
+        return {};
+    return chainserver::StateCommitment(Hash(o.get_array<32>(0)));
+}
+
+chainserver::StateCommitment ChainDB::compute_state_commitment() const
+{
+    chainserver::StateCommitment c;
+    stmtStateExport.for_each([&](Statement2::Row& r) {
+        const auto address { r.get_array<20>(1) };
+        c.add(r.get<AccountId>(0), AddressView(address.data()), r.get<Funds>(2));
+    },
+        next_state_id());
+    return c;
+}
+
+std::tuple<ConsensusHeaders, HistoryHeights, AccountHeights> ChainDB::getConsensusHeaders() const
 {
-    uint32_t h = 1;
-    std::vector<Batch> batches;
-    ;
     HistoryHeights historyHeights;
     AccountHeights accountHeights;
+    if (auto head { stmtConsensusHead.one() }; head.has_value() && head.get<int64_t>(0) > 0) {
+        Height length { head.get<Height>(0) };
+        Header tip { stmtConsensusHeader.one(length).get_array<80>(0) };
+        if (auto loaded { headerStore.load(length, tip, get_consensus_work()) }) {
+            uint32_t h = 1;
+            stmtConsensusCursors.for_each([&](Statement2::Row& r) {
+                if (h != r.get<Height>(0)) { // corrupted
+                    throw std::runtime_error("Database corrupted, block height not consecutive");
+                }
+                historyHeights.append(r.get<HistoryId>(1));
+                accountHeights.append(r.get<AccountId>(2));
+                h += 1;
+            });
+            if (h != length.value() + 1)
+                throw std::runtime_error("Database corrupted, block height not consecutive");
+            spdlog::debug("Loaded {} headers from header store", length.value());
+            return { std::move(*loaded), std::move(historyHeights), std::move(accountHeights) };
+        }
+        spdlog::info("Rebuilding header store");
+    }
+
+    uint32_t h = 1;
+    ConsensusHeaders res;
+    auto& batches { res.batches };
     Batch b;
     stmtConsensusHeaders.for_each([&](Statement2::Row& r) {
         if (h != r.get<Height>(0)) { // corrupted
@@ -333,7 +735,8 @@ std::tuple<std::vector<Batch>, HistoryHeights, AccountHeights> ChainDB::getConse
     if (b.size() > 0) {
         batches.push_back(std::move(b));
     }
-    return { std::move(batches), std::move(historyHeights), std::move(accountHeights) };
+    headerStore.rebuild(res);
+    return { std::move(res), std::move(historyHeights), std::move(accountHeights) };
 }
 
 void ChainDB::insert_bad_block(NonzeroHeight height,
@@ -401,31 +804,94 @@ void ChainDB::insertAccountHistory(AccountId accountId, HistoryId historyId)
     stmtAccountHistoryInsert.run(accountId, historyId);
 }
 
+void ChainDB::insert_history(std::span<const std::pair<HashView, std::span<const uint8_t>>> rows)
+{
+    size_t i { 0 };
+    for (; i + historyInsertRows <= rows.size(); i += historyInsertRows) {
+        for (size_t j = 0; j < historyInsertRows; ++j) {
+            auto& [hash, data] { rows[i + j] };
+            stmtHistoryInsertMulti.bind(3 * j + 1, (int64_t)cache.nextHistoryId.value());
+            stmtHistoryInsertMulti.bind(3 * j + 2, hash);
+            stmtHistoryInsertMulti.bind(3 * j + 3, data);
+            ++cache.nextHistoryId;
+        }
+        stmtHistoryInsertMulti.run_bound();
+    }
+    for (; i < rows.size(); ++i) {
+        auto& [hash, data] { rows[i] };
+        stmtHistoryInsert.run((int64_t)cache.nextHistoryId.value(), hash, data);
+        ++cache.nextHistoryId;
+    }
+}
+
+void ChainDB::insert_account_history(std::span<const std::pair<AccountId, HistoryId>> rows)
+{
+    stmtAccountHistoryInsertMulti.run_batch(accountHistoryInsertRows, stmtAccountHistoryInsert, rows);
+}
+
 std::optional<std::tuple<AccountId, Funds>> ChainDB::lookup_address(const AddressView address) const
 {
+    if (auto c { accountCache.lookup(address) })
+        return c;
     auto p = stmtAddressLookup.one(address);
     if (!p.has_value())
         return {};
-    return std::tuple<AccountId, Funds> {
+    std::tuple<AccountId, Funds> res {
         p.get<AccountId>(0),
         p.get<Funds>(1)
     };
+    accountCache.insert(std::get<0>(res), { address, std::get<1>(res) });
+    return res;
+}
+
+auto ChainDB::lookup_addresses(std::vector<AddressView> addresses) const -> AddressLookups
+{
+    AddressLookups res;
+    std::sort(addresses.begin(), addresses.end());
+    addresses.erase(std::unique(addresses.begin(), addresses.end()), addresses.end());
+    std::erase_if(addresses, [&](AddressView a) {
+        if (auto c { accountCache.lookup(a) }) {
+            res.emplace(a, *c);
+            return true;
+        }
+        return false;
+    });
+    stmtAddressLookupMulti.for_each_in(addressLookupRows, addresses, [&](Statement2::Row& r) {
+        AccountId id { uint64_t(r.get<int64_t>(0)) };
+        AddressFunds af {
+            .address = r.get_array<20>(1),
+            .funds = r.get<Funds>(2)
+        };
+        accountCache.insert(id, af);
+        res.emplace(af.address, std::tuple { id, af.funds });
+    });
+    return res;
 }
 
-std::vector<std::tuple<HistoryId, Hash, std::vector<uint8_t>>> ChainDB::lookup_history_100_desc(
-    AccountId accountId, int64_t beforeId)
+HistoryPage ChainDB::lookup_history_desc(
+    AccountId accountId, int64_t beforeId, uint32_t limit)
 {
-    std::vector<std::tuple<HistoryId, Hash, std::vector<uint8_t>>> out;
+    HistoryPage out;
+    // one extra row tells whether more entries exist, its data is not read
     stmtHistoryById.for_each(
         [&](Statement2::Row& row) {
-            out.push_back({ HistoryId{row.get<uint64_t>(0)},
+            if (out.entries_desc.size() == limit) {
+                out.more = true;
+                return;
+            }
+            out.entries_desc.push_back({ HistoryId { row.get<uint64_t>(0) },
                 row.get_array<32>(1),
                 row.get_vector(2) });
         },
-        accountId, beforeId);
+        accountId, beforeId, int64_t(limit) + 1);
     return out;
 }
 
+size_t ChainDB::count_history(AccountId accountId, size_t cap)
+{
+    return stmtHistoryCount.one(accountId, int64_t(cap)).get<int64_t>(0);
+}
+
 AddressFunds ChainDB::fetch_account(AccountId id) const
 {
     auto p = lookup_account(id);
@@ -437,13 +903,41 @@ AddressFunds ChainDB::fetch_account(AccountId id) const
 
 std::optional<AddressFunds> ChainDB::lookup_account(AccountId id) const
 {
+    if (auto c { accountCache.lookup(id) })
+        return c;
     auto o { stmtAccountLookup.one(id) };
     if (!o.has_value())
         return {};
-    return AddressFunds {
+    AddressFunds res {
         .address = o.get_array<20>(0),
         .funds = o.get<Funds>(1)
     };
+    accountCache.insert(id, res);
+    return res;
+}
+
+std::map<AccountId, AddressFunds> ChainDB::lookup_accounts(std::vector<AccountId> ids) const
+{
+    std::map<AccountId, AddressFunds> res;
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    std::erase_if(ids, [&](AccountId id) {
+        if (auto c { accountCache.lookup(id) }) {
+            res.emplace(id, *c);
+            return true;
+        }
+        return false;
+    });
+    stmtAccountLookupMulti.for_each_in(accountLookupRows, ids, [&](Statement2::Row& r) {
+        AccountId id { uint64_t(r.get<int64_t>(0)) };
+        AddressFunds af {
+            .address = r.get_array<20>(1),
+            .funds = r.get<Funds>(2)
+        };
+        accountCache.insert(id, af);
+        res.emplace(id, af);
+    });
+    return res;
 }
 
 API::Richlist ChainDB::lookup_richlist(uint32_t N) const
@@ -463,18 +957,6 @@ std::optional<BlockId> ChainDB::lookup_block_id(const HashView hash) const
     return stmtBlockIdSelect.one(hash);
 }
 
-std::optional<NonzeroHeight> ChainDB::lookup_block_height(const HashView hash) const
-{
-    auto o { stmtBlockHeightSelect.one(hash) };
-    if (!o.has_value())
-        return {};
-    auto h{o.get<Height>(0)};
-    if (h == 0) {
-        throw std::runtime_error("Database corrupted, block " +serialize_hex(hash) + " has invalid height 0.");
-    }
-    return h.nonzero_assert();
-}
-
 void ChainDB::delete_bad_block(HashView blockhash)
 {
     auto o = stmtBlockIdSelect.one(blockhash);
@@ -510,7 +992,7 @@ std::vector<TransactionId> read_tx_ids(const BodyContainer& body,
 chainserver::TransactionIds ChainDB::fetch_tx_ids(Height height) const
 {
     const auto [lower, upper] = chainserver::TransactionIds::block_range(height);
-    chainserver::TransactionIds out;
+    std::vector<TransactionId> tids;
     spdlog::debug("Loading nonces from blocks {} to {} into cache...", lower.value(), upper.value());
     auto ids { consensus_block_ids(lower, upper) };
     if (ids.size() != upper - lower)
@@ -524,12 +1006,12 @@ chainserver::TransactionIds ChainDB::fetch_tx_ids(Height height) const
         }
         assert(height == b->height);
         assert(b->body.size() > 0);
-        for (auto& tid : read_tx_ids(b->body, b->height)) {
-            if (out.emplace(tid).second == false) {
-                throw std::runtime_error(
-                    "Database corrupted (duplicate transaction id in chain)");
-            };
-        }
+        auto blockIds { read_tx_ids(b->body, b->height) };
+        tids.insert(tids.end(), blockIds.begin(), blockIds.end());
     }
+    chainserver::TransactionIds out;
+    if (!out.assign(std::move(tids)))
+        throw std::runtime_error(
+            "Database corrupted (duplicate transaction id in chain)");
     return out;
 }
@@ -5,10 +5,20 @@
 #include "block/chain/offsts.hpp"
 #include "block/id.hpp"
 #include "chain/deletion_key.hpp"
+#include "db/block_archive.hpp"
+#include "db/header_store.hpp"
+#include "db/sqlite_profile.hpp"
+#include "chainserver/account_cache.hpp"
+#include "chainserver/state_commitment.hpp"
 #include "chainserver/transaction_ids.hpp"
 #include "general/address_funds.hpp"
 #include "general/filelock/filelock.hpp"
+#include "general/metrics.hpp"
 #include "api/types/forward_declarations.hpp"
+#include <algorithm>
+#include <functional>
+#include <span>
+#include <tuple>
 class ChainDBTransaction;
 class Batch;
 struct SignedSnapshot;
@@ -17,6 +27,11 @@ struct RawBody : public std::vector<uint8_t> {
 };
 struct RawUndo : public std::vector<uint8_t> {
 };
+// page of account history entries, newest first
+struct HistoryPage {
+    std::vector<std::tuple<HistoryId, Hash, std::vector<uint8_t>>> entries_desc;
+    bool more { false }; // older entries exist
+};
 
 struct Column2 : public SQLite::Column {
 
@@ -104,6 +119,10 @@ struct Statement2 : public SQLite::Statement {
     {
         SQLite::Statement::bind(index, v.data(), v.size());
     }
+    void bind(const int index, std::span<const uint8_t> s)
+    {
+        SQLite::Statement::bind(index, s.data(), s.size());
+    }
     void bind(const int index, Funds f)
     {
         SQLite::Statement::bind(index, (int64_t)f.E8());
@@ -135,15 +154,41 @@ struct Statement2 : public SQLite::Statement {
         bind(i, std::forward<T>(t));
         recursive_bind<i + 1>(std::forward<Types>(types)...);
     }
+    // executes with parameters bound individually through bind()
+    uint32_t run_bound()
+    {
+        metrics::ScopeTimer st(timing());
+        auto nchanged = exec();
+        reset();
+        assert(nchanged >= 0);
+        return nchanged;
+    }
     template <typename... Types>
     uint32_t run(Types&&... types)
     {
         recursive_bind<1>(std::forward<Types>(types)...);
+        metrics::ScopeTimer st(timing());
         auto nchanged = exec();
         reset();
         assert(nchanged >=0);
         return nchanged;
     }
+    // Runs this statement of n placeholder groups (see multi_row_insert)
+    // once per n rows, remaining rows are run through single. Rows are
+    // tuples (or pairs) of parameters.
+    template <typename Rows>
+    void run_batch(size_t n, Statement2& single, const Rows& rows)
+    {
+        size_t i { 0 };
+        for (; i + n <= rows.size(); i += n) {
+            int index { 1 };
+            for (size_t j = 0; j < n; ++j)
+                std::apply([&](auto&... p) { (bind(index++, p), ...); }, rows[i + j]);
+            run_bound();
+        }
+        for (; i < rows.size(); ++i)
+            std::apply([&](auto&... p) { single.run(p...); }, rows[i]);
+    }
 
     // private:
     struct Row {
@@ -165,6 +210,13 @@ struct Statement2 : public SQLite::Statement {
             value_assert();
             return st.getColumn(index);
         }
+        // view on SQLite's buffer, only valid until the next step
+        std::span<const uint8_t> get_blob(int index)
+        {
+            value_assert();
+            auto c { st.getColumn(index) };
+            return { static_cast<const uint8_t*>(c.getBlob()), size_t(c.getBytes()) };
+        }
 
         template <typename T>
         operator std::optional<T>()
@@ -187,6 +239,7 @@ struct Statement2 : public SQLite::Statement {
         Row(Statement2& st)
             : st(st)
         {
+            metrics::ScopeTimer t(st.timing());
             hasValue = st.executeStep();
         }
         Statement2& st;
@@ -203,6 +256,16 @@ struct Statement2 : public SQLite::Statement {
     };
 
 public:
+    // execution time of this statement, steps of queries are observed
+    // individually
+    metrics::Histogram& timing()
+    {
+        if (!timingHistogram)
+            timingHistogram = &metrics::histogram("warthog_sqlite_statement_seconds",
+                "Duration of SQLite statement executions", { { "statement", getQuery() } });
+        return *timingHistogram;
+    }
+
     template <typename... Types>
     [[nodiscard]] SingleResult one(Types&&... types)
     {
@@ -210,6 +273,19 @@ public:
         return SingleResult { *this };
     }
 
+    // Runs this query of the form "... IN (?,...)" with n placeholders
+    // once per n keys, the last chunk is padded by repeating its final key.
+    template <typename Keys, typename Lambda>
+    void for_each_in(size_t n, const Keys& keys, Lambda lambda)
+    {
+        for (size_t i = 0; i < keys.size(); i += n) {
+            const size_t end { std::min(i + n, keys.size()) };
+            for (size_t j = 0; j < n; ++j)
+                bind(int(j + 1), keys[std::min(i + j, end - 1)]);
+            for_each(lambda);
+        }
+    }
+
     template <typename... Types, typename Lambda>
     void for_each(Lambda lambda, Types&&... types)
     {
@@ -222,6 +298,9 @@ public:
         }
         reset();
     }
+
+private:
+    metrics::Histogram* timingHistogram { nullptr };
 };
 
 class ChainDB {
@@ -230,21 +309,60 @@ private:
     // ids to save additional information in tables
     static constexpr int64_t WORKSUMID = -1;
     static constexpr int64_t SIGNEDPINID = -2;
+    static constexpr int64_t PRUNEDID = -3;
+    static constexpr int64_t ARCHIVEDID = -4;
 
 public:
-    ChainDB(const std::string& path);
+    ChainDB(const std::string& path, SQLiteProfile profile = SQLiteProfile::Balanced);
     [[nodiscard]] ChainDBTransaction transaction();
+
+    // must not be called within a transaction
+    void set_profile(SQLiteProfile);
+    SQLiteProfile profile() const { return activeProfile; }
+    // The history indices and the covering (address, balance) index of State
+    // are maintained in every profile, missing ones are built when the
+    // database is opened. Building them in one pass after sync would be
+    // faster but blocks the chainserver, the only writer, for the whole
+    // build, so only offline bulk loads (wart-replay reindex) drop them.
+    // Must not be called within a transaction.
+    void set_lookup_indices(bool enabled);
+    const std::string& path() const { return db.getFilename(); }
     void set_balance(AccountId stateId, Funds newbalance)
     {
         stmtStateSetBalance.run(newbalance, stateId);
+        accountCache.set_balance(stateId, newbalance);
     };
     void insertStateEntry(const AddressView address, Funds balance,
         AccountId verifyNextStateId);
 
     void delete_state_from(AccountId fromAccountId);
     // void setStateBalance(AccountId accountId, Funds balance);
-    void insert_consensus(NonzeroHeight height, BlockId blockId, HistoryId historyCursor, AccountId accountCursor);
-    std::tuple<std::vector<Batch>, HistoryHeights, AccountHeights>
+    void insert_consensus(NonzeroHeight height, BlockId blockId, HeaderView header, HistoryId historyCursor, AccountId accountCursor);
+    // Aggregates of a consensus block, inserted before its balances are
+    // written. The supply total continues the one of the previous block
+    // or, for the first block after an upgrade or a snapshot import,
+    // starts from the sum of all balances. Deleted with the consensus
+    // entry on rollback.
+    struct BlockStats {
+        uint32_t timestamp;
+        uint32_t transfers;
+        Funds volume;
+        Funds fees;
+        Funds rewards;
+        uint32_t newAccounts;
+        uint64_t accounts; // after the block
+        uint64_t transactions; // after the block, rewards included
+    };
+    void insert_block_stats(NonzeroHeight height, const BlockStats&);
+    // State commitment after each consensus block, deleted with the
+    // consensus entry on rollback. Missing for heights applied before the
+    // commitment was introduced, then it is computed from the State table.
+    void insert_state_commitment(NonzeroHeight height, const chainserver::StateCommitment&);
+    [[nodiscard]] std::optional<chainserver::StateCommitment> get_state_commitment(Height height) const;
+    // one pass over the State table
+    [[nodiscard]] chainserver::StateCommitment compute_state_commitment() const;
+    // headers are taken from the header store if it is consistent
+    std::tuple<ConsensusHeaders, HistoryHeights, AccountHeights>
     getConsensusHeaders() const;
 
     // Consensus Functions
@@ -258,7 +376,38 @@ public:
     // delete schedule functiosn
     [[nodiscard]] DeletionKey delete_consensus_from(NonzeroHeight height);
 
-    void garbage_collect_blocks(DeletionKey);
+    // deletes at most maxBlocks scheduled blocks, returns whether all
+    // blocks scheduled up to the deletion key are deleted
+    [[nodiscard]] bool garbage_collect_blocks(DeletionKey, size_t maxBlocks);
+    // Drops bodies and undo data of consensus blocks up to height upper,
+    // headers and state are kept.
+    void prune_blocks(Height upper, bool pruneHistory);
+    // consensus blocks up to this height have no body
+    Height pruned_height() const { return cache.prunedHeight; }
+    // Moves the bodies of the next full archive segment below height upper
+    // out of the Blocks table, returns false if there is none.
+    bool archive_blocks(Height upper);
+    // bodies of consensus blocks up to this height are in the block archive
+    Height archived_height() const { return cache.archivedHeight; }
+
+    // Online maintenance in small steps, must not be called within a
+    // transaction.
+    struct SpaceStats {
+        int64_t pageSize;
+        int64_t pages;
+        int64_t freePages;
+        uint64_t walBytes; // size of the WAL file
+    };
+    SpaceStats space_stats();
+    // free pages can only be returned to the file system by databases
+    // created with auto_vacuum=INCREMENTAL, others reuse them
+    bool incremental_vacuum_enabled() const { return incrementalVacuum; }
+    // releases at most maxPages free pages at the end of the file
+    void incremental_vacuum(int64_t maxPages);
+    // Copies the WAL into the database without waiting for readers, with
+    // truncate it also waits for readers and resets the WAL file. Returns
+    // whether all frames were copied.
+    bool checkpoint_wal(bool truncate);
     [[nodiscard]] DeletionKey schedule_protected_all();
     [[nodiscard]] DeletionKey schedule_protected_part(Headerchain hc, NonzeroHeight fromHeight);
     void protect_stage_assert_scheduled(BlockId id);
@@ -267,10 +416,16 @@ public:
     // Block functions
     // get
     [[nodiscard]] std::optional<BlockId> lookup_block_id(const HashView hash) const;
-    [[nodiscard]] std::optional<NonzeroHeight> lookup_block_height(const HashView hash) const;
     [[nodiscard]] std::optional<std::tuple<Header, RawBody, RawUndo>> get_block_undo(BlockId id) const;
+    // streams body and undo data of consensus blocks in [begin,end) by
+    // descending height, the spans are only valid during the callback
+    void visit_consensus_undo(Height begin, Height end,
+        const std::function<void(NonzeroHeight, std::span<const uint8_t> body, std::span<const uint8_t> undo)>& cb) const;
     [[nodiscard]] std::optional<Block> get_block(BlockId id) const;
     [[nodiscard]] std::optional<std::pair<BlockId, Block>> get_block(HashView hash) const;
+    // raw body access for serving blocks to peers without copying
+    [[nodiscard]] std::optional<size_t> body_size(HashView hash) const;
+    bool visit_body(HashView hash, const std::function<void(std::span<const uint8_t>)>& cb) const;
     // set
     std::pair<BlockId, bool> insert_protect(const Block&);
     void set_block_undo(BlockId id, const std::vector<uint8_t>& undo);
@@ -279,6 +434,8 @@ public:
     // Account functions
     // get
     [[nodiscard]] std::optional<AddressFunds> lookup_account(AccountId id) const;
+    // one query per accountLookupRows uncached ids, missing ids are omitted
+    [[nodiscard]] std::map<AccountId, AddressFunds> lookup_accounts(std::vector<AccountId> ids) const;
     [[nodiscard]] API::Richlist lookup_richlist(uint32_t N) const;
     [[nodiscard]] AddressFunds fetch_account(AccountId id) const;
 
@@ -314,25 +471,46 @@ public:
     std::vector<std::pair<Hash, std::vector<uint8_t>>>
     lookupHistoryRange(HistoryId lower, HistoryId upper);
     void insertAccountHistory(AccountId accountId, HistoryId historyId);
+    // multi-row variants, history ids are assigned consecutively
+    void insert_history(std::span<const std::pair<HashView, std::span<const uint8_t>>> rows);
+    void insert_account_history(std::span<const std::pair<AccountId, HistoryId>> rows);
     HistoryId next_history_id() const { return cache.nextHistoryId; }
 
+    //////////////////////////////
+    // State snapshots for bootstrapping new nodes (db/state_snapshot.cpp).
+    // The export contains headers, accounts and cursors at the signed
+    // snapshot height but only the bodies needed for transaction id checks.
+    // History before those blocks is omitted if pruneHistory is set.
+    void export_state_snapshot(const std::string& path, bool pruneHistory) const;
+    // must be called on an empty database
+    void import_state_snapshot(const std::string& path);
+
     //////////////////////////////
     // BELOW METHODS REQUIRED FOR INDEXING NODES
     std::optional<std::tuple<AccountId, Funds>> lookup_address(const AddressView address) const; // for indexing nodes
-    std::vector<std::tuple<HistoryId, Hash, std::vector<uint8_t>>> lookup_history_100_desc(AccountId account_id, int64_t beforeId);
+    // one query per addressLookupRows uncached addresses, missing addresses are omitted
+    using AddressLookups = std::map<Address, std::tuple<AccountId, Funds>, Address::Comparator>;
+    [[nodiscard]] AddressLookups lookup_addresses(std::vector<AddressView> addresses) const;
+    HistoryPage lookup_history_desc(AccountId account_id, int64_t beforeId, uint32_t limit);
+    size_t count_history(AccountId account_id, size_t cap);
 
 
 
 private:
+    void load_archived_body(Block&) const;
     [[nodiscard]] bool schedule_exists(BlockId dk);
     [[nodiscard]] bool consensus_exists(Height h, BlockId dk);
 
 private:
     SQLite::Database db;
     Filelock fl;
+    SQLiteProfile activeProfile;
+    bool incrementalVacuum { false };
     struct CreateTables {
         CreateTables(SQLite::Database& db)
         {
+            // only takes effect on new databases
+            db.exec("PRAGMA auto_vacuum = INCREMENTAL");
             db.exec("PRAGMA foreign_keys = ON");
             db.exec("CREATE TABLE IF NOT EXISTS `AccountHistory` (`account_id` "
                     "INTEGER, `history_id` INTEGER, PRIMARY "
@@ -341,7 +519,15 @@ private:
 
             db.exec("CREATE TABLE IF NOT EXISTS `Blocks` ( `height` INTEGER "
                     "NOT NULL, `header` BLOB NOT NULL, `body` BLOB NOT NULL, "
-                    "`undo` BLOB DEFAULT null, `hash` BLOB NOT NULL UNIQUE )");
+                    "`hash` BLOB NOT NULL UNIQUE )");
+            // undo data is rarely read and kept apart from the bodies such
+            // that serving blocks and rollbacks do not page in each other's
+            // data, `length` is the uncompressed size
+            db.exec("CREATE TABLE IF NOT EXISTS `Undo` ( `block_id` INTEGER NOT NULL, "
+                    "`compression` INTEGER NOT NULL, `length` INTEGER NOT NULL, "
+                    "`undo` BLOB NOT NULL, PRIMARY KEY(`block_id`))");
+            db.exec("CREATE TRIGGER IF NOT EXISTS `undo_delete` AFTER DELETE ON `Blocks` "
+                    "BEGIN DELETE FROM `Undo` WHERE `block_id`=OLD.ROWID; END");
             db.exec("CREATE TABLE IF NOT EXISTS \"Consensus\" ( `height` INTEGER NOT "
                     "NULL, `block_id` INTEGER NOT NULL, `history_cursor` INTEGER NOT "
                     "NULL, `account_cursor` INTEGER NOT NULL, PRIMARY KEY(`height`) )");
@@ -359,28 +545,56 @@ private:
                     "BLOB UNIQUE )");
             db.exec("CREATE TABLE IF NOT EXISTS`Deleteschedule` ( `block_id`	INTEGER NOT NULL, `deletion_key`	INTEGER, PRIMARY KEY(`block_id`))");
 
-            // create indices
+            // create indices, the history indices are created by set_lookup_indices
             db.exec("CREATE INDEX IF NOT EXISTS `deletion_key` ON `Deleteschedule` ( `deletion_key`)");
-            db.exec("CREATE INDEX IF NOT EXISTS `account_history_index` ON "
-                    "`AccountHistory` (`history_id` ASC)");
+            db.exec("CREATE INDEX IF NOT EXISTS `balance_index` ON "
+                    "`State` (`balance` DESC)");
             db.exec("CREATE TABLE IF NOT EXISTS `History` ( `id` INTEGER NOT NULL, "
                     "`hash` BLOB NOT NULL, `data` BLOB NOT NULL, PRIMARY KEY(`id`))");
+            // per block aggregates of the consensus chain, the last three
+            // columns are running totals up to and including the block
+            db.exec("CREATE TABLE IF NOT EXISTS `BlockStats` ( `height` INTEGER NOT NULL, "
+                    "`timestamp` INTEGER NOT NULL, `transfers` INTEGER NOT NULL, "
+                    "`volume` INTEGER NOT NULL, `fees` INTEGER NOT NULL, `rewards` INTEGER NOT NULL, "
+                    "`new_accounts` INTEGER NOT NULL, `supply` INTEGER NOT NULL, "
+                    "`accounts` INTEGER NOT NULL, `transactions` INTEGER NOT NULL, PRIMARY KEY(`height`))");
+            db.exec("CREATE INDEX IF NOT EXISTS `block_stats_timestamp` ON `BlockStats` (`timestamp`)");
+            db.exec("CREATE TABLE IF NOT EXISTS `StateCommitment` ( `height` INTEGER NOT NULL, "
+                    "`commitment` BLOB NOT NULL, PRIMARY KEY(`height`))");
+            migrate(db);
         }
+        // Schema versions (PRAGMA user_version):
+        //   0: initial
+        //   1: AccountHistory clustered by (account_id, history_id)
+        //   2: undo data moved from Blocks to Undo
+        static constexpr int64_t schemaVersion = 2;
+        static void migrate(SQLite::Database& db);
     } createTables;
     struct Cache {
         AccountId maxStateId;
         HistoryId nextHistoryId;
         DeletionKey deletionKey;
+        Height prunedHeight;
+        Height archivedHeight;
         static Cache init(SQLite::Database& db);
     } cache;
+    mutable chainserver::PersistentAccountCache accountCache;
+    mutable HeaderStore headerStore;
+    BlockArchive archive;
     Statement2 stmtBlockInsert;
+    Statement2 stmtBlockInsertPruned;
     Statement2 stmtUndoSet;
     mutable Statement2 stmtBlockGetUndo;
+    mutable Statement2 stmtConsensusUndoRange;
     mutable Statement2 stmtBlockById;
     mutable Statement2 stmtBlockByHash;
+    mutable Statement2 stmtBlockBodySize;
+    mutable Statement2 stmtBlockBody;
 
     // Consensus table functions
     mutable Statement2 stmtConsensusHeaders;
+    mutable Statement2 stmtConsensusCursors;
+    mutable Statement2 stmtConsensusHeader;
     Statement2 stmtConsensusInsert;
     // Statement2 stmtConsensusSet;
     Statement2 stmtConsensusSetProperty;
@@ -389,6 +603,11 @@ private:
     mutable Statement2 stmtConsensusSelectHistory;
     mutable Statement2 stmtConsensusHead;
     Statement2 stmtConsensusDeleteFrom;
+    Statement2 stmtBlockStatsInsert;
+    Statement2 stmtBlockStatsDeleteFrom;
+    Statement2 stmtStateCommitmentInsert;
+    mutable Statement2 stmtStateCommitmentGet;
+    Statement2 stmtStateCommitmentDeleteFrom;
 
     Statement2 stmtScheduleExists;
     Statement2 stmtScheduleInsert;
@@ -398,6 +617,8 @@ private:
     Statement2 stmtScheduleConsensus;
     Statement2 stmtDeleteGCBlocks;
     Statement2 stmtDeleteGCRefs;
+    Statement2 stmtBlockPrune;
+    Statement2 stmtUndoPrune;
 
     Statement2 stmtStateInsert;
     Statement2 stmtStateDeleteFrom;
@@ -405,20 +626,35 @@ private:
     Statement2 stmtBadblockInsert;
     mutable Statement2 stmtBadblockGet;
     mutable Statement2 stmtAccountLookup;
+    static constexpr size_t accountLookupRows { 64 };
+    mutable Statement2 stmtAccountLookupMulti;
     mutable Statement2 stmtRichlistLookup;
     Statement2 stmtHistoryInsert;
     Statement2 stmtHistoryDeleteFrom;
     mutable Statement2 stmtHistoryLookup;
     mutable Statement2 stmtHistoryLookupRange;
     Statement2 stmtAccountHistoryInsert;
+    static constexpr size_t historyInsertRows { 64 };
+    static constexpr size_t accountHistoryInsertRows { 256 };
+    Statement2 stmtHistoryInsertMulti;
+    Statement2 stmtAccountHistoryInsertMulti;
     Statement2 stmtAccountHistoryDeleteFrom;
+    Statement2 stmtHistoryDeleteBelow;
+    Statement2 stmtAccountHistoryDeleteBelow;
 
     mutable Statement2 stmtBlockIdSelect;
-    mutable Statement2 stmtBlockHeightSelect;
     Statement2 stmtBlockDelete;
 
     mutable Statement2 stmtAddressLookup;
+    static constexpr size_t addressLookupRows { 64 };
+    mutable Statement2 stmtAddressLookupMulti;
     mutable Statement2 stmtHistoryById;
+    mutable Statement2 stmtHistoryCount;
+
+    // state snapshot export
+    mutable Statement2 stmtStateExport;
+    mutable Statement2 stmtHistoryExport;
+    mutable Statement2 stmtAccountHistoryExport;
 };
 class ChainDBTransaction {
 public:
@@ -426,11 +662,14 @@ public:
     {
         tx.commit();
         commited = true;
+        parent->headerStore.commit();
     }
     ~ChainDBTransaction()
     {
         if (parent != nullptr && !commited) {
             parent->cache = c;
+            parent->accountCache.clear();
+            parent->headerStore.discard();
         }
     }
     ChainDBTransaction(const ChainDBTransaction&) = delete;
@@ -438,10 +677,30 @@ public:
         : parent(other.parent)
         , tx(std::move(other.tx))
         , c(std::move(other.c))
+        , savepoint(std::move(other.savepoint))
     {
         other.commited = true;
     }
 
+    // Sets a savepoint, rollback_to_savepoint() drops the modifications
+    // made after it and keeps the transaction open.
+    void set_savepoint()
+    {
+        if (savepoint)
+            parent->db.exec("RELEASE SAVEPOINT chaindb");
+        parent->db.exec("SAVEPOINT chaindb");
+        savepoint = Savepoint { parent->cache, parent->headerStore.mark() };
+    }
+    bool has_savepoint() const { return savepoint.has_value(); }
+    void rollback_to_savepoint()
+    {
+        assert(savepoint);
+        parent->db.exec("ROLLBACK TO SAVEPOINT chaindb");
+        parent->cache = savepoint->cache;
+        parent->accountCache.clear();
+        parent->headerStore.discard_after(savepoint->headers);
+    }
+
 private:
     friend class ChainDB;
     ChainDBTransaction(ChainDB& parent)
@@ -450,8 +709,13 @@ private:
         , c(parent.cache)
     {
     }
+    struct Savepoint {
+        ChainDB::Cache cache;
+        HeaderStore::Mark headers;
+    };
     bool commited = false;
     ChainDB* parent;
     SQLite::Transaction tx;
     ChainDB::Cache c;
+    std::optional<Savepoint> savepoint;
 };
@@ -0,0 +1,249 @@
+#include "chain_db_reader.hpp"
+#include "api/types/all.hpp"
+#include "block/chain/history/history.hpp"
+
+ChainDBReader::ChainDBReader(const std::string& path)
+    : db(path, SQLite::OPEN_READONLY)
+    , stmtAccountLookup(
+          db, "SELECT `Address`, `Balance` FROM `State` WHERE ROWID=?")
+    , stmtRichlistLookup(
+          db, "SELECT Address, Balance FROM `State` ORDER BY `Balance` DESC LIMIT ?")
+    , stmtAddressLookup(
+          db, "SELECT `ROWID`,`balance` FROM `State` WHERE `address`=?")
+    , stmtHistoryLookupRange(db,
+          "SELECT `hash`, `data` FROM `History` WHERE `id`>=? AND`id`<?")
+    // constrain and order by the AccountHistory primary key such that
+    // the scan runs on its (account_id, history_id) index
+    , stmtHistoryById(db, "SELECT ah.history_id, `hash`,`data` FROM `AccountHistory` `ah` "
+                          "JOIN `History` `h` ON h.id=`ah`.history_id WHERE "
+                          "ah.`account_id`=? AND ah.history_id<? ORDER BY ah.history_id DESC LIMIT ?")
+    , stmtHistoryAsc(db, "SELECT ah.history_id, `hash`,`data` FROM `AccountHistory` `ah` "
+                         "JOIN `History` `h` ON h.id=`ah`.history_id WHERE "
+                         "ah.`account_id`=? AND ah.history_id>? ORDER BY ah.history_id ASC LIMIT ?")
+    , stmtHistoryCount(db, "SELECT COUNT(*) FROM (SELECT 1 FROM `AccountHistory` "
+                           "WHERE `account_id`=? LIMIT ?)")
+    , stmtHistoryLatest(db, "SELECT `history_id` FROM `AccountHistory` "
+                            "WHERE `account_id`=? ORDER BY `history_id` DESC LIMIT 1")
+    // aggregated on the timestamp index, the running totals are taken from
+    // the last block of each bucket
+    , stmtChainStats(db, "SELECT g.b, g.first, g.last, g.blocks, g.transfers, g.volume, g.fees, g.rewards, "
+                         "g.new_accounts, s.supply, s.accounts, s.transactions FROM (SELECT "
+                         "(`timestamp`-?1)/?3 AS b, min(`height`) AS first, max(`height`) AS last, count(*) AS blocks, "
+                         "sum(`transfers`) AS transfers, sum(`volume`) AS volume, sum(`fees`) AS fees, "
+                         "sum(`rewards`) AS rewards, sum(`new_accounts`) AS new_accounts FROM `BlockStats` "
+                         "WHERE `timestamp`>=?1 AND `timestamp`<?2 GROUP BY b) g "
+                         "JOIN `BlockStats` s ON s.height=g.last ORDER BY g.b ASC")
+    , stmtConsensusHashes(db, "SELECT b.`hash` FROM `Consensus` c JOIN `Blocks` b ON b.ROWID=c.`block_id` "
+                              "WHERE c.`height`>=? AND c.`height`<? ORDER BY c.`height` ASC")
+    , stmtMaxAccountId(db, "SELECT coalesce(max(ROWID),0) FROM `State`")
+    , stmtHistoryComplete(db, "SELECT EXISTS(SELECT 1 FROM `History` WHERE `id`=1)")
+    , stmtAccountHistoryData(db, "SELECT h.`data` FROM `AccountHistory` `ah` "
+                                 "JOIN `History` `h` ON h.id=`ah`.history_id WHERE ah.`account_id`=?")
+{
+}
+
+std::optional<AddressFunds> ChainDBReader::lookup_account(AccountId id) const
+{
+    auto o { stmtAccountLookup.one(id) };
+    if (!o.has_value())
+        return {};
+    return AddressFunds {
+        .address = o.get_array<20>(0),
+        .funds = o.get<Funds>(1)
+    };
+}
+
+AddressFunds ChainDBReader::fetch_account(AccountId id) const
+{
+    auto p = lookup_account(id);
+    if (!p) {
+        throw std::runtime_error("Database corrupted (fetch_account(" + std::to_string(id.value()) + ")");
+    }
+    return *p;
+}
+
+API::Richlist ChainDBReader::lookup_richlist(uint32_t N) const
+{
+    API::Richlist out;
+    stmtRichlistLookup.for_each([&](Statement2::Row& r) {
+        out.entries.push_back(
+            { Address { r.get_array<20>(0) },
+                r.get<Funds>(1) });
+    },
+        N);
+    return out;
+}
+
+std::optional<std::tuple<AccountId, Funds>> ChainDBReader::lookup_address(const AddressView address) const
+{
+    auto p = stmtAddressLookup.one(address);
+    if (!p.has_value())
+        return {};
+    return std::tuple<AccountId, Funds> {
+        p.get<AccountId>(0),
+        p.get<Funds>(1)
+    };
+}
+
+std::vector<std::pair<Hash, std::vector<uint8_t>>> ChainDBReader::lookupHistoryRange(HistoryId lower, HistoryId upper) const
+{
+    std::vector<std::pair<Hash, std::vector<uint8_t>>> out;
+    int64_t l = lower.value();
+    int64_t u = (upper == HistoryId { 0 } ? std::numeric_limits<int64_t>::max() : upper.value());
+    stmtHistoryLookupRange.for_each([&](Statement2::Row& r) {
+        out.push_back(
+            { r.get_array<32>(0),
+                r.get_vector(1) });
+    },
+        l, u);
+    return out;
+}
+
+HistoryPage ChainDBReader::lookup_history_desc(
+    AccountId accountId, int64_t beforeId, uint32_t limit) const
+{
+    HistoryPage out;
+    // one extra row tells whether more entries exist, its data is not read
+    stmtHistoryById.for_each(
+        [&](Statement2::Row& row) {
+            if (out.entries_desc.size() == limit) {
+                out.more = true;
+                return;
+            }
+            out.entries_desc.push_back({ HistoryId { row.get<uint64_t>(0) },
+                row.get_array<32>(1),
+                row.get_vector(2) });
+        },
+        accountId, beforeId, int64_t(limit) + 1);
+    return out;
+}
+
+std::vector<std::tuple<HistoryId, Hash, std::vector<uint8_t>>> ChainDBReader::lookup_history_asc(
+    AccountId accountId, int64_t afterId, uint32_t limit) const
+{
+    std::vector<std::tuple<HistoryId, Hash, std::vector<uint8_t>>> out;
+    stmtHistoryAsc.for_each(
+        [&](Statement2::Row& row) {
+            out.push_back({ HistoryId { row.get<uint64_t>(0) },
+                row.get_array<32>(1),
+                row.get_vector(2) });
+        },
+        accountId, afterId, limit);
+    return out;
+}
+
+size_t ChainDBReader::count_history(AccountId accountId, size_t cap) const
+{
+    return stmtHistoryCount.one(accountId, int64_t(cap)).get<int64_t>(0);
+}
+
+API::ChainStats ChainDBReader::lookup_chain_stats(uint32_t from, uint32_t to, uint32_t bucketSeconds) const
+{
+    API::ChainStats out { .bucketSeconds = bucketSeconds, .buckets {} };
+    stmtChainStats.for_each([&](Statement2::Row& r) {
+        auto height = [&](int i) {
+            Height h { r.get<Height>(i) };
+            if (h == 0)
+                throw std::runtime_error("Database corrupted, block statistics at height 0.");
+            return h.nonzero_assert();
+        };
+        out.buckets.push_back({
+            .begin = uint32_t(from + r.get<int64_t>(0) * bucketSeconds),
+            .firstHeight = height(1),
+            .lastHeight = height(2),
+            .blocks = uint32_t(r.get<int64_t>(3)),
+            .transfers = r.get<uint64_t>(4),
+            .volume = r.get<Funds>(5),
+            .fees = r.get<Funds>(6),
+            .rewards = r.get<Funds>(7),
+            .newAccounts = r.get<uint64_t>(8),
+            .supply = r.get<Funds>(9),
+            .accounts = r.get<uint64_t>(10),
+            .transactions = r.get<uint64_t>(11),
+        });
+    },
+        from, to, bucketSeconds);
+    return out;
+}
+
+API::Balances ChainDBReader::lookup_balances(const API::BalancesRequest& req)
+{
+    auto& addresses { req.addresses };
+    API::Balances out;
+    out.entries.reserve(addresses.size());
+    std::vector<size_t> valid;
+    for (size_t i = 0; i < addresses.size(); ++i) {
+        if (addresses[i].has_value()) {
+            out.entries.push_back(API::Balances::Entry {
+                .balance { AccountId { 0 }, Funds { 0 } },
+                .latestHistoryId {},
+            });
+            valid.push_back(i);
+        } else {
+            out.entries.push_back(tl::make_unexpected(addresses[i].error()));
+        }
+    }
+    // address order walks the address index front to back
+    std::sort(valid.begin(), valid.end(), [&](size_t a, size_t b) {
+        return *addresses[a] < *addresses[b];
+    });
+
+    SQLite::Transaction t(db); // consistent snapshot, one shared lock
+    for (auto i : valid) {
+        auto p { lookup_address(*addresses[i]) };
+        if (!p)
+            continue;
+        auto& [accountId, balance] { *p };
+        auto& e { *out.entries[i] };
+        e.balance = { accountId, balance };
+        if (req.latestHistory) {
+            if (auto o { stmtHistoryLatest.one(accountId) }; o.has_value())
+                e.latestHistoryId = HistoryId { o.get<uint64_t>(0) };
+        }
+    }
+    return out;
+}
+
+std::vector<Hash> ChainDBReader::consensus_hashes(NonzeroHeight begin, NonzeroHeight end) const
+{
+    std::vector<Hash> out;
+    stmtConsensusHashes.for_each([&](Statement2::Row& r) {
+        out.push_back(r.get_array<32>(0));
+    },
+        begin, end);
+    return out;
+}
+
+AccountId ChainDBReader::max_account_id() const
+{
+    return stmtMaxAccountId.one().get<AccountId>(0);
+}
+
+std::optional<std::pair<Funds, Funds>> ChainDBReader::audit_balance(AccountId id, size_t maxEntries)
+{
+    SQLite::Transaction t(db); // consistent snapshot
+    if (stmtHistoryComplete.one().get<int64_t>(0) == 0)
+        return {};
+    auto account { lookup_account(id) };
+    if (!account || count_history(id, maxEntries + 1) > maxEntries)
+        return {};
+    uint64_t in { 0 };
+    uint64_t out { 0 };
+    stmtAccountHistoryData.for_each([&](Statement2::Row& r) {
+        auto parsed { history::parse(r.get_vector(0)) };
+        if (!parsed)
+            throw std::runtime_error("Database corrupted, cannot parse history entry of account " + std::to_string(id.value()));
+        if (auto tr { std::get_if<history::TransferData>(&*parsed) }) {
+            if (tr->fromAccountId == id)
+                out += tr->amount.E8() + tr->compactFee.uncompact().E8();
+            if (tr->toAccountId == id)
+                in += tr->amount.E8();
+        } else {
+            auto& rw { std::get<history::RewardData>(*parsed) };
+            if (rw.toAccountId == id)
+                in += rw.miningReward.E8();
+        }
+    },
+        id);
+    return std::pair { account->funds, Funds(in - out) };
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include "db/chain_db.hpp"
+
+// Read-only connection to the chain database with its own prepared
+// statements. Used by the API read pool to query the database
+// concurrently to the chainserver (requires WAL journal mode).
+class ChainDBReader {
+public:
+    ChainDBReader(const std::string& path);
+    ChainDBReader(const ChainDBReader&) = delete;
+
+    [[nodiscard]] std::optional<AddressFunds> lookup_account(AccountId id) const;
+    [[nodiscard]] AddressFunds fetch_account(AccountId id) const;
+    [[nodiscard]] API::Richlist lookup_richlist(uint32_t N) const;
+    std::optional<std::tuple<AccountId, Funds>> lookup_address(const AddressView address) const;
+    // all addresses within one read transaction
+    [[nodiscard]] API::Balances lookup_balances(const API::BalancesRequest&);
+    std::vector<std::pair<Hash, std::vector<uint8_t>>> lookupHistoryRange(HistoryId lower, HistoryId upper) const;
+    HistoryPage lookup_history_desc(AccountId account_id, int64_t beforeId, uint32_t limit) const;
+    // continues a forward scan after the history id afterId, oldest first
+    std::vector<std::tuple<HistoryId, Hash, std::vector<uint8_t>>> lookup_history_asc(AccountId account_id, int64_t afterId, uint32_t limit) const;
+    size_t count_history(AccountId account_id, size_t cap) const;
+    // block statistics of timestamps in [from, to)
+    [[nodiscard]] API::ChainStats lookup_chain_stats(uint32_t from, uint32_t to, uint32_t bucketSeconds) const;
+
+    // for the background consistency check
+    // hashes stored with the consensus blocks of heights in [begin, end)
+    [[nodiscard]] std::vector<Hash> consensus_hashes(NonzeroHeight begin, NonzeroHeight end) const;
+    [[nodiscard]] AccountId max_account_id() const;
+    // stored balance and the balance summed up from the account history
+    // within one read transaction, empty if the account does not exist, has
+    // more than maxEntries history entries or the history is pruned
+    [[nodiscard]] std::optional<std::pair<Funds, Funds>> audit_balance(AccountId, size_t maxEntries);
+
+private:
+    SQLite::Database db;
+    mutable Statement2 stmtAccountLookup;
+    mutable Statement2 stmtRichlistLookup;
+    mutable Statement2 stmtAddressLookup;
+    mutable Statement2 stmtHistoryLookupRange;
+    mutable Statement2 stmtHistoryById;
+    mutable Statement2 stmtHistoryAsc;
+    mutable Statement2 stmtHistoryCount;
+    mutable Statement2 stmtHistoryLatest;
+    mutable Statement2 stmtChainStats;
+    mutable Statement2 stmtConsensusHashes;
+    mutable Statement2 stmtMaxAccountId;
+    mutable Statement2 stmtHistoryComplete;
+    mutable Statement2 stmtAccountHistoryData;
+};
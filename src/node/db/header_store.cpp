@@ -0,0 +1,261 @@
+#include "header_store.hpp"
+#include "block/header/view_inline.hpp"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <spdlog/spdlog.h>
+#ifdef _WIN32
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+constexpr size_t WorksumSize { 32 };
+
+// read-only view of a whole file
+class MappedFile {
+public:
+    MappedFile(const std::string& path)
+    {
+#ifdef _WIN32
+        std::ifstream f(path, std::ios::binary);
+        if (f)
+            buf.assign(std::istreambuf_iterator<char>(f), {});
+        ptr = buf.data();
+        len = buf.size();
+#else
+        int fd { open(path.c_str(), O_RDONLY) };
+        if (fd < 0)
+            return;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* p { mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) };
+            if (p != MAP_FAILED) {
+                ptr = static_cast<const uint8_t*>(p);
+                len = st.st_size;
+            }
+        }
+        close(fd);
+#endif
+    }
+    MappedFile(const MappedFile&) = delete;
+    ~MappedFile()
+    {
+#ifndef _WIN32
+        if (len > 0)
+            munmap(const_cast<uint8_t*>(ptr), len);
+#endif
+    }
+    const uint8_t* data() const { return ptr; }
+    size_t size() const { return len; }
+
+private:
+#ifdef _WIN32
+    std::vector<uint8_t> buf;
+#endif
+    const uint8_t* ptr { nullptr };
+    size_t len { 0 };
+};
+
+bool append_file(const std::string& path, const uint8_t* data, size_t n)
+{
+    std::ofstream f(path, std::ios::binary | std::ios::app);
+    f.write(reinterpret_cast<const char*>(data), n);
+    f.flush();
+    return f.good();
+}
+}
+
+HeaderStore::HeaderStore(const std::string& dbpath)
+    : headerPath(dbpath + ".headers")
+    , worksumPath(dbpath + ".worksum")
+{
+}
+
+std::optional<ConsensusHeaders> HeaderStore::load(Height length, const Header& tip, const Worksum& totalWork)
+{
+    valid = false;
+    MappedFile headers(headerPath);
+    MappedFile worksums(worksumPath);
+    const size_t nComplete { length.complete_batches() };
+    if (length.value() == 0
+        || headers.size() < size_t(length.value()) * 80
+        || worksums.size() < nComplete * WorksumSize
+        || memcmp(headers.data() + (length.value() - 1) * 80, tip.data(), 80) != 0)
+        return {};
+
+    ConsensusHeaders res;
+    res.batchWork.reserve(nComplete);
+    for (size_t i = 0; i < nComplete; ++i) {
+        std::array<uint8_t, WorksumSize> a;
+        memcpy(a.data(), worksums.data() + i * WorksumSize, WorksumSize);
+        res.batchWork.push_back(a);
+    }
+    const uint8_t* tailBegin { headers.data() + nComplete * HEADERBATCHSIZE * 80 };
+    Batch t(tailBegin, tailBegin + length.incomplete_batch_size() * 80);
+    Worksum w { nComplete > 0 ? res.batchWork.back() : Worksum {} };
+    if (w + t.worksum(Height(nComplete * HEADERBATCHSIZE)) != totalWork)
+        return {};
+
+    res.batches.reserve(nComplete + 1);
+    for (size_t i = 0; i < nComplete; ++i) {
+        auto begin { headers.data() + i * HEADERBATCHSIZE * 80 };
+        res.batches.emplace_back(begin, begin + HEADERBATCHSIZE * 80);
+    }
+    if (t.size() > 0)
+        res.batches.push_back(t);
+
+    // drop uncommitted leftovers
+    const bool excess { headers.size() > size_t(length.value()) * 80
+        || worksums.size() > nComplete * WorksumSize };
+    this->length = length;
+    checkpoints = res.batchWork;
+    tail = std::move(t);
+    valid = true;
+    if (excess)
+        truncate_files(length);
+    discard();
+    return res;
+}
+
+void HeaderStore::rebuild(ConsensusHeaders& h)
+{
+    valid = false;
+    length = Height(0);
+    checkpoints.clear();
+    tail.clear();
+    h.batchWork.clear();
+    std::error_code ec;
+    std::filesystem::remove(headerPath, ec);
+    std::filesystem::remove(worksumPath, ec);
+
+    bool ok { true };
+    for (auto& b : h.batches) {
+        ok = ok && append_file(headerPath, b.data(), b.size() * 80);
+        if (b.complete()) {
+            Worksum w { checkpoint(checkpoints.size()) + b.worksum(length) };
+            ok = ok && append_file(worksumPath, w.to_bytes().data(), WorksumSize);
+            checkpoints.push_back(w);
+        } else {
+            tail = b;
+        }
+        length = length + b.size();
+    }
+    h.batchWork = checkpoints;
+    valid = ok;
+    if (!ok)
+        spdlog::warn("Cannot write header store {}", headerPath);
+    discard();
+}
+
+void HeaderStore::append(NonzeroHeight height, const Header& header)
+{
+    if (height.value() != shrinkLength.value() + appended.size() + 1) {
+        // gap, cannot follow the database anymore
+        valid = false;
+        return;
+    }
+    appended.push_back(header);
+}
+
+void HeaderStore::shrink(Height newLength)
+{
+    if (newLength.value() < shrinkLength.value()) {
+        shrinkLength = newLength;
+        appended.clear();
+    } else if (newLength.value() < shrinkLength.value() + appended.size()) {
+        appended.resize(newLength - shrinkLength);
+    }
+}
+
+void HeaderStore::commit()
+{
+    if (!valid) {
+        std::error_code ec;
+        std::filesystem::remove(headerPath, ec);
+        std::filesystem::remove(worksumPath, ec);
+        discard();
+        return;
+    }
+    if (shrinkLength < length)
+        truncate_files(shrinkLength);
+    for (auto& h : appended) {
+        if (!append_file(headerPath, h.data(), 80)) {
+            valid = false;
+            break;
+        }
+        tail.append(h);
+        length = length + 1;
+        if (tail.complete()) {
+            Worksum w { checkpoint(checkpoints.size()) + tail.worksum(length - HEADERBATCHSIZE) };
+            if (!append_file(worksumPath, w.to_bytes().data(), WorksumSize)) {
+                valid = false;
+                break;
+            }
+            checkpoints.push_back(w);
+            tail.clear();
+        }
+    }
+    if (!valid) {
+        spdlog::warn("Cannot write header store {}, it will be rebuilt on next start", headerPath);
+        return commit(); // removes files
+    }
+    discard();
+}
+
+void HeaderStore::discard()
+{
+    shrinkLength = length;
+    appended.clear();
+}
+
+void HeaderStore::discard_after(const Mark& m)
+{
+    if (shrinkLength == m.shrinkLength && appended.size() >= m.appended) {
+        appended.resize(m.appended);
+        valid = m.valid;
+    } else {
+        // shrinked below the mark, headers appended before it are lost
+        // and the files are rebuilt on next start
+        shrinkLength = m.shrinkLength;
+        appended.clear();
+        valid = false;
+    }
+}
+
+void HeaderStore::truncate_files(Height newLength)
+{
+    assert(newLength <= length);
+    const size_t nComplete { newLength.complete_batches() };
+    std::error_code ec;
+    std::filesystem::resize_file(headerPath, size_t(newLength.value()) * 80, ec);
+    if (!ec)
+        std::filesystem::resize_file(worksumPath, nComplete * WorksumSize, ec);
+    if (ec) {
+        valid = false;
+        return;
+    }
+    if (nComplete < checkpoints.size()) {
+        // previously complete batch becomes tail, read it back
+        tail.clear();
+        if (newLength.incomplete_batch_size() > 0) {
+            MappedFile headers(headerPath);
+            auto begin { headers.data() + nComplete * HEADERBATCHSIZE * 80 };
+            tail.assign(begin, begin + newLength.incomplete_batch_size() * 80);
+        }
+        checkpoints.resize(nComplete);
+    } else {
+        tail.shrink(newLength.incomplete_batch_size());
+    }
+    length = newLength;
+}
+
+Worksum HeaderStore::checkpoint(size_t i) const
+{
+    // cumulative worksum before batch i
+    return i == 0 ? Worksum {} : checkpoints[i - 1];
+}
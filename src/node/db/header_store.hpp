@@ -0,0 +1,65 @@
+#pragma once
+#include "block/chain/height.hpp"
+#include "block/header/batch.hpp"
+#include "block/header/header.hpp"
+#include "block/chain/worksum.hpp"
+#include <optional>
+#include <string>
+#include <vector>
+
+// Headers of the consensus chain as loaded at startup. If known, batchWork
+// holds the cumulative worksum up to and including each complete batch.
+struct ConsensusHeaders {
+    std::vector<Batch> batches;
+    std::vector<Worksum> batchWork;
+};
+
+// Flat copy of the consensus headers next to the chain database such that
+// startup does not need to read every header from the Blocks table. Two
+// append-only files are kept: "<db>.headers" holds the raw 80 byte headers
+// in height order and "<db>.worksum" holds the cumulative worksum of every
+// complete batch (one checkpoint per Batchslot). The store is only a cache,
+// it is validated against the database on load and rebuilt from it on any
+// mismatch. Modifications are buffered and written on commit of the
+// surrounding ChainDBTransaction, they are dropped on rollback.
+class HeaderStore {
+public:
+    HeaderStore(const std::string& dbpath);
+
+    // Maps the files, returns nullopt unless they contain a chain of
+    // `length` headers ending with `tip` and with total work `totalWork`.
+    [[nodiscard]] std::optional<ConsensusHeaders> load(Height length, const Header& tip, const Worksum& totalWork);
+    // replaces the files by the given headers, fills in h.batchWork
+    void rebuild(ConsensusHeaders& h);
+
+    void append(NonzeroHeight, const Header&);
+    void shrink(Height length);
+    void commit();
+    void discard();
+    // uncommitted modifications at some point, for partial discards
+    struct Mark {
+        Height shrinkLength;
+        size_t appended;
+        bool valid;
+    };
+    Mark mark() const { return { shrinkLength, appended.size(), valid }; }
+    void discard_after(const Mark&);
+
+private:
+    void truncate_files(Height length);
+    Worksum checkpoint(size_t i) const;
+
+    std::string headerPath;
+    std::string worksumPath;
+    bool valid { false }; // files reflect the committed chain
+
+    // committed state
+    Height length { 0 };
+    std::vector<Worksum> checkpoints;
+    Batch tail; // headers after the last complete batch
+
+    // uncommitted modifications: chain shrinked to shrinkLength, then
+    // appended headers
+    Height shrinkLength { 0 };
+    std::vector<Header> appended;
+};
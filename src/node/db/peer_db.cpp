@@ -11,8 +11,17 @@ PeerDB::CreateTables::CreateTables(SQLite::Database& db)
             "`code` INTEGER DEFAULT NULL )");
     db.exec("CREATE TABLE IF NOT EXISTS `refuse_log` ( `peer` INTEGER NOT NULL, `timestamp` INTEGER NOT NULL )");
     db.exec("CREATE INDEX IF NOT EXISTS `bans_index` ON `bans` ( `ban_until` DESC )");
+    db.exec("CREATE TABLE IF NOT EXISTS `ban_ranges` ( `ip` INTEGER NOT NULL, "
+            "`prefix` INTEGER NOT NULL, `ban_until` INTEGER NOT NULL, "
+            "PRIMARY KEY(`ip`, `prefix`) )");
     db.exec(R"SQL(CREATE TABLE IF NOT EXISTS "peers" ( "ipport" INTEGER, "lastseen" INTEGER DEFAULT 0, PRIMARY KEY("ipport")))SQL");
     db.exec(R"SQL(CREATE INDEX IF NOT EXISTS "lastseen_peers" ON "peers" ( "lastseen"))SQL");
+    // connect statistics, added to existing databases
+    if (db.execAndGet("SELECT COUNT(*) FROM pragma_table_info('peers') WHERE name='successes'").getInt() == 0) {
+        db.exec("ALTER TABLE `peers` ADD COLUMN `successes` INTEGER NOT NULL DEFAULT 0");
+        db.exec("ALTER TABLE `peers` ADD COLUMN `failures` INTEGER NOT NULL DEFAULT 0");
+        db.exec("ALTER TABLE `peers` ADD COLUMN `latency` INTEGER DEFAULT NULL");
+    }
 }
 
 PeerDB::PeerDB(const std::string& path)
@@ -22,35 +31,91 @@ PeerDB::PeerDB(const std::string& path)
     , getOffenses(db, "SELECT `ip`, `timestamp`, `offense` FROM `offenses` LIMIT 100 OFFSET ?")
     , insertPeer(db, "INSERT OR IGNORE INTO `peers` (`ipport`) VALUES (?) ")
     , setlastseen(db, "UPDATE `peers` SET `lastseen`=? WHERE `ipport`=?")
-    , selectRecentPeers(db, "SELECT `ipport`, `lastseen` FROM `peers` ORDER BY `lastseen` DESC LIMIT ?")
+    , selectRecentPeers(db, "SELECT `ipport`, `lastseen`, `successes`, `failures`, `latency` FROM `peers` ORDER BY `lastseen` DESC LIMIT ?")
+    , setPeerStats(db, "UPDATE `peers` SET `successes`=?, `failures`=?, `latency`=? WHERE `ipport`=?")
 
-    , peerinsert(db, "INSERT INTO `bans` (`ip`,`ban_until`,`offense`) VALUES "
+    , peerinsert(db, "INSERT OR IGNORE INTO `bans` (`ip`,`ban_until`,`offense`) VALUES "
                      "(?,0,0)")
     , peerset(db, "UPDATE `bans` SET `ban_until`=?, `offense`=? WHERE `ip`=?")
     , stmtResetBans(db, "UPDATE `bans` SET `ban_until`=0, `offense`=0")
 
     , peerget(db, "SELECT `ban_until`, `offense` FROM `bans` WHERE `ip`=?")
     , peergetBanned(db, "SELECT `ip`,`ban_until`, `offense` FROM `bans` WHERE `ban_until`>?")
-    , connectset(db, "INSERT INTO `connection_log` (`peer`,`begin`) VALUES "
-                     "(?,?)")
+    , connectset(db, "INSERT INTO `connection_log` (ROWID,`peer`,`begin`) VALUES "
+                     "(?,?,?)")
     , disconnectset(db, "UPDATE `connection_log` SET `end`=?, `code`=? WHERE ROWID=?")
     , refuseinsert(db, "INSERT INTO `refuse_log` (`peer`,`timestamp`) VALUES (?,?)")
+    , banRangeSet(db, "INSERT OR REPLACE INTO `ban_ranges` (`ip`,`prefix`,`ban_until`) VALUES (?,?,?)")
+    , banRangeGet(db, "SELECT `ip`,`prefix`,`ban_until` FROM `ban_ranges` WHERE `ban_until`>?")
+    // rows are appended in time order, delete the prefix by ROWID
+    , pruneConnections(db, "DELETE FROM `connection_log` WHERE ROWID < "
+                           "(SELECT ROWID FROM `connection_log` WHERE `begin`>=? ORDER BY ROWID LIMIT 1)")
+    , pruneRefused(db, "DELETE FROM `refuse_log` WHERE ROWID < "
+                       "(SELECT ROWID FROM `refuse_log` WHERE `timestamp`>=? ORDER BY ROWID LIMIT 1)")
+{
+}
+
+std::vector<PeerDB::BanRange> PeerDB::get_banned_ranges()
+{
+    std::vector<BanRange> res;
+    banRangeGet.bind(1, now_timestamp());
+    while (banRangeGet.executeStep()) {
+        res.push_back({ .net { uint32_t(banRangeGet.getColumn(0).getInt64()) },
+            .prefix = uint8_t(banRangeGet.getColumn(1).getInt()),
+            .banuntil = uint32_t(banRangeGet.getColumn(2).getInt64()) });
+    }
+    banRangeGet.reset();
+    return res;
+}
+
+int64_t PeerDB::max_connect_rowid()
+{
+    return db.execAndGet("SELECT COALESCE(MAX(ROWID),0) FROM `connection_log`").getInt64();
+}
+
+void PeerDB::prune_logs(uint32_t before)
 {
+    pruneConnections.bind(1, before);
+    pruneConnections.exec();
+    pruneConnections.reset();
+    pruneRefused.bind(1, before);
+    pruneRefused.exec();
+    pruneRefused.reset();
 }
 
-std::vector<std::pair<EndpointAddress, uint32_t>> PeerDB::recent_peers(int64_t maxEntries)
+auto PeerDB::recent_peers(int64_t maxEntries) -> std::vector<RecentPeer>
 {
-    std::vector<std::pair<EndpointAddress, uint32_t>> out;
+    std::vector<RecentPeer> out;
     selectRecentPeers.bind(1, maxEntries);
     while (selectRecentPeers.executeStep()) {
         int64_t id = selectRecentPeers.getColumn(0).getInt64();
         uint32_t timestamp = selectRecentPeers.getColumn(1).getInt64();
-        out.push_back({ EndpointAddress::from_sql_id(id), timestamp });
+        PeerStats stats {
+            .successes = uint32_t(selectRecentPeers.getColumn(2).getInt64()),
+            .failures = uint32_t(selectRecentPeers.getColumn(3).getInt64()),
+            .latencyMs {}
+        };
+        if (auto c { selectRecentPeers.getColumn(4) }; !c.isNull())
+            stats.latencyMs = uint32_t(c.getInt64());
+        out.push_back({ EndpointAddress::from_sql_id(id), timestamp, stats });
     }
     selectRecentPeers.reset();
     return out;
 };
 
+void PeerDB::set_peer_stats(EndpointAddress a, const PeerStats& s)
+{
+    setPeerStats.bind(1, s.successes);
+    setPeerStats.bind(2, s.failures);
+    if (s.latencyMs)
+        setPeerStats.bind(3, *s.latencyMs);
+    else
+        setPeerStats.bind(3);
+    setPeerStats.bind(4, a.to_sql_id());
+    setPeerStats.exec();
+    setPeerStats.reset();
+}
+
 void PeerDB::peer_seen(EndpointAddress a, uint32_t now)
 {
     setlastseen.bind(1, now);
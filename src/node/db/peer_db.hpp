@@ -5,6 +5,7 @@
 #include "general/tcp_util.hpp"
 #include "general/now.hpp"
 #include "general/errors.hpp"
+#include <optional>
 #include <vector>
 
 class PeerDB {
@@ -21,6 +22,23 @@ class PeerDB {
                 :ip(ip),banuntil(banuntil),offense(offense){};
 
     };
+    struct BanRange {
+        IPv4 net;
+        uint8_t prefix;
+        uint32_t banuntil;
+    };
+    // outbound connect statistics of a peer, restored on startup to rank
+    // the reconnection candidates
+    struct PeerStats {
+        uint32_t successes { 0 };
+        uint32_t failures { 0 };
+        std::optional<uint32_t> latencyMs;
+    };
+    struct RecentPeer {
+        EndpointAddress address;
+        uint32_t lastseen;
+        PeerStats stats;
+    };
     PeerDB(const std::string &path);
     SQLite::Transaction transaction() { return SQLite::Transaction(db); }
     void set_ban(IPv4 ipv4, uint32_t banUntil, int32_t offense) {
@@ -51,6 +69,16 @@ class PeerDB {
         return res;
     }
 
+    void set_ban_range(const BanRange& r)
+    {
+        banRangeSet.bind(1, r.net.data);
+        banRangeSet.bind(2, r.prefix);
+        banRangeSet.bind(3, r.banuntil);
+        banRangeSet.exec();
+        banRangeSet.reset();
+    }
+    std::vector<BanRange> get_banned_ranges();
+
     bool get_peer( IPv4 ipv4, uint32_t& banUntil, int32_t& offense){
         peerget.bind(1,ipv4.data);
         bool found=false;
@@ -63,13 +91,15 @@ class PeerDB {
         return found;
     }
 
-    int64_t insert_connect(uint32_t peer, uint32_t begin)
+    // rowids are assigned by the caller such that inserts can be delayed
+    int64_t max_connect_rowid();
+    void insert_connect(int64_t rowid, uint32_t peer, uint32_t begin)
     {
-        connectset.bind(1,peer);
-        connectset.bind(2,begin);
+        connectset.bind(1,rowid);
+        connectset.bind(2,peer);
+        connectset.bind(3,begin);
         connectset.exec();
         connectset.reset();
-        return db.getLastInsertRowid();
     }
 
     void insert_disconnect(int64_t rowid, uint32_t end, int32_t code){
@@ -111,9 +141,13 @@ class PeerDB {
     void reset_bans(){
         stmtResetBans.exec();
         stmtResetBans.reset();
+        db.exec("DELETE FROM `ban_ranges`");
     }
-    std::vector<std::pair<EndpointAddress,uint32_t>> recent_peers(int64_t maxEntries = 100);
+    // deletes connection_log and refuse_log rows older than timestamp
+    void prune_logs(uint32_t before);
+    std::vector<RecentPeer> recent_peers(int64_t maxEntries = 100);
     void peer_seen(EndpointAddress,uint32_t now);
+    void set_peer_stats(EndpointAddress, const PeerStats&);
     void peer_insert(EndpointAddress);
 
   private:
@@ -126,6 +160,7 @@ class PeerDB {
     SQLite::Statement insertPeer;
     SQLite::Statement setlastseen;
     SQLite::Statement selectRecentPeers;
+    SQLite::Statement setPeerStats;
     SQLite::Statement peerinsert;
     SQLite::Statement peerset;
     SQLite::Statement stmtResetBans;
@@ -134,5 +169,9 @@ class PeerDB {
     SQLite::Statement connectset;
     SQLite::Statement disconnectset;
     SQLite::Statement refuseinsert;
+    SQLite::Statement banRangeSet;
+    SQLite::Statement banRangeGet;
+    SQLite::Statement pruneConnections;
+    SQLite::Statement pruneRefused;
 
 };
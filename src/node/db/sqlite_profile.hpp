@@ -0,0 +1,34 @@
+#pragma once
+#include <optional>
+#include <string_view>
+
+// SQLite tuning profiles for the chain database
+enum class SQLiteProfile {
+    Sync, // fast initial sync, no fsync (switched to Durable once synced)
+    Balanced, // WAL with synchronous=NORMAL
+    Durable // WAL with synchronous=FULL
+};
+
+inline std::optional<SQLiteProfile> parse_sqlite_profile(std::string_view s)
+{
+    if (s == "sync")
+        return SQLiteProfile::Sync;
+    if (s == "balanced")
+        return SQLiteProfile::Balanced;
+    if (s == "durable")
+        return SQLiteProfile::Durable;
+    return {};
+}
+
+inline const char* to_string(SQLiteProfile p)
+{
+    switch (p) {
+    case SQLiteProfile::Sync:
+        return "sync";
+    case SQLiteProfile::Balanced:
+        return "balanced";
+    case SQLiteProfile::Durable:
+        return "durable";
+    }
+    return "";
+}
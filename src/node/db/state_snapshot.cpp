@@ -0,0 +1,332 @@
+#include "block/body/rollback.hpp"
+#include "block/body/view.hpp"
+#include "block/chain/signed_snapshot.hpp"
+#include "block/chain/worksum.hpp"
+#include "block/header/header_impl.hpp"
+#include "chain_db.hpp"
+#include "chainserver/transaction_ids.hpp"
+#include "crypto/hasher_sha256.hpp"
+#include "general/hex.hpp"
+#include "general/reader.hpp"
+#include "general/writer.hpp"
+#include "spdlog/spdlog.h"
+#include <fstream>
+#include <map>
+
+// State snapshot file layout (integers big endian):
+//
+//   "WARTSNAP", uint32 version
+//   signed snapshot (SignedSnapshot::binary_size bytes), its height h
+//   h headers, h pairs of uint64 (history cursor, account cursor)
+//   uint64 n, n times (20 byte address, uint64 balance) for account ids 1..n
+//   32 byte state commitment of these accounts (since version 2)
+//   uint32 lower, for heights lower..h: uint32 length, body, uint32 length, undo
+//   uint64 n, n times (uint64 id, 32 byte hash, uint32 length, data)
+//   uint64 n, n times (uint64 account id, uint64 history id)
+//   sha256 of all preceding bytes
+namespace {
+constexpr std::array<uint8_t, 8> magic { 'W', 'A', 'R', 'T', 'S', 'N', 'A', 'P' };
+constexpr uint32_t version { 2 };
+constexpr size_t maxChunk { 1 << 26 }; // sanity bound for length prefixed data
+
+class SnapshotOut {
+public:
+    SnapshotOut(const std::string& path)
+        : f(path, std::ios::binary | std::ios::trunc)
+    {
+        if (!f)
+            throw std::runtime_error("Cannot open " + path);
+    }
+    void write(const uint8_t* p, size_t n)
+    {
+        f.write(reinterpret_cast<const char*>(p), n);
+        std::move(hasher).write(p, n);
+    }
+    template <typename T>
+    SnapshotOut& operator<<(T v)
+    {
+        std::array<uint8_t, sizeof(T)> a;
+        Writer(a.data(), a.size()) << v;
+        write(a.data(), a.size());
+        return *this;
+    }
+    template <size_t N>
+    SnapshotOut& operator<<(const std::array<uint8_t, N>& a)
+    {
+        write(a.data(), N);
+        return *this;
+    }
+    SnapshotOut& operator<<(const std::vector<uint8_t>& v)
+    {
+        *this << uint32_t(v.size());
+        write(v.data(), v.size());
+        return *this;
+    }
+    void finish()
+    {
+        Hash h { std::move(hasher) };
+        f.write(reinterpret_cast<const char*>(h.data()), h.size());
+        if (!f.flush())
+            throw std::runtime_error("Cannot write state snapshot");
+    }
+
+private:
+    std::ofstream f;
+    HasherSHA256 hasher;
+};
+
+class SnapshotIn {
+public:
+    SnapshotIn(const std::string& path)
+        : f(path, std::ios::binary)
+    {
+        if (!f)
+            throw std::runtime_error("Cannot open " + path);
+    }
+    void read(uint8_t* p, size_t n)
+    {
+        if (!f.read(reinterpret_cast<char*>(p), n))
+            throw std::runtime_error("State snapshot truncated");
+        std::move(hasher).write(p, n);
+    }
+    template <size_t N>
+    std::array<uint8_t, N> array()
+    {
+        std::array<uint8_t, N> a;
+        read(a.data(), N);
+        return a;
+    }
+    uint32_t uint32() { return Reader(array<4>()).uint32(); }
+    uint64_t uint64() { return Reader(array<8>()).uint64(); }
+    std::vector<uint8_t> vector()
+    {
+        const size_t n { uint32() };
+        if (n > maxChunk)
+            throw std::runtime_error("State snapshot corrupted");
+        std::vector<uint8_t> v(n);
+        read(v.data(), n);
+        return v;
+    }
+    void finish()
+    {
+        Hash expected { std::move(hasher) };
+        Hash h;
+        if (!f.read(reinterpret_cast<char*>(h.data()), h.size()) || h != expected)
+            throw std::runtime_error("State snapshot checksum mismatch");
+    }
+
+private:
+    std::ifstream f;
+    HasherSHA256 hasher;
+};
+}
+
+void ChainDB::export_state_snapshot(const std::string& path, bool pruneHistory) const
+{
+    auto ss { get_signed_snapshot() };
+    if (!ss)
+        throw std::runtime_error("Cannot export state snapshot, there is no signed snapshot");
+    const NonzeroHeight h { ss->height() };
+
+    auto [consensus, historyHeights, accountHeights] { getConsensusHeaders() };
+    std::vector<uint8_t> headers;
+    for (auto& b : consensus.batches)
+        headers.insert(headers.end(), b.raw().begin(), b.raw().end());
+    const Height length { uint32_t(headers.size() / 80) };
+    if (length < h || Header(HeaderView(headers.data() + (h.value() - 1) * 80)).hash() != ss->hash)
+        throw std::runtime_error("Cannot export state snapshot, signed snapshot is not on the consensus chain");
+    headers.resize(h.value() * 80);
+
+    std::vector<std::pair<HistoryId, AccountId>> cursors;
+    stmtConsensusCursors.for_each([&](Statement2::Row& r) {
+        cursors.push_back({ r.get<HistoryId>(1), r.get<AccountId>(2) });
+    });
+    assert(cursors.size() == length.value());
+    auto cursor { [&](Height height) { return cursors[height.value() - 1]; } };
+
+    // the chain may have grown beyond the signed snapshot
+    const bool atTip { h == length };
+    const HistoryId historyEnd { atTip ? next_history_id() : cursor(h + 1).first };
+    const AccountId accountEnd { atTip ? next_state_id() : cursor(h + 1).second };
+
+    // balances at height h from the undo data of later blocks
+    std::map<AccountId, Funds> oldBalances;
+    if (!atTip) {
+        const auto ids { consensus_block_ids(h + 1, length + 1) };
+        for (auto id : ids) {
+            auto u { get_block_undo(id) };
+            if (!u)
+                throw std::runtime_error("Database corrupted (could not load block)");
+            RollbackView rbv(std::get<2>(*u));
+            for (size_t j = 0; j < rbv.nAccounts(); ++j) {
+                auto entry { rbv.accountBalance(j) };
+                if (entry.id() < accountEnd)
+                    oldBalances.try_emplace(entry.id(), entry.balance());
+            }
+        }
+    }
+
+    SnapshotOut out(path);
+    out << magic << version;
+    std::array<uint8_t, SignedSnapshot::binary_size> ssBytes;
+    Writer w(ssBytes.data(), ssBytes.size());
+    w << *ss;
+    out << ssBytes << h.value();
+    out.write(headers.data(), headers.size());
+    for (Height i { 1 }; i <= h; i = i + 1)
+        out << cursor(i).first.value() << cursor(i).second.value();
+
+    out << uint64_t(accountEnd.value() - 1);
+    chainserver::StateCommitment commitment;
+    uint64_t expectedId { 1 };
+    stmtStateExport.for_each([&](Statement2::Row& r) {
+        const AccountId id { r.get<AccountId>(0) };
+        if (id.value() != expectedId++)
+            throw std::runtime_error("Database corrupted, account ids not consecutive");
+        Funds balance { r.get<Funds>(2) };
+        if (auto iter { oldBalances.find(id) }; iter != oldBalances.end())
+            balance = iter->second;
+        const auto address { r.get_array<20>(1) };
+        commitment.add(id, AddressView(address.data()), balance);
+        out << address << balance.E8();
+    },
+        accountEnd);
+    if (expectedId != accountEnd.value())
+        throw std::runtime_error("Database corrupted, accounts missing");
+    if (auto stored { get_state_commitment(h) }; stored && *stored != commitment)
+        throw std::runtime_error("Database corrupted, state commitment mismatch at height " + std::to_string(h.value()));
+    out << std::array<uint8_t, 32>(commitment.hash());
+
+    // full blocks of the transaction id window
+    const Height lower { chainserver::TransactionIds::block_range(h).first };
+    const auto ids { consensus_block_ids(lower, h + 1) };
+    out << lower.value();
+    for (auto id : ids) {
+        auto u { get_block_undo(id) };
+        if (!u)
+            throw std::runtime_error("Database corrupted (could not load block)");
+        out << std::vector<uint8_t>(std::get<1>(*u)) << std::vector<uint8_t>(std::get<2>(*u));
+    }
+
+    const HistoryId historyBegin { pruneHistory ? cursor(lower).first : HistoryId(uint64_t(1)) };
+    out << uint64_t(historyEnd.value() - historyBegin.value());
+    stmtHistoryExport.for_each([&](Statement2::Row& r) {
+        out << r.get<uint64_t>(0) << r.get_array<32>(1) << r.get_vector(2);
+    },
+        historyBegin, historyEnd);
+    std::vector<std::pair<uint64_t, uint64_t>> accountHistory;
+    stmtAccountHistoryExport.for_each([&](Statement2::Row& r) {
+        accountHistory.push_back({ r.get<uint64_t>(0), r.get<uint64_t>(1) });
+    },
+        historyBegin, historyEnd);
+    out << uint64_t(accountHistory.size());
+    for (auto& [a, hid] : accountHistory)
+        out << a << hid;
+    out.finish();
+    spdlog::info("Exported state snapshot at height {} ({} accounts, {} history entries, state commitment {})",
+        h.value(), accountEnd.value() - 1, historyEnd.value() - historyBegin.value(), serialize_hex(commitment.hash()));
+}
+
+void ChainDB::import_state_snapshot(const std::string& path)
+{
+    if (auto head { stmtConsensusHead.one() }; head.has_value() && head.get<int64_t>(0) > 0)
+        throw std::runtime_error("Cannot import state snapshot, chain database is not empty");
+
+    SnapshotIn in(path);
+    if (in.array<8>() != magic)
+        throw std::runtime_error("Not a state snapshot");
+    const uint32_t fileVersion { in.uint32() };
+    if (fileVersion != 1 && fileVersion != version)
+        throw std::runtime_error("Not a state snapshot of a supported version");
+    auto ssBytes { in.array<SignedSnapshot::binary_size>() };
+    Reader r(ssBytes);
+    const SignedSnapshot ss(r); // throws if not signed by a leader
+    if (in.uint32() != ss.height().value())
+        throw std::runtime_error("State snapshot corrupted");
+    const NonzeroHeight h { ss.height() };
+
+    // headers must link up to the signed hash
+    std::vector<Batch> batches;
+    Worksum work;
+    std::optional<Hash> prev;
+    for (Height i { 0 }; i < h;) {
+        const size_t n { std::min<size_t>(HEADERBATCHSIZE, h - i) };
+        std::vector<uint8_t> bytes(n * 80);
+        in.read(bytes.data(), bytes.size());
+        Batch b(std::move(bytes));
+        if (!b.valid_inner_links() || (prev && b.first().prevhash() != *prev))
+            throw std::runtime_error("State snapshot headers do not form a chain");
+        prev = b.last().hash();
+        work += b.worksum(i);
+        i = i + n;
+        batches.push_back(std::move(b));
+    }
+    if (*prev != ss.hash)
+        throw std::runtime_error("State snapshot headers do not match the signed snapshot");
+    auto header { [&](Height height) {
+        return batches[(height.value() - 1) / HEADERBATCHSIZE][(height.value() - 1) % HEADERBATCHSIZE];
+    } };
+
+    auto t { transaction() };
+    std::vector<std::pair<HistoryId, AccountId>> cursors;
+    cursors.reserve(h.value());
+    for (Height i { 1 }; i <= h; i = i + 1)
+        cursors.push_back({ HistoryId(in.uint64()), AccountId(in.uint64()) });
+
+    // verified in the same pass, the import does not replay any blocks
+    const uint64_t nAccounts { in.uint64() };
+    chainserver::StateCommitment commitment;
+    for (uint64_t i = 1; i <= nAccounts; ++i) {
+        auto address { in.array<20>() };
+        const Funds balance { Funds(in.uint64()) };
+        commitment.add(AccountId(i), AddressView(address.data()), balance);
+        stmtStateInsert.run(AccountId(i), address, balance);
+    }
+    if (fileVersion >= 2 && chainserver::StateCommitment(Hash(in.array<32>())) != commitment)
+        throw std::runtime_error("State snapshot accounts do not match the state commitment");
+
+    const Height lower { in.uint32() };
+    if (lower == 0 || lower > h + 1)
+        throw std::runtime_error("State snapshot corrupted");
+    for (Height i { 1 }; i <= h; i = i + 1) {
+        const NonzeroHeight height { i.nonzero_assert() };
+        const HeaderView hv { header(height) };
+        if (i < lower) {
+            // header only, bodies of old blocks are not part of the snapshot
+            stmtBlockInsertPruned.run(height, hv, hv.hash());
+        } else {
+            std::vector<uint8_t> body { in.vector() };
+            BodyView bv(body);
+            if (!bv.valid() || bv.merkleRoot(height) != hv.merkleroot())
+                throw std::runtime_error("State snapshot block body at height " + std::to_string(height.value()) + " does not match its header");
+            stmtBlockInsert.run(height, hv, body, hv.hash());
+        }
+        const BlockId blockId { db.getLastInsertRowid() };
+        if (i >= lower)
+            set_block_undo(blockId, in.vector());
+        auto& [historyCursor, accountCursor] { cursors[i.value() - 1] };
+        stmtConsensusInsert.run(height, blockId, historyCursor, accountCursor);
+    }
+    insert_state_commitment(h, commitment);
+
+    const uint64_t nHistory { in.uint64() };
+    for (uint64_t i = 0; i < nHistory; ++i) {
+        const uint64_t id { in.uint64() };
+        auto hash { in.array<32>() };
+        stmtHistoryInsert.run(id, hash, in.vector());
+    }
+    const uint64_t nAccountHistory { in.uint64() };
+    for (uint64_t i = 0; i < nAccountHistory; ++i) {
+        const uint64_t accountId { in.uint64() };
+        stmtAccountHistoryInsert.run(accountId, in.uint64());
+    }
+    in.finish();
+
+    set_consensus_work(work);
+    set_signed_snapshot(ss);
+    stmtConsensusSetProperty.run(PRUNEDID, lower - 1);
+    t.commit();
+    cache = Cache::init(db);
+    spdlog::info("Imported state snapshot at height {} ({} accounts, {} history entries, state commitment {})",
+        h.value(), nAccounts, nHistory, serialize_hex(commitment.hash()));
+}
@@ -41,18 +41,26 @@ std::pair<int32_t, Conref> AddressManager::insert(Connection* c, HeaderDownload:
     if (cr->c->inbound)
         queue_verification(cr->c->peer_endpoint());
     else {
+        std::optional<milliseconds> latency;
+        if (auto iter = pendingOutgoing.find(a); iter != pendingOutgoing.end())
+            latency = duration_cast<milliseconds>(sc::now() - iter->second);
         just_verified(a, false);
 
         // set "connected" flag in verified list
         if (auto iter = verified.find(a); iter != verified.end()) {
-            iter->second.outboundConnection = true;
+            auto& v { iter->second };
+            v.outboundConnection = true;
+            v.successes += 1;
+            if (latency)
+                v.latency = v.latency ? (3 * *v.latency + *latency) / 4 : *latency;
+            save_stats(a, v);
         }
     }
 
     // adjust pinned entry
     auto iter = pinned.find(a);
     if (iter != pinned.end()) {
-        remove_timer(iter);
+        remove_timer(iter->second.timer);
         iter->second.sleepSeconds = 0;
     }
     assert(byEndpoint.try_emplace(a, p.first).second);
@@ -75,16 +83,15 @@ bool AddressManager::erase(Conndatamap::iterator iter)
         iter->second.outboundConnection = false;
         if (outbound) {
             iter->second.lastVerified = sc::now();
-            set_timer(sc::now() + successSleep, iter);
+            set_timer(sc::now() + successSleep, a, iter->second.timer, false);
         }
     }
 
     if (auto iter = pinned.find(a); iter != pinned.end()) {
         auto& pinState = iter->second;
         auto expires = std::max(sc::now() + seconds(pinState.sleepSeconds), iter->second.ratelimit_sleep());
-        auto timer_iter = timer.emplace(expires, iter);
-        assert(pinState.timer_iter == timer.end());
-        pinState.timer_iter = timer_iter;
+        assert(!pinState.timer.active());
+        set_timer(expires, a, pinState.timer, true);
         return true;
     }
     return false;
@@ -98,20 +105,87 @@ void AddressManager::garbage_collect()
     delayedDelete.clear();
 }
 
-void AddressManager::remove_timer(decltype(pinned)::iterator iter)
+double AddressManager::VerifiedState::score() const
 {
-    auto& timer_iter = iter->second.timer_iter;
-    if (timer_iter == timer.end())
-        return;
-    timer.erase(timer_iter);
-    timer_iter = timer.end();
+    // success rate with a uniform prior, discounted by connect latency
+    const double rate { (successes + 1.0) / (successes + failures + 2.0) };
+    const double ms { latency ? double(latency->count()) : 500.0 };
+    return rate / (1.0 + ms / 1000.0);
+}
+
+void AddressManager::save_stats(EndpointAddress a, const VerifiedState& v)
+{
+    peerServer.async_peer_stats(a, { .successes = v.successes, .failures = v.failures, .latencyMs { v.latency ? std::optional<uint32_t>(v.latency->count()) : std::nullopt } });
+}
+
+const AddressManager::TimerState* AddressManager::timer_state(const TimerEntry& e) const
+{
+    if (e.pin) {
+        auto iter = pinned.find(e.address);
+        return iter == pinned.end() ? nullptr : &iter->second.timer;
+    }
+    auto iter = verified.find(e.address);
+    return iter == verified.end() ? nullptr : &iter->second.timer;
+}
+
+bool AddressManager::active(const TimerEntry& e) const
+{
+    auto s { timer_state(e) };
+    return s && s->active() && s->generation == e.generation;
+}
+
+void AddressManager::set_timer(sc::time_point expires, EndpointAddress a, TimerState& s, bool pin)
+{
+    s.expires = expires;
+    s.generation = ++timerGeneration;
+    timer.push_back({ expires, a, pin, s.generation });
+    std::push_heap(timer.begin(), timer.end(), std::greater<>());
+    if (timer.size() > 64 + 4 * (verified.size() + pinned.size()))
+        compact_timers();
+}
+
+void AddressManager::remove_timer(TimerState& s)
+{
+    s.expires.reset(); // heap entry becomes stale
+}
+
+void AddressManager::compact_timers()
+{
+    std::erase_if(timer, [&](const TimerEntry& e) { return !active(e); });
+    std::make_heap(timer.begin(), timer.end(), std::greater<>());
+}
+
+size_t AddressManager::ConnectRate::available(sc::time_point now)
+{
+    tokens = std::min(burst, tokens + duration<double>(now - updated).count() * perSecond);
+    updated = now;
+    return size_t(tokens);
+}
+
+auto AddressManager::ConnectRate::next_token() const -> sc::time_point
+{
+    if (tokens >= 1)
+        return updated;
+    return updated + duration_cast<sc::duration>(duration<double>((1 - tokens) / perSecond));
 }
 
 std::optional<std::chrono::steady_clock::time_point> AddressManager::wakeup_time()
 {
-    if (timer.empty())
+    while (!timer.empty() && !active(timer.front())) {
+        std::pop_heap(timer.begin(), timer.end(), std::greater<>());
+        timer.pop_back();
+    }
+    // a completing connect frees a slot and connects again
+    if (pendingOutgoing.size() >= maxPending)
         return {};
-    return timer.begin()->first;
+    std::optional<sc::time_point> t;
+    if (!timer.empty())
+        t = timer.front().expires;
+    if (!unverifiedAddresses.empty())
+        t = sc::now();
+    if (!t)
+        return {};
+    return std::max(*t, connectRate.next_token());
 }
 
 std::vector<EndpointAddress> AddressManager::sample_verified(size_t N)
@@ -137,8 +211,7 @@ bool AddressManager::pin(EndpointAddress a)
     auto p = pinned.try_emplace(a);
     if (!p.second)
         return false;
-    auto iter = timer.emplace(sc::now(), p.first);
-    p.first->second.timer_iter = iter;
+    set_timer(sc::now(), a, p.first->second.timer, true);
     return true;
 }
 
@@ -147,11 +220,7 @@ bool AddressManager::unpin(EndpointAddress a)
     auto iter = pinned.find(a);
     if (iter == pinned.end())
         return false;
-    auto& t = iter->second.timer_iter;
-    if (t != timer.end()) {
-        timer.erase(t);
-    }
-    pinned.erase(iter);
+    pinned.erase(iter); // heap entry becomes stale
     return true;
 }
 
@@ -185,20 +254,26 @@ AddressManager::AddressManager(PeerServer& peerServer, const std::vector<Endpoin
     , ownIps(interface_ips_v4())
 {
     // get recently seen peers from db
-    std::promise<std::vector<std::pair<EndpointAddress, uint32_t>>> p;
+    std::promise<std::vector<PeerDB::RecentPeer>> p;
     auto future { p.get_future() };
-    auto cb = [&p](std::vector<std::pair<EndpointAddress, uint32_t>>&& v) {
+    auto cb = [&p](std::vector<PeerDB::RecentPeer>&& v) {
         p.set_value(std::move(v));
     };
     peerServer.async_get_recent_peers(std::move(cb), maxRecent);
     auto db_peers = future.get();
     int64_t nowts = now_timestamp();
-    for (const auto& [a, timestamp] : db_peers) {
-        auto p = verified.try_emplace(a, timer.end());
+    // all are due at once, pop_connect ranks them by their restored
+    // statistics such that the best peers are connected first
+    for (const auto& [a, timestamp, stats] : db_peers) {
+        auto p = verified.try_emplace(a);
         assert(p.second);
-        set_timer(sc::now(), p.first);
+        set_timer(sc::now(), a, p.first->second.timer, false);
         auto& node = p.first->second;
         node.lastVerified = sc::now() - seconds((nowts - int64_t(timestamp)));
+        node.successes = stats.successes;
+        node.failures = stats.failures;
+        if (stats.latencyMs)
+            node.latency = milliseconds(*stats.latencyMs);
     }
 
     // pin
@@ -219,47 +294,57 @@ bool AddressManager::on_failed_outbound(EndpointAddress a)
 
     // verified addresses bookkeeping
     if (auto iter = verified.find(a); iter != verified.end()) {
-        set_timer(sc::now() + failedSleep, iter);
+        iter->second.failures += 1;
+        save_stats(a, iter->second);
+        set_timer(sc::now() + failedSleep, a, iter->second.timer, false);
     }
 
     // pinned bookkeeping
     if (auto iter = pinned.find(a); iter != pinned.end()) {
         auto& cs = iter->second;
-        auto timer_iter = timer.emplace(sc::now() + seconds(cs.sleepSeconds), iter);
-        remove_timer(iter);
-        cs.timer_iter = timer_iter;
+        set_timer(sc::now() + seconds(cs.sleepSeconds), a, cs.timer, true);
         cs.sleepSeconds = std::max(cs.sleepSeconds, std::min(2 * (cs.sleepSeconds + 1), size_t(5 * 60ul)));
         return true;
     }
     return false;
 }
 
-std::vector<EndpointAddress> AddressManager::pop_connect()
+std::vector<EndpointAddress> AddressManager::pop_connect(size_t limit)
 {
     auto now = sc::now();
     std::vector<EndpointAddress> out;
+    limit = std::min(limit, connectRate.available(now));
+    auto slots = [&]() {
+        return std::min(limit - out.size(), maxPending - std::min(maxPending, pendingOutgoing.size()));
+    };
 
-    while (pendingOutgoing.size() < maxPending) {
-        if (timer.size() > 0 && timer.begin()->first < now) {
-            auto& v = timer.begin()->second;
-            if (std::holds_alternative<VerIter>(v)) {
-                auto iter = std::get<VerIter>(v);
-                remove_timer(iter);
-                const EndpointAddress& a = iter->first;
-                if (pendingOutgoing.contains(a))
-                    continue;
-                out.push_back(a);
-                pendingOutgoing.try_emplace(a, now);
-            } else if (std::holds_alternative<PinIter>(v)) {
-                auto iter = std::get<PinIter>(v);
-                remove_timer(iter);
-                const EndpointAddress& a = iter->first;
-                if (pendingOutgoing.contains(a))
-                    continue;
-                out.push_back(a);
-                pendingOutgoing.try_emplace(a, now);
-            }
-        } else if (unverifiedAddresses.size() > 0) {
+    // rank all due timers, pins first
+    struct Candidate {
+        double score;
+        const TimerEntry* e;
+    };
+    std::vector<Candidate> due;
+    for (auto& e : timer) {
+        if (e.expires >= now || !active(e))
+            continue;
+        double score { std::numeric_limits<double>::infinity() };
+        if (!e.pin)
+            score = verified.find(e.address)->second.score();
+        due.push_back({ score, &e });
+    }
+    const size_t n { std::min(due.size(), slots()) };
+    std::partial_sort(due.begin(), due.begin() + n, due.end(),
+        [](const Candidate& c1, const Candidate& c2) { return c1.score > c2.score; });
+    for (size_t i = 0; i < due.size() && out.size() < n; ++i) {
+        const TimerEntry& e { *due[i].e };
+        const EndpointAddress a { e.address };
+        remove_timer(e.pin ? pinned.find(a)->second.timer : verified.find(a)->second.timer);
+        if (pendingOutgoing.try_emplace(a, now).second)
+            out.push_back(a);
+    }
+
+    while (slots() > 0) {
+        if (unverifiedAddresses.size() > 0) {
             auto& a = *unverifiedAddresses.begin();
             if (!failedAddresses.contains(a) && !verified.contains(a)) {
                 if (pendingOutgoing.emplace(a, now).second)
@@ -270,6 +355,7 @@ std::vector<EndpointAddress> AddressManager::pop_connect()
             break;
     }
 
+    connectRate.tokens -= out.size();
     return out;
 }
 bool AddressManager::is_own_endpoint(EndpointAddress a)
@@ -299,7 +385,9 @@ void AddressManager::queue_verification(const std::vector<EndpointAddress>& as)
 {
     spdlog::debug("Queueing {} unverified addresses. BEFORE: {}", as.size(), unverifiedAddresses.size());
     for (auto& a : as) {
-        insert_unverified(a);
+        // every peer gossips the same addresses, only look up new ones
+        if (recentAddresses.insert_new(a))
+            insert_unverified(a);
     }
 }
 
@@ -311,9 +399,9 @@ void AddressManager::just_verified(EndpointAddress a, bool setTimer)
     spdlog::debug("DB seen peer {}", a.to_string());
 
     auto now = sc::now();
-    auto p = verified.try_emplace(a, timer.end());
+    auto p = verified.try_emplace(a);
     if (setTimer) {
-        set_timer(now + successSleep, p.first);
+        set_timer(now + successSleep, a, p.first->second.timer, false);
     }
     p.first->second.lastVerified = now;
     if (p.second)
@@ -336,25 +424,8 @@ void AddressManager::check_prune_verified()
         assert(verifiedPruneTo <= verifiedPruneAt);
         const size_t N = verified.size() - verifiedPruneTo;
         for (size_t i = 0; i < N; ++i) {
-            remove_timer(v[i]);
-            verified.erase(v[i]);
+            verified.erase(v[i]); // heap entry becomes stale
         }
     }
 }
-
-void AddressManager::remove_timer(decltype(verified)::iterator iter)
-{
-    auto& timer_iter = iter->second.timer_iter;
-    if (timer_iter == timer.end())
-        return;
-    timer.erase(timer_iter);
-    timer_iter = timer.end();
-}
-
-void AddressManager::set_timer(sc::time_point expires, decltype(verified)::iterator iter)
-{
-    remove_timer(iter);
-    auto timer_iter = timer.emplace(expires, iter);
-    iter->second.timer_iter = timer_iter;
-}
 }
@@ -1,10 +1,14 @@
 #pragma once
 #include "../types/conndata.hpp"
 #include "flat_address_set.hpp"
+#include "rolling_filter.hpp"
 #include "general/tcp_util.hpp"
 #include <chrono>
+#include <limits>
 #include <map>
+#include <optional>
 #include <set>
+#include <unordered_map>
 #include <vector>
 struct PeerServer;
 class Conref;
@@ -15,6 +19,13 @@ namespace address_manager {
 
 struct AddressManager;
 
+struct EndpointHash {
+    size_t operator()(const EndpointAddress& a) const
+    {
+        return std::hash<uint64_t> {}((uint64_t(a.ipv4.data) << 16) | a.port);
+    }
+};
+
 struct AddressManager {
     friend struct ::Inspector;
 
@@ -23,24 +34,40 @@ private:
     struct PinState;
 
     using sc = std::chrono::steady_clock;
-    using VerifiedMap = std::map<EndpointAddress, VerifiedState>;
+    using VerifiedMap = std::unordered_map<EndpointAddress, VerifiedState, EndpointHash>;
     using VerIter = VerifiedMap::iterator;
-    using PinnedMap = std::map<EndpointAddress, PinState>;
+    using PinnedMap = std::unordered_map<EndpointAddress, PinState, EndpointHash>;
     using PinIter = PinnedMap::iterator;
-    using PendingMap = std::map<EndpointAddress, sc::time_point>;
-    using TimerVal = std::variant<VerIter, PinIter>;
-    using TimerType = std::multimap<sc::time_point, TimerVal>;
+    using PendingMap = std::unordered_map<EndpointAddress, sc::time_point, EndpointHash>;
 
     //////////////////////////////
     // struct definitions
+
+    // Connect timers of verified and pinned addresses share one min-heap.
+    // Entries are invalidated lazily: an entry is active if its address
+    // still has a timer with the same generation. Generations are unique
+    // across entries.
+    struct TimerState {
+        bool active() const { return expires.has_value(); }
+        std::optional<sc::time_point> expires;
+        uint32_t generation { 0 };
+    };
+    struct TimerEntry {
+        sc::time_point expires;
+        EndpointAddress address;
+        bool pin;
+        uint32_t generation;
+        bool operator>(const TimerEntry& e) const { return expires > e.expires; }
+    };
     struct VerifiedState {
-        VerifiedState(TimerType::iterator end)
-            : timer_iter(end)
-        {
-        }
-        TimerType::iterator timer_iter;
+        TimerState timer;
         std::chrono::steady_clock::time_point lastVerified;
         bool outboundConnection = false;
+        // outbound connect statistics for candidate selection
+        uint32_t successes { 0 };
+        uint32_t failures { 0 };
+        std::optional<std::chrono::milliseconds> latency; // moving average
+        double score() const;
     };
     struct PinState {
         PinState()
@@ -63,7 +90,17 @@ private:
                 return now;
             return now + (rateLimit - a);
         }
-        TimerType::iterator timer_iter;
+        TimerState timer;
+    };
+    // global outbound connect rate, a token bucket allowing bursts of
+    // maxPending connects after boot
+    struct ConnectRate {
+        static constexpr double perSecond = 10;
+        static constexpr double burst = 20;
+        double tokens { burst };
+        sc::time_point updated { sc::now() };
+        size_t available(sc::time_point now); // refills
+        sc::time_point next_token() const;
     };
     class ConrefIter : public Coniter {
     public:
@@ -164,8 +201,11 @@ public:
     // callbacks
     [[nodiscard]] bool on_failed_outbound(EndpointAddress); // returns whether is pinned
 
-    // access queued
-    std::vector<EndpointAddress> pop_connect();
+    // access queued, returns up to limit addresses to connect to, due pins
+    // first, then due verified addresses by past success and latency. At
+    // most maxPending connects are pending at once, new ones are subject
+    // to the global connect rate.
+    std::vector<EndpointAddress> pop_connect(size_t limit = std::numeric_limits<size_t>::max());
     void queue_verification(const std::vector<EndpointAddress>&);
 
     // pin control
@@ -181,9 +221,12 @@ private:
     void queue_verification(EndpointAddress);
     void check_prune_verified();
     void just_verified(EndpointAddress, bool setTimer);
-    void remove_timer(VerIter);
-    void set_timer(sc::time_point, VerIter);
-    void remove_timer(PinIter);
+    void set_timer(sc::time_point, EndpointAddress, TimerState&, bool pin);
+    void remove_timer(TimerState&);
+    const TimerState* timer_state(const TimerEntry&) const;
+    void save_stats(EndpointAddress, const VerifiedState&); // persisted in the peers db
+    bool active(const TimerEntry& e) const;
+    void compact_timers();
     void insert_unverified(EndpointAddress a);
     bool is_own_endpoint(EndpointAddress a);
 
@@ -191,12 +234,14 @@ private:
     // data
     PeerServer& peerServer;
     size_t maxPending = 20;
+    ConnectRate connectRate;
     size_t maxRecent = 100;
     size_t verifiedPruneAt = 200;
     size_t verifiedPruneTo = 100;
     const std::vector<IPv4> ownIps;
 
     FlatAddressSet failedAddresses;
+    RollingAddressFilter recentAddresses { 2048 }; // gossiped by peers
 
     // maps/sets by EndpointAddress
     std::set<EndpointAddress> unverifiedAddresses;
@@ -208,7 +253,8 @@ private:
     std::optional<sc::time_point> cacheExpire;
 
     // Timer
-    TimerType timer;
+    std::vector<TimerEntry> timer; // min-heap by expiry
+    uint32_t timerGeneration { 0 };
     PendingMap pendingOutgoing;
     mutable Conndatamap conndatamap;
     std::vector<Conndatamap::iterator> delayedDelete;
@@ -0,0 +1,83 @@
+#include "rolling_filter.hpp"
+#include <algorithm>
+#include <bit>
+#include <random>
+
+namespace address_manager {
+namespace {
+constexpr size_t bitsPerEntry { 16 };
+constexpr size_t nHashes { 4 };
+
+uint64_t mix(uint64_t x)
+{
+    // splitmix64 finalizer
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+}
+
+RollingAddressFilter::RollingAddressFilter(size_t capacity)
+    : capacity(capacity)
+    , salt(std::random_device {}() | (uint64_t(std::random_device {}()) << 32))
+{
+    const size_t words { std::bit_ceil(std::max(capacity * bitsPerEntry / 64, size_t(1))) };
+    current.words.resize(words);
+    previous.words.resize(words);
+}
+
+std::pair<uint64_t, uint64_t> RollingAddressFilter::hashes(EndpointAddress a) const
+{
+    const uint64_t h { mix(uint64_t(a.to_sql_id()) ^ salt) };
+    return { h, mix(h) | 1 };
+}
+
+bool RollingAddressFilter::Generation::contains(uint64_t h1, uint64_t h2) const
+{
+    const size_t mask { words.size() * 64 - 1 };
+    for (size_t i = 0; i < nHashes; ++i) {
+        const size_t bit { (h1 + i * h2) & mask };
+        if ((words[bit / 64] & (uint64_t(1) << (bit % 64))) == 0)
+            return false;
+    }
+    return true;
+}
+
+void RollingAddressFilter::Generation::insert(uint64_t h1, uint64_t h2)
+{
+    const size_t mask { words.size() * 64 - 1 };
+    for (size_t i = 0; i < nHashes; ++i) {
+        const size_t bit { (h1 + i * h2) & mask };
+        words[bit / 64] |= uint64_t(1) << (bit % 64);
+    }
+    inserted += 1;
+}
+
+bool RollingAddressFilter::contains(EndpointAddress a) const
+{
+    auto [h1, h2] { hashes(a) };
+    return current.contains(h1, h2) || previous.contains(h1, h2);
+}
+
+void RollingAddressFilter::insert(EndpointAddress a)
+{
+    auto [h1, h2] { hashes(a) };
+    if (current.contains(h1, h2))
+        return;
+    if (current.inserted >= capacity) {
+        std::swap(current, previous);
+        std::ranges::fill(current.words, 0);
+        current.inserted = 0;
+    }
+    current.insert(h1, h2);
+}
+
+bool RollingAddressFilter::insert_new(EndpointAddress a)
+{
+    const bool known { contains(a) };
+    insert(a); // refreshes addresses of the previous generation
+    return !known;
+}
+}
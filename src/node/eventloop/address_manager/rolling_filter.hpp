@@ -0,0 +1,35 @@
+#pragma once
+#include "general/tcp_util.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace address_manager {
+
+// Rolling Bloom filter of recently seen endpoint addresses. Two generations
+// of `capacity` insertions each are kept, when the current one is full the
+// older one is dropped, so an address is remembered for at least `capacity`
+// later insertions. False positives (about 0.5%) only drop an address from
+// gossip, hashes are salted per filter such that different nodes drop
+// different addresses.
+class RollingAddressFilter {
+public:
+    RollingAddressFilter(size_t capacity);
+    [[nodiscard]] bool contains(EndpointAddress) const;
+    void insert(EndpointAddress);
+    // returns whether the address was not contained, inserts it
+    bool insert_new(EndpointAddress a);
+
+private:
+    struct Generation {
+        std::vector<uint64_t> words;
+        size_t inserted { 0 };
+        bool contains(uint64_t h1, uint64_t h2) const;
+        void insert(uint64_t h1, uint64_t h2);
+    };
+    std::pair<uint64_t, uint64_t> hashes(EndpointAddress) const;
+    const size_t capacity;
+    const uint64_t salt;
+    Generation current;
+    Generation previous;
+};
+}
@@ -2,10 +2,17 @@
 #include "../asyncio/connection.hpp"
 #include "address_manager/address_manager_impl.hpp"
 #include "api/types/all.hpp"
+#include "block/body/view.hpp"
+#include "block/chain/consensus_headers.hpp"
 #include "block/chain/header_chain.hpp"
 #include "block/header/batch.hpp"
+#include "block/header/header_impl.hpp"
 #include "block/header/view.hpp"
 #include "chainserver/server.hpp"
+#include "general/block_latency.hpp"
+#include "general/metrics.hpp"
+#include "general/thread_settings.hpp"
+#include "general/trace.hpp"
 #include "global/globals.hpp"
 #include "mempool/order_key.hpp"
 #include "peerserver/peerserver.hpp"
@@ -22,7 +29,7 @@ Eventloop::Eventloop(PeerServer& ps, ChainServer& cs, const Config& config)
     : stateServer(cs)
     , chains(cs.get_chainstate())
     , mempool(false)
-    , connections(ps, config.peers.connect)
+    , connections(ps, config.node.follow ? std::vector { *config.node.follow } : config.peers.connect)
     // , signedSnapshot(chains.signed_snapshot())
     , headerDownload(chains, consensus().total_work())
     , blockDownload(*this)
@@ -54,12 +61,13 @@ void Eventloop::start_async_loop()
 
 bool Eventloop::defer(Event e)
 {
-    std::unique_lock<std::mutex> l(mutex);
     if (closeReason)
         return false;
-    haswork = true;
-    events.push(std::move(e));
-    cv.notify_one();
+    if (events.push(std::move(e))) {
+        // queue was empty, worker might be sleeping
+        std::unique_lock<std::mutex> l(mutex);
+        cv.notify_one();
+    }
     return true;
 }
 bool Eventloop::async_process(Connection* c)
@@ -69,7 +77,6 @@ bool Eventloop::async_process(Connection* c)
 void Eventloop::async_shutdown(int32_t reason)
 {
     std::unique_lock<std::mutex> l(mutex);
-    haswork = true;
     closeReason = reason;
     cv.notify_one();
 }
@@ -95,6 +102,11 @@ void Eventloop::async_mempool_update(mempool::Log&& s)
     defer(std::move(s));
 }
 
+void Eventloop::async_push_block(const Block& b)
+{
+    defer(OnPushBlock { b });
+}
+
 void Eventloop::api_get_peers(PeersCb&& cb)
 {
     defer(std::move(cb));
@@ -108,9 +120,9 @@ void Eventloop::api_get_hashrate(HashrateCb&& cb)
     defer(std::move(cb));
 }
 
-void Eventloop::api_get_hashrate_chart(NonzeroHeight from, NonzeroHeight to, HashrateChartCb&& cb)
+void Eventloop::api_get_hashrate_chart(NonzeroHeight from, NonzeroHeight to, uint32_t step, HashrateChartCb&& cb)
 {
-    defer(GetHashrateChart { std::move(cb), from, to });
+    defer(GetHashrateChart { std::move(cb), from, to, step });
 }
 
 void Eventloop::async_forward_blockrep(uint64_t conId, std::vector<BodyContainer>&& blocks)
@@ -118,14 +130,26 @@ void Eventloop::async_forward_blockrep(uint64_t conId, std::vector<BodyContainer
     defer(OnForwardBlockrep { conId, std::move(blocks) });
 }
 
+void Eventloop::async_forward_raw_blockrep(uint64_t conId, uint32_t nonce, std::optional<Sndbuffer>&& sb)
+{
+    defer(OnForwardRawBlockrep { conId, nonce, std::move(sb) });
+}
+
+void Eventloop::async_forward_compactrep(uint64_t conId, const std::vector<uint32_t>& prefill, std::vector<BodyContainer>&& blocks)
+{
+    defer(OnForwardBlockrep { conId, std::move(blocks), true, prefill });
+}
+
 bool Eventloop::has_work()
 {
     auto now = std::chrono::steady_clock::now();
-    return haswork || (now > timer.next());
+    return closeReason != 0 || !events.empty() || !receiving.empty() || !syncMessages.empty() || (now > timer.next());
 }
 
 void Eventloop::loop()
 {
+    trace::set_thread_name("eventloop");
+    apply_thread_settings(config().threads.eventloop, "eventloop");
     connect_scheduled();
     while (true) {
         {
@@ -137,7 +161,6 @@ void Eventloop::loop()
                 spdlog::debug("Eventloop wait until {} ms", count);
                 cv.wait_until(ul, until);
             }
-            haswork = false;
         }
         work();
         if (check_shutdown()) {
@@ -146,13 +169,47 @@ void Eventloop::loop()
     }
 }
 
+namespace {
+// Merges the next update into an append such that consecutive appends
+// queued during fast sync are applied once and peers receive a single
+// AppendMsg. Returns false if the next update is no append.
+bool coalesce(chainserver::state_update::StateUpdate& u, chainserver::state_update::StateUpdate& next)
+{
+    using chainserver::state_update::Append;
+    auto a { std::get_if<Append>(&u.chainstateUpdate) };
+    auto b { std::get_if<Append>(&next.chainstateUpdate) };
+    if (!a || !b)
+        return false;
+    auto& ha { a->headerchainAppend };
+    auto& hb { b->headerchainAppend };
+    // the grid of the AppendMsg holds one header per new complete batch
+    constexpr size_t maxGrid { (AppendMsg::maxSize - 4 - 4 - 32) / 80 };
+    if (ha.completeBatches.size() + hb.completeBatches.size() > maxGrid)
+        return false;
+    ha.completeBatches.insert(ha.completeBatches.end(),
+        std::make_move_iterator(hb.completeBatches.begin()),
+        std::make_move_iterator(hb.completeBatches.end()));
+    ha.finalPin = std::move(hb.finalPin);
+    ha.incompleteBatch = std::move(hb.incompleteBatch);
+    if (b->signedSnapshot)
+        a->signedSnapshot = std::move(b->signedSnapshot);
+    u.mempoolUpdate.insert(u.mempoolUpdate.end(),
+        std::make_move_iterator(next.mempoolUpdate.begin()),
+        std::make_move_iterator(next.mempoolUpdate.end()));
+    return true;
+}
+}
+
 void Eventloop::work()
 {
-    decltype(events) tmp;
+    static auto& duration { metrics::histogram("warthog_eventloop_work_seconds",
+        "Duration of an eventloop iteration") };
+    metrics::ScopeTimer st(duration);
+    TRACE_ZONE("eventloop.work");
+    auto tmp { events.pop_all() };
     std::vector<Timer::Event> expired;
     {
         std::unique_lock<std::mutex> l(mutex);
-        std::swap(tmp, events);
         expired = timer.pop_expired();
     }
     // process expired
@@ -163,12 +220,21 @@ void Eventloop::work()
             data);
     }
     while (!tmp.empty()) {
+        Event e { std::move(tmp.front()) };
+        tmp.pop();
+        if (auto u { std::get_if<StateUpdate>(&e) }) {
+            StateUpdate* next;
+            while (!tmp.empty() && (next = std::get_if<StateUpdate>(&tmp.front())) && coalesce(*u, *next))
+                tmp.pop();
+        }
         std::visit([&](auto&& e) {
             handle_event(std::move(e));
         },
-            tmp.front());
-        tmp.pop();
+            std::move(e));
     }
+    receive_messages();
+    process_sync_messages();
+    assign_requests();
     connections.garbage_collect();
     update_sync_state();
 }
@@ -200,6 +266,10 @@ void Eventloop::handle_event(OnRelease&& m)
     bool registered { m.c->eventloop_registered };
     if ((!erased) && registered)
         erase(m.c->dataiter);
+    if (m.c->eventloop_queued)
+        std::erase(receiving, m.c);
+    if (m.c->eventloop_sync_queued > 0)
+        std::erase_if(syncMessages, [&](auto& s) { return s.c == m.c; });
     unref(m.c);
 }
 void Eventloop::handle_event(OnProcessConnection&& m)
@@ -210,7 +280,7 @@ void Eventloop::handle_event(OnProcessConnection&& m)
 void Eventloop::handle_event(StateUpdate&& e)
 {
     // mempool
-    mempool.apply_log(std::move(e.mempoolUpdate));
+    mempool.apply_delta(mempool::Delta(std::move(e.mempoolUpdate)));
 
     // header chain
     std::visit([&](auto&& action) {
@@ -221,8 +291,9 @@ void Eventloop::handle_event(StateUpdate&& e)
 
 void Eventloop::update_chain(Append&& m)
 {
-    const auto msg = chains.update_consensus(std::move(m));
+    const SharedSndbuffer msg { chains.update_consensus(std::move(m)) };
     log_chain_length();
+    block_latency::mark_through(block_latency::Stage::Relayed, consensus().headers().length());
     for (auto c : connections.initialized()) {
         try {
             c->chain.on_consensus_append(chains);
@@ -243,10 +314,11 @@ void Eventloop::update_chain(Fork&& fork)
 {
     auto msg { chains.update_consensus(std::move(fork)) };
     log_chain_length();
+    const SharedSndbuffer sb { msg };
     for (auto c : connections.initialized()) {
         try {
             c->chain.on_consensus_fork(msg.forkHeight, chains);
-            c.send(msg);
+            c.send(sb);
         } catch (ChainError e) {
             close(c, e);
         }
@@ -262,9 +334,10 @@ void Eventloop::update_chain(RollbackData&& rd)
     const auto msg { chains.update_consensus(rd) };
     if (msg) {
         log_chain_length();
+        const SharedSndbuffer sb { *msg };
         for (auto c : connections.initialized()) {
             c->chain.on_consensus_shrink(chains);
-            c.send(*msg);
+            c.send(sb);
         }
     }
     headerDownload.on_signed_snapshot_update();
@@ -321,6 +394,11 @@ void Eventloop::log_chain_length()
         spdlog::info("Synced. (height {}).", synced);
 }
 
+bool Eventloop::log_communication()
+{
+    return config().node.logCommunication && communicationLog.allow();
+}
+
 void Eventloop::handle_event(PeersCb&& cb)
 {
     std::vector<API::Peerinfo> out;
@@ -359,8 +437,25 @@ void Eventloop::handle_event(stage_operation::Result&& r)
 void Eventloop::handle_event(OnForwardBlockrep&& m)
 {
     if (auto cr { connections.find(m.conId) }; cr) {
+        if (m.compact) {
+            std::vector<CompactBody> compact;
+            for (size_t i = 0; i < m.blocks.size(); ++i)
+                compact.push_back({ m.blocks[i].view(), i == 0 ? m.prefill : std::vector<uint32_t> {} });
+            cr.send(CompactrepMsg(cr->lastNonce, std::move(compact)));
+            return;
+        }
         BlockrepMsg msg(cr->lastNonce, std::move(m.blocks));
-        cr.send(msg);
+        send_blockrep(cr, msg);
+    }
+}
+
+void Eventloop::handle_event(OnForwardRawBlockrep&& m)
+{
+    if (auto cr { connections.find(m.conId) }; cr) {
+        if (m.sb)
+            send_blockrep(cr, std::move(*m.sb));
+        else
+            cr.send(BlockrepMsg(m.nonce, {}));
     }
 }
 
@@ -384,7 +479,13 @@ void Eventloop::handle_event(HashrateCb&& cb)
 
 void Eventloop::handle_event(GetHashrateChart&& e)
 {
-    e.cb(consensus().headers().hashrate_chart(e.from, e.to, 100));
+    e.cb(consensus().headers().hashrate_chart(e.from, e.to, 100, e.step));
+}
+
+void Eventloop::handle_event(OnPushBlock&& e)
+{
+    remember_push(e.block.header.hash());
+    push_block(BlockpushMsg(std::move(e.block)), {});
 }
 
 void Eventloop::handle_event(OnPinAddress&& e)
@@ -399,46 +500,24 @@ void Eventloop::handle_event(OnUnpinAddress&& e)
 }
 void Eventloop::handle_event(mempool::Log&& log)
 {
-    mempool.apply_log(log);
-
-    // build vector of mempool entries
-    std::vector<mempool::Entry> entries;
-    for (auto& action : log) {
-        if (std::holds_alternative<mempool::Put>(action)) {
-            entries.push_back(std::get<mempool::Put>(action).entry);
-        }
-    }
-    std::sort(entries.begin(),entries.end(),
-        [](const mempool::Entry& e1, const mempool::Entry& e2) {
-            if (e1.second.transactionHeight == e2.second.transactionHeight)
-                return e1.first < e2.first;
-            return e1.second.transactionHeight < e2.second.transactionHeight;
-        });
-
-    // construct subscription bounds per connection
-    auto eiter = entries.begin();
-    std::vector<std::pair<decltype(entries)::iterator, Conref>> bounds;
-    auto miter = mempoolSubscriptions.cbegin();
-    if (mempoolSubscriptions.size() > 0) {
-        while (eiter != entries.end()) {
-            while (!(eiter->second.transactionHeight < miter->first.transactionHeight)) {
-                bounds.push_back({ eiter, miter->second });
-                ++miter;
-                if (miter == mempoolSubscriptions.cend())
-                    goto finished;
-            }
+    mempool::Delta delta(std::move(log));
+    mempool.apply_delta(delta);
+
+    // puts and subscriptions are both ordered by OrderKey, a subscription
+    // receives the puts below its key and peers with the same bound share
+    // one serialized buffer
+    auto& entries { delta.put };
+    auto eiter { entries.begin() };
+    std::optional<std::pair<decltype(eiter), SharedSndbuffer>> last;
+    for (auto& [key, cr] : mempoolSubscriptions) {
+        while (eiter != entries.end()
+            && mempool::OrderKey { eiter->second.transactionHeight, eiter->first } < key)
             ++eiter;
-        }
-        while (miter != mempoolSubscriptions.end()) {
-            bounds.push_back({ entries.end(), miter->second });
-            ++miter;
-        }
-    finished:
-
-        // send subscription individually
-        for (auto& [end, cr] : bounds) {
-            cr.send(TxnotifyMsg::direct_send(entries.begin(), end));
-        }
+        if (eiter == entries.begin())
+            continue;
+        if (!last || last->first != eiter)
+            last.emplace(eiter, TxnotifyMsg::direct_send(entries.begin(), eiter));
+        cr.send(last->second);
     }
 }
 
@@ -460,6 +539,8 @@ void Eventloop::erase(Conref c)
     };
     if (connections.erase(c.iterator()))
         update_wakeup();
+    txRequests.erase(c.id());
+    send_txrequests();
     if (doRequests) {
         do_requests();
     }
@@ -522,6 +603,11 @@ void Eventloop::process_connection(Connection* c)
         // fresh connection
 
         c->eventloop_registered = true;
+        if (auto& f { config().node.follow }; f && (c->inbound || c->peer_address() != *f)) {
+            c->async_close(EREFUSED); // followers only talk to their primary
+            c->eventloop_erased = true;
+            return;
+        }
         auto [error, cr] = connections.insert(
             c, headerDownload, blockDownload, timer);
         update_wakeup();
@@ -531,36 +617,113 @@ void Eventloop::process_connection(Connection* c)
             c->eventloop_erased = true;
             return;
         }
-        if (config().node.logCommunication)
+        if (log_communication())
             spdlog::info("{} connected", c->to_string());
 
         send_init(cr);
     }
-    auto messages = c->extractMessages();
+    if (!c->eventloop_queued) {
+        c->eventloop_queued = true;
+        receiving.push_back(c);
+    }
+}
+
+namespace {
+bool is_sync_reply(uint8_t type)
+{
+    using namespace messages;
+    switch (type) {
+    case BatchrepMsg::msgcode:
+    case ProberepMsg::msgcode:
+    case BlockrepMsg::msgcode:
+    case CompactrepMsg::msgcode:
+    case BatchrepDeltaMsg::msgcode:
+    case BlockrepZstdMsg::msgcode:
+        return true;
+    default:
+        return false;
+    }
+}
+}
+
+void Eventloop::receive_messages()
+{
+    // one round, connections with remaining messages are queued at the back
+    for (size_t n { receiving.size() }; n > 0; --n) {
+        auto c { receiving.front() };
+        receiving.pop_front();
+        if (receive_messages(c))
+            receiving.push_back(c);
+        else
+            c->eventloop_queued = false;
+    }
+}
+
+bool Eventloop::receive_messages(Connection* c)
+{
+    if (c->eventloop_erased)
+        return false;
+    auto [messages, more] = c->extract_messages(messageBudget);
+    auto checksumsValid { Rcvbuffer::verify(messages) };
     Conref cr { c->dataiter };
-    for (auto& msg : messages) {
+    for (size_t i = 0; i < messages.size(); ++i) {
         try {
-            dispatch_message(cr, msg);
+            if (checksumsValid[i] == false)
+                throw Error(ECHECKSUM);
+            if (c->eventloop_sync_queued > 0 || is_sync_reply(messages[i].type())) {
+                c->eventloop_sync_queued += 1;
+                syncMessages.push_back({ c, std::move(messages[i]) });
+                continue;
+            }
+            dispatch_message(cr, messages[i]);
             // active
         } catch (Error e) {
             close(cr, e.e);
             do_requests();
-            break;
+            return false;
         }
         if (c->eventloop_erased) {
-            return;
+            return false;
         }
     }
+    return more;
+}
+
+void Eventloop::process_sync_messages()
+{
+    // at least one message per iteration
+    const auto deadline { std::chrono::steady_clock::now() + syncBudget };
+    while (!syncMessages.empty()) {
+        auto [c, msg] { std::move(syncMessages.front()) };
+        syncMessages.pop_front();
+        c->eventloop_sync_queued -= 1;
+        if (!c->eventloop_erased) {
+            Conref cr { c->dataiter };
+            try {
+                dispatch_message(cr, msg);
+            } catch (Error e) {
+                close(cr, e.e);
+                do_requests();
+            }
+        }
+        if (std::chrono::steady_clock::now() >= deadline)
+            return;
+    }
 }
 
 void Eventloop::send_ping_await_pong(Conref c)
 {
-    if (config().node.logCommunication)
+    if (log_communication())
         spdlog::info("{} Sending Ping", c.str());
     auto t = timer.insert(
         (config().localDebug ? 10min : 1min),
         Timer::CloseNoPong { c.id() });
-    PingMsg p(signed_snapshot() ? signed_snapshot()->priority : SignedSnapshot::Priority {});
+    const bool reconcile { (c->capabilities & capability::TXRECON) != 0 };
+    if (reconcile && !c->c->inbound)
+        send_txrecon(c);
+    // transaction ids are exchanged by reconciliation instead of pong
+    PingMsg p(signed_snapshot() ? signed_snapshot()->priority : SignedSnapshot::Priority {},
+        5, reconcile ? 0 : 100);
     c.ping().await_pong(p, t);
     c.send(p);
 }
@@ -575,7 +738,7 @@ void Eventloop::received_pong_sleep_ping(Conref c)
 void Eventloop::update_wakeup()
 {
     auto wakeupTime = connections.wakeup_time();
-    if (wakeupTimer && (wakeupTime == (*wakeupTimer)->first))
+    if (wakeupTimer && (wakeupTime == timer.expiry(*wakeupTimer)))
         return; // no change
     if (wakeupTimer) {
         timer.cancel(*wakeupTimer);
@@ -586,6 +749,20 @@ void Eventloop::update_wakeup()
     wakeupTimer = timer.insert(*wakeupTime, Timer::Connect {});
 }
 
+void Eventloop::update_txrequest_wakeup()
+{
+    auto wakeupTime = txRequests.wakeup_time();
+    if (txRequestTimer && (wakeupTime == timer.expiry(*txRequestTimer)))
+        return; // no change
+    if (txRequestTimer) {
+        timer.cancel(*txRequestTimer);
+        txRequestTimer.reset();
+    }
+    if (!wakeupTime)
+        return;
+    txRequestTimer = timer.insert(*wakeupTime, Timer::RequestTxs {});
+}
+
 void Eventloop::send_requests(Conref cr, const std::vector<Request>& requests)
 {
     for (auto& r : requests) {
@@ -596,8 +773,10 @@ void Eventloop::send_requests(Conref cr, const std::vector<Request>& requests)
     }
 }
 
-void Eventloop::do_requests()
+void Eventloop::assign_requests()
 {
+    if (!std::exchange(requestsChanged, false))
+        return;
     headerDownload.do_requests(sender());
     blockDownload.do_peer_requests(sender());
     headerDownload.do_probe_requests(sender());
@@ -607,20 +786,35 @@ void Eventloop::do_requests()
 template <typename T>
 void Eventloop::send_request(Conref c, const T& req)
 {
-    if (config().node.logCommunication)
+    if (log_communication())
         spdlog::info("{} send {}", c.str(), req.log_str());
-    auto t = timer.insert(req.expiry_time, Timer::Expire { c.id() });
+    auto t = timer.insert(c->responses.timeout<T>(), Timer::Expire { c.id() });
     c.job().assign(t, timer, req);
+    c->responses.on_request<T>();
     if (req.isActiveRequest) {
         assert(activeRequests < maxRequests);
         activeRequests += 1;
     }
+    if constexpr (std::is_same_v<T, Blockrequest>) {
+        block_latency::mark(block_latency::Stage::Requested, req.range.lower, req.range.upper);
+        if (req.compact)
+            return c.send(CompactreqMsg(req.nonce, req.range, req.prefill));
+    }
     c.send(req);
 }
 
 void Eventloop::send_init(Conref cr)
 {
-    cr.send(InitMsg::serialize_chainstate(consensus()));
+    cr.send(InitMsg::serialize_chainstate(consensus(), cr->c->peer_version() >= CAPABILITIESVERSION));
+}
+
+void Eventloop::send_blockrep(Conref cr, Sndbuffer&& sb)
+{
+    if (cr->capabilities & capability::ZSTD) {
+        if (auto compressed { BlockrepZstdMsg::compress(sb) })
+            return cr.send(std::move(*compressed));
+    }
+    cr.send(std::move(sb));
 }
 
 template <typename T>
@@ -658,6 +852,7 @@ void Eventloop::handle_connection_timeout(Conref cr, Timer::Expire&&)
         [&]<typename T>(T& v) {
             if constexpr (std::is_base_of_v<IsRequest, T>) {
                 v.unref_active_requests(activeRequests);
+                cr->responses.on_expire();
                 on_request_expired(cr, v);
             } else {
                 assert(false);
@@ -665,6 +860,10 @@ void Eventloop::handle_connection_timeout(Conref cr, Timer::Expire&&)
         },
         cr.job().data_v);
     assert(!cr.job().data_v.valueless_by_exception());
+
+    // make room for another outbound peer, enough others serve requests
+    if (!cr->c->inbound && cr->responses.persistently_slow() && headerDownload.size() > minPeersKeepSlow)
+        close(cr, ESLOWPEER);
 }
 
 void Eventloop::on_request_expired(Conref cr, const Proberequest&)
@@ -689,19 +888,35 @@ void Eventloop::on_request_expired(Conref cr, const Blockrequest&)
 void Eventloop::handle_timeout(Timer::Connect&&)
 {
     wakeupTimer.reset();
-    auto connect = connections.pop_connect();
-    for (auto& a : connect) {
-        global().pcm->async_connect(a);
-    }
-    update_wakeup();
+    connect_scheduled();
 }
 
-void Eventloop::dispatch_message(Conref cr, Rcvbuffer& msg)
+void Eventloop::handle_timeout(Timer::RequestTxs&&)
+{
+    txRequestTimer.reset();
+    send_txrequests();
+}
+
+namespace {
+metrics::Histogram& dispatch_histogram(size_t msgIndex)
 {
     using namespace messages;
-    if (msg.verify() == false)
-        throw Error(ECHECKSUM);
+    static const auto histograms { [&]() {
+        std::array<metrics::Histogram*, std::variant_size_v<Msg>> res;
+        for (size_t i = 0; i < res.size(); ++i)
+            res[i] = &metrics::histogram("warthog_message_dispatch_seconds",
+                "Duration of parsing and handling a peer message", { { "type", name(i) } });
+        return res;
+    }() };
+    return *histograms[msgIndex];
+}
+}
 
+void Eventloop::dispatch_message(Conref cr, Rcvbuffer& msg)
+{
+    using namespace messages;
+    TRACE_ZONE("eventloop.message");
+    const auto begin { std::chrono::steady_clock::now() };
     auto m = msg.parse();
     // first message must be of type INIT (is_init() is only initially true)
     if (cr.job().awaiting_init()) {
@@ -715,25 +930,32 @@ void Eventloop::dispatch_message(Conref cr, Rcvbuffer& msg)
             throw Error(EINVINIT);
     }
 
+    const auto index { m.index() };
     std::visit([&](auto&& e) {
         handle_msg(cr, std::move(e));
     },
         m);
+    const auto duration { std::chrono::steady_clock::now() - begin };
+    dispatch_histogram(index).observe(duration);
+    cr->c->traffic.on_processed(msg.type(), duration);
 }
 
 void Eventloop::handle_msg(Conref cr, InitMsg&& m)
 {
-    if (config().node.logCommunication)
+    if (log_communication())
         spdlog::info("{} handle init: height {}, work {}", cr.str(), m.chainLength.value(), m.worksum.getdouble());
     cr.job().reset_notexpired<AwaitInit>(timer);
+    cr->capabilities = m.capabilities;
     if (insert(cr, m))
         do_requests();
 }
 
 void Eventloop::handle_msg(Conref cr, AppendMsg&& m)
 {
-    if (config().node.logCommunication)
+    if (log_communication())
         spdlog::info("{} handle append", cr.str());
+    if (m.newLength <= consensus().headers().length() + 2)
+        block_latency::begin(m.newLength, block_latency::Stage::Announced); // not during sync
     cr->chain.on_peer_append(m, chains);
     headerDownload.on_append(cr);
     blockDownload.on_append(cr);
@@ -742,7 +964,7 @@ void Eventloop::handle_msg(Conref cr, AppendMsg&& m)
 
 void Eventloop::handle_msg(Conref c, SignedPinRollbackMsg&& m)
 {
-    if (config().node.logCommunication)
+    if (log_communication())
         spdlog::info("{} handle rollback ", c.str());
     verify_rollback(c, m);
     c->chain.on_peer_shrink(m, chains);
@@ -753,7 +975,7 @@ void Eventloop::handle_msg(Conref c, SignedPinRollbackMsg&& m)
 
 void Eventloop::handle_msg(Conref c, ForkMsg&& m)
 {
-    if (config().node.logCommunication)
+    if (log_communication())
         spdlog::info("{} handle fork", c.str());
     c->chain.on_peer_fork(m, chains);
     headerDownload.on_fork(c);
@@ -763,10 +985,16 @@ void Eventloop::handle_msg(Conref c, ForkMsg&& m)
 
 void Eventloop::handle_msg(Conref c, PingMsg&& m)
 {
-    if (config().node.logCommunication)
+    if (log_communication())
         spdlog::info("{} handle ping", c.str());
     size_t nAddr { std::min(uint16_t(20), m.maxAddresses) };
-    auto addresses = connections.sample_verified(nAddr);
+    std::vector<EndpointAddress> addresses;
+    for (auto a : connections.sample_verified(2 * nAddr)) { // skip addresses the peer knows
+        if (addresses.size() == nAddr)
+            break;
+        if (c->knownAddresses.insert_new(a))
+            addresses.push_back(a);
+    }
     c->ratelimit.ping();
     PongMsg msg(m.nonce, std::move(addresses), mempool.take(m.maxTransactions));
     spdlog::debug("{} Sending {} addresses", c.str(), msg.addresses.size());
@@ -778,12 +1006,15 @@ void Eventloop::handle_msg(Conref c, PingMsg&& m)
 
 void Eventloop::handle_msg(Conref cr, PongMsg&& m)
 {
-    if (config().node.logCommunication)
+    if (log_communication())
         spdlog::info("{} handle pong", cr.str());
     auto& pingMsg = cr.ping().check(m);
     received_pong_sleep_ping(cr);
     spdlog::debug("{} Received {} addresses", cr.str(), m.addresses.size());
-    connections.queue_verification(m.addresses);
+    for (auto& a : m.addresses)
+        cr->knownAddresses.insert(a);
+    if (!config().node.follow)
+        connections.queue_verification(m.addresses);
     spdlog::debug("{} Got {} transaction Ids in pong message", cr.str(), m.txids.size());
 
     // update acknowledged priority
@@ -792,9 +1023,7 @@ void Eventloop::handle_msg(Conref cr, PongMsg&& m)
     }
 
     // request new txids
-    auto txids = mempool.filter_new(m.txids);
-    if (txids.size() > 0)
-        cr.send(TxreqMsg(txids));
+    request_txs(cr, mempool.filter_new(m.txids));
 
     // connect scheduled (in case new addresses were added)
     connect_scheduled();
@@ -802,35 +1031,39 @@ void Eventloop::handle_msg(Conref cr, PongMsg&& m)
 
 void Eventloop::handle_msg(Conref cr, BatchreqMsg&& m)
 {
-    if (config().node.logCommunication)
+    if (log_communication())
         spdlog::info("{} handle batchreq [{},{}]", cr.str(), m.selector.startHeight.value(), (m.selector.startHeight + m.selector.length - 1).value());
     auto& s = m.selector;
-    Batch batch = [&]() {
-        if (s.descriptor == consensus().descriptor()) {
-            return consensus().headers().get_headers(s.startHeight, s.end());
-        } else {
-            return stateServer.get_headers(s);
-        }
-    }();
-
-    BatchrepMsg rep(m.nonce, std::move(batch));
-    rep.nonce = m.nonce;
-    cr.send(rep);
+    const bool delta { (cr->capabilities & capability::HEADERDELTA) != 0 };
+    if (s.descriptor == consensus().descriptor()) {
+        // serialized straight from the shared batches of the consensus chain
+        auto spans { consensus().headers().header_spans(s.startHeight, s.end()) };
+        cr.send(delta ? BatchrepDeltaMsg::serialize(m.nonce, spans)
+                      : BatchrepMsg::serialize(m.nonce, spans));
+        return;
+    }
+    Batch batch { stateServer.get_headers(s) };
+    if (delta) {
+        cr.send(BatchrepDeltaMsg(m.nonce, std::move(batch)));
+        return;
+    }
+    cr.send(BatchrepMsg(m.nonce, std::move(batch)));
 }
 
-void Eventloop::handle_msg(Conref cr, BatchrepMsg&& m)
+void Eventloop::handle_msg(Conref cr, BatchrepView&& m)
 {
-    if (config().node.logCommunication)
+    if (log_communication())
         spdlog::info("{} handle_batchrep", cr.str());
     // check nonce and get associated data
     auto req = cr.job().pop_req(m, timer, activeRequests);
+    cr->responses.on_reply(m.headers.size());
 
     // save batch
-    if (m.batch.size() < req.minReturn || m.batch.size() > req.max_return()) {
+    if (m.size() < req.minReturn || m.size() > req.max_return()) {
         close(ChainOffender(EBATCHSIZE, req.selector.startHeight, cr.id()));
         return;
     }
-    auto offenders = headerDownload.on_response(cr, std::move(req), std::move(m.batch));
+    auto offenders = headerDownload.on_response(cr, std::move(req), m.batch());
     for (auto& o : offenders) {
         close(o);
     }
@@ -842,9 +1075,14 @@ void Eventloop::handle_msg(Conref cr, BatchrepMsg&& m)
     do_requests();
 }
 
+void Eventloop::handle_msg(Conref cr, BatchrepDeltaMsg&& m)
+{
+    handle_msg(cr, BatchrepView(m.nonce, m.batch.raw()));
+}
+
 void Eventloop::handle_msg(Conref cr, ProbereqMsg&& m)
 {
-    if (config().node.logCommunication)
+    if (log_communication())
         spdlog::info("{} handle_probereq d:{}, h:{}", cr.str(), m.descriptor.value(), m.height.value());
     ProberepMsg rep(m.nonce, consensus().descriptor().value());
     auto h = consensus().headers().get_header(m.height);
@@ -864,9 +1102,10 @@ void Eventloop::handle_msg(Conref cr, ProbereqMsg&& m)
 
 void Eventloop::handle_msg(Conref cr, ProberepMsg&& rep)
 {
-    if (config().node.logCommunication)
+    if (log_communication())
         spdlog::info("{} handle_proberep", cr.str());
     auto req = cr.job().pop_req(rep, timer, activeRequests);
+    cr->responses.on_reply(0);
     if (!rep.requested.has_value() && !req.descripted->expired()) {
         throw ChainError { EEMPTY, req.height };
     }
@@ -880,17 +1119,21 @@ void Eventloop::handle_msg(Conref cr, BlockreqMsg&& m)
 {
     using namespace std::placeholders;
     BlockreqMsg req(m);
-    if (config().node.logCommunication)
+    if (log_communication())
         spdlog::info("{} handle_blockreq [{},{}]", cr.str(), req.range.lower.value(), req.range.upper.value());
     cr->lastNonce = req.nonce;
-    stateServer.async_get_blocks(req.range, std::bind(&Eventloop::async_forward_blockrep, this, cr.id(), _1));
+    stateServer.async_get_blockrep(req.range, req.nonce, std::bind(&Eventloop::async_forward_raw_blockrep, this, cr.id(), req.nonce, _1));
 }
 
-void Eventloop::handle_msg(Conref cr, BlockrepMsg&& m)
+void Eventloop::handle_msg(Conref cr, BlockrepView&& m)
 {
-    if (config().node.logCommunication)
+    if (log_communication())
         spdlog::info("{} handle blockrep", cr.str());
     auto req = cr.job().pop_req(m, timer, activeRequests);
+    size_t bytes { 0 };
+    for (auto& b : m.blocks)
+        bytes += b.size();
+    cr->responses.on_reply(bytes);
 
     try {
         blockDownload.on_blockreq_reply(cr, std::move(m), req);
@@ -901,19 +1144,205 @@ void Eventloop::handle_msg(Conref cr, BlockrepMsg&& m)
     do_requests();
 }
 
+void Eventloop::handle_msg(Conref cr, BlockrepZstdMsg&& m)
+{
+    const BlockrepMsg rep(m.nonce, std::move(m.blocks));
+    handle_msg(cr, BlockrepView(rep));
+}
+
+void Eventloop::handle_msg(Conref cr, CompactreqMsg&& m)
+{
+    if (log_communication())
+        spdlog::info("{} handle_compactreq [{},{}]", cr.str(), m.range.lower.value(), m.range.upper.value());
+    if (m.range.length() > MAXBLOCKBATCHSIZE) // no byte budget for compact replies
+        throw Error(EBLOCKRANGE);
+    cr->lastNonce = m.nonce;
+    stateServer.async_get_blocks(m.range,
+        [this, conId = cr.id(), prefill = std::move(m.prefill)](std::vector<BodyContainer>&& blocks) {
+            async_forward_compactrep(conId, prefill, std::move(blocks));
+        });
+}
+
+void Eventloop::handle_msg(Conref cr, CompactrepMsg&& m)
+{
+    if (log_communication())
+        spdlog::info("{} handle compactrep", cr.str());
+    auto req = cr.job().pop_req(m, timer, activeRequests);
+    cr->responses.on_reply(0);
+    if (!req.compact) {
+        close(cr, EUNREQUESTED);
+        return;
+    }
+
+    try {
+        auto fallback { blockDownload.on_compact_reply(cr, std::move(m), req, mempool) };
+        if (fallback)
+            send_request(cr, *fallback);
+        else
+            process_blockdownload_stage();
+    } catch (Error e) {
+        close(cr, e);
+    }
+    do_requests();
+}
+
 void Eventloop::handle_msg(Conref cr, TxnotifyMsg&& m)
 {
-    if (config().node.logCommunication)
+    if (log_communication())
         spdlog::info("{} handle Txnotify", cr.str());
-    auto txids = mempool.filter_new(m.txids);
-    if (txids.size() > 0)
-        cr.send(TxreqMsg(txids));
+    request_txs(cr, mempool.filter_new(m.txids));
     do_requests();
 }
 
+void Eventloop::push_block(const BlockpushMsg& m, std::optional<uint64_t> exceptId)
+{
+    const size_t n { config().node.blockPushPeers };
+    if (n == 0)
+        return;
+    std::vector<Conref> peers;
+    for (auto c : connections.initialized()) {
+        if ((c->capabilities & capability::BLOCKPUSH) && c.id() != exceptId)
+            peers.push_back(c);
+    }
+    const size_t k { std::min(n, peers.size()) };
+    if (k == 0)
+        return;
+    std::partial_sort(peers.begin(), peers.begin() + k, peers.end(), [](Conref a, Conref b) {
+        return a->responses.faster_than(b->responses);
+    });
+    const SharedSndbuffer msg { Sndbuffer(m) };
+    for (size_t i = 0; i < k; ++i)
+        peers[i].send(msg);
+}
+
+bool Eventloop::remember_push(const Hash& hash)
+{
+    if (std::find(recentPushes.begin(), recentPushes.end(), hash) != recentPushes.end())
+        return false;
+    if (recentPushes.size() == maxRecentPushes)
+        recentPushes.pop_front();
+    recentPushes.push_back(hash);
+    return true;
+}
+
+void Eventloop::send_txrecon(Conref cr)
+{
+    auto& rs { cr->txrecon };
+    const uint64_t salt { (uint64_t(rand()) << 32) ^ uint64_t(rand()) };
+    mempool::TxSketch sketch(salt, rs.sketch_cells());
+    rs.sketched.clear();
+    for (auto& t : mempool.take(mempool::RECONSETSIZE))
+        rs.sketched.emplace(sketch.add(t.txid), t);
+    TxreconreqMsg m(std::move(sketch));
+    rs.nonce = m.nonce;
+    cr.send(m);
+}
+
+void Eventloop::request_txs(Conref cr, std::vector<TransactionId>&& announced)
+{
+    if (announced.empty())
+        return;
+    txRequests.announced(cr.id(), announced);
+    send_txrequests();
+}
+
+void Eventloop::send_txrequests()
+{
+    for (auto& [conId, txids] : txRequests.pop_requests(std::chrono::steady_clock::now())) {
+        // unknown ids expire and fall back to other announcers
+        if (auto cr { connections.find(conId) }; cr)
+            cr.send(TxreqMsg(std::move(txids)));
+    }
+    update_txrequest_wakeup();
+}
+
+void Eventloop::handle_msg(Conref cr, TxreconreqMsg&& m)
+{
+    if (log_communication())
+        spdlog::info("{} handle TxreconreqMsg", cr.str());
+    if (!cr->c->inbound || !(cr->capabilities & capability::TXRECON))
+        throw Error(EUNREQUESTED);
+    auto& theirs { m.sketch };
+    mempool::TxSketch ours(theirs.salt(), theirs.cells().size());
+    std::map<uint64_t, TxidWithFee> sketched;
+    for (auto& t : mempool.take(mempool::RECONSETSIZE))
+        sketched.emplace(ours.add(t.txid), t);
+    ours -= theirs;
+
+    std::vector<TxidWithFee> announce;
+    auto d { ours.decode() };
+    if (!d) {
+        // fall back to announcing everything
+        for (auto& [_, t] : sketched)
+            announce.push_back(t);
+        cr.send(TxreconrepMsg(m.nonce, {}));
+    } else {
+        for (auto id : d->ours) {
+            if (auto iter { sketched.find(id) }; iter != sketched.end())
+                announce.push_back(iter->second);
+        }
+        cr.send(TxreconrepMsg(m.nonce,
+            TxreconrepMsg::Decoded { uint16_t(d->size()), std::move(d->theirs) }));
+    }
+    if (announce.size() > 0)
+        cr.send(TxnotifyMsg(std::move(announce)));
+}
+
+void Eventloop::handle_msg(Conref cr, TxreconrepMsg&& m)
+{
+    if (log_communication())
+        spdlog::info("{} handle TxreconrepMsg", cr.str());
+    auto& rs { cr->txrecon };
+    if (!rs.nonce || *rs.nonce != m.nonce)
+        throw Error(EUNREQUESTED);
+    rs.nonce.reset();
+    auto sketched { std::move(rs.sketched) };
+    rs.sketched.clear();
+
+    std::vector<TxidWithFee> announce;
+    if (!m.decoded) {
+        rs.on_failure();
+        for (auto& [_, t] : sketched)
+            announce.push_back(t);
+    } else {
+        rs.on_success(m.decoded->difference);
+        for (auto id : m.decoded->missing) {
+            if (auto iter { sketched.find(id) }; iter != sketched.end())
+                announce.push_back(iter->second);
+        }
+    }
+    if (announce.size() > 0)
+        cr.send(TxnotifyMsg(std::move(announce)));
+}
+
+void Eventloop::handle_msg(Conref cr, BlockpushMsg&& m)
+{
+    auto& b { m.block };
+    if (log_communication())
+        spdlog::info("{} handle blockpush #{}", cr.str(), b.height.value());
+    if (!remember_push(b.header.hash()))
+        return; // pushed by another peer before
+    auto& headers { consensus().headers() };
+    if (b.height != headers.length() + 1)
+        return; // not on top of our chain, left to the header sync
+
+    // the header is checked completely before it is relayed, the body only
+    // by the chainserver
+    auto prepared { ExtendableHeaderchain(headers, headers.length()).prepare_append(signed_snapshot(), b.header) };
+    if (!prepared) {
+        auto e { prepared.error() };
+        if (e == EPOW || e == EDIFFICULTY)
+            throw Error(e);
+        return; // competing block or timestamp out of our tolerance
+    }
+    block_latency::begin(b.height, block_latency::Stage::Received);
+    push_block(m, cr.id());
+    stateServer.async_append_pushed(std::move(b), [](const tl::expected<void, int32_t>&) {});
+}
+
 void Eventloop::handle_msg(Conref cr, TxreqMsg&& m)
 {
-    if (config().node.logCommunication)
+    if (log_communication())
         spdlog::info("{} handle TxreqMsg", cr.str());
     std::vector<std::optional<TransferTxExchangeMessage>> out;
     for (auto& e : m.txids) {
@@ -925,20 +1354,25 @@ void Eventloop::handle_msg(Conref cr, TxreqMsg&& m)
 
 void Eventloop::handle_msg(Conref cr, TxrepMsg&& m)
 {
-    if (config().node.logCommunication)
+    if (log_communication())
         spdlog::info("{} handle TxrepMsg", cr.str());
     std::vector<TransferTxExchangeMessage> txs;
+    std::vector<bool> delivered;
     for (auto& o : m.txs) {
+        delivered.push_back(o.has_value());
         if (o)
             txs.push_back(*o);
     };
+    if (!txRequests.on_reply(cr.id(), delivered))
+        throw Error(EUNREQUESTED);
     stateServer.async_put_mempool(std::move(txs));
+    send_txrequests();
     do_requests();
 }
 
 void Eventloop::handle_msg(Conref cr, LeaderMsg&& msg)
 {
-    if (config().node.logCommunication)
+    if (log_communication())
         spdlog::info("{} handle LeaderMsg", cr.str());
     // ban if necessary
     if (msg.signedSnapshot.priority <= cr->acknowledgedSnapshotPriority) {
@@ -988,10 +1422,8 @@ void Eventloop::cancel_timer(Timer::iterator& ref)
 
 void Eventloop::connect_scheduled()
 {
-    auto as = connections.pop_connect();
-    for (auto& a : as) {
-        global().pcm->async_connect(a);
-    }
+    global().pcm->async_connect(connections.pop_connect());
+    update_wakeup(); // remaining due addresses wait for a slot or the rate
 }
 
 void Eventloop::verify_rollback(Conref cr, const SignedPinRollbackMsg& m)
@@ -5,16 +5,22 @@
 #include "block/chain/signed_snapshot.hpp"
 #include "chain_cache.hpp"
 #include "chainserver/state/update/update.hpp"
+#include "communication/buffers/recvbuffer.hpp"
+#include "communication/buffers/sndbuffer.hpp"
 #include "communication/stage_operation/result.hpp"
 #include "eventloop/timer.hpp"
+#include "general/logging.hpp"
+#include "general/mpsc_queue.hpp"
 #include "mempool/mempool.hpp"
 #include "mempool/subscription_declaration.hpp"
 #include "peerserver/peerserver.hpp"
 #include "sync/sync.hpp"
 #include "sync/sync_state.hpp"
+#include "tx_requests.hpp"
 #include "types/chainstate.hpp"
 #include "types/conndata.hpp"
 #include <condition_variable>
+#include <deque>
 #include <limits>
 #include <map>
 #include <mutex>
@@ -65,11 +71,12 @@ public:
     void async_shutdown(int32_t reason);
     void async_report_failed_outbound(EndpointAddress);
     void async_stage_action(stage_operation::Result);
+    void async_push_block(const Block&); // mined by us
 
     void api_get_peers(PeersCb&& cb);
     void api_get_hashrate(HashrateCb&& cb);
     void api_get_hashrate_chart(HashrateChartCb&& cb);
-    void api_get_hashrate_chart(NonzeroHeight from, NonzeroHeight to,HashrateChartCb&& cb);
+    void api_get_hashrate_chart(NonzeroHeight from, NonzeroHeight to, uint32_t step, HashrateChartCb&& cb);
     void api_inspect(InspectorCb&&);
 
     void start_async_loop();
@@ -83,11 +90,16 @@ private:
     void work();
     bool check_shutdown();
     void process_connection(Connection* c);
+    void receive_messages();
+    bool receive_messages(Connection* c); // returns whether more are buffered
+    void process_sync_messages();
 
     //////////////////////////////
     // Private async functions
 
     void async_forward_blockrep(uint64_t conId, std::vector<BodyContainer>&& blocks);
+    void async_forward_raw_blockrep(uint64_t conId, uint32_t nonce, std::optional<Sndbuffer>&& sb);
+    void async_forward_compactrep(uint64_t conId, const std::vector<uint32_t>& prefill, std::vector<BodyContainer>&& blocks);
 
     //////////////////////////////
     // Connection related functions
@@ -102,15 +114,15 @@ private:
 
     ////////////////////////
     // Handling incoming messages
-    void dispatch_message(Conref cr, Rcvbuffer& rb);
+    void dispatch_message(Conref cr, Rcvbuffer& rb); // checksum must be verified
     void handle_msg(Conref cr, PingMsg&&);
     void handle_msg(Conref cr, PongMsg&&);
     void handle_msg(Conref cr, BatchreqMsg&&);
-    void handle_msg(Conref cr, BatchrepMsg&&);
+    void handle_msg(Conref cr, BatchrepView&&);
     void handle_msg(Conref cr, ProbereqMsg&&);
     void handle_msg(Conref cr, ProberepMsg&&);
     void handle_msg(Conref cr, BlockreqMsg&&);
-    void handle_msg(Conref cr, BlockrepMsg&&);
+    void handle_msg(Conref cr, BlockrepView&&);
     void handle_msg(Conref cr, InitMsg&&);
     void handle_msg(Conref cr, AppendMsg&&);
     void handle_msg(Conref cr, SignedPinRollbackMsg&&);
@@ -119,14 +131,23 @@ private:
     void handle_msg(Conref cr, TxreqMsg&&);
     void handle_msg(Conref cr, TxrepMsg&&);
     void handle_msg(Conref cr, LeaderMsg&&);
+    void handle_msg(Conref cr, CompactreqMsg&&);
+    void handle_msg(Conref cr, CompactrepMsg&&);
+    void handle_msg(Conref cr, BatchrepDeltaMsg&&);
+    void handle_msg(Conref cr, BlockrepZstdMsg&&);
+    void handle_msg(Conref cr, TxreconreqMsg&&);
+    void handle_msg(Conref cr, TxreconrepMsg&&);
+    void handle_msg(Conref cr, BlockpushMsg&&);
 
     ////////////////////////
     // convenience functions
     void consider_send_snapshot(Conref);
 
     ////////////////////////
-    // assign work to connections
-    void do_requests();
+    // assign work to connections: handlers only mark that the request
+    // state changed, the downloaders are scanned once per iteration
+    void do_requests() { requestsChanged = true; }
+    void assign_requests();
     void send_requests(Conref cr, const std::vector<Request>&);
 
     ////////////////////////
@@ -137,6 +158,15 @@ private:
     friend class RequestSender;
     RequestSender sender() { return RequestSender(*this); };
     void send_init(Conref cr);
+    // compressed for peers with capability::ZSTD
+    void send_blockrep(Conref cr, Sndbuffer&& blockrep);
+    // outbound side of connections with capability::TXRECON
+    void send_txrecon(Conref cr);
+    void request_txs(Conref cr, std::vector<TransactionId>&& announced);
+    // to the fastest peers with capability::BLOCKPUSH
+    void push_block(const BlockpushMsg&, std::optional<uint64_t> exceptId);
+    bool remember_push(const Hash&); // false if seen before
+    void send_txrequests();
 
     ////////////////////////
     // Handling timeout events
@@ -150,6 +180,7 @@ private:
     void send_ping_await_pong(Conref cr);
     void received_pong_sleep_ping(Conref cr);
     void update_wakeup();
+    void update_txrequest_wakeup();
 
     ////////////////////////
     // Timeout callbacks
@@ -157,6 +188,7 @@ private:
     requires std::derived_from<T, Timer::WithConnecitonId>
     void handle_timeout(T&&);
     void handle_timeout(Timer::Connect&&);
+    void handle_timeout(Timer::RequestTxs&&);
     void handle_connection_timeout(Conref, Timer::SendPing&&);
     void handle_connection_timeout(Conref, Timer::Expire&&);
     void handle_connection_timeout(Conref, Timer::CloseNoReply&&);
@@ -184,6 +216,13 @@ private:
     struct OnForwardBlockrep {
         uint64_t conId;
         std::vector<BodyContainer> blocks;
+        bool compact = false;
+        std::vector<uint32_t> prefill {};
+    };
+    struct OnForwardRawBlockrep {
+        uint64_t conId;
+        uint32_t nonce;
+        std::optional<Sndbuffer> sb;
     };
     struct OnFailedAddressEvent {
         EndpointAddress a;
@@ -194,16 +233,20 @@ private:
     struct OnUnpinAddress {
         EndpointAddress a;
     };
+    struct OnPushBlock {
+        Block block;
+    };
     struct GetHashrateChart {
         HashrateChartCb cb;
         NonzeroHeight from;
         NonzeroHeight to;
+        uint32_t step;
     };
     // event queue
     using Event = std::variant<OnRelease, OnProcessConnection,
         StateUpdate, SignedSnapshotCb, PeersCb, stage_operation::Result,
-        OnForwardBlockrep, OnFailedAddressEvent, InspectorCb, HashrateCb, GetHashrateChart,
-        OnPinAddress, OnUnpinAddress, mempool::Log>;
+        OnForwardBlockrep, OnForwardRawBlockrep, OnFailedAddressEvent, InspectorCb, HashrateCb, GetHashrateChart,
+        OnPinAddress, OnUnpinAddress, mempool::Log, OnPushBlock>;
 
 public:
     bool defer(Event e);
@@ -217,6 +260,7 @@ private:
     void handle_event(SignedSnapshotCb&&);
     void handle_event(stage_operation::Result&&);
     void handle_event(OnForwardBlockrep&&);
+    void handle_event(OnForwardRawBlockrep&&);
     void handle_event(OnFailedAddressEvent&&);
     void handle_event(InspectorCb&&);
     void handle_event(HashrateCb&&);
@@ -224,6 +268,7 @@ private:
     void handle_event(OnPinAddress&&);
     void handle_event(OnUnpinAddress&&);
     void handle_event(mempool::Log&&);
+    void handle_event(OnPushBlock&&);
 
     // chain updates
     using Append = chainserver::state_update::Append;
@@ -239,6 +284,8 @@ private:
 
     // log
     void log_chain_length();
+    // per message logs, rate limited during floods
+    bool log_communication();
 
     // checkers
     void verify_rollback(Conref, const SignedPinRollbackMsg&); // throws
@@ -261,18 +308,45 @@ private: // private data
 
     address_manager::AddressManager connections;
 
+    LogLimiter communicationLog { "peer messages" };
     Timer timer;
     std::optional<Timer::iterator> wakeupTimer;
+    std::optional<Timer::iterator> txRequestTimer;
+
+    // Connections with buffered messages are served round-robin, each
+    // with at most messageBudget messages per eventloop iteration.
+    static constexpr size_t messageBudget = 16;
+    std::deque<Connection*> receiving;
+
+    // Sync replies (headers, probes, blocks) drive the expensive download
+    // logic. They are queued and processed after the other messages of an
+    // iteration, for at most syncBudget, such that keepalives and relay of
+    // other peers do not wait behind them. Once a connection has queued
+    // messages, its later messages are queued as well to keep their order.
+    static constexpr auto syncBudget = std::chrono::milliseconds(20);
+    struct SyncMessage {
+        Connection* c;
+        Rcvbuffer msg;
+    };
+    std::deque<SyncMessage> syncMessages;
+
+    // hashes of the latest pushed blocks, each is relayed once
+    static constexpr size_t maxRecentPushes = 32;
+    std::deque<Hash> recentPushes;
 
     // Request related
+    bool requestsChanged = false;
     size_t activeRequests = 0;
     size_t maxRequests = 10;
+    // persistently slow outbound peers are closed above this many peers
+    static constexpr size_t minPeersKeepSlow = 8;
 
     //
     auto signed_snapshot() const { return chains.signed_snapshot(); };
     HeaderDownload::Downloader headerDownload;
     BlockDownload::Downloader blockDownload;
     mempool::SubscriptionMap mempoolSubscriptions;
+    TxRequests txRequests;
     SyncState syncState;
 
     ////////////////////////////
@@ -280,10 +354,11 @@ private: // private data
     ////////////////////////////
     std::condition_variable cv;
     std::mutex mutex;
-    bool haswork = false;
-    int32_t closeReason = 0;
+    std::atomic<int32_t> closeReason = 0;
     bool blockdownloadHalted = false;
-    std::queue<Event> events;
+
+    // lock-free event queue, mutex is only taken to wake up the worker
+    MPSCQueue<Event> events;
     std::thread worker; // worker (constructed last)
 };
 
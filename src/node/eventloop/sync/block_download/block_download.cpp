@@ -8,6 +8,8 @@
 #include "eventloop/chain_cache.hpp"
 #include "eventloop/eventloop.hpp"
 #include "eventloop/types/peer_requests.hpp"
+#include "general/block_latency.hpp"
+#include "general/task_pool.hpp"
 #include "spdlog/spdlog.h"
 
 namespace BlockDownload {
@@ -72,7 +74,9 @@ stage_operation::StageAddOperation Downloader::pop_stage_add() // OK
     stageState.pendingOperation.set_stage_add(
         forks.lower_bound(focus.height_begin()),
         forks.end());
-    return { headers(), focus.pop_data() };
+    // bodies in focus passed check_bodies against the current headers,
+    // forks discard the bodies above the fork height
+    return { .headers { headers() }, .blocks { focus.pop_data() }, .bodiesChecked = true };
 }
 
 stage_operation::StageSetOperation Downloader::pop_stage_set() // OK
@@ -163,6 +167,7 @@ std::vector<ChainOffender> Downloader::init(std::tuple<HeaderDownload::LeaderInf
 
     std::vector<ChainOffender> out;
     auto& [li, hc] = thc;
+    claimedWork = li.descripted->worksum();
     ForkHeight fh = attorney.update_blockdownlad(std::move(hc));
 
     assert(headers().length() != 0);
@@ -271,34 +276,29 @@ void Downloader::do_peer_requests(RequestSender s) // OK?
 
     assert(reachable_length() <= headers().length());
     assert(!stageState.pendingOperation.is_stage_set());
+    focus.adapt_width(forks.size());
 
-    BlockSlot downloadSlot(focus.height_begin());
-    Height minHeight { std::min(downloadSlot.upper_height(), headers().length()) };
-    auto forkIter = forks.lower_bound((minHeight + 1).nonzero_assert());
-    if (forkIter == forks.end())
-        return;
     for (auto n : focus) {
-        if (!n.has_value() || n->iter->second.activeRequest())
+        // stalled requests are assigned to another peer in addition
+        if (!n.has_value() || (n->iter->second.activeRequest() && !n->iter->second.reassignable()))
             continue;
 
-        // found request
+        // found request, assign it to the fastest idle peer having the range,
+        // later ranges are not available to more peers
         auto& range { n->r };
-        if (forkIter->first <= range.upper)
-            forkIter = forks.lower_bound(range.upper + 1);
-        while (true) {
-            if (forkIter == forks.end())
-                return;
-            if (!forkIter->second.job()) {
-                Conref& cr = forkIter->second;
-                assert(has_fork_data(cr));
-                auto req { n->link_request(cr) };
-                s.send(cr, req);
-                if (s.finished())
-                    return;
-                break;
-            }
-            ++forkIter;
+        Conref best;
+        for (auto iter = forks.lower_bound(range.upper + 1); iter != forks.end(); ++iter) {
+            Conref cr { iter->second };
+            if (!cr.job() && (!best.valid() || cr->responses.faster_than(best->responses)))
+                best = cr;
         }
+        if (!best.valid())
+            return;
+        assert(has_fork_data(best));
+        auto req { n->link_request(best) };
+        s.send(best, req);
+        if (s.finished())
+            return;
     }
 }
 
@@ -315,9 +315,13 @@ std::optional<stage_operation::Operation> Downloader::pop_stage()
     }
 }
 
-void Downloader::on_blockreq_reply(Conref cr, BlockrepMsg&& rep, Blockrequest& req)
+void Downloader::on_blockreq_reply(Conref cr, BlockrepView&& rep, Blockrequest& req)
 { // OK
     focus.erase(cr);
+    size_t bytes { 0 };
+    for (auto& b : rep.blocks)
+        bytes += b.size();
+    data(cr).stats.on_reply(rep.blocks.size(), bytes);
 
     if (!initialized)
         return;
@@ -335,8 +339,10 @@ void Downloader::on_blockreq_reply(Conref cr, BlockrepMsg&& rep, Blockrequest& r
         throw Error(EEMPTY);
     }
 
-    // check for correct length
-    if (rep.blocks.size() != req.range.length())
+    // check for correct length, replies to ranges longer than
+    // MAXBLOCKBATCHSIZE may be truncated to the byte budget
+    if (rep.blocks.size() > req.range.length()
+        || (rep.blocks.size() < req.range.length() && req.range.length() <= MAXBLOCKBATCHSIZE))
         throw Error(EMALFORMED);
 
     // discard old replies
@@ -349,20 +355,77 @@ void Downloader::on_blockreq_reply(Conref cr, BlockrepMsg&& rep, Blockrequest& r
     if (headers().hash_at(req.range.upper) != req.upperHash)
         return;
 
-    // check merkle roots
+    // check merkle roots, bodies are independent and parsed in parallel
     size_t i0 = (req.range.lower < focus.height_begin() ? focus.height_begin() - req.range.lower : 0);
+    auto errors { check_bodies(rep.blocks, req.range.lower, i0) };
     for (size_t i = i0; i < rep.blocks.size(); ++i) {
+        if (errors[i] != 0)
+            throw Error(errors[i]);
+    }
+
+    // only now the bodies are copied out of the receive buffer
+    focus.set_blocks(req.range.lower, rep.blocks);
+    block_latency::mark(block_latency::Stage::Received, req.range.lower, req.range.lower + uint32_t(rep.blocks.size() - 1));
+    return;
+}
+
+std::optional<Blockrequest> Downloader::on_compact_reply(Conref cr, CompactrepMsg&& rep, Blockrequest& req, const mempool::Mempool& mempool)
+{
+    if (rep.empty() || !initialized) {
+        on_blockreq_reply(cr, BlockrepView(rep.nonce, {}), req);
+        return {};
+    }
+
+    // check for correct length
+    if (rep.blocks.size() != req.range.length())
+        throw Error(EMALFORMED);
+
+    // reconstruct bodies from mempool, request again on failure:
+    // first with missing transfers prefilled, then in full
+    auto fallback = [&](std::vector<uint32_t> missing) -> std::optional<Blockrequest> {
+        Blockrequest r(req.descripted, req.range, req.upperHash);
+        if (req.prefill.empty() && req.range.length() == 1 && missing.size() > 0) {
+            r.compact = true;
+            r.prefill = std::move(missing);
+        }
+        return r;
+    };
+    std::vector<BodyContainer> blocks;
+    for (size_t i = 0; i < rep.blocks.size(); ++i) {
         auto height { req.range.lower + i };
-        BodyView bv(rep.blocks[i].view());
-        if (!bv.valid())
+        auto r { rep.blocks[i].reconstruct(height, mempool) };
+        if (!r.body)
+            return fallback(std::move(r.missing));
+        blocks.push_back(std::move(*r.body));
+    }
+    const BlockrepMsg reconstructed(rep.nonce, std::move(blocks));
+    BlockrepView view(reconstructed);
+    auto errors { check_bodies(view.blocks, req.range.lower, 0) };
+    for (size_t i = 0; i < errors.size(); ++i) {
+        if (errors[i] == EMALFORMED)
             throw Error(EMALFORMED);
-        if (bv.merkleRoot(height) != headers()[height].merkleroot())
-            throw Error(EMROOT);
+        // our mempool may hold a different transaction with same id
+        if (errors[i] == EMROOT)
+            return fallback({});
     }
+    on_blockreq_reply(cr, std::move(view), req);
+    return {};
+}
 
-    const BlockSlot slot(req.range.lower);
-    focus.set_blocks(slot, req.range.lower, std::move(rep.blocks));
-    return;
+std::vector<int32_t> Downloader::check_bodies(const std::vector<std::span<const uint8_t>>& blocks, NonzeroHeight lower, size_t i0) const
+{
+    // bodies above the known headers are only checked for validity
+    std::vector<int32_t> errors(blocks.size(), 0);
+    task_pool().parallel_for(blocks.size() - std::min(i0, blocks.size()), [&](size_t j) {
+        const size_t i { i0 + j };
+        auto height { lower + i };
+        BodyView bv(blocks[i]);
+        if (!bv.valid())
+            errors[i] = EMALFORMED;
+        else if (headers().length() >= height && bv.merkleRoot(height) != headers()[height].merkleroot())
+            errors[i] = EMROOT;
+    });
+    return errors;
 }
 
 void Downloader::reset()
@@ -371,6 +434,7 @@ void Downloader::reset()
     assert(headers().length() == 0);
 
     // download target related
+    claimedWork.setzero();
     reachableWork.setzero();
     reachableHeight = Height(0);
     forks.clear();
@@ -401,6 +465,7 @@ bool Downloader::erase(Conref cr)
 
 void Downloader::on_blockreq_expire(Conref cr)
 { // OK
+    data(cr).stats.on_expire();
     focus.erase(cr);
 }
 
@@ -444,7 +509,9 @@ void Downloader::set_min_worksum(const Worksum& ws)
 {
     if (!initialized)
         return;
-    if (ws >= headers().total_work()) {
+    // Bodies of a verified header prefix are downloaded ahead as long as
+    // the leader's claimed chain has more work.
+    if (ws >= std::max(headers().total_work(), claimedWork)) {
         spdlog::debug("Disable blockdownload");
         initialized = false;
         stageState.clear();
@@ -15,6 +15,9 @@
 namespace HeaderDownload {
 class LeaderInfo;
 }
+namespace mempool {
+class Mempool;
+}
 
 namespace BlockDownload {
 enum class ServerCall {
@@ -41,7 +44,8 @@ public:
     void on_fork(Conref cr);
     void on_append(Conref cr);
     void on_rollback(Conref c);
-    void on_blockreq_reply(Conref, BlockrepMsg&&, Blockrequest&);
+    void on_blockreq_reply(Conref, BlockrepView&&, Blockrequest&);
+    [[nodiscard]] std::optional<Blockrequest> on_compact_reply(Conref, CompactrepMsg&&, Blockrequest&, const mempool::Mempool&);
     void on_blockreq_expire(Conref cr);
     void on_probe_reply(Conref cr, const ProbereqMsg&, const ProberepMsg&);
     void on_probe_expire(Conref cr);
@@ -71,6 +75,8 @@ private:
     [[nodiscard]] stage_operation::StageAddOperation pop_stage_add();
     [[nodiscard]] stage_operation::StageSetOperation pop_stage_set();
     const Headerchain& headers() const;
+    // error code per body from index i0 on, 0 if valid and merkle root matches
+    std::vector<int32_t> check_bodies(const std::vector<std::span<const uint8_t>>&, NonzeroHeight lower, size_t i0) const;
     auto connections();
     bool update_reachable(bool reset = false); // returns whether reachable was actually updated
     bool has_fork_data(Conref cr)
@@ -88,6 +94,7 @@ private:
     Attorney attorney; // access chain
 
     // download target related
+    Worksum claimedWork; // by the leader, headers may be a verified prefix
     Worksum reachableWork;
     Height reachableHeight { 0 };
     Forkmap forks;
@@ -1,6 +1,9 @@
 #pragma once
 #include "block/chain/fork_range.hpp"
 #include "block/chain/height.hpp"
+#include "general/params.hpp"
+#include <algorithm>
+#include <chrono>
 #include <map>
 class Conref;
 namespace BlockDownload {
@@ -11,6 +14,65 @@ struct FocusNode;
 using FocusMap = std::map<BlockSlot, FocusNode>; // indexed by batch index
 class Downloader;
 
+// Round trip time and throughput of block requests to one peer, used to
+// size the peer's request window and to detect stalled requests.
+struct RequestStats {
+    using clock = std::chrono::steady_clock;
+    static constexpr auto targetDuration = std::chrono::seconds(2); // per request
+    static constexpr size_t minBytesPerSecond = 5000;
+
+    void on_request() { requestedAt = clock::now(); }
+    void on_reply(size_t nBlocks, size_t bytes)
+    {
+        using namespace std::chrono;
+        const auto elapsed { std::max(duration_cast<milliseconds>(clock::now() - requestedAt), 1ms) };
+        const double rate { double(bytes) * 1000.0 / double(elapsed.count()) };
+        if (samples == 0) {
+            rtt = elapsed;
+            bytesPerSecond = rate;
+        } else { // exponential moving average
+            rtt = (3 * rtt + elapsed) / 4;
+            bytesPerSecond = (3 * bytesPerSecond + rate) / 4;
+        }
+        if (nBlocks > 0)
+            bytesPerBlock = (3 * bytesPerBlock + bytes / nBlocks) / 4;
+        samples += 1;
+    }
+    void on_expire()
+    {
+        rtt = std::max(2 * rtt, std::chrono::milliseconds(targetDuration));
+        bytesPerSecond /= 4;
+    }
+
+    // number of blocks to request such that the reply takes about
+    // targetDuration, peers replying within a byte budget are asked for
+    // more than MAXBLOCKBATCHSIZE blocks when these are small
+    uint32_t window_blocks(bool budgeted) const
+    {
+        if (samples == 0)
+            return MAXBLOCKBATCHSIZE;
+        double bytes { std::max(bytesPerSecond, double(minBytesPerSecond)) * std::chrono::duration<double>(targetDuration).count() };
+        const uint32_t maxBlocks { budgeted ? MAXBLOCKRANGESIZE : MAXBLOCKBATCHSIZE };
+        if (budgeted)
+            bytes = std::min(bytes, double(MAXBLOCKREPSIZE));
+        return std::clamp(uint32_t(bytes / double(std::max(bytesPerBlock, size_t(1)))), uint32_t(1), maxBlocks);
+    }
+
+    // request takes much longer than expected
+    bool stalled() const
+    {
+        const auto expected { std::max(3 * rtt, std::chrono::milliseconds(3 * targetDuration)) };
+        return clock::now() - requestedAt > expected;
+    }
+
+private:
+    clock::time_point requestedAt;
+    std::chrono::milliseconds rtt { 0 };
+    double bytesPerSecond { 0 };
+    size_t bytesPerBlock { 1000 };
+    size_t samples { 0 };
+};
+
 struct ConnectionData {
     ConnectionData(Forkmap::iterator forkEnd, FocusMap::iterator focusEnd)
         : forkIter(forkEnd)
@@ -22,5 +84,6 @@ struct ConnectionData {
 
     std::shared_ptr<Descripted> descripted;
     ForkRange forkRange;
+    RequestStats stats;
 };
 }
@@ -1,4 +1,5 @@
 #include "focus.hpp"
+#include "asyncio/connection.hpp"
 #include "block_download.hpp"
 #include "spdlog/spdlog.h"
 
@@ -52,9 +53,33 @@ Blockrequest Focus::FocusSlot::link_request(Conref cr)
     iter->second.c = cr;
     iter->second.refs.push_back(cr);
 
-    // craft block request
+    // craft block request, sized to the peer's throughput
     auto& descripted = data(cr).descripted;
-    return Blockrequest(descripted, r, focus.headers().hash_at(r.upper));
+    auto& stats { data(cr).stats };
+    const bool budgeted { (cr->capabilities & capability::BLOCKBUDGET) != 0 };
+    const Height maxUpper { r.lower + (stats.window_blocks(budgeted) - 1) };
+    NonzeroHeight upper { std::min(r.upper, maxUpper.nonzero_assert()) };
+    if (upper == r.upper && maxUpper > r.upper) {
+        // small blocks are requested together with the following slots,
+        // which the peer must have as well
+        const Height forkBound { data(cr).forkIter->first - 1 };
+        upper = focus.link_following(iter, std::min({ maxUpper, forkBound, focus.headers().length() }), cr);
+    }
+    BlockRange range { r.lower, upper };
+    Blockrequest req(descripted, range, focus.headers().hash_at(upper));
+    stats.on_request();
+
+    // transfers of blocks just above our chain are likely in our mempool
+    constexpr uint32_t compactWindow = 5;
+    req.compact = cr->c->peer_version() >= COMPACTBLOCKSVERSION
+        && upper.value() <= focus.downloadLength.value() + compactWindow;
+    return req;
+}
+
+bool FocusNode::reassignable()
+{
+    // at most one additional peer per block batch
+    return refs.size() < 2 && data(c).stats.stalled();
 }
 
 bool Focus::has_data()
@@ -104,13 +129,34 @@ NonzeroHeight Focus::height_begin()
 void Focus::map_erase(FocusMap::iterator iter)
 {
     for (auto c : iter->second.refs) {
+        // requests spanning several slots link to their first slot
         auto& focusIter = data(c).focusIter;
-        assert(focusIter == iter);
-        focusIter = map.end();
+        if (focusIter != iter)
+            continue;
+        auto next { std::next(iter) };
+        if (next != map.end() && std::ranges::find(next->second.refs, c) != next->second.refs.end())
+            focusIter = next;
+        else
+            focusIter = map.end();
     }
     map.erase(iter);
 }
 
+NonzeroHeight Focus::link_following(FocusMap::iterator iter, Height maxUpper, Conref cr)
+{
+    NonzeroHeight upper { iter->first.upper_height().nonzero_assert() };
+    const BlockSlot end { BlockSlot(height_begin()) + width };
+    for (auto slot { iter->first + 1 }; slot < end && upper < maxUpper; ++slot) {
+        auto& node { map.try_emplace(slot).first->second };
+        if (node.blockBodies.size() > 0 || node.refs.size() > 0)
+            break;
+        node.c = cr;
+        node.refs.push_back(cr);
+        upper = std::min(slot.upper_height(), maxUpper).nonzero_assert();
+    }
+    return upper;
+}
+
 void Focus::fork(NonzeroHeight fh)
 {
     BlockSlot bs(fh);
@@ -143,17 +189,18 @@ void Focus::clear()
 void Focus::erase(Conref cr)
 {
     auto& focusIter { data(cr).focusIter };
-    if (focusIter != map.end()) {
-        // unlink from focusNode
-        auto& focusNode { focusIter->second };
+    // unlink from the consecutive focusNodes of the request
+    for (auto iter { focusIter }; iter != map.end(); ++iter) {
+        auto& focusNode { iter->second };
+        if (std::erase(focusNode.refs, cr) == 0)
+            break;
         if (focusNode.c == cr) {
             focusNode.c.clear();
         }
-        std::erase(focusNode.refs, cr);
-
-        // unlink from connection data
-        focusIter = map.end();
     }
+
+    // unlink from connection data
+    focusIter = map.end();
 }
 
 void Focus::advance(Height newOffset)
@@ -209,7 +256,19 @@ void Focus::set_offset(Height newOffset)
     }
 }
 
-void Focus::set_blocks(BlockSlot slot, Height reqBegin, std::vector<BodyContainer>&& blocks)
+void Focus::set_blocks(NonzeroHeight reqBegin, std::span<const std::span<const uint8_t>> blocks)
+{
+    while (blocks.size() > 0) {
+        const BlockSlot slot(reqBegin);
+        const size_t n { std::min(blocks.size(), size_t(slot.upper_height() - reqBegin + 1)) };
+        if (slot.upper_height() >= height_begin()) // skip slots below the focus
+            set_slot_blocks(slot, reqBegin, blocks.subspan(0, n));
+        blocks = blocks.subspan(n);
+        reqBegin = reqBegin + n;
+    }
+}
+
+void Focus::set_slot_blocks(BlockSlot slot, Height reqBegin, std::span<const std::span<const uint8_t>> blocks)
 {
     auto [iter, created] { map.try_emplace(slot) };
     FocusNode& fn { iter->second };
@@ -219,7 +278,7 @@ void Focus::set_blocks(BlockSlot slot, Height reqBegin, std::vector<BodyContaine
                 slot.lower_height().value(), reqBegin.value());
             return;
         }
-        fn.blockBodies = std::move(blocks);
+        fn.blockBodies.assign(blocks.begin(), blocks.end());
     } else { // already present
         auto& blockBodies = fn.blockBodies;
         auto missingStart = std::max(slot.lower_height(), (downloadLength + 1).nonzero_assert()) + blockBodies.size();
@@ -230,7 +289,7 @@ void Focus::set_blocks(BlockSlot slot, Height reqBegin, std::vector<BodyContaine
         }
 
         for (size_t i = missingStart - reqBegin; i < blocks.size(); ++i) {
-            blockBodies.push_back(std::move(blocks[i]));
+            blockBodies.push_back(blocks[i]);
         }
         assert(blockBodies.size() <= BLOCKBATCHSIZE);
     }
@@ -4,6 +4,7 @@
 #include "block/chain/height.hpp"
 #include "eventloop/types/conref_declaration.hpp"
 #include "eventloop/types/peer_requests.hpp"
+#include <algorithm>
 
 // #include "conr
 namespace BlockDownload {
@@ -57,6 +58,7 @@ private:
 struct FocusNode {
     std::vector<BodyContainer> blockBodies;
     bool activeRequest() { return c.valid(); }
+    bool reassignable(); // active request is stalled
     void register_downloader(Conref);
     Conref conref() const { return c; };
 
@@ -67,7 +69,10 @@ struct Focus {
     using FocusMap = std::map<BlockSlot, FocusNode>;
     Focus(const Downloader& dl, size_t windowWidth)
         : downloader(dl)
+        , minWidth(windowWidth)
         , width(windowWidth) {};
+    // number of block batches in flight grows with the number of peers
+    void adapt_width(size_t nPeers) { width = std::clamp(nPeers + 2, minWidth, 4 * minWidth); }
     bool has_data();
 
     NonzeroHeight height_begin();
@@ -77,7 +82,9 @@ struct Focus {
     void clear(); // precondition: reset all connections focusIter
     void erase(Conref cr);
     void set_offset(Height);
-    void set_blocks(BlockSlot, Height reqBegin, std::vector<BodyContainer>&& blocks);
+    // copies the retained bodies, replies to byte budgeted requests may
+    // span several slots
+    void set_blocks(NonzeroHeight reqBegin, std::span<const std::span<const uint8_t>> blocks);
 
     struct FocusSlot {
         FocusMap::iterator iter;
@@ -139,12 +146,17 @@ struct Focus {
     EndIterator end() { return {}; }
 
 private:
+    void set_slot_blocks(BlockSlot, Height reqBegin, std::span<const std::span<const uint8_t>> blocks);
+    // links the untouched slots following iter to cr, returns the upper
+    // height of the extended request
+    NonzeroHeight link_following(FocusMap::iterator iter, Height maxUpper, Conref cr);
     void advance(Height newOffset);
     void map_erase(FocusMap::iterator);
     const Headerchain& headers();
 
 private:
     const Downloader& downloader;
+    const size_t minWidth;
     size_t width;
     FocusMap map;
     Height downloadLength { 0 };
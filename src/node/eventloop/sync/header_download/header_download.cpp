@@ -2,6 +2,7 @@
 #include "block/chain/consensus_headers.hpp"
 #include "eventloop/eventloop.hpp"
 #include "eventloop/types/peer_requests.hpp"
+#include "general/task_pool.hpp"
 #include "global/globals.hpp"
 #include "probe_balanced.hpp"
 #include <set>
@@ -100,7 +101,7 @@ void Downloader::acquire_queued_batch(std::optional<Header> prev, HeaderView hv,
     auto iter = p.first;
     assert(iter->second.leaderRefs.insert(li).second);
     li->queuedIters.push_back({ prev, iter });
-    assert(li->queuedIters.size() <= pendingDepth);
+    assert(li->queuedIters.size() <= maxPendingDepth);
 }
 
 void Downloader::release_first_queued_batch(Lead_iter li)
@@ -132,7 +133,7 @@ bool Downloader::can_insert_leader(Conref cr)
     auto& d { cr.chain().descripted() };
 
     bool res = !is_leader(cr)
-        && leaderList.size() < maxLeaders // free leader slots
+        && (leaderList.size() < maxLeaders || lightest_leader()->snapshot.worksum < d->worksum()) // free or lighter slot
         && d->worksum() > minWork // provides more work
         && d->grid().valid_checkpoint() // valid checkpoint
         && (!id || id != d->descriptor); // no signed pin fail for this descriptor
@@ -151,7 +152,7 @@ bool Downloader::valid_shared_batch(const SharedBatch& sb)
             if (ptr->upper_height() < ss.height())
                 break;
             if (ptr->lower_height() <= ss.height()) {
-                if ((*ptr)[ss.height()].hash() != ss.hash)
+                if (ptr->hash(ss.height()) != ss.hash)
                     return false;
             }
         }
@@ -182,6 +183,11 @@ bool Downloader::consider_insert_leader(Conref cr)
             ? ProbeData { cr.chain().stage_fork_range(), chains.stage_pin() }
             : ProbeData { cr.chain().consensus_fork_range(), chains.consensus_pin() } };
 
+    // the heaviest claims are probed and verified concurrently, a full
+    // leader set gives up its lightest leader
+    if (leaderList.size() >= maxLeaders)
+        erase_leader(lightest_leader());
+
     Lead_iter li;
     if (pin.valid()) {
         auto vi = acquire_verifier(std::move(pin));
@@ -195,6 +201,17 @@ bool Downloader::consider_insert_leader(Conref cr)
     return true;
 }
 
+Lead_iter Downloader::lightest_leader()
+{
+    assert(!leaderList.empty());
+    auto li { leaderList.begin() };
+    for (auto i { li }; i != leaderList.end(); ++i) {
+        if (i->snapshot.worksum < li->snapshot.worksum)
+            li = i;
+    }
+    return li;
+}
+
 void Downloader::erase_leader(const Lead_iter li)
 {
     while (li->queuedIters.size() > 0)
@@ -212,7 +229,7 @@ void Downloader::queue_requests(Lead_iter li)
     auto& d = *li->snapshot.descripted;
     auto ns = li->next_slot();
     auto s = ns + li->queuedIters.size();
-    for (; s < d.grid().slot_end() && s < ns + pendingDepth; ++s) {
+    for (; s < d.grid().slot_end() && s < ns + pending_depth(); ++s) {
         if (s.index() == 0)
             acquire_queued_batch({}, d.grid()[s], li);
         else
@@ -282,7 +299,7 @@ bool Downloader::try_final_request(Lead_iter li, RequestSender& sender)
     Batchslot descriptedSlot = desc->grid().slot_end();
     assert(descriptedSlot.upper() > desc->chain_length());
     assert(descriptedSlot.offset() <= desc->chain_length());
-    Batchslot focusMaxSlot = ln.next_slot() + pendingDepth;
+    Batchslot focusMaxSlot = ln.next_slot() + pending_depth();
 
     if (focusMaxSlot >= descriptedSlot // in reach
         && desc->chain_length().incomplete_batch_size() != 0 // non-empty descripted slot
@@ -354,6 +371,10 @@ void Downloader::do_requests(RequestSender s)
             continue;
     }
 
+    // batches go to the fastest idle peer that has them
+    std::stable_sort(connections.begin(), connections.end(), [](Conref c1, Conref c2) {
+        return c1->responses.faster_than(c2->responses);
+    });
     ConnectionFinder cf(s, connections);
     for (auto& ln : leaderList) {
         for (auto& q : ln.queued()) {
@@ -425,8 +446,8 @@ void Downloader::process_final(Lead_iter li, std::vector<Offender>& out)
 
     // check header chain
     const HeaderVerifier parent { fromGenesis ? HeaderVerifier {} : (*li->verifier)->second.verifier };
-    // TODO: this is called on each new block, scans old POW again for whole batch, not good
-    auto o { parent.copy_apply(chains.signed_snapshot(), li->finalBatch.batch, heightOffset) };
+    // called on each new block, PoW of the headers seen before is cached
+    auto o { parent.copy_apply(chains.signed_snapshot(), li->finalBatch.batch, heightOffset, &task_pool(), &powCache) };
     if (!o.has_value()) {
         out.push_back({ o.error(), li->cr });
         return;
@@ -457,7 +478,7 @@ bool Downloader::advance_verifier(const Ver_iter* vi, const Lead_set& leaders, c
     auto a {
         (vi ? (*vi)->second.verifier : HeaderVerifier {})
             .copy_apply(chains.signed_snapshot(), b,
-                (vi ? (*vi)->second.sb.upper_height() : Height(0)))
+                (vi ? (*vi)->second.sb.upper_height() : Height(0)), &task_pool(), &powCache)
     };
     if (!a.has_value()) {
         for (const Lead_iter& li : leaders) {
@@ -601,6 +622,13 @@ auto Downloader::on_response(Conref cr, Batchrequest&& req, Batch&& res) -> std:
             return { ChainOffender { ChainError(EBATCHSIZE, req.selector.startHeight), cr } };
         if (qi == queuedBatches.end())
             return {};
+
+        // The grid commits to the last header, so an inner linked batch
+        // ending there is the only valid one. Checking this here blames
+        // the peer that served the batch instead of the leaders verifying
+        // it later, so batches can be fetched from arbitrary peers.
+        if (!(b.last() == qi->first) || !b.valid_inner_links())
+            return { ChainOffender { ChainError(EGRIDMISMATCH, req.selector.startHeight), cr } };
         auto& queued = qi->second;
         if (queued.batch.complete())
             return {};
@@ -626,13 +654,20 @@ auto Downloader::on_response(Conref cr, Batchrequest&& req, Batch&& res) -> std:
     LeaderInfo& li = std::get<0>(val);
     Headerchain chain { std::get<1>(val) };
     assert(chain.total_work() == std::get<2>(val));
-    set_min_worksum(chain.total_work());
+    prefixWork = chain.total_work();
+    if (prefixWork > minWork)
+        set_min_worksum(prefixWork);
     return std::tuple<LeaderInfo, Headerchain> { li, chain };
 }
 
 bool Downloader::has_data() const
 {
-    return maximizer.has_value() && std::get<2>(maximizer.value()) > minWork;
+    if (!maximizer.has_value())
+        return false;
+    auto& [li, _, worksum] { maximizer.value() };
+    if (worksum > minWork)
+        return true;
+    return worksum > prefixWork && li.descripted->worksum() > minWork;
 }
 
 bool Downloader::erase(Conref cr)
@@ -640,8 +675,10 @@ bool Downloader::erase(Conref cr)
     bool erased = std::erase(connections, cr);
 
     clear_connection_probe(cr);
-    if (maximizer.has_value() && std::get<0>(maximizer.value()).cr == cr)
+    if (maximizer.has_value() && std::get<0>(maximizer.value()).cr == cr) {
         maximizer.reset();
+        prefixWork.setzero();
+    }
     const auto& leaderIter = data(cr).leaderIter;
     if (leaderIter != leaderList.end()) {
         erase_leader(leaderIter);
@@ -656,13 +693,13 @@ bool Downloader::erase(Conref cr)
 
 void Downloader::select_leaders()
 {
-    if (leaderList.size() >= maxLeaders)
-        return;
-    for (auto cr : connections) {
-        if (consider_insert_leader(cr)
-            && leaderList.size() >= maxLeaders)
-            return;
-    }
+    // heaviest claims first such that they take the free slots
+    auto candidates { connections };
+    std::stable_sort(candidates.begin(), candidates.end(), [](Conref c1, Conref c2) {
+        return c2.chain().descripted()->worksum() < c1.chain().descripted()->worksum();
+    });
+    for (auto cr : candidates)
+        consider_insert_leader(cr);
 }
 
 void Downloader::insert(Conref cr)
@@ -725,6 +762,7 @@ void Downloader::on_signed_snapshot_update()
         auto hc { std::get<1>(*maximizer) };
         if (!chains.signed_snapshot()->compatible_inefficient(hc)) {
             maximizer.reset();
+            prefixWork.setzero();
         };
     }
     prune_leaders();
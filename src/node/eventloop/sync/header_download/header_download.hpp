@@ -2,8 +2,10 @@
 #include "../request_sender_declaration.hpp"
 #include "block/chain/consensus_headers.hpp"
 #include "block/chain/offender.hpp"
+#include "block/chain/pow_cache.hpp"
 #include "eventloop/types/conndata.hpp"
 #include "eventloop/types/peer_requests.hpp"
+#include <algorithm>
 #include <deque>
 #include <set>
 
@@ -250,6 +252,10 @@ public:
     void on_proberep(Conref c, const Proberequest& req, const ProberepMsg&);
     void on_probe_request_expire(Conref cr);
     [[nodiscard]] std::vector<ChainOffender> on_response(Conref cr, Batchrequest&&, Batch&&);
+    // Returns the verified chain with most work once it exceeds minWork.
+    // Before that, growing verified prefixes of a leader that claims more
+    // than minWork are returned such that block bodies can be downloaded
+    // while the remaining headers are verified.
     [[nodiscard]] std::optional<std::tuple<LeaderInfo, Headerchain>> pop_data();
 
 private:
@@ -278,6 +284,7 @@ private:
 
     // leader related functions
     void erase_leader(Lead_iter);
+    Lead_iter lightest_leader(); // leaderList must not be empty
     void queue_requests(Lead_iter);
     bool consider_insert_leader(Conref cr); // returns true if has effect
     bool can_insert_leader(Conref cr);
@@ -286,8 +293,12 @@ private:
 
 private: // data
     VerifierMap verifierMap;
+    PowCache powCache { 2 * HEADERBATCHSIZE }; // final batches of all leaders
     std::optional<std::tuple<LeaderInfo, HeaderchainSkeleton, Worksum>> maximizer;
-    size_t pendingDepth = 10;
+    // batches queued per leader, scales with peers serving them in parallel
+    static constexpr size_t minPendingDepth = 10;
+    static constexpr size_t maxPendingDepth = 64;
+    size_t pending_depth() const { return std::clamp(2 * connections.size(), minPendingDepth, maxPendingDepth); }
     size_t maxLeaders = 10;
 
     Lead_list leaderList;
@@ -295,5 +306,6 @@ private: // data
     std::vector<Conref> connectionsWithProbeJob;
     const StageAndConsensus& chains;
     Worksum minWork;
+    Worksum prefixWork; // of the last prefix returned by pop_data
 };
 }
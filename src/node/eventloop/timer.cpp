@@ -1,23 +1,212 @@
 #include "timer.hpp"
+#include <algorithm>
+#include <bit>
+#include <cassert>
 
+Timer::Timer()
+    : origin(std::chrono::steady_clock::now())
+{
+    for (auto& l : wheel) {
+        l.heads.fill(npos);
+        l.occupied.fill(0);
+    }
+}
+
+uint64_t Timer::to_tick(time_point tp) const
+{
+    using namespace std::chrono;
+    if (tp <= origin)
+        return 0;
+    auto d { duration_cast<nanoseconds>(tp - origin).count() };
+    return (uint64_t(d) + 999999) / 1000000;
+}
+
+Timer::time_point Timer::to_time(uint64_t tick) const
+{
+    return origin + std::chrono::milliseconds(tick);
+}
+
+auto Timer::insert(time_point expires, Event e) -> iterator
+{
+    uint32_t i;
+    if (freeList != npos) {
+        i = freeList;
+        freeList = nodes[i].next;
+    } else {
+        i = nodes.size();
+        nodes.emplace_back(Node { .expires {}, .tick { 0 }, .event { Connect {} }, .prev { npos }, .next { npos }, .level { 0 }, .slot { 0 } });
+    }
+    auto& n { nodes[i] };
+    n.expires = expires;
+    n.tick = std::max(to_tick(expires), current + 1);
+    n.event = std::move(e);
+    n.used = true;
+    place(i);
+    count += 1;
+    return { i, n.generation };
+}
+
+auto Timer::lookup(iterator iter) const -> const Node*
+{
+    if (iter.index >= nodes.size())
+        return nullptr;
+    auto& n { nodes[iter.index] };
+    if (!n.used || n.generation != iter.generation)
+        return nullptr;
+    return &n;
+}
+
+void Timer::cancel(iterator iter)
+{
+    if (!lookup(iter))
+        return;
+    unlink(iter.index);
+    auto& n { nodes[iter.index] };
+    n.used = false;
+    n.generation += 1;
+    n.next = freeList;
+    freeList = iter.index;
+    count -= 1;
+}
+
+std::optional<Timer::time_point> Timer::expiry(iterator iter) const
+{
+    if (auto n { lookup(iter) })
+        return n->expires;
+    return {};
+}
+
+void Timer::place(uint32_t i)
+{
+    auto& n { nodes[i] };
+    assert(n.tick >= current);
+    // entries beyond the range of the wheel sit in the top level and are
+    // placed again on every cascade of their slot
+    const uint64_t delta { std::min(n.tick - current, (uint64_t(1) << (levels * slotBits)) - 1) };
+    size_t level { 0 };
+    while (delta >= (uint64_t(1) << ((level + 1) * slotBits)))
+        level += 1;
+    const uint64_t tick { current + delta };
+    const size_t slot { (tick >> (level * slotBits)) & (slots - 1) };
+    auto& l { wheel[level] };
+    n.level = level;
+    n.slot = slot;
+    n.prev = npos;
+    n.next = l.heads[slot];
+    if (n.next != npos)
+        nodes[n.next].prev = i;
+    l.heads[slot] = i;
+    l.occupied[slot / 64] |= uint64_t(1) << (slot % 64);
+}
+
+void Timer::unlink(uint32_t i)
+{
+    auto& n { nodes[i] };
+    auto& l { wheel[n.level] };
+    if (n.prev != npos)
+        nodes[n.prev].next = n.next;
+    else
+        l.heads[n.slot] = n.next;
+    if (n.next != npos)
+        nodes[n.next].prev = n.prev;
+    if (l.heads[n.slot] == npos)
+        l.occupied[n.slot / 64] &= ~(uint64_t(1) << (n.slot % 64));
+}
+
+void Timer::cascade(size_t level)
+{
+    const size_t slot { (current >> (level * slotBits)) & (slots - 1) };
+    if (slot == 0 && level + 1 < levels)
+        cascade(level + 1);
+    auto& l { wheel[level] };
+    uint32_t i { l.heads[slot] };
+    l.heads[slot] = npos;
+    l.occupied[slot / 64] &= ~(uint64_t(1) << (slot % 64));
+    while (i != npos) {
+        const uint32_t next { nodes[i].next };
+        place(i);
+        i = next;
+    }
+}
+
+void Timer::expire_slot(std::vector<Event>& out)
+{
+    const size_t slot { current & (slots - 1) };
+    auto& l { wheel[0] };
+    uint32_t i { l.heads[slot] };
+    l.heads[slot] = npos;
+    l.occupied[slot / 64] &= ~(uint64_t(1) << (slot % 64));
+    const size_t begin { out.size() };
+    while (i != npos) {
+        auto& n { nodes[i] };
+        assert(n.tick <= current);
+        const uint32_t next { n.next };
+        out.push_back(std::move(n.event));
+        n.used = false;
+        n.generation += 1;
+        n.next = freeList;
+        freeList = i;
+        count -= 1;
+        i = next;
+    }
+    // slots are filled at the front, keep insertion order
+    std::reverse(out.begin() + begin, out.end());
+}
+
+size_t Timer::next_occupied(size_t level) const
+{
+    auto& occ { wheel[level].occupied };
+    const size_t from { (current >> (level * slotBits)) & (slots - 1) };
+    for (size_t d = 1; d <= slots;) {
+        const size_t s { (from + d) & (slots - 1) };
+        const uint64_t word { occ[s / 64] >> (s % 64) };
+        if (word != 0) {
+            const size_t o { d + std::countr_zero(word) };
+            return o <= slots ? o : 0;
+        }
+        d += 64 - s % 64;
+    }
+    return 0;
+}
 
 std::vector<Timer::Event> Timer::pop_expired() {
-    const auto now = std::chrono::steady_clock::now();
+    using namespace std::chrono;
+    const uint64_t now { uint64_t(std::max(duration_cast<milliseconds>(steady_clock::now() - origin).count(), int64_t(0))) };
     std::vector<Timer::Event> res;
-    for (auto iter = ordered.begin(); iter != ordered.end();) {
-        if (iter->first > now)
+    while (current < now) {
+        if (count == 0) {
+            current = now;
+            break;
+        }
+        // stop at the next occupied level 0 slot or at the next cascade
+        const uint64_t boundary { (current | (slots - 1)) + 1 };
+        const size_t d { next_occupied(0) };
+        const uint64_t target { std::min(d ? current + d : boundary, boundary) };
+        if (target > now) {
+            current = now;
             break;
-        res.push_back(iter->second);
-        ordered.erase(iter++);
+        }
+        current = target;
+        if ((current & (slots - 1)) == 0)
+            cascade(1);
+        expire_slot(res);
     }
     return res;
 }
 
-Timer::time_point Timer::next() {
-    if (ordered.empty()){
+Timer::time_point Timer::next() const {
+    if (count == 0) {
         return std::chrono::steady_clock::now()+std::chrono::days(1);
         // this does not work on docker alpine 3.15 (wait_until fires immediately)
         // return time_point::max();
     }
-    return ordered.begin()->first;
+    // exact for level 0, higher levels wake up at their cascade
+    uint64_t tick { uint64_t(-1) };
+    for (size_t level = 0; level < levels; ++level) {
+        if (size_t d { next_occupied(level) }) {
+            const size_t shift { level * slotBits };
+            tick = std::min(tick, ((current >> shift) + d) << shift);
+        }
+    }
+    return to_time(tick);
 };
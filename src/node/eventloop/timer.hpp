@@ -1,10 +1,17 @@
 #pragma once
 #include "types/peer_requests.hpp"
+#include <array>
 #include <chrono>
-#include <map>
+#include <cstdint>
+#include <optional>
 #include <variant>
 #include <vector>
 
+// Hierarchical timing wheel with millisecond ticks. Four levels of 256
+// slots cover 2^32 ms, entries cascade to lower levels when their slot
+// comes up. Insert and cancel are O(1), entries live in a slab and are
+// linked intrusively into their slot. Handles carry a generation such
+// that cancelling an expired or cancelled entry is a no-op.
 class Timer {
 
 public:
@@ -24,14 +31,24 @@ public:
     };
     struct Connect {
     };
-    using Event = std::variant<SendPing, Expire, CloseNoReply,CloseNoPong, Connect>;
+    struct RequestTxs {
+    };
+    using Event = std::variant<SendPing, Expire, CloseNoReply,CloseNoPong, Connect, RequestTxs>;
 
 private:
     using time_point = std::chrono::steady_clock::time_point;
-    using Ordered = std::multimap<time_point, Event>;
+    static constexpr uint32_t npos = uint32_t(-1);
+    static constexpr size_t levels = 4;
+    static constexpr size_t slotBits = 8;
+    static constexpr size_t slots = size_t(1) << slotBits;
 
 public:
-    using iterator = Ordered::iterator;
+    struct iterator {
+        uint32_t index { npos };
+        uint32_t generation { 0 };
+        bool operator==(const iterator&) const = default;
+    };
+    Timer();
     // Methods
 
     template <typename _Rep, typename _Period>
@@ -39,19 +56,44 @@ public:
         auto expires = std::chrono::steady_clock::now() + duration;
         return insert(expires,e);
     }
-    auto insert(std::chrono::steady_clock::time_point expires, Event e){
-        return ordered.emplace(expires,e);
-    }
-    void cancel(Timer::iterator iter)
-    {
-        if (iter != ordered.end())
-            ordered.erase(iter);
-    }
-    iterator end() { return ordered.end(); }
+    iterator insert(time_point expires, Event e);
+    void cancel(iterator);
+    std::optional<time_point> expiry(iterator) const;
+    iterator end() const { return {}; }
     std::vector<Event> pop_expired();
-    time_point next();
+    time_point next() const;
+    size_t size() const { return count; }
 
 private:
-    Ordered ordered;
-};
+    struct Node {
+        time_point expires;
+        uint64_t tick;
+        Event event;
+        uint32_t prev;
+        uint32_t next;
+        uint32_t generation { 0 };
+        uint8_t level;
+        uint8_t slot;
+        bool used { false };
+    };
+    struct Level {
+        std::array<uint32_t, slots> heads;
+        std::array<uint64_t, slots / 64> occupied;
+    };
+    uint64_t to_tick(time_point) const; // rounds up
+    time_point to_time(uint64_t tick) const;
+    const Node* lookup(iterator) const;
+    void place(uint32_t i); // links node into its slot relative to current
+    void unlink(uint32_t i);
+    void cascade(size_t level);
+    void expire_slot(std::vector<Event>& out);
+    // offset in [1,slots] of the next occupied slot after the current one, 0 if none
+    size_t next_occupied(size_t level) const;
 
+    const time_point origin;
+    uint64_t current { 0 }; // last processed tick
+    size_t count { 0 };
+    std::array<Level, levels> wheel;
+    std::vector<Node> nodes;
+    uint32_t freeList { npos };
+};
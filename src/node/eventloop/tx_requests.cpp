@@ -0,0 +1,130 @@
+#include "tx_requests.hpp"
+#include "communication/messages.hpp"
+#include <algorithm>
+
+void TxRequests::announced(uint64_t conId, const std::vector<TransactionId>& txids)
+{
+    for (auto& txid : txids) {
+        auto& e { entries[txid] };
+        if (std::find(e.announcers.begin(), e.announcers.end(), conId) == e.announcers.end())
+            e.announcers.push_back(conId);
+        if (!e.assigned)
+            ready.insert(txid);
+    }
+}
+
+bool TxRequests::on_reply(uint64_t conId, const std::vector<bool>& delivered)
+{
+    auto iter { pending.find(conId) };
+    if (iter == pending.end())
+        return false;
+    Pending p { std::move(iter->second.front()) };
+    iter->second.pop_front();
+    if (iter->second.empty())
+        pending.erase(iter);
+
+    for (size_t i = 0; i < p.txids.size(); ++i) {
+        auto& txid { p.txids[i] };
+        if (i < delivered.size() && delivered[i]) {
+            entries.erase(txid);
+            ready.erase(txid);
+        } else if (!p.expired) {
+            unassign(txid, conId);
+        }
+    }
+    return true;
+}
+
+void TxRequests::erase(uint64_t conId)
+{
+    pending.erase(conId);
+    for (auto iter = entries.begin(); iter != entries.end();) {
+        auto& e { iter->second };
+        std::erase(e.announcers, conId);
+        if (e.assigned == conId)
+            e.assigned.reset();
+        if (e.announcers.empty()) {
+            ready.erase(iter->first);
+            iter = entries.erase(iter);
+            continue;
+        }
+        if (!e.assigned)
+            ready.insert(iter->first);
+        ++iter;
+    }
+}
+
+void TxRequests::unassign(const TransactionId& txid, uint64_t conId)
+{
+    auto iter { entries.find(txid) };
+    if (iter == entries.end() || iter->second.assigned != conId)
+        return;
+    auto& e { iter->second };
+    e.assigned.reset();
+    std::erase(e.announcers, conId);
+    if (e.announcers.empty())
+        entries.erase(iter);
+    else
+        ready.insert(txid);
+}
+
+void TxRequests::expire(time_point now)
+{
+    for (auto& [conId, requests] : pending) {
+        for (auto& p : requests) {
+            if (p.expired)
+                continue;
+            if (now < p.expires)
+                break;
+            p.expired = true; // kept to match the late reply
+            for (auto& txid : p.txids)
+                unassign(txid, conId);
+        }
+    }
+}
+
+auto TxRequests::pop_requests(time_point now) -> Batches
+{
+    expire(now);
+    std::map<uint64_t, std::vector<TransactionId>> batches;
+    auto available = [&](uint64_t conId) {
+        auto b { batches.find(conId) };
+        if (b != batches.end())
+            return b->second.size() < TxreqMsg::MAXENTRIES;
+        auto p { pending.find(conId) };
+        return p == pending.end() || p->second.size() < MAXPENDING;
+    };
+    for (auto iter = ready.begin(); iter != ready.end();) {
+        auto& e { entries.at(*iter) };
+        auto a { std::find_if(e.announcers.begin(), e.announcers.end(), available) };
+        if (a == e.announcers.end()) {
+            ++iter;
+            continue;
+        }
+        e.assigned = *a;
+        batches[*a].push_back(*iter);
+        iter = ready.erase(iter);
+    }
+
+    Batches out;
+    for (auto& [conId, txids] : batches) {
+        pending[conId].push_back({ now + timeout, txids });
+        out.push_back({ conId, std::move(txids) });
+    }
+    return out;
+}
+
+auto TxRequests::wakeup_time() const -> std::optional<time_point>
+{
+    std::optional<time_point> res;
+    for (auto& [_, requests] : pending) {
+        for (auto& p : requests) {
+            if (p.expired)
+                continue;
+            if (!res || p.expires < *res)
+                res = p.expires;
+            break;
+        }
+    }
+    return res;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include "block/body/transaction_id.hpp"
+#include <chrono>
+#include <deque>
+#include <map>
+#include <optional>
+#include <set>
+#include <vector>
+
+// Schedules TxreqMsg across peers. Each announced transaction id is
+// requested from one announcer at a time, the others are kept as fallbacks
+// in case that peer does not deliver before the request expires.
+class TxRequests {
+    using time_point = std::chrono::steady_clock::time_point;
+
+public:
+    static constexpr auto timeout { std::chrono::seconds(10) };
+    static constexpr size_t MAXPENDING = 4; // outstanding TxreqMsg per peer
+    using Batches = std::vector<std::pair<uint64_t, std::vector<TransactionId>>>;
+
+    // ids must be filtered by Mempool::filter_new
+    void announced(uint64_t conId, const std::vector<TransactionId>&);
+    // reply to the oldest pending request of that peer, false if unrequested
+    [[nodiscard]] bool on_reply(uint64_t conId, const std::vector<bool>& delivered);
+    void erase(uint64_t conId);
+
+    // assigns ready ids to announcers, one maximal batch per peer
+    [[nodiscard]] Batches pop_requests(time_point now);
+    [[nodiscard]] std::optional<time_point> wakeup_time() const;
+
+private:
+    struct Entry {
+        std::vector<uint64_t> announcers;
+        std::optional<uint64_t> assigned;
+    };
+    struct Pending {
+        time_point expires;
+        std::vector<TransactionId> txids;
+        bool expired { false };
+    };
+    void unassign(const TransactionId&, uint64_t conId);
+    void expire(time_point now);
+
+    std::map<TransactionId, Entry> entries;
+    std::set<TransactionId> ready; // not assigned to any peer
+    std::map<uint64_t, std::deque<Pending>> pending;
+};
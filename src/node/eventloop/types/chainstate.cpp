@@ -10,7 +10,10 @@ ConsensusSlave::ConsensusSlave(std::optional<SignedSnapshot> sp, Descriptor desc
 
 std::pair<Height, AppendMsg> ConsensusSlave::apply(Append&& append)
 {
+    const size_t completeBefore { headerchain->complete_batches().size() };
     auto res { headerchain->apply_append(std::move(append.headerchainAppend)) };
+    if (headerchain->complete_batches().size() != completeBefore)
+        gridCache.reset();
 
     // signed snapshot
     if (append.signedSnapshot) {
@@ -27,6 +30,7 @@ ForkMsg ConsensusSlave::apply(Fork&& fork)
         *pinGenerator = std::move(fork.prevChain);
     }
     pinGenerator.reset();
+    gridCache.reset();
     auto res { headerchain->apply_fork(std::move(fork)) };
 
     // signed snapshot
@@ -48,6 +52,7 @@ auto ConsensusSlave::apply(const RollbackData& rd) -> std::optional<SignedPinRol
     if (rd.data) {
         descriptor_ = rd.data->rollback.descriptor;
         headerchain->shrink(rd.data->rollback.shrinkLength);
+        gridCache.reset();
 
         // prevChain
         if (pinGenerator.use_count() > 1) {
@@ -68,6 +73,13 @@ auto ConsensusSlave::apply(const RollbackData& rd) -> std::optional<SignedPinRol
     return res;
 };
 
+const Grid& ConsensusSlave::grid() const
+{
+    if (!gridCache)
+        gridCache = headerchain->grid();
+    return *gridCache;
+}
+
 Headerchain::pin_t ConsensusSlave::get_pin() const
 {
     if (!pinGenerator) {
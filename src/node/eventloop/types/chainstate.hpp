@@ -20,7 +20,8 @@ public:
         return *headerchain;
     }
     Headerchain::pin_t get_pin() const;
-    Grid grid() const{ return headerchain->grid();};
+    // cached, rebuilt after a batch completes or the chain forks
+    const Grid& grid() const;
 
     const SignedSnapshot::Priority get_signed_snapshot_priority() const;
     const auto& get_signed_snapshot() const { return signedSnapshot; }
@@ -34,4 +35,5 @@ private:
     Descriptor descriptor_ {0};
     std::shared_ptr<Headerchain> headerchain;
     mutable std::shared_ptr<std::shared_ptr<Headerchain>> pinGenerator;
+    mutable std::optional<Grid> gridCache;
 };
@@ -1,9 +1,11 @@
 #pragma once
 
+#include "eventloop/address_manager/rolling_filter.hpp"
 #include "eventloop/peer_chain.hpp"
 #include "eventloop/sync/block_download/connection_data.hpp"
 #include "eventloop/sync/header_download/connection_data.hpp"
 #include "eventloop/timer.hpp"
+#include "mempool/reconciliation.hpp"
 #include "mempool/subscription_declaration.hpp"
 
 class Timerref {
@@ -142,11 +144,15 @@ private:
         using type = Proberequest;
     };
 
-    template <std::same_as<BatchrepMsg> T>
+    template <std::same_as<BatchrepView> T>
     struct typemap<T> {
         using type = Batchrequest;
     };
-    template <std::same_as<BlockrepMsg> T>
+    template <std::same_as<BlockrepView> T>
+    struct typemap<T> {
+        using type = Blockrequest;
+    };
+    template <std::same_as<CompactrepMsg> T>
     struct typemap<T> {
         using type = Blockrequest;
     };
@@ -187,6 +193,119 @@ private:
     std::optional<PingMsg> data;
 };
 
+// Request timeout after RFC 6298 from the reply times of one request type,
+// doubled on every expiry until the next reply.
+class RttEstimator {
+    using milliseconds = std::chrono::milliseconds;
+
+public:
+    static constexpr milliseconds initial { 30000 };
+    static constexpr milliseconds lower { 2000 };
+    static constexpr milliseconds upper { 60000 };
+    void on_reply(double ms)
+    {
+        if (samples == 0) {
+            srtt = ms;
+            rttvar = ms / 2;
+        } else {
+            rttvar = 0.75 * rttvar + 0.25 * std::abs(srtt - ms);
+            srtt = 0.875 * srtt + 0.125 * ms;
+        }
+        samples += 1;
+        backoff = 1;
+    }
+    void on_expire() { backoff = std::min(2 * backoff, 8u); }
+    milliseconds timeout() const
+    {
+        const double ms { samples == 0 ? double(initial.count()) : srtt + 4 * rttvar };
+        return std::clamp(milliseconds(int64_t(ms * backoff)), lower, upper);
+    }
+
+private:
+    double srtt { 0 };
+    double rttvar { 0 };
+    size_t samples { 0 };
+    uint32_t backoff { 1 };
+};
+
+// Reply latency and throughput of header batch, block and probe requests
+// as exponential moving averages, used to route requests to fast peers,
+// and adaptive timeouts per request type. Expired requests count as slow
+// replies.
+struct ResponseStats {
+    using clock = std::chrono::steady_clock;
+    template <typename T>
+    void on_request()
+    {
+        requestedAt = clock::now();
+        kind = kind_of<T>();
+    }
+    void on_reply(size_t bytes)
+    {
+        const double ms { std::max(elapsed_ms(), 1.0) };
+        rtt[kind].on_reply(ms);
+        add_sample(ms, double(bytes) * 1000.0 / ms);
+        expiredInRow = 0;
+    }
+    void on_expire()
+    {
+        rtt[kind].on_expire();
+        add_sample(std::max(elapsed_ms(), 2 * latencyMs), 0);
+        expiredInRow += 1;
+    }
+    // after this time the request is also assigned to other peers
+    template <typename T>
+    std::chrono::milliseconds timeout() const { return rtt[kind_of<T>()].timeout(); }
+
+    // peers without replies rank between fast and slow ones
+    double latency_ms() const { return samples > 0 ? latencyMs : 1000.0; }
+    double bytes_per_second() const { return bytesPerSecond; }
+    bool faster_than(const ResponseStats& other) const
+    {
+        return latency_ms() < other.latency_ms();
+    }
+    bool persistently_slow() const
+    {
+        return expiredInRow >= 3 || (samples >= 8 && latencyMs > 15000.0);
+    }
+
+private:
+    template <typename T>
+    static constexpr size_t kind_of()
+    {
+        if constexpr (std::is_same_v<T, Proberequest>)
+            return 0;
+        else if constexpr (std::is_same_v<T, Batchrequest>)
+            return 1;
+        else {
+            static_assert(std::is_same_v<T, Blockrequest>);
+            return 2;
+        }
+    }
+    double elapsed_ms() const
+    {
+        return std::chrono::duration<double, std::milli>(clock::now() - requestedAt).count();
+    }
+    void add_sample(double ms, double rate)
+    {
+        if (samples == 0) {
+            latencyMs = ms;
+            bytesPerSecond = rate;
+        } else {
+            latencyMs = (3 * latencyMs + ms) / 4;
+            bytesPerSecond = (3 * bytesPerSecond + rate) / 4;
+        }
+        samples += 1;
+    }
+    clock::time_point requestedAt;
+    size_t kind { 0 };
+    std::array<RttEstimator, 3> rtt;
+    double latencyMs { 0 };
+    double bytesPerSecond { 0 };
+    size_t samples { 0 };
+    size_t expiredInRow { 0 };
+};
+
 struct Ratelimit {
     using sc = std::chrono::steady_clock;
     void update() { valid_rate(lastUpdate, std::chrono::minutes(2)); }
@@ -225,8 +344,12 @@ struct PeerState {
     SignedSnapshot::Priority acknowledgedSnapshotPriority;
     SignedSnapshot::Priority theirSnapshotPriority;
     uint32_t lastNonce;
+    uint8_t capabilities { 0 }; // announced in the peer's InitMsg
+    mempool::ReconState txrecon;
     bool verifiedEndpoint = false;
+    address_manager::RollingAddressFilter knownAddresses { 256 }; // sent by or to the peer
     Ping ping;
+    ResponseStats responses;
     Usage usage;
     friend class Eventloop;
     friend class BlockDownload::Downloader;
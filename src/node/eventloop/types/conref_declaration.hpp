@@ -6,6 +6,7 @@ struct PeerState;
 class PeerChain;
 class Connection;
 class Sndbuffer;
+class SharedSndbuffer;
 using Conndatamap = std::map<uint64_t, PeerState>;
 using Coniter = Conndatamap::iterator;
 
@@ -29,6 +30,7 @@ public:
     void clear() { data.val = 0; }
     inline bool initialized();
     void send(Sndbuffer);
+    void send(const SharedSndbuffer&);
     Conref()
         : data({ .val = 0ul })
     {
@@ -7,7 +7,6 @@
 #include <chrono>
 #include <memory>
 struct IsRequest {
-    static constexpr auto expiry_time = std::chrono::seconds(30);
     bool isActiveRequest = true;
     void unref_active_requests(size_t& activeRequests)
     {
@@ -43,6 +42,8 @@ struct Blockrequest : public BlockreqMsg, public IsRequest {
     }
     std::shared_ptr<Descripted> descripted;
     Hash upperHash;
+    bool compact = false; // sent as CompactreqMsg
+    std::vector<uint32_t> prefill;
 };
 
 struct Batchrequest : public BatchreqMsg, public IsRequest {
@@ -0,0 +1,150 @@
+#include "block_latency.hpp"
+#include "metrics.hpp"
+#include <deque>
+#include <map>
+#include <mutex>
+
+namespace block_latency {
+namespace {
+    using namespace std::chrono;
+    constexpr size_t maxOpen { 16 };
+    constexpr size_t maxRecent { 100 };
+    constexpr auto maxAge { minutes(2) }; // unfinished traces are closed after
+
+    metrics::Histogram& histogram(Stage s)
+    {
+        static auto hs { [] {
+            std::array<metrics::Histogram*, nStages> res;
+            for (size_t i = 0; i < nStages; ++i)
+                res[i] = &metrics::histogram("warthog_block_latency_seconds",
+                    "Time from the first sighting of a new chain head to each processing stage",
+                    { { "stage", name(Stage(i)) } });
+            return res;
+        }() };
+        return *hs[size_t(s)];
+    }
+
+    class Tracer {
+    public:
+        void begin(NonzeroHeight h, Stage s)
+        {
+            const auto now { steady_clock::now() };
+            std::lock_guard l(m);
+            if (h.value() <= finishedThrough)
+                return;
+            auto [iter, inserted] { open.try_emplace(h.value()) };
+            auto& r { iter->second };
+            if (inserted) {
+                r.trace.height = h;
+                r.trace.started = system_clock::now();
+                r.begin = now;
+            }
+            set(r, s, now);
+            while (open.size() > maxOpen || (open.size() > 1 && now - open.begin()->second.begin > maxAge))
+                finish(open.begin());
+        }
+        void mark(Stage s, NonzeroHeight lower, NonzeroHeight upper)
+        {
+            const auto now { steady_clock::now() };
+            std::lock_guard l(m);
+            for (auto iter { open.lower_bound(lower.value()) }; iter != open.end() && iter->first <= upper.value();)
+                set_finish(iter++, s, now);
+        }
+        void mark_through(Stage s, Height h)
+        {
+            const auto now { steady_clock::now() };
+            std::lock_guard l(m);
+            for (auto iter { open.begin() }; iter != open.end() && iter->first <= h.value();)
+                set_finish(iter++, s, now);
+        }
+        std::vector<Trace> recent_traces()
+        {
+            std::lock_guard l(m);
+            std::vector<Trace> res;
+            for (auto iter { open.rbegin() }; iter != open.rend(); ++iter)
+                res.push_back(iter->second.trace);
+            res.insert(res.end(), recent.rbegin(), recent.rend());
+            return res;
+        }
+
+    private:
+        struct Record {
+            Trace trace { NonzeroHeight(1u), {}, {} };
+            steady_clock::time_point begin;
+        };
+        using Iter = std::map<uint32_t, Record>::iterator;
+        static void set(Record& r, Stage s, steady_clock::time_point now)
+        {
+            auto& d { r.trace.stages[size_t(s)] };
+            if (!d)
+                d = now - r.begin;
+        }
+        void set_finish(Iter iter, Stage s, steady_clock::time_point now)
+        {
+            set(iter->second, s, now);
+            if (s == Stage::Template)
+                finish(iter);
+        }
+        void finish(Iter iter)
+        {
+            auto& t { iter->second.trace };
+            for (size_t i = 0; i < nStages; ++i)
+                if (t.stages[i])
+                    histogram(Stage(i)).observe(*t.stages[i]);
+            finishedThrough = std::max(finishedThrough, iter->first);
+            recent.push_back(std::move(t));
+            if (recent.size() > maxRecent)
+                recent.pop_front();
+            open.erase(iter);
+        }
+
+        std::mutex m;
+        std::map<uint32_t, Record> open; // by height
+        std::deque<Trace> recent;
+        uint32_t finishedThrough { 0 };
+    } tracer;
+}
+
+std::string_view name(Stage s)
+{
+    switch (s) {
+    case Stage::Announced:
+        return "announced";
+    case Stage::Requested:
+        return "requested";
+    case Stage::Received:
+        return "received";
+    case Stage::Staged:
+        return "staged";
+    case Stage::Applied:
+        return "applied";
+    case Stage::Committed:
+        return "committed";
+    case Stage::Relayed:
+        return "relayed";
+    case Stage::Template:
+        return "template";
+    }
+    return "";
+}
+
+void begin(NonzeroHeight h, Stage s)
+{
+    tracer.begin(h, s);
+}
+
+void mark(Stage s, NonzeroHeight lower, NonzeroHeight upper)
+{
+    tracer.mark(s, lower, upper);
+}
+
+void mark_through(Stage s, Height h)
+{
+    tracer.mark_through(s, h);
+}
+
+std::vector<Trace> recent()
+{
+    return tracer.recent_traces();
+}
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include "block/chain/height.hpp"
+#include <array>
+#include <chrono>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+// Per block latency traces of new chain heads, from the first announcement
+// (or push, or local mining) to the relay of the appended chain and the
+// new mining template. Blocks are traced by height, only heights close to
+// the chain head are started such that sync is not traced. Each stage is
+// observed as time since the first stage in the histogram
+// warthog_block_latency_seconds, completed traces are kept for the API.
+namespace block_latency {
+enum class Stage : uint8_t {
+    Announced, // first append message of a peer
+    Requested, // block request sent
+    Received, // block body received (or pushed)
+    Staged, // handed to the chainserver
+    Applied, // appended to the chain state
+    Committed, // database commit
+    Relayed, // append sent to peers
+    Template, // mining template updated, completes the trace
+};
+constexpr size_t nStages { size_t(Stage::Template) + 1 };
+std::string_view name(Stage);
+
+// starts tracing a new head at height h, marks the stage if traced already
+void begin(NonzeroHeight h, Stage);
+// marks traced heights in [lower, upper] for which the stage is not marked yet
+void mark(Stage, NonzeroHeight lower, NonzeroHeight upper);
+inline void mark(Stage s, NonzeroHeight h) { mark(s, h, h); }
+// marks all traced heights up to h
+void mark_through(Stage, Height h);
+
+struct Trace {
+    NonzeroHeight height;
+    std::chrono::system_clock::time_point started;
+    std::array<std::optional<std::chrono::steady_clock::duration>, nStages> stages; // since started
+};
+// most recent traces first, unfinished traces included
+std::vector<Trace> recent();
+}
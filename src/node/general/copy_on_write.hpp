@@ -0,0 +1,46 @@
+#pragma once
+#include <memory>
+
+// Value with shared immutable storage. Copies are O(1) and share the data,
+// the first modification through mut() of a shared value copies it. A
+// default constructed or moved-from value is empty.
+template <typename T>
+class CopyOnWrite {
+public:
+    CopyOnWrite() = default;
+    CopyOnWrite(T t)
+        : p(std::make_shared<T>(std::move(t)))
+    {
+    }
+    CopyOnWrite& operator=(T t)
+    {
+        if (p && p.use_count() == 1)
+            *p = std::move(t);
+        else
+            p = std::make_shared<T>(std::move(t));
+        return *this;
+    }
+
+    const T& operator*() const { return p ? *p : empty(); }
+    const T* operator->() const { return &operator*(); }
+
+    // the use count cannot increase concurrently because copies are only
+    // made from this instance by its owner
+    T& mut()
+    {
+        if (!p)
+            p = std::make_shared<T>();
+        else if (p.use_count() != 1)
+            p = std::make_shared<T>(*p);
+        return *p;
+    }
+    void reset() { p.reset(); }
+
+private:
+    static const T& empty()
+    {
+        static const T e;
+        return e;
+    }
+    std::shared_ptr<T> p;
+};
@@ -0,0 +1,83 @@
+#pragma once
+#include <atomic>
+#include <coroutine>
+#include <functional>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+
+// C++20 coroutines over the callback interfaces of the chainserver and
+// eventloop queues. A coroutine returning coro::Detached starts eagerly
+// and frees its frame when it returns, inside it
+//
+//     auto head { co_await coro::call(get_block_head) };
+//
+// issues the query and resumes on the thread that answers it, such that
+// several queries compose without nested callbacks. The continuation
+// handed to the queue only captures a pointer to the awaiter in the
+// coroutine frame and fits the small buffer of std::function, the frame
+// is the only allocation of the request. Queues must answer every query,
+// a dropped callback leaks the frame.
+namespace coro {
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() noexcept { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept { }
+        void unhandled_exception() { throw; } // like a throwing callback
+    };
+};
+
+namespace detail {
+    template <typename Cb>
+    struct callback_arg;
+    template <typename A>
+    struct callback_arg<std::function<void(A)>> {
+        using type = std::remove_cvref_t<A>;
+    };
+    template <typename... P>
+    using last_t = std::remove_cvref_t<std::tuple_element_t<sizeof...(P) - 1, std::tuple<P...>>>;
+}
+
+template <typename Cb, typename Start>
+class Awaiter {
+public:
+    using value_type = typename detail::callback_arg<Cb>::type;
+    explicit Awaiter(Start start)
+        : start(std::move(start))
+    {
+    }
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(std::coroutine_handle<> h)
+    {
+        handle = h;
+        start(Cb([this](auto& v) {
+            value.emplace(v);
+            if (completed.exchange(true))
+                handle.resume();
+        }));
+        // the callback may have run already, then we continue here
+        return !completed.exchange(true);
+    }
+    value_type await_resume() { return std::move(*value); }
+
+private:
+    Start start;
+    std::coroutine_handle<> handle;
+    std::optional<value_type> value;
+    std::atomic<bool> completed { false };
+};
+
+// awaitable calling f(args..., callback), the callback type is the last
+// parameter of f and the awaited value its argument
+template <typename... P, typename... A>
+auto call(void (*f)(P...), A&&... args)
+{
+    using Cb = detail::last_t<P...>;
+    auto start { [f, ... args = std::forward<A>(args)](Cb&& cb) mutable {
+        f(std::move(args)..., std::move(cb));
+    } };
+    return Awaiter<Cb, decltype(start)>(std::move(start));
+}
+}
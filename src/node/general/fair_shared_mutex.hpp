@@ -0,0 +1,25 @@
+#pragma once
+#include <mutex>
+#include <shared_mutex>
+
+// Shared mutex that does not starve exclusive lockers: a pending
+// exclusive lock holds the gate, so no new shared locks are granted.
+class FairSharedMutex {
+public:
+    void lock()
+    {
+        std::lock_guard g(gate);
+        m.lock();
+    }
+    void unlock() { m.unlock(); }
+    void lock_shared()
+    {
+        std::lock_guard g(gate);
+        m.lock_shared();
+    }
+    void unlock_shared() { m.unlock_shared(); }
+
+private:
+    std::mutex gate;
+    std::shared_mutex m;
+};
@@ -0,0 +1,54 @@
+#include "logging.hpp"
+#include "spdlog/async.h"
+#include "spdlog/sinks/rotating_file_sink.h"
+#include "spdlog/sinks/stdout_color_sinks.h"
+#include "spdlog/spdlog.h"
+
+namespace {
+constexpr size_t queueSize { 8192 };
+}
+
+void init_logging()
+{
+    spdlog::init_thread_pool(queueSize, 1);
+    auto logger { std::make_shared<spdlog::async_logger>("warthog",
+        std::make_shared<spdlog::sinks::stdout_color_sink_mt>(), spdlog::thread_pool(),
+        spdlog::async_overflow_policy::overrun_oldest) };
+    spdlog::set_default_logger(std::move(logger));
+    spdlog::flush_every(std::chrono::seconds(1));
+}
+
+void shutdown_logging()
+{
+    spdlog::shutdown();
+}
+
+std::shared_ptr<spdlog::logger> rotating_file_logger(const std::string& name, const std::string& path)
+{
+    constexpr size_t maxSize { 1048576 * 5 }; // 5 MB
+    constexpr size_t maxFiles { 3 };
+    return spdlog::rotating_logger_mt<spdlog::async_factory_nonblock>(name, path, maxSize, maxFiles);
+}
+
+bool LogLimiter::allow()
+{
+    size_t dropped { 0 };
+    {
+        std::lock_guard l(m);
+        auto now { clock::now() };
+        if (tokens < burst) {
+            const auto refill { (now - refilled) / period };
+            tokens = std::min(burst, tokens + size_t(refill));
+            refilled = (tokens == burst ? now : refilled + refill * period);
+        }
+        if (tokens == 0) {
+            suppressed += 1;
+            return false;
+        }
+        tokens -= 1;
+        std::swap(dropped, suppressed);
+    }
+    if (dropped > 0)
+        spdlog::info("Suppressed {} log messages ({})", dropped, site);
+    return true;
+}
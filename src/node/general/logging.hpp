@@ -0,0 +1,43 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace spdlog {
+class logger;
+}
+
+// Log messages are formatted on the calling thread and written to the
+// sinks by a dedicated thread. When the bounded queue is full the oldest
+// messages are dropped instead of blocking the caller.
+void init_logging();
+void shutdown_logging(); // flushes the queue
+std::shared_ptr<spdlog::logger> rotating_file_logger(const std::string& name, const std::string& path);
+
+// Token bucket for log sites that fire per message, per transaction or per
+// connection. Allows burst messages at once and refills one per period.
+// Suppressed messages are counted and reported when the site logs again.
+class LogLimiter {
+    using clock = std::chrono::steady_clock;
+
+public:
+    LogLimiter(const char* site, size_t burst = 20, clock::duration period = std::chrono::milliseconds(100))
+        : site(site)
+        , burst(burst)
+        , period(period)
+        , tokens(burst)
+    {
+    }
+    [[nodiscard]] bool allow();
+
+private:
+    const char* site;
+    const size_t burst;
+    const clock::duration period;
+    std::mutex m;
+    size_t tokens;
+    size_t suppressed { 0 };
+    clock::time_point refilled { clock::now() };
+};
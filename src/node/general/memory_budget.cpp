@@ -0,0 +1,158 @@
+#include "memory_budget.hpp"
+#include <chrono>
+#include <deque>
+#include <mutex>
+
+namespace memory_budget {
+class Budget {
+public:
+    static Budget& instance()
+    {
+        static Budget b;
+        return b;
+    }
+    Component& component(std::string_view name, uint32_t priority, size_t minBytes)
+    {
+        std::lock_guard l(m);
+        for (auto& c : components)
+            if (c.name == name)
+                return c;
+        auto& c { components.emplace_back(name, priority, minBytes) };
+        rebalance_locked();
+        return c;
+    }
+    void set_total(size_t bytes)
+    {
+        std::lock_guard l(m);
+        total = bytes;
+        rebalance_locked();
+    }
+    void maybe_rebalance()
+    {
+        using namespace std::chrono;
+        const int64_t now { duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count() };
+        int64_t last { lastRebalance.load(std::memory_order_relaxed) };
+        if (now - last < 10000 || !lastRebalance.compare_exchange_strong(last, now))
+            return;
+        std::lock_guard l(m);
+        rebalance_locked();
+    }
+    Report report()
+    {
+        std::lock_guard l(m);
+        Report r;
+        if (total != 0)
+            r.total = total;
+        for (auto& c : components) {
+            r.components.push_back({ .name { c.name },
+                .priority { c.priority },
+                .usage { c.usage() },
+                .limit {} });
+            if (c.priority != 0 && total != 0)
+                r.components.back().limit = c.limit();
+        }
+        return r;
+    }
+
+private:
+    static void set_limit(Component& c, size_t bytes)
+    {
+        c.limitBytes.store(bytes, std::memory_order_relaxed);
+        c.limitGauge.set(int64_t(std::min(bytes, size_t(std::numeric_limits<int64_t>::max()))));
+    }
+    void rebalance_locked()
+    {
+        constexpr size_t unlimited { std::numeric_limits<size_t>::max() };
+        std::vector<Component*> open;
+        double remaining { double(total) };
+        for (auto& c : components) {
+            if (c.priority == 0)
+                remaining -= double(c.usage());
+            else
+                open.push_back(&c);
+        }
+        if (total == 0) {
+            for (auto* c : open)
+                set_limit(*c, unlimited);
+            return;
+        }
+        remaining = std::max(remaining, 0.0);
+
+        // components close to their limit are assumed to want more
+        auto demand = [](const Component& c) -> double {
+            const size_t u { c.usage() };
+            if (u >= c.limit() / 10 * 9)
+                return std::numeric_limits<double>::infinity();
+            return double(std::max(c.minBytes, u + u / 4));
+        };
+        std::vector<std::pair<Component*, double>> assigned;
+        while (!open.empty()) {
+            double weights { 0 };
+            for (auto* c : open)
+                weights += c->priority;
+            const double pool { remaining };
+            bool satisfied { false };
+            std::erase_if(open, [&](Component* c) {
+                const double d { demand(*c) };
+                if (d > pool * c->priority / weights)
+                    return false;
+                assigned.push_back({ c, d });
+                remaining -= d;
+                satisfied = true;
+                return true;
+            });
+            if (!satisfied) {
+                for (auto* c : open)
+                    assigned.push_back({ c, remaining * c->priority / weights });
+                remaining = 0;
+                break;
+            }
+        }
+
+        // room to grow for everyone if all demands are met
+        double weights { 0 };
+        for (auto& [c, _] : assigned)
+            weights += c->priority;
+        for (auto& [c, bytes] : assigned)
+            set_limit(*c, std::max(c->minBytes, size_t(bytes + remaining * c->priority / weights)));
+    }
+
+    std::mutex m;
+    std::deque<Component> components; // stable addresses
+    size_t total { 0 };
+    std::atomic<int64_t> lastRebalance { 0 };
+};
+
+Component::Component(std::string_view name, uint32_t priority, size_t minBytes)
+    : name(name)
+    , priority(priority)
+    , minBytes(minBytes)
+    , usageGauge(metrics::gauge("warthog_memory_usage_bytes",
+          "Approximate memory usage by component", { { "component", name } }))
+    , limitGauge(metrics::gauge("warthog_memory_limit_bytes",
+          "Memory limit assigned to the component by the budget", { { "component", name } }))
+{
+}
+
+void Component::set_usage(size_t bytes)
+{
+    usageBytes.store(bytes, std::memory_order_relaxed);
+    usageGauge.set(int64_t(bytes));
+    Budget::instance().maybe_rebalance();
+}
+
+Component& component(std::string_view name, uint32_t priority, size_t minBytes)
+{
+    return Budget::instance().component(name, priority, minBytes);
+}
+
+void set_total(size_t bytes)
+{
+    Budget::instance().set_total(bytes);
+}
+
+Report report()
+{
+    return Budget::instance().report();
+}
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include "metrics.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Process wide memory budget (config memory.budget) shared by the caches
+// and the mempool. Components report their approximate usage and size
+// themselves to the limit they are assigned. The budget minus the usage
+// of fixed components (priority 0) is split such that components using
+// less than their priority share keep their usage plus headroom and the
+// others divide the rest by priority. Limits are recomputed on usage
+// reports at most every 10 seconds. Without budget every limit is
+// unbounded and the components keep their own caps.
+namespace memory_budget {
+class Budget;
+class Component {
+public:
+    Component(std::string_view name, uint32_t priority, size_t minBytes);
+    size_t limit() const { return limitBytes.load(std::memory_order_relaxed); }
+    size_t usage() const { return usageBytes.load(std::memory_order_relaxed); }
+    // number of entries of entryBytes each within the limit, at most cap
+    size_t max_entries(size_t entryBytes, size_t cap) const
+    {
+        return std::min(cap, limit() / entryBytes);
+    }
+    void set_usage(size_t bytes);
+
+    const std::string name;
+    const uint32_t priority; // 0 for fixed components, which are only reported
+    const size_t minBytes;
+
+private:
+    friend class Budget;
+    std::atomic<size_t> usageBytes { 0 };
+    std::atomic<size_t> limitBytes { std::numeric_limits<size_t>::max() };
+    metrics::Gauge& usageGauge;
+    metrics::Gauge& limitGauge;
+};
+
+// registered for the process lifetime, same name returns same component
+Component& component(std::string_view name, uint32_t priority, size_t minBytes = 0);
+
+// bytes shared by all components, 0 disables the budget
+void set_total(size_t bytes);
+
+struct Usage {
+    std::string name;
+    uint32_t priority;
+    size_t usage;
+    std::optional<size_t> limit;
+};
+struct Report {
+    std::optional<size_t> total;
+    std::vector<Usage> components;
+};
+Report report();
+}
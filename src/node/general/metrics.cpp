@@ -0,0 +1,163 @@
+#include "metrics.hpp"
+#include <cassert>
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace metrics {
+namespace {
+struct Family {
+    std::string type;
+    std::string help;
+    std::map<std::string, std::unique_ptr<Metric>> members; // by label string
+};
+
+struct Registry {
+    std::mutex m;
+    std::map<std::string, Family, std::less<>> families;
+};
+
+Registry& registry()
+{
+    static Registry r;
+    return r;
+}
+
+std::string escape(std::string_view s)
+{
+    std::string res;
+    res.reserve(s.size());
+    for (char c : s) {
+        if (c == '\\' || c == '"')
+            res.push_back('\\');
+        if (c == '\n') {
+            res += "\\n";
+            continue;
+        }
+        res.push_back(c);
+    }
+    return res;
+}
+
+std::string format_labels(Labels labels)
+{
+    std::string res;
+    for (auto& [k, v] : labels) {
+        if (!res.empty())
+            res.push_back(',');
+        res += k;
+        res += "=\"";
+        res += escape(v);
+        res += '"';
+    }
+    return res;
+}
+
+template <typename T>
+T& get(std::string_view name, std::string_view help, std::string_view type, Labels labels)
+{
+    auto& r { registry() };
+    std::lock_guard l(r.m);
+    auto iter { r.families.find(name) };
+    if (iter == r.families.end())
+        iter = r.families.emplace(std::string(name), Family { std::string(type), std::string(help), {} }).first;
+    auto& f { iter->second };
+    assert(f.type == type);
+    auto& p { f.members[format_labels(labels)] };
+    if (!p)
+        p = std::make_unique<T>();
+    return static_cast<T&>(*p);
+}
+
+void line(std::string& out, const std::string& name, const std::string& labels, const std::string& value)
+{
+    out += name;
+    if (!labels.empty()) {
+        out += '{';
+        out += labels;
+        out += '}';
+    }
+    out += ' ';
+    out += value;
+    out += '\n';
+}
+}
+
+void Counter::write(std::string& out, const std::string& name, const std::string& labels) const
+{
+    line(out, name, labels, std::to_string(value()));
+}
+
+void Gauge::write(std::string& out, const std::string& name, const std::string& labels) const
+{
+    line(out, name, labels, std::to_string(value()));
+}
+
+void Histogram::observe(std::chrono::steady_clock::duration d)
+{
+    using namespace std::chrono;
+    const auto ns { duration_cast<nanoseconds>(d).count() };
+    const double s { ns * 1e-9 };
+    size_t i { 0 };
+    while (i < bounds.size() && s > bounds[i])
+        ++i;
+    counts[i].fetch_add(1, std::memory_order_relaxed);
+    sumNs.fetch_add(ns, std::memory_order_relaxed);
+}
+
+void Histogram::write(std::string& out, const std::string& name, const std::string& labels) const
+{
+    const std::string sep { labels.empty() ? "" : "," };
+    uint64_t cumulative { 0 };
+    for (size_t i = 0; i < counts.size(); ++i) {
+        cumulative += counts[i].load(std::memory_order_relaxed);
+        std::string le { i < bounds.size() ? std::to_string(bounds[i]) : "+Inf" };
+        line(out, name + "_bucket", labels + sep + "le=\"" + le + "\"", std::to_string(cumulative));
+    }
+    line(out, name + "_sum", labels, std::to_string(sumNs.load(std::memory_order_relaxed) * 1e-9));
+    line(out, name + "_count", labels, std::to_string(cumulative));
+}
+
+Counter& counter(std::string_view name, std::string_view help, Labels labels)
+{
+    return get<Counter>(name, help, "counter", labels);
+}
+
+Gauge& gauge(std::string_view name, std::string_view help, Labels labels)
+{
+    return get<Gauge>(name, help, "gauge", labels);
+}
+
+Histogram& histogram(std::string_view name, std::string_view help, Labels labels)
+{
+    return get<Histogram>(name, help, "histogram", labels);
+}
+
+double total_seconds(std::string_view name)
+{
+    auto& r { registry() };
+    std::lock_guard l(r.m);
+    auto iter { r.families.find(name) };
+    if (iter == r.families.end())
+        return 0;
+    double s { 0 };
+    for (auto& [labels, m] : iter->second.members)
+        if (auto h { dynamic_cast<const Histogram*>(m.get()) })
+            s += h->sum_seconds();
+    return s;
+}
+
+std::string prometheus()
+{
+    auto& r { registry() };
+    std::lock_guard l(r.m);
+    std::string out;
+    for (auto& [name, f] : r.families) {
+        out += "# HELP " + name + " " + f.help + "\n";
+        out += "# TYPE " + name + " " + f.type + "\n";
+        for (auto& [labels, m] : f.members)
+            m->write(out, name, labels);
+    }
+    return out;
+}
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <utility>
+
+// Process wide metrics registry exported in Prometheus text format on the
+// /metrics endpoint. Metrics are registered once (usually into function
+// local static references) and live until program exit, updates are lock
+// free and can be done from any thread.
+namespace metrics {
+using Labels = std::initializer_list<std::pair<std::string_view, std::string_view>>;
+
+class Metric {
+public:
+    virtual ~Metric() = default;
+    virtual void write(std::string& out, const std::string& name, const std::string& labels) const = 0;
+};
+
+class Counter : public Metric {
+public:
+    void inc(uint64_t n = 1) { v.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value() const { return v.load(std::memory_order_relaxed); }
+    void write(std::string& out, const std::string& name, const std::string& labels) const override;
+
+private:
+    std::atomic<uint64_t> v { 0 };
+};
+
+class Gauge : public Metric {
+public:
+    void set(int64_t n) { v.store(n, std::memory_order_relaxed); }
+    void add(int64_t n) { v.fetch_add(n, std::memory_order_relaxed); }
+    int64_t value() const { return v.load(std::memory_order_relaxed); }
+    void write(std::string& out, const std::string& name, const std::string& labels) const override;
+
+private:
+    std::atomic<int64_t> v { 0 };
+};
+
+// durations in seconds
+class Histogram : public Metric {
+public:
+    static constexpr std::array<double, 16> bounds {
+        1e-6, 1e-5, 5e-5, 1e-4, 5e-4, 1e-3, 5e-3, 1e-2,
+        5e-2, 0.1, 0.25, 0.5, 1, 2.5, 10, 60
+    };
+    void observe(std::chrono::steady_clock::duration);
+    double sum_seconds() const { return sumNs.load(std::memory_order_relaxed) * 1e-9; }
+    void write(std::string& out, const std::string& name, const std::string& labels) const override;
+
+private:
+    std::array<std::atomic<uint64_t>, bounds.size() + 1> counts {}; // last is +Inf
+    std::atomic<uint64_t> sumNs { 0 };
+};
+
+Counter& counter(std::string_view name, std::string_view help, Labels = {});
+Gauge& gauge(std::string_view name, std::string_view help, Labels = {});
+Histogram& histogram(std::string_view name, std::string_view help, Labels = {});
+
+// all registered metrics in Prometheus text exposition format
+std::string prometheus();
+
+// sum of all observations of a histogram family over all label values
+double total_seconds(std::string_view name);
+
+// observes the lifetime of the scope
+class ScopeTimer {
+public:
+    ScopeTimer(Histogram& h)
+        : h(h)
+        , begin(std::chrono::steady_clock::now())
+    {
+    }
+    ScopeTimer(const ScopeTimer&) = delete;
+    ~ScopeTimer() { h.observe(std::chrono::steady_clock::now() - begin); }
+
+private:
+    Histogram& h;
+    std::chrono::steady_clock::time_point begin;
+};
+}
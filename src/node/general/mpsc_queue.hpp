@@ -0,0 +1,79 @@
+#pragma once
+#include <atomic>
+#include <utility>
+
+// Lock-free multi-producer single-consumer queue. Producers push
+// individual elements, the consumer takes all pending elements at
+// once in FIFO order (per producer) with a single atomic exchange.
+template <typename T>
+class MPSCQueue {
+    struct Node {
+        T value;
+        Node* next;
+    };
+
+public:
+    // elements taken out of the queue, owned by the consumer
+    class Batch {
+        friend class MPSCQueue;
+        Batch(Node* head)
+            : head(head)
+        {
+        }
+
+    public:
+        Batch() = default;
+        Batch(const Batch&) = delete;
+        Batch(Batch&& b)
+            : head(std::exchange(b.head, nullptr))
+        {
+        }
+        ~Batch()
+        {
+            while (!empty())
+                pop();
+        }
+        bool empty() const { return head == nullptr; }
+        T& front() { return head->value; }
+        void pop()
+        {
+            delete std::exchange(head, head->next);
+        }
+
+    private:
+        Node* head { nullptr };
+    };
+
+    MPSCQueue() = default;
+    MPSCQueue(const MPSCQueue&) = delete;
+    ~MPSCQueue()
+    {
+        auto drained { pop_all() }; // deletes the remaining nodes
+    }
+
+    // Returns true if the queue was empty before, i.e. only then
+    // the consumer needs to be woken up.
+    bool push(T t)
+    {
+        Node* n { new Node { std::move(t), top.load(std::memory_order_relaxed) } };
+        while (!top.compare_exchange_weak(n->next, n,
+            std::memory_order_release, std::memory_order_relaxed)) { }
+        return n->next == nullptr;
+    }
+
+    // consumer only
+    [[nodiscard]] Batch pop_all()
+    {
+        Node* n { top.exchange(nullptr, std::memory_order_acquire) };
+        // reverse pushed stack to obtain FIFO order
+        Node* head { nullptr };
+        while (n)
+            head = std::exchange(n, std::exchange(n->next, head));
+        return { head };
+    }
+
+    bool empty() const { return top.load(std::memory_order_acquire) == nullptr; }
+
+private:
+    std::atomic<Node*> top { nullptr };
+};
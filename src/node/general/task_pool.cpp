@@ -0,0 +1,135 @@
+#include "task_pool.hpp"
+#include <algorithm>
+#include <cassert>
+
+namespace {
+struct Current {
+    const TaskPool* pool { nullptr };
+    size_t index { 0 };
+};
+thread_local Current current;
+}
+
+TaskPool::TaskPool(size_t nThreads)
+{
+    // the calling thread participates in parallel_for, keep one worker for
+    // tasks nobody waits on
+    const size_t nWorkers { std::max(nThreads, size_t(2)) - 1 };
+    for (size_t i = 0; i < nWorkers; ++i)
+        queues.push_back(std::make_unique<Queue>());
+    for (size_t i = 0; i < nWorkers; ++i)
+        threads.emplace_back(&TaskPool::work, this, i);
+}
+
+TaskPool::~TaskPool()
+{
+    {
+        std::unique_lock l(m);
+        shutdown = true;
+    }
+    cv.notify_all();
+    for (auto& t : threads)
+        t.join();
+}
+
+void TaskPool::push(Task t)
+{
+    const size_t i { current.pool == this
+            ? current.index
+            : nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size() };
+    pending.fetch_add(1); // before the push such that it never underflows
+    {
+        auto& q { *queues[i] };
+        std::lock_guard l(q.m);
+        q.tasks.push_back(std::move(t));
+    }
+    {
+        // prevents lost wakeups of workers going to sleep
+        std::lock_guard l(m);
+    }
+    cv.notify_one();
+}
+
+bool TaskPool::run_one()
+{
+    if (pending.load() == 0)
+        return false;
+    const bool own { current.pool == this };
+    const size_t self { own ? current.index : 0 };
+    Task t;
+    for (size_t j = 0; j < queues.size() && !t; ++j) {
+        const size_t i { (self + j) % queues.size() };
+        auto& q { *queues[i] };
+        std::lock_guard l(q.m);
+        if (q.tasks.empty())
+            continue;
+        if (own && j == 0) { // own queue: newest first
+            t = std::move(q.tasks.back());
+            q.tasks.pop_back();
+        } else { // steal oldest
+            t = std::move(q.tasks.front());
+            q.tasks.pop_front();
+        }
+    }
+    if (!t)
+        return false;
+    pending.fetch_sub(1);
+    t();
+    return true;
+}
+
+void TaskPool::help_until(const std::function<bool()>& done)
+{
+    while (!done()) {
+        if (!run_one())
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+}
+
+void TaskPool::parallel_for(size_t n, const std::function<void(size_t)>& fun)
+{
+    if (n == 0)
+        return;
+    if (n == 1) {
+        fun(0);
+        return;
+    }
+    std::atomic<size_t> next { 0 };
+    std::atomic<size_t> finished { 0 };
+    auto process { [&]() {
+        size_t i;
+        while ((i = next.fetch_add(1)) < n) {
+            fun(i);
+            finished.fetch_add(1);
+        }
+    } };
+    const size_t helpers { std::min(n, size()) - 1 };
+    std::vector<Future<void>> futures;
+    futures.reserve(helpers);
+    for (size_t i = 0; i < helpers; ++i)
+        futures.push_back(submit(process));
+    process();
+    // helpers which did not start yet return immediately
+    for (auto& f : futures)
+        f.get();
+    assert(finished == n);
+}
+
+void TaskPool::work(size_t index)
+{
+    current = { this, index };
+    while (true) {
+        if (run_one())
+            continue;
+        std::unique_lock l(m);
+        cv.wait(l, [&]() { return shutdown || pending.load() > 0; });
+        if (shutdown)
+            return;
+    }
+}
+
+TaskPool& task_pool()
+{
+    static TaskPool pool;
+    return pool;
+}
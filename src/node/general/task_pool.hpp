@@ -0,0 +1,89 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Work-stealing thread pool shared by the node subsystems for CPU bound
+// work (signature recovery, PoW checks, merkle hashing, serialization).
+// Every worker owns a deque: tasks submitted by a worker are pushed to its
+// own deque and run LIFO, idle workers steal FIFO from the others. Threads
+// waiting for results (Future::get, parallel_for) run queued tasks in the
+// meantime such that nested submissions cannot deadlock the pool.
+class TaskPool {
+    using Task = std::function<void()>;
+
+public:
+    template <typename T>
+    class Future {
+    public:
+        Future() = default;
+        bool valid() const { return f.valid(); }
+        bool ready() const { return f.wait_for(std::chrono::seconds(0)) == std::future_status::ready; }
+        // rethrows exceptions of the task
+        T get()
+        {
+            pool->help_until([&]() { return ready(); });
+            return f.get();
+        }
+
+    private:
+        friend class TaskPool;
+        Future(TaskPool* pool, std::future<T> f)
+            : pool(pool)
+            , f(std::move(f))
+        {
+        }
+        TaskPool* pool { nullptr };
+        std::future<T> f;
+    };
+
+    TaskPool(size_t nThreads = std::thread::hardware_concurrency());
+    TaskPool(const TaskPool&) = delete;
+    ~TaskPool();
+
+    template <typename F>
+    auto submit(F&& f) -> Future<std::invoke_result_t<std::decay_t<F>>>
+    {
+        using R = std::invoke_result_t<std::decay_t<F>>;
+        auto t { std::make_shared<std::packaged_task<R()>>(std::forward<F>(f)) };
+        Future<R> res(this, t->get_future());
+        push([t]() { (*t)(); });
+        return res;
+    }
+
+    // calls fun(i) for every i in [0,n) and blocks until all are processed,
+    // the calling thread participates, fun must not throw
+    void parallel_for(size_t n, const std::function<void(size_t)>& fun);
+    size_t size() const { return threads.size() + 1; }
+
+private:
+    struct Queue {
+        std::mutex m;
+        std::deque<Task> tasks;
+    };
+    void push(Task);
+    bool run_one(); // runs a queued task if there is one
+    void help_until(const std::function<bool()>& done);
+    void work(size_t index);
+
+private:
+    std::vector<std::unique_ptr<Queue>> queues; // one per worker
+    std::atomic<size_t> pending { 0 };
+    std::atomic<size_t> nextQueue { 0 }; // round robin for external submissions
+    std::mutex m;
+    std::condition_variable cv;
+    bool shutdown { false };
+    std::vector<std::thread> threads;
+};
+
+// node wide instance, started on first use
+TaskPool& task_pool();
@@ -0,0 +1,34 @@
+#include "thread_settings.hpp"
+#include "spdlog/spdlog.h"
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+void apply_thread_settings(const Config::ThreadSettings& s, const char* role)
+{
+    if (s.empty())
+        return;
+#ifdef __linux__
+    if (!s.cores.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (auto c : s.cores)
+            CPU_SET(c, &set);
+        if (int e { pthread_setaffinity_np(pthread_self(), sizeof(set), &set) })
+            spdlog::warn("Cannot pin {} thread to its cores: {}", role, strerror(e));
+    }
+    if (s.nice) {
+        // nice values are per thread on Linux
+        if (setpriority(PRIO_PROCESS, id_t(syscall(SYS_gettid)), *s.nice) != 0)
+            spdlog::warn("Cannot set nice value {} of {} thread: {}", *s.nice, role, strerror(errno));
+    }
+#else
+    spdlog::warn("Thread settings of {} are only supported on Linux.", role);
+#endif
+}
@@ -0,0 +1,7 @@
+#pragma once
+#include "config/config.hpp"
+
+// Pins the calling thread to the configured cores and sets its nice value.
+// Failures (e.g. raising the priority without CAP_SYS_NICE) are logged and
+// otherwise ignored, the thread then keeps the default scheduling.
+void apply_thread_settings(const Config::ThreadSettings&, const char* role);
@@ -0,0 +1,113 @@
+#include "trace.hpp"
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <mutex>
+
+namespace trace {
+namespace {
+class Ring {
+public:
+    static constexpr size_t capacity = 1 << 14; // power of 2
+    Ring(uint64_t tid, const char* name)
+        : tid(tid)
+        , name(name ? name : "thread " + std::to_string(tid))
+    {
+    }
+
+    // only called by the owning thread
+    void push(const char* n, uint64_t beginNs, uint64_t durationNs)
+    {
+        const uint64_t h { head.load(std::memory_order_relaxed) };
+        auto& s { slots[h & (capacity - 1)] };
+        s.name.store(n, std::memory_order_relaxed);
+        s.beginNs.store(beginNs, std::memory_order_relaxed);
+        s.durationNs.store(durationNs, std::memory_order_relaxed);
+        head.store(h + 1, std::memory_order_release);
+    }
+
+    ThreadEvents copy() const
+    {
+        ThreadEvents res { .tid = tid, .name = name, .events {} };
+        const uint64_t end { head.load(std::memory_order_acquire) };
+        const uint64_t begin { end > capacity ? end - capacity : 0 };
+        res.events.reserve(end - begin);
+        for (uint64_t i = begin; i < end; ++i) {
+            auto& s { slots[i & (capacity - 1)] };
+            res.events.push_back({ s.name.load(std::memory_order_relaxed),
+                s.beginNs.load(std::memory_order_relaxed),
+                s.durationNs.load(std::memory_order_relaxed) });
+        }
+        // drop the slots the writer may have overwritten meanwhile,
+        // including the one it may be writing right now
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const uint64_t next { head.load(std::memory_order_relaxed) + 1 };
+        if (next - begin > capacity) {
+            const size_t overwritten { std::min(size_t(next - begin - capacity), res.events.size()) };
+            res.events.erase(res.events.begin(), res.events.begin() + overwritten);
+        }
+        return res;
+    }
+
+private:
+    struct Slot {
+        std::atomic<const char*> name { nullptr };
+        std::atomic<uint64_t> beginNs { 0 };
+        std::atomic<uint64_t> durationNs { 0 };
+    };
+    const uint64_t tid;
+    const std::string name;
+    std::atomic<uint64_t> head { 0 };
+    std::array<Slot, capacity> slots;
+};
+
+// rings of exited threads are kept such that their zones can be dumped
+struct Registry {
+    std::mutex m;
+    std::vector<std::unique_ptr<Ring>> rings;
+};
+
+Registry& registry()
+{
+    static Registry r;
+    return r;
+}
+
+thread_local const char* threadName { nullptr };
+thread_local Ring* threadRing { nullptr };
+}
+
+namespace detail {
+std::atomic<bool> enabled { false };
+
+void record(const char* name, uint64_t beginNs, uint64_t durationNs)
+{
+    if (!threadRing) {
+        auto& r { registry() };
+        std::lock_guard l(r.m);
+        threadRing = r.rings.emplace_back(std::make_unique<Ring>(r.rings.size(), threadName)).get();
+    }
+    threadRing->push(name, beginNs, durationNs);
+}
+}
+
+void set_enabled(bool enable)
+{
+    detail::enabled.store(enable, std::memory_order_relaxed);
+}
+
+void set_thread_name(const char* name)
+{
+    threadName = name;
+}
+
+std::vector<ThreadEvents> collect()
+{
+    auto& r { registry() };
+    std::lock_guard l(r.m);
+    std::vector<ThreadEvents> res;
+    for (auto& ring : r.rings)
+        res.push_back(ring->copy());
+    return res;
+}
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Scoped tracing zones for diagnosing latency spikes on live nodes. Every
+// thread records its completed zones into an own ring buffer which readers
+// copy without stopping the writer. Recording is off by default, a zone
+// then costs a relaxed load.
+namespace trace {
+struct Event {
+    const char* name; // string literal
+    uint64_t beginNs; // steady clock
+    uint64_t durationNs;
+};
+struct ThreadEvents {
+    uint64_t tid; // in order of the first recorded zone
+    std::string name;
+    std::vector<Event> events; // oldest first
+};
+
+namespace detail {
+extern std::atomic<bool> enabled;
+void record(const char* name, uint64_t beginNs, uint64_t durationNs);
+inline uint64_t now_ns()
+{
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+}
+
+inline bool enabled() { return detail::enabled.load(std::memory_order_relaxed); }
+void set_enabled(bool);
+void set_thread_name(const char*); // string literal, call before the first zone
+std::vector<ThreadEvents> collect(); // last recorded zones of all threads
+
+class Zone {
+public:
+    Zone(const char* name)
+        : name(enabled() ? name : nullptr)
+        , begin(this->name ? detail::now_ns() : 0)
+    {
+    }
+    Zone(const Zone&) = delete;
+    ~Zone()
+    {
+        if (name)
+            detail::record(name, begin, detail::now_ns() - begin);
+    }
+
+private:
+    const char* name;
+    uint64_t begin;
+};
+}
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+#define TRACE_ZONE(name) trace::Zone TRACE_CONCAT(traceZone, __LINE__) { name }
@@ -1,20 +1,16 @@
 #include "globals.hpp"
 #include "asyncio/conman.hpp"
-#include "spdlog/sinks/rotating_file_sink.h"
+#include "general/logging.hpp"
 namespace {
 
 auto create_connection_logger()
 {
-    auto max_size = 1048576 * 5; // 5 MB
-    auto max_files = 3;
-    return spdlog::rotating_logger_mt("connection_logger", config().defaultDataDir + "logs/connections.log", max_size, max_files);
+    return rotating_file_logger("connection_logger", config().defaultDataDir + "logs/connections.log");
 }
 
 auto create_syncdebug_logger()
 {
-    auto max_size = 1048576 * 5; // 5 MB
-    auto max_files = 3;
-    return spdlog::rotating_logger_mt("syncdebug_logger", config().defaultDataDir + "logs/syncdebug.log", max_size, max_files);
+    return rotating_file_logger("syncdebug_logger", config().defaultDataDir + "logs/syncdebug.log");
 }
 
 }
@@ -41,7 +37,7 @@ const Config& config()
     return globalinstance.conf;
 }
 
-void global_init(BatchRegistry* pbr, PeerServer* pps, ChainServer* pcs, Conman* pcm, Eventloop* pel, HTTPEndpoint* httpEndpoint)
+void global_init(BatchRegistry* pbr, PeerServer* pps, ChainServer* pcs, Conman* pcm, Eventloop* pel, HTTPEndpoint* httpEndpoint, StratumServer* stratumServer)
 {
     globalinstance.pbr = pbr;
     globalinstance.pps = pps;
@@ -49,6 +45,7 @@ void global_init(BatchRegistry* pbr, PeerServer* pps, ChainServer* pcs, Conman*
     globalinstance.pcs = pcs;
     globalinstance.pel = pel;
     globalinstance.httpEndpoint = httpEndpoint;
+    globalinstance.stratumServer = stratumServer;
     globalinstance.connLogger = create_connection_logger();;
     globalinstance.syncdebugLogger = create_syncdebug_logger();;
 };
@@ -4,6 +4,7 @@
 
 class BatchRegistry;
 class HTTPEndpoint;
+class StratumServer;
 class PeerServer;
 class ChainServer;
 class Eventloop;
@@ -19,6 +20,7 @@ struct Global {
     Eventloop* pel;
     BatchRegistry* pbr;
     HTTPEndpoint* httpEndpoint;
+    StratumServer* stratumServer; // nullptr if disabled
     std::shared_ptr<spdlog::logger> connLogger;
     std::shared_ptr<spdlog::logger> syncdebugLogger;
     Config conf;
@@ -30,4 +32,4 @@ inline spdlog::logger& connection_log() { return *global().connLogger; }
 inline spdlog::logger& syncdebug_log() { return *global().syncdebugLogger; }
 const Config& config();
 int init_config(int argc, char** argv);
-void global_init(BatchRegistry* pbr, PeerServer* pps, ChainServer* pcs, Conman* pcm, Eventloop* pel, HTTPEndpoint* httpEndpoint);
+void global_init(BatchRegistry* pbr, PeerServer* pps, ChainServer* pcs, Conman* pcm, Eventloop* pel, HTTPEndpoint* httpEndpoint, StratumServer* stratumServer);
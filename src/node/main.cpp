@@ -1,14 +1,21 @@
 #include "api/http/endpoint.hpp"
+#include "api/stratum/server.hpp"
 #include "asyncio/conman.hpp"
 #include "chainserver/server.hpp"
 #include "db/chain_db.hpp"
 #include "db/peer_db.hpp"
 #include "eventloop/eventloop.hpp"
+#include "general/cpu_features.hpp"
 #include "general/errors.hpp"
+#include "general/logging.hpp"
+#include "general/memory_budget.hpp"
+#include "general/thread_settings.hpp"
+#include "general/trace.hpp"
 #include "global/globals.hpp"
 #include "peerserver/peerserver.hpp"
 #include "spdlog/spdlog.h"
 
+#include <future>
 #include <iostream>
 using namespace std;
 
@@ -74,6 +81,7 @@ struct ECC {
 int main(int argc, char** argv)
 {
     ECC ecc;
+    init_logging();
     initialize_srand();
     int i = init_config(argc, argv);
     if (i <= 0)
@@ -82,6 +90,12 @@ int main(int argc, char** argv)
 
     spdlog::info("Chain database: {}", config().data.chaindb);
     spdlog::info("Peers database: {}", config().data.peersdb);
+    spdlog::info("Chain database profile: {}", to_string(config().data.chaindbProfile));
+    spdlog::info("CPU features: {}", cpu_features().to_string());
+    if (config().memory.budget != 0) {
+        spdlog::info("Memory budget of caches and mempool: {} MiB", config().memory.budget);
+        memory_budget::set_total(config().memory.budget << 20);
+    }
 
 
     // spdlog::flush_on(spdlog::level::debug);
@@ -90,14 +104,22 @@ int main(int argc, char** argv)
     uv_loop_t l;
     uv_loop_init(&l);
 
+    // consensus headers and transaction ids load in the
+    // background while the peer side starts up
+    spdlog::debug("Opening chain database \"{}\"", config().data.chaindb);
+    auto chainLoad { std::async(std::launch::async, [&breg]() {
+        auto db { std::make_unique<ChainDB>(config().data.chaindb, config().data.chaindbProfile) };
+        auto cs { std::make_unique<ChainServer>(*db, breg, config().node.snapshotSigner, config().jsonrpc.readConnections) };
+        return std::pair { std::move(db), std::move(cs) }; // server is destroyed first
+    }) };
+
     spdlog::debug("Opening peers database \"{}\"", config().data.peersdb);
     PeerDB pdb(config().data.peersdb);
     PeerServer ps(pdb, config());
     spdlog::info("{} IPs are currently blacklisted.", pdb.get_banned_peers().size());
 
-    spdlog::debug("Opening chain database \"{}\"", config().data.chaindb);
-    ChainDB db(config().data.chaindb);
-    ChainServer cs(db, breg,config().node.snapshotSigner);
+    auto chain { chainLoad.get() };
+    ChainServer& cs { *chain.second };
 
     Eventloop el(ps, cs, config());
     Conman cm(&l, ps, config());
@@ -109,21 +131,32 @@ int main(int argc, char** argv)
 
     // starting endpoint
     HTTPEndpoint endpoint { config() };
+    std::optional<StratumServer> stratum;
+    if (config().stratum.bind)
+        stratum.emplace(config());
 
     // setup globals
-    global_init(&breg, &ps, &cs, &cm, &el, &endpoint);
+    global_init(&breg, &ps, &cs, &cm, &el, &endpoint, stratum ? &*stratum : nullptr);
+
+    cs.restore_mempool();
 
     // running eventloops
     el.start_async_loop();
+    trace::set_thread_name("conman");
+    // last such that the other threads do not inherit the pinning
+    // of the main thread
+    apply_thread_settings(config().threads.uv, "conman");
     if ((i = uv_run(&l, UV_RUN_DEFAULT)))
         goto error;
     free_signals();
     if ((i = uv_run(&l, UV_RUN_DEFAULT)))
         goto error;
     uv_loop_close(&l);
+    shutdown_logging();
 
     return 0;
 error:
     spdlog::error("libuv error:", errors::err_name(i));
+    shutdown_logging();
     return i;
 }
@@ -1,47 +1,23 @@
 #pragma once
 #include "block/chain/height.hpp"
-#include "txmap.hpp"
+#include "entry.hpp"
 #include <type_traits>
 
 namespace mempool {
-struct ComparatorPin {
-    using iter_t = Txmap::iterator;
-    using is_transparent = std::true_type;
-    inline bool operator()(iter_t i1, Height h2) const
-    {
-        return (i1->first.pinHeight < h2);
-    }
-    inline bool operator()(iter_t i1, iter_t i2) const
-    {
-        if (i1->first.pinHeight == i2->first.pinHeight)
-            return i1->first < i2->first;
-        return (i1->first.pinHeight < i2->first.pinHeight);
-    }
+// keys of the ordered indexes, slot refers to the EntryStore
+struct FeeKey {
+    CompactUInt fee;
+    TransactionId txid;
+    uint32_t slot;
 };
+
 struct ComparatorFee {
-    using iter_t = Txmap::iterator;
-    inline bool operator()(iter_t i1, iter_t i2) const
+    inline bool operator()(const FeeKey& k1, const FeeKey& k2) const
     {
-        if (i1->second.fee == i2->second.fee) {
-            return i1->first < i2->first;
+        if (k1.fee == k2.fee) {
+            return k1.txid < k2.txid;
         };
-        return i1->second.fee > i2->second.fee;
-    }
-};
-struct ComparatorHash {
-    using iter_t = Txmap::iterator;
-    using is_transparent = std::true_type;
-    inline bool operator()(iter_t i1, iter_t i2) const
-    {
-        return i1->second.hash < i2->second.hash;
-    }
-    inline bool operator()(iter_t i1, const HashView rhs) const
-    {
-        return i1->second.hash < rhs;
-    }
-    inline bool operator()(HashView lhs, iter_t i2) const
-    {
-        return lhs < i2->second.hash;
+        return k1.fee > k2.fee;
     }
 };
 }
@@ -0,0 +1,73 @@
+#include "dump.hpp"
+#include "general/reader.hpp"
+#include "general/writer.hpp"
+#include "spdlog/spdlog.h"
+#include <filesystem>
+#include <fstream>
+
+namespace mempool {
+namespace {
+constexpr uint32_t magic { 0x6d706f6f }; // "mpoo"
+constexpr uint32_t version { 1 };
+constexpr size_t headerSize { 12 };
+constexpr size_t maxEntries { 1000000 };
+}
+
+void save_dump(const std::string& path, const std::vector<TransferTxExchangeMessage>& txs)
+{
+    std::vector<uint8_t> bytes(headerSize + txs.size() * TransferTxExchangeMessage::bytesize);
+    Writer w(bytes);
+    w << magic << version << uint32_t(txs.size());
+    for (auto& tx : txs)
+        w << tx;
+
+    // write to temporary file first such that the dump is never partial
+    const auto tmp { path + ".tmp" };
+    {
+        std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+        f.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+        f.flush();
+        if (!f.good()) {
+            spdlog::warn("Cannot write mempool to {}", tmp);
+            return;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, path, ec);
+    if (ec) {
+        spdlog::warn("Cannot write mempool to {}: {}", path, ec.message());
+        return;
+    }
+    spdlog::info("Saved {} mempool transactions", txs.size());
+}
+
+std::vector<TransferTxExchangeMessage> load_dump(const std::string& path)
+{
+    std::vector<uint8_t> bytes;
+    {
+        std::ifstream f(path, std::ios::binary);
+        if (!f)
+            return {};
+        bytes.assign(std::istreambuf_iterator<char>(f), {});
+    }
+    std::error_code ec;
+    std::filesystem::remove(path, ec); // a crash must not load it again
+
+    std::vector<TransferTxExchangeMessage> txs;
+    try {
+        Reader r(bytes);
+        if (r.uint32() != magic || r.uint32() != version)
+            throw Error(EMALFORMED);
+        const uint32_t n { r.uint32() };
+        if (n > maxEntries || r.remaining() != n * TransferTxExchangeMessage::bytesize)
+            throw Error(EMALFORMED);
+        txs.reserve(n);
+        for (size_t i = 0; i < n; ++i)
+            txs.push_back(TransferTxExchangeMessage { r });
+    } catch (Error) {
+        spdlog::warn("Ignoring corrupted mempool file {}", path);
+        return {};
+    }
+    return txs;
+}
+}
@@ -0,0 +1,13 @@
+#pragma once
+#include "block/body/primitives.hpp"
+#include <string>
+#include <vector>
+
+namespace mempool {
+// Mempool transactions are written to a file on shutdown and inserted
+// again on startup such that a restarted node mines full blocks right
+// away. The file is removed once loaded, missing or corrupted files
+// yield no transactions.
+void save_dump(const std::string& path, const std::vector<TransferTxExchangeMessage>&);
+[[nodiscard]] std::vector<TransferTxExchangeMessage> load_dump(const std::string& path);
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include "entry.hpp"
+#include <cassert>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace mempool {
+
+// Reference to an entry in the EntryStore. The generation detects
+// references that outlived their entry because slots are reused.
+struct EntryRef {
+    uint32_t slot;
+    uint32_t generation;
+    bool operator==(const EntryRef&) const = default;
+};
+
+// Contiguous slab of mempool entries, freed slots are recycled.
+class EntryStore {
+    struct Slot {
+        std::optional<Entry> entry;
+        uint32_t generation { 0 };
+    };
+
+public:
+    size_t size() const { return slots.size() - freeSlots.size(); }
+
+    EntryRef insert(const Entry& e)
+    {
+        uint32_t i;
+        if (freeSlots.empty()) {
+            i = slots.size();
+            slots.emplace_back();
+        } else {
+            i = freeSlots.back();
+            freeSlots.pop_back();
+        }
+        auto& s { slots[i] };
+        assert(!s.entry);
+        s.entry.emplace(e);
+        return { i, s.generation };
+    }
+
+    void erase(EntryRef r)
+    {
+        auto& s { slots[r.slot] };
+        assert(valid(r));
+        s.entry.reset();
+        s.generation += 1;
+        freeSlots.push_back(r.slot);
+    }
+
+    // keeps the slot and its generation
+    void replace(uint32_t slot, const Entry& e)
+    {
+        auto& s { slots[slot] };
+        assert(s.entry);
+        s.entry.emplace(e);
+    }
+
+    bool valid(EntryRef r) const
+    {
+        return r.slot < slots.size() && slots[r.slot].generation == r.generation && slots[r.slot].entry;
+    }
+
+    const Entry& operator[](uint32_t slot) const
+    {
+        assert(slots[slot].entry);
+        return *slots[slot].entry;
+    }
+    const Entry& operator[](EntryRef r) const
+    {
+        assert(valid(r));
+        return *slots[r.slot].entry;
+    }
+    EntryRef ref(uint32_t slot) const
+    {
+        assert(slots[slot].entry);
+        return { slot, slots[slot].generation };
+    }
+
+    // calls f(entry) for all entries in slot order until f returns false
+    template <typename F>
+    void for_each(F&& f) const
+    {
+        for (auto& s : slots)
+            if (s.entry && !f(*s.entry))
+                return;
+    }
+
+private:
+    std::vector<Slot> slots;
+    std::vector<uint32_t> freeSlots;
+};
+}
@@ -13,4 +13,13 @@ struct Erase {
 };
 using Action = std::variant<Put, Erase>;
 using Log = std::vector<Action>;
+
+// Net effect of a Log: only the last action per transaction id is kept,
+// erased ids are sorted and puts are sorted by OrderKey such that
+// subscribers can be served in one sweep.
+struct Delta {
+    Delta(Log&& log);
+    std::vector<TransactionId> erased;
+    std::vector<Entry> put;
+};
 }
@@ -1,126 +1,358 @@
 #include "mempool.hpp"
 #include "chainserver/transaction_ids.hpp"
 #include "general/log_compressed.hpp"
+#include "general/memory_budget.hpp"
+#include "spdlog/spdlog.h"
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <utility>
 namespace mempool {
 
+namespace {
+uint64_t mix(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
+}
+
+namespace {
+// entry with its index and template slots
+constexpr size_t approxEntryBytes = 400;
+memory_budget::Component& budget()
+{
+    static auto& c { memory_budget::component("mempool", 4, 1000 * approxEntryBytes) };
+    return c;
+}
+}
+
+Mempool::Mempool(bool master, size_t maxSize)
+    : hashSeed((uint64_t(std::random_device {}()) << 32) ^ std::random_device {}())
+    , master(master)
+    , maxSize(maxSize)
+{
+}
+
+uint64_t Mempool::hash(const TransactionId& id) const
+{
+    return mix(mix(hashSeed ^ id.accountId.value())
+        ^ ((uint64_t(id.pinHeight.value()) << 32) | id.nonceId.value()));
+}
+
+uint64_t Mempool::hash(HashView h) const
+{
+    uint64_t v;
+    memcpy(&v, h.data(), sizeof(v));
+    return mix(hashSeed ^ v);
+}
+
+uint64_t Mempool::hash(AccountId id) const
+{
+    return mix(hashSeed ^ ~id.value());
+}
+
 std::vector<TransferTxExchangeMessage> Mempool::get_payments(size_t n, bool log, std::vector<Hash>* hashes) const
 {
     if (n == 0) {
         return {};
     }
+    if (n == blockTemplate.n) {
+        auto& t { block_template(n, log) };
+        if (hashes)
+            hashes->insert(hashes->end(), t.hashes.begin(), t.hashes.end());
+        return t.payments;
+    }
     std::vector<TransferTxExchangeMessage> res;
     res.reserve(n);
     size_t i = 0;
-    for (auto iter = byFee.rbegin(); iter != byFee.rend(); ++iter) {
+    byFee.for_each_reverse([&](const FeeKey& k) {
+        auto& e { entries[k.slot] };
         try {
-            TransferTxExchangeMessage m { (*iter)->first, (*iter)->second };
-            if (log) {
+            TransferTxExchangeMessage m { e.first, e.second };
+            if (log && spdlog::should_log(spdlog::level::debug)) {
                 log_compressed(m);
             }
 
             res.push_back(m);
             if (hashes)
-                hashes->emplace_back((*iter)->second.hash);
+                hashes->emplace_back(e.second.hash);
         } catch (...) {
         }
-        if (++i >= n)
-            break;
-    }
+        return ++i < n;
+    });
     return res;
 };
 
-void Mempool::apply_log(const Log& log)
+auto Mempool::snapshot() const -> std::shared_ptr<const Snapshot>
+{
+    if (cachedSnapshot)
+        return cachedSnapshot;
+    auto s { std::make_shared<Snapshot>() };
+    s->version = version;
+    s->rows.reserve(entries.size());
+    byFee.for_each_reverse([&](const FeeKey& k) {
+        auto& e { entries[k.slot] };
+        auto be { find_balance_entry(e.first.accountId) };
+        s->rows.push_back({ e,
+            be ? be->address : TransferTxExchangeMessage { e.first, e.second }.from_address(e.second.hash) });
+        return true;
+    });
+    cachedSnapshot = std::move(s);
+    return cachedSnapshot;
+}
+
+auto Mempool::block_template(size_t n, bool log) const -> const BlockTemplate&
 {
-    for (auto& l : log) {
-        std::visit([&](auto& entry) {
-            apply_logevent(entry);
-        },
-            l);
+    auto& t { blockTemplate };
+    if (t.n != n) { // build from scratch, afterwards patched on insert and erase
+        t = { .n = n, .version = t.version };
+        byFee.for_each_reverse([&](const FeeKey& k) {
+            if (t.keys.size() >= n)
+                return false;
+            auto& e { entries[k.slot] };
+            t.keys.push_back(k);
+            t.payments.push_back({ e.first, e.second });
+            t.hashes.push_back(e.second.hash);
+            t.totalFee += k.fee.uncompact();
+            return true;
+        });
     }
-};
+    if (log && spdlog::should_log(spdlog::level::debug)) {
+        for (auto& m : t.payments)
+            log_compressed(m);
+    }
+    return t;
+}
 
-void Mempool::apply_logevent(const Put& a)
+void Mempool::template_insert(const FeeKey& k)
 {
-    erase(a.entry.first);
-    auto p = txs.emplace(a.entry);
-    assert(p.second);
-    byPin.insert(p.first);
-    byFee.insert(p.first);
-    byHash.insert(p.first);
-};
+    auto& t { blockTemplate };
+    if (t.n == 0)
+        return;
+    // template is in reverse byFee order
+    auto less { [](const FeeKey& a, const FeeKey& b) { return ComparatorFee()(b, a); } };
+    if (t.keys.size() == t.n && !less(k, t.keys.back()))
+        return;
+    t.version += 1;
+    auto i { std::lower_bound(t.keys.begin(), t.keys.end(), k, less) - t.keys.begin() };
+    auto& e { entries[k.slot] };
+    t.keys.insert(t.keys.begin() + i, k);
+    t.payments.insert(t.payments.begin() + i, { e.first, e.second });
+    t.hashes.insert(t.hashes.begin() + i, e.second.hash);
+    t.totalFee += k.fee.uncompact();
+    if (t.keys.size() > t.n) {
+        t.totalFee -= t.keys.back().fee.uncompact();
+        t.keys.pop_back();
+        t.payments.pop_back();
+        t.hashes.pop_back();
+    }
+}
 
-void Mempool::apply_logevent(const Erase& e)
+void Mempool::template_erase(const FeeKey& k)
 {
-    erase(e.id);
-};
+    auto& t { blockTemplate };
+    if (t.n == 0)
+        return;
+    auto less { [](const FeeKey& a, const FeeKey& b) { return ComparatorFee()(b, a); } };
+    auto iter { std::lower_bound(t.keys.begin(), t.keys.end(), k, less) };
+    if (iter == t.keys.end() || less(k, *iter))
+        return;
+    auto i { iter - t.keys.begin() };
+    t.version += 1;
+    const bool full { t.keys.size() == t.n };
+    const FeeKey last { t.keys.back() };
+    t.totalFee -= k.fee.uncompact();
+    t.keys.erase(t.keys.begin() + i);
+    t.payments.erase(t.payments.begin() + i);
+    t.hashes.erase(t.hashes.begin() + i);
+    if (full) { // refill with the next entry after the template
+        if (auto next { byFee.prev(last) }) {
+            auto& e { entries[next->slot] };
+            t.keys.push_back(*next);
+            t.payments.push_back({ e.first, e.second });
+            t.hashes.push_back(e.second.hash);
+            t.totalFee += next->fee.uncompact();
+        }
+    }
+}
+
+Delta::Delta(Log&& log)
+{
+    auto id_of = [](const Action& a) -> const TransactionId& {
+        if (auto p { std::get_if<Put>(&a) })
+            return p->entry.first;
+        return std::get<Erase>(a).id;
+    };
+    std::vector<std::pair<TransactionId, size_t>> order;
+    order.reserve(log.size());
+    for (size_t i = 0; i < log.size(); ++i)
+        order.push_back({ id_of(log[i]), i });
+    std::sort(order.begin(), order.end());
+    for (size_t i = 0; i < order.size(); ++i) {
+        if (i + 1 < order.size() && order[i + 1].first == order[i].first)
+            continue; // superseded by a later action
+        auto& a { log[order[i].second] };
+        if (auto p { std::get_if<Put>(&a) })
+            put.push_back(std::move(p->entry));
+        else
+            erased.push_back(order[i].first);
+    }
+    std::sort(put.begin(), put.end(), [](const Entry& e1, const Entry& e2) {
+        return OrderKey { e1.second.transactionHeight, e1.first }
+        < OrderKey { e2.second.transactionHeight, e2.first };
+    });
+}
+
+void Mempool::apply_delta(const Delta& d)
+{
+    for (auto& id : d.erased)
+        erase(id);
+    for (auto& e : d.put) {
+        erase(e.first);
+        insert(e);
+    }
+}
+
+void Mempool::insert(const Entry& e)
+{
+    changed();
+    auto r { entries.insert(e) };
+    byTxid.insert(hash(e.first), r.slot);
+    byHash.insert(hash(e.second.hash), r.slot);
+    byPin.insert(e.first.pinHeight, r.slot);
+    FeeKey k { e.second.fee, e.first, r.slot };
+    byFee.insert(k);
+    template_insert(k);
+    if (master)
+        budget().set_usage(entries.size() * approxEntryBytes);
+}
+
+std::optional<uint32_t> Mempool::find(const TransactionId& id) const
+{
+    return byTxid.find(hash(id), [&](uint32_t slot) { return entries[slot].first == id; });
+}
 
 std::optional<TransferTxExchangeMessage> Mempool::operator[](const TransactionId& id) const
 {
-    auto iter = txs.find(id);
-    if (iter == txs.end())
+    auto slot { find(id) };
+    if (!slot)
         return {};
-    return TransferTxExchangeMessage { iter->first, iter->second };
+    auto& e { entries[*slot] };
+    return TransferTxExchangeMessage { e.first, e.second };
 };
 
 std::optional<TransferTxExchangeMessage> Mempool::operator[](const HashView txHash) const
 {
-    auto iter = byHash.find(txHash);
-    if (iter == byHash.end())
+    auto slot { byHash.find(hash(txHash), [&](uint32_t slot) { return entries[slot].second.hash == txHash; }) };
+    if (!slot)
         return {};
-    assert((*iter)->second.hash == txHash);
-    return TransferTxExchangeMessage { (*iter)->first, (*iter)->second };
+    auto& e { entries[*slot] };
+    return TransferTxExchangeMessage { e.first, e.second };
 };
 
-void Mempool::erase(decltype(txs)::iterator iter)
+BalanceEntry& Mempool::balance_entry(AccountId id, const AddressFunds& af)
+{
+    if (auto p { find_balance_entry(id) })
+        return *p;
+    byAccount.insert(hash(id), balanceEntries.size());
+    return balanceEntries.emplace_back(id, af);
+}
+
+BalanceEntry* Mempool::find_balance_entry(AccountId id)
+{
+    return const_cast<BalanceEntry*>(std::as_const(*this).find_balance_entry(id));
+}
+
+const BalanceEntry* Mempool::find_balance_entry(AccountId id) const
+{
+    auto i { byAccount.find(hash(id), [&](uint32_t i) { return balanceEntries[i].accountId == id; }) };
+    if (!i)
+        return nullptr;
+    return &balanceEntries[*i];
+}
+
+void Mempool::erase_balance_entry(BalanceEntry& be)
+{
+    const uint32_t i(&be - balanceEntries.data());
+    const uint32_t last(balanceEntries.size() - 1);
+    byAccount.erase(hash(be.accountId), i);
+    if (i != last) {
+        byAccount.relocate(hash(balanceEntries[last].accountId), last, i);
+        be = std::move(balanceEntries[last]);
+    }
+    balanceEntries.pop_back();
+}
+
+void Mempool::erase_slot(uint32_t slot)
+{
+    byPin.erase(entries[slot].first.pinHeight, slot);
+    erase_unpinned(slot);
+}
+
+void Mempool::erase_unpinned(uint32_t slot)
 {
-    const TransactionId id { iter->first };
-    byPin.erase(iter);
-    byFee.erase(iter);
-    byHash.erase(iter);
-    auto tx = *iter;
+    changed();
+    const Entry tx { entries[slot] };
+    const TransactionId& id { tx.first };
+    const FeeKey k { tx.second.fee, id, slot };
+    byFee.erase(k);
+    template_erase(k);
+    byTxid.erase(hash(id), slot);
+    byHash.erase(hash(tx.second.hash), slot);
     Funds spend = tx.second.fee.uncompact() + tx.second.amount;
-    auto biter = balanceEntries.find(id.accountId);
-    if (biter != balanceEntries.end()) {
-        biter->second._used -= spend;
-        if (biter->second._used.is_zero()) {
-            balanceEntries.erase(biter);
+    if (auto be { find_balance_entry(id.accountId) }) {
+        be->_used -= spend;
+        if (be->_used.is_zero()) {
+            erase_balance_entry(*be);
         }
     }
-    txs.erase(iter);
-    if (master)
+    entries.erase(entries.ref(slot));
+    if (master) {
         log.push_back(Erase { id });
+        budget().set_usage(entries.size() * approxEntryBytes);
+    }
 };
 
+void Mempool::erase_bucket(std::vector<uint32_t> slots)
+{
+    if (master)
+        log.reserve(log.size() + slots.size());
+    for (auto slot : slots)
+        erase_unpinned(slot);
+}
+
 void Mempool::erase_from_height(Height h)
 {
-    auto iter = byPin.lower_bound(h);
-    while (iter != byPin.end()) {
-        erase(*(iter++));
-    }
+    while (!byPin.empty() && byPin.highest() >= h)
+        erase_bucket(byPin.pop_highest());
 };
 
 void Mempool::erase_before_height(Height h)
 {
-    auto end = byPin.lower_bound(h);
-    for (auto iter = byPin.begin(); iter != end;) {
-        erase(*(iter++));
-    }
+    while (!byPin.empty() && byPin.lowest() < h)
+        erase_bucket(byPin.pop_lowest());
 };
 
 void Mempool::erase(TransactionId id)
 {
-    if (auto iter = txs.find(id); iter != txs.end())
-        erase(iter);
+    if (auto slot { find(id) })
+        erase_slot(*slot);
 }
 
 std::vector<TxidWithFee> Mempool::take(size_t N) const
 {
     std::vector<TxidWithFee> out;
-    for (auto p : txs) {
+    entries.for_each([&](const Entry& e) {
         if (out.size() == N)
-            break;
-        out.push_back({ p.first, p.second.fee });
-    }
+            return false;
+        out.push_back({ e.first, e.second.fee });
+        return true;
+    });
     return out;
 };
 
@@ -128,8 +360,8 @@ std::vector<TransactionId> Mempool::filter_new(const std::vector<TxidWithFee>& v
 {
     std::vector<TransactionId> out;
     for (auto& t : v) {
-        auto iter = txs.find(t.txid);
-        if (iter == txs.end() || t.fee > iter->second.fee)
+        auto slot { find(t.txid) };
+        if (!slot || t.fee > entries[*slot].second.fee)
             out.push_back(t.txid);
     }
     return out;
@@ -142,33 +374,78 @@ int32_t Mempool::insert_tx(const TransferTxExchangeMessage& pm,
 {
     if (pm.from_address(txhash) != af.address)
         return EFAKEACCID;
+    return insert_recovered_tx(pm, txh, txhash, af);
+}
 
+int32_t Mempool::insert_recovered_tx(const TransferTxExchangeMessage& pm,
+    TransactionHeight txh,
+    const TxHash& txhash,
+    const AddressFunds& af)
+{
     if (af.funds.is_zero())
         return EBALANCE;
-    auto& e = balanceEntries.try_emplace(pm.from_id(), af).first->second;
-
-    assert(!e.avail.is_zero());
     Funds spend = pm.fee() + pm.amount;
-    if (spend.overflow() || spend + e._used > e.avail)
+    if (spend.overflow())
         return EBALANCE;
 
-    if (auto iter = txs.find(pm.txid); iter != txs.end()) {
-        if (iter->second.fee >= pm.compactFee) {
+    // fee bump of the transaction with the same account, pin and nonce
+    if (auto slot { find(pm.txid) }) {
+        if (entries[*slot].second.fee >= pm.compactFee)
             return ENONCE;
-        }
-        erase(iter);
+        return replace_slot(*slot, pm, txh, txhash, af);
     }
 
-    auto [iter, inserted] = txs.try_emplace(pm.txid,
-        pm.reserved, pm.compactFee, pm.toAddr, pm.amount, pm.signature, txhash, txh);
-    assert(inserted);
+    auto* e = &balance_entry(pm.from_id(), af);
+    assert(!e->avail.is_zero());
+    if (spend + e->_used > e->avail)
+        return EBALANCE;
+
+    // a full mempool makes room by evicting its lowest fee entry
+    if (entries.size() >= (master ? budget().max_entries(approxEntryBytes, maxSize) : maxSize)) {
+        const FeeKey lowest { byFee.back() };
+        if (lowest.fee >= pm.compactFee)
+            return EMEMPOOLFULL;
+        erase_slot(lowest.slot);
+        // erasing may have removed or moved the balance entry
+        e = &balance_entry(pm.from_id(), af);
+    }
+
+    Entry entry { pm.txid, EntryValue { pm.reserved, pm.compactFee, pm.toAddr, pm.amount, pm.signature, txhash, txh } };
+    insert(entry);
     if (master)
-        log.push_back(Put { *iter });
-    byPin.insert(iter);
-    byFee.insert(iter);
-    byHash.insert(iter);
-    e._used += spend;
+        log.push_back(Put { entry });
+    e->_used += spend;
     return 0;
 };
 
+int32_t Mempool::replace_slot(uint32_t slot, const TransferTxExchangeMessage& pm,
+    TransactionHeight txh, const TxHash& txhash, const AddressFunds& af)
+{
+    auto& e { balance_entry(pm.from_id(), af) };
+    const Entry& old { entries[slot] };
+    const Funds oldSpend { old.second.fee.uncompact() + old.second.amount };
+    const Funds spend { pm.fee() + pm.amount };
+    assert(oldSpend <= e._used);
+    if (spend + (e._used - oldSpend) > e.avail)
+        return EBALANCE;
+
+    changed();
+    // txid and pin height are unchanged, only the hash and fee indexes move
+    const FeeKey oldKey { old.second.fee, old.first, slot };
+    byFee.erase(oldKey);
+    template_erase(oldKey);
+    byHash.erase(hash(old.second.hash), slot);
+
+    Entry entry { pm.txid, EntryValue { pm.reserved, pm.compactFee, pm.toAddr, pm.amount, pm.signature, txhash, txh } };
+    entries.replace(slot, entry);
+    byHash.insert(hash(entry.second.hash), slot);
+    const FeeKey k { entry.second.fee, entry.first, slot };
+    byFee.insert(k);
+    template_insert(k);
+    if (master)
+        log.push_back(Put { entry });
+    e._used -= oldSpend;
+    e._used += spend;
+    return 0;
+}
 }
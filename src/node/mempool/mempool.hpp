@@ -1,11 +1,15 @@
 #pragma once
 #include "comparators.hpp"
+#include "entry_store.hpp"
 #include "general/address_funds.hpp"
 #include "mempool/log.hpp"
-#include <set>
+#include "ordered_array.hpp"
+#include "pin_buckets.hpp"
+#include "slot_index.hpp"
+#include "snapshot.hpp"
 #include <vector>
 namespace chainserver{
-    struct TransactionIds;
+    class TransactionIds;
 }
 namespace mempool {
 struct BalanceEntry {
@@ -13,37 +17,56 @@ struct BalanceEntry {
     Funds avail { 0 };
     Address address;
     Funds used() { return _used; };
-    BalanceEntry(const AddressFunds& af)
+    BalanceEntry(AccountId accountId, const AddressFunds& af)
         : avail(af.funds)
-        , address(af.address) {};
+        , address(af.address)
+        , accountId(accountId) {};
 private:
+    AccountId accountId;
     Funds _used { 0 };
 };
 
-class Mempool {
-    using iter_t = Txmap::iterator;
+// Incrementally maintained result of Mempool::get_payments(n), the
+// transactions selected for new blocks. Every mempool entry passed the
+// BalanceEntry check on insertion, so any selection is balance feasible.
+struct BlockTemplate {
+    size_t n { 0 }; // requested size
+    uint64_t version { 0 }; // incremented on every change
+    std::vector<FeeKey> keys {}; // in get_payments order
+    std::vector<TransferTxExchangeMessage> payments {};
+    std::vector<Hash> hashes {};
+    Funds totalFee { 0 };
+};
 
+// Entries live in a contiguous EntryStore, they are indexed by flat
+// hash indexes (txid, tx hash), by pin height buckets and by a flat
+// ordered array (fee).
+class Mempool {
 public:
-    Mempool(bool master = true, size_t maxSize = 100000)
-        : master(master)
-        , maxSize(maxSize)
-    {
-    }
+    // a full master mempool evicts its lowest fee entry for higher fee
+    // transactions
+    Mempool(bool master = true, size_t maxSize = 100000);
 
     [[nodiscard]] Log pop_log()
     {
         return std::move(log);
         log.clear();
     }
-    void apply_log(const Log& log);
+    void apply_delta(const Delta&);
     int32_t insert_tx(const TransferTxExchangeMessage& pm, TransactionHeight txh, const TxHash& hash, const AddressFunds& e);
+    // e.address must already be verified to be the signer of pm
+    int32_t insert_recovered_tx(const TransferTxExchangeMessage& pm, TransactionHeight txh, const TxHash& hash, const AddressFunds& e);
     void erase(TransactionId id);
     void erase_from_height(Height);
     void erase_before_height(Height);
 
     // getters
+    [[nodiscard]] size_t size() const { return entries.size(); }
     [[nodiscard]] auto get_payments(size_t n, bool log, std::vector<Hash>* hashes = nullptr) const
         -> std::vector<TransferTxExchangeMessage>;
+    [[nodiscard]] auto block_template(size_t n, bool log) const -> const BlockTemplate&;
+    [[nodiscard]] uint64_t block_template_version() const { return blockTemplate.version; }
+    [[nodiscard]] auto snapshot() const -> std::shared_ptr<const Snapshot>;
     [[nodiscard]] auto take(size_t) const -> std::vector<TxidWithFee>;
     [[nodiscard]] auto filter_new(const std::vector<TxidWithFee>&) const
         -> std::vector<TransactionId>;
@@ -55,18 +78,42 @@ public:
         -> std::optional<TransferTxExchangeMessage>;
 
 private:
-    void apply_logevent(const Put&);
-    void apply_logevent(const Erase&);
-    void erase(Txmap::iterator);
+    void insert(const Entry&);
+    void erase_slot(uint32_t slot);
+    // in place replacement by a higher fee transaction with the same txid
+    int32_t replace_slot(uint32_t slot, const TransferTxExchangeMessage& pm,
+        TransactionHeight txh, const TxHash& hash, const AddressFunds& af);
+    void erase_unpinned(uint32_t slot); // already removed from byPin
+    void erase_bucket(std::vector<uint32_t> slots);
+    [[nodiscard]] std::optional<uint32_t> find(const TransactionId&) const;
+    [[nodiscard]] BalanceEntry& balance_entry(AccountId, const AddressFunds&);
+    [[nodiscard]] BalanceEntry* find_balance_entry(AccountId);
+    [[nodiscard]] const BalanceEntry* find_balance_entry(AccountId) const;
+    void erase_balance_entry(BalanceEntry&);
+    uint64_t hash(const TransactionId&) const;
+    uint64_t hash(HashView) const;
+    uint64_t hash(AccountId) const;
+    void template_insert(const FeeKey&);
+    void template_erase(const FeeKey&);
+    void changed()
+    {
+        version += 1;
+        cachedSnapshot.reset();
+    }
 
 private:
-
     Log log;
-    Txmap txs;
-    std::set<iter_t, ComparatorPin> byPin;
-    std::set<iter_t, ComparatorFee> byFee;
-    std::set<iter_t, ComparatorHash> byHash;
-    std::map<AccountId, BalanceEntry> balanceEntries;
+    EntryStore entries;
+    SlotIndex byTxid;
+    SlotIndex byHash;
+    PinBuckets byPin;
+    OrderedArray<FeeKey, ComparatorFee> byFee;
+    std::vector<BalanceEntry> balanceEntries; // dense, indexed by byAccount
+    SlotIndex byAccount;
+    mutable BlockTemplate blockTemplate;
+    uint64_t version { 0 }; // incremented on every change
+    mutable std::shared_ptr<const Snapshot> cachedSnapshot;
+    uint64_t hashSeed; // random, against crafted index collisions
     bool master;
     size_t maxSize;
 };
@@ -0,0 +1,124 @@
+#pragma once
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <optional>
+#include <vector>
+
+namespace mempool {
+
+// Flat replacement for std::set of small trivially copyable keys. Keys
+// are kept in consecutive sorted chunks of bounded size (like the leaf
+// level of a B-tree) such that inserts and erases move at most one chunk
+// and iteration runs over contiguous memory.
+template <typename T, typename Less = std::less<>, size_t ChunkSize = 128>
+class OrderedArray {
+    using Chunk = std::vector<T>;
+
+public:
+    size_t size() const { return n; }
+    bool empty() const { return n == 0; }
+    const T& front() const { return chunks.front().front(); }
+    const T& back() const { return chunks.back().back(); }
+
+    // returns false if an equivalent key is present already
+    bool insert(const T& t)
+    {
+        if (chunks.empty()) {
+            chunks.emplace_back().reserve(ChunkSize);
+            chunks.back().push_back(t);
+            n = 1;
+            return true;
+        }
+        auto ci { chunk_of(t) };
+        if (ci == chunks.end())
+            ci = std::prev(ci); // append to last chunk
+        auto& c { *ci };
+        auto pos { std::lower_bound(c.begin(), c.end(), t, less) };
+        if (pos != c.end() && !less(t, *pos))
+            return false;
+        c.insert(pos, t);
+        n += 1;
+        if (c.size() >= 2 * ChunkSize) {
+            // split full chunk in halves
+            Chunk upper(c.begin() + ChunkSize, c.end());
+            c.erase(c.begin() + ChunkSize, c.end());
+            chunks.insert(ci + 1, std::move(upper));
+        }
+        return true;
+    }
+
+    // returns false if no equivalent key was present
+    bool erase(const T& t)
+    {
+        auto ci { chunk_of(t) };
+        if (ci == chunks.end())
+            return false;
+        auto& c { *ci };
+        auto pos { std::lower_bound(c.begin(), c.end(), t, less) };
+        if (pos == c.end() || less(t, *pos))
+            return false;
+        c.erase(pos);
+        n -= 1;
+        if (c.empty())
+            chunks.erase(ci);
+        else if (ci + 1 != chunks.end() && c.size() + (ci + 1)->size() < ChunkSize) {
+            // merge small neighbours
+            c.insert(c.end(), (ci + 1)->begin(), (ci + 1)->end());
+            chunks.erase(ci + 1);
+        }
+        return true;
+    }
+
+    // calls f(key) in ascending order until f returns false
+    template <typename F>
+    void for_each(F&& f) const
+    {
+        for (auto& c : chunks)
+            for (auto& t : c)
+                if (!f(t))
+                    return;
+    }
+
+    // calls f(key) in descending order until f returns false
+    template <typename F>
+    void for_each_reverse(F&& f) const
+    {
+        for (auto ci = chunks.rbegin(); ci != chunks.rend(); ++ci)
+            for (auto it = ci->rbegin(); it != ci->rend(); ++it)
+                if (!f(*it))
+                    return;
+    }
+
+    // largest key less than t, t need not be present
+    std::optional<T> prev(const T& t) const
+    {
+        auto ci { chunk_of(t) };
+        if (ci != chunks.end()) {
+            auto pos { std::lower_bound(ci->begin(), ci->end(), t, less) };
+            if (pos != ci->begin())
+                return *std::prev(pos);
+        }
+        if (ci == chunks.begin())
+            return {};
+        return std::prev(ci)->back();
+    }
+
+private:
+    // first chunk whose last element is not less than t
+    auto chunk_of(const T& t)
+    {
+        return std::lower_bound(chunks.begin(), chunks.end(), t,
+            [&](const Chunk& c, const T& t) { return less(c.back(), t); });
+    }
+    auto chunk_of(const T& t) const
+    {
+        return std::lower_bound(chunks.begin(), chunks.end(), t,
+            [&](const Chunk& c, const T& t) { return less(c.back(), t); });
+    }
+
+    std::vector<Chunk> chunks;
+    size_t n { 0 };
+    [[no_unique_address]] Less less;
+};
+}
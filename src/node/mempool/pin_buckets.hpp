@@ -0,0 +1,58 @@
+#pragma once
+#include "block/chain/height.hpp"
+#include <cassert>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+namespace mempool {
+
+// Slot numbers grouped by pin height. Pin heights are multiples of 32, so
+// there are few buckets. A slot is removed in O(1) by moving the last slot
+// of its bucket into its place, whole buckets are taken out when their pin
+// height leaves the valid range.
+class PinBuckets {
+    using Buckets = std::map<Height, std::vector<uint32_t>>;
+
+public:
+    bool empty() const { return buckets.empty(); }
+    Height lowest() const { return buckets.begin()->first; }
+    Height highest() const { return buckets.rbegin()->first; }
+
+    void insert(Height pinHeight, uint32_t slot)
+    {
+        auto& b { buckets[pinHeight] };
+        if (position.size() <= slot)
+            position.resize(slot + 1);
+        position[slot] = b.size();
+        b.push_back(slot);
+    }
+
+    void erase(Height pinHeight, uint32_t slot)
+    {
+        auto iter { buckets.find(pinHeight) };
+        assert(iter != buckets.end());
+        auto& b { iter->second };
+        const uint32_t i { position[slot] };
+        assert(b[i] == slot);
+        b[i] = b.back();
+        position[b[i]] = i;
+        b.pop_back();
+        if (b.empty())
+            buckets.erase(iter);
+    }
+
+    std::vector<uint32_t> pop_lowest() { return pop(buckets.begin()); }
+    std::vector<uint32_t> pop_highest() { return pop(std::prev(buckets.end())); }
+
+private:
+    std::vector<uint32_t> pop(Buckets::iterator iter)
+    {
+        auto slots { std::move(iter->second) };
+        buckets.erase(iter);
+        return slots;
+    }
+    Buckets buckets;
+    std::vector<uint32_t> position; // index within the bucket, by slot
+};
+}
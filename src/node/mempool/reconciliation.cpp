@@ -0,0 +1,115 @@
+#include "reconciliation.hpp"
+#include "block/chain/height.hpp"
+#include <algorithm>
+#include <cassert>
+
+namespace mempool {
+namespace {
+uint64_t mix(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
+uint64_t check_hash(uint64_t shortId)
+{
+    return mix(shortId ^ 0x9e3779b97f4a7c15ull);
+}
+}
+
+TxSketch::TxSketch(uint64_t salt, size_t nCells)
+    : _salt(salt)
+{
+    nCells = std::clamp(nCells, MINCELLS, MAXCELLS);
+    _cells.resize(nCells - nCells % HASHES);
+}
+
+TxSketch::TxSketch(uint64_t salt, std::vector<Cell> cells)
+    : _salt(salt)
+    , _cells(std::move(cells))
+{
+    assert(_cells.size() % HASHES == 0);
+}
+
+uint64_t TxSketch::short_id(uint64_t salt, const TransactionId& txid)
+{
+    uint64_t lower { (uint64_t(txid.pinHeight.value()) << 32) | txid.nonceId.value() };
+    return mix(mix(salt ^ txid.accountId.value()) ^ lower);
+}
+
+uint64_t TxSketch::add(const TransactionId& txid)
+{
+    auto id { short_id(_salt, txid) };
+    toggle(id, 1);
+    return id;
+}
+
+void TxSketch::toggle(uint64_t shortId, int32_t sign)
+{
+    // one cell in each of the HASHES partitions
+    const size_t partition { _cells.size() / HASHES };
+    const uint64_t h { check_hash(shortId) };
+    for (size_t i = 0; i < HASHES; ++i) {
+        auto& c { _cells[i * partition + mix(shortId + i) % partition] };
+        c.count += sign;
+        c.keySum ^= shortId;
+        c.hashSum ^= h;
+    }
+}
+
+TxSketch& TxSketch::operator-=(const TxSketch& other)
+{
+    assert(_cells.size() == other._cells.size());
+    for (size_t i = 0; i < _cells.size(); ++i) {
+        _cells[i].count -= other._cells[i].count;
+        _cells[i].keySum ^= other._cells[i].keySum;
+        _cells[i].hashSum ^= other._cells[i].hashSum;
+    }
+    return *this;
+}
+
+auto TxSketch::decode() const -> std::optional<Difference>
+{
+    TxSketch s(*this);
+    auto pure = [&](const Cell& c) {
+        return (c.count == 1 || c.count == -1) && c.hashSum == check_hash(c.keySum);
+    };
+    Difference d;
+    std::vector<size_t> queue;
+    for (size_t i = 0; i < s._cells.size(); ++i)
+        if (pure(s._cells[i]))
+            queue.push_back(i);
+    while (!queue.empty()) {
+        auto& c { s._cells[queue.back()] };
+        queue.pop_back();
+        if (!pure(c))
+            continue;
+        const auto id { c.keySum };
+        const auto sign { c.count };
+        (sign > 0 ? d.ours : d.theirs).push_back(id);
+        if (d.size() > s._cells.size())
+            return {};
+        s.toggle(id, -sign);
+        const size_t partition { s._cells.size() / HASHES };
+        for (size_t i = 0; i < HASHES; ++i) {
+            auto j { i * partition + mix(id + i) % partition };
+            if (pure(s._cells[j]))
+                queue.push_back(j);
+        }
+    }
+    for (auto& c : s._cells)
+        if (c.count != 0 || c.keySum != 0 || c.hashSum != 0)
+            return {};
+    return d;
+}
+
+size_t ReconState::sketch_cells() const
+{
+    // peeling fails rarely with 2 cells per element, the constructor
+    // rounds to a multiple of HASHES
+    return 2 * expectedDifference + TxSketch::MINCELLS;
+}
+}
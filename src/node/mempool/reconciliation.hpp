@@ -0,0 +1,65 @@
+#pragma once
+#include "block/body/transaction_id.hpp"
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <vector>
+
+namespace mempool {
+
+// Invertible Bloom lookup table over salted 64 bit short ids of
+// transaction ids. Subtracting the sketch of a peer's set from the sketch
+// of our set and peeling the result yields the symmetric difference, as
+// long as it is small compared to the number of cells.
+class TxSketch {
+public:
+    struct Cell {
+        int32_t count { 0 };
+        uint64_t keySum { 0 };
+        uint64_t hashSum { 0 };
+    };
+    static constexpr size_t HASHES = 4;
+    static constexpr size_t MINCELLS = HASHES * 8;
+    static constexpr size_t MAXCELLS = HASHES * 1024;
+    static constexpr size_t cellsize = 4 + 8 + 8;
+
+    TxSketch(uint64_t salt, size_t nCells);
+    TxSketch(uint64_t salt, std::vector<Cell> cells);
+    static uint64_t short_id(uint64_t salt, const TransactionId&);
+
+    // returns the short id of the inserted transaction id
+    uint64_t add(const TransactionId& txid);
+    TxSketch& operator-=(const TxSketch&);
+
+    struct Difference {
+        std::vector<uint64_t> ours; // only in the minuend
+        std::vector<uint64_t> theirs; // only in the subtrahend
+        size_t size() const { return ours.size() + theirs.size(); }
+    };
+    // empty if the difference is too large to be peeled
+    std::optional<Difference> decode() const;
+
+    uint64_t salt() const { return _salt; }
+    auto& cells() const { return _cells; }
+
+private:
+    void toggle(uint64_t shortId, int32_t sign);
+    uint64_t _salt;
+    std::vector<Cell> _cells;
+};
+
+// number of best mempool entries that take part in reconciliation
+constexpr size_t RECONSETSIZE = 1000;
+
+// per peer reconciliation state of the initiating side
+struct ReconState {
+    std::optional<uint32_t> nonce; // of the pending TxreconreqMsg
+    std::map<uint64_t, TxidWithFee> sketched; // short ids of the pending sketch
+    size_t sketch_cells() const;
+    void on_success(size_t difference) { expectedDifference = difference; }
+    void on_failure() { expectedDifference = 2 * expectedDifference + 8; }
+
+private:
+    size_t expectedDifference { 8 };
+};
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include <cassert>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace mempool {
+
+// Open addressing hash index (linear probing) of slot numbers. Only the
+// hash value and the slot are stored, key equality is decided by the
+// caller through the slot, so keys are not duplicated in the index.
+class SlotIndex {
+    static constexpr uint32_t emptySlot = uint32_t(-1);
+    struct Bucket {
+        uint32_t hash;
+        uint32_t slot { emptySlot };
+    };
+
+public:
+    size_t size() const { return n; }
+
+    // eq(slot) must return true if slot holds the looked up key
+    template <typename Eq>
+    std::optional<uint32_t> find(uint64_t hash, Eq&& eq) const
+    {
+        if (buckets.empty())
+            return {};
+        const uint32_t h(hash);
+        for (size_t i = h & mask();; i = (i + 1) & mask()) {
+            auto& b { buckets[i] };
+            if (b.slot == emptySlot)
+                return {};
+            if (b.hash == h && eq(b.slot))
+                return b.slot;
+        }
+    }
+
+    void insert(uint64_t hash, uint32_t slot)
+    {
+        assert(slot != emptySlot);
+        if (2 * (n + 1) > buckets.size())
+            grow();
+        place({ uint32_t(hash), slot });
+        n += 1;
+    }
+
+    void erase(uint64_t hash, uint32_t slot)
+    {
+        const uint32_t h(hash);
+        size_t i { h & mask() };
+        while (buckets[i].slot != slot) {
+            assert(buckets[i].slot != emptySlot);
+            i = (i + 1) & mask();
+        }
+        // backward shift deletion, no tombstones
+        for (size_t j = (i + 1) & mask(); buckets[j].slot != emptySlot; j = (j + 1) & mask()) {
+            size_t home { buckets[j].hash & mask() };
+            if (((j - home) & mask()) >= ((j - i) & mask())) {
+                buckets[i] = buckets[j];
+                i = j;
+            }
+        }
+        buckets[i].slot = emptySlot;
+        n -= 1;
+    }
+
+    // slot of a stored entry changed
+    void relocate(uint64_t hash, uint32_t from, uint32_t to)
+    {
+        const uint32_t h(hash);
+        size_t i { h & mask() };
+        while (buckets[i].slot != from) {
+            assert(buckets[i].slot != emptySlot);
+            i = (i + 1) & mask();
+        }
+        buckets[i].slot = to;
+    }
+
+private:
+    size_t mask() const { return buckets.size() - 1; }
+    void place(Bucket b)
+    {
+        size_t i { b.hash & mask() };
+        while (buckets[i].slot != emptySlot)
+            i = (i + 1) & mask();
+        buckets[i] = b;
+    }
+    void grow()
+    {
+        auto old { std::move(buckets) };
+        buckets.assign(old.empty() ? 64 : 2 * old.size(), {});
+        for (auto& b : old)
+            if (b.slot != emptySlot)
+                place(b);
+    }
+
+    std::vector<Bucket> buckets;
+    size_t n { 0 };
+};
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include "entry.hpp"
+#include <memory>
+#include <vector>
+
+namespace mempool {
+// Immutable fee ordered copy of the mempool for API paging. It is built at
+// most once per mempool version and shared by all requests until the
+// mempool changes, pages are serialized from it on the API threads.
+struct Snapshot {
+    struct Row {
+        Entry entry;
+        Address from; // signer, known from the balance entry
+    };
+    uint64_t version;
+    std::vector<Row> rows; // highest fee first
+};
+}
@@ -1,31 +1,77 @@
 #include "ban_cache.hpp"
+#include "general/now.hpp"
+#include <algorithm>
+#include <bit>
+#include <cassert>
+
+uint64_t BanCache::key(IPv4 ip, uint8_t prefix)
+{
+    const uint32_t mask { prefix == 0 ? 0 : ~uint32_t(0) << (32 - prefix) };
+    return (uint64_t(prefix) << 32) | (ip.data & mask);
+}
+
+size_t BanCache::probe(uint64_t k) const
+{
+    // fibonacci hashing, linear probing
+    const size_t m { slots.size() - 1 };
+    size_t i = (k * 0x9e3779b97f4a7c15ull) >> 32 & m;
+    while (slots[i].key != k && slots[i].key != emptyKey)
+        i = (i + 1) & m;
+    return i;
+}
+
+void BanCache::rehash(size_t minCapacity)
+{
+    const uint32_t now { now_timestamp() };
+    auto old { std::move(slots) };
+    slots.assign(std::bit_ceil(std::max(minCapacity, size_t(64))), Slot {});
+    n = 0;
+    prefixes = 0;
+    for (auto& s : old) {
+        if (s.key == emptyKey || s.banUntil <= now)
+            continue;
+        slots[probe(s.key)] = s;
+        prefixes |= uint64_t(1) << (s.key >> 32);
+        n += 1;
+    }
+}
 
 void BanCache::clear()
 {
-    map.clear();
-    iters = {};
+    slots.clear();
+    n = 0;
+    prefixes = 0;
 };
-void BanCache::set(IPv4 ip, uint32_t banUntil)
+
+void BanCache::set_range(IPv4 net, uint8_t prefix, uint32_t banUntil)
 {
-    auto p = map.insert(std::make_pair(ip.data, banUntil));
-    if (p.second) { // newly inserted
-        iters.push(p.first);
-        if (iters.size() > maxSize) {
-            map.erase(iters.front());
-            iters.pop();
-        }
-    } else {
-        auto& expires = p.first->second;
-        if (expires < banUntil)
-            expires = banUntil;
+    assert(prefix <= 32);
+    if (2 * (n + 1) > slots.size())
+        rehash(4 * (n + 1));
+    const uint64_t k { key(net, prefix) };
+    auto& s { slots[probe(k)] };
+    if (s.key == emptyKey) {
+        s = { k, banUntil };
+        n += 1;
+        prefixes |= uint64_t(1) << prefix;
+    } else if (s.banUntil < banUntil) {
+        s.banUntil = banUntil;
     }
 }
 
-bool BanCache::get(IPv4 ip, uint32_t& banUntil)
+bool BanCache::get(IPv4 ip, uint32_t& banUntil) const
 {
-    auto iter = map.find(ip.data);
-    if (iter == map.end())
+    if (n == 0)
         return false;
-    banUntil = iter->second;
-    return true;
+    bool found { false };
+    for (auto p { prefixes }; p != 0; p &= p - 1) {
+        const uint8_t prefix = std::countr_zero(p);
+        auto& s { slots[probe(key(ip, prefix))] };
+        if (s.key == emptyKey)
+            continue;
+        if (!found || s.banUntil > banUntil)
+            banUntil = s.banUntil;
+        found = true;
+    }
+    return found;
 };
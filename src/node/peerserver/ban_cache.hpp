@@ -1,18 +1,34 @@
 #pragma once
 
-#include"general/tcp_util.hpp"
-#include<map>
-#include<queue>
-#include<cstddef>
-class BanCache
-{
+#include "general/tcp_util.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Open addressing table of all active bans. Entries are CIDR ranges, a
+// single address is a range with prefix 32. The table is loaded completely
+// from the database such that accept time checks never query it. Expired
+// bans are dropped when the table is rehashed.
+class BanCache {
 public:
-    BanCache (size_t maxSize=1000):maxSize(maxSize){};
-    void set(IPv4 ip, uint32_t banUntil);
-    bool get(IPv4 ip, uint32_t& banUntil);
+    void set(IPv4 ip, uint32_t banUntil) { set_range(ip, 32, banUntil); }
+    void set_range(IPv4 net, uint8_t prefix, uint32_t banUntil);
+    // latest ban expiry of all ranges containing ip
+    bool get(IPv4 ip, uint32_t& banUntil) const;
     void clear();
+    size_t size() const { return n; }
+
 private:
-    std::map<uint32_t,uint32_t> map;
-    std::queue<decltype(map)::iterator> iters;
-    const size_t maxSize;
+    static constexpr uint64_t emptyKey = ~uint64_t(0);
+    struct Slot {
+        uint64_t key { emptyKey };
+        uint32_t banUntil { 0 };
+    };
+    static uint64_t key(IPv4 ip, uint8_t prefix);
+    size_t probe(uint64_t key) const; // slot with key or first empty slot
+    void rehash(size_t minCapacity);
+
+    std::vector<Slot> slots;
+    size_t n { 0 };
+    uint64_t prefixes { 0 }; // bit p is set if ranges with prefix p exist
 };
@@ -1,9 +1,8 @@
 #include "peerserver.hpp"
-#include "asyncio/conman.hpp"
-#include "asyncio/connection.hpp"
 #include "config/config.hpp"
 #include "db/peer_db.hpp"
 #include "general/now.hpp"
+#include "general/thread_settings.hpp"
 
 namespace {
 uint32_t bantime(int32_t /*offense*/)
@@ -14,9 +13,19 @@ uint32_t bantime(int32_t /*offense*/)
 
 PeerServer::PeerServer(PeerDB& db, const Config& config)
     : db(db)
+    , nextPrune(std::chrono::steady_clock::now())
+    , nextConnectRowid(db.max_connect_rowid() + 1)
     , enableBan(config.peers.enableBan)
 {
-    worker = std::thread(&PeerServer::work, this);
+    for (auto& b : db.get_banned_peers())
+        bancache.set(b.ip, b.banuntil);
+    for (auto& r : db.get_banned_ranges())
+        bancache.set_range(r.net, r.prefix, r.banuntil);
+    publish_bans();
+    worker = std::thread([this, s = config.threads.peerserver]() {
+        apply_thread_settings(s, "peerserver");
+        work();
+    });
 }
 void PeerServer::register_close(IPv4 address, uint32_t now,
     int32_t offense, int64_t rowid)
@@ -24,12 +33,75 @@ void PeerServer::register_close(IPv4 address, uint32_t now,
 
     if (errors::is_malicious(offense)) {
         uint32_t banuntil = now + bantime(offense);
-        db.set_ban(address, banuntil, offense);
-        db.insert_offense(address, offense);
+        buffer_write(WriteBan { address, banuntil, offense });
         bancache.set(address, banuntil);
+        publish_bans();
     }
     if (rowid >= 0)
-        db.insert_disconnect(rowid, now, offense);
+        buffer_write(WriteDisconnect { rowid, now, offense });
+}
+
+void PeerServer::buffer_write(Write w)
+{
+    if (writes.empty())
+        flushDeadline = std::chrono::steady_clock::now() + flushInterval;
+    writes.push_back(std::move(w));
+}
+
+void PeerServer::flush_writes()
+{
+    using namespace std::chrono;
+    const bool prune { steady_clock::now() >= nextPrune };
+    if (writes.empty() && !prune)
+        return;
+    auto t = db.transaction();
+    for (auto& w : writes)
+        std::visit([&](auto& w) { write(w); }, w);
+    if (prune) {
+        nextPrune = steady_clock::now() + pruneInterval;
+        const uint32_t ts { now_timestamp() };
+        db.prune_logs(ts > logRetentionSeconds ? ts - logRetentionSeconds : 0);
+    }
+    t.commit();
+    writes.clear();
+}
+
+void PeerServer::write(const WriteBan& w)
+{
+    db.set_ban(w.ip, w.banuntil, w.offense);
+    db.insert_offense(w.ip, w.offense);
+}
+void PeerServer::write(const PeerDB::BanRange& r)
+{
+    db.set_ban_range(r);
+}
+void PeerServer::write(const WriteNewPeer& w)
+{
+    db.insert_peer(w.ip);
+}
+void PeerServer::write(const WriteConnect& w)
+{
+    db.insert_connect(w.rowid, w.ip.data, w.begin);
+}
+void PeerServer::write(const WriteDisconnect& w)
+{
+    db.insert_disconnect(w.rowid, w.end, w.code);
+}
+void PeerServer::write(const WriteRefuse& w)
+{
+    db.insert_refuse(w.ip, w.timestamp);
+}
+void PeerServer::write(const RegisterPeer& w)
+{
+    db.peer_insert(w.a);
+}
+void PeerServer::write(const SeenPeer& w)
+{
+    db.peer_seen(w.a, w.timestamp);
+}
+void PeerServer::write(const PeerStats& w)
+{
+    db.set_peer_stats(w.a, w.stats);
 }
 
 void PeerServer::work()
@@ -38,27 +110,29 @@ void PeerServer::work()
         decltype(events) tmpq;
         {
             std::unique_lock<std::mutex> l(mutex);
+            auto ready = [&]() { return hasWork || shutdown; };
+            if (writes.empty())
+                cv.wait(l, ready);
+            else
+                cv.wait_until(l, flushDeadline, ready);
             if (shutdown)
-                return;
-            while (!hasWork) {
-                cv.wait(l);
-            }
+                break;
             hasWork = false;
             std::swap(tmpq, events);
         }
-        {
-            auto t = db.transaction();
-            now = now_timestamp();
-            while (!tmpq.empty()) {
-                std::visit([&](auto& e) {
-                    handle_event(std::move(e));
-                },
-                    tmpq.front());
-                tmpq.pop();
-            }
-            t.commit();
+        now = now_timestamp();
+        while (!tmpq.empty()) {
+            std::visit([&](auto& e) {
+                handle_event(std::move(e));
+            },
+                tmpq.front());
+            tmpq.pop();
         }
+        if (writes.size() >= maxBufferedWrites
+            || std::chrono::steady_clock::now() >= flushDeadline)
+            flush_writes();
     }
+    flush_writes();
 }
 
 void PeerServer::handle_event(Offense&& o)
@@ -68,54 +142,79 @@ void PeerServer::handle_event(Offense&& o)
 
 void PeerServer::handle_event(Unban&& ub)
 {
+    flush_writes();
     bancache.clear();
+    publish_bans();
     spdlog::info("Reset bans");
     db.reset_bans();
     ub.cb({});
 };
 
+void PeerServer::handle_event(BanRange&& b)
+{
+    if (b.range.prefix > 32)
+        return b.cb(tl::make_unexpected(EBANPREFIX));
+    b.range.banuntil = now + b.seconds;
+    bancache.set_range(b.range.net, b.range.prefix, b.range.banuntil);
+    publish_bans();
+    buffer_write(b.range);
+    spdlog::info("Banned {}/{} for {} seconds", b.range.net.to_string(), b.range.prefix, b.seconds);
+    b.cb({});
+};
+
 void PeerServer::handle_event(GetOffenses&& go)
 {
+    flush_writes();
     go.cb(db.get_offenses(go.page));
 };
 
-void PeerServer::handle_event(NewConnection&& nc)
+void PeerServer::publish_bans()
 {
-    Connection* c = nc.c;
-    bool allowed = true;
-    const IPv4& ip = c->peer_address().ipv4;
+    banSnapshot.store(std::make_shared<const BanCache>(bancache));
+}
+
+std::optional<int64_t> PeerServer::validate(IPv4 ip)
+{
+    const uint32_t t { now_timestamp() };
     uint32_t banuntil;
-    int32_t offense;
-    if (bancache.get(ip, banuntil) || db.get_peer(ip.data, banuntil, offense)) { // found entry
-        if (enableBan == true && banuntil > now) {
-            allowed = false;
-            db.insert_refuse(ip, now);
-        }
-    } else {
-        db.insert_peer(ip);
-    };
-    if (allowed) {
-        auto rowid = db.insert_connect(ip.data, now);
-        nc.cm.async_validate(c, true, rowid);
-    } else {
-        nc.cm.async_validate(c, false, -1);
+    if (enableBan && banSnapshot.load()->get(ip, banuntil) && banuntil > t) {
+        (void)async_event(Accepted { ip, t, -1 });
+        return {};
     }
+    const int64_t rowid { nextConnectRowid.fetch_add(1, std::memory_order_relaxed) };
+    (void)async_event(Accepted { ip, t, rowid });
+    return rowid;
+}
+
+void PeerServer::handle_event(Accepted&& a)
+{
+    if (a.rowid < 0)
+        return buffer_write(WriteRefuse { a.ip, a.timestamp });
+    buffer_write(WriteNewPeer { a.ip });
+    buffer_write(WriteConnect { a.rowid, a.ip, a.timestamp });
 };
 void PeerServer::handle_event(BannedCB&& cb)
 {
+    flush_writes();
     auto banned = db.get_banned_peers();
     cb(banned);
 };
 void PeerServer::handle_event(RegisterPeer&& e)
 {
-    db.peer_insert(e.a);
+    buffer_write(std::move(e));
 };
 void PeerServer::handle_event(SeenPeer&& e)
 {
-    db.peer_seen(e.a, now);
+    e.timestamp = now;
+    buffer_write(std::move(e));
+};
+void PeerServer::handle_event(PeerStats&& e)
+{
+    buffer_write(std::move(e));
 };
 void PeerServer::handle_event(GetRecentPeers&& e)
 {
+    flush_writes();
     e.cb(db.recent_peers(e.maxEntries));
 };
 void PeerServer::handle_event(Inspect&& e)
@@ -7,16 +7,17 @@
 #include "general/errors.hpp"
 #include "general/tcp_util.hpp"
 #include "spdlog/spdlog.h"
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <cstdint>
+#include <memory>
 #include <mutex>
 #include <queue>
 #include <thread>
 #include <uv.h>
 #include <variant>
 
-class Connection;
-class Conman;
 struct Inspector;
 struct Config;
 
@@ -33,13 +34,19 @@ public:
 
 private:
     friend struct Inspector;
-    struct NewConnection {
-        Conman& cm;
-        Connection* c;
+    struct Accepted {
+        IPv4 ip;
+        uint32_t timestamp;
+        int64_t rowid; // negative if refused
     };
     struct Unban {
         ResultCB cb;
     };
+    struct BanRange {
+        PeerDB::BanRange range;
+        uint32_t seconds;
+        ResultCB cb;
+    };
 
     struct GetOffenses {
         Page page;
@@ -60,11 +67,11 @@ public:
         hasWork = true;
         cv.notify_one();
     }
-    bool async_validate(Conman& cm, Connection* c)
-    {
-        // make sure that addref is called before
-        return async_event(NewConnection { cm, c });
-    }
+    // Accept time check of inbound connections, called on the uv threads.
+    // Bans are read from an immutable snapshot the PeerServer thread
+    // publishes on every change, the connection log is written
+    // asynchronously. Returns the log rowid, nothing if refused.
+    std::optional<int64_t> validate(IPv4 ip);
     bool async_get_banned(BannedCB cb)
     {
         return async_event(cb);
@@ -73,6 +80,10 @@ public:
     {
         return async_event(Unban { std::move(cb) });
     }
+    bool async_ban_range(IPv4 net, uint8_t prefix, uint32_t seconds, ResultCB cb)
+    {
+        return async_event(BanRange { { net, prefix, 0 }, seconds, std::move(cb) });
+    }
     bool async_get_offenses(Page page, OffensesCb cb)
     {
         return async_event(GetOffenses { page, std::move(cb) });
@@ -85,8 +96,12 @@ public:
     {
         return async_event(SeenPeer { a });
     }
+    bool async_peer_stats(EndpointAddress a, PeerDB::PeerStats stats)
+    {
+        return async_event(PeerStats { a, stats });
+    }
     bool async_get_recent_peers(
-        std::function<void(std::vector<std::pair<EndpointAddress, uint32_t>>&&)>&& cb,
+        std::function<void(std::vector<PeerDB::RecentPeer>&&)>&& cb,
         size_t maxEntries = 100)
     {
         return async_event(GetRecentPeers { std::move(cb), maxEntries });
@@ -109,15 +124,20 @@ private:
     };
     struct SeenPeer {
         EndpointAddress a;
+        uint32_t timestamp { 0 };
+    };
+    struct PeerStats {
+        EndpointAddress a;
+        PeerDB::PeerStats stats;
     };
     struct GetRecentPeers {
-        std::function<void(std::vector<std::pair<EndpointAddress, uint32_t>>&&)> cb;
+        std::function<void(std::vector<PeerDB::RecentPeer>&&)> cb;
         size_t maxEntries;
     };
     struct Inspect {
         std::function<void(const PeerServer&)> cb;
     };
-    using Event = std::variant<Offense, NewConnection, GetOffenses, Unban, BannedCB, RegisterPeer, SeenPeer, GetRecentPeers, Inspect>;
+    using Event = std::variant<Offense, Accepted, GetOffenses, Unban, BanRange, BannedCB, RegisterPeer, SeenPeer, PeerStats, GetRecentPeers, Inspect>;
     [[nodiscard]] bool async_event(Event e)
     {
         std::unique_lock<std::mutex> l(mutex);
@@ -131,19 +151,71 @@ private:
     void work();
     void accept_connection();
     void register_close(IPv4 address, uint32_t now, int32_t offense, int64_t rowid);
+    void publish_bans();
+
+    ////////////////
+    // Buffered writes, flushed in one transaction after flushInterval or
+    // when maxBufferedWrites are queued. Reads depending on them flush first.
+    static constexpr auto flushInterval { std::chrono::milliseconds(500) };
+    static constexpr size_t maxBufferedWrites { 1000 };
+    static constexpr auto pruneInterval { std::chrono::hours(1) };
+    static constexpr uint32_t logRetentionSeconds { 30 * 24 * 60 * 60 };
+    struct WriteBan {
+        IPv4 ip;
+        uint32_t banuntil;
+        int32_t offense;
+    };
+    struct WriteNewPeer {
+        IPv4 ip;
+    };
+    struct WriteConnect {
+        int64_t rowid;
+        IPv4 ip;
+        uint32_t begin;
+    };
+    struct WriteDisconnect {
+        int64_t rowid;
+        uint32_t end;
+        int32_t code;
+    };
+    struct WriteRefuse {
+        IPv4 ip;
+        uint32_t timestamp;
+    };
+    using Write = std::variant<WriteBan, PeerDB::BanRange, WriteNewPeer, WriteConnect, WriteDisconnect, WriteRefuse, RegisterPeer, SeenPeer, PeerStats>;
+    void buffer_write(Write);
+    void flush_writes();
+    void write(const WriteBan&);
+    void write(const PeerDB::BanRange&);
+    void write(const WriteNewPeer&);
+    void write(const WriteConnect&);
+    void write(const WriteDisconnect&);
+    void write(const WriteRefuse&);
+    void write(const RegisterPeer&);
+    void write(const SeenPeer&);
+    void write(const PeerStats&);
+
     ////////////////
     //
     // private variables
     PeerDB& db;
     uint32_t now;
     BanCache bancache;
+    std::atomic<std::shared_ptr<const BanCache>> banSnapshot; // read by validate
+    std::vector<Write> writes;
+    std::chrono::steady_clock::time_point flushDeadline;
+    std::chrono::steady_clock::time_point nextPrune;
+    std::atomic<int64_t> nextConnectRowid;
+    const bool enableBan;
     void handle_event(Offense&&);
     void handle_event(Unban&&);
+    void handle_event(BanRange&&);
     void handle_event(GetOffenses&&);
-    void handle_event(NewConnection&&);
+    void handle_event(Accepted&&);
     void handle_event(BannedCB&&);
     void handle_event(RegisterPeer&&);
     void handle_event(SeenPeer&&);
+    void handle_event(PeerStats&&);
     void handle_event(GetRecentPeers&&);
     void handle_event(Inspect&&);
 
@@ -151,7 +223,6 @@ private:
     // Mutex protected variables
     std::mutex mutex;
     bool hasWork = false;
-    bool enableBan;
     bool shutdown = false;
     std::queue<Event> events;
     std::condition_variable cv;
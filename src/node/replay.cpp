@@ -0,0 +1,296 @@
+// End-to-end sync benchmark without networking. Blocks of an existing chain
+// database are dumped into a flat file which is then fed into a fresh
+// database through State::set_stage and State::add_stage just like the
+// eventloop does during block download.
+//
+// The reindex mode rebuilds the state, history and account history of a
+// chain database (stopped node) from its stored blocks into a fresh one,
+// for example after a schema change or state corruption. Block loading and
+// body checks of the next height range run in parallel to the sequential
+// application of the current one, the new database is bulk loaded.
+//
+// usage: wart-replay dump <chaindb> <dumpfile> [maxHeight]
+//        wart-replay replay <dumpfile> <newchaindb> [blocksPerStage]
+//        wart-replay reindex <chaindb> <newchaindb> [blocksPerStage]
+//
+// Dump file records: uint32 height, 80 byte header, uint32 body length, body
+#include "block/body/parse.hpp"
+#include "block/body/view.hpp"
+#include "block/chain/consensus_headers.hpp"
+#include "block/header/batch.hpp"
+#include "block/header/header_impl.hpp"
+#include "chainserver/state/state.hpp"
+#include "db/chain_db.hpp"
+#include "general/metrics.hpp"
+#include "general/reader.hpp"
+#include "general/task_pool.hpp"
+#include "general/writer.hpp"
+#include "global/globals.hpp"
+#include "spdlog/spdlog.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <future>
+#include <iostream>
+
+namespace {
+struct ECC {
+    ECC() { ECC_Start(); }
+    ~ECC() { ECC_Stop(); }
+};
+
+void write_u32(std::ofstream& f, uint32_t v)
+{
+    std::array<uint8_t, 4> a;
+    Writer(a.data(), a.size()) << v;
+    f.write(reinterpret_cast<const char*>(a.data()), a.size());
+}
+
+bool read_u32(std::ifstream& f, uint32_t& v)
+{
+    std::array<uint8_t, 4> a;
+    if (!f.read(reinterpret_cast<char*>(a.data()), a.size()))
+        return false;
+    v = Reader(a).uint32();
+    return true;
+}
+
+class DumpReader {
+public:
+    DumpReader(const std::string& path)
+        : f(path, std::ios::binary)
+    {
+        if (!f)
+            throw std::runtime_error("Cannot open " + path);
+    }
+    std::optional<Block> next(bool withBody)
+    {
+        uint32_t height, len;
+        Header header;
+        if (!read_u32(f, height))
+            return {};
+        if (!f.read(reinterpret_cast<char*>(header.data()), 80) || !read_u32(f, len))
+            throw std::runtime_error("Truncated dump file");
+        std::vector<uint8_t> body;
+        if (withBody) {
+            body.resize(len);
+            if (!f.read(reinterpret_cast<char*>(body.data()), len))
+                throw std::runtime_error("Truncated dump file");
+        } else {
+            f.seekg(len, std::ios::cur);
+        }
+        if (height != nextHeight++)
+            throw std::runtime_error("Dump file heights are not consecutive");
+        return Block { Height(height).nonzero_assert(), header, std::move(body) };
+    }
+
+private:
+    std::ifstream f;
+    uint32_t nextHeight { 1 };
+};
+
+int dump(const std::string& dbpath, const std::string& out, uint32_t maxHeight)
+{
+    ChainDB db(dbpath);
+    Height length { 0 };
+    for (auto& b : std::get<0>(db.getConsensusHeaders()).batches)
+        length = length + b.size();
+    if (maxHeight > 0 && length.value() > maxHeight)
+        length = Height(maxHeight);
+
+    std::ofstream f(out, std::ios::binary | std::ios::trunc);
+    constexpr uint32_t chunk { 1000 };
+    for (Height begin { 1 }; begin <= length; begin = begin + chunk) {
+        Height end { std::min(begin.value() + chunk, length.value() + 1) };
+        for (auto id : db.consensus_block_ids(begin, end)) {
+            auto b { db.get_block(id) };
+            if (!b)
+                throw std::runtime_error("Cannot load block");
+            write_u32(f, b->height.value());
+            f.write(reinterpret_cast<const char*>(b->header.data()), 80);
+            write_u32(f, b->body.size());
+            f.write(reinterpret_cast<const char*>(b->body.data().data()), b->body.size());
+        }
+    }
+    if (!f.flush())
+        throw std::runtime_error("Cannot write " + out);
+    spdlog::info("Dumped {} blocks", length.value());
+    return 0;
+}
+
+int replay(const std::string& in, const std::string& dbpath, size_t blocksPerStage)
+{
+    using namespace std::chrono;
+    BatchRegistry breg;
+    global_init(&breg, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr);
+    ChainDB db(dbpath);
+    chainserver::State state(db, breg, {});
+    if (state.chainlength() != 0)
+        throw std::runtime_error("Replay needs an empty chain database");
+
+    // first pass: headers only
+    std::vector<Batch> batches;
+    {
+        DumpReader r(in);
+        Batch b;
+        while (auto block { r.next(false) }) {
+            b.append(block->header);
+            if (b.complete()) {
+                batches.push_back(std::move(b));
+                b = {};
+            }
+        }
+        if (b.size() > 0)
+            batches.push_back(std::move(b));
+    }
+    const ExtendableHeaderchain headers(std::move(batches), {}, breg);
+    const Height length { headers.length() };
+    spdlog::info("Replaying {} blocks", length.value());
+
+    // second pass: bodies
+    const auto begin { steady_clock::now() };
+    auto firstMiss { state.set_stage(Headerchain(static_cast<const Headerchain&>(headers))).firstMissHeight };
+    if (!firstMiss || *firstMiss != Height(1))
+        throw std::runtime_error("Unexpected stage state");
+    DumpReader r(in);
+    size_t nTxs { 0 };
+    std::vector<Block> blocks;
+    auto flush = [&] {
+        if (blocks.empty())
+            return;
+        auto [res, update] { state.add_stage(blocks, headers) };
+        if (res.ce.is_error())
+            throw std::runtime_error("Block " + std::to_string(res.ce.height().value()) + " rejected: " + res.ce.err_name());
+        while (state.garbage_collect(true)) { }
+        blocks.clear();
+    };
+    while (auto block { r.next(true) }) {
+        BodyView bv(block->body.view());
+        if (bv.valid())
+            for (auto t : bv.transfers()) {
+                (void)t;
+                nTxs += 1;
+            }
+        blocks.push_back(std::move(*block));
+        if (blocks.size() >= blocksPerStage)
+            flush();
+    }
+    flush();
+    const double s { duration<double>(steady_clock::now() - begin).count() };
+
+    const double sqlite { metrics::total_seconds("warthog_sqlite_statement_seconds") };
+    const double sig { metrics::total_seconds("warthog_signature_recovery_seconds") };
+    printf("{\"blocks\":%u,\"transactions\":%zu,\"seconds\":%.3f,\"blocks_per_second\":%.1f,"
+           "\"transactions_per_second\":%.1f,\"sqlite_seconds\":%.3f,\"signature_seconds\":%.3f}\n",
+        length.value(), nTxs, s, length.value() / s, nTxs / s, sqlite, sig);
+    return 0;
+}
+
+// blocks [begin, end) with bodies checked against the headers
+std::vector<Block> load_range(const ChainDB& db, const Headerchain& headers, Height begin, Height end)
+{
+    std::vector<Block> blocks;
+    for (auto id : db.consensus_block_ids(begin, end)) {
+        auto b { db.get_block(id) };
+        if (!b)
+            throw std::runtime_error("Cannot load block");
+        blocks.push_back(std::move(*b));
+    }
+    if (blocks.size() != end - begin)
+        throw std::runtime_error("Missing blocks in [" + std::to_string(begin.value()) + "," + std::to_string(end.value()) + ")");
+    std::vector<int32_t> errors(blocks.size(), 0);
+    task_pool().parallel_for(blocks.size(), [&](size_t i) {
+        auto& b { blocks[i] };
+        BodyView bv(b.body.view());
+        if (b.height != begin + i || !(b.header == headers[b.height]))
+            errors[i] = EHEADERLINK;
+        else if (!bv.valid())
+            errors[i] = EMALFORMED;
+        else if (b.header.merkleroot() != bv.merkleRoot(b.height))
+            errors[i] = EMROOT;
+    });
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        if (errors[i] != 0)
+            throw std::runtime_error("Stored block " + std::to_string((begin + i).value()) + " is corrupted: " + Error(errors[i]).err_name());
+    }
+    return blocks;
+}
+
+int reindex(const std::string& srcpath, const std::string& dstpath, size_t blocksPerStage)
+{
+    using namespace std::chrono;
+    BatchRegistry breg;
+    global_init(&breg, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr);
+    const ChainDB src(srcpath);
+    ChainDB db(dstpath, SQLiteProfile::Sync); // bulk loading, lookup indices are built at the end
+    db.set_lookup_indices(false);
+    chainserver::State state(db, breg, {});
+    if (state.chainlength() != 0)
+        throw std::runtime_error("Reindex needs an empty chain database");
+
+    // worksums are recomputed from the headers
+    const ExtendableHeaderchain headers(std::move(std::get<0>(src.getConsensusHeaders()).batches), {}, breg);
+    const Height length { headers.length() };
+    spdlog::info("Reindexing {} blocks", length.value());
+
+    const auto begin { steady_clock::now() };
+    auto firstMiss { state.set_stage(Headerchain(static_cast<const Headerchain&>(headers))).firstMissHeight };
+    if (length.value() > 0 && (!firstMiss || *firstMiss != Height(1)))
+        throw std::runtime_error("Unexpected stage state");
+    auto load = [&](Height from) {
+        Height to { std::min(from.value() + uint32_t(blocksPerStage), length.value() + 1) };
+        return std::async(std::launch::async, load_range, std::cref(src), std::cref(headers), from, to);
+    };
+    std::future<std::vector<Block>> next;
+    if (length.value() > 0)
+        next = load(Height(1));
+    while (next.valid()) {
+        auto blocks { next.get() };
+        const Height after { blocks.back().height + 1 };
+        if (after <= length)
+            next = load(after);
+        auto [res, update] { state.add_stage(blocks, headers, true) };
+        if (res.ce.is_error())
+            throw std::runtime_error("Block " + std::to_string(res.ce.height().value()) + " rejected: " + res.ce.err_name());
+        while (state.garbage_collect(true)) { }
+        if (after.value() / 10000 != blocks.front().height.value() / 10000)
+            spdlog::info("Reindexed {} of {} blocks", after.value() - 1, length.value());
+    }
+    db.set_profile(SQLiteProfile::Balanced);
+    db.set_lookup_indices(true);
+    const double s { duration<double>(steady_clock::now() - begin).count() };
+    spdlog::info("Reindexed {} blocks in {:.1f} s ({:.0f} blocks/s)", length.value(), s, length.value() / s);
+    return 0;
+}
+
+int usage()
+{
+    std::cerr << "usage: wart-replay dump <chaindb> <dumpfile> [maxHeight]\n"
+                 "       wart-replay replay <dumpfile> <newchaindb> [blocksPerStage]\n"
+                 "       wart-replay reindex <chaindb> <newchaindb> [blocksPerStage]\n";
+    return 1;
+}
+}
+
+int main(int argc, char** argv)
+{
+    ECC ecc;
+    if (argc < 4)
+        return usage();
+    const std::string mode { argv[1] };
+    try {
+        if (mode == "dump")
+            return dump(argv[2], argv[3], argc > 4 ? std::stoul(argv[4]) : 0);
+        if (mode == "replay")
+            return replay(argv[2], argv[3], argc > 4 ? std::stoul(argv[4]) : 100);
+        if (mode == "reindex")
+            return reindex(argv[2], argv[3], argc > 4 ? std::stoul(argv[4]) : 1000);
+    } catch (std::exception& e) {
+        spdlog::error("{}", e.what());
+        return 1;
+    } catch (Error& e) {
+        spdlog::error("{}", e.strerror());
+        return 1;
+    }
+    return usage();
+}
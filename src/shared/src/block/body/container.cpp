@@ -10,6 +10,7 @@ BodyContainer::BodyContainer(std::span<const uint8_t> s)
     if (s.size() > MAXBLOCKSIZE) {
         throw Error(EBLOCKSIZE);
     }
+    bytes.assign(s.begin(), s.end());
 }
 
 BodyView BodyContainer::view() const
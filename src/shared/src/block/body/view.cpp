@@ -3,6 +3,7 @@
 #include "crypto/hasher_sha256.hpp"
 #include "general/hex.hpp"
 #include "general/reader.hpp"
+#include <algorithm>
 #include <iostream>
 #include <vector>
 using namespace std;
@@ -40,22 +41,94 @@ BodyView::BodyView(std::span<const uint8_t> s)
     isValid = true;
 };
 
-Hash BodyView::merkleRoot(Height h) const
+namespace {
+// hashes pairs of consecutive nodes of one level (multi-buffer),
+// a trailing unpaired node is hashed alone
+void hash_level(const std::vector<Hash>& from, std::vector<Hash>& to)
+{
+    static_assert(sizeof(Hash) == 32);
+    to.resize((from.size() + 1) / 2);
+    const size_t pairs { from.size() / 2 };
+    hashSHA256_batch(from.front().data(), 64, 64, pairs, to.data());
+    if (pairs < to.size())
+        to.back() = hashSHA256(from.back().data(), 32);
+}
+}
+
+std::vector<Hash> BodyView::leaf_hashes() const
 {
-    assert(isValid);
     std::vector<Hash> hashes(nAddresses + nRewards + nTransfers);
 
-    // hash addresses
-    size_t idx = 0;
-    for (size_t i = 0; i < nAddresses; ++i)
-        hashes[idx++] = hashSHA256(s.data() + offsetAddresses + i * AddressSize, AddressSize);
+    // hash addresses, payouts and payments (multi-buffer)
+    Hash* out = hashes.data();
+    hashSHA256_batch(data() + offsetAddresses, AddressSize, AddressSize, nAddresses, out);
+    out += nAddresses;
+    hashSHA256_batch(data() + offsetRewards, RewardSize, RewardSize, nRewards, out);
+    out += nRewards;
+    hashSHA256_batch(data() + offsetTransfers, TransferSize, TransferSize, nTransfers, out);
+    return hashes;
+}
+
+std::span<const uint8_t> BodyView::leaf_data(size_t leaf) const
+{
+    assert(isValid);
+    if (leaf < nAddresses)
+        return s.subspan(offsetAddresses + leaf * AddressSize, AddressSize);
+    leaf -= nAddresses;
+    if (leaf < nRewards)
+        return s.subspan(offsetRewards + leaf * RewardSize, RewardSize);
+    leaf -= nRewards;
+    assert(leaf < nTransfers);
+    return s.subspan(offsetTransfers + leaf * TransferSize, TransferSize);
+}
+
+MerkleBranch BodyView::merkle_branch(Height h, size_t leaf) const
+{
+    assert(isValid);
+    auto level { leaf_hashes() };
+    assert(leaf < level.size());
+    MerkleBranch res { .steps {}, .seed {}, .legacy = h.value() < NEWMERKLEROOT };
+    std::copy_n(data(), res.seed.size(), res.seed.begin());
+
+    // both root types hash pairwise until at most two nodes are left
+    std::vector<Hash> next;
+    while (true) {
+        const size_t sibling { leaf ^ 1 };
+        auto& step { res.steps.emplace_back(MerkleBranch::Step { .sibling {}, .siblingLeft = sibling < leaf }) };
+        if (sibling < level.size())
+            step.sibling = level[sibling];
+        if (level.size() <= 2)
+            return res;
+        hash_level(level, next);
+        std::swap(level, next);
+        leaf /= 2;
+    }
+}
+
+Hash MerkleBranch::root(const Hash& leaf) const
+{
+    Hash h { leaf };
+    for (size_t i = 0; i < steps.size(); ++i) {
+        auto& s { steps[i] };
+        HasherSHA256 hasher {};
+        if (s.sibling && s.siblingLeft)
+            hasher.write(s.sibling->data(), 32);
+        hasher.write(h.data(), 32);
+        if (s.sibling && !s.siblingLeft)
+            hasher.write(s.sibling->data(), 32);
+        if (i + 1 == steps.size())
+            hasher.write(seed.data(), seed.size());
+        h = std::move(hasher);
+    }
+    if (legacy)
+        h = hashSHA256(h.data(), 32);
+    return h;
+}
 
-    // hash payouts
-    for (size_t i = 0; i < nRewards; ++i)
-        hashes[idx++] = hashSHA256(data() + offsetRewards + i * RewardSize, RewardSize);
-    // hash payments
-    for (size_t i = 0; i < nTransfers; ++i)
-        hashes[idx++] = hashSHA256(data() + offsetTransfers + i * TransferSize, TransferSize);
+Hash BodyView::merkleRoot(Height h) const
+{
+    assert(isValid);
+    std::vector<Hash> hashes { leaf_hashes() };
     std::vector<Hash> tmp, *from, *to;
     from = &hashes;
     to = &tmp;
@@ -63,19 +136,17 @@ Hash BodyView::merkleRoot(Height h) const
     bool new_root_type = h.value() >= NEWMERKLEROOT;
     if (new_root_type) {
         do {
-            to->resize((from->size() + 1) / 2);
-            size_t j = 0;
-            for (size_t i = 0; i < (from->size() + 1) / 2; ++i) {
+            if (from->size() > 2) {
+                hash_level(*from, *to);
+            } else {
+                to->resize(1);
                 HasherSHA256 hasher {};
-                hasher.write((*from)[j].data(), 32);
-                if (j + 1 < from->size()) {
-                    hasher.write((*from)[j + 1].data(), 32);
+                hasher.write((*from)[0].data(), 32);
+                if (1 < from->size()) {
+                    hasher.write((*from)[1].data(), 32);
                 }
-
-                if (to->size() == 1)
-                    hasher.write(data(), 4); // first 4 bytes in block are for extranonce I think?
-                (*to)[i] = std::move(hasher);
-                j += 2;
+                hasher.write(data(), 4); // first 4 bytes in block are for extranonce I think?
+                (*to)[0] = std::move(hasher);
             }
             std::swap(from, to);
         } while (from->size() > 1);
@@ -98,16 +169,7 @@ Hash BodyView::merkleRoot(Height h) const
             } else {
                 if (from->size() == 1)
                     finish = true;
-                size_t j = 0;
-                for (size_t i = 0; i < (from->size() + 1) / 2; ++i) {
-                    HasherSHA256 hasher {};
-                    hasher.write((*from)[j].data(), 32);
-                    if (j + 1 < from->size()) {
-                        hasher.write((*from)[j + 1].data(), 32);
-                    }
-                    (*to)[i] = std::move(hasher);
-                    j += 2;
-                }
+                hash_level(*from, *to);
             }
             std::swap(from, to);
         } while (!finish);
@@ -2,12 +2,30 @@
 
 #include "crypto/hash.hpp"
 #include "block/chain/height.hpp"
+#include <array>
+#include <optional>
 #include <span>
+#include <vector>
 
 struct TransferView;
 struct RewardView;
 class AddressView;
 
+// Path from a leaf to the merkle root of a block body. Levels are hashed
+// pairwise and an unpaired last node is hashed alone. The top level of at
+// most two nodes is hashed together with the first 4 body bytes (seed),
+// legacy roots hash that result once more.
+struct MerkleBranch {
+    struct Step {
+        std::optional<Hash> sibling; // empty if the node is hashed alone
+        bool siblingLeft;
+    };
+    std::vector<Step> steps; // from the leaf level up to the top level
+    std::array<uint8_t, 4> seed;
+    bool legacy;
+    Hash root(const Hash& leaf) const;
+};
+
 class BodyView {
     struct Rewards {
         Rewards(const BodyView& bv)
@@ -131,6 +149,12 @@ public:
     constexpr static size_t TransferSize { 34 + SIGLEN };
     BodyView(std::span<const uint8_t>);
     Hash merkleRoot(Height h) const;
+    // leaves are the addresses, then the rewards, then the transfers, such
+    // that the history entries of the block are consecutive leaves
+    size_t leaf_count() const { return nAddresses + nRewards + nTransfers; }
+    size_t leaf_offset_history() const { return nAddresses; }
+    MerkleBranch merkle_branch(Height h, size_t leaf) const;
+    std::span<const uint8_t> leaf_data(size_t leaf) const;
     bool valid() const { return isValid; }
     size_t size() const { return s.size(); }
     const uint8_t* data() const { return s.data(); }
@@ -146,6 +170,7 @@ public:
 private:
     size_t getNTransfers() const { return nTransfers; };
     uint16_t getNRewards() const { return nRewards; };
+    std::vector<Hash> leaf_hashes() const;
 
 private:
     std::span<const uint8_t> s;
@@ -10,21 +10,34 @@ class Worksum {
 private:
     static constexpr size_t BITS = 256;
     static constexpr size_t ELEMENTS = BITS / (8 * 4 /*CHAR_BIT*sizeof(uint32_t)*/);
+    static constexpr size_t LIMBS = BITS / 64;
 
 public:
     using fragments_type = std::array<uint32_t, ELEMENTS>;
 
 private:
-    fragments_type fragments;
+    // little endian 64-bit limbs, such that additions carry through 4 words
+    std::array<uint64_t, LIMBS> limbs;
+    uint32_t fragment(size_t i) const { return uint32_t(limbs[i / 2] >> (32 * (i % 2))); }
+    void set_fragment(size_t i, uint32_t f)
+    {
+        const size_t shift { 32 * (i % 2) };
+        limbs[i / 2] = (limbs[i / 2] & ~(uint64_t(0xfffffffful) << shift)) | (uint64_t(f) << shift);
+    }
 
 public:
-    const std::array<uint32_t, BITS / (8 * 4 /*CHAR_BIT*sizeof(uint32_t)*/)> getFragments() const { return fragments; }
+    const fragments_type getFragments() const
+    {
+        fragments_type res;
+        for (size_t i = 0; i < res.size(); ++i)
+            res[i] = fragment(i);
+        return res;
+    }
     static size_t bytesize() { return sizeof(uint32_t) * ELEMENTS; };
     static Worksum max()
     {
         Worksum ws;
-        for (auto& f : ws.fragments)
-            f = std::numeric_limits<uint32_t>::max();
+        ws.limbs.fill(std::numeric_limits<uint64_t>::max());
         return ws;
     }
     bool operator==(const Worksum& w) const = default;
@@ -32,26 +45,17 @@ public:
     Worksum& operator-=(const Worksum& w);
     Worksum& operator*=(uint32_t factor);
     Worksum& operator+=(const Worksum& w);
-//     Worksum& operator+=(const Target& t);
-// Worksum& Worksum::operator+=(const Target& t)
-// {
-//     return this->operator+=(Worksum(t));
-// }
     friend Worksum operator+(Worksum w1, const Worksum& w2)
     {
         return w1 += w2;
     }
-    // friend Worksum operator+(Worksum w, const TargetV1& t)
-    // {
-    //     return w += t;
-    // }
     inline bool operator<(const Worksum& rhs) const
     {
-        size_t j = fragments.size();
+        size_t j = limbs.size();
         while (j != 0) {
             j -= 1;
-            if (fragments[j] != rhs.fragments[j])
-                return (fragments[j] < rhs.fragments[j]);
+            if (limbs[j] != rhs.limbs[j])
+                return (limbs[j] < rhs.limbs[j]);
         }
         return false;
     }
@@ -65,37 +69,36 @@ public:
     }
     inline bool operator>=(const Worksum& rhs) const
     {
-        return operator>(rhs) || operator==(rhs);
+        return !operator<(rhs);
     }
-    inline bool is_zero()
+    inline bool is_zero() const
     {
         return *this == Worksum();
     }
     inline void setzero()
     {
-        for (auto& f : fragments) {
-            f = 0;
-        }
+        limbs.fill(0);
     }
 
     double getdouble() const
     {
         double factor = 1.0;
-        double sum = double(fragments[0]);
-        for (size_t i = 1; i < fragments.size(); ++i) {
+        double sum = double(fragment(0));
+        for (size_t i = 1; i < ELEMENTS; ++i) {
             factor *= 4294967296.0;
-            sum += factor * double(fragments[i]);
+            sum += factor * double(fragment(i));
         }
         return sum;
     }
     std::array<uint8_t, BITS / 8> to_bytes() const;
     Worksum()
     {
-        fragments.fill(0ul);
+        limbs.fill(0);
     }
     Worksum(fragments_type fragments)
-        : fragments(fragments)
     {
+        for (size_t i = 0; i < limbs.size(); ++i)
+            limbs[i] = uint64_t(fragments[2 * i]) | (uint64_t(fragments[2 * i + 1]) << 32);
     }
     Worksum(std::array<uint8_t, 32> data);
     Worksum(const TargetV1& t);
@@ -0,0 +1,243 @@
+#pragma once
+#include "custom_float.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+
+// A fixed number of CustomFloat values in structure of arrays layout. The
+// operations reproduce the scalar CustomFloat arithmetic bit by bit, also
+// the exponent and sign left in zero results, but evaluate every lane with
+// selects instead of branches such that the compiler vectorizes the lane
+// loops. Scalar preconditions are not asserted per lane, lanes violating
+// them produce unspecified values instead of undefined behavior.
+class CustomFloatBatch {
+public:
+    static constexpr size_t lanes { 8 };
+    using Mask = std::array<uint32_t, lanes>; // 1 for true
+
+    CustomFloatBatch() = default;
+    // broadcast
+    CustomFloatBatch(CustomFloat f)
+    {
+        m.fill(f.mantissa());
+        e.fill(f.exponent());
+        p.fill(f.positive());
+    }
+    // values[i] in lane i
+    explicit CustomFloatBatch(const CustomFloat* values)
+    {
+        for (size_t i = 0; i < lanes; ++i)
+            set(i, lane(values[i]));
+    }
+    // equals CustomFloat(hashes[i]) in lane i, lanes beyond n repeat the last hash
+    CustomFloatBatch(const Hash* hashes, size_t n)
+    {
+        assert(n > 0 && n <= lanes);
+        for (size_t i = 0; i < lanes; ++i) {
+            const auto l { from_hash(hashes[std::min(i, n - 1)]) };
+            m[i] = l.m;
+            e[i] = l.e;
+            p[i] = l.p;
+        }
+    }
+    CustomFloat operator[](size_t i) const { return { e[i], m[i], p[i] != 0 }; }
+
+    friend CustomFloatBatch operator+(const CustomFloatBatch& a, const CustomFloatBatch& b)
+    {
+        return zip(a, b, add);
+    }
+    friend CustomFloatBatch operator-(const CustomFloatBatch& a, const CustomFloatBatch& b)
+    {
+        return zip(a, b, [](Lane x, Lane y) { return add(x, { y.m, y.e, !y.p }); });
+    }
+    friend CustomFloatBatch operator*(const CustomFloatBatch& a, const CustomFloatBatch& b)
+    {
+        return zip(a, b, mul);
+    }
+    friend CustomFloatBatch log2(const CustomFloatBatch& x)
+    {
+        return map(x, lane_log2);
+    }
+    friend CustomFloatBatch pow2(const CustomFloatBatch& x)
+    {
+        return map(x, lane_pow2);
+    }
+    friend CustomFloatBatch pow(const CustomFloatBatch& base, CustomFloat exponent)
+    {
+        return pow2(CustomFloatBatch(exponent) * log2(base));
+    }
+
+    // per lane x < bound like operator<(CustomFloat, CustomFloat)
+    Mask operator<(CustomFloat bound) const
+    {
+        return below(-bound.exponent(), bound.mantissa());
+    }
+    // per lane comparison of -exponent with zeros, then of the mantissa as
+    // in the comparisons against CustomFloat bounds and targets
+    Mask below(uint32_t zeros, uint64_t mantissa) const
+    {
+        Mask r;
+        for (size_t i = 0; i < lanes; ++i) {
+            const uint32_t z(-e[i]);
+            r[i] = (z > zeros) | ((z == zeros) & (m[i] < mantissa));
+        }
+        return r;
+    }
+    // lanes of a where mask is set, else lanes of b
+    friend CustomFloatBatch select(const Mask& mask, const CustomFloatBatch& a, const CustomFloatBatch& b)
+    {
+        CustomFloatBatch r;
+        for (size_t i = 0; i < lanes; ++i) {
+            r.m[i] = mask[i] ? a.m[i] : b.m[i];
+            r.e[i] = mask[i] ? a.e[i] : b.e[i];
+            r.p[i] = mask[i] ? a.p[i] : b.p[i];
+        }
+        return r;
+    }
+
+private:
+    struct Lane {
+        uint32_t m;
+        int32_t e;
+        uint32_t p;
+    };
+    static CustomFloatBatch map(const CustomFloatBatch& a, auto f)
+    {
+        CustomFloatBatch r;
+        for (size_t i = 0; i < lanes; ++i)
+            r.set(i, f(a.get(i)));
+        return r;
+    }
+    static CustomFloatBatch zip(const CustomFloatBatch& a, const CustomFloatBatch& b, auto f)
+    {
+        CustomFloatBatch r;
+        for (size_t i = 0; i < lanes; ++i)
+            r.set(i, f(a.get(i), b.get(i)));
+        return r;
+    }
+    Lane get(size_t i) const { return { m[i], e[i], p[i] }; }
+    void set(size_t i, Lane l)
+    {
+        m[i] = l.m;
+        e[i] = l.e;
+        p[i] = l.p;
+    }
+    static Lane lane(CustomFloat f) { return { f.mantissa(), f.exponent(), f.positive() }; }
+
+    static Lane from_hash(const Hash& h)
+    {
+        size_t i { 0 };
+        while (i < h.size() && h[i] == 0)
+            i += 1;
+        uint32_t bits { 0 };
+        for (size_t j = 0; j < 4; ++j, ++i)
+            bits = (bits << 8) | (i < h.size() ? h[i] : 0xFFu); // "infinite amount of trailing 1's"
+        const int32_t zeros(8 * (i - 4));
+        return normalize(-zeros, bits, 1);
+    }
+    // shift_left of a nonzero mantissa
+    static Lane normalize(int32_t e, uint32_t m, uint32_t p)
+    {
+        const int s { std::countl_zero(m) };
+        return { uint32_t(uint64_t(m) << s), e - s, p };
+    }
+    static Lane select(bool c, Lane a, Lane b)
+    {
+        return { c ? a.m : b.m, c ? a.e : b.e, c ? a.p : b.p };
+    }
+    // CustomFloat::operator+=
+    static Lane add(Lane a, Lane b)
+    {
+        const bool swap { a.e < b.e };
+        const Lane x { select(swap, b, a) }; // larger exponent
+        const Lane y { select(swap, a, b) };
+        const auto d { std::min(int64_t(x.e) - int64_t(y.e), int64_t(63)) };
+        const uint64_t tmp { x.m };
+        const uint64_t operand { uint64_t(y.m) >> d };
+
+        // same signs
+        const uint64_t sum { tmp + operand };
+        const uint32_t carry(sum >> 32);
+        const Lane same { uint32_t(sum >> carry), x.e + int32_t(carry), x.p };
+
+        // different signs, operand > tmp only at equal exponents
+        const bool flip { operand > tmp };
+        const uint32_t diff(flip ? operand - tmp : tmp - operand);
+        const Lane different { select(diff == 0,
+            Lane { 0, x.e, x.p },
+            normalize(x.e, diff | (diff == 0), flip ? y.p : x.p)) };
+
+        const Lane r { select(x.p == y.p, same, different) };
+        return select(a.m == 0, b, select(b.m == 0, a, r));
+    }
+    // CustomFloat::operator*=
+    static Lane mul(Lane a, Lane b)
+    {
+        const bool zero { a.m == 0 || b.m == 0 };
+        uint64_t tmp { uint64_t(a.m) * uint64_t(b.m) };
+        const uint32_t low(tmp < (uint64_t(1) << 63));
+        tmp <<= low;
+        const Lane r { uint32_t(tmp >> 32), int32_t(int64_t(a.e) + int64_t(b.e) - low), a.p == b.p };
+        return select(zero, Lane { 0, a.e, a.p }, r);
+    }
+    // CustomFloat::from_int
+    static Lane from_int(int32_t i)
+    {
+        const uint32_t u(i < 0 ? -int64_t(i) : i);
+        return select(i == 0, Lane { 0, 0, 1 }, normalize(32, u | (u == 0), i >= 0));
+    }
+    // log2(CustomFloat)
+    static Lane lane_log2(Lane x)
+    {
+        const Lane c0 { lane(CustomFloat(1, 2872373668ull)) };
+        const Lane c1 { lane(CustomFloat(3, 2377545675ull, false)) };
+        const Lane c2 { lane(CustomFloat(3, 3384280813ull)) };
+        const Lane c3 { lane(CustomFloat(2, 3451338727ull, false)) };
+        const int32_t e { x.e };
+        x.e = 0;
+        const Lane d { add(c3, mul(x, add(c2, mul(x, add(c1, mul(x, c0)))))) };
+        return add(from_int(e), d);
+    }
+    // CustomFloat::pow2_fraction
+    static Lane pow2_fraction(Lane f)
+    {
+        const Lane c0 { lane(CustomFloat(-3, 3207796260ull)) };
+        const Lane c1 { lane(CustomFloat(-2, 3510493713ull)) };
+        const Lane c2 { lane(CustomFloat(0, 3014961390ull)) };
+        const Lane c3 { lane(CustomFloat(1, 2147933481ull)) };
+        return add(c3, mul(f, add(c2, mul(f, add(c1, mul(f, c0))))));
+    }
+    // pow2(CustomFloat), all branches share one pow2_fraction evaluation
+    static Lane lane_pow2(Lane x)
+    {
+        constexpr Lane one { 0x80000000u, 1, 1 };
+        const bool positive { x.p != 0 };
+
+        // e_x > 0: integer part n and fraction
+        const bool integer { x.e > 0 };
+        const int32_t ex { std::clamp(x.e, 1, 31) };
+        const int64_t n(x.m >> (32 - ex));
+        const uint32_t mfrac { x.m << ex };
+        const Lane frac { normalize(0, mfrac | (mfrac == 0), 1) };
+
+        // e_x <= 0: x is the fraction
+        const Lane arg { integer
+                ? (positive ? frac : add(one, { frac.m, frac.e, 0 }))
+                : (positive ? x : add(one, x)) };
+        Lane r { pow2_fraction(arg) };
+        const int64_t e { integer
+                ? (positive ? r.e + n : -(r.e + n - 1))
+                : (positive ? r.e : -int64_t(r.e) + 1) };
+        r.e = e;
+
+        // e_x > 0 without fraction
+        const Lane exact { 0x80000000u, int32_t(positive ? n + 1 : 1 - n), 1 };
+        r = select(integer && mfrac == 0, exact, r);
+        return select(x.m == 0, one, r);
+    }
+
+    std::array<uint32_t, lanes> m;
+    std::array<int32_t, lanes> e;
+    std::array<uint32_t, lanes> p; // 1 if positive
+};
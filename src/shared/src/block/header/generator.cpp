@@ -12,6 +12,18 @@ HeaderGenerator::HeaderGenerator(std::array<uint8_t, 32> prevhash,
     , nonce(0u) {
 
     };
+HeaderGenerator::HeaderGenerator(std::array<uint8_t, 32> prevhash,
+    const std::array<uint8_t, 32>& merkleroot, Target target,
+    uint32_t timestamp)
+    : version(target.is_janushash() ? 2 : 1)
+    , prevhash(prevhash)
+    , merkleroot(merkleroot)
+    , timestamp(timestamp)
+    , target(target)
+    , nonce(0u)
+{
+}
+
 [[nodiscard]] Header HeaderGenerator::serialize(uint32_t nonce) const
 {
     Header out;
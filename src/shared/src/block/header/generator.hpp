@@ -11,6 +11,9 @@ public:
     HeaderGenerator(std::array<uint8_t, 32> prevhash, const BodyView& bv,
         Target target,
         uint32_t timestamp, Height height);
+    // merkle root computed by the caller
+    HeaderGenerator(std::array<uint8_t, 32> prevhash, const std::array<uint8_t, 32>& merkleroot,
+        Target target, uint32_t timestamp);
     // member elements
     int32_t version = 1; // 4 bytes
     std::array<uint8_t, 32> prevhash; // 32 bytes
@@ -0,0 +1,58 @@
+#include "midstate.hpp"
+#include "block/chain/height.hpp"
+#include "header_impl.hpp"
+
+HeaderMidstate::HeaderMidstate(const Header& h)
+    : header(h)
+    , sha(h.data(), prefixSize)
+{
+    verus.write(h.data(), prefixSize);
+}
+
+auto HeaderMidstate::tail(uint32_t nonce) const -> std::array<uint8_t, HeaderView::bytesize - prefixSize>
+{
+    std::array<uint8_t, HeaderView::bytesize - prefixSize> t;
+    memcpy(t.data(), header.data() + prefixSize, t.size());
+    memcpy(t.data() + (HeaderView::offset_nonce - prefixSize), &nonce, 4);
+    return t;
+}
+
+Hash HeaderMidstate::hash(uint32_t nonce) const
+{
+    auto t { tail(nonce) };
+    auto h { sha.hash(t.data(), t.size()) };
+    return hashSHA256(h.data(), h.size());
+}
+
+Hash HeaderMidstate::verus_hash(uint32_t nonce) const
+{
+    auto t { tail(nonce) };
+    return Verus::VerusHasher(verus).write(t.data(), t.size()).finalize();
+}
+
+bool HeaderMidstate::validPOW(uint32_t nonce, NonzeroHeight height) const
+{
+    Header h { header };
+    h.set_nonce(nonce);
+    if (HeaderView::uses_verushash(height))
+        return HeaderView(h).validPOW(hash(nonce), height, verus_hash(nonce));
+    return HeaderView(h).validPOW(hash(nonce), height);
+}
+
+void HeaderMidstate::validPOW_batch(std::span<const uint32_t> nonces, NonzeroHeight height, uint8_t* out) const
+{
+    if (!HeaderView::uses_verushash(height)) {
+        for (size_t i = 0; i < nonces.size(); ++i)
+            out[i] = validPOW(nonces[i], height);
+        return;
+    }
+    std::vector<Hash> hashes, verusHashes;
+    hashes.reserve(nonces.size());
+    verusHashes.reserve(nonces.size());
+    for (auto n : nonces) {
+        hashes.push_back(hash(n));
+        verusHashes.push_back(verus_hash(n));
+    }
+    const auto target { TargetV2::from_raw(header.data() + HeaderView::offset_target) };
+    HeaderView::validPOW_batch(hashes.data(), verusHashes.data(), nonces.size(), height, target, out);
+}
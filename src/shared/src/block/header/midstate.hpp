@@ -0,0 +1,33 @@
+#pragma once
+#include "crypto/hasher_sha256.hpp"
+#include "crypto/verushash/verushash.hpp"
+#include "header.hpp"
+#include <span>
+
+class NonzeroHeight;
+
+// Hash state of the nonce independent header prefix for mining loops. The
+// first 64 byte SHA256 block and the first two haraka512 rounds of the
+// verushash are processed once per job, hashing a nonce then only
+// processes the last 16 header bytes. Nonces are passed as for
+// Header::set_nonce.
+class HeaderMidstate {
+public:
+    explicit HeaderMidstate(const Header& h);
+
+    // equals Header::hash() with the nonce set
+    Hash hash(uint32_t nonce) const;
+    Hash verus_hash(uint32_t nonce) const;
+    bool validPOW(uint32_t nonce, NonzeroHeight height) const;
+    // out[i] = validPOW(nonces[i], height), Janushash checks run batched
+    void validPOW_batch(std::span<const uint32_t> nonces, NonzeroHeight height, uint8_t* out) const;
+    // sha256 midstate, the GPU kernel continues from it
+    const SHA256Midstate& sha256() const { return sha; }
+
+private:
+    static constexpr size_t prefixSize { 64 };
+    std::array<uint8_t, HeaderView::bytesize - prefixSize> tail(uint32_t nonce) const;
+    Header header;
+    SHA256Midstate sha;
+    Verus::VerusHasher verus;
+};
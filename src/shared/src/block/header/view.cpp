@@ -4,8 +4,10 @@
 #include "crypto/hasher_sha256.hpp"
 #include "crypto/verushash/verushash.hpp"
 #include "custom_float.hpp"
+#include "custom_float_batch.hpp"
 #include "difficulty.hpp"
 #include "general/params.hpp"
+#include <algorithm>
 #include <iostream>
 
 inline bool operator<(const CustomFloat& hashproduct, TargetV2 t)
@@ -42,78 +44,166 @@ inline bool operator<(const CustomFloat& hashproduct, TargetV2 t)
     return "0b_" + s;
 }
 
+bool HeaderView::uses_verushash(NonzeroHeight height)
+{
+    return JANUSENABLED && height.value() > JANUSRETARGETSTART;
+}
+
 bool HeaderView::validPOW(const Hash& h, NonzeroHeight height) const
 {
-    if (JANUSENABLED && height.value() > JANUSRETARGETSTART) {
-        if (height.value() > JANUSV2RETARGETSTART) {
-            auto verusHashV2_1 { verus_hash({ data(), size() }) };
-            auto verusFloat { CustomFloat(verusHashV2_1) };
-            auto sha256tFloat { CustomFloat(hashSHA256(h)) };
-            if (height.value() > JANUSV4RETARGETSTART) {
-
-                if (height.value() > JANUSV6RETARGETSTART) { 
-                    constexpr auto c = CustomFloat(-7, 2748779069); // 0.005
-                    if (sha256tFloat < c) {
-                        // we will adjust that if better miner is available
-                        sha256tFloat = c;
-                    }
-                }
+    if (uses_verushash(height))
+        return validPOW(h, height, verus_hash({ data(), size() }));
+    return target_v1().compatible(h);
+}
 
-                if (height.value() > JANUSV5RETARGETSTART) { 
-                    // temporary fix against unfair mining
-                    // better GPU hashrate will also give more candidatess that pass through this threshold
-                    // for verushash computation.
-                    constexpr auto c = CustomFloat(-9, 3306097748); // CustomFloat::from_double(0.0015034391929775724)
-                    if (sha256tFloat < c)
-                        return false;
-                }
+bool HeaderView::validPOW(const Hash& h, NonzeroHeight height, const Hash& verusHashV2_1) const
+{
+    return validPOW(h, height, verusHashV2_1, target_v2());
+}
 
+bool HeaderView::validPOW(const Hash& h, NonzeroHeight height, const Hash& verusHashV2_1, TargetV2 target) const
+{
+    assert(uses_verushash(height));
+    if (height.value() > JANUSV2RETARGETSTART) {
+        auto verusFloat { CustomFloat(verusHashV2_1) };
+        auto sha256tFloat { CustomFloat(hashSHA256(h)) };
+        if (height.value() > JANUSV4RETARGETSTART) {
 
-                if (!(verusHashV2_1 < CustomFloat(-33, 3785965345))) {
-                    // reject verushash with log_e less than -23
-                    return false;
+            if (height.value() > JANUSV6RETARGETSTART) { 
+                constexpr auto c = CustomFloat(-7, 2748779069); // 0.005
+                if (sha256tFloat < c) {
+                    // we will adjust that if better miner is available
+                    sha256tFloat = c;
                 }
+            }
 
-            } else if (height.value() > JANUSV3RETARGETSTART) {
-                if (!(verusHashV2_1 < CustomFloat(-30, 3496838790))) {
-                    // reject verushash with log_e less than -21
+            if (height.value() > JANUSV5RETARGETSTART) { 
+                // temporary fix against unfair mining
+                // better GPU hashrate will also give more candidatess that pass through this threshold
+                // for verushash computation.
+                constexpr auto c = CustomFloat(-9, 3306097748); // CustomFloat::from_double(0.0015034391929775724)
+                if (sha256tFloat < c)
                     return false;
-                }
             }
-            using namespace std;
-            // cout << to_bin(verusHashV2_1) << endl;
-            // now introduce        _  ___  _Hacker: "shi*t" <-- At difficulty 2^40 which is minimum SHA256t
-            // factor to cripple     \|o o|/                     must have 40/0.7 ~ 57 zeros to generate
-            // GPU-only mining         \0/                       a valid block alone (2000x of 46 now)
-            constexpr auto factor { CustomFloat(0, 3006477107) }; // = 0.7 <-- this can be decreased if necessary
-            // constexpr auto factor { CustomFloat(0, 3435973836) }; // = 0.8, lift to this later when we have better miner
-            auto hashProduct { verusFloat * pow(sha256tFloat, factor) };
-            return verusHashV2_1[0] == 0 && (hashProduct < target_v2());
 
+
+            if (!(verusHashV2_1 < CustomFloat(-33, 3785965345))) {
+                // reject verushash with log_e less than -23
+                return false;
+            }
+
+        } else if (height.value() > JANUSV3RETARGETSTART) {
+            if (!(verusHashV2_1 < CustomFloat(-30, 3496838790))) {
+                // reject verushash with log_e less than -21
+                return false;
+            }
+        }
+        using namespace std;
+        // cout << to_bin(verusHashV2_1) << endl;
+        // now introduce        _  ___  _Hacker: "shi*t" <-- At difficulty 2^40 which is minimum SHA256t
+        // factor to cripple     \|o o|/                     must have 40/0.7 ~ 57 zeros to generate
+        // GPU-only mining         \0/                       a valid block alone (2000x of 46 now)
+        constexpr auto factor { CustomFloat(0, 3006477107) }; // = 0.7 <-- this can be decreased if necessary
+        // constexpr auto factor { CustomFloat(0, 3435973836) }; // = 0.8, lift to this later when we have better miner
+        auto hashProduct { verusFloat * pow(sha256tFloat, factor) };
+        return verusHashV2_1[0] == 0 && (hashProduct < target);
+
+    } else { // Old Janushash
+        // HashExponentialDigest hd; // prepare hash product of  Proof of Balanced work with two algos: verus + 3xsha256
+        // auto verusHashV2_1 { verus_hash({ data(), size() }) };
+        // hd.digest(verusHashV2_1);
+        // auto triplesha { hashSHA256(h) };
+        // hd.digest(triplesha);
+        // return verusHashV2_1[0] == 0 && target_v2().compatible(hd);
+
+        auto verusFloat { CustomFloat(verusHashV2_1) };
+        using namespace std;
+        // cout << to_bin(verusHashV2_1) << endl;
+        auto sha256tFloat { CustomFloat(hashSHA256(h)) };
+        auto hashProduct { verusFloat * sha256tFloat };
+        if (height.value() > JANUSV5RETARGETSTART) {
+            // honest miners will be with 90% in a band around threshold, too good hashes are unlikely. 
+            // Here we reject best 10% of too good hashes, 90% of normally mined blocks will pass through. 
+            // This is to avoid unfair mining.
+            if (hashProduct * CustomFloat(4, 2684354560) < target)
+                return false;
+        }
+        return verusHashV2_1[0] == 0 && (hashProduct < target);
+    }
+}
+
+namespace {
+// index of the PoW rule set, the retarget starts are increasing
+uint32_t pow_rules(NonzeroHeight height)
+{
+    const auto h { height.value() };
+    return HeaderView::uses_verushash(height)
+        + (h > JANUSV2RETARGETSTART) + (h > JANUSV3RETARGETSTART)
+        + (h > JANUSV4RETARGETSTART) + (h > JANUSV5RETARGETSTART)
+        + (h > JANUSV6RETARGETSTART);
+}
+}
+
+bool HeaderView::same_pow_rules(NonzeroHeight h1, NonzeroHeight h2)
+{
+    return pow_rules(h1) == pow_rules(h2);
+}
+
+void HeaderView::validPOW_batch(const Hash* hashes, const Hash* verusHashes, size_t n, NonzeroHeight height, TargetV2 target, uint8_t* out)
+{
+    // mirrors validPOW(h, height, verusHash, target) lane by lane
+    assert(uses_verushash(height));
+    constexpr size_t L { CustomFloatBatch::lanes };
+    using Mask = CustomFloatBatch::Mask;
+    const auto h { height.value() };
+    const uint32_t zerosTarget { target.zeros10() };
+    const uint64_t bits32 { uint64_t(target.bits22()) << 10 };
+    for (size_t begin = 0; begin < n; begin += L) {
+        const size_t m { std::min(L, n - begin) };
+        Hash sha256t[L];
+        hashSHA256_batch(hashes[begin].data(), 32, sizeof(Hash), m, sha256t);
+        const CustomFloatBatch verusFloat(verusHashes + begin, m);
+        CustomFloatBatch sha256tFloat(sha256t, m);
+
+        Mask valid;
+        for (size_t i = 0; i < L; ++i)
+            valid[i] = verusHashes[begin + std::min(i, m - 1)][0] == 0;
+        auto require { [&](const Mask& r) {
+            for (size_t i = 0; i < L; ++i)
+                valid[i] &= r[i];
+        } };
+        auto reject { [&](const Mask& r) {
+            for (size_t i = 0; i < L; ++i)
+                valid[i] &= !r[i];
+        } };
+
+        if (h > JANUSV2RETARGETSTART) {
+            if (h > JANUSV4RETARGETSTART) {
+                if (h > JANUSV6RETARGETSTART) {
+                    constexpr auto c = CustomFloat(-7, 2748779069); // 0.005
+                    sha256tFloat = select(sha256tFloat < c, c, sha256tFloat);
+                }
+                if (h > JANUSV5RETARGETSTART)
+                    reject(sha256tFloat < CustomFloat(-9, 3306097748));
+                require(verusFloat < CustomFloat(-33, 3785965345));
+            } else if (h > JANUSV3RETARGETSTART) {
+                require(verusFloat < CustomFloat(-30, 3496838790));
+            }
+            constexpr auto factor { CustomFloat(0, 3006477107) }; // = 0.7
+            require((verusFloat * pow(sha256tFloat, factor)).below(zerosTarget, bits32));
         } else { // Old Janushash
-            // HashExponentialDigest hd; // prepare hash product of  Proof of Balanced work with two algos: verus + 3xsha256
-            // auto verusHashV2_1 { verus_hash({ data(), size() }) };
-            // hd.digest(verusHashV2_1);
-            // auto triplesha { hashSHA256(h) };
-            // hd.digest(triplesha);
-            // return verusHashV2_1[0] == 0 && target_v2().compatible(hd);
-
-            auto verusHashV2_1 { verus_hash({ data(), size() }) };
-            auto verusFloat { CustomFloat(verusHashV2_1) };
-            using namespace std;
-            // cout << to_bin(verusHashV2_1) << endl;
-            auto sha256tFloat { CustomFloat(hashSHA256(h)) };
             auto hashProduct { verusFloat * sha256tFloat };
-            if (height.value() > JANUSV5RETARGETSTART) {
-                // honest miners will be with 90% in a band around threshold, too good hashes are unlikely. 
-                // Here we reject best 10% of too good hashes, 90% of normally mined blocks will pass through. 
-                // This is to avoid unfair mining.
-                if (hashProduct * CustomFloat(4, 2684354560) < target_v2())
-                    return false;
-            }
-            return verusHashV2_1[0] == 0 && (hashProduct < target_v2());
+            if (h > JANUSV5RETARGETSTART)
+                reject((hashProduct * CustomFloat(4, 2684354560)).below(zerosTarget, bits32));
+            require(hashProduct.below(zerosTarget, bits32));
         }
-    } else {
-        return target_v1().compatible(h);
+        for (size_t i = 0; i < m; ++i)
+            out[begin + i] = valid[i];
     }
 }
+
+void HeaderView::validPOW_batch(const Hash* hashes, size_t n, TargetV1 target, uint8_t* out)
+{
+    for (size_t i = 0; i < n; ++i)
+        out[i] = target.compatible(hashes[i]);
+}
@@ -29,6 +29,21 @@ public:
 
     inline Target target(NonzeroHeight h) const;
     bool validPOW(const Hash& h, NonzeroHeight height) const;
+    // whether the PoW at this height involves the header's verushash
+    static bool uses_verushash(NonzeroHeight height);
+    // verusHash must be verus_hash of this header, requires uses_verushash(height)
+    bool validPOW(const Hash& h, NonzeroHeight height, const Hash& verusHash) const;
+    // same check against another target, e.g. an easier share target of a pool
+    bool validPOW(const Hash& h, NonzeroHeight height, const Hash& verusHash, TargetV2 target) const;
+    // out[i] = validPOW(hashes[i], height, verusHashes[i], target) for headers
+    // with the given target, the CustomFloat arithmetic runs on many headers
+    // at once. Requires uses_verushash(height).
+    static void validPOW_batch(const Hash* hashes, const Hash* verusHashes, size_t n, NonzeroHeight height, TargetV2 target, uint8_t* out);
+    // out[i] = validPOW(hashes[i], height) for pre-Janushash headers with the
+    // given target. Requires !uses_verushash(height).
+    static void validPOW_batch(const Hash* hashes, size_t n, TargetV1 target, uint8_t* out);
+    // whether the PoW of both heights is checked by the same rules
+    static bool same_pow_rules(NonzeroHeight h1, NonzeroHeight h2);
     inline uint32_t version() const;
     inline HashView prevhash() const;
     inline HashView merkleroot() const;
@@ -75,7 +75,8 @@ PaymentCreateMessage::operator std::string()
 
 bool PaymentCreateMessage::valid_signature(HashView pinHash, AddressView fromAddress) const
 {
-    return signature.recover_pubkey(tx_hash(pinHash)).address() == fromAddress;
+    auto recovered { signature.recover_address(tx_hash(pinHash)) };
+    return recovered && *recovered == fromAddress;
 }
 
 Address PaymentCreateMessage::from_address(
@@ -40,14 +40,20 @@ bool PubKey::operator==(const PubKey& rhs) const
     return secp256k1_ec_pubkey_cmp(secp256k1_ctx, &pubkey, &rhs.pubkey) == 0;
 };
 
-Address PubKey::address()
+namespace {
+Address hash_address(const std::array<uint8_t, 33>& serialized)
 {
     Address ret;
-    auto serialized = serialize();
     auto sha = hashSHA256(serialized);
     ripemd160(sha.data(), sha.size(), ret.data());
     return ret;
 }
+}
+
+Address PubKey::address()
+{
+    return hash_address(serialize());
+}
 
 std::array<uint8_t, 33> PubKey::serialize() const
 {
@@ -197,6 +203,18 @@ PubKey RecoverableSignature::recover_pubkey(HashView hv) const
     return PubKey(*this, hv);
 }
 
+std::optional<Address> RecoverableSignature::recover_address(HashView hv) const
+{
+    secp256k1_pubkey pubkey;
+    if (!secp256k1_ecdsa_recover(secp256k1_ctx, &pubkey, &recsig, hv.data()))
+        return {};
+    std::array<uint8_t, 33> serialized;
+    size_t len = serialized.size();
+    secp256k1_ec_pubkey_serialize(secp256k1_ctx, serialized.data(), &len, &pubkey,
+        SECP256K1_EC_COMPRESSED);
+    return hash_address(serialized);
+}
+
 RecoverableSignature::RecoverableSignature(const uint8_t* keydata, HashView hv)
 {
     int ret = secp256k1_ecdsa_sign_recoverable(
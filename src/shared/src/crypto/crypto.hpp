@@ -76,6 +76,9 @@ public:
       return res;
   };
   PubKey recover_pubkey(HashView) const;
+  // signer address without throwing, the context is only read such that
+  // any number of threads can recover concurrently
+  std::optional<Address> recover_address(HashView) const;
 
 private:        // private methods
   RecoverableSignature(){}; //uninitialized
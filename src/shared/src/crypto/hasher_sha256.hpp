@@ -4,8 +4,11 @@
 #include "hash.hpp"
 #include "sha2.hpp"
 #include <array>
+#include <cassert>
+#include <cstring>
 #include <cstdint>
 #include <iostream>
+#include <span>
 #include <vector>
 class HasherSHA256 {
 private:
@@ -74,12 +77,89 @@ private:
     }
 };
 
-inline Hash hashSHA256(const uint8_t* data, size_t len)
-{
-    Hash res;
-    sha256_Raw(data, len, res.data());
-    return res;
-}
+// Collects the N bytes a HasherSHA256 with the same operator<< sequence
+// would hash, such that many such inputs can be hashed with
+// hashSHA256_batch.
+template <size_t N>
+class SHA256Input {
+public:
+    template <size_t M>
+    SHA256Input& operator<<(const std::array<uint8_t, M>& arr)
+    {
+        return write(arr.data(), arr.size());
+    }
+    template <size_t M>
+    SHA256Input& operator<<(View<M> v)
+    {
+        return write(v.data(), v.size());
+    }
+    SHA256Input& operator<<(IsUint32 val)
+    {
+        return *this << val.value();
+    }
+    SHA256Input& operator<<(uint32_t val)
+    {
+        uint32_t valBe = hton32(val);
+        return write(&valBe, 4);
+    }
+    SHA256Input& operator<<(IsUint64 val)
+    {
+        return *this << val.value();
+    }
+    SHA256Input& operator<<(uint64_t val)
+    {
+        uint64_t valBe = hton64(val);
+        return write(&valBe, 8);
+    }
+    SHA256Input& operator<<(uint16_t val)
+    {
+        uint16_t valBe = hton16(val);
+        return write(&valBe, 2);
+    }
+    const uint8_t* data() const
+    {
+        assert(pos == N);
+        return bytes.data();
+    }
+    static constexpr size_t size() { return N; }
+
+private:
+    SHA256Input& write(const void* data, size_t len)
+    {
+        assert(pos + len <= N);
+        memcpy(bytes.data() + pos, data, len);
+        pos += len;
+        return *this;
+    }
+    std::array<uint8_t, N> bytes;
+    size_t pos { 0 };
+};
+
+// Uses SHA extensions when supported by the CPU
+Hash hashSHA256(const uint8_t* data, size_t len);
+
+// Multi-buffer hashing of independent inputs, out[i] receives the hash of
+// the i-th input. Depending on the CPU inputs are processed with SHA
+// extensions, 8 AVX2 lanes or 4 SSE2/NEON lanes.
+void hashSHA256_batch(std::span<const std::span<const uint8_t>> inputs, Hash* out);
+// n inputs of length len, the i-th input starts at data + i * stride
+void hashSHA256_batch(const uint8_t* data, size_t len, size_t stride, size_t n, Hash* out);
+
+// SHA256 state after a prefix of whole 64 byte blocks, inputs sharing the
+// prefix are hashed without processing it again
+class SHA256Midstate {
+public:
+    // len must be a multiple of 64
+    SHA256Midstate(const uint8_t* prefix, size_t len);
+    // hash of the prefix followed by tail
+    Hash hash(const uint8_t* tail, size_t len) const;
+    // big endian words of the state
+    const std::array<uint32_t, 8>& state() const { return h; }
+
+private:
+    std::array<uint32_t, 8> h;
+    uint64_t prefixLen;
+};
 
 inline Hash hashSHA256(const std::vector<uint8_t>& vec)
 {
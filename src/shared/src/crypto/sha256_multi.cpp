@@ -0,0 +1,371 @@
+#include "hasher_sha256.hpp"
+#include "general/cpu_features.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SHA256_X86
+#include <immintrin.h>
+#elif defined(__arm__) || defined(__aarch64__)
+#include "crypto/sse2neon.h"
+#if defined(__aarch64__)
+#define SHA256_ARMV8
+#include <arm_neon.h>
+#endif
+#endif
+
+namespace {
+constexpr uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+constexpr uint32_t H0[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+inline uint32_t read_be32(const uint8_t* p)
+{
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+inline void write_be32(uint8_t* p, uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+// message blocks of a single input including the SHA256 padding
+struct LaneInput {
+    const uint8_t* data { nullptr };
+    size_t fullBlocks { 0 };
+    size_t nblocks { 0 }; // 0 for unused lanes
+    uint8_t tail[128];
+    void init(const uint8_t* d, size_t len)
+    {
+        data = d;
+        fullBlocks = len / 64;
+        const size_t rem { len % 64 };
+        const size_t tailBlocks { rem + 9 > 64 ? 2u : 1u };
+        nblocks = fullBlocks + tailBlocks;
+        memset(tail, 0, sizeof(tail));
+        if (rem > 0)
+            memcpy(tail, d + 64 * fullBlocks, rem);
+        tail[rem] = 0x80;
+        const uint64_t bits { uint64_t(len) * 8 };
+        write_be32(tail + 64 * tailBlocks - 8, uint32_t(bits >> 32));
+        write_be32(tail + 64 * tailBlocks - 4, uint32_t(bits));
+    }
+    const uint8_t* block(size_t i) const
+    {
+        if (i < fullBlocks)
+            return data + 64 * i;
+        if (i < nblocks)
+            return tail + 64 * (i - fullBlocks);
+        return tail; // lane finished, result is ignored
+    }
+};
+
+// 4 lanes, SSE2 on x86 and NEON (through sse2neon) on ARM
+#if defined(SHA256_X86) || defined(__arm__) || defined(__aarch64__)
+#define SHA256_LANES4
+namespace lanes4 {
+struct Ops {
+    using T = __m128i;
+    static constexpr size_t lanes = 4;
+    static T add(T a, T b) { return _mm_add_epi32(a, b); }
+    static T xor_(T a, T b) { return _mm_xor_si128(a, b); }
+    static T and_(T a, T b) { return _mm_and_si128(a, b); }
+    static T or_(T a, T b) { return _mm_or_si128(a, b); }
+    static T andnot(T a, T b) { return _mm_andnot_si128(a, b); } // ~a & b
+    template <int n>
+    static T shr(T a) { return _mm_srli_epi32(a, n); }
+    template <int n>
+    static T shl(T a) { return _mm_slli_epi32(a, n); }
+    static T set1(uint32_t v) { return _mm_set1_epi32(int(v)); }
+    static T load(const uint32_t* p) { return _mm_loadu_si128((const __m128i*)p); }
+    static void store(uint32_t* p, T v) { _mm_storeu_si128((__m128i*)p, v); }
+};
+#define LANES_TARGET
+#include "sha256_lanes.inc"
+#undef LANES_TARGET
+}
+#endif
+
+#ifdef SHA256_X86
+// 8 lanes, AVX2
+namespace lanes8 {
+#define LANES_TARGET __attribute__((target("avx2")))
+struct Ops {
+    using T = __m256i;
+    static constexpr size_t lanes = 8;
+    LANES_TARGET static T add(T a, T b) { return _mm256_add_epi32(a, b); }
+    LANES_TARGET static T xor_(T a, T b) { return _mm256_xor_si256(a, b); }
+    LANES_TARGET static T and_(T a, T b) { return _mm256_and_si256(a, b); }
+    LANES_TARGET static T or_(T a, T b) { return _mm256_or_si256(a, b); }
+    LANES_TARGET static T andnot(T a, T b) { return _mm256_andnot_si256(a, b); }
+    template <int n>
+    LANES_TARGET static T shr(T a) { return _mm256_srli_epi32(a, n); }
+    template <int n>
+    LANES_TARGET static T shl(T a) { return _mm256_slli_epi32(a, n); }
+    LANES_TARGET static T set1(uint32_t v) { return _mm256_set1_epi32(int(v)); }
+    LANES_TARGET static T load(const uint32_t* p) { return _mm256_loadu_si256((const __m256i*)p); }
+    LANES_TARGET static void store(uint32_t* p, T v) { _mm256_storeu_si256((__m256i*)p, v); }
+};
+#include "sha256_lanes.inc"
+#undef LANES_TARGET
+}
+
+// single buffer, SHA extensions
+namespace shani {
+__attribute__((target("sha,sse4.1"))) void transform(uint32_t state[8], const uint8_t* data, size_t nblocks)
+{
+    const __m128i MASK { _mm_set_epi64x(0x0c0d0e0f08090a0bull, 0x0405060700010203ull) };
+    __m128i tmp { _mm_loadu_si128((const __m128i*)&state[0]) };
+    __m128i state1 { _mm_loadu_si128((const __m128i*)&state[4]) };
+    tmp = _mm_shuffle_epi32(tmp, 0xB1); // CDAB
+    state1 = _mm_shuffle_epi32(state1, 0x1B); // EFGH
+    __m128i state0 { _mm_alignr_epi8(tmp, state1, 8) }; // ABEF
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0); // CDGH
+
+    for (size_t b = 0; b < nblocks; ++b, data += 64) {
+        const __m128i abefSave { state0 };
+        const __m128i cdghSave { state1 };
+        __m128i m[4];
+        for (size_t g = 0; g < 16; ++g) {
+            if (g < 4)
+                m[g] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 16 * g)), MASK);
+            __m128i msg { _mm_add_epi32(m[g % 4], _mm_loadu_si128((const __m128i*)(K + 4 * g))) };
+            state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+            if (g >= 3 && g <= 14) {
+                __m128i& next { m[(g + 1) % 4] };
+                next = _mm_add_epi32(next, _mm_alignr_epi8(m[g % 4], m[(g + 3) % 4], 4));
+                next = _mm_sha256msg2_epu32(next, m[g % 4]);
+            }
+            msg = _mm_shuffle_epi32(msg, 0x0E);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+            if (g >= 1 && g <= 12)
+                m[(g + 3) % 4] = _mm_sha256msg1_epu32(m[(g + 3) % 4], m[g % 4]);
+        }
+        state0 = _mm_add_epi32(state0, abefSave);
+        state1 = _mm_add_epi32(state1, cdghSave);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B); // FEBA
+    state1 = _mm_shuffle_epi32(state1, 0xB1); // DCHG
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0); // DCBA
+    state1 = _mm_alignr_epi8(state1, tmp, 8); // ABEF
+    _mm_storeu_si128((__m128i*)&state[0], state0);
+    _mm_storeu_si128((__m128i*)&state[4], state1);
+}
+
+void hash(const uint8_t* data, size_t len, uint8_t* out)
+{
+    uint32_t state[8];
+    memcpy(state, H0, sizeof(state));
+    LaneInput in;
+    in.init(data, len);
+    transform(state, data, in.fullBlocks);
+    transform(state, in.tail, in.nblocks - in.fullBlocks);
+    for (size_t i = 0; i < 8; ++i)
+        write_be32(out + 4 * i, state[i]);
+}
+}
+#endif
+
+#ifdef SHA256_ARMV8
+// single buffer, ARMv8 SHA2 instructions
+namespace armv8 {
+#ifdef __clang__
+#define SHA2_TARGET __attribute__((target("sha2")))
+#else
+#define SHA2_TARGET __attribute__((target("+sha2")))
+#endif
+SHA2_TARGET void transform(uint32_t state[8], const uint8_t* data, size_t nblocks)
+{
+    uint32x4_t state0 { vld1q_u32(&state[0]) }; // ABCD
+    uint32x4_t state1 { vld1q_u32(&state[4]) }; // EFGH
+
+    for (size_t b = 0; b < nblocks; ++b, data += 64) {
+        const uint32x4_t abcdSave { state0 };
+        const uint32x4_t efghSave { state1 };
+        uint32x4_t m[4];
+        for (size_t g = 0; g < 4; ++g)
+            m[g] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 16 * g)));
+        for (size_t g = 0; g < 16; ++g) {
+            const uint32x4_t msg { vaddq_u32(m[g % 4], vld1q_u32(K + 4 * g)) };
+            if (g < 12)
+                m[g % 4] = vsha256su0q_u32(m[g % 4], m[(g + 1) % 4]);
+            const uint32x4_t tmp { state0 };
+            state0 = vsha256hq_u32(state0, state1, msg);
+            state1 = vsha256h2q_u32(state1, tmp, msg);
+            if (g < 12)
+                m[g % 4] = vsha256su1q_u32(m[g % 4], m[(g + 2) % 4], m[(g + 3) % 4]);
+        }
+        state0 = vaddq_u32(state0, abcdSave);
+        state1 = vaddq_u32(state1, efghSave);
+    }
+    vst1q_u32(&state[0], state0);
+    vst1q_u32(&state[4], state1);
+}
+#undef SHA2_TARGET
+
+void hash(const uint8_t* data, size_t len, uint8_t* out)
+{
+    uint32_t state[8];
+    memcpy(state, H0, sizeof(state));
+    LaneInput in;
+    in.init(data, len);
+    transform(state, data, in.fullBlocks);
+    transform(state, in.tail, in.nblocks - in.fullBlocks);
+    for (size_t i = 0; i < 8; ++i)
+        write_be32(out + 4 * i, state[i]);
+}
+}
+#endif
+
+void hash_trezor(const uint8_t* data, size_t len, uint8_t* out)
+{
+    sha256_Raw(data, len, out);
+}
+
+void transform_trezor(uint32_t state[8], const uint8_t* data, size_t nblocks)
+{
+    for (size_t b = 0; b < nblocks; ++b, data += 64) {
+        uint32_t w[16];
+        for (size_t i = 0; i < 16; ++i)
+            w[i] = read_be32(data + 4 * i);
+        sha256_Transform(state, w, state);
+    }
+}
+
+struct Implementation {
+    size_t lanes { 1 };
+    void (*hash_lanes)(const LaneInput*, Hash* const*) { nullptr };
+    void (*hash_single)(const uint8_t*, size_t, uint8_t*) { hash_trezor };
+    void (*transform)(uint32_t*, const uint8_t*, size_t) { transform_trezor };
+};
+
+Implementation detect()
+{
+    [[maybe_unused]] auto& f { cpu_features() };
+    Implementation impl;
+#ifdef SHA256_LANES4
+    impl.lanes = lanes4::Ops::lanes;
+    impl.hash_lanes = lanes4::hash_lanes;
+#endif
+#ifdef SHA256_X86
+    if (f.sse41 && f.sha) {
+        // SHA extensions beat multi-lane hashing per buffer
+        impl.lanes = 1;
+        impl.hash_lanes = nullptr;
+        impl.hash_single = shani::hash;
+        impl.transform = shani::transform;
+    } else if (f.avx2) {
+        impl.lanes = lanes8::Ops::lanes;
+        impl.hash_lanes = lanes8::hash_lanes;
+    }
+#endif
+#ifdef SHA256_ARMV8
+    if (f.armSha2) {
+        // like SHA extensions on x86 faster than NEON lanes
+        impl.lanes = 1;
+        impl.hash_lanes = nullptr;
+        impl.hash_single = armv8::hash;
+        impl.transform = armv8::transform;
+    }
+#endif
+    return impl;
+}
+
+const Implementation& implementation()
+{
+    static const Implementation impl { detect() };
+    return impl;
+}
+
+template <typename InputAt>
+void hash_batch(size_t n, InputAt&& input_at, Hash* out)
+{
+    const auto& impl { implementation() };
+    size_t i { 0 };
+    if (impl.hash_lanes) {
+        LaneInput in[8];
+        Hash* outs[8];
+        for (; i + 1 < n; i += impl.lanes) { // at least 2 inputs left
+            for (size_t l = 0; l < impl.lanes; ++l) {
+                if (i + l < n) {
+                    auto s { input_at(i + l) };
+                    in[l].init(s.data(), s.size());
+                    outs[l] = out + i + l;
+                } else {
+                    in[l].nblocks = 0;
+                    outs[l] = nullptr;
+                }
+            }
+            impl.hash_lanes(in, outs);
+        }
+    }
+    for (; i < n; ++i) {
+        auto s { input_at(i) };
+        impl.hash_single(s.data(), s.size(), out[i].data());
+    }
+}
+}
+
+Hash hashSHA256(const uint8_t* data, size_t len)
+{
+    Hash res;
+    implementation().hash_single(data, len, res.data());
+    return res;
+}
+
+SHA256Midstate::SHA256Midstate(const uint8_t* prefix, size_t len)
+    : prefixLen(len)
+{
+    assert(len % 64 == 0);
+    memcpy(h.data(), H0, sizeof(H0));
+    implementation().transform(h.data(), prefix, len / 64);
+}
+
+Hash SHA256Midstate::hash(const uint8_t* tail, size_t len) const
+{
+    const auto& impl { implementation() };
+    auto state { h };
+    const size_t fullBlocks { len / 64 };
+    impl.transform(state.data(), tail, fullBlocks);
+    const size_t rem { len % 64 };
+    const size_t tailBlocks { rem + 9 > 64 ? 2u : 1u };
+    uint8_t last[128] {};
+    if (rem > 0)
+        memcpy(last, tail + 64 * fullBlocks, rem);
+    last[rem] = 0x80;
+    const uint64_t bits { (prefixLen + len) * 8 };
+    write_be32(last + 64 * tailBlocks - 8, uint32_t(bits >> 32));
+    write_be32(last + 64 * tailBlocks - 4, uint32_t(bits));
+    impl.transform(state.data(), last, tailBlocks);
+    Hash res;
+    for (size_t i = 0; i < 8; ++i)
+        write_be32(res.data() + 4 * i, state[i]);
+    return res;
+}
+
+void hashSHA256_batch(std::span<const std::span<const uint8_t>> inputs, Hash* out)
+{
+    hash_batch(
+        inputs.size(), [&](size_t i) { return inputs[i]; }, out);
+}
+
+void hashSHA256_batch(const uint8_t* data, size_t len, size_t stride, size_t n, Hash* out)
+{
+    hash_batch(
+        n, [&](size_t i) { return std::span<const uint8_t>(data + i * stride, len); }, out);
+}
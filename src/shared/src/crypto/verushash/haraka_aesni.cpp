@@ -0,0 +1,115 @@
+#include "haraka_aesni.hpp"
+#ifdef VERUS_HARAKA_AESNI
+#include "verus_clhash_port.hpp"
+#include <wmmintrin.h>
+
+#define AESNI_TARGET __attribute__((target("aes")))
+
+namespace {
+AESNI_TARGET inline const __m128i* constants()
+{
+    return reinterpret_cast<const __m128i*>(haraka_round_constants());
+}
+
+AESNI_TARGET inline __m128i load(const unsigned char* p) { return _mm_loadu_si128((const __m128i*)p); }
+
+AESNI_TARGET inline void mix2(__m128i& s0, __m128i& s1)
+{
+    __m128i tmp = _mm_unpacklo_epi32(s0, s1);
+    s1 = _mm_unpackhi_epi32(s0, s1);
+    s0 = tmp;
+}
+
+AESNI_TARGET inline void mix4(__m128i& s0, __m128i& s1, __m128i& s2, __m128i& s3)
+{
+    __m128i tmp = _mm_unpacklo_epi32(s0, s1);
+    s0 = _mm_unpackhi_epi32(s0, s1);
+    s1 = _mm_unpacklo_epi32(s2, s3);
+    s2 = _mm_unpackhi_epi32(s2, s3);
+    s3 = _mm_unpacklo_epi32(s0, s2);
+    s0 = _mm_unpackhi_epi32(s0, s2);
+    s2 = _mm_unpackhi_epi32(s1, tmp);
+    s1 = _mm_unpacklo_epi32(s1, tmp);
+}
+
+AESNI_TARGET inline void haraka512_perm(__m128i s[4], const __m128i* rc)
+{
+    for (size_t i = 0; i < 5; ++i) {
+        for (size_t j = 0; j < 2; ++j) {
+            s[0] = _mm_aesenc_si128(s[0], _mm_loadu_si128(rc + 8 * i + 4 * j));
+            s[1] = _mm_aesenc_si128(s[1], _mm_loadu_si128(rc + 8 * i + 4 * j + 1));
+            s[2] = _mm_aesenc_si128(s[2], _mm_loadu_si128(rc + 8 * i + 4 * j + 2));
+            s[3] = _mm_aesenc_si128(s[3], _mm_loadu_si128(rc + 8 * i + 4 * j + 3));
+        }
+        mix4(s[0], s[1], s[2], s[3]);
+    }
+}
+
+AESNI_TARGET inline void haraka512(unsigned char* out, const unsigned char* in, const __m128i* rc)
+{
+    __m128i s[4] { load(in), load(in + 16), load(in + 32), load(in + 48) };
+    haraka512_perm(s, rc);
+    // feed-forward and truncation
+    s[0] = _mm_xor_si128(s[0], load(in));
+    s[1] = _mm_xor_si128(s[1], load(in + 16));
+    s[2] = _mm_xor_si128(s[2], load(in + 32));
+    s[3] = _mm_xor_si128(s[3], load(in + 48));
+    _mm_storel_epi64((__m128i*)out, _mm_unpackhi_epi64(s[0], s[0]));
+    _mm_storel_epi64((__m128i*)(out + 8), _mm_unpackhi_epi64(s[1], s[1]));
+    _mm_storel_epi64((__m128i*)(out + 16), s[2]);
+    _mm_storel_epi64((__m128i*)(out + 24), s[3]);
+}
+}
+
+AESNI_TARGET void haraka256_aesni(unsigned char* out, const unsigned char* in)
+{
+    const __m128i* rc { constants() };
+    __m128i s0 { load(in) }, s1 { load(in + 16) };
+    for (size_t i = 0; i < 5; ++i) {
+        for (size_t j = 0; j < 2; ++j) {
+            s0 = _mm_aesenc_si128(s0, _mm_loadu_si128(rc + 4 * i + 2 * j));
+            s1 = _mm_aesenc_si128(s1, _mm_loadu_si128(rc + 4 * i + 2 * j + 1));
+        }
+        mix2(s0, s1);
+    }
+    _mm_storeu_si128((__m128i*)out, _mm_xor_si128(s0, load(in)));
+    _mm_storeu_si128((__m128i*)(out + 16), _mm_xor_si128(s1, load(in + 16)));
+}
+
+AESNI_TARGET void haraka256_aesni_x4(unsigned char* const out[4], const unsigned char* const in[4])
+{
+    const __m128i* rc { constants() };
+    __m128i s[4][2];
+    for (size_t l = 0; l < 4; ++l) {
+        s[l][0] = load(in[l]);
+        s[l][1] = load(in[l] + 16);
+    }
+    for (size_t i = 0; i < 5; ++i) {
+        for (size_t j = 0; j < 2; ++j) {
+            const __m128i k0 { _mm_loadu_si128(rc + 4 * i + 2 * j) };
+            const __m128i k1 { _mm_loadu_si128(rc + 4 * i + 2 * j + 1) };
+            // independent lanes back to back
+            for (size_t l = 0; l < 4; ++l) {
+                s[l][0] = _mm_aesenc_si128(s[l][0], k0);
+                s[l][1] = _mm_aesenc_si128(s[l][1], k1);
+            }
+        }
+        for (size_t l = 0; l < 4; ++l)
+            mix2(s[l][0], s[l][1]);
+    }
+    for (size_t l = 0; l < 4; ++l) {
+        _mm_storeu_si128((__m128i*)out[l], _mm_xor_si128(s[l][0], load(in[l])));
+        _mm_storeu_si128((__m128i*)(out[l] + 16), _mm_xor_si128(s[l][1], load(in[l] + 16)));
+    }
+}
+
+AESNI_TARGET void haraka512_aesni(unsigned char* out, const unsigned char* in)
+{
+    haraka512(out, in, constants());
+}
+
+AESNI_TARGET void haraka512_aesni_keyed(unsigned char* out, const unsigned char* in, const u128* rc)
+{
+    haraka512(out, in, rc);
+}
+#endif
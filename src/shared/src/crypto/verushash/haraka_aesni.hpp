@@ -0,0 +1,15 @@
+#pragma once
+#include "u128.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define VERUS_HARAKA_AESNI
+// AES-NI implementations of the Haraka permutations used by VerusHash.
+// Only call them if Verus::can_optimize() returns true.
+void haraka256_aesni(unsigned char* out, const unsigned char* in);
+void haraka512_aesni(unsigned char* out, const unsigned char* in);
+void haraka512_aesni_keyed(unsigned char* out, const unsigned char* in, const u128* rc);
+
+// 4 independent Haraka-256 evaluations with interleaved AES rounds to hide
+// the latency of the aesenc instruction
+void haraka256_aesni_x4(unsigned char* const out[4], const unsigned char* const in[4]);
+#endif
@@ -0,0 +1,123 @@
+#include "haraka_armv8.hpp"
+#ifdef VERUS_HARAKA_ARMV8
+#include "verus_clhash_port.hpp"
+#include <arm_neon.h>
+
+namespace {
+inline const uint8x16_t* constants()
+{
+    return reinterpret_cast<const uint8x16_t*>(haraka_round_constants());
+}
+
+inline uint8x16_t load(const unsigned char* p) { return vld1q_u8(p); }
+inline uint8x16_t load(const uint8x16_t* p) { return vld1q_u8(reinterpret_cast<const uint8_t*>(p)); }
+
+// same as _mm_aesenc_si128: aese xors the key before SubBytes/ShiftRows,
+// aesenc after MixColumns
+ARMV8_CRYPTO_TARGET inline uint8x16_t aesenc(uint8x16_t s, uint8x16_t k)
+{
+    return veorq_u8(vaesmcq_u8(vaeseq_u8(s, vdupq_n_u8(0))), k);
+}
+
+inline void mix2(uint8x16_t& s0, uint8x16_t& s1)
+{
+    uint32x4_t a { vreinterpretq_u32_u8(s0) }, b { vreinterpretq_u32_u8(s1) };
+    s0 = vreinterpretq_u8_u32(vzip1q_u32(a, b));
+    s1 = vreinterpretq_u8_u32(vzip2q_u32(a, b));
+}
+
+// mirrors the _mm_unpack*_epi32 sequence of the AES-NI version
+inline void mix4(uint8x16_t& s0, uint8x16_t& s1, uint8x16_t& s2, uint8x16_t& s3)
+{
+    uint32x4_t a { vreinterpretq_u32_u8(s0) }, b { vreinterpretq_u32_u8(s1) };
+    uint32x4_t c { vreinterpretq_u32_u8(s2) }, d { vreinterpretq_u32_u8(s3) };
+    uint32x4_t tmp { vzip1q_u32(a, b) };
+    a = vzip2q_u32(a, b);
+    b = vzip1q_u32(c, d);
+    c = vzip2q_u32(c, d);
+    d = vzip1q_u32(a, c);
+    a = vzip2q_u32(a, c);
+    c = vzip2q_u32(b, tmp);
+    b = vzip1q_u32(b, tmp);
+    s0 = vreinterpretq_u8_u32(a);
+    s1 = vreinterpretq_u8_u32(b);
+    s2 = vreinterpretq_u8_u32(c);
+    s3 = vreinterpretq_u8_u32(d);
+}
+
+ARMV8_CRYPTO_TARGET inline void haraka512(unsigned char* out, const unsigned char* in, const uint8x16_t* rc)
+{
+    uint8x16_t s[4] { load(in), load(in + 16), load(in + 32), load(in + 48) };
+    for (size_t i = 0; i < 5; ++i) {
+        for (size_t j = 0; j < 2; ++j) {
+            s[0] = aesenc(s[0], load(rc + 8 * i + 4 * j));
+            s[1] = aesenc(s[1], load(rc + 8 * i + 4 * j + 1));
+            s[2] = aesenc(s[2], load(rc + 8 * i + 4 * j + 2));
+            s[3] = aesenc(s[3], load(rc + 8 * i + 4 * j + 3));
+        }
+        mix4(s[0], s[1], s[2], s[3]);
+    }
+    // feed-forward and truncation
+    s[0] = veorq_u8(s[0], load(in));
+    s[1] = veorq_u8(s[1], load(in + 16));
+    s[2] = veorq_u8(s[2], load(in + 32));
+    s[3] = veorq_u8(s[3], load(in + 48));
+    vst1_u8(out, vget_high_u8(s[0]));
+    vst1_u8(out + 8, vget_high_u8(s[1]));
+    vst1_u8(out + 16, vget_low_u8(s[2]));
+    vst1_u8(out + 24, vget_low_u8(s[3]));
+}
+}
+
+ARMV8_CRYPTO_TARGET void haraka256_armv8(unsigned char* out, const unsigned char* in)
+{
+    const uint8x16_t* rc { constants() };
+    uint8x16_t s0 { load(in) }, s1 { load(in + 16) };
+    for (size_t i = 0; i < 5; ++i) {
+        for (size_t j = 0; j < 2; ++j) {
+            s0 = aesenc(s0, load(rc + 4 * i + 2 * j));
+            s1 = aesenc(s1, load(rc + 4 * i + 2 * j + 1));
+        }
+        mix2(s0, s1);
+    }
+    vst1q_u8(out, veorq_u8(s0, load(in)));
+    vst1q_u8(out + 16, veorq_u8(s1, load(in + 16)));
+}
+
+ARMV8_CRYPTO_TARGET void haraka256_armv8_x4(unsigned char* const out[4], const unsigned char* const in[4])
+{
+    const uint8x16_t* rc { constants() };
+    uint8x16_t s[4][2];
+    for (size_t l = 0; l < 4; ++l) {
+        s[l][0] = load(in[l]);
+        s[l][1] = load(in[l] + 16);
+    }
+    for (size_t i = 0; i < 5; ++i) {
+        for (size_t j = 0; j < 2; ++j) {
+            const uint8x16_t k0 { load(rc + 4 * i + 2 * j) };
+            const uint8x16_t k1 { load(rc + 4 * i + 2 * j + 1) };
+            // independent lanes back to back
+            for (size_t l = 0; l < 4; ++l) {
+                s[l][0] = aesenc(s[l][0], k0);
+                s[l][1] = aesenc(s[l][1], k1);
+            }
+        }
+        for (size_t l = 0; l < 4; ++l)
+            mix2(s[l][0], s[l][1]);
+    }
+    for (size_t l = 0; l < 4; ++l) {
+        vst1q_u8(out[l], veorq_u8(s[l][0], load(in[l])));
+        vst1q_u8(out[l] + 16, veorq_u8(s[l][1], load(in[l] + 16)));
+    }
+}
+
+ARMV8_CRYPTO_TARGET void haraka512_armv8(unsigned char* out, const unsigned char* in)
+{
+    haraka512(out, in, constants());
+}
+
+ARMV8_CRYPTO_TARGET void haraka512_armv8_keyed(unsigned char* out, const unsigned char* in, const u128* rc)
+{
+    haraka512(out, in, reinterpret_cast<const uint8x16_t*>(rc));
+}
+#endif
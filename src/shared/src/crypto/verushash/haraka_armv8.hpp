@@ -0,0 +1,25 @@
+#pragma once
+#include "u128.h"
+
+#if defined(__aarch64__)
+#define VERUS_HARAKA_ARMV8
+// ARMv8 crypto extension implementations of the Haraka permutations and of
+// verusclhash v2.1 used by VerusHash. Only call them if
+// Verus::can_optimize() returns true.
+void haraka256_armv8(unsigned char* out, const unsigned char* in);
+void haraka512_armv8(unsigned char* out, const unsigned char* in);
+void haraka512_armv8_keyed(unsigned char* out, const unsigned char* in, const u128* rc);
+
+// 4 independent Haraka-256 evaluations with interleaved AES rounds to hide
+// the latency of the aese/aesmc pair
+void haraka256_armv8_x4(unsigned char* const out[4], const unsigned char* const in[4]);
+
+uint64_t verusclhash_sv2_1_armv8(void* random, const unsigned char buf[64],
+    uint64_t keyMask, __m128i** pMoveScratch);
+
+#ifdef __clang__
+#define ARMV8_CRYPTO_TARGET __attribute__((target("crypto")))
+#else
+#define ARMV8_CRYPTO_TARGET __attribute__((target("+crypto")))
+#endif
+#endif
@@ -0,0 +1,93 @@
+#include "haraka_armv8.hpp"
+#ifdef VERUS_HARAKA_ARMV8
+#include <arm_neon.h>
+#include <cstring>
+
+// verusclhash v2.1 with the carryless multiplications on PMULL and the AES
+// rounds on the crypto extension instead of the table based emulation of
+// verus_clhash_port.cpp. The inner loop is shared via verus_clhash_sv2_1.inc.
+namespace {
+ARMV8_CRYPTO_TARGET inline __m128i _mm_clmulepi64_si128_emu(const __m128i& a, const __m128i& b, int imm)
+{
+    const uint64x2_t ua { vreinterpretq_u64_s64(a) }, ub { vreinterpretq_u64_s64(b) };
+    const poly64_t x { (imm & 1) ? vgetq_lane_u64(ua, 1) : vgetq_lane_u64(ua, 0) };
+    const poly64_t y { (imm & 0x10) ? vgetq_lane_u64(ub, 1) : vgetq_lane_u64(ub, 0) };
+    return vreinterpretq_s64_p128(vmull_p64(x, y));
+}
+
+// rounding narrow shift does not saturate, unlike vqrdmulhq_s16, so the
+// result matches _mm_mulhrs_epi16 for -32768 * -32768 too
+inline __m128i _mm_mulhrs_epi16_emu(__m128i a, __m128i b)
+{
+    const int16x8_t sa { vreinterpretq_s16_s64(a) }, sb { vreinterpretq_s16_s64(b) };
+    const int32x4_t lo { vmull_s16(vget_low_s16(sa), vget_low_s16(sb)) };
+    const int32x4_t hi { vmull_s16(vget_high_s16(sa), vget_high_s16(sb)) };
+    return vreinterpretq_s64_s16(vcombine_s16(vrshrn_n_s32(lo, 15), vrshrn_n_s32(hi, 15)));
+}
+
+inline __m128i _mm_xor_si128_emu(__m128i a, __m128i b) { return veorq_s64(a, b); }
+inline __m128i _mm_load_si128_emu(const void* p) { return vld1q_s64((const int64_t*)p); }
+inline void _mm_store_si128_emu(void* p, __m128i val) { vst1q_s64((int64_t*)p, val); }
+inline int64_t _mm_cvtsi128_si64_emu(const __m128i& a) { return vgetq_lane_s64(a, 0); }
+inline __m128i _mm_cvtsi32_si128_emu(uint32_t lo) { return vcombine_s64(vcreate_s64(lo), vcreate_s64(0)); }
+
+inline __m128i _mm_unpacklo_epi32_emu(__m128i a, __m128i b)
+{
+    return vreinterpretq_s64_u32(vzip1q_u32(vreinterpretq_u32_s64(a), vreinterpretq_u32_s64(b)));
+}
+
+inline __m128i _mm_unpackhi_epi32_emu(__m128i a, __m128i b)
+{
+    return vreinterpretq_s64_u32(vzip2q_u32(vreinterpretq_u32_s64(a), vreinterpretq_u32_s64(b)));
+}
+
+// same as _mm_aesenc_si128 on 16 byte buffers
+ARMV8_CRYPTO_TARGET inline void aesenc(unsigned char* s, const unsigned char* rk)
+{
+    const uint8x16_t x { vaesmcq_u8(vaeseq_u8(vld1q_u8(s), vdupq_n_u8(0))) };
+    vst1q_u8(s, veorq_u8(x, vld1q_u8(rk)));
+}
+
+#define AES2_EMU(s0, s1, rci)                                    \
+    aesenc((unsigned char*)&s0, (unsigned char*)&(rc[rci]));     \
+    aesenc((unsigned char*)&s1, (unsigned char*)&(rc[rci + 1])); \
+    aesenc((unsigned char*)&s0, (unsigned char*)&(rc[rci + 2])); \
+    aesenc((unsigned char*)&s1, (unsigned char*)&(rc[rci + 3]));
+
+#define MIX2_EMU(s0, s1)                         \
+    tmp = _mm_unpacklo_epi32_emu(s0, s1);        \
+    s1 = _mm_unpackhi_epi32_emu(s0, s1);         \
+    s0 = tmp;
+
+#define CLHASH_REPEAT_SV2_1 clmul_repeat_sv2_1
+#define CLHASH_TARGET ARMV8_CRYPTO_TARGET
+#include "verus_clhash_sv2_1.inc"
+#undef CLHASH_TARGET
+#undef CLHASH_REPEAT_SV2_1
+#undef MIX2_EMU
+#undef AES2_EMU
+
+// modulo reduction to 64-bit value, see precompReduction64_port
+ARMV8_CRYPTO_TARGET inline uint64_t precomp_reduction64(__m128i A)
+{
+    static constexpr uint8_t table[16] { 0, 27, 54, 45, 108, 119, 90, 65, 216, 195, 238, 245, 180, 175, 130, 153 };
+    const uint64x2_t a { vreinterpretq_u64_s64(A) };
+    // (64,4,3,1,0) irreducible polynomial
+    const uint8x16_t Q2 { vreinterpretq_u8_p128(vmull_p64(vgetq_lane_u64(a, 1), (1U << 4) + (1U << 3) + (1U << 1) + (1U << 0))) };
+    // pshufb semantics: index bits 0-3, bit 7 zeroes the byte
+    const uint8x16_t idx { vandq_u8(vextq_u8(Q2, vdupq_n_u8(0), 8), vdupq_n_u8(0x8f)) };
+    const uint8x16_t Q3 { vqtbl1q_u8(vld1q_u8(table), idx) };
+    const uint8x16_t Q4 { veorq_u8(Q2, vreinterpretq_u8_u64(a)) };
+    return vgetq_lane_u64(vreinterpretq_u64_u8(veorq_u8(Q3, Q4)), 0);
+}
+}
+
+ARMV8_CRYPTO_TARGET uint64_t verusclhash_sv2_1_armv8(void* random, const unsigned char buf[64],
+    uint64_t keyMask, __m128i** pMoveScratch)
+{
+    __m128i acc { clmul_repeat_sv2_1((__m128i*)random, (const __m128i*)buf, keyMask, pMoveScratch) };
+    // lazyLengthHash(1024, 64)
+    acc = veorq_s64(acc, vreinterpretq_s64_p128(vmull_p64(64, 1024)));
+    return precomp_reduction64(acc);
+}
+#endif
@@ -19,3 +19,6 @@ void haraka512_port_keyed(unsigned char *out, const unsigned char *in,
 /* Implementation of Haraka-256 */
 void haraka256_port(unsigned char *out, const unsigned char *in);
 
+/* Haraka round constants (40 x 16 bytes) */
+const unsigned char *haraka_round_constants();
+
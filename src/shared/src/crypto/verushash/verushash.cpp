@@ -5,15 +5,44 @@
 
 #if defined(__arm__) || defined(__aarch64__)
 #include "crypto/sse2neon.h"
-// #include <asm/hwcap.h>
-// #include <sys/auxv.h>
 #else
-#include <cpuid.h>
 #include <x86intrin.h>
 #endif // !WIN32
 
 // #include "verus_clhash_opt.hpp"
+#include "general/cpu_features.hpp"
+#include "haraka_aesni.hpp"
+#include "haraka_armv8.hpp"
 #include "verus_clhash_port.hpp"
+#include <array>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <optional>
+#include <type_traits>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+// hardware implementations of the Haraka permutations, only used if
+// can_optimize() returns true
+#if defined(VERUS_HARAKA_AESNI)
+#define VERUS_HARAKA_NATIVE
+namespace {
+constexpr auto haraka256_native { haraka256_aesni };
+constexpr auto haraka256_native_x4 { haraka256_aesni_x4 };
+constexpr auto haraka512_native { haraka512_aesni };
+constexpr auto haraka512_native_keyed { haraka512_aesni_keyed };
+}
+#elif defined(VERUS_HARAKA_ARMV8)
+#define VERUS_HARAKA_NATIVE
+namespace {
+constexpr auto haraka256_native { haraka256_armv8 };
+constexpr auto haraka256_native_x4 { haraka256_armv8_x4 };
+constexpr auto haraka512_native { haraka512_armv8 };
+constexpr auto haraka512_native_keyed { haraka512_armv8_keyed };
+}
+#endif
 
 namespace Verus {
 class HashKey {
@@ -25,6 +54,15 @@ public:
     HashKey(HashView seedBytes,
         void (*haraka256Function)(unsigned char* out,
             const unsigned char* in));
+#ifdef VERUS_HARAKA_NATIVE
+    // generates 4 keys with interleaved haraka256 chains
+    static void apply_seeds_x4(HashKey* const keys[4]);
+    // key is not generated, use apply_seeds_x4
+    explicit HashKey(HashView seedBytes)
+        : curSeed(seedBytes)
+    {
+    }
+#endif
     void update_seed(HashView newSeed,
         void (*haraka256Function)(unsigned char* out,
             const unsigned char* in));
@@ -62,28 +100,76 @@ public:
 
 private:
     Hash curSeed;
+    void init_refresh();
     void apply_seed(HashView newSeed,
         void (*haraka256Function)(unsigned char* out,
             const unsigned char* in));
     /* data */
     alignas(32) uint8_t key[2 * keySizeInBytes];
 };
+namespace {
+std::atomic<bool> threadKeyBuffers { false };
+std::atomic<bool> portable { false };
+
+class ThreadKeyBuffer {
+public:
+    ThreadKeyBuffer()
+    {
+        if (!threadKeyBuffers.load(std::memory_order_relaxed))
+            return;
+#ifdef __linux__
+        constexpr size_t hugePage { 2 * 1024 * 1024 };
+        void* m { mmap(nullptr, hugePage, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0) };
+        if (m == MAP_FAILED) { // no reserved huge pages, try transparent ones
+            m = mmap(nullptr, hugePage, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (m == MAP_FAILED)
+                return;
+            madvise(m, hugePage, MADV_HUGEPAGE);
+        }
+        p = m;
+        size = hugePage;
+#endif
+    }
+    ~ThreadKeyBuffer()
+    {
+#ifdef __linux__
+        if (p)
+            munmap(p, size);
+#endif
+    }
+    void* get() const { return p; }
+
+private:
+    void* p { nullptr };
+    size_t size { 0 };
+};
+
+void* thread_key_buffer()
+{
+    thread_local ThreadKeyBuffer b;
+    return b.get();
+}
+}
+
+void use_thread_key_buffers(bool enable)
+{
+    threadKeyBuffers = enable;
+}
+
+void use_portable(bool enable)
+{
+    portable = enable;
+}
+
 bool can_optimize()
 {
-#if defined(__arm__) || defined(__aarch64__)
-    // long hwcaps = getauxval(AT_HWCAP);
-    //
-    // if ((hwcaps & HWCAP_AES) && (hwcaps & HWCAP_PMULL))
-    //     return true;
-    // else
+    if (portable.load(std::memory_order_relaxed))
         return false;
+    auto& f { cpu_features() };
+#if defined(__arm__) || defined(__aarch64__)
+    return f.armAes;
 #else
-    unsigned int eax, ebx, ecx, edx;
-    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
-        return false;
-    } else {
-        return ((ecx & (bit_AVX | bit_AES | bit_PCLMUL)) == (bit_AVX | bit_AES | bit_PCLMUL));
-    }
+    return f.avx && f.aes && f.pclmul;
 #endif
 }
 
@@ -152,10 +238,41 @@ void HashKey::apply_seed(HashView newSeed,
         (*haraka256Function)(buf, psrc);
         memcpy(pkey, buf, key256extra);
     }
+    init_refresh();
+};
+void HashKey::init_refresh()
+{
     memcpy(key + keySizeInBytes, key, keyRefreshsize);
     memset((unsigned char*)key + (keySizeInBytes + keyRefreshsize), 0,
         keySizeInBytes - keyRefreshsize);
-};
+}
+#ifdef VERUS_HARAKA_NATIVE
+void HashKey::apply_seeds_x4(HashKey* const keys[4])
+{
+    unsigned char* pkey[4];
+    const unsigned char* psrc[4];
+    for (size_t l = 0; l < 4; ++l) {
+        pkey[l] = keys[l]->key;
+        psrc[l] = keys[l]->curSeed.data();
+    }
+    for (size_t i = 0; i < key256blocks; i++) {
+        haraka256_native_x4(pkey, psrc);
+        for (size_t l = 0; l < 4; ++l) {
+            psrc[l] = pkey[l];
+            pkey[l] += 32;
+        }
+    }
+    if (key256extra != 0) {
+        unsigned char buf[4][32];
+        unsigned char* const bufs[4] { buf[0], buf[1], buf[2], buf[3] };
+        haraka256_native_x4(bufs, psrc);
+        for (size_t l = 0; l < 4; ++l)
+            memcpy(pkey[l], buf[l], key256extra);
+    }
+    for (size_t l = 0; l < 4; ++l)
+        keys[l]->init_refresh();
+}
+#endif
 HashKey::HashKey(HashView seed,
     void (*haraka256Function)(unsigned char* out,
         const unsigned char* in))
@@ -171,28 +288,80 @@ Hash VerusHasher::finalize()
     FillExtra((u128*)curBuf);
 
     // gen new key with what is last in buffer
+#ifdef VERUS_HARAKA_NATIVE
+    auto haraka256 { optimized ? haraka256_native : haraka256_port };
+#else
+    auto haraka256 { haraka256_port };
+#endif
+    static_assert(std::is_trivially_destructible_v<HashKey>);
+    if (void* p { thread_key_buffer() })
+        return finalize(*new (p) HashKey(curBuf, haraka256));
+    HashKey hk(curBuf, haraka256);
+    return finalize(hk);
+};
 
-    HashKey hk(curBuf,  haraka256_port);
-
+Hash VerusHasher::finalize(HashKey& hk)
+{
     // run verusclhash on the buffer
-    uint64_t intermediate { hk.apply_verusclhash(
-        curBuf,  verusclhash_sv2_1_port) };
+#ifdef VERUS_HARAKA_ARMV8
+    auto verusclhash { optimized ? verusclhash_sv2_1_armv8 : verusclhash_sv2_1_port };
+#else
+    auto verusclhash { verusclhash_sv2_1_port };
+#endif
+    uint64_t intermediate { hk.apply_verusclhash(curBuf, verusclhash) };
     // fill buffer to the end with the result
     FillExtra(&intermediate);
 
     // get the final hash with a mutated dynamic key for each hash result
     Hash out;
     constexpr uint64_t mask16 = keyMask >> 4;
+    const u128* rc { (const u128*)hk.key_data() + (intermediate & mask16) };
 
-    haraka512_port_keyed(out.data(), curBuf,
-            (const u128*)hk.key_data() + (intermediate & mask16));
-
+#ifdef VERUS_HARAKA_NATIVE
+    if (optimized) {
+        haraka512_native_keyed(out.data(), curBuf, rc);
+        return out;
+    }
+#endif
+    haraka512_port_keyed(out.data(), curBuf, rc);
     return out;
-};
+}
 
 VerusHasher& VerusHasher::write(const uint8_t* data, size_t len)
 {
+#ifdef VERUS_HARAKA_NATIVE
+    if (optimized)
+        return write(data, len, haraka512_native);
+#endif
     return write(data, len, haraka512_port);
 };
 
+void VerusHasher::hash_batch(std::span<const std::span<const uint8_t>> inputs, Hash* out)
+{
+    size_t i { 0 };
+#ifdef VERUS_HARAKA_NATIVE
+    if (can_optimize()) {
+        // key generation dominates the hashing time and is a chain of
+        // dependent haraka256 calls, interleave 4 of them
+        VerusHasher hashers[4];
+        auto keys { std::make_unique<std::array<std::optional<HashKey>, 4>>() };
+        for (; i + 4 <= inputs.size(); i += 4) {
+            HashKey* pkeys[4];
+            for (size_t l = 0; l < 4; ++l) {
+                auto& h { hashers[l] };
+                h.reset();
+                h.write(inputs[i + l]);
+                h.FillExtra((u128*)h.curBuf);
+                pkeys[l] = &(*keys)[l].emplace(h.curBuf);
+            }
+            HashKey::apply_seeds_x4(pkeys);
+            for (size_t l = 0; l < 4; ++l)
+                out[i + l] = hashers[l].finalize(*pkeys[l]);
+        }
+    }
+#endif
+    for (; i < inputs.size(); ++i)
+        out[i] = VerusHasher().write(inputs[i]).finalize();
+}
+
 } // namespace Verus
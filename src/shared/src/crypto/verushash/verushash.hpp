@@ -6,8 +6,19 @@
 
 namespace Verus {
 bool can_optimize();
+// Makes can_optimize() return false such that hashers constructed later
+// use the portable implementation, for comparing both in benchmarks.
+void use_portable(bool enable);
+
+// Generates the hash keys of each thread in a buffer owned by that thread
+// and backed by huge pages where available instead of on the stack. The
+// buffer is allocated by the first hash of a thread, so a thread pinned to
+// a core gets it on its NUMA node. Threads which hashed before keep using
+// the stack.
+void use_thread_key_buffers(bool enable);
 
 class MinerOpt;
+class HashKey;
 
 class VerusHasher {
     friend class MinerOpt;
@@ -15,6 +26,18 @@ class VerusHasher {
 
 public:
     VerusHasher();
+    // curBuf and result point into the own buffers
+    VerusHasher(const VerusHasher& o) { *this = o; }
+    VerusHasher& operator=(const VerusHasher& o)
+    {
+        std::memcpy(buf1, o.buf1, 64);
+        std::memcpy(buf2, o.buf2, 64);
+        curBuf = o.curBuf == o.buf1 ? buf1 : buf2;
+        result = o.result == o.buf1 ? buf1 : buf2;
+        curPos = o.curPos;
+        optimized = o.optimized;
+        return *this;
+    }
     void reset()
     {
         std::memset(curBuf, 0, 64);
@@ -27,6 +50,10 @@ public:
     }
     [[nodiscard]] Hash finalize();
 
+    // hashes inputs[i] into out[i], several inputs are processed
+    // simultaneously when AES instructions are available
+    static void hash_batch(std::span<const std::span<const uint8_t>> inputs, Hash* out);
+
 private:
     // data
     VerusHasher& write(const uint8_t* data, const size_t len,
@@ -60,6 +87,7 @@ private:
     // methods
     template <typename T>
     void FillExtra(const T* _data);
+    Hash finalize(HashKey& hk);
 };
 } // namespace Verus
 
@@ -67,3 +95,8 @@ private:
 {
     return Verus::VerusHasher().write(s).finalize();
 }
+
+inline void verus_hash_batch(std::span<const std::span<const uint8_t>> inputs, Hash* out)
+{
+    Verus::VerusHasher::hash_batch(inputs, out);
+}
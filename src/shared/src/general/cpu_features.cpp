@@ -0,0 +1,81 @@
+#include "cpu_features.hpp"
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#elif defined(__aarch64__) && defined(__linux__)
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+
+namespace {
+#if defined(__x86_64__) || defined(__i386__)
+uint64_t xgetbv0()
+{
+    uint32_t lo, hi;
+    __asm__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return (uint64_t(hi) << 32) | lo;
+}
+#endif
+
+CPUFeatures probe()
+{
+    CPUFeatures f;
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return f;
+    f.sse41 = ecx & bit_SSE4_1;
+    f.aes = ecx & bit_AES;
+    f.pclmul = ecx & bit_PCLMUL;
+    const uint64_t xcr0 { (ecx & bit_OSXSAVE) ? xgetbv0() : 0 };
+    const bool ymm { (xcr0 & 0x06) == 0x06 }; // XMM and YMM state
+    const bool zmm { (xcr0 & 0xe6) == 0xe6 }; // and opmask, ZMM state
+    f.avx = ymm && (ecx & bit_AVX);
+    if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        f.avx2 = f.avx && (ebx & bit_AVX2);
+        f.avx512 = zmm && (ebx & bit_AVX512F) && (ebx & bit_AVX512BW);
+        f.vaes = f.avx && (ecx & bit_VAES);
+        f.sha = ebx & bit_SHA;
+    }
+#elif defined(__aarch64__) && defined(__APPLE__)
+    // every Apple Silicon core has the crypto extension
+    f.armAes = true;
+    f.armSha2 = true;
+#elif defined(__aarch64__) && defined(__linux__)
+    const unsigned long hwcaps { getauxval(AT_HWCAP) };
+    f.armAes = (hwcaps & HWCAP_AES) && (hwcaps & HWCAP_PMULL);
+    f.armSha2 = hwcaps & HWCAP_SHA2;
+#endif
+    return f;
+}
+}
+
+std::string CPUFeatures::to_string() const
+{
+    std::string s;
+    auto add = [&](bool b, const char* name) {
+        if (!b)
+            return;
+        if (!s.empty())
+            s += ' ';
+        s += name;
+    };
+    add(sse41, "sse4.1");
+    add(aes, "aes");
+    add(pclmul, "pclmul");
+    add(avx, "avx");
+    add(avx2, "avx2");
+    add(avx512, "avx512");
+    add(vaes, "vaes");
+    add(sha, "sha");
+    add(armAes, "arm-aes");
+    add(armSha2, "arm-sha2");
+    return s.empty() ? "none" : s;
+}
+
+const CPUFeatures& cpu_features()
+{
+    static const CPUFeatures f { probe() };
+    return f;
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <string>
+
+// Instruction set extensions of the host CPU, probed once. The crypto and
+// hex kernels choose their implementation from these flags at runtime such
+// that a generic build runs at full speed on every host.
+struct CPUFeatures {
+    // x86, AVX variants only if the OS saves the wider registers
+    bool sse41 { false };
+    bool aes { false };
+    bool pclmul { false };
+    bool avx { false };
+    bool avx2 { false };
+    bool avx512 { false }; // F and BW
+    bool vaes { false };
+    bool sha { false };
+    // ARMv8 crypto extension
+    bool armAes { false }; // AES and PMULL
+    bool armSha2 { false };
+
+    std::string to_string() const;
+};
+
+const CPUFeatures& cpu_features();
@@ -85,17 +85,26 @@
     XX(86, ENOINIT, "first message must be init message")               \
     XX(87, EINVINIT, "only first message can be init message")          \
     XX(88, EFAKEACCID, "fake account id")                               \
+    XX(89, EMEMPOOLFULL, "mempool full and fee too low")                \
     XX(201, EBADNONCE, "cannot parse nonce")                            \
     XX(202, EBADFEE, "invalid fee")                                     \
     XX(203, EINEXACTFEE, "inexact fee not allowed")                     \
     XX(204, EBADAMOUNT, "invalid amount")                               \
     XX(205, EPARSESIG, "cannot parse signature")                        \
+    XX(206, ETXBATCHSIZE, "too many transactions in batch")             \
+    XX(207, EPAGESIZE, "invalid page size")                             \
+    XX(208, EBANPREFIX, "invalid ban range prefix")                     \
+    XX(209, ERATELIMIT, "too many requests")                            \
+    XX(210, EADDRBATCHSIZE, "too many addresses in batch")              \
+    XX(211, ESTATSRANGE, "invalid statistics range")                    \
     XX(1000, ESIGTERM, "received SIGTERM")                              \
     XX(1001, ESIGHUP, "received SIGHUP")                                \
     XX(1002, ESIGINT, "received SIGINT")                                \
     XX(1003, EREFUSED, "connection refused due to ban")                 \
     XX(1004, EMAXCONNECTIONS, "too many connections from this ip")      \
     XX(1005, EDUPLICATECONNECTION, "duplicate connection")              \
+    XX(1006, ESLOWPEER, "replaced slow peer")                           \
+    XX(1007, EREPLAYEND, "end of replayed session")                     \
     XX(2000, EBUG, "bug-related error")
 
 #define ERR_DEFINE(code, name, _) constexpr int32_t name = code;
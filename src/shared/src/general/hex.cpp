@@ -1,4 +1,14 @@
 #include "hex.hpp"
+#include "cpu_features.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HEX_X86
+#include <immintrin.h>
+#define HEX_SIMD
+#elif defined(__aarch64__)
+#include "crypto/sse2neon.h"
+#define HEX_SIMD
+#endif
 
 void serialize_hex(uint32_t number, char* out)
 {
@@ -6,7 +16,8 @@ void serialize_hex(uint32_t number, char* out)
     serialize_hex((const uint8_t*)&tmp, 4, out);
 };
 
-void serialize_hex(const uint8_t* data, size_t size, char* out)
+namespace {
+void serialize_hex_scalar(const uint8_t* data, size_t size, char* out)
 {
     constexpr const char* h = "0123456789abcdef";
     for (size_t i = 0; i < size; ++i) {
@@ -15,6 +26,96 @@ void serialize_hex(const uint8_t* data, size_t size, char* out)
     }
 }
 
+#ifdef HEX_SIMD
+// Nibbles are turned into characters arithmetically: '0' + n, plus the
+// distance from '9' + 1 to 'a' for n > 9. SSE2 is part of x86-64 and is
+// translated to NEON on aarch64.
+inline __m128i sse2_nibbles_to_hex(__m128i n)
+{
+    const __m128i gt9 { _mm_cmpgt_epi8(n, _mm_set1_epi8(9)) };
+    return _mm_add_epi8(_mm_add_epi8(n, _mm_set1_epi8('0')),
+        _mm_and_si128(gt9, _mm_set1_epi8('a' - '9' - 1)));
+}
+
+size_t serialize_hex_sse2(const uint8_t* data, size_t size, char* out)
+{
+    const __m128i mask { _mm_set1_epi8(0x0F) };
+    size_t i { 0 };
+    for (; i + 16 <= size; i += 16) {
+        const __m128i x { _mm_loadu_si128((const __m128i*)(data + i)) };
+        const __m128i hi { _mm_and_si128(_mm_srli_epi16(x, 4), mask) };
+        const __m128i lo { _mm_and_si128(x, mask) };
+        _mm_storeu_si128((__m128i*)(out + 2 * i), sse2_nibbles_to_hex(_mm_unpacklo_epi8(hi, lo)));
+        _mm_storeu_si128((__m128i*)(out + 2 * i + 16), sse2_nibbles_to_hex(_mm_unpackhi_epi8(hi, lo)));
+    }
+    return i;
+}
+
+// Parses 16 characters into 8 bytes, returns false on invalid characters.
+inline bool parse_hex_sse2(const char* in, uint8_t* out)
+{
+    const __m128i c { _mm_loadu_si128((const __m128i*)in) };
+    const __m128i zero { _mm_setzero_si128() };
+    const __m128i digit { _mm_sub_epi8(c, _mm_set1_epi8('0')) };
+    const __m128i letter { _mm_sub_epi8(_mm_or_si128(c, _mm_set1_epi8(0x20)), _mm_set1_epi8('a')) };
+    // unsigned x <= k  <=>  saturating x - k == 0
+    const __m128i isDigit { _mm_cmpeq_epi8(_mm_subs_epu8(digit, _mm_set1_epi8(9)), zero) };
+    const __m128i isLetter { _mm_cmpeq_epi8(_mm_subs_epu8(letter, _mm_set1_epi8(5)), zero) };
+    if (_mm_movemask_epi8(_mm_or_si128(isDigit, isLetter)) != 0xFFFF)
+        return false;
+    const __m128i v { _mm_or_si128(_mm_and_si128(isDigit, digit),
+        _mm_andnot_si128(isDigit, _mm_add_epi8(letter, _mm_set1_epi8(10)))) };
+    // high nibble in the even, low nibble in the odd byte of each 16 bit lane
+    const __m128i bytes { _mm_or_si128(_mm_and_si128(_mm_slli_epi16(v, 4), _mm_set1_epi16(0x00F0)),
+        _mm_srli_epi16(v, 8)) };
+    _mm_storel_epi64((__m128i*)out, _mm_packus_epi16(bytes, bytes));
+    return true;
+}
+#endif
+
+#ifdef HEX_X86
+#define HEX_AVX2 __attribute__((target("avx2")))
+HEX_AVX2 inline __m256i avx2_nibbles_to_hex(__m256i n)
+{
+    const __m256i gt9 { _mm256_cmpgt_epi8(n, _mm256_set1_epi8(9)) };
+    return _mm256_add_epi8(_mm256_add_epi8(n, _mm256_set1_epi8('0')),
+        _mm256_and_si256(gt9, _mm256_set1_epi8('a' - '9' - 1)));
+}
+
+HEX_AVX2 size_t serialize_hex_avx2(const uint8_t* data, size_t size, char* out)
+{
+    const __m256i mask { _mm256_set1_epi8(0x0F) };
+    size_t i { 0 };
+    for (; i + 32 <= size; i += 32) {
+        // unpack works within 128 bit lanes, order the quadwords such that
+        // the low halves hold bytes 0-15 and the high halves bytes 16-31
+        const __m256i x { _mm256_permute4x64_epi64(_mm256_loadu_si256((const __m256i*)(data + i)), 0xD8) };
+        const __m256i hi { _mm256_and_si256(_mm256_srli_epi16(x, 4), mask) };
+        const __m256i lo { _mm256_and_si256(x, mask) };
+        _mm256_storeu_si256((__m256i*)(out + 2 * i), avx2_nibbles_to_hex(_mm256_unpacklo_epi8(hi, lo)));
+        _mm256_storeu_si256((__m256i*)(out + 2 * i + 32), avx2_nibbles_to_hex(_mm256_unpackhi_epi8(hi, lo)));
+    }
+    return i;
+}
+#undef HEX_AVX2
+
+const bool hasAvx2 { cpu_features().avx2 };
+#endif
+}
+
+void serialize_hex(const uint8_t* data, size_t size, char* out)
+{
+    size_t i { 0 };
+#ifdef HEX_X86
+    if (hasAvx2)
+        i = serialize_hex_avx2(data, size, out);
+#endif
+#ifdef HEX_SIMD
+    i += serialize_hex_sse2(data + i, size - i, out + 2 * i);
+#endif
+    serialize_hex_scalar(data + i, size - i, out + 2 * i);
+}
+
 std::string serialize_hex(const uint8_t* data, size_t size)
 {
     std::string out;
@@ -82,8 +183,15 @@ bool parse_hex(std::string_view in, uint8_t* out, size_t out_size)
 {
     if (in.size() != out_size * 2)
         return false;
+    size_t i { 0 };
+#ifdef HEX_SIMD
+    for (; i + 8 <= out_size; i += 8) {
+        if (!parse_hex_sse2(in.data() + 2 * i, out + i))
+            return false;
+    }
+#endif
     bool valid = true;
-    for (size_t i = 0; i < out_size && valid; ++i) {
+    for (; i < out_size && valid; ++i) {
         out[i] = (hexdigit(in[2 * i], valid) << 4)
             + (hexdigit(in[2 * i + 1], valid));
     }
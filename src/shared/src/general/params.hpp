@@ -28,7 +28,9 @@ constexpr uint32_t MAXBLOCKSIZE = 35000; // max size per block (i.e. approximate
 // Batch parameters
 /////////////
 constexpr uint32_t HEADERBATCHSIZE = DEBUG_PARAMS ? 16 : 8640; // number of headers that are returned in one batch, reqestable from offsets equal to multiples of this number
-constexpr uint32_t MAXBLOCKBATCHSIZE = 30; // maximal number of blocks that can be requested
+constexpr uint32_t MAXBLOCKBATCHSIZE = 30; // maximal number of blocks that can be requested from any peer
+constexpr uint32_t MAXBLOCKRANGESIZE = 1200; // maximal number of blocks that can be requested from peers replying within a byte budget
+constexpr uint32_t MAXBLOCKREPSIZE = MAXBLOCKBATCHSIZE * (4 + MAXBLOCKSIZE); // byte budget of one block reply
 constexpr uint32_t BLOCKBATCHSIZE = 30; // number of blocks that the node requests in one batch
 
 /////////////
@@ -1,5 +1,8 @@
 #include "block/header/custom_float.hpp"
+#include "block/header/custom_float_batch.hpp"
 #include <iostream>
+#include <random>
+#include <vector>
 using namespace std;
 
 void assert_exactly_equal(double d1, double d2)
@@ -204,6 +207,113 @@ void test_custom_float()
     test_pow2_branches();
 }
 
+// the batch operations must agree bit by bit with the scalar ones
+void assert_same(const CustomFloat& f1, const CustomFloat& f2)
+{
+    assert(f1.mantissa() == f2.mantissa());
+    assert(f1.exponent() == f2.exponent());
+    assert(f1.positive() == f2.positive());
+}
+
+void test_batch_lanes(const std::vector<CustomFloat>& a, const std::vector<CustomFloat>& b)
+{
+    constexpr size_t L { CustomFloatBatch::lanes };
+    CustomFloatBatch ba(a.data()), bb(b.data());
+    auto sum { ba + bb };
+    auto difference { ba - bb };
+    auto product { ba * bb };
+    auto less { ba < b[0] };
+    for (size_t i = 0; i < L; ++i) {
+        assert_same(sum[i], a[i] + b[i]);
+        assert_same(difference[i], CustomFloat(a[i]) - b[i]);
+        assert_same(product[i], a[i] * b[i]);
+        if (a[i].positive() && a[i].exponent() <= 0 && b[0].positive() && b[0].exponent() <= 0)
+            assert(less[i] == (a[i] < b[0]));
+    }
+}
+
+void test_batch_functions(const std::vector<CustomFloat>& positive, const std::vector<CustomFloat>& exponents)
+{
+    constexpr size_t L { CustomFloatBatch::lanes };
+    CustomFloatBatch bp(positive.data()), be(exponents.data());
+    constexpr auto factor { CustomFloat(0, 3006477107) }; // = 0.7 as in Janushash
+    auto l { log2(bp) };
+    auto p2 { pow2(be) };
+    auto p { pow(bp, factor) };
+    for (size_t i = 0; i < L; ++i) {
+        assert_same(l[i], log2(positive[i]));
+        assert_same(p2[i], pow2(exponents[i]));
+        assert_same(p[i], pow(positive[i], factor));
+    }
+}
+
+void test_custom_float_batch()
+{
+    constexpr size_t L { CustomFloatBatch::lanes };
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    auto random_double = [&](double scale) {
+        auto d { std::ldexp(unit(rng) + 0.5, int(unit(rng) * 2 * scale) - int(scale)) };
+        return rng() % 2 ? d : -d;
+    };
+
+    for (size_t round = 0; round < 20000; ++round) {
+        // hash conversion, also with leading zero bytes and all zero
+        Hash hashes[L];
+        for (auto& h : hashes) {
+            for (auto& b : h)
+                b = rng();
+            const size_t zeros { rng() % 34 };
+            for (size_t j = 0; j < std::min(zeros, h.size()); ++j)
+                h[j] = 0;
+        }
+        const size_t n { 1 + rng() % L };
+        CustomFloatBatch bh(hashes, n);
+        for (size_t i = 0; i < L; ++i)
+            assert_same(bh[i], CustomFloat(hashes[std::min(i, n - 1)]));
+
+        // arithmetic with zeros, cancellation and distant exponents
+        std::vector<CustomFloat> a, b;
+        for (size_t i = 0; i < L; ++i) {
+            a.push_back(CustomFloat::from_double(random_double(40)));
+            switch (rng() % 5) {
+            case 0:
+                b.push_back(CustomFloat::zero());
+                break;
+            case 1:
+                b.push_back(CustomFloat::from_double(-a.back().to_double()));
+                break;
+            case 2:
+                b.push_back(a.back());
+                break;
+            default:
+                b.push_back(CustomFloat::from_double(random_double(i % 2 ? 2 : 100)));
+            }
+        }
+        if (round % 7 == 0)
+            a[round % L] = CustomFloat::zero();
+        test_batch_lanes(a, b);
+        test_batch_lanes(b, a);
+
+        // log2 and pow on hash values, pow2 on all of its branches
+        std::vector<CustomFloat> positive, exponents;
+        for (size_t i = 0; i < L; ++i) {
+            positive.push_back(bh[i]);
+            switch (rng() % 4) {
+            case 0:
+                exponents.push_back(CustomFloat::from_int(int32_t(rng() % 60) - 30));
+                break;
+            case 1:
+                exponents.push_back(CustomFloat::from_double(unit(rng) * 2 - 1));
+                break;
+            default:
+                exponents.push_back(CustomFloat::from_double(random_double(4)));
+            }
+        }
+        test_batch_functions(positive, exponents);
+    }
+}
+
 int main()
 {
     auto f = CustomFloat::from_double(0.005);
@@ -211,5 +321,6 @@ int main()
     cout<<"mantissa:  "<<f.mantissa()<<endl;
     cout<<"to_double: "<<f.to_double()<<endl;
     test_custom_float();
+    test_custom_float_batch();
     return 0;
 }
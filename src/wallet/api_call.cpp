@@ -13,11 +13,27 @@ size_t writeFunction(void* ptr, size_t size, size_t nmemb, std::string* data)
     return size * nmemb;
 }
 
+Endpoint::Endpoint(std::string host, uint16_t port)
+    : host(host)
+    , port(port)
+{
+}
+
+Endpoint::~Endpoint() = default;
+
+httplib::Client& Endpoint::cli()
+{
+    if (!client) {
+        client = std::make_unique<httplib::Client>(host, port);
+        client->set_read_timeout(10);
+        client->set_keep_alive(true);
+    }
+    return *client;
+}
+
 bool Endpoint::http_get(const std::string& get, std::string& out)
 {
-    httplib::Client cli(host, port);
-    cli.set_read_timeout(10);
-    if (auto res = cli.Get(get)) {
+    if (auto res = cli().Get(get)) {
         out = std::move(res->body);
         return true;
     }
@@ -26,9 +42,7 @@ bool Endpoint::http_get(const std::string& get, std::string& out)
 
 int Endpoint::http_post(const std::string& path, const std::vector<uint8_t>& postdata, std::string& out)
 {
-    httplib::Client cli(host, port);
-    cli.set_read_timeout(10);
-    if (auto res = cli.Post(path, (const char*)postdata.data(), postdata.size(), ""s)) {
+    if (auto res = cli().Post(path, (const char*)postdata.data(), postdata.size(), ""s)) {
         out = std::move(res->body);
         return true;
     }
@@ -94,6 +108,33 @@ std::pair<int32_t,std::string> Endpoint::send_transaction(const string& txjson)
     }
 }
 
+std::vector<std::pair<int32_t, std::string>> Endpoint::send_transactions(const string& txsjson)
+{
+    std::string out;
+    if (!http_post("/transaction/add_batch", std::vector<uint8_t>(txsjson.begin(), txsjson.end()), out)) {
+        throw failed_msg();
+    }
+    json parsed;
+    try {
+        parsed = json::parse(out);
+    } catch (...) {
+        throw std::runtime_error("API request failed, response is malformed. Is the node version compatible with this wallet?");
+    }
+    if (auto code { parsed.value("code", 0) }; code != 0) {
+        throw std::runtime_error("Batch rejected (code " + std::to_string(code) + "): " + parsed.value("error", ""s));
+    }
+    try {
+        std::vector<std::pair<int32_t, std::string>> res;
+        for (auto& e : parsed["data"]) {
+            auto& error { e["error"] };
+            res.push_back({ e["code"].get<int32_t>(), error.is_null() ? ""s : error.get<string>() });
+        }
+        return res;
+    } catch (...) {
+        throw std::runtime_error("API request failed, response is malformed. Is the node version compatible with this wallet?");
+    }
+}
+
 std::runtime_error Endpoint::failed_msg()
 {
     return std::runtime_error { "API request to host " + host + " at port " + std::to_string(port) + " failed. Are you running the node with RPC endpoint enabled?" };
@@ -2,21 +2,29 @@
 #include "crypto/hash.hpp"
 #include "general/funds.hpp"
 #include <array>
+#include <memory>
 #include <string>
 #include <vector>
+namespace httplib {
+class Client;
+}
 struct PinHeight;
+// Requests share one keep-alive connection to the node.
 class Endpoint {
     std::string host;
     uint16_t port;
+    std::unique_ptr<httplib::Client> client;
 
 public:
-    Endpoint(std::string host, uint16_t port)
-        : host(host)
-        , port(port) {};
+    Endpoint(std::string host, uint16_t port);
+    ~Endpoint();
     Funds get_balance(const std::string& account);
     std::pair<int32_t,std::string> send_transaction(const std::string& txjson);
+    // txsjson is a JSON array of transactions, returns code and error per entry
+    std::vector<std::pair<int32_t, std::string>> send_transactions(const std::string& txsjson);
     std::pair<PinHeight, Hash> get_pin();
 private:
+    httplib::Client& cli();
     bool http_get(const std::string& get, std::string& out);
     int http_post(const std::string& path, const std::vector<uint8_t>& postdata, std::string& out);
     std::runtime_error failed_msg();
@@ -0,0 +1,236 @@
+#include "httplib.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <thread>
+using namespace std;
+using namespace std::chrono;
+
+// HTTP API load benchmark: replays a recorded request mix over concurrent
+// keep-alive connections and reports latency percentiles per route next to
+// the chain server queue depth sampled from the node's /metrics endpoint.
+namespace {
+struct Options {
+    string mix; // file with one "<route> <path>" request per line
+    string address; // account for the built-in mix
+    string host { "localhost" };
+    uint16_t port { 3000 };
+    size_t connections { 8 };
+    double duration { 30 }; // seconds
+};
+
+struct Request {
+    string route;
+    string path;
+};
+
+void usage()
+{
+    cerr << "Usage: wart-apibench (--mix FILE | --address ADDR) [--host HOST] [--port PORT]\n"
+            "                     [--connections N] [--duration SECONDS]\n"
+            "Each line of FILE is a recorded request \"<route> <path>\", repeated lines\n"
+            "weight the mix. Without FILE a mix of head, balance, history, block, mine\n"
+            "and mempool requests for ADDR is replayed.\n";
+}
+
+Options parse_options(int argc, char** argv)
+{
+    Options o;
+    for (int i = 1; i < argc; ++i) {
+        string k { argv[i] };
+        if (i + 1 == argc)
+            throw std::runtime_error("Missing value for " + k + ".");
+        string v { argv[++i] };
+        if (k == "--mix")
+            o.mix = v;
+        else if (k == "--address")
+            o.address = v;
+        else if (k == "--host")
+            o.host = v;
+        else if (k == "--port")
+            o.port = stoul(v);
+        else if (k == "--connections")
+            o.connections = std::max<size_t>(stoul(v), 1);
+        else if (k == "--duration")
+            o.duration = stod(v);
+        else
+            throw std::runtime_error("Unknown option " + k + ".");
+    }
+    if (o.mix.empty() == o.address.empty() || !(o.duration > 0))
+        throw std::runtime_error("Exactly one of --mix and --address and a positive --duration are required.");
+    return o;
+}
+
+vector<Request> read_mix(const string& path)
+{
+    ifstream is(path);
+    if (!is.good())
+        throw std::runtime_error("Cannot open mix file '" + path + "'.");
+    vector<Request> res;
+    for (string line; getline(is, line);) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        istringstream ls(line);
+        Request r;
+        if (!(ls >> r.route >> r.path))
+            throw std::runtime_error("Invalid mix line '" + line + "'.");
+        res.push_back(std::move(r));
+    }
+    if (res.empty())
+        throw std::runtime_error("Mix file '" + path + "' is empty.");
+    return res;
+}
+
+// read heavy, roughly the proportions seen on public nodes
+vector<Request> default_mix(const string& address)
+{
+    vector<pair<Request, size_t>> weighted {
+        { { "head", "/chain/head" }, 30 },
+        { { "balance", "/account/" + address + "/balance" }, 25 },
+        { { "history", "/account/" + address + "/history/0" }, 10 },
+        { { "block", "/chain/block/1" }, 10 },
+        { { "mine", "/chain/mine/" + address }, 15 },
+        { { "mempool", "/transaction/mempool" }, 10 },
+    };
+    vector<Request> res;
+    for (size_t i = 0;; ++i) { // interleaved such that every window sees all routes
+        bool added { false };
+        for (auto& [r, w] : weighted) {
+            if (i < w) {
+                res.push_back(r);
+                added = true;
+            }
+        }
+        if (!added)
+            return res;
+    }
+}
+
+double percentile(vector<double> v, double p)
+{
+    if (v.empty())
+        return 0;
+    auto n { std::min(v.size() - 1, size_t(p * v.size())) };
+    std::nth_element(v.begin(), v.begin() + n, v.end());
+    return v[n];
+}
+
+struct RouteStats {
+    vector<double> latencies; // milliseconds
+    size_t depthSum { 0 }; // queue depth when the request was sent
+    size_t errors { 0 };
+    void merge(RouteStats&& o)
+    {
+        latencies.insert(latencies.end(), o.latencies.begin(), o.latencies.end());
+        depthSum += o.depthSum;
+        errors += o.errors;
+    }
+};
+
+optional<size_t> queue_depth(httplib::Client& cli)
+{
+    auto res { cli.Get("/metrics") };
+    if (!res || res->status != 200)
+        return {};
+    constexpr string_view key { "warthog_chainserver_queue_depth " };
+    auto& b { res->body };
+    for (size_t pos = 0; pos < b.size();) {
+        auto end { std::min(b.find('\n', pos), b.size()) };
+        string_view line { b.data() + pos, end - pos };
+        if (line.starts_with(key))
+            return size_t(stod(string(line.substr(key.size()))));
+        pos = end + 1;
+    }
+    return {};
+}
+}
+
+int main(int argc, char** argv)
+{
+    try {
+        auto o { parse_options(argc, argv) };
+        const auto mix { o.mix.empty() ? default_mix(o.address) : read_mix(o.mix) };
+
+        std::atomic<size_t> depth { 0 };
+        std::atomic<bool> done { false };
+        const auto deadline { steady_clock::now() + duration_cast<steady_clock::duration>(duration<double>(o.duration)) };
+
+        vector<double> depths;
+        std::thread sampler([&]() {
+            httplib::Client cli(o.host, o.port);
+            cli.set_keep_alive(true);
+            while (!done) {
+                if (auto d { queue_depth(cli) }) {
+                    depth = *d;
+                    depths.push_back(*d);
+                }
+                std::this_thread::sleep_for(100ms);
+            }
+        });
+
+        vector<map<string, RouteStats>> perConnection(o.connections);
+        vector<std::thread> threads;
+        for (size_t c = 0; c < o.connections; ++c) {
+            threads.emplace_back([&, c]() {
+                httplib::Client cli(o.host, o.port);
+                cli.set_keep_alive(true);
+                cli.set_read_timeout(30);
+                auto& stats { perConnection[c] };
+                // connections start at different offsets of the mix
+                for (size_t i = c * mix.size() / o.connections; steady_clock::now() < deadline; ++i) {
+                    auto& r { mix[i % mix.size()] };
+                    auto& s { stats[r.route] };
+                    s.depthSum += depth;
+                    auto sent { steady_clock::now() };
+                    auto res { cli.Get(r.path) };
+                    s.latencies.push_back(duration<double, milli>(steady_clock::now() - sent).count());
+                    if (!res || res->status != 200)
+                        s.errors += 1;
+                }
+            });
+        }
+        for (auto& t : threads)
+            t.join();
+        done = true;
+        sampler.join();
+
+        map<string, RouteStats> routes;
+        for (auto& m : perConnection)
+            for (auto& [route, s] : m)
+                routes[route].merge(std::move(s));
+
+        size_t total { 0 };
+        cout << std::fixed << std::setprecision(2)
+             << left << setw(12) << "route" << right << setw(9) << "requests" << setw(8) << "errors"
+             << setw(10) << "p50 ms" << setw(10) << "p99 ms" << setw(10) << "p999 ms" << setw(12) << "avg depth" << "\n";
+        for (auto& [route, s] : routes) {
+            const size_t n { s.latencies.size() };
+            total += n;
+            cout << left << setw(12) << route << right << setw(9) << n << setw(8) << s.errors
+                 << setw(10) << percentile(s.latencies, 0.5)
+                 << setw(10) << percentile(s.latencies, 0.99)
+                 << setw(10) << percentile(s.latencies, 0.999)
+                 << setw(12) << (n ? double(s.depthSum) / n : 0.0) << "\n";
+        }
+        cout << total << " requests over " << o.connections << " connections, "
+             << total / o.duration << " req/s.\n";
+        if (depths.empty())
+            cout << "Chain server queue depth not available (no /metrics).\n";
+        else
+            cout << "Chain server queue depth: p50 " << percentile(depths, 0.5)
+                 << ", p99 " << percentile(depths, 0.99)
+                 << ", max " << percentile(depths, 1) << "\n";
+        cout.flush();
+        return 0;
+    } catch (std::exception& e) {
+        cerr << e.what() << endl;
+        usage();
+        return -1;
+    }
+}
@@ -49,6 +49,7 @@ const char *gengetopt_args_info_help[] = {
   "      --nonce=LONGLONG      Specify transaction nonce",
   "  -h, --host=STRING         Host (RPC-Node)  (default=`localhost')",
   "  -p, --port=INT            Port (RPC-Node)  (default=`3000')",
+  "      --payout=FILENAME     Sign and submit all transfers listed in a JSON or\n                              CSV file",
     0
 };
 
@@ -89,6 +90,7 @@ void clear_given (struct gengetopt_args_info *args_info)
   args_info->nonce_given = 0 ;
   args_info->host_given = 0 ;
   args_info->port_given = 0 ;
+  args_info->payout_given = 0 ;
 }
 
 static
@@ -110,6 +112,8 @@ void clear_args (struct gengetopt_args_info *args_info)
   args_info->host_orig = NULL;
   args_info->port_arg = 3000;
   args_info->port_orig = NULL;
+  args_info->payout_arg = NULL;
+  args_info->payout_orig = NULL;
   
 }
 
@@ -133,6 +137,7 @@ void init_args_info(struct gengetopt_args_info *args_info)
   args_info->nonce_help = gengetopt_args_info_help[12] ;
   args_info->host_help = gengetopt_args_info_help[13] ;
   args_info->port_help = gengetopt_args_info_help[14] ;
+  args_info->payout_help = gengetopt_args_info_help[15] ;
   
 }
 
@@ -236,6 +241,8 @@ cmdline_parser_release (struct gengetopt_args_info *args_info)
   free_string_field (&(args_info->host_arg));
   free_string_field (&(args_info->host_orig));
   free_string_field (&(args_info->port_orig));
+  free_string_field (&(args_info->payout_arg));
+  free_string_field (&(args_info->payout_orig));
   
   
 
@@ -296,6 +303,8 @@ cmdline_parser_dump(FILE *outfile, struct gengetopt_args_info *args_info)
     write_into_file(outfile, "host", args_info->host_orig, 0);
   if (args_info->port_given)
     write_into_file(outfile, "port", args_info->port_orig, 0);
+  if (args_info->payout_given)
+    write_into_file(outfile, "payout", args_info->payout_orig, 0);
   
 
   i = EXIT_SUCCESS;
@@ -575,6 +584,7 @@ cmdline_parser_internal (
         { "nonce",	1, NULL, 0 },
         { "host",	1, NULL, 'h' },
         { "port",	1, NULL, 'p' },
+        { "payout",	1, NULL, 0 },
         { 0,  0, 0, 0 }
       };
 
@@ -762,6 +772,20 @@ cmdline_parser_internal (
                 additional_error))
               goto failure;
           
+          }
+          /* Sign and submit all transfers listed in a JSON or CSV file.  */
+          else if (strcmp (long_options[option_index].name, "payout") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->payout_arg), 
+                 &(args_info->payout_orig), &(args_info->payout_given),
+                &(local_args_info.payout_given), optarg, 0, 0, ARG_STRING,
+                check_ambiguity, override, 0, 0,
+                "payout", '-',
+                additional_error))
+              goto failure;
+          
           }
           
           break;
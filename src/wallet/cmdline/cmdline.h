@@ -72,6 +72,9 @@ struct gengetopt_args_info
   int port_arg;	/**< @brief Port (RPC-Node) (default='3000').  */
   char * port_orig;	/**< @brief Port (RPC-Node) original value given at command line.  */
   const char *port_help; /**< @brief Port (RPC-Node) help description.  */
+  char * payout_arg;	/**< @brief Sign and submit all transfers listed in a JSON or CSV file.  */
+  char * payout_orig;	/**< @brief Sign and submit all transfers listed in a JSON or CSV file original value given at command line.  */
+  const char *payout_help; /**< @brief Sign and submit all transfers listed in a JSON or CSV file help description.  */
   
   unsigned int help_given ;	/**< @brief Whether help was given.  */
   unsigned int version_given ;	/**< @brief Whether version was given.  */
@@ -88,6 +91,7 @@ struct gengetopt_args_info
   unsigned int nonce_given ;	/**< @brief Whether nonce was given.  */
   unsigned int host_given ;	/**< @brief Whether host was given.  */
   unsigned int port_given ;	/**< @brief Whether port was given.  */
+  unsigned int payout_given ;	/**< @brief Whether payout was given.  */
 
 } ;
 
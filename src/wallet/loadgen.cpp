@@ -0,0 +1,177 @@
+#include "api_call.hpp"
+#include "communication/create_payment.hpp"
+#include "crypto/crypto.hpp"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <thread>
+using namespace std;
+using namespace std::chrono;
+
+// Transaction flood for mempool admission benchmarks: pre-signs transfers
+// of funded test accounts and submits them in batches at a fixed rate,
+// then reports acceptance latency and throughput as seen by the client.
+namespace {
+struct Options {
+    string keys; // file with one private key per line
+    string host { "localhost" };
+    uint16_t port { 3000 };
+    size_t count { 1000 }; // transactions per account
+    double rate { 1000 }; // transactions per second
+    size_t batch { 500 };
+    Funds fee { Funds::throw_parse("0.0001") };
+    Funds amount { Funds::throw_parse("0.00000001") };
+};
+
+void usage()
+{
+    cerr << "Usage: wart-loadgen --keys FILE [--host HOST] [--port PORT] [--count N]\n"
+            "                    [--rate TX/S] [--batch N] [--fee WART] [--amount WART]\n"
+            "Each account in FILE sends --count transfers to the next account.\n";
+}
+
+Options parse_options(int argc, char** argv)
+{
+    Options o;
+    for (int i = 1; i < argc; ++i) {
+        string k { argv[i] };
+        if (i + 1 == argc)
+            throw std::runtime_error("Missing value for " + k + ".");
+        string v { argv[++i] };
+        auto funds = [&]() {
+            if (auto f { Funds::parse(v) })
+                return *f;
+            throw std::runtime_error("Invalid amount '" + v + "' for " + k + ".");
+        };
+        if (k == "--keys")
+            o.keys = v;
+        else if (k == "--host")
+            o.host = v;
+        else if (k == "--port")
+            o.port = stoul(v);
+        else if (k == "--count")
+            o.count = stoul(v);
+        else if (k == "--rate")
+            o.rate = stod(v);
+        else if (k == "--batch")
+            o.batch = std::clamp<size_t>(stoul(v), 1, 10000); // maximal batch accepted by the node
+        else if (k == "--fee")
+            o.fee = funds();
+        else if (k == "--amount")
+            o.amount = funds();
+        else
+            throw std::runtime_error("Unknown option " + k + ".");
+    }
+    if (o.keys.empty() || !(o.rate > 0))
+        throw std::runtime_error("Options --keys and a positive --rate are required.");
+    return o;
+}
+
+vector<PrivKey> read_keys(const string& path)
+{
+    ifstream is(path);
+    if (!is.good())
+        throw std::runtime_error("Cannot open key file '" + path + "'.");
+    vector<PrivKey> res;
+    for (string line; getline(is, line);) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        res.push_back(PrivKey(line));
+    }
+    if (res.size() < 2)
+        throw std::runtime_error("Key file needs at least 2 funded accounts.");
+    return res;
+}
+
+vector<PaymentCreateMessage> sign_all(const Options& o, const vector<PrivKey>& keys, const pair<PinHeight, Hash>& pin)
+{
+    vector<Address> addresses;
+    for (auto& k : keys)
+        addresses.push_back(k.pubkey().address());
+    vector<PaymentCreateMessage> res;
+    res.reserve(keys.size() * o.count);
+    // interleaved by account such that every batch spreads over accounts
+    vector<uint32_t> nonces;
+    for (size_t a = 0; a < keys.size(); ++a)
+        nonces.push_back(NonceId::random().value());
+    for (size_t i = 0; i < o.count; ++i) {
+        for (size_t a = 0; a < keys.size(); ++a) {
+            res.emplace_back(pin.first, pin.second, keys[a], CompactUInt::compact(o.fee),
+                addresses[(a + 1) % keys.size()], o.amount, NonceId(nonces[a] + uint32_t(i)));
+        }
+    }
+    return res;
+}
+
+double percentile(vector<double> v, double p)
+{
+    if (v.empty())
+        return 0;
+    auto n { std::min(v.size() - 1, size_t(p * v.size())) };
+    std::nth_element(v.begin(), v.begin() + n, v.end());
+    return v[n];
+}
+}
+
+int main(int argc, char** argv)
+{
+    try {
+        auto o { parse_options(argc, argv) };
+        auto keys { read_keys(o.keys) };
+        Endpoint endpoint(o.host, o.port);
+        auto pin { endpoint.get_pin() };
+
+        auto t0 { steady_clock::now() };
+        auto txs { sign_all(o, keys, pin) };
+        cout << "Signed " << txs.size() << " transactions in "
+             << duration<double>(steady_clock::now() - t0).count() << "s." << endl;
+
+        vector<double> latencies; // per batch, milliseconds
+        map<int32_t, pair<size_t, string>> rejected; // by code
+        size_t accepted { 0 };
+        const auto interval { duration<double>(o.batch / o.rate) };
+        const auto start { steady_clock::now() };
+        for (size_t begin = 0, n = 0; begin < txs.size(); begin += o.batch, ++n) {
+            std::this_thread::sleep_until(start + duration_cast<steady_clock::duration>(n * interval));
+            const size_t end { std::min(txs.size(), begin + o.batch) };
+            string body { "[" };
+            for (size_t i = begin; i < end; ++i) {
+                if (i != begin)
+                    body += ",";
+                body += string(txs[i]);
+            }
+            body += "]";
+            auto sent { steady_clock::now() };
+            auto results { endpoint.send_transactions(body) };
+            latencies.push_back(duration<double, milli>(steady_clock::now() - sent).count());
+            for (auto& [code, error] : results) {
+                if (code == 0) {
+                    accepted += 1;
+                } else {
+                    auto& r { rejected[code] };
+                    r.first += 1;
+                    r.second = error;
+                }
+            }
+        }
+        const double elapsed { duration<double>(steady_clock::now() - start).count() };
+
+        cout << "Submitted " << txs.size() << " transactions in " << latencies.size()
+             << " batches of up to " << o.batch << " in " << elapsed << "s.\n"
+             << "Accepted " << accepted << " (" << accepted / elapsed << " tx/s).\n"
+             << "Batch latency ms: p50 " << percentile(latencies, 0.5)
+             << ", p90 " << percentile(latencies, 0.9)
+             << ", p99 " << percentile(latencies, 0.99)
+             << ", max " << percentile(latencies, 1) << "\n";
+        for (auto& [code, r] : rejected)
+            cout << "Rejected " << r.first << " (code " << code << "): " << r.second << "\n";
+        cout.flush();
+        return 0;
+    } catch (std::exception& e) {
+        cerr << e.what() << endl;
+        usage();
+        return -1;
+    }
+}
@@ -131,12 +131,139 @@ Address read_address(std::string msg)
     return Address(read_with_msg(msg));
 }
 
+struct Payout {
+    Address to;
+    Funds amount;
+    std::optional<Funds> fee; // --fee otherwise
+    std::optional<NonceId> nonce; // random otherwise
+};
+
+// Payout files are either a JSON array of objects with the keys "to",
+// "amount" and optionally "fee" and "nonce", or CSV with lines
+// "to,amount[,fee[,nonce]]" where empty lines and lines starting with '#'
+// are skipped.
+std::vector<Payout> read_payouts(const filesystem::path& path)
+{
+    ifstream file(path);
+    if (!file.is_open())
+        throw std::runtime_error("Cannot read file '" + path.string() + "'.");
+    ostringstream ss;
+    ss << file.rdbuf();
+    const std::string content { ss.str() };
+
+    std::vector<Payout> res;
+    auto entry_error = [&](size_t i, const std::string& what) {
+        return std::runtime_error("Payout file '" + path.string() + "', entry " + std::to_string(i + 1) + ": " + what);
+    };
+    auto parse_entry = [&](size_t i, std::string_view to, const std::string& amount, const std::string& fee, const std::string& nonce) {
+        try {
+            res.push_back({ .to { Address(to) },
+                .amount { parse_amount(amount) },
+                .fee { fee.empty() ? std::optional<Funds>() : parse_amount(fee) },
+                .nonce { nonce.empty() ? std::optional<NonceId>() : NonceId(uint32_t(std::stoul(nonce))) } });
+        } catch (Error& e) {
+            throw entry_error(i, e.strerror());
+        } catch (std::logic_error&) {
+            throw entry_error(i, "Cannot parse nonce \"" + nonce + "\"");
+        } catch (std::runtime_error& e) {
+            throw entry_error(i, e.what());
+        }
+    };
+
+    if (auto pos { content.find_first_not_of(" \t\r\n") }; pos != std::string::npos && content[pos] == '[') {
+        json parsed;
+        try {
+            parsed = json::parse(content);
+        } catch (nlohmann::detail::parse_error&) {
+            throw std::runtime_error("Payout file '" + path.string() + "' has incorrect JSON structure.");
+        }
+        for (size_t i = 0; i < parsed.size(); ++i) {
+            auto& e { parsed[i] };
+            auto str = [&](const char* key) -> std::string {
+                auto iter { e.find(key) };
+                if (iter == e.end())
+                    return "";
+                return iter->is_string() ? iter->get<std::string>() : iter->dump();
+            };
+            if (!e.is_object() || !e.contains("to") || !e.contains("amount"))
+                throw entry_error(i, "\"to\" and \"amount\" are required");
+            parse_entry(i, str("to"), str("amount"), str("fee"), str("nonce"));
+        }
+        return res;
+    }
+
+    istringstream lines(content);
+    std::string line;
+    for (size_t i = 0; std::getline(lines, line); ++i) {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::vector<std::string> fields;
+        istringstream cols(line);
+        for (std::string f; std::getline(cols, f, ',');)
+            fields.push_back(f);
+        if (fields.size() < 2 || fields.size() > 4)
+            throw entry_error(i, "expected \"to,amount[,fee[,nonce]]\"");
+        fields.resize(4);
+        parse_entry(i, fields[0], fields[1], fields[2], fields[3]);
+    }
+    return res;
+}
+
+// Signs all payouts with the same pin and submits them in batches over one
+// connection.
+int payout(Endpoint& endpoint, const Wallet& w, const filesystem::path& path, std::optional<Funds> defaultFee)
+{
+    auto payouts { read_payouts(path) };
+    std::vector<PaymentCreateMessage> messages;
+    messages.reserve(payouts.size());
+    auto pin = endpoint.get_pin();
+    for (size_t i = 0; i < payouts.size(); ++i) {
+        auto& p { payouts[i] };
+        auto fee { p.fee ? p.fee : defaultFee };
+        if (!fee)
+            throw std::runtime_error("Payout " + std::to_string(i + 1) + " has no fee, specify a default using --fee.");
+        messages.emplace_back(pin.first, pin.second, w.privKey, CompactUInt::compact(*fee),
+            p.to, p.amount, p.nonce ? *p.nonce : NonceId::random());
+    }
+
+    constexpr size_t batchSize { 10000 }; // maximal batch accepted by the node
+    size_t rejected { 0 };
+    for (size_t begin = 0; begin < messages.size(); begin += batchSize) {
+        const size_t end { std::min(messages.size(), begin + batchSize) };
+        std::string txs { "[" };
+        for (size_t i = begin; i < end; ++i) {
+            if (i != begin)
+                txs += ",";
+            txs += std::string(messages[i]);
+        }
+        txs += "]";
+        auto results { endpoint.send_transactions(txs) };
+        if (results.size() != end - begin)
+            throw std::runtime_error("API request failed, response is malformed. Is the node version compatible with this wallet?");
+        for (size_t i = begin; i < end; ++i) {
+            auto& [code, error] { results[i - begin] };
+            auto& m { messages[i] };
+            cout << m.toAddr.to_string() << " " << m.amount.to_string() << " nonce " << m.nonceId.value() << ": ";
+            if (code) {
+                rejected += 1;
+                cout << "rejected (code " << code << "): " << error << "\n";
+            } else {
+                cout << "accepted\n";
+            }
+        }
+    }
+    cout << messages.size() - rejected << " of " << messages.size() << " transactions accepted." << endl;
+    return rejected == 0 ? 0 : -1;
+}
+
 int process(gengetopt_args_info& ai)
 {
     bool action = false;
-    size_t sum_actions = ai.address_given + ai.balance_given + ai.send_given;
+    size_t sum_actions = ai.address_given + ai.balance_given + ai.send_given + ai.payout_given;
     if (sum_actions > 1) {
-        cerr << "Invalid combination of --address, --balance and --send.";
+        cerr << "Invalid combination of --address, --balance, --send and --payout.";
         return -1;
     }
 
@@ -177,6 +304,10 @@ int process(gengetopt_args_info& ai)
             cout << balance_lambda().to_string() << endl;
             return 0;
         }
+        if (ai.payout_given) {
+            return payout(endpoint, *w, ai.payout_arg,
+                ai.fee_given ? parse_amount(ai.fee_arg) : std::optional<Funds>());
+        }
         if (ai.send_given) {
             bool interactive { ai.to_given || !ai.fee_given || !ai.amount_given || !ai.nonce_given };
             Address to(ai.to_given ? Address(ai.to_arg) : read_address("To: "));